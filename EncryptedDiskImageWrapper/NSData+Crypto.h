@@ -26,24 +26,87 @@
 
 #import <Foundation/Foundation.h>
 
+#import "PGCryptoProvider.h"
+
 /*!
- @abstract The error domain used when errors originate in the CommonCrypto functions.
+ @abstract The error domain used when errors originate in the crypto provider.
+ @discussion Error codes are PGCryptoStatus values, which are the same as CommonCrypto's CCCryptorStatus values regardless of the provider.
  */
 extern NSString *const PGCommonCryptoErrorDomain;
 
+/*!
+ @abstract The symmetric key encryption algorithms supported by NSData (Crypto).
+ @discussion These values are stored alongside encrypted data, e.g., in user table entries, so they must never change.
+ @constant PGAES256CBCEncryptionAlgorithm AES-256 in CBC mode with PKCS #7 padding and a 16-byte initialization vector. This is the algorithm used
+     by the data methods that don't take one. It can't detect tampering, and a wrong key is only detected when the padding happens to be invalid.
+ @constant PGAES256GCMEncryptionAlgorithm AES-256 in GCM mode with a 12-byte initialization vector. The ciphertext is the same length as the
+     plaintext and is followed by a 16-byte authentication tag, so any change to the key, initialization vector, associated data, or ciphertext 
+     makes decryption fail with kCCDecodeError. GCM can encrypt blocks in parallel, and both crypto providers use the processor's AES and 
+     carry-less multiplication instructions for it. It is recommended for all new data, and it is the algorithm used by the streaming methods 
+     that don't take one. Streams are split into 64 KB chunks, each sealed separately with its own nonce and tag, so that they can be 
+     authenticated as they are decrypted; see PGStreamCryptor.
+ */
+typedef enum {
+    PGAES256CBCEncryptionAlgorithm = 0,
+    PGAES256GCMEncryptionAlgorithm = 1
+} PGEncryptionAlgorithm;
+
+enum {
+    /*! @abstract The length in bytes of symmetric keys generated by +randomSymmetricKey and derived from passwords. */
+    PGSymmetricKeyLength = 32,
+    
+    /*! @abstract The length in bytes of the salts generated for deriving keys from passwords. */
+    PGKeyDerivationSaltLength = 24,
+    
+    /*! @abstract The most scrypt lanes that calibration uses when no lane count is given, however many processors there are. */
+    PGScryptMaximumDefaultLanes = 4,
+    
+    /*! @abstract The smallest scrypt cost (N) that calibration chooses, which gives each lane 16 MB with the default block size. */
+    PGScryptMinimumCalibratedCost = 1 << 14
+};
+
+/*!
+ @abstract The algorithms with which NSData (Crypto) derives keys from passwords.
+ @discussion These values are stored alongside encrypted data, e.g., in user table entries, so they must never change.
+ @constant PGPBKDF2KeyDerivationAlgorithm PBKDF2 with HMAC-SHA256. This is the algorithm used by the methods that take a rounds value. It runs
+     on a single core and needs almost no memory, so it resists guessing on GPUs poorly.
+ @constant PGScryptKeyDerivationAlgorithm scrypt (RFC 7914), which is memory-hard and splits its work into lanes that run concurrently. See 
+     PGScrypt.h.
+ */
+typedef enum {
+    PGPBKDF2KeyDerivationAlgorithm = 0,
+    PGScryptKeyDerivationAlgorithm = 1
+} PGKeyDerivationAlgorithm;
+
+/*!
+ @abstract The parameters with which a key is derived from a password.
+ @field algorithm The key derivation algorithm.
+ @field rounds For PBKDF2, the number of rounds. For scrypt, the cost parameter (N), which is a power of two. 0 means that the parameters have
+     yet to be calibrated.
+ @field blockSize For scrypt, the block size parameter (r). Unused by PBKDF2.
+ @field lanes For scrypt, the parallelization parameter (p). Unused by PBKDF2.
+ */
+typedef struct {
+    PGKeyDerivationAlgorithm algorithm;
+    uint32_t rounds;
+    uint32_t blockSize;
+    uint32_t lanes;
+} PGKeyDerivationParameters;
+
 /*!
  @abstract Additions to NSData to support cryptography.
  @discussion The Crypto category of NSData adds methods of general utility in cryptographic applications. It adds methods for secure random
      number and password generation, MD5 and SHA digests, and AES symmetric key cryptography.
  
-     All cryptographic methods are implemented using a combination of the Security Framework and Common Crypto library.
+     All cryptographic methods are implemented using the default crypto provider (see PGCryptoProvider.h), which is the Security Framework
+     and Common Crypto library unless another provider has been set.
  */
 @interface NSData (Crypto)
 
 
 /*!
  @abstract Returns a newly initialized data object containing the specified number of cryptographically secure random bytes.
- @discussion The random bytes are generated using SecRandomCopyBytes(). 
+ @discussion The random bytes are generated using the default crypto provider.
  @param dataLength The number of random bytes to be generated
  @return A newly initialized data object containing the specified number of random bytes
  */
@@ -51,12 +114,21 @@ extern NSString *const PGCommonCryptoErrorDomain;
 
 /*!
  @abstract Constructs and returns a data object containing the specified number of cryptographically secure random bytes.
- @discussion The random bytes are generated using SecRandomCopyBytes().
+ @discussion The random bytes are generated using the default crypto provider.
  @param dataLength The number of random bytes to be generated
  @return A newly initialized data object containing the specified number of random bytes
  */
 + (NSData *)randomDataOfLength:(NSUInteger)dataLength;
 
+/*!
+ @abstract Fills the specified buffer with cryptographically secure random bytes.
+ @discussion The random bytes are generated using the default crypto provider. Nothing is allocated.
+ @param buffer The buffer to fill. May only be NULL if length is 0.
+ @param length The number of random bytes to generate.
+ @return Whether the bytes were generated.
+ */
++ (BOOL)getRandomBytes:(void *)buffer length:(size_t)length;
+
 /*!
  @abstract Generates a password using cryptographically secure random byte generation.
  @discussion The password is generated by randomly generating 16 bytes of data, which is then converted into a 32 character string. 16 bytes of random
@@ -102,10 +174,90 @@ extern NSString *const PGCommonCryptoErrorDomain;
  */
 - (NSData *)SHA512Digest;
 
+/*!
+ @abstract Writes the digest of the receiver using the specified algorithm into a buffer.
+ @discussion Unlike the methods that return a digest, this allocates nothing, which matters when hashing at a high rate.
+ @param digest The buffer into which to write the digest. Must have room for PGCryptoDigestLength(algorithm) bytes.
+ @param algorithm The digest algorithm.
+ */
+- (void)getDigest:(void *)digest usingAlgorithm:(PGCryptoDigestAlgorithm)algorithm;
+
+/*!
+ @abstract Returns the HMAC-SHA256 of the receiver using the specified key.
+ @param key The key to use. May not be nil.
+ @return The HMAC-SHA256 of the receiver
+ */
+- (NSData *)HMACSHA256DigestWithKey:(NSData *)key;
+
+/*!
+ @abstract Writes the HMAC-SHA256 of the receiver using the specified key into a buffer.
+ @discussion Nothing is allocated. The key may be in memory allocated with PGKeyArenaAllocate.
+ @param digest The buffer into which to write the HMAC. Must have room for PGCryptoHMACSHA256Length bytes.
+ @param key The key to use. May only be NULL if keyLength is 0.
+ @param keyLength The length of the key.
+ */
+- (void)getHMACSHA256Digest:(void *)digest withKeyBytes:(const void *)key length:(size_t)keyLength;
+
+/*!
+ @abstract Returns whether the receiver's contents are equal to those of another data object.
+ @discussion Unlike -isEqualToData:, the time this method takes depends only on the length of the data, not on its contents. Use it to compare
+     digests and other secret-dependent values.
+ 
+ @param otherData The data object with which to compare the receiver.
+ @return Whether the receiver and otherData have the same length and contents.
+ */
+- (BOOL)isEqualToDataInConstantTime:(NSData *)otherData;
+
+/*!
+ @abstract Constructs and returns a randomly generated key suitable for use with the symmetric key encryption methods.
+ @return A randomly generated AES-256 key
+ */
++ (NSData *)randomSymmetricKey;
+
+/*!
+ @abstract Returns the number of key derivation rounds that takes roughly 100ms for a password of the specified length on this machine.
+ @discussion Calibration itself takes time, so callers that encrypt many values with passwords of similar length can calibrate once and pass
+     the result to -encryptedDataWithPassword:salt:rounds:initializationVector:error: via roundsOut.
+ @param passwordLength The length of the password in characters.
+ @return The calibrated number of rounds.
+ */
++ (NSNumber *)calibratedRoundsForPasswordLength:(NSUInteger)passwordLength;
+
+/*!
+ @abstract Returns key derivation parameters with which deriving a key from a password of the specified length takes roughly 100ms on this
+     machine.
+ @discussion For scrypt, the time is wall-clock time with all the lanes running concurrently, so more lanes on a machine with more cores 
+     means more work for an attacker in the same time. The memory that scrypt uses is limited to 128 MB across all lanes; on machines fast 
+     enough to reach that limit, derivation takes less than 100ms. Splitting that limit across many lanes would leave each lane too little 
+     memory to resist hardware attacks, so no more than PGScryptMaximumDefaultLanes lanes are used by default, and the cost is never less than
+     PGScryptMinimumCalibratedCost. With more lanes than that, the total memory exceeds 128 MB rather than each lane getting less, and on slow
+     machines derivation may take longer than 100ms. As with +calibratedRoundsForPasswordLength:, callers that encrypt many 
+     values can calibrate once and pass the result to 
+     -encryptedDataWithPassword:algorithm:associatedData:keyDerivationParameters:salt:initializationVector:error:.
+ @param algorithm The key derivation algorithm.
+ @param lanes The number of lanes for scrypt. Ignored for PBKDF2. If 0, the number of active processors is used, up to 
+     PGScryptMaximumDefaultLanes.
+ @param passwordLength The length of the password in characters.
+ @return The calibrated parameters.
+ */
++ (PGKeyDerivationParameters)calibratedKeyDerivationParametersForAlgorithm:(PGKeyDerivationAlgorithm)algorithm 
+                                                                     lanes:(uint32_t)lanes 
+                                                            passwordLength:(NSUInteger)passwordLength;
+
+/*!
+ @abstract Returns whether the default crypto provider supports the specified encryption algorithm.
+ @discussion PGAES256CBCEncryptionAlgorithm is always supported. PGAES256GCMEncryptionAlgorithm requires the OpenSSL provider, as the 
+     CommonCrypto provider doesn't support GCM.
+ @param algorithm The encryption algorithm.
+ @return Whether data can be encrypted and decrypted with the algorithm.
+ */
++ (BOOL)isEncryptionAlgorithmAvailable:(PGEncryptionAlgorithm)algorithm;
+
 /*!
  @abstract Constructs a new data object containing the receiver's data encrypted using the AES-256 symmetric key encryption algorithm.
  @discussion Encryption is done by first deriving a symmetric key using the provided password, a randomly generated salt, and a number of rounds. The 
-     number of rounds is chosen such that symmetric key derivation will take 100ms, thus introducing a penalty for attempting to guess a password. After 
+     number of rounds is chosen such that symmetric key derivation will take 100ms, thus introducing a penalty for attempting to guess a password,
+     unless a rounds value is passed in via roundsOut. After 
      the symmetric key has been derived, it is used with a randomly generated initialization vector to encrypt the receiver's data. 
  
      In order to subsequently decrypt the result of this method, you must use the same password, salt, rounds value, and initialization vector. As such,
@@ -114,8 +266,8 @@ extern NSString *const PGCommonCryptoErrorDomain;
  @param password The password to use to encrypt the data. May not be nil.
  @param saltOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated salt used during symmetric
      key derivation. May not be NULL.
- @param roundsOut On input, a pointer to an NSNumber object. Upon successful completion, points to the rounds value used during symmetric key 
-     derivation. May not be NULL.
+ @param roundsOut On input, a pointer to an NSNumber object. If that object is not nil, its value is used as the rounds value instead of 
+     calibrating one. Upon successful completion, points to the rounds value used during symmetric key derivation. May not be NULL.
  @param initializationVectorOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated initialization
      vector used during encryption. May not be NULL.
  @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
@@ -152,6 +304,531 @@ extern NSString *const PGCommonCryptoErrorDomain;
                  initializationVector:(NSData *)initializationVector 
                                 error:(NSError **)errorOut;
 
+/*!
+ @abstract Constructs a new data object containing the receiver's data encrypted with a key derived from a password using the specified algorithm.
+ @discussion This is like -encryptedDataWithPassword:salt:rounds:initializationVector:error:, except that the algorithm can be chosen and, with
+     PGAES256GCMEncryptionAlgorithm, associated data can be authenticated along with the receiver's data. Associated data isn't encrypted or 
+     included in the result, but the same associated data must be supplied to decrypt it. It is typically used to bind the ciphertext to its 
+     context, e.g., the name of the user whose secret it is, so that it can't be moved elsewhere undetected.
+ 
+ @param password The password to use to encrypt the data. May not be nil.
+ @param algorithm The encryption algorithm to use.
+ @param associatedData The data to authenticate along with the receiver's data. Must be nil unless algorithm is PGAES256GCMEncryptionAlgorithm.
+ @param saltOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated salt used during symmetric
+     key derivation. May not be NULL.
+ @param roundsOut On input, a pointer to an NSNumber object. If that object is not nil, its value is used as the rounds value instead of 
+     calibrating one. Upon successful completion, points to the rounds value used during symmetric key derivation. May not be NULL.
+ @param initializationVectorOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated initialization
+     vector used during encryption. May not be NULL.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return A new data object containing the receiver's data encrypted with the specified algorithm.
+ */
+- (NSData *)encryptedDataWithPassword:(NSString *)password 
+                            algorithm:(PGEncryptionAlgorithm)algorithm
+                       associatedData:(NSData *)associatedData
+                                 salt:(NSData **)saltOut
+                               rounds:(NSNumber **)roundsOut
+                 initializationVector:(NSData **)initializationVectorOut 
+                                error:(NSError **)errorOut;
+
+/*!
+ @abstract Constructs a new data object containing the receiver's data decrypted with a key derived from a password using the specified algorithm.
+ @discussion With PGAES256GCMEncryptionAlgorithm, decryption fails with kCCDecodeError unless the password, salt, rounds value, initialization
+     vector, associated data, and the receiver's data are all exactly the same as when it was encrypted.
+ 
+ @param password The password to use to decrypt the data. May not be nil.
+ @param algorithm The encryption algorithm that was used to encrypt the data.
+ @param associatedData The associated data that was supplied when encrypting the data. Must be nil unless algorithm is 
+     PGAES256GCMEncryptionAlgorithm.
+ @param salt The randomly generated salt used to generate the symmetric encryption key. May not be nil.
+ @param rounds The rounds value used to generate the symmetric encryption key. May not be nil.
+ @param initializationVector The randomly generated initialization vector used to encrypt the data. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return A new data object containing the receiver's data decrypted with the specified algorithm.
+ */
+- (NSData *)decryptedDataWithPassword:(NSString *)password 
+                            algorithm:(PGEncryptionAlgorithm)algorithm
+                       associatedData:(NSData *)associatedData
+                                 salt:(NSData *)salt 
+                               rounds:(NSNumber *)rounds
+                 initializationVector:(NSData *)initializationVector 
+                                error:(NSError **)errorOut;
+
+/*!
+ @abstract Constructs a new data object containing the receiver's data encrypted with a key derived from a password with the specified key 
+     derivation parameters.
+ @discussion This is like -encryptedDataWithPassword:algorithm:associatedData:salt:rounds:initializationVector:error:, except that the key
+     derivation algorithm and its parameters can be chosen. PGPBKDF2KeyDerivationAlgorithm derives the same key as the methods that take a 
+     rounds value.
+ 
+ @param password The password to use to encrypt the data. May not be nil.
+ @param algorithm The encryption algorithm to use.
+ @param associatedData The data to authenticate along with the receiver's data. Must be nil unless algorithm is PGAES256GCMEncryptionAlgorithm.
+ @param parametersInOut On input, the key derivation parameters to use. If their rounds value is 0, the rest are calibrated for their 
+     algorithm and lanes. Upon successful completion, contains the parameters that were used. May not be NULL.
+ @param saltOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated salt used during symmetric
+     key derivation. May not be NULL.
+ @param initializationVectorOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated initialization
+     vector used during encryption. May not be NULL.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return A new data object containing the receiver's data encrypted with the specified algorithm.
+ */
+- (NSData *)encryptedDataWithPassword:(NSString *)password 
+                            algorithm:(PGEncryptionAlgorithm)algorithm
+                       associatedData:(NSData *)associatedData
+              keyDerivationParameters:(PGKeyDerivationParameters *)parametersInOut
+                                 salt:(NSData **)saltOut
+                 initializationVector:(NSData **)initializationVectorOut 
+                                error:(NSError **)errorOut;
+
+/*!
+ @abstract Constructs a new data object containing the receiver's data decrypted with a key derived from a password with the specified key 
+     derivation parameters.
+ 
+ @param password The password to use to decrypt the data. May not be nil.
+ @param algorithm The encryption algorithm that was used to encrypt the data.
+ @param associatedData The associated data that was supplied when encrypting the data. Must be nil unless algorithm is 
+     PGAES256GCMEncryptionAlgorithm.
+ @param parameters The key derivation parameters that were used to encrypt the data.
+ @param salt The randomly generated salt used to generate the symmetric encryption key. May not be nil.
+ @param initializationVector The randomly generated initialization vector used to encrypt the data. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return A new data object containing the receiver's data decrypted with the specified algorithm.
+ */
+- (NSData *)decryptedDataWithPassword:(NSString *)password 
+                            algorithm:(PGEncryptionAlgorithm)algorithm
+                       associatedData:(NSData *)associatedData
+              keyDerivationParameters:(PGKeyDerivationParameters)parameters
+                                 salt:(NSData *)salt 
+                 initializationVector:(NSData *)initializationVector 
+                                error:(NSError **)errorOut;
+
+/*!
+ @abstract Constructs a new data object containing the receiver's data encrypted with the specified AES-256 key.
+ @discussion Unlike -encryptedDataWithPassword:salt:rounds:initializationVector:error:, no key derivation is performed, so the key itself must have 
+     enough entropy to resist guessing. Keys generated with +randomSymmetricKey are suitable. The initialization vector is randomly generated and 
+     returned indirectly.
+ 
+ @param symmetricKey The AES-256 key to use. May not be nil.
+ @param initializationVectorOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated initialization
+     vector used during encryption. May not be NULL.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return A new data object containing the receiver's data encrypted with AES-256 encryption.
+ */
+- (NSData *)encryptedDataWithSymmetricKey:(NSData *)symmetricKey 
+                     initializationVector:(NSData **)initializationVectorOut 
+                                    error:(NSError **)errorOut;
+
+/*!
+ @abstract Constructs a new data object containing the receiver's data decrypted with the specified AES-256 key.
+ 
+ @param symmetricKey The AES-256 key that was used to encrypt the data. May not be nil.
+ @param initializationVector The initialization vector used to encrypt the data. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return A new data object containing the receiver's data decrypted using AES-256 encryption.
+ */
+- (NSData *)decryptedDataWithSymmetricKey:(NSData *)symmetricKey 
+                     initializationVector:(NSData *)initializationVector 
+                                    error:(NSError **)errorOut;
+
+/*!
+ @abstract Constructs a new data object containing the receiver's data encrypted with the specified AES-256 key and algorithm.
+ @discussion See -encryptedDataWithPassword:algorithm:associatedData:salt:rounds:initializationVector:error: for a description of associated
+     data. The initialization vector is randomly generated and returned indirectly.
+ 
+ @param symmetricKey The AES-256 key to use. May not be nil.
+ @param algorithm The encryption algorithm to use.
+ @param associatedData The data to authenticate along with the receiver's data. Must be nil unless algorithm is PGAES256GCMEncryptionAlgorithm.
+ @param initializationVectorOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated initialization
+     vector used during encryption. May not be NULL.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return A new data object containing the receiver's data encrypted with the specified algorithm.
+ */
+- (NSData *)encryptedDataWithSymmetricKey:(NSData *)symmetricKey 
+                                algorithm:(PGEncryptionAlgorithm)algorithm
+                           associatedData:(NSData *)associatedData
+                     initializationVector:(NSData **)initializationVectorOut 
+                                    error:(NSError **)errorOut;
+
+/*!
+ @abstract Constructs a new data object containing the receiver's data decrypted with the specified AES-256 key and algorithm.
+ 
+ @param symmetricKey The AES-256 key that was used to encrypt the data. May not be nil.
+ @param algorithm The encryption algorithm that was used to encrypt the data.
+ @param associatedData The associated data that was supplied when encrypting the data. Must be nil unless algorithm is 
+     PGAES256GCMEncryptionAlgorithm.
+ @param initializationVector The initialization vector used to encrypt the data. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return A new data object containing the receiver's data decrypted with the specified algorithm.
+ */
+- (NSData *)decryptedDataWithSymmetricKey:(NSData *)symmetricKey 
+                                algorithm:(PGEncryptionAlgorithm)algorithm
+                           associatedData:(NSData *)associatedData
+                     initializationVector:(NSData *)initializationVector 
+                                    error:(NSError **)errorOut;
+
+/*!
+ @abstract Derives a symmetric key from the specified password into a buffer.
+ @discussion The key is derived exactly as in -encryptedDataWithPassword:salt:rounds:initializationVector:error:, so it can be used with the 
+     symmetric key methods to decrypt data encrypted with a password. Allocate the buffer with PGKeyArenaAllocate so that the key is never 
+     swapped out and is zeroed when released. Unlike the password methods, this never calibrates the number of rounds.
+ 
+ @param symmetricKey The buffer into which to write the key. Must have room for PGSymmetricKeyLength bytes.
+ @param password The password from which to derive the key. May not be nil.
+ @param salt The salt to use. May not be nil.
+ @param rounds The number of rounds of key derivation. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the key was derived.
+ */
++ (BOOL)getSymmetricKey:(void *)symmetricKey 
+            forPassword:(NSString *)password 
+                   salt:(NSData *)salt 
+                 rounds:(NSNumber *)rounds 
+                  error:(NSError **)errorOut;
+
+/*!
+ @abstract Derives a symmetric key from the specified password into a buffer with the specified key derivation parameters.
+ @discussion This is like +getSymmetricKey:forPassword:salt:rounds:error:, except that the key derivation algorithm and its parameters can be 
+     chosen. The parameters are never calibrated.
+ 
+ @param symmetricKey The buffer into which to write the key. Must have room for PGSymmetricKeyLength bytes.
+ @param password The password from which to derive the key. May not be nil.
+ @param salt The salt to use. May not be nil.
+ @param parameters The key derivation parameters.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the key was derived. If the parameters are invalid or would need too much memory, the error's code is PGCryptoParameterError.
+ */
++ (BOOL)getSymmetricKey:(void *)symmetricKey 
+            forPassword:(NSString *)password 
+                   salt:(NSData *)salt 
+keyDerivationParameters:(PGKeyDerivationParameters)parameters 
+                  error:(NSError **)errorOut;
+
+/*!
+ @abstract Returns the length of the initialization vectors used with the specified algorithm.
+ @param algorithm The encryption algorithm.
+ @return The initialization vector length in bytes.
+ */
++ (size_t)initializationVectorLengthForAlgorithm:(PGEncryptionAlgorithm)algorithm;
+
+/*!
+ @abstract Returns the number of bytes that encrypting the specified number of bytes with the specified algorithm produces.
+ @param length The number of bytes to be encrypted.
+ @param algorithm The encryption algorithm.
+ @return The length of the encrypted bytes, including padding or the authentication tag.
+ */
++ (size_t)encryptedLengthForLength:(size_t)length algorithm:(PGEncryptionAlgorithm)algorithm;
+
+/*!
+ @abstract Encrypts the receiver's data into a buffer with the specified AES key, algorithm, and initialization vector.
+ @discussion This is the buffer-in, buffer-out counterpart of -encryptedDataWithSymmetricKey:algorithm:associatedData:initializationVector:error:.
+     It allocates nothing unless an error occurs, and the key may be in memory allocated with PGKeyArenaAllocate. Because the caller supplies the 
+     initialization vector, the caller is responsible for making it random, e.g., with +getRandomBytes:length:. A GCM initialization vector must
+     never be used twice with the same key.
+ 
+ @param outputBuffer The buffer into which to write the encrypted bytes. May not be NULL.
+ @param capacity The size of outputBuffer. Must be at least +encryptedLengthForLength:algorithm: of the receiver's length.
+ @param lengthOut On return, the number of bytes written to outputBuffer. May not be NULL.
+ @param symmetricKey The AES key to use. May not be NULL.
+ @param keyLength The length of the key, which must be a valid AES key length.
+ @param algorithm The encryption algorithm.
+ @param associatedData Additional data to authenticate but not encrypt. Must be nil unless algorithm is PGAES256GCMEncryptionAlgorithm.
+ @param initializationVector The initialization vector, which must be +initializationVectorLengthForAlgorithm: bytes long. May not be NULL.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the data was encrypted.
+ */
+- (BOOL)getEncryptedBytes:(void *)outputBuffer
+                 capacity:(size_t)capacity
+                   length:(size_t *)lengthOut
+             symmetricKey:(const void *)symmetricKey
+                keyLength:(size_t)keyLength
+                algorithm:(PGEncryptionAlgorithm)algorithm
+           associatedData:(NSData *)associatedData
+     initializationVector:(const void *)initializationVector
+                    error:(NSError **)errorOut;
+
+/*!
+ @abstract Decrypts the receiver's data into a buffer with the specified AES key, algorithm, and initialization vector.
+ @discussion This is the buffer-in, buffer-out counterpart of -decryptedDataWithSymmetricKey:algorithm:associatedData:initializationVector:error:.
+     It allocates nothing unless an error occurs, and the key may be in memory allocated with PGKeyArenaAllocate. Decryption never produces more
+     bytes than the receiver's length, so a buffer that large always suffices.
+ 
+ @param outputBuffer The buffer into which to write the decrypted bytes. May not be NULL.
+ @param capacity The size of outputBuffer.
+ @param lengthOut On return, the number of bytes written to outputBuffer. May not be NULL.
+ @param symmetricKey The AES key that was used to encrypt the data. May not be NULL.
+ @param keyLength The length of the key.
+ @param algorithm The algorithm that was used to encrypt the data.
+ @param associatedData The associated data that was authenticated when the data was encrypted. Must be nil unless algorithm is
+     PGAES256GCMEncryptionAlgorithm.
+ @param initializationVector The initialization vector that was used to encrypt the data, which must be 
+     +initializationVectorLengthForAlgorithm: bytes long. May not be NULL.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the data was decrypted. If the buffer is too small, the error's code is PGCryptoBufferTooSmallError.
+ */
+- (BOOL)getDecryptedBytes:(void *)outputBuffer
+                 capacity:(size_t)capacity
+                   length:(size_t *)lengthOut
+             symmetricKey:(const void *)symmetricKey
+                keyLength:(size_t)keyLength
+                algorithm:(PGEncryptionAlgorithm)algorithm
+           associatedData:(NSData *)associatedData
+     initializationVector:(const void *)initializationVector
+                    error:(NSError **)errorOut;
+
+/*!
+ @abstract Encrypts the contents of one file descriptor into another using AES-256 in GCM mode.
+ @discussion This invokes +encryptFileDescriptor:toFileDescriptor:password:algorithm:salt:rounds:initializationVector:error: with 
+     PGAES256GCMEncryptionAlgorithm. If GCM isn't available, it fails with kCCUnimplemented.
+ 
+ @param inputFileDescriptor The file descriptor from which to read the data to encrypt.
+ @param outputFileDescriptor The file descriptor to which the encrypted data is written.
+ @param password The password to use to encrypt the data. May not be nil.
+ @param saltOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated salt used during symmetric
+     key derivation. May not be NULL.
+ @param roundsOut On input, a pointer to an NSNumber object. Upon successful completion, points to the rounds value used during symmetric key 
+     derivation. May not be NULL.
+ @param initializationVectorOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated initialization
+     vector used during encryption. May not be NULL.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the data was successfully encrypted and written.
+ */
++ (BOOL)encryptFileDescriptor:(int)inputFileDescriptor
+             toFileDescriptor:(int)outputFileDescriptor
+                     password:(NSString *)password
+                         salt:(NSData **)saltOut
+                       rounds:(NSNumber **)roundsOut
+         initializationVector:(NSData **)initializationVectorOut
+                        error:(NSError **)errorOut;
+
+/*!
+ @abstract Decrypts the contents of one file descriptor into another using AES-256 in GCM mode.
+ @discussion This invokes +decryptFileDescriptor:toFileDescriptor:password:algorithm:salt:rounds:initializationVector:error: with 
+     PGAES256GCMEncryptionAlgorithm.
+ 
+ @param inputFileDescriptor The file descriptor from which to read the data to decrypt.
+ @param outputFileDescriptor The file descriptor to which the decrypted data is written.
+ @param password The password that was used to encrypt the data. May not be nil.
+ @param salt The randomly generated salt used to generate the symmetric encryption key. May not be nil.
+ @param rounds The rounds value used to generate the symmetric encryption key. May not be nil.
+ @param initializationVector The randomly generated initialization vector used to encrypt the data. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the data was successfully decrypted and written.
+ */
++ (BOOL)decryptFileDescriptor:(int)inputFileDescriptor
+             toFileDescriptor:(int)outputFileDescriptor
+                     password:(NSString *)password
+                         salt:(NSData *)salt
+                       rounds:(NSNumber *)rounds
+         initializationVector:(NSData *)initializationVector
+                        error:(NSError **)errorOut;
+
+/*!
+ @abstract Encrypts the contents of one file descriptor into another using the specified algorithm.
+ @discussion The data is streamed through a small, fixed-size ring of buffers instead of being held in memory all at once. Reading from the input 
+     file descriptor happens concurrently with encryption and writing, so throughput is limited by the cipher rather than by I/O or memory 
+     allocation. The symmetric key is derived once for the entire stream. With PGAES256CBCEncryptionAlgorithm, the output is exactly that of 
+     -encryptedDataWithPassword:salt:rounds:initializationVector:error:. With PGAES256GCMEncryptionAlgorithm, it is a sequence of authenticated 
+     chunks, as described in PGStreamCryptor.
+
+     Data is read from the input file descriptor's current offset until end-of-file. Neither file descriptor is closed.
+ 
+ @param inputFileDescriptor The file descriptor from which to read the data to encrypt.
+ @param outputFileDescriptor The file descriptor to which the encrypted data is written.
+ @param password The password to use to encrypt the data. May not be nil.
+ @param algorithm The encryption algorithm to use.
+ @param saltOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated salt used during symmetric
+     key derivation. May not be NULL.
+ @param roundsOut On input, a pointer to an NSNumber object. Upon successful completion, points to the rounds value used during symmetric key 
+     derivation. May not be NULL.
+ @param initializationVectorOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated initialization
+     vector used during encryption. May not be NULL.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the data was successfully encrypted and written.
+ */
++ (BOOL)encryptFileDescriptor:(int)inputFileDescriptor
+             toFileDescriptor:(int)outputFileDescriptor
+                     password:(NSString *)password
+                    algorithm:(PGEncryptionAlgorithm)algorithm
+                         salt:(NSData **)saltOut
+                       rounds:(NSNumber **)roundsOut
+         initializationVector:(NSData **)initializationVectorOut
+                        error:(NSError **)errorOut;
+
+/*!
+ @abstract Decrypts the contents of one file descriptor into another using the specified algorithm.
+ @discussion This is the streaming counterpart of -decryptedDataWithPassword:algorithm:associatedData:salt:rounds:initializationVector:error:. See 
+     +encryptFileDescriptor:toFileDescriptor:password:algorithm:salt:rounds:initializationVector:error: for details on how data is streamed. 
+     With PGAES256GCMEncryptionAlgorithm, each chunk is authenticated before any of its plaintext is written, and decryption fails with 
+     kCCDecodeError as soon as a chunk has been modified, reordered, or removed, or if the stream has been truncated or extended. The output 
+     written before the failure is authentic, but incomplete.
+ 
+ @param inputFileDescriptor The file descriptor from which to read the data to decrypt.
+ @param outputFileDescriptor The file descriptor to which the decrypted data is written.
+ @param password The password that was used to encrypt the data. May not be nil.
+ @param algorithm The encryption algorithm that was used to encrypt the data.
+ @param salt The randomly generated salt used to generate the symmetric encryption key. May not be nil.
+ @param rounds The rounds value used to generate the symmetric encryption key. May not be nil.
+ @param initializationVector The randomly generated initialization vector used to encrypt the data. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the data was successfully decrypted and written.
+ */
++ (BOOL)decryptFileDescriptor:(int)inputFileDescriptor
+             toFileDescriptor:(int)outputFileDescriptor
+                     password:(NSString *)password
+                    algorithm:(PGEncryptionAlgorithm)algorithm
+                         salt:(NSData *)salt
+                       rounds:(NSNumber *)rounds
+         initializationVector:(NSData *)initializationVector
+                        error:(NSError **)errorOut;
+
+/*!
+ @abstract Encrypts the file at one path into a new file at another path using AES-256 in GCM mode.
+ @discussion This invokes +encryptFileAtPath:toPath:password:algorithm:salt:rounds:initializationVector:error: with 
+     PGAES256GCMEncryptionAlgorithm.
+ 
+ @param inputPath The path of the file to encrypt. May not be nil.
+ @param outputPath The path at which to write the encrypted file. May not be nil.
+ @param password The password to use to encrypt the data. May not be nil.
+ @param saltOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated salt. May not be NULL.
+ @param roundsOut On input, a pointer to an NSNumber object. Upon successful completion, points to the rounds value. May not be NULL.
+ @param initializationVectorOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated initialization
+     vector. May not be NULL.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the file was successfully encrypted.
+ */
++ (BOOL)encryptFileAtPath:(NSString *)inputPath
+                   toPath:(NSString *)outputPath
+                 password:(NSString *)password
+                     salt:(NSData **)saltOut
+                   rounds:(NSNumber **)roundsOut
+     initializationVector:(NSData **)initializationVectorOut
+                    error:(NSError **)errorOut;
+
+/*!
+ @abstract Decrypts the file at one path into a new file at another path using AES-256 in GCM mode.
+ @discussion This invokes +decryptFileAtPath:toPath:password:algorithm:salt:rounds:initializationVector:error: with 
+     PGAES256GCMEncryptionAlgorithm.
+ 
+ @param inputPath The path of the file to decrypt. May not be nil.
+ @param outputPath The path at which to write the decrypted file. May not be nil.
+ @param password The password that was used to encrypt the data. May not be nil.
+ @param salt The randomly generated salt used to generate the symmetric encryption key. May not be nil.
+ @param rounds The rounds value used to generate the symmetric encryption key. May not be nil.
+ @param initializationVector The randomly generated initialization vector used to encrypt the data. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the file was successfully decrypted.
+ */
++ (BOOL)decryptFileAtPath:(NSString *)inputPath
+                   toPath:(NSString *)outputPath
+                 password:(NSString *)password
+                     salt:(NSData *)salt
+                   rounds:(NSNumber *)rounds
+     initializationVector:(NSData *)initializationVector
+                    error:(NSError **)errorOut;
+
+/*!
+ @abstract Encrypts the file at one path into a new file at another path using the specified algorithm.
+ @discussion The output file is created with owner-only permissions, replacing any existing file. If encryption fails, the partially written output
+     file is removed. See +encryptFileDescriptor:toFileDescriptor:password:algorithm:salt:rounds:initializationVector:error: for more 
+     information.
+ 
+ @param inputPath The path of the file to encrypt. May not be nil.
+ @param outputPath The path at which to write the encrypted file. May not be nil.
+ @param password The password to use to encrypt the data. May not be nil.
+ @param algorithm The encryption algorithm to use.
+ @param saltOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated salt. May not be NULL.
+ @param roundsOut On input, a pointer to an NSNumber object. Upon successful completion, points to the rounds value. May not be NULL.
+ @param initializationVectorOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated initialization
+     vector. May not be NULL.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the file was successfully encrypted.
+ */
++ (BOOL)encryptFileAtPath:(NSString *)inputPath
+                   toPath:(NSString *)outputPath
+                 password:(NSString *)password
+                algorithm:(PGEncryptionAlgorithm)algorithm
+                     salt:(NSData **)saltOut
+                   rounds:(NSNumber **)roundsOut
+     initializationVector:(NSData **)initializationVectorOut
+                    error:(NSError **)errorOut;
+
+/*!
+ @abstract Decrypts the file at one path into a new file at another path using the specified algorithm.
+ @discussion The output file is created with owner-only permissions, replacing any existing file. If decryption fails, the partially written output
+     file is removed. See +decryptFileDescriptor:toFileDescriptor:password:algorithm:salt:rounds:initializationVector:error: for more 
+     information.
+ 
+ @param inputPath The path of the file to decrypt. May not be nil.
+ @param outputPath The path at which to write the decrypted file. May not be nil.
+ @param password The password that was used to encrypt the data. May not be nil.
+ @param algorithm The encryption algorithm that was used to encrypt the data.
+ @param salt The randomly generated salt used to generate the symmetric encryption key. May not be nil.
+ @param rounds The rounds value used to generate the symmetric encryption key. May not be nil.
+ @param initializationVector The randomly generated initialization vector used to encrypt the data. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the file was successfully decrypted.
+ */
++ (BOOL)decryptFileAtPath:(NSString *)inputPath
+                   toPath:(NSString *)outputPath
+                 password:(NSString *)password
+                algorithm:(PGEncryptionAlgorithm)algorithm
+                     salt:(NSData *)salt
+                   rounds:(NSNumber *)rounds
+     initializationVector:(NSData *)initializationVector
+                    error:(NSError **)errorOut;
+
+/*!
+ @abstract Constructs and returns a data object containing the bytes represented by the specified hexadecimal string.
+ @discussion The string may contain uppercase or lowercase hexadecimal digits, but must not contain a "0x" prefix, whitespace, or any other 
+     characters. This is the inverse of -hexadecimalString.
+ 
+ @param hexadecimalString The hexadecimal string. May not be nil.
+ 
+ @return A data object containing the bytes represented by the string, or nil if the string is not a valid hexadecimal string.
+ */
++ (NSData *)dataWithHexadecimalString:(NSString *)hexadecimalString;
+
 /*!
  @abstract Returns a representation of the receiver's data as a lowercase hexadecimal string.
  @discussion The string does not contain a "0x" prefix.
@@ -159,4 +836,200 @@ extern NSString *const PGCommonCryptoErrorDomain;
  */
 - (NSString *)hexadecimalString;
 
+/*!
+ @abstract Constructs and returns a data object containing the bytes represented by the specified base64 string.
+ @discussion The string must use the standard base64 alphabet from RFC 4648, be padded to a multiple of 4 characters, and must not contain 
+     whitespace or any other characters. This is the inverse of -base64String.
+ 
+ @param base64String The base64 string. May not be nil.
+ 
+ @return A data object containing the bytes represented by the string, or nil if the string is not a valid base64 string.
+ */
++ (NSData *)dataWithBase64String:(NSString *)base64String;
+
+/*!
+ @abstract Returns a representation of the receiver's data as a padded base64 string using the standard alphabet from RFC 4648.
+ @return A base64 string representation of the receiver's data
+ */
+- (NSString *)base64String;
+
+@end
+
+
+/*!
+ @abstract PGStreamCryptor instances encrypt or decrypt a stream of data one chunk at a time.
+ @discussion A stream cryptor derives its symmetric key once, when it is initialized, and then accepts any number of chunks of input, producing the
+     corresponding output as it goes. After the last chunk of input has been supplied, the stream must be finished, which flushes any buffered data.
+ 
+     With PGAES256GCMEncryptionAlgorithm, which is the default, the plaintext is split into 64 KB chunks, the last of which may be shorter or even
+     empty, and each is sealed separately. A chunk's ciphertext is followed by its 16-byte tag. Its nonce is the stream's initialization vector 
+     with the chunk's index in the stream combined into its last four bytes, and a flag marking whether it is the last chunk is authenticated 
+     along with it. Decryption only releases a chunk's plaintext once its tag has been verified, and fails with kCCDecodeError if a chunk has been
+     modified, reordered, or removed, or if the stream ends without a last chunk or continues after one. A stream may have at most 2^32 chunks.
+ 
+     With PGAES256CBCEncryptionAlgorithm, finishing the stream applies or removes PKCS7 padding, and the output is byte-for-byte compatible with 
+     -encryptedDataWithPassword:salt:rounds:initializationVector:error:. It isn't authenticated.
+ 
+     The buffer-based methods never allocate memory, so a caller can process an arbitrarily large stream using a single, fixed-size output buffer. The
+     required size of that buffer can be determined with -outputLengthForInputLength:final:. 
+ 
+     Stream cryptors are not thread-safe. 
+ */
+@interface PGStreamCryptor : NSObject
+
+/*!
+ @abstract Initializes a newly allocated stream cryptor for encryption with AES-256 in GCM mode.
+ @discussion This invokes -initForEncryptionWithPassword:algorithm:salt:rounds:initializationVector:error: with PGAES256GCMEncryptionAlgorithm.
+ 
+ @param password The password to use to encrypt the data. May not be nil.
+ @param saltOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated salt. May not be NULL.
+ @param roundsOut On input, a pointer to an NSNumber object. Upon successful completion, points to the rounds value. May not be NULL.
+ @param initializationVectorOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated initialization
+     vector. May not be NULL.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return An initialized stream cryptor, or nil if the cryptor could not be created.
+ */
+- (id)initForEncryptionWithPassword:(NSString *)password 
+                               salt:(NSData **)saltOut
+                             rounds:(NSNumber **)roundsOut
+               initializationVector:(NSData **)initializationVectorOut
+                              error:(NSError **)errorOut;
+
+/*!
+ @abstract Initializes a newly allocated stream cryptor for decryption with AES-256 in GCM mode.
+ @discussion This invokes -initForDecryptionWithPassword:algorithm:salt:rounds:initializationVector:error: with PGAES256GCMEncryptionAlgorithm.
+ 
+ @param password The password that was used to encrypt the data. May not be nil.
+ @param salt The randomly generated salt used to generate the symmetric encryption key. May not be nil.
+ @param rounds The rounds value used to generate the symmetric encryption key. May not be nil.
+ @param initializationVector The randomly generated initialization vector used to encrypt the data. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return An initialized stream cryptor, or nil if the cryptor could not be created.
+ */
+- (id)initForDecryptionWithPassword:(NSString *)password 
+                               salt:(NSData *)salt
+                             rounds:(NSNumber *)rounds
+               initializationVector:(NSData *)initializationVector
+                              error:(NSError **)errorOut;
+
+/*!
+ @abstract Initializes a newly allocated stream cryptor for encryption with the specified algorithm.
+ @discussion A salt and initialization vector are randomly generated, and the number of rounds is chosen such that symmetric key derivation takes
+     100ms. All three are returned indirectly, as they are required to decrypt the stream.
+ 
+ @param password The password to use to encrypt the data. May not be nil.
+ @param algorithm The encryption algorithm to use.
+ @param saltOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated salt. May not be NULL.
+ @param roundsOut On input, a pointer to an NSNumber object. Upon successful completion, points to the rounds value. May not be NULL.
+ @param initializationVectorOut On input, a pointer to an NSData object. Upon successful completion, points to the randomly generated initialization
+     vector. May not be NULL.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return An initialized stream cryptor, or nil if the cryptor could not be created.
+ */
+- (id)initForEncryptionWithPassword:(NSString *)password 
+                          algorithm:(PGEncryptionAlgorithm)algorithm
+                               salt:(NSData **)saltOut
+                             rounds:(NSNumber **)roundsOut
+               initializationVector:(NSData **)initializationVectorOut
+                              error:(NSError **)errorOut;
+
+/*!
+ @abstract Initializes a newly allocated stream cryptor for decryption with the specified algorithm.
+ 
+ @param password The password that was used to encrypt the data. May not be nil.
+ @param algorithm The encryption algorithm that was used to encrypt the data.
+ @param salt The randomly generated salt used to generate the symmetric encryption key. May not be nil.
+ @param rounds The rounds value used to generate the symmetric encryption key. May not be nil.
+ @param initializationVector The randomly generated initialization vector used to encrypt the data. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return An initialized stream cryptor, or nil if the cryptor could not be created.
+ */
+- (id)initForDecryptionWithPassword:(NSString *)password 
+                          algorithm:(PGEncryptionAlgorithm)algorithm
+                               salt:(NSData *)salt
+                             rounds:(NSNumber *)rounds
+               initializationVector:(NSData *)initializationVector
+                              error:(NSError **)errorOut;
+
+/*!
+ @abstract Returns the size of the output buffer needed to process the specified amount of input.
+ @param inputLength The number of bytes of input that will be supplied.
+ @param final Whether the output will be produced by finishing the stream rather than by updating it.
+ @return The maximum number of bytes of output that processing inputLength bytes of input can produce.
+ */
+- (size_t)outputLengthForInputLength:(size_t)inputLength final:(BOOL)final;
+
+/*!
+ @abstract Processes a chunk of input, writing any available output into the specified buffer.
+ @discussion Because data is processed in whole blocks, or with GCM, in whole chunks, the amount of output may differ from the amount of input. 
+ 
+ @param bytes The input bytes. May only be NULL if length is 0.
+ @param length The number of input bytes.
+ @param outputBuffer The buffer in which to store the output. May not be NULL.
+ @param capacity The size of outputBuffer. Must be at least [self outputLengthForInputLength:length final:NO].
+ @param outputLengthOut On input, a pointer to a size_t. Upon successful completion, set to the number of bytes written to outputBuffer. May not be NULL.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the input was processed successfully.
+ */
+- (BOOL)updateWithBytes:(const void *)bytes length:(size_t)length outputBuffer:(void *)outputBuffer capacity:(size_t)capacity 
+           outputLength:(size_t *)outputLengthOut error:(NSError **)errorOut;
+
+/*!
+ @abstract Finishes the stream, writing any remaining output into the specified buffer.
+ @discussion After this method is invoked, the receiver may no longer be used. When decrypting, this is where a bad password, corrupted data, 
+     or a truncated stream is typically detected.
+ 
+ @param outputBuffer The buffer in which to store the output. May not be NULL.
+ @param capacity The size of outputBuffer. Must be at least [self outputLengthForInputLength:0 final:YES].
+ @param outputLengthOut On input, a pointer to a size_t. Upon successful completion, set to the number of bytes written to outputBuffer. May not be NULL.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the stream was finished successfully.
+ */
+- (BOOL)finishWithOutputBuffer:(void *)outputBuffer capacity:(size_t)capacity outputLength:(size_t *)outputLengthOut error:(NSError **)errorOut;
+
+/*!
+ @abstract Processes a chunk of input and returns the available output as a new data object.
+ @param data The input data. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ @return The output produced by the input, which may be empty, or nil if an error occurred.
+ */
+- (NSData *)updateWithData:(NSData *)data error:(NSError **)errorOut;
+
+/*!
+ @abstract Finishes the stream and returns any remaining output as a new data object.
+ @discussion After this method is invoked, the receiver may no longer be used.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ @return The remaining output, which may be empty, or nil if an error occurred.
+ */
+- (NSData *)finish:(NSError **)errorOut;
+
+/*!
+ @abstract Reads from one file descriptor until end-of-file, processes the data, and writes the output to another file descriptor.
+ @discussion Data is read into a fixed-size ring of buffers on a background queue while the calling thread processes and writes previously read 
+     buffers, so memory use is constant regardless of the stream's length. The stream is finished once end-of-file is reached, after which the 
+     receiver may no longer be used. Neither file descriptor is closed.
+ 
+ @param inputFileDescriptor The file descriptor from which to read input.
+ @param outputFileDescriptor The file descriptor to which output is written.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the entire stream was processed and written successfully.
+ */
+- (BOOL)processFileDescriptor:(int)inputFileDescriptor toFileDescriptor:(int)outputFileDescriptor error:(NSError **)errorOut;
+
 @end
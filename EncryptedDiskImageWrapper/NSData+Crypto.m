@@ -26,92 +26,432 @@
 
 #import "NSData+Crypto.h"
 
-#import <CommonCrypto/CommonCryptor.h>
-#import <CommonCrypto/CommonDigest.h>
-#import <CommonCrypto/CommonKeyDerivation.h>
-#import <Security/SecRandom.h>
+#import <fcntl.h>
+#import <unistd.h>
+#import <libkern/OSAtomic.h>
+
+#import "PGCodec.h"
+#import "PGCryptoProvider.h"
+#import "PGInstrumentation.h"
+#import "PGKeyArena.h"
+#import "PGScrypt.h"
 
 
 #pragma mark Types, Constants, and Functions
 
 NSString *const PGCommonCryptoErrorDomain = @"com.quantumlenscap.PGCommonCryptoErrorDomain";
 
-/*!
- @abstract Computes and returns the digest of the specified data buffer.
- @discussion digest must be pre-allocated and have enough space to store the digest. Specifically, the size should be one of the
-     digest length constants, whose names take the form CC_<ALGORITHM>_DIGEST_LENGTH, which are defined in CommonCrypto/CommonDigest.h.
-
- @param data The data for which to compute the digest of
- @param dataLength The length (in bytes) of data
- @param digest The buffer in which to store the digest. Should have enough allocated space to store the digest.
- 
- @return The digest of the data in the data buffer.
- */
-typedef unsigned char *CommonCryptoDigestFunction(const void *data, CC_LONG dataLength, unsigned char *digest);
-
-
 /*!
  @abstract The number of random bytes used to generate a password.
  @discussion Note that this is not the length of the password itself.
  */
 static const NSUInteger PGDataCryptoGeneratedPasswordRandomDataLength = 16;
 
-// Key derivation constants
-static const CCPBKDFAlgorithm PGDataCryptoPBKDFAlgorithm = kCCPBKDF2;
-static const CCPseudoRandomAlgorithm PGDataCryptoPBKDFPseudoRandomAlgorithm = kCCPRFHmacAlgSHA256;    
-static const NSUInteger PGDataCryptoPBKDFSaltSize = 24;
+// Key derivation constants. Keys are derived with PBKDF2 and HMAC-SHA256 or with scrypt, which uses at most 128 MB when calibrated.
+static const NSUInteger PGDataCryptoPBKDFSaltSize = PGKeyDerivationSaltLength;
 static const NSUInteger PGDataCryptoPBKDFKeyDerivationTime = 100;
+static const size_t PGDataCryptoScryptCalibrationMemoryLength = 128 * 1024 * 1024;
 
-// Symmetric key encryption/decryption constants
-static const CCAlgorithm PGDataCryptoEncryptionAlgorithm = kCCAlgorithmAES128;
-static const NSUInteger PGDataCryptoSymmetricKeySize = kCCKeySizeAES256;
-static const NSUInteger PGDataCryptoBlockSize = kCCBlockSizeAES128;
+// Symmetric key encryption/decryption constants. Data is encrypted with AES-256 in CBC mode with PKCS #7 padding.
+static const NSUInteger PGDataCryptoSymmetricKeySize = PGSymmetricKeyLength;
+static const NSUInteger PGDataCryptoBlockSize = PGCryptoAESBlockSize;
 static const NSUInteger PGDataCryptoInitializationVectorSize = PGDataCryptoBlockSize;
+static const NSUInteger PGDataCryptoGCMInitializationVectorSize = PGCryptoAESGCMNonceLength;
+static const NSUInteger PGDataCryptoGCMTagSize = PGCryptoAESGCMTagLength;
+
+
+/*!
+ @abstract Returns the size of the initialization vectors used with the specified algorithm.
+ @param algorithm The encryption algorithm.
+ @return The initialization vector size in bytes.
+ */
+static inline NSUInteger PGDataCryptoInitializationVectorSizeForAlgorithm(PGEncryptionAlgorithm algorithm)
+{
+    return algorithm == PGAES256GCMEncryptionAlgorithm ? PGDataCryptoGCMInitializationVectorSize : PGDataCryptoInitializationVectorSize;
+}
+
+
+/*!
+ @abstract Returns key derivation parameters with which deriving a key takes about 100ms on this machine.
+ @param algorithm The key derivation algorithm.
+ @param lanes The number of scrypt lanes, or 0 for one per active processor up to PGScryptMaximumDefaultLanes. Ignored for PBKDF2.
+ @param passwordLength The length of the password in characters.
+ @return The calibrated parameters.
+ */
+static PGKeyDerivationParameters PGDataCryptoCalibratedKeyDerivationParameters(PGKeyDerivationAlgorithm algorithm, uint32_t lanes, 
+                                                                               NSUInteger passwordLength)
+{
+    PGKeyDerivationParameters parameters = { algorithm, 0, 0, 0 };
+    
+    uint64_t calibrationStartTime = PGInstrumentationBeginSpan();
+    if (algorithm == PGScryptKeyDerivationAlgorithm) {
+        parameters.blockSize = PGScryptDefaultBlockSize;
+        parameters.lanes = lanes ? lanes : (uint32_t)MIN([[NSProcessInfo processInfo] activeProcessorCount], PGScryptMaximumDefaultLanes);
+        
+        // Rather than giving each lane less memory as the number of lanes grows, let the total grow past the calibration limit, up to the most 
+        // that a derivation may use
+        uint32_t minimumCost = PGScryptMinimumCalibratedCost;
+        while (minimumCost > PGScryptMinimumCost && 
+               PGScryptMemoryLength(minimumCost, parameters.blockSize, parameters.lanes) > PGScryptMaximumMemoryLength) {
+            minimumCost /= 2;
+        }
+        
+        size_t memoryLength = MAX(PGDataCryptoScryptCalibrationMemoryLength, 
+                                  PGScryptMemoryLength(minimumCost, parameters.blockSize, parameters.lanes));
+        parameters.rounds = MAX(PGScryptCalibrateCost(parameters.blockSize, parameters.lanes, PGDataCryptoPBKDFKeyDerivationTime, memoryLength), 
+                                minimumCost);
+    } else {
+        parameters.rounds = PGCryptoDefaultProvider()->calibrateRounds(passwordLength, PGDataCryptoPBKDFSaltSize, PGDataCryptoSymmetricKeySize, 
+                                                                       PGDataCryptoPBKDFKeyDerivationTime);
+    }
+    
+    PGInstrumentationEndSpan(PGKeyCalibrationSpan, calibrationStartTime);
+    return parameters;
+}
 
 
 /*!
- @abstract Derives a symmetric key for the given password and salt combination.
- @discussion roundsOut may not be NULL. If *roundsOut is nil, this function will determine the appropriate number of rounds
-     that are necessary to derive a key in 100ms, and use that value in key derivation. The value will also be returned indirectly 
-     (and autoreleased) via *roundsOut. If *roundsOut is not nil, its unsigned int value will be used for the number of rounds.
+ @abstract Derives a symmetric key for the given password and salt combination into the specified buffer.
  
  @param password The password to use to derive the symmetric key. May not be nil.
  @param salt The salt to use to derive the symmetric key. May not be nil.
- @param roundsOut A pointer to an NSNumber instance. May not be NULL, though the instance itself may be nil. If it is, returns
-     the number of rounds indirectly. Otherwise, uses the instance's unsigned int value as the rounds value when deriving the key.
+ @param parameters The key derivation parameters.
+ @param symmetricKey The buffer into which to write the key. Must have room for PGDataCryptoSymmetricKeySize bytes. Should be allocated with 
+     PGKeyArenaAllocate.
  
- @return A symmetric key suitiable for use in encrypting data
+ @return The status of the derivation.
  */
-static NSData *PGDataCryptoSymmetricKeyForPassword(NSString *password, NSData *salt, NSNumber **roundsOut) 
+static PGCryptoStatus PGDataCryptoDeriveSymmetricKey(NSString *password, NSData *salt, PGKeyDerivationParameters parameters, void *symmetricKey) 
 {   
     NSCAssert(password, @"nil password");
     NSCAssert(salt, @"nil salt");
-    NSCAssert(roundsOut, @"NULL roundsOut");
+    NSCAssert(symmetricKey, @"NULL symmetric key");
     
-    NSUInteger saltLength = [salt length];
+    const char *passwordBytes = [password UTF8String];
+    PGCryptoStatus result = PGCryptoParameterError;
+    
+    uint64_t derivationStartTime = PGInstrumentationBeginSpan();
+    if (parameters.algorithm == PGScryptKeyDerivationAlgorithm) {
+        result = PGScryptDeriveKey(passwordBytes, strlen(passwordBytes), [salt bytes], [salt length], parameters.rounds, parameters.blockSize, 
+                                   parameters.lanes, symmetricKey, PGDataCryptoSymmetricKeySize);
+    } else if (parameters.algorithm == PGPBKDF2KeyDerivationAlgorithm) {
+        // PBKDF2 has always been given the password's length in characters rather than bytes, and existing keys depend on it
+        result = PGCryptoDefaultProvider()->deriveKey(passwordBytes, [password length], [salt bytes], [salt length], parameters.rounds,
+                                                      symmetricKey, PGDataCryptoSymmetricKeySize);
+    }
+    
+    PGInstrumentationEndSpan(PGKeyDerivationSpan, derivationStartTime);
+    return result;
+}
+
 
-    // *roundsOut points to a valid number, get the number of rounds out of it. Else, figure out the rounds count and return it indirectly.
-    unsigned rounds = 0;
-    if (*roundsOut) {
-        rounds = [*roundsOut unsignedIntValue];
+/*!
+ @abstract Encrypts or decrypts the specified bytes in one shot with AES-CBC using the specified symmetric key and initialization vector.
+ 
+ @param provider The crypto provider to use. May not be NULL.
+ @param operation Either PGCryptoEncrypt or PGCryptoDecrypt.
+ @param symmetricKey The symmetric key to use. May not be NULL.
+ @param keyLength The length of the symmetric key.
+ @param initializationVector The initialization vector to use. Must be PGDataCryptoInitializationVectorSize bytes long.
+ @param input The bytes to encrypt or decrypt. May only be NULL if length is 0.
+ @param length The number of bytes to encrypt or decrypt.
+ @param output The buffer into which to write the output. May not be NULL.
+ @param capacity The size of output.
+ @param outputLengthOut On return, the number of bytes written to output. May not be NULL.
+
+ @return The provider's status.
+ */
+static PGCryptoStatus PGDataCryptoCryptCBC(const PGCryptoProvider *provider, PGCryptoOperation operation, const void *symmetricKey, 
+                                           size_t keyLength, const void *initializationVector, const void *input, size_t length, void *output, 
+                                           size_t capacity, size_t *outputLengthOut)
+{
+    PGCryptoCipherRef cipher = NULL;
+    PGCryptoStatus result = provider->cipherCreate(operation, PGCryptoModeCBC, true, symmetricKey, keyLength, initializationVector, &cipher);
+    if (result != PGCryptoSuccess) return result;
+    
+    size_t updateLength = 0;
+    size_t finalLength = 0;
+    result = provider->cipherUpdate(cipher, input, length, output, capacity, &updateLength);
+    if (result == PGCryptoSuccess) result = provider->cipherFinal(cipher, (uint8_t *)output + updateLength, capacity - updateLength, &finalLength);
+    
+    provider->cipherRelease(cipher);
+    *outputLengthOut = updateLength + finalLength;
+    return result;
+}
+
+
+/*!
+ @abstract Encrypts or decrypts the specified bytes with AES-GCM using the specified symmetric key, initialization vector, and associated data.
+ @discussion Encrypted data is the ciphertext followed by the authentication tag.
+ 
+ @param provider The crypto provider to use. May not be NULL.
+ @param operation Either PGCryptoEncrypt or PGCryptoDecrypt.
+ @param symmetricKey The symmetric key to use. May not be NULL.
+ @param keyLength The length of the symmetric key.
+ @param initializationVector The initialization vector to use. Must be PGDataCryptoGCMInitializationVectorSize bytes long.
+ @param associatedData The associated data to authenticate. May be nil.
+ @param input The bytes to encrypt or decrypt. May only be NULL if length is 0.
+ @param length The number of bytes to encrypt or decrypt.
+ @param output The buffer into which to write the output. May not be NULL.
+ @param capacity The size of output.
+ @param outputLengthOut On return, the number of bytes written to output. May not be NULL.
+ 
+ @return The provider's status.
+ */
+static PGCryptoStatus PGDataCryptoCryptGCM(const PGCryptoProvider *provider, PGCryptoOperation operation, const void *symmetricKey, 
+                                           size_t keyLength, const void *initializationVector, NSData *associatedData, const void *input, 
+                                           size_t length, void *output, size_t capacity, size_t *outputLengthOut)
+{
+    *outputLengthOut = 0;
+    if (operation == PGCryptoEncrypt) {
+        if (capacity < length + PGDataCryptoGCMTagSize) return PGCryptoBufferTooSmallError;
+        
+        PGCryptoStatus result = provider->GCMSeal(symmetricKey, keyLength, initializationVector, [associatedData bytes], [associatedData length], 
+                                                  input, length, output, (uint8_t *)output + length);
+        if (result == PGCryptoSuccess) *outputLengthOut = length + PGDataCryptoGCMTagSize;
+        return result;
+    }
+    
+    // Anything too short to contain a tag can't have been produced by encryption
+    if (length < PGDataCryptoGCMTagSize) return PGCryptoDecodeError;
+    
+    size_t plaintextLength = length - PGDataCryptoGCMTagSize;
+    if (capacity < plaintextLength) return PGCryptoBufferTooSmallError;
+    
+    PGCryptoStatus result = provider->GCMOpen(symmetricKey, keyLength, initializationVector, [associatedData bytes], [associatedData length], 
+                                              input, plaintextLength, (const uint8_t *)input + plaintextLength, output);
+    if (result == PGCryptoSuccess) *outputLengthOut = plaintextLength;
+    return result;
+}
+
+
+/*!
+ @abstract Encrypts or decrypts the specified bytes in one shot into a buffer using the specified algorithm, symmetric key, and initialization 
+     vector.
+ @discussion Nothing is allocated unless an error occurs.
+ 
+ @param operation Either PGCryptoEncrypt or PGCryptoDecrypt.
+ @param algorithm The encryption algorithm.
+ @param symmetricKey The symmetric key to use. May not be NULL.
+ @param keyLength The length of the symmetric key.
+ @param initializationVector The initialization vector to use. May not be NULL.
+ @param initializationVectorLength The length of the initialization vector.
+ @param associatedData The associated data to authenticate. Must be nil unless algorithm is PGAES256GCMEncryptionAlgorithm.
+ @param input The bytes to encrypt or decrypt. May only be NULL if length is 0.
+ @param length The number of bytes to encrypt or decrypt.
+ @param output The buffer into which to write the output. May not be NULL.
+ @param capacity The size of output.
+ @param outputLengthOut On return, the number of bytes written to output. May not be NULL.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+
+ @return Whether the bytes were encrypted or decrypted.
+ */
+static BOOL PGDataCryptoCrypt(PGCryptoOperation operation, PGEncryptionAlgorithm algorithm, const void *symmetricKey, size_t keyLength, 
+                              const void *initializationVector, size_t initializationVectorLength, NSData *associatedData, const void *input, 
+                              size_t length, void *output, size_t capacity, size_t *outputLengthOut, NSError **errorOut)
+{
+    NSCAssert(!associatedData || algorithm == PGAES256GCMEncryptionAlgorithm, @"associated data requires an authenticated algorithm");
+    
+    // The provider reads a whole initialization vector, so make sure there is one
+    if (initializationVectorLength < PGDataCryptoInitializationVectorSizeForAlgorithm(algorithm) || 
+        (algorithm != PGAES256CBCEncryptionAlgorithm && algorithm != PGAES256GCMEncryptionAlgorithm)) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:PGCryptoParameterError userInfo:nil];
+        return NO;
+    }
+    
+    const PGCryptoProvider *provider = PGCryptoDefaultProvider();
+    PGCryptoStatus result = PGCryptoSuccess;
+    
+    uint64_t startTime = PGInstrumentationBeginSpan();
+    if (algorithm == PGAES256GCMEncryptionAlgorithm) {
+        result = PGDataCryptoCryptGCM(provider, operation, symmetricKey, keyLength, initializationVector, associatedData, input, length, output,
+                                      capacity, outputLengthOut);
     } else {
-        rounds = CCCalibratePBKDF(PGDataCryptoPBKDFAlgorithm, [password length], saltLength, PGDataCryptoPBKDFPseudoRandomAlgorithm, 
-                                  PGDataCryptoSymmetricKeySize, PGDataCryptoPBKDFKeyDerivationTime);
-        *roundsOut = [NSNumber numberWithUnsignedInt:rounds];
+        result = PGDataCryptoCryptCBC(provider, operation, symmetricKey, keyLength, initializationVector, input, length, output, capacity, 
+                                      outputLengthOut);
+    }
+    
+    PGInstrumentationEndSpan(PGCryptSpan, startTime);
+    
+    if (result != PGCryptoSuccess) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:result userInfo:nil];
+        return NO;
     }
     
-    // Generate the symmetric key
-    void *symmetricKey = malloc(PGDataCryptoSymmetricKeySize);
-    if (CCKeyDerivationPBKDF(PGDataCryptoPBKDFAlgorithm, [password UTF8String], [password length], [salt bytes], saltLength, 
-                             PGDataCryptoPBKDFPseudoRandomAlgorithm, rounds, symmetricKey, PGDataCryptoSymmetricKeySize) != kCCSuccess) {
-        free(symmetricKey);
+    return YES;
+}
+
+
+/*!
+ @abstract Encrypts or decrypts the specified data in one shot into a new data object using the specified algorithm, symmetric key, and 
+     initialization vector.
+ @discussion The output is allocated once, at its largest possible size. 
+ 
+ @param operation Either PGCryptoEncrypt or PGCryptoDecrypt.
+ @param algorithm The encryption algorithm.
+ @param symmetricKey The symmetric key to use. May not be NULL.
+ @param keyLength The length of the symmetric key.
+ @param initializationVector The initialization vector to use. May not be nil.
+ @param associatedData The associated data to authenticate. Must be nil unless algorithm is PGAES256GCMEncryptionAlgorithm.
+ @param data The data to encrypt or decrypt. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return A new data object containing the encrypted or decrypted data, or nil if an error occurred.
+ */
+static NSData *PGDataCryptoCryptData(PGCryptoOperation operation, PGEncryptionAlgorithm algorithm, const void *symmetricKey, size_t keyLength, 
+                                     NSData *initializationVector, NSData *associatedData, NSData *data, NSError **errorOut)
+{
+    // Decryption never outputs more than its input
+    size_t capacity = operation == PGCryptoEncrypt ? [NSData encryptedLengthForLength:[data length] algorithm:algorithm] : [data length];
+    NSMutableData *outputData = [NSMutableData dataWithLength:capacity];
+    size_t outputLength = 0;
+    if (!PGDataCryptoCrypt(operation, algorithm, symmetricKey, keyLength, [initializationVector bytes], [initializationVector length], 
+                           associatedData, [data bytes], [data length], [outputData mutableBytes], capacity, &outputLength, errorOut)) {
         return nil;
     }
     
-    return [NSData dataWithBytesNoCopy:symmetricKey length:PGDataCryptoSymmetricKeySize];
+    [outputData setLength:outputLength];
+    return outputData;
 }
 
 
+// Streaming constants
+static const size_t PGDataCryptoStreamChunkSize = 256 * 1024;
+static const NSUInteger PGDataCryptoStreamRingSlotCount = 4;
+
+// GCM streams are sealed in chunks of this much plaintext. Each chunk's index is combined into the last four bytes of its nonce, which limits
+// the number of chunks in a stream.
+static const size_t PGDataCryptoGCMStreamChunkSize = 64 * 1024;
+static const uint64_t PGDataCryptoGCMStreamMaximumChunkCount = 1ULL << 32;
+
+
+/*!
+ @abstract Reads from the specified file descriptor until the buffer is full or end-of-file is reached.
+ @discussion Interrupted reads are retried.
+ 
+ @param fileDescriptor The file descriptor to read from.
+ @param buffer The buffer in which to store the data read. May not be NULL.
+ @param capacity The size of buffer.
+ 
+ @return The number of bytes read, which is only less than capacity at end-of-file, or -1 if an error occurred, in which case errno is set.
+ */
+static ssize_t PGDataCryptoReadFully(int fileDescriptor, void *buffer, size_t capacity)
+{
+    size_t totalLength = 0;
+    while (totalLength < capacity) {
+        ssize_t length = read(fileDescriptor, (uint8_t *)buffer + totalLength, capacity - totalLength);
+        if (length == 0) break;
+        if (length < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        
+        totalLength += length;
+    }
+    
+    return totalLength;
+}
+
+
+/*!
+ @abstract Writes the entire contents of the buffer to the specified file descriptor.
+ @discussion Interrupted and partial writes are retried.
+ 
+ @param fileDescriptor The file descriptor to write to.
+ @param buffer The data to write. May only be NULL if length is 0.
+ @param length The number of bytes to write.
+ 
+ @return Whether all the data was written. If not, errno is set.
+ */
+static BOOL PGDataCryptoWriteFully(int fileDescriptor, const void *buffer, size_t length)
+{
+    size_t totalLength = 0;
+    while (totalLength < length) {
+        ssize_t writtenLength = write(fileDescriptor, (const uint8_t *)buffer + totalLength, length - totalLength);
+        if (writtenLength < 0) {
+            if (errno == EINTR) continue;
+            return NO;
+        }
+        
+        totalLength += writtenLength;
+    }
+    
+    return YES;
+}
+
+
+/*!
+ @abstract Returns the characters of the specified string as ASCII.
+ @discussion If the string stores its characters as ASCII, they are returned directly. Otherwise, they are converted into a buffer, which is 
+     returned indirectly and must be kept alive for as long as the characters are used.
+ 
+ @param string The string. May not be nil.
+ @param bufferOut On input, a pointer to a data object. If the characters had to be converted, points to the data object containing them. May not
+     be NULL.
+ 
+ @return The string's ASCII characters, which are not NUL-terminated, or NULL if the string contains non-ASCII characters.
+ */
+static const char *PGDataCryptoASCIICharacters(NSString *string, NSData **bufferOut)
+{
+    NSCAssert(string, @"nil string");
+    NSCAssert(bufferOut, @"NULL bufferOut");
+    
+    const char *characters = CFStringGetCStringPtr((__bridge CFStringRef)string, kCFStringEncodingASCII);
+    if (characters) return characters;
+    
+    NSUInteger length = [string length];
+    NSMutableData *buffer = [NSMutableData dataWithLength:length];
+    NSUInteger usedLength = 0;
+    if (![string getBytes:[buffer mutableBytes] maxLength:length usedLength:&usedLength encoding:NSASCIIStringEncoding options:0 
+                    range:NSMakeRange(0, length) remainingRange:NULL] || usedLength != length) {
+        return NULL;
+    }
+    
+    *bufferOut = buffer;
+    return [buffer bytes];
+}
+
+
+#pragma mark - PGStreamCryptor Private Methods Interface
+
+@interface PGStreamCryptor ()
+
+/*!
+ @abstract Initializes a newly allocated stream cryptor with the specified operation, algorithm, symmetric key, and initialization vector.
+ @discussion This is the designated initializer. The key is copied, either into the provider's cipher or into the key arena, so it may be released
+     as soon as this returns.
+ 
+ @param operation Either PGCryptoEncrypt or PGCryptoDecrypt.
+ @param algorithm The encryption algorithm.
+ @param symmetricKey The symmetric key to use. May not be NULL.
+ @param keyLength The length of the symmetric key.
+ @param initializationVector The initialization vector to use. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return An initialized stream cryptor, or nil if the cryptor could not be created.
+ */
+- (id)initWithOperation:(PGCryptoOperation)operation algorithm:(PGEncryptionAlgorithm)algorithm symmetricKey:(const void *)symmetricKey 
+              keyLength:(size_t)keyLength initializationVector:(NSData *)initializationVector error:(NSError **)errorOut;
+
+/*!
+ @abstract Seals or opens the buffered GCM chunk, writing its output into the specified buffer, and empties the buffer.
+ 
+ @param final Whether the chunk is the last in the stream.
+ @param outputBuffer The buffer in which to store the output. May not be NULL.
+ @param capacity The size of outputBuffer.
+ @param outputLengthOut On input, a pointer to a size_t. Upon successful completion, set to the number of bytes written to outputBuffer. May not be NULL.
+ 
+ @return PGCryptoSuccess if the chunk was processed successfully; PGCryptoDecodeError if it failed to authenticate; or another status otherwise.
+ */
+- (PGCryptoStatus)cryptBufferedChunkAsFinal:(BOOL)final outputBuffer:(void *)outputBuffer capacity:(size_t)capacity 
+                               outputLength:(size_t *)outputLengthOut;
+
+@end
+
+
 #pragma mark
 
 @implementation NSData (Crypto)
@@ -122,7 +462,7 @@ static NSData *PGDataCryptoSymmetricKeyForPassword(NSString *password, NSData *s
 - (id)initWithRandomDataOfLength:(NSUInteger)dataLength
 {
     uint8_t *randomBytes = malloc(dataLength);
-    if (SecRandomCopyBytes(kSecRandomDefault, dataLength, randomBytes) == -1) {
+    if (![NSData getRandomBytes:randomBytes length:dataLength]) {
         free(randomBytes);
         return nil;
     }
@@ -137,6 +477,13 @@ static NSData *PGDataCryptoSymmetricKeyForPassword(NSString *password, NSData *s
 }
 
 
++ (BOOL)getRandomBytes:(void *)buffer length:(size_t)length
+{
+    NSAssert(buffer || length == 0, @"NULL buffer");
+    return PGCryptoDefaultProvider()->randomBytes(buffer, length) == PGCryptoSuccess;
+}
+
+
 #pragma mark Password Generation
 
 + (NSString *)randomlyGeneratedPassword
@@ -147,152 +494,940 @@ static NSData *PGDataCryptoSymmetricKeyForPassword(NSString *password, NSData *s
 
 #pragma mark Digests
 
-- (NSData *)digestUsingCommonCryptoDigestFunction:(CommonCryptoDigestFunction)digestFunction digestLength:(NSUInteger)digestLength
+- (NSData *)digestUsingAlgorithm:(PGCryptoDigestAlgorithm)algorithm
+{
+    NSMutableData *digest = [NSMutableData dataWithLength:PGCryptoDigestLength(algorithm)];
+    [self getDigest:[digest mutableBytes] usingAlgorithm:algorithm];
+    return digest;
+}
+
+
+- (void)getDigest:(void *)digest usingAlgorithm:(PGCryptoDigestAlgorithm)algorithm
 {
-    unsigned char *digestBuffer = malloc(digestLength);
-    digestFunction([self bytes], (unsigned int)[self length], digestBuffer);
-    return [NSData dataWithBytesNoCopy:digestBuffer length:digestLength];
+    NSAssert(digest, @"NULL digest");
+    PGCryptoDefaultProvider()->digest(algorithm, [self bytes], [self length], digest);
 }
 
 
 - (NSData *)MD5Digest
 {
-    return [self digestUsingCommonCryptoDigestFunction:CC_MD5 digestLength:CC_MD5_DIGEST_LENGTH];
+    return [self digestUsingAlgorithm:PGCryptoDigestMD5];
 }
 
 
 - (NSData *)SHA1Digest
 {
-    return [self digestUsingCommonCryptoDigestFunction:CC_SHA1 digestLength:CC_SHA1_DIGEST_LENGTH];
+    return [self digestUsingAlgorithm:PGCryptoDigestSHA1];
 }
 
 
 - (NSData *)SHA224Digest
 {
-    return [self digestUsingCommonCryptoDigestFunction:CC_SHA224 digestLength:CC_SHA224_DIGEST_LENGTH];    
+    return [self digestUsingAlgorithm:PGCryptoDigestSHA224];
 }
 
 
 - (NSData *)SHA256Digest
 {
-    return [self digestUsingCommonCryptoDigestFunction:CC_SHA256 digestLength:CC_SHA256_DIGEST_LENGTH];
+    return [self digestUsingAlgorithm:PGCryptoDigestSHA256];
 }
 
 
 - (NSData *)SHA384Digest 
 {
-    return [self digestUsingCommonCryptoDigestFunction:CC_SHA384 digestLength:CC_SHA384_DIGEST_LENGTH];    
+    return [self digestUsingAlgorithm:PGCryptoDigestSHA384];
 }
 
 
 - (NSData *)SHA512Digest
 {
-    return [self digestUsingCommonCryptoDigestFunction:CC_SHA512 digestLength:CC_SHA512_DIGEST_LENGTH];    
+    return [self digestUsingAlgorithm:PGCryptoDigestSHA512];
+}
+
+
+#pragma mark HMAC
+
+- (NSData *)HMACSHA256DigestWithKey:(NSData *)key
+{
+    NSAssert(key, @"nil key");
+    
+    NSMutableData *digest = [NSMutableData dataWithLength:PGCryptoHMACSHA256Length];
+    [self getHMACSHA256Digest:[digest mutableBytes] withKeyBytes:[key bytes] length:[key length]];
+    return digest;
+}
+
+
+- (void)getHMACSHA256Digest:(void *)digest withKeyBytes:(const void *)key length:(size_t)keyLength
+{
+    NSAssert(digest, @"NULL digest");
+    NSAssert(key || keyLength == 0, @"NULL key");
+    PGCryptoDefaultProvider()->HMACSHA256(key, keyLength, [self bytes], [self length], digest);
+}
+
+
+- (BOOL)isEqualToDataInConstantTime:(NSData *)otherData
+{
+    if ([self length] != [otherData length]) return NO;
+    
+    // Accumulate the differences so that the time taken doesn't depend on where the first difference is
+    const uint8_t *bytes = [self bytes];
+    const uint8_t *otherBytes = [otherData bytes];
+    uint8_t difference = 0;
+    for (NSUInteger i = 0; i < [self length]; ++i) {
+        difference |= bytes[i] ^ otherBytes[i];
+    }
+    
+    return difference == 0;
 }
 
 
 #pragma mark Encryption and Decryption
 
++ (NSData *)randomSymmetricKey
+{
+    return [self randomDataOfLength:PGDataCryptoSymmetricKeySize];
+}
+
+
++ (NSNumber *)calibratedRoundsForPasswordLength:(NSUInteger)passwordLength
+{
+    return [NSNumber numberWithUnsignedInt:PGCryptoDefaultProvider()->calibrateRounds(passwordLength, PGDataCryptoPBKDFSaltSize, 
+                                                                                      PGDataCryptoSymmetricKeySize, 
+                                                                                      PGDataCryptoPBKDFKeyDerivationTime)];
+}
+
+
++ (PGKeyDerivationParameters)calibratedKeyDerivationParametersForAlgorithm:(PGKeyDerivationAlgorithm)algorithm lanes:(uint32_t)lanes 
+                                                            passwordLength:(NSUInteger)passwordLength
+{
+    return PGDataCryptoCalibratedKeyDerivationParameters(algorithm, lanes, passwordLength);
+}
+
+
++ (BOOL)isEncryptionAlgorithmAvailable:(PGEncryptionAlgorithm)algorithm
+{
+    if (algorithm != PGAES256GCMEncryptionAlgorithm) return algorithm == PGAES256CBCEncryptionAlgorithm;
+    
+    // Providers only find out whether they can do GCM when asked to, so seal nothing with a throwaway key
+    uint8_t key[PGSymmetricKeyLength] = { 0 };
+    uint8_t nonce[PGCryptoAESGCMNonceLength] = { 0 };
+    uint8_t tag[PGCryptoAESGCMTagLength];
+    return PGCryptoDefaultProvider()->GCMSeal(key, sizeof(key), nonce, NULL, 0, NULL, 0, NULL, tag) == PGCryptoSuccess;
+}
+
+
 - (NSData *)encryptedDataWithPassword:(NSString *)password salt:(NSData **)saltOut rounds:(NSNumber **)roundsOut
                  initializationVector:(NSData **)initializationVectorOut error:(NSError **)errorOut
+{
+    return [self encryptedDataWithPassword:password algorithm:PGAES256CBCEncryptionAlgorithm associatedData:nil salt:saltOut rounds:roundsOut 
+                      initializationVector:initializationVectorOut error:errorOut];
+}
+
+
+- (NSData *)decryptedDataWithPassword:(NSString *)password salt:(NSData *)salt rounds:(NSNumber *)rounds
+                 initializationVector:(NSData *)initializationVector error:(NSError **)errorOut
+{
+    return [self decryptedDataWithPassword:password algorithm:PGAES256CBCEncryptionAlgorithm associatedData:nil salt:salt rounds:rounds 
+                      initializationVector:initializationVector error:errorOut];
+}
+
+
+- (NSData *)encryptedDataWithPassword:(NSString *)password algorithm:(PGEncryptionAlgorithm)algorithm associatedData:(NSData *)associatedData 
+                                 salt:(NSData **)saltOut rounds:(NSNumber **)roundsOut initializationVector:(NSData **)initializationVectorOut 
+                                error:(NSError **)errorOut
+{
+    NSAssert(roundsOut, @"NULL rounds");
+    
+    PGKeyDerivationParameters parameters = { PGPBKDF2KeyDerivationAlgorithm, [*roundsOut unsignedIntValue], 0, 0 };
+    NSData *encryptedData = [self encryptedDataWithPassword:password algorithm:algorithm associatedData:associatedData 
+                                    keyDerivationParameters:&parameters salt:saltOut initializationVector:initializationVectorOut error:errorOut];
+    if (!encryptedData) return nil;
+    
+    *roundsOut = [NSNumber numberWithUnsignedInt:parameters.rounds];
+    return encryptedData;
+}
+
+
+- (NSData *)decryptedDataWithPassword:(NSString *)password algorithm:(PGEncryptionAlgorithm)algorithm associatedData:(NSData *)associatedData 
+                                 salt:(NSData *)salt rounds:(NSNumber *)rounds initializationVector:(NSData *)initializationVector 
+                                error:(NSError **)errorOut
+{
+    NSAssert(rounds, @"nil rounds");
+    
+    PGKeyDerivationParameters parameters = { PGPBKDF2KeyDerivationAlgorithm, [rounds unsignedIntValue], 0, 0 };
+    return [self decryptedDataWithPassword:password algorithm:algorithm associatedData:associatedData keyDerivationParameters:parameters 
+                                      salt:salt initializationVector:initializationVector error:errorOut];
+}
+
+
+- (NSData *)encryptedDataWithPassword:(NSString *)password algorithm:(PGEncryptionAlgorithm)algorithm associatedData:(NSData *)associatedData 
+              keyDerivationParameters:(PGKeyDerivationParameters *)parametersInOut salt:(NSData **)saltOut 
+                 initializationVector:(NSData **)initializationVectorOut error:(NSError **)errorOut
 {
     NSAssert(password, @"nil password");
+    NSAssert(parametersInOut, @"NULL key derivation parameters");
     NSAssert(saltOut, @"NULL salt");
-    NSAssert(roundsOut, @"NULL rounds");
     NSAssert(initializationVectorOut, @"NULL initialization vector");
 
-    // Generate a symmetric key for the password
+    // Generate a symmetric key for the password. The key only ever lives in the key arena.
     NSData *salt = [NSData randomDataOfLength:PGDataCryptoPBKDFSaltSize];
-    NSNumber *rounds = nil;
-    NSData *symmetricKey = PGDataCryptoSymmetricKeyForPassword(password, salt, &rounds);
+    PGKeyDerivationParameters parameters = *parametersInOut;
+    if (parameters.rounds == 0) {
+        parameters = PGDataCryptoCalibratedKeyDerivationParameters(parameters.algorithm, parameters.lanes, [password length]);
+    }
+    
+    void *symmetricKey = PGKeyArenaAllocate(PGDataCryptoSymmetricKeySize);
+    PGCryptoStatus result = symmetricKey ? PGDataCryptoDeriveSymmetricKey(password, salt, parameters, symmetricKey) : PGCryptoMemoryError;
     
     // Encrypt our data with symmetric key and an initialization vector
-    NSData *initializationVector = [NSData randomDataOfLength:PGDataCryptoInitializationVectorSize];
-    size_t encryptedDataBufferCapacity = [self length] + PGDataCryptoBlockSize;
-    void *encryptedDataBuffer = malloc(encryptedDataBufferCapacity);
-    size_t encryptedDataBufferLength = 0;
-    
-    int result = CCCrypt(kCCEncrypt, PGDataCryptoEncryptionAlgorithm, kCCOptionPKCS7Padding, [symmetricKey bytes], [symmetricKey length], 
-                         [initializationVector bytes], [self bytes], [self length], encryptedDataBuffer, encryptedDataBufferCapacity, 
-                         &encryptedDataBufferLength);
-    
-    // If we didn't have enough space to encrypt, reallocate encrypt to be encryptDataBufferLength bytes and try again
-    if (result == kCCBufferTooSmall) {
-        encryptedDataBufferCapacity = encryptedDataBufferLength;
-        encryptedDataBuffer = realloc(encryptedDataBuffer, encryptedDataBufferCapacity);
-        
-        result = CCCrypt(kCCEncrypt, PGDataCryptoEncryptionAlgorithm, kCCOptionPKCS7Padding, [symmetricKey bytes], [symmetricKey length], 
-                         [initializationVector bytes], [self bytes], [self length], encryptedDataBuffer, encryptedDataBufferCapacity, 
-                         &encryptedDataBufferLength);
+    NSData *initializationVector = [NSData randomDataOfLength:PGDataCryptoInitializationVectorSizeForAlgorithm(algorithm)];
+    NSData *encryptedData = nil;
+    if (result == PGCryptoSuccess) {
+        encryptedData = PGDataCryptoCryptData(PGCryptoEncrypt, algorithm, symmetricKey, PGDataCryptoSymmetricKeySize, initializationVector, 
+                                              associatedData, self, errorOut);
+    } else if (errorOut) {
+        *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:result userInfo:nil];
     }
     
-    if (result != kCCSuccess) {
-        free(encryptedDataBuffer);
+    PGKeyArenaRelease(symmetricKey);
+    if (!encryptedData) return nil;
+    
+    *parametersInOut = parameters;
+    *saltOut = salt;
+    *initializationVectorOut = initializationVector;
+    
+    return encryptedData;
+}
+
+
+- (NSData *)decryptedDataWithPassword:(NSString *)password algorithm:(PGEncryptionAlgorithm)algorithm associatedData:(NSData *)associatedData 
+              keyDerivationParameters:(PGKeyDerivationParameters)parameters salt:(NSData *)salt 
+                 initializationVector:(NSData *)initializationVector error:(NSError **)errorOut
+{
+    NSAssert(password, @"nil password");
+    NSAssert(salt, @"nil salt");
+    NSAssert(initializationVector, @"nil initialization vector");
+    
+    // Get the symmetric key for the password, then decrypt our data with it
+    void *symmetricKey = PGKeyArenaAllocate(PGDataCryptoSymmetricKeySize);
+    PGCryptoStatus result = symmetricKey ? PGDataCryptoDeriveSymmetricKey(password, salt, parameters, symmetricKey) : PGCryptoMemoryError;
+    
+    NSData *decryptedData = nil;
+    if (result == PGCryptoSuccess) {
+        decryptedData = PGDataCryptoCryptData(PGCryptoDecrypt, algorithm, symmetricKey, PGDataCryptoSymmetricKeySize, initializationVector, 
+                                              associatedData, self, errorOut);
+    } else if (errorOut) {
+        *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:result userInfo:nil];
+    }
+    
+    PGKeyArenaRelease(symmetricKey);
+    return decryptedData;
+}
+
+
+- (NSData *)encryptedDataWithSymmetricKey:(NSData *)symmetricKey initializationVector:(NSData **)initializationVectorOut error:(NSError **)errorOut
+{
+    return [self encryptedDataWithSymmetricKey:symmetricKey algorithm:PGAES256CBCEncryptionAlgorithm associatedData:nil 
+                          initializationVector:initializationVectorOut error:errorOut];
+}
+
+
+- (NSData *)decryptedDataWithSymmetricKey:(NSData *)symmetricKey initializationVector:(NSData *)initializationVector error:(NSError **)errorOut
+{
+    return [self decryptedDataWithSymmetricKey:symmetricKey algorithm:PGAES256CBCEncryptionAlgorithm associatedData:nil 
+                          initializationVector:initializationVector error:errorOut];
+}
+
+
+- (NSData *)encryptedDataWithSymmetricKey:(NSData *)symmetricKey algorithm:(PGEncryptionAlgorithm)algorithm associatedData:(NSData *)associatedData
+                     initializationVector:(NSData **)initializationVectorOut error:(NSError **)errorOut
+{
+    NSAssert(symmetricKey, @"nil symmetric key");
+    NSAssert(initializationVectorOut, @"NULL initialization vector");
+    
+    // A GCM initialization vector must never repeat for a key. Random 96-bit vectors are safe for far more messages than we'll ever encrypt.
+    NSData *initializationVector = [NSData randomDataOfLength:PGDataCryptoInitializationVectorSizeForAlgorithm(algorithm)];
+    NSData *encryptedData = PGDataCryptoCryptData(PGCryptoEncrypt, algorithm, [symmetricKey bytes], [symmetricKey length], initializationVector, 
+                                                  associatedData, self, errorOut);
+    if (!encryptedData) return nil;
+    
+    *initializationVectorOut = initializationVector;
+    return encryptedData;
+}
+
+
+- (NSData *)decryptedDataWithSymmetricKey:(NSData *)symmetricKey algorithm:(PGEncryptionAlgorithm)algorithm associatedData:(NSData *)associatedData
+                     initializationVector:(NSData *)initializationVector error:(NSError **)errorOut
+{
+    NSAssert(symmetricKey, @"nil symmetric key");
+    NSAssert(initializationVector, @"nil initialization vector");
+    
+    return PGDataCryptoCryptData(PGCryptoDecrypt, algorithm, [symmetricKey bytes], [symmetricKey length], initializationVector, associatedData, 
+                                 self, errorOut);
+}
+
+
+#pragma mark Buffer Encryption and Decryption
+
++ (BOOL)getSymmetricKey:(void *)symmetricKey forPassword:(NSString *)password salt:(NSData *)salt rounds:(NSNumber *)rounds 
+                  error:(NSError **)errorOut
+{
+    NSAssert(rounds, @"nil rounds");
+    
+    PGKeyDerivationParameters parameters = { PGPBKDF2KeyDerivationAlgorithm, [rounds unsignedIntValue], 0, 0 };
+    return [self getSymmetricKey:symmetricKey forPassword:password salt:salt keyDerivationParameters:parameters error:errorOut];
+}
+
+
++ (BOOL)getSymmetricKey:(void *)symmetricKey forPassword:(NSString *)password salt:(NSData *)salt 
+keyDerivationParameters:(PGKeyDerivationParameters)parameters error:(NSError **)errorOut
+{
+    NSAssert(symmetricKey, @"NULL symmetric key");
+    NSAssert(password, @"nil password");
+    NSAssert(salt, @"nil salt");
+    
+    PGCryptoStatus result = PGDataCryptoDeriveSymmetricKey(password, salt, parameters, symmetricKey);
+    if (result != PGCryptoSuccess) {
         if (errorOut) *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:result userInfo:nil];
-        return nil;
+        return NO;
     }
     
+    return YES;
+}
+
+
++ (size_t)initializationVectorLengthForAlgorithm:(PGEncryptionAlgorithm)algorithm
+{
+    return PGDataCryptoInitializationVectorSizeForAlgorithm(algorithm);
+}
+
+
++ (size_t)encryptedLengthForLength:(size_t)length algorithm:(PGEncryptionAlgorithm)algorithm
+{
+    // CBC always adds between one byte and one block of padding
+    if (algorithm == PGAES256GCMEncryptionAlgorithm) return length + PGDataCryptoGCMTagSize;
+    return (length / PGDataCryptoBlockSize + 1) * PGDataCryptoBlockSize;
+}
+
+
+- (BOOL)getEncryptedBytes:(void *)outputBuffer capacity:(size_t)capacity length:(size_t *)lengthOut symmetricKey:(const void *)symmetricKey 
+                keyLength:(size_t)keyLength algorithm:(PGEncryptionAlgorithm)algorithm associatedData:(NSData *)associatedData 
+     initializationVector:(const void *)initializationVector error:(NSError **)errorOut
+{
+    NSAssert(outputBuffer, @"NULL output buffer");
+    NSAssert(lengthOut, @"NULL length");
+    NSAssert(symmetricKey, @"NULL symmetric key");
+    NSAssert(initializationVector, @"NULL initialization vector");
+    
+    return PGDataCryptoCrypt(PGCryptoEncrypt, algorithm, symmetricKey, keyLength, initializationVector, 
+                             PGDataCryptoInitializationVectorSizeForAlgorithm(algorithm), associatedData, [self bytes], [self length], 
+                             outputBuffer, capacity, lengthOut, errorOut);
+}
+
+
+- (BOOL)getDecryptedBytes:(void *)outputBuffer capacity:(size_t)capacity length:(size_t *)lengthOut symmetricKey:(const void *)symmetricKey 
+                keyLength:(size_t)keyLength algorithm:(PGEncryptionAlgorithm)algorithm associatedData:(NSData *)associatedData 
+     initializationVector:(const void *)initializationVector error:(NSError **)errorOut
+{
+    NSAssert(outputBuffer, @"NULL output buffer");
+    NSAssert(lengthOut, @"NULL length");
+    NSAssert(symmetricKey, @"NULL symmetric key");
+    NSAssert(initializationVector, @"NULL initialization vector");
+    
+    return PGDataCryptoCrypt(PGCryptoDecrypt, algorithm, symmetricKey, keyLength, initializationVector, 
+                             PGDataCryptoInitializationVectorSizeForAlgorithm(algorithm), associatedData, [self bytes], [self length], 
+                             outputBuffer, capacity, lengthOut, errorOut);
+}
+
+
+#pragma mark Streaming Encryption and Decryption
+
++ (BOOL)encryptFileDescriptor:(int)inputFileDescriptor toFileDescriptor:(int)outputFileDescriptor password:(NSString *)password
+                         salt:(NSData **)saltOut rounds:(NSNumber **)roundsOut initializationVector:(NSData **)initializationVectorOut 
+                        error:(NSError **)errorOut
+{
+    return [self encryptFileDescriptor:inputFileDescriptor toFileDescriptor:outputFileDescriptor password:password 
+                             algorithm:PGAES256GCMEncryptionAlgorithm salt:saltOut rounds:roundsOut initializationVector:initializationVectorOut
+                                 error:errorOut];
+}
+
+
++ (BOOL)decryptFileDescriptor:(int)inputFileDescriptor toFileDescriptor:(int)outputFileDescriptor password:(NSString *)password
+                         salt:(NSData *)salt rounds:(NSNumber *)rounds initializationVector:(NSData *)initializationVector 
+                        error:(NSError **)errorOut
+{
+    return [self decryptFileDescriptor:inputFileDescriptor toFileDescriptor:outputFileDescriptor password:password 
+                             algorithm:PGAES256GCMEncryptionAlgorithm salt:salt rounds:rounds initializationVector:initializationVector 
+                                 error:errorOut];
+}
+
+
++ (BOOL)encryptFileDescriptor:(int)inputFileDescriptor toFileDescriptor:(int)outputFileDescriptor password:(NSString *)password
+                    algorithm:(PGEncryptionAlgorithm)algorithm salt:(NSData **)saltOut rounds:(NSNumber **)roundsOut 
+         initializationVector:(NSData **)initializationVectorOut error:(NSError **)errorOut
+{
+    NSData *salt = nil;
+    NSNumber *rounds = nil;
+    NSData *initializationVector = nil;
+    PGStreamCryptor *cryptor = [[PGStreamCryptor alloc] initForEncryptionWithPassword:password algorithm:algorithm salt:&salt rounds:&rounds
+                                                                 initializationVector:&initializationVector error:errorOut];
+    if (!cryptor || ![cryptor processFileDescriptor:inputFileDescriptor toFileDescriptor:outputFileDescriptor error:errorOut]) return NO;
+
     *saltOut = salt;
     *roundsOut = rounds;
     *initializationVectorOut = initializationVector;
+    return YES;
+}
+
+
++ (BOOL)decryptFileDescriptor:(int)inputFileDescriptor toFileDescriptor:(int)outputFileDescriptor password:(NSString *)password
+                    algorithm:(PGEncryptionAlgorithm)algorithm salt:(NSData *)salt rounds:(NSNumber *)rounds 
+         initializationVector:(NSData *)initializationVector error:(NSError **)errorOut
+{
+    PGStreamCryptor *cryptor = [[PGStreamCryptor alloc] initForDecryptionWithPassword:password algorithm:algorithm salt:salt rounds:rounds
+                                                                 initializationVector:initializationVector error:errorOut];
+    return cryptor && [cryptor processFileDescriptor:inputFileDescriptor toFileDescriptor:outputFileDescriptor error:errorOut];
+}
+
+
++ (BOOL)encryptFileAtPath:(NSString *)inputPath toPath:(NSString *)outputPath password:(NSString *)password salt:(NSData **)saltOut 
+                   rounds:(NSNumber **)roundsOut initializationVector:(NSData **)initializationVectorOut error:(NSError **)errorOut
+{
+    return [self encryptFileAtPath:inputPath toPath:outputPath password:password algorithm:PGAES256GCMEncryptionAlgorithm salt:saltOut 
+                            rounds:roundsOut initializationVector:initializationVectorOut error:errorOut];
+}
+
+
++ (BOOL)decryptFileAtPath:(NSString *)inputPath toPath:(NSString *)outputPath password:(NSString *)password salt:(NSData *)salt 
+                   rounds:(NSNumber *)rounds initializationVector:(NSData *)initializationVector error:(NSError **)errorOut
+{
+    return [self decryptFileAtPath:inputPath toPath:outputPath password:password algorithm:PGAES256GCMEncryptionAlgorithm salt:salt 
+                            rounds:rounds initializationVector:initializationVector error:errorOut];
+}
+
+
++ (BOOL)encryptFileAtPath:(NSString *)inputPath toPath:(NSString *)outputPath password:(NSString *)password 
+                algorithm:(PGEncryptionAlgorithm)algorithm salt:(NSData **)saltOut rounds:(NSNumber **)roundsOut 
+     initializationVector:(NSData **)initializationVectorOut error:(NSError **)errorOut
+{
+    NSAssert(inputPath, @"nil input path");
+    NSAssert(outputPath, @"nil output path");
+
+    int inputFileDescriptor = open([inputPath fileSystemRepresentation], O_RDONLY);
+    if (inputFileDescriptor == -1) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return NO;
+    }
     
-    return [NSData dataWithBytesNoCopy:encryptedDataBuffer length:encryptedDataBufferLength];
+    int outputFileDescriptor = open([outputPath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (outputFileDescriptor == -1) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        close(inputFileDescriptor);
+        return NO;
+    }
+    
+    BOOL success = [self encryptFileDescriptor:inputFileDescriptor toFileDescriptor:outputFileDescriptor password:password algorithm:algorithm
+                                          salt:saltOut rounds:roundsOut initializationVector:initializationVectorOut error:errorOut];
+    close(inputFileDescriptor);
+    if (close(outputFileDescriptor) == -1 && success) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        success = NO;
+    }
+    
+    if (!success) unlink([outputPath fileSystemRepresentation]);
+    return success;
 }
 
 
-- (NSData *)decryptedDataWithPassword:(NSString *)password salt:(NSData *)salt rounds:(NSNumber *)rounds
-                 initializationVector:(NSData *)initializationVector error:(NSError **)errorOut
++ (BOOL)decryptFileAtPath:(NSString *)inputPath toPath:(NSString *)outputPath password:(NSString *)password 
+                algorithm:(PGEncryptionAlgorithm)algorithm salt:(NSData *)salt rounds:(NSNumber *)rounds 
+     initializationVector:(NSData *)initializationVector error:(NSError **)errorOut
+{
+    NSAssert(inputPath, @"nil input path");
+    NSAssert(outputPath, @"nil output path");
+    
+    int inputFileDescriptor = open([inputPath fileSystemRepresentation], O_RDONLY);
+    if (inputFileDescriptor == -1) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return NO;
+    }
+    
+    int outputFileDescriptor = open([outputPath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (outputFileDescriptor == -1) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        close(inputFileDescriptor);
+        return NO;
+    }
+    
+    BOOL success = [self decryptFileDescriptor:inputFileDescriptor toFileDescriptor:outputFileDescriptor password:password algorithm:algorithm
+                                          salt:salt rounds:rounds initializationVector:initializationVector error:errorOut];
+    close(inputFileDescriptor);
+    if (close(outputFileDescriptor) == -1 && success) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        success = NO;
+    }
+    
+    if (!success) unlink([outputPath fileSystemRepresentation]);
+    return success;
+}
+
+
+#pragma mark Utilities
+
+- (NSString *)hexadecimalString
+{
+    NSUInteger byteCount = [self length];
+    if (byteCount == 0) return @"";
+    
+    size_t characterCount = PGCodecHexEncodedLength(byteCount);
+    char *characters = malloc(characterCount);
+    PGCodecHexEncode([self bytes], byteCount, characters);
+    return [[NSString alloc] initWithBytesNoCopy:characters length:characterCount encoding:NSASCIIStringEncoding freeWhenDone:YES];
+}
+
+
++ (NSData *)dataWithHexadecimalString:(NSString *)hexadecimalString
+{
+    NSAssert(hexadecimalString, @"nil hexadecimal string");
+    
+    NSUInteger characterCount = [hexadecimalString length];
+    if (characterCount % 2) return nil;
+    
+    NSData *buffer = nil;
+    const char *characters = PGDataCryptoASCIICharacters(hexadecimalString, &buffer);
+    if (!characters) return nil;
+    
+    NSMutableData *data = [NSMutableData dataWithLength:characterCount / 2];
+    return PGCodecHexDecode(characters, characterCount, [data mutableBytes]) ? data : nil;
+}
+
+
+- (NSString *)base64String
+{
+    NSUInteger byteCount = [self length];
+    if (byteCount == 0) return @"";
+    
+    size_t characterCount = PGCodecBase64EncodedLength(byteCount);
+    char *characters = malloc(characterCount);
+    PGCodecBase64Encode([self bytes], byteCount, characters);
+    return [[NSString alloc] initWithBytesNoCopy:characters length:characterCount encoding:NSASCIIStringEncoding freeWhenDone:YES];
+}
+
+
++ (NSData *)dataWithBase64String:(NSString *)base64String
+{
+    NSAssert(base64String, @"nil base64 string");
+    
+    NSData *buffer = nil;
+    const char *characters = PGDataCryptoASCIICharacters(base64String, &buffer);
+    if (!characters) return nil;
+    
+    NSUInteger characterCount = [base64String length];
+    size_t byteCount = PGCodecBase64DecodedLength(characters, characterCount);
+    if (byteCount == SIZE_MAX) return nil;
+    
+    NSMutableData *data = [NSMutableData dataWithLength:byteCount];
+    return PGCodecBase64Decode(characters, characterCount, [data mutableBytes]) ? data : nil;
+}
+
+@end
+
+
+#pragma mark -
+
+@implementation PGStreamCryptor {
+    const PGCryptoProvider *_provider;
+    PGCryptoOperation _operation;
+    PGEncryptionAlgorithm _algorithm;
+    BOOL _finished;
+    
+    // CBC streams go through a provider cipher
+    PGCryptoCipherRef _cipher;
+    
+    // GCM streams buffer one chunk of input at a time and seal or open it with the key, which is kept in the key arena. The input is plaintext 
+    // when encrypting and ciphertext followed by its tag when decrypting. A full chunk isn't processed until more input arrives, since until 
+    // then it might be the last one.
+    void *_symmetricKey;
+    size_t _keyLength;
+    uint8_t _initializationVector[PGCryptoAESGCMNonceLength];
+    uint64_t _chunkIndex;
+    uint8_t *_chunkBuffer;
+    size_t _chunkBufferLength;
+    size_t _chunkInputLength;
+    size_t _chunkOutputLength;
+}
+
+
+// A stream cryptor is useless without a key, so we just don't recognize the -init message.
+- (id)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    return nil;
+}
+
+
+- (id)initWithOperation:(PGCryptoOperation)operation algorithm:(PGEncryptionAlgorithm)algorithm symmetricKey:(const void *)symmetricKey 
+              keyLength:(size_t)keyLength initializationVector:(NSData *)initializationVector error:(NSError **)errorOut
+{
+    NSAssert(symmetricKey, @"NULL symmetric key");
+    NSAssert(initializationVector, @"nil initialization vector");
+
+    if (!(self = [super init])) return nil;
+    
+    // Hold on to the provider so that changing the default doesn't affect a stream that's in progress
+    _provider = PGCryptoDefaultProvider();
+    _operation = operation;
+    _algorithm = algorithm;
+    
+    PGCryptoStatus result = PGCryptoSuccess;
+    if ([initializationVector length] < PGDataCryptoInitializationVectorSizeForAlgorithm(algorithm)) {
+        result = PGCryptoParameterError;
+    } else if (algorithm == PGAES256GCMEncryptionAlgorithm) {
+        _chunkInputLength = PGDataCryptoGCMStreamChunkSize + (operation == PGCryptoEncrypt ? 0 : PGDataCryptoGCMTagSize);
+        _chunkOutputLength = PGDataCryptoGCMStreamChunkSize + (operation == PGCryptoEncrypt ? PGDataCryptoGCMTagSize : 0);
+        _symmetricKey = PGKeyArenaAllocate(keyLength);
+        _chunkBuffer = malloc(_chunkInputLength);
+        if (_symmetricKey && _chunkBuffer) {
+            memcpy(_symmetricKey, symmetricKey, keyLength);
+            memcpy(_initializationVector, [initializationVector bytes], sizeof(_initializationVector));
+            _keyLength = keyLength;
+        } else {
+            result = PGCryptoMemoryError;
+        }
+    } else {
+        result = _provider->cipherCreate(operation, PGCryptoModeCBC, true, symmetricKey, keyLength, [initializationVector bytes], &_cipher);
+    }
+    
+    if (result != PGCryptoSuccess) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:result userInfo:nil];
+        return nil;
+    }
+    
+    return self;
+}
+
+
+- (id)initForEncryptionWithPassword:(NSString *)password salt:(NSData **)saltOut rounds:(NSNumber **)roundsOut 
+               initializationVector:(NSData **)initializationVectorOut error:(NSError **)errorOut
+{
+    return [self initForEncryptionWithPassword:password algorithm:PGAES256GCMEncryptionAlgorithm salt:saltOut rounds:roundsOut 
+                          initializationVector:initializationVectorOut error:errorOut];
+}
+
+
+- (id)initForDecryptionWithPassword:(NSString *)password salt:(NSData *)salt rounds:(NSNumber *)rounds 
+               initializationVector:(NSData *)initializationVector error:(NSError **)errorOut
+{
+    return [self initForDecryptionWithPassword:password algorithm:PGAES256GCMEncryptionAlgorithm salt:salt rounds:rounds 
+                          initializationVector:initializationVector error:errorOut];
+}
+
+
+- (id)initForEncryptionWithPassword:(NSString *)password algorithm:(PGEncryptionAlgorithm)algorithm salt:(NSData **)saltOut 
+                             rounds:(NSNumber **)roundsOut initializationVector:(NSData **)initializationVectorOut error:(NSError **)errorOut
+{
+    NSAssert(password, @"nil password");
+    NSAssert(saltOut, @"NULL salt");
+    NSAssert(roundsOut, @"NULL rounds");
+    NSAssert(initializationVectorOut, @"NULL initialization vector");
+    
+    // Generate a symmetric key for the password
+    NSData *salt = [NSData randomDataOfLength:PGDataCryptoPBKDFSaltSize];
+    PGKeyDerivationParameters parameters = PGDataCryptoCalibratedKeyDerivationParameters(PGPBKDF2KeyDerivationAlgorithm, 0, [password length]);
+    void *symmetricKey = PGKeyArenaAllocate(PGDataCryptoSymmetricKeySize);
+    NSData *initializationVector = [NSData randomDataOfLength:PGDataCryptoInitializationVectorSizeForAlgorithm(algorithm)];
+    
+    PGCryptoStatus result = PGCryptoMemoryError;
+    if (symmetricKey && salt && initializationVector) result = PGDataCryptoDeriveSymmetricKey(password, salt, parameters, symmetricKey);
+    if (result != PGCryptoSuccess) {
+        PGKeyArenaRelease(symmetricKey);
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:result userInfo:nil];
+        return nil;
+    }
+    
+    self = [self initWithOperation:PGCryptoEncrypt algorithm:algorithm symmetricKey:symmetricKey keyLength:PGDataCryptoSymmetricKeySize 
+              initializationVector:initializationVector error:errorOut];
+    PGKeyArenaRelease(symmetricKey);
+    if (!self) return nil;
+
+    *saltOut = salt;
+    *roundsOut = [NSNumber numberWithUnsignedInt:parameters.rounds];
+    *initializationVectorOut = initializationVector;
+    return self;
+}
+
+
+- (id)initForDecryptionWithPassword:(NSString *)password algorithm:(PGEncryptionAlgorithm)algorithm salt:(NSData *)salt 
+                             rounds:(NSNumber *)rounds initializationVector:(NSData *)initializationVector error:(NSError **)errorOut
 {
     NSAssert(password, @"nil password");
     NSAssert(salt, @"nil salt");
     NSAssert(rounds, @"nil rounds");
     NSAssert(initializationVector, @"nil initialization vector");
+
+    PGKeyDerivationParameters parameters = { PGPBKDF2KeyDerivationAlgorithm, [rounds unsignedIntValue], 0, 0 };
+    void *symmetricKey = PGKeyArenaAllocate(PGDataCryptoSymmetricKeySize);
+    PGCryptoStatus result = symmetricKey ? PGDataCryptoDeriveSymmetricKey(password, salt, parameters, symmetricKey) : PGCryptoMemoryError;
+    if (result != PGCryptoSuccess) {
+        PGKeyArenaRelease(symmetricKey);
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:result userInfo:nil];
+        return nil;
+    }
     
-    // Get the symmetric key for the password
-    NSData *symmetricKey = PGDataCryptoSymmetricKeyForPassword(password, salt, &rounds);
+    self = [self initWithOperation:PGCryptoDecrypt algorithm:algorithm symmetricKey:symmetricKey keyLength:PGDataCryptoSymmetricKeySize 
+              initializationVector:initializationVector error:errorOut];
+    PGKeyArenaRelease(symmetricKey);
+    return self;
+}
+
+
+- (void)dealloc
+{
+    if (_cipher) _provider->cipherRelease(_cipher);
+    PGKeyArenaRelease(_symmetricKey);
     
-    // Decrypt our data with the symmetric key and initialization vector
-    size_t decryptedDataBufferCapacity = [self length] + PGDataCryptoBlockSize;
-    void *decryptedDataBuffer = malloc(decryptedDataBufferCapacity);
-    size_t decryptedDataBufferLength = 0;
+    // Don't leave plaintext lying around in freed memory
+    if (_chunkBuffer) {
+        memset(_chunkBuffer, 0, _chunkInputLength);
+        free(_chunkBuffer);
+    }
+}
+
+
+- (size_t)outputLengthForInputLength:(size_t)inputLength final:(BOOL)final
+{
+    if (_algorithm != PGAES256GCMEncryptionAlgorithm) return _provider->cipherOutputLength(_cipher, inputLength, final);
     
-    int result = CCCrypt(kCCDecrypt, PGDataCryptoEncryptionAlgorithm, kCCOptionPKCS7Padding, [symmetricKey bytes], [symmetricKey length], 
-                         [initializationVector bytes], [self bytes], [self length], decryptedDataBuffer, decryptedDataBufferCapacity, 
-                         &decryptedDataBufferLength);
+    // Input completes at most one chunk more than it contains whole chunks, since up to a chunk may already be buffered, and finishing the 
+    // stream produces one more
+    return (inputLength / _chunkInputLength + 1 + (final ? 1 : 0)) * _chunkOutputLength;
+}
 
-    // If we didn't have enough space to decrypt, reallocate decryptedDataBuffer to be decryptedDataBufferLength bytes and try again
-    if (result == kCCBufferTooSmall) {
-        decryptedDataBufferCapacity = decryptedDataBufferLength;
-        decryptedDataBuffer = realloc(decryptedDataBuffer, decryptedDataBufferCapacity);
+
+- (BOOL)updateWithBytes:(const void *)bytes length:(size_t)length outputBuffer:(void *)outputBuffer capacity:(size_t)capacity 
+           outputLength:(size_t *)outputLengthOut error:(NSError **)errorOut
+{
+    NSAssert(!_finished, @"stream cryptor already finished");
+    NSAssert(outputBuffer, @"NULL output buffer");
+    NSAssert(outputLengthOut, @"NULL output length");
+    
+    PGCryptoStatus result = PGCryptoSuccess;
+    if (_algorithm != PGAES256GCMEncryptionAlgorithm) {
+        result = _provider->cipherUpdate(_cipher, bytes, length, outputBuffer, capacity, outputLengthOut);
+    } else {
+        size_t outputLength = 0;
+        while (length > 0) {
+            // The buffered chunk is only known not to be the last one once there's more input
+            if (_chunkBufferLength == _chunkInputLength) {
+                size_t chunkOutputLength = 0;
+                result = [self cryptBufferedChunkAsFinal:NO outputBuffer:(uint8_t *)outputBuffer + outputLength capacity:capacity - outputLength
+                                            outputLength:&chunkOutputLength];
+                if (result != PGCryptoSuccess) break;
+                outputLength += chunkOutputLength;
+            }
+            
+            size_t copyLength = MIN(length, _chunkInputLength - _chunkBufferLength);
+            memcpy(_chunkBuffer + _chunkBufferLength, bytes, copyLength);
+            _chunkBufferLength += copyLength;
+            bytes = (const uint8_t *)bytes + copyLength;
+            length -= copyLength;
+        }
         
-        result = CCCrypt(kCCDecrypt, PGDataCryptoEncryptionAlgorithm, kCCOptionPKCS7Padding, [symmetricKey bytes], [symmetricKey length], 
-                         [initializationVector bytes], [self bytes], [self length], decryptedDataBuffer, decryptedDataBufferCapacity, 
-                         &decryptedDataBufferLength);
+        *outputLengthOut = outputLength;
+    }
+    
+    if (result != PGCryptoSuccess) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:result userInfo:nil];
+        return NO;
+    }
+    
+    return YES;
+}
+
+
+- (BOOL)finishWithOutputBuffer:(void *)outputBuffer capacity:(size_t)capacity outputLength:(size_t *)outputLengthOut error:(NSError **)errorOut
+{
+    NSAssert(!_finished, @"stream cryptor already finished");
+    NSAssert(outputBuffer, @"NULL output buffer");
+    NSAssert(outputLengthOut, @"NULL output length");
+
+    _finished = YES;
+    PGCryptoStatus result = PGCryptoSuccess;
+    if (_algorithm != PGAES256GCMEncryptionAlgorithm) {
+        result = _provider->cipherFinal(_cipher, outputBuffer, capacity, outputLengthOut);
+    } else {
+        result = [self cryptBufferedChunkAsFinal:YES outputBuffer:outputBuffer capacity:capacity outputLength:outputLengthOut];
     }
     
-    if (result != kCCSuccess) {
-        free(decryptedDataBuffer);
+    if (result != PGCryptoSuccess) {
         if (errorOut) *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:result userInfo:nil];
+        return NO;
+    }
+    
+    return YES;
+}
+
+
+- (NSData *)updateWithData:(NSData *)data error:(NSError **)errorOut
+{
+    NSAssert(data, @"nil data");
+    
+    size_t capacity = [self outputLengthForInputLength:[data length] final:NO];
+    NSMutableData *outputData = [NSMutableData dataWithLength:capacity];
+    size_t outputLength = 0;
+    if (![self updateWithBytes:[data bytes] length:[data length] outputBuffer:[outputData mutableBytes] capacity:capacity 
+                  outputLength:&outputLength error:errorOut]) {
         return nil;
     }
     
-    return [NSData dataWithBytesNoCopy:decryptedDataBuffer length:decryptedDataBufferLength];
+    [outputData setLength:outputLength];
+    return outputData;
 }
 
 
-#pragma mark Utilities
+- (NSData *)finish:(NSError **)errorOut
+{
+    size_t capacity = [self outputLengthForInputLength:0 final:YES];
+    NSMutableData *outputData = [NSMutableData dataWithLength:capacity];
+    size_t outputLength = 0;
+    if (![self finishWithOutputBuffer:[outputData mutableBytes] capacity:capacity outputLength:&outputLength error:errorOut]) return nil;
+    
+    [outputData setLength:outputLength];
+    return outputData;
+}
 
-- (NSString *)hexadecimalString
+
+- (BOOL)processFileDescriptor:(int)inputFileDescriptor toFileDescriptor:(int)outputFileDescriptor error:(NSError **)errorOut
 {
-    const uint8_t *bytes = [self bytes];
-    NSUInteger byteCount = [self length];
+    const size_t chunkSize = PGDataCryptoStreamChunkSize;
+    const NSUInteger slotCount = PGDataCryptoStreamRingSlotCount;
+    
+    // The ring and the output buffer are allocated once, so memory use doesn't depend on the length of the stream
+    size_t outputCapacity = [self outputLengthForInputLength:chunkSize final:NO];
+    size_t finalOutputCapacity = [self outputLengthForInputLength:0 final:YES];
+    if (finalOutputCapacity > outputCapacity) outputCapacity = finalOutputCapacity;
+    
+    uint8_t *ring = malloc(slotCount * chunkSize);
+    ssize_t *slotLengths = calloc(slotCount, sizeof(ssize_t));
+    uint8_t *outputBuffer = malloc(outputCapacity);
+    
+    dispatch_semaphore_t emptySlots = dispatch_semaphore_create(slotCount);
+    dispatch_semaphore_t fullSlots = dispatch_semaphore_create(0);
+    dispatch_group_t readerGroup = dispatch_group_create();
+    // The reader and this thread both touch the cancelled flag, so it's only accessed with barriers. The slots and readErrorNumber are handed
+    // off through the semaphores, which order their accesses.
+    __block volatile int32_t cancelled = 0;
+    __block int readErrorNumber = 0;
+    
+    // Fill slots in order on a background queue. A slot length of 0 marks end-of-file and -1 marks a read error; either ends the reader.
+    dispatch_group_async(readerGroup, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        for (NSUInteger slot = 0; ; slot = (slot + 1) % slotCount) {
+            dispatch_semaphore_wait(emptySlots, DISPATCH_TIME_FOREVER);
+            if (OSAtomicAdd32Barrier(0, &cancelled)) return;
+            
+            ssize_t length = PGDataCryptoReadFully(inputFileDescriptor, ring + slot * chunkSize, chunkSize);
+            if (length < 0) readErrorNumber = errno;
+            slotLengths[slot] = length;
+            dispatch_semaphore_signal(fullSlots);
+            
+            if (length <= 0) return;
+        }
+    });
     
-    NSMutableString *hexString = [NSMutableString stringWithCapacity:2 * byteCount];
-    for (NSUInteger i = 0; i < byteCount; ++i) {
-        [hexString appendFormat:@"%02x", bytes[i]];
+    // Process and write slots in the same order on this thread, handing each slot back to the reader when we're done with it
+    NSError *error = nil;
+    BOOL success = NO;
+    for (NSUInteger slot = 0; ; slot = (slot + 1) % slotCount) {
+        dispatch_semaphore_wait(fullSlots, DISPATCH_TIME_FOREVER);
+        
+        ssize_t length = slotLengths[slot];
+        size_t outputLength = 0;
+        if (length < 0) {
+            error = [NSError errorWithDomain:NSPOSIXErrorDomain code:readErrorNumber userInfo:nil];
+            break;
+        } else if (length == 0) {
+            if (![self finishWithOutputBuffer:outputBuffer capacity:outputCapacity outputLength:&outputLength error:&error]) break;
+        } else if (![self updateWithBytes:ring + slot * chunkSize length:length outputBuffer:outputBuffer capacity:outputCapacity 
+                             outputLength:&outputLength error:&error]) {
+            break;
+        }
+        
+        if (!PGDataCryptoWriteFully(outputFileDescriptor, outputBuffer, outputLength)) {
+            error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            break;
+        }
+        
+        if (length == 0) {
+            success = YES;
+            break;
+        }
+        
+        dispatch_semaphore_signal(emptySlots);
     }
     
-    return hexString;
+    // If we stopped early, tell the reader to stop and wake it in case it's waiting for an empty slot
+    if (!success) {
+        OSAtomicCompareAndSwap32Barrier(0, 1, &cancelled);
+        dispatch_semaphore_signal(emptySlots);
+    }
+    
+    dispatch_group_wait(readerGroup, DISPATCH_TIME_FOREVER);
+    dispatch_release(readerGroup);
+    dispatch_release(fullSlots);
+    dispatch_release(emptySlots);
+    
+    // Don't leave plaintext lying around in freed memory
+    memset(ring, 0, slotCount * chunkSize);
+    memset(outputBuffer, 0, outputCapacity);
+    free(outputBuffer);
+    free(slotLengths);
+    free(ring);
+    
+    if (!success && errorOut) *errorOut = error;
+    return success;
+}
+
+
+
+#pragma mark Private Methods
+
+- (PGCryptoStatus)cryptBufferedChunkAsFinal:(BOOL)final outputBuffer:(void *)outputBuffer capacity:(size_t)capacity 
+                               outputLength:(size_t *)outputLengthOut
+{
+    *outputLengthOut = 0;
+    if (_chunkIndex >= PGDataCryptoGCMStreamMaximumChunkCount) return PGCryptoParameterError;
+    
+    // Each chunk's nonce is unique within the stream, and the final flag is authenticated, so a stream that has been truncated at a chunk 
+    // boundary fails to decrypt just like one whose chunks have been modified or reordered
+    uint8_t nonce[PGCryptoAESGCMNonceLength];
+    uint32_t bigEndianChunkIndex = CFSwapInt32HostToBig((uint32_t)_chunkIndex);
+    memcpy(nonce, _initializationVector, sizeof(nonce));
+    for (NSUInteger i = 0; i < sizeof(bigEndianChunkIndex); ++i) {
+        nonce[sizeof(nonce) - sizeof(bigEndianChunkIndex) + i] ^= ((const uint8_t *)&bigEndianChunkIndex)[i];
+    }
+    
+    uint8_t finalFlag = final ? 1 : 0;
+    PGCryptoStatus result = PGCryptoSuccess;
+    size_t outputLength = 0;
+    if (_operation == PGCryptoEncrypt) {
+        outputLength = _chunkBufferLength + PGDataCryptoGCMTagSize;
+        if (capacity < outputLength) return PGCryptoBufferTooSmallError;
+        result = _provider->GCMSeal(_symmetricKey, _keyLength, nonce, &finalFlag, sizeof(finalFlag), _chunkBuffer, _chunkBufferLength, 
+                                    outputBuffer, (uint8_t *)outputBuffer + _chunkBufferLength);
+    } else {
+        if (_chunkBufferLength < PGDataCryptoGCMTagSize) return PGCryptoDecodeError;
+        outputLength = _chunkBufferLength - PGDataCryptoGCMTagSize;
+        if (capacity < outputLength) return PGCryptoBufferTooSmallError;
+        result = _provider->GCMOpen(_symmetricKey, _keyLength, nonce, &finalFlag, sizeof(finalFlag), _chunkBuffer, outputLength, 
+                                    _chunkBuffer + outputLength, outputBuffer);
+    }
+    
+    if (result != PGCryptoSuccess) return result;
+    
+    ++_chunkIndex;
+    _chunkBufferLength = 0;
+    *outputLengthOut = outputLength;
+    return PGCryptoSuccess;
 }
 
 @end
@@ -26,25 +26,37 @@
 
 #import "NSString+Grouping.h"
 
+#import "PGCodec.h"
+
 @implementation NSString (Grouping)
 
 - (NSString *)stringByInterposingString:(NSString *)separator betweenSubstringsOfLength:(NSUInteger)substringLength
 {
     NSAssert(substringLength > 0, @"substringLength == 0"); 
-    if (substringLength > [self length]) return self;
+    NSUInteger length = [self length];
+    if (substringLength > length) return self;
     
-    NSUInteger groupCount = [self length] / substringLength;
-    if ([self length] % substringLength) ++groupCount;
-
-    NSMutableString *separatedString = [[NSMutableString alloc] initWithCapacity:[self length] + [separator length] * (groupCount - 1)];
-    [separatedString appendString:self];
+    // Use the receiver's characters in place if it stores them as UTF-16, and copy them out otherwise
+    const unichar *characters = CFStringGetCharactersPtr((__bridge CFStringRef)self);
+    unichar *characterBuffer = NULL;
+    if (!characters) {
+        characterBuffer = malloc(length * sizeof(unichar));
+        [self getCharacters:characterBuffer range:NSMakeRange(0, length)];
+        characters = characterBuffer;
+    }
     
     NSUInteger separatorLength = [separator length];
-    for (NSUInteger i = 0; i < groupCount - 1; ++i) {
-        [separatedString insertString:separator atIndex:substringLength * (i + 1) + separatorLength * i];
-    }
+    unichar *separatorCharacters = malloc(separatorLength * sizeof(unichar) + 1);
+    [separator getCharacters:separatorCharacters range:NSMakeRange(0, separatorLength)];
+    
+    // Every character is copied exactly once, straight into the new string's storage
+    size_t separatedLength = PGCodecInterposedLength(length, substringLength, separatorLength);
+    unichar *separatedCharacters = malloc(separatedLength * sizeof(unichar));
+    PGCodecInterpose(characters, length, sizeof(unichar), substringLength, separatorCharacters, separatorLength, separatedCharacters);
     
-    return separatedString;
+    free(characterBuffer);
+    free(separatorCharacters);
+    return [[NSString alloc] initWithCharactersNoCopy:separatedCharacters length:separatedLength freeWhenDone:YES];
 }
 
 @end
@@ -0,0 +1,150 @@
+//
+//  PGArchive.h
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+/*! @abstract The default size of the chunks into which an archiver splits files. */
+extern const NSUInteger PGArchiverDefaultChunkSize;
+
+
+/*!
+ @abstract PGArchiveCatalog instances list the files and directories an archive was made from.
+ @discussion A catalog records the size, modification date, and permissions of each regular file beneath a directory, the directory's 
+     subdirectories, and the paths that were excluded from it. Every archive ends with the catalog of the directory it was made from, and the 
+     archiver returns it when it writes or extracts an archive. Pass the catalog of one archive when making the next to make an incremental 
+     archive, which omits the contents of files whose size and modification date haven't changed.
+ 
+     Catalogs are immutable and may be used from any thread.
+ */
+@interface PGArchiveCatalog : NSObject
+
+/*! @abstract The paths of the regular files in the catalog, relative to its directory, in ascending order. */
+@property(readonly, strong) NSArray *relativePaths;
+
+/*! @abstract The paths of the subdirectories in the catalog, relative to its directory, in ascending order. */
+@property(readonly, strong) NSArray *directoryRelativePaths;
+
+/*! @abstract The paths relative to the catalog's directory that were excluded from it, along with everything beneath them. */
+@property(readonly, strong) NSSet *excludedRelativePaths;
+
+/*!
+ @abstract Initializes a newly allocated catalog with a catalog file written by -writeToFile:error:.
+ 
+ @param path The path of the catalog file. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return An initialized catalog, or nil if the file could not be read or is malformed.
+ */
+- (id)initWithContentsOfFile:(NSString *)path error:(NSError **)errorOut;
+
+/*!
+ @abstract Atomically writes the catalog to the specified file.
+ 
+ @param path The path of the catalog file. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the catalog was written.
+ */
+- (BOOL)writeToFile:(NSString *)path error:(NSError **)errorOut;
+
+/*!
+ @abstract Returns the recorded size of the file at the specified path.
+ @param relativePath The file's path relative to the catalog's directory. May not be nil.
+ @return The file's size in bytes, or 0 if the catalog has no such file.
+ */
+- (unsigned long long)sizeForRelativePath:(NSString *)relativePath;
+
+/*!
+ @abstract Returns the recorded modification date of the file at the specified path.
+ @param relativePath The file's path relative to the catalog's directory. May not be nil.
+ @return The file's modification date, or nil if the catalog has no such file.
+ */
+- (NSDate *)modificationDateForRelativePath:(NSString *)relativePath;
+
+@end
+
+
+/*!
+ @abstract PGArchiver instances stream a directory into a single archive and back through a file descriptor.
+ @discussion Archiving is a pipeline: the calling thread walks the directory and hands out chunks of its files; a pool of workers reads the chunks
+     with pread(2), compresses them with zlib, and checksums them, many at once on all cores; and a writer writes the finished chunks to the 
+     archive in order. Extracting runs the same pipeline backward: the calling thread reads the archive, and the workers decompress and verify 
+     the chunks and write them to their files with pwrite(2). Only maximumBufferedChunkCount chunks are in flight at once, and their buffers are 
+     reused, so an archiver uses a fixed amount of memory no matter how large the directory is. Chunks that don't compress are stored as they are. 
+     The archive is written and read strictly sequentially, so it can be a pipe or socket as well as a file.
+ 
+     An archive made with a base catalog is incremental: it lists every file, but only includes the contents of those whose size or modification
+     date differs from the base catalog's. An incremental archive can only be extracted over a directory restored from its base, to which it 
+     applies the changes in place. A full archive is extracted into a new directory, which appears at its path only once extraction succeeds.
+ 
+     Files must not be modified while they are being archived. Archivers may be used from any thread, but only for one archive at a time.
+ */
+@interface PGArchiver : NSObject
+
+/*! @abstract The size of the chunks into which files are split. Defaults to PGArchiverDefaultChunkSize. Only affects archiving. */
+@property(readwrite) NSUInteger chunkSize;
+
+/*! @abstract The maximum number of chunks that are read, compressed, or written at once. Defaults to twice the number of active processors. */
+@property(readwrite) NSUInteger maximumBufferedChunkCount;
+
+/*! @abstract The zlib compression level, from 1 (fastest) to 9 (smallest). Defaults to 1, since encrypted data rarely compresses. */
+@property(readwrite) int compressionLevel;
+
+/*!
+ @abstract Writes an archive of the specified directory to the specified file descriptor.
+ 
+ @param path The path of the directory to archive. May not be nil.
+ @param fileDescriptor The file descriptor to which to write the archive. It is not closed.
+ @param excludedRelativePaths The paths, relative to the directory, of files and directories to leave out of the archive. May be nil.
+ @param baseCatalog The catalog of an earlier archive of the directory. If not nil, an incremental archive is written that only includes the 
+     contents of files that have changed since then.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The catalog of the directory, which was also written to the end of the archive, or nil if an error occurred.
+ */
+- (PGArchiveCatalog *)archiveDirectoryAtPath:(NSString *)path toFileDescriptor:(int)fileDescriptor excludedRelativePaths:(NSSet *)excludedRelativePaths 
+                                 baseCatalog:(PGArchiveCatalog *)baseCatalog error:(NSError **)errorOut;
+
+/*!
+ @abstract Extracts an archive read from the specified file descriptor to the specified directory.
+ @discussion A full archive is extracted into a temporary directory beside the specified one, which is moved into place once extraction succeeds.
+     Nothing may exist at the path. An incremental archive is applied to the existing directory at the path: changed files are extracted beside 
+     it and then moved into place, and files that aren't in the archive's catalog are removed, except those beneath its excluded paths. If a file 
+     the archive expects to be unchanged is missing or has the wrong size, nothing is changed.
+ 
+ @param fileDescriptor The file descriptor from which to read the archive. It is read up to the end of the archive and is not closed.
+ @param path The path of the directory to which to extract the archive. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The catalog of the directory the archive was made from, or nil if an error occurred.
+ */
+- (PGArchiveCatalog *)extractArchiveFromFileDescriptor:(int)fileDescriptor toDirectoryAtPath:(NSString *)path error:(NSError **)errorOut;
+
+@end
@@ -0,0 +1,1185 @@
+//
+//  PGArchive.m
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGArchive.h"
+
+#import <fcntl.h>
+#import <sys/stat.h>
+#import <unistd.h>
+#import <zlib.h>
+
+#import "PGErrors.h"
+
+/*
+ An archive is a header, a sequence of records, and an end record followed by the archive's catalog. All integers are little-endian.
+ 
+   Header          magic "PGAR", version (uint32), flags (uint32), chunk size (uint32)
+   Record          type (uint32), path length (uint32), size (uint64), path (UTF-8, path length bytes)
+   Chunk           stored length (uint32), flags (uint32), CRC-32 of the uncompressed bytes (uint32), reserved (uint32), stored bytes
+   End record      type (uint32), catalog length (uint32), 0 (uint64), catalog (binary property list, catalog length bytes)
+ 
+ Directory records come first, then file records in ascending path order. A file record is followed by its contents, split into chunks of the 
+ archive's chunk size (the last may be shorter), each of which is compressed independently with zlib. Unchanged file records in incremental 
+ archives have no chunks.
+ */
+
+#pragma mark Constants and Functions
+
+const NSUInteger PGArchiverDefaultChunkSize = 1024 * 1024;
+
+/*! @abstract The bytes with which every archive starts. */
+static const uint8_t PGArchiveMagic[4] = { 'P', 'G', 'A', 'R' };
+
+/*! @abstract The version of the archive format written by this class. */
+static const uint32_t PGArchiveVersion = 1;
+
+/*! @abstract The largest chunk size an archive may have, which bounds the memory extracting a malformed archive can use. */
+static const uint32_t PGArchiveMaximumChunkSize = 64 * 1024 * 1024;
+
+/*! @abstract The longest relative path an archive may contain, in bytes. */
+static const uint32_t PGArchiveMaximumPathLength = 4096;
+
+/*! @abstract The longest catalog an archive may contain, in bytes. */
+static const uint32_t PGArchiveMaximumCatalogLength = 256 * 1024 * 1024;
+
+/*! @abstract The version of the catalog file format written by this class. */
+static const NSUInteger PGArchiveCatalogVersion = 1;
+
+/*! @abstract The catalog file key whose value corresponds to the file format version. */
+static NSString *const PGVersionArchiveCatalogKey = @"Version";
+
+/*! @abstract The catalog file key whose value is a dictionary of file entries keyed by relative path. */
+static NSString *const PGFilesArchiveCatalogKey = @"Files";
+
+/*! @abstract The catalog file key whose value is an array of the catalog's directories' relative paths. */
+static NSString *const PGDirectoriesArchiveCatalogKey = @"Directories";
+
+/*! @abstract The catalog file key whose value is an array of the catalog's excluded relative paths. */
+static NSString *const PGExcludedPathsArchiveCatalogKey = @"ExcludedPaths";
+
+/*! @abstract The file entry key whose value corresponds to the file's size in bytes. */
+static NSString *const PGSizeArchiveCatalogEntryKey = @"Size";
+
+/*! @abstract The file entry key whose value corresponds to the file's modification date. */
+static NSString *const PGModificationDateArchiveCatalogEntryKey = @"ModificationDate";
+
+/*! @abstract The file entry key whose value corresponds to the file's POSIX permissions. */
+static NSString *const PGPermissionsArchiveCatalogEntryKey = @"Permissions";
+
+/*! @abstract Flags in an archive's header. */
+enum {
+    /*! @abstract The archive is incremental. */
+    PGArchiveIncrementalFlag = 1 << 0
+};
+
+/*! @abstract Flags in a chunk's header. */
+enum {
+    /*! @abstract The chunk's stored bytes are compressed. */
+    PGArchiveCompressedChunkFlag = 1 << 0
+};
+
+/*! @abstract The types of archive records. */
+typedef enum {
+    /*! @abstract The end of the archive, followed by its catalog. */
+    PGArchiveEndRecord = 0,
+    
+    /*! @abstract A file, followed by its contents. */
+    PGArchiveFileRecord = 1,
+    
+    /*! @abstract A file that hasn't changed since the base catalog of an incremental archive. */
+    PGArchiveUnchangedFileRecord = 2,
+    
+    /*! @abstract A directory. */
+    PGArchiveDirectoryRecord = 3
+} PGArchiveRecordType;
+
+/*! @abstract The header at the start of an archive. */
+typedef struct {
+    uint8_t magic[4];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t chunkSize;
+} PGArchiveHeader;
+
+/*! @abstract The header of an archive record. */
+typedef struct {
+    uint32_t type;
+    uint32_t pathLength;
+    uint64_t size;
+} PGArchiveRecordHeader;
+
+/*! @abstract The header of a chunk of a file's contents. */
+typedef struct {
+    uint32_t storedLength;
+    uint32_t flags;
+    uint32_t checksum;
+    uint32_t reserved;
+} PGArchiveChunkHeader;
+
+
+/*!
+ @abstract Writes the specified bytes to a file descriptor, retrying after partial writes and interruptions.
+ @param fileDescriptor The file descriptor.
+ @param bytes The bytes to write. May only be NULL if length is 0.
+ @param length The number of bytes to write.
+ @return 0 if every byte was written, or an errno value.
+ */
+static int PGArchiveWriteFully(int fileDescriptor, const void *bytes, size_t length)
+{
+    while (length > 0) {
+        ssize_t written = write(fileDescriptor, bytes, length);
+        if (written == -1) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        
+        bytes = (const uint8_t *)bytes + written;
+        length -= written;
+    }
+    
+    return 0;
+}
+
+
+/*!
+ @abstract Reads the specified number of bytes from a file descriptor, retrying after partial reads and interruptions.
+ @param fileDescriptor The file descriptor.
+ @param buffer The buffer into which to read. Must be at least length bytes long.
+ @param length The number of bytes to read.
+ @return 0 if every byte was read, an errno value if reading failed, or -1 if the end of the file was reached first.
+ */
+static int PGArchiveReadFully(int fileDescriptor, void *buffer, size_t length)
+{
+    while (length > 0) {
+        ssize_t bytesRead = read(fileDescriptor, buffer, length);
+        if (bytesRead == -1) {
+            if (errno == EINTR) continue;
+            return errno;
+        } else if (bytesRead == 0) {
+            return -1;
+        }
+        
+        buffer = (uint8_t *)buffer + bytesRead;
+        length -= bytesRead;
+    }
+    
+    return 0;
+}
+
+
+/*!
+ @abstract Returns whether the specified path is safe to extract, i.e., it is relative and can't refer to anything outside the directory.
+ @param relativePath The path. May not be nil.
+ @return Whether the path is safe.
+ */
+static BOOL PGArchiveIsSafeRelativePath(NSString *relativePath)
+{
+    if ([relativePath length] == 0 || [relativePath hasPrefix:@"/"]) return NO;
+    
+    for (NSString *component in [relativePath componentsSeparatedByString:@"/"]) {
+        if ([component length] == 0 || [component isEqualToString:@"."] || [component isEqualToString:@".."]) return NO;
+    }
+    
+    return YES;
+}
+
+
+/*!
+ @abstract Returns whether the specified relative path is one of the specified excluded paths or beneath one.
+ @param relativePath The path. May not be nil.
+ @param excludedRelativePaths The excluded paths. May not be nil.
+ @return Whether the path is excluded.
+ */
+static BOOL PGArchiveIsExcludedRelativePath(NSString *relativePath, NSSet *excludedRelativePaths)
+{
+    for (NSString *path = relativePath; [path length] > 0; path = [path stringByDeletingLastPathComponent]) {
+        if ([excludedRelativePaths containsObject:path]) return YES;
+    }
+    
+    return NO;
+}
+
+
+/*!
+ @abstract Returns the specified paths sorted by their Unicode code points, which is the order in which an archive's records are written.
+ @param paths The paths to sort. May not be nil.
+ @return The sorted paths.
+ */
+static NSArray *PGArchiveSortedPaths(NSArray *paths)
+{
+    return [paths sortedArrayUsingComparator:^NSComparisonResult(NSString *path1, NSString *path2) {
+        return [path1 compare:path2 options:NSLiteralSearch];
+    }];
+}
+
+
+/*!
+ @abstract Returns an error describing a malformed archive or catalog file.
+ @return The error.
+ */
+static NSError *PGArchiveMalformedError(void)
+{
+    return [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperMalformedArchiveError userInfo:nil];
+}
+
+
+#pragma mark - Pipeline
+
+/*!
+ @abstract PGArchiveFile instances own a file descriptor that is shared by the chunks of one file in a pipeline.
+ @discussion The file descriptor is closed when the instance is deallocated, i.e., once the last of the file's chunks has been processed.
+ */
+@interface PGArchiveFile : NSObject
+
+/*! @abstract The file descriptor. */
+@property(readonly) int fileDescriptor;
+
+/*!
+ @abstract Initializes a newly allocated file with the specified file descriptor, which it takes ownership of.
+ @param fileDescriptor The file descriptor.
+ @return An initialized file.
+ */
+- (id)initWithFileDescriptor:(int)fileDescriptor;
+
+@end
+
+
+@implementation PGArchiveFile
+
+@synthesize fileDescriptor = _fileDescriptor;
+
+- (id)initWithFileDescriptor:(int)fileDescriptor
+{
+    if (!(self = [super init])) return nil;
+    _fileDescriptor = fileDescriptor;
+    return self;
+}
+
+
+- (void)dealloc
+{
+    close(_fileDescriptor);
+}
+
+@end
+
+
+/*!
+ @abstract PGArchiveSlot instances hold the buffers and state of one chunk in flight in a pipeline.
+ @discussion A slot's buffers are allocated once and reused for every chunk that passes through it. A slot is only accessed by one thread at a
+     time: the thread that filled it hands it off to a worker, which hands it off to the writer or back to the pool of free slots.
+ */
+@interface PGArchiveSlot : NSObject
+
+/*! @abstract The buffer holding a chunk's bytes as they are in the source: a file's contents when archiving, or stored bytes when extracting. */
+@property(readonly) uint8_t *inputBuffer;
+
+/*! @abstract The buffer holding a chunk's bytes as they are written: compressed bytes when archiving, or a file's contents when extracting. */
+@property(readonly) uint8_t *outputBuffer;
+
+/*! @abstract The capacity of the output buffer. */
+@property(readonly) size_t outputCapacity;
+
+/*! @abstract A record to write before or instead of the slot's chunk, or nil if there is none. Only used when archiving. */
+@property(readwrite, strong) NSData *recordData;
+
+/*! @abstract The file from or to which the chunk is read or written, or nil if the slot only holds a record. */
+@property(readwrite, strong) PGArchiveFile *file;
+
+/*! @abstract The offset of the chunk in its file. */
+@property(readwrite) uint64_t offset;
+
+/*! @abstract The number of bytes of the file the chunk covers. */
+@property(readwrite) size_t length;
+
+/*! @abstract The chunk's header. */
+@property(readwrite) PGArchiveChunkHeader chunkHeader;
+
+/*! @abstract Whether the slot marks the end of the archive. */
+@property(readwrite, getter = isEnd) BOOL end;
+
+/*! @abstract Signaled once a worker has finished with the slot's chunk. Only used when archiving. */
+@property(readonly) dispatch_semaphore_t readySemaphore;
+
+/*!
+ @abstract Initializes a newly allocated slot with buffers of the specified sizes.
+ @param inputCapacity The capacity of the input buffer.
+ @param outputCapacity The capacity of the output buffer.
+ @return An initialized slot, or nil if the buffers could not be allocated.
+ */
+- (id)initWithInputCapacity:(size_t)inputCapacity outputCapacity:(size_t)outputCapacity;
+
+@end
+
+
+@implementation PGArchiveSlot
+
+@synthesize inputBuffer = _inputBuffer;
+@synthesize outputBuffer = _outputBuffer;
+@synthesize outputCapacity = _outputCapacity;
+@synthesize recordData = _recordData;
+@synthesize file = _file;
+@synthesize offset = _offset;
+@synthesize length = _length;
+@synthesize chunkHeader = _chunkHeader;
+@synthesize end = _end;
+@synthesize readySemaphore = _readySemaphore;
+
+- (id)initWithInputCapacity:(size_t)inputCapacity outputCapacity:(size_t)outputCapacity
+{
+    if (!(self = [super init])) return nil;
+    
+    _inputBuffer = malloc(inputCapacity);
+    _outputBuffer = malloc(outputCapacity);
+    _outputCapacity = outputCapacity;
+    _readySemaphore = dispatch_semaphore_create(0);
+    if (!_inputBuffer || !_outputBuffer) return nil;
+    
+    return self;
+}
+
+
+- (void)dealloc
+{
+    free(_inputBuffer);
+    free(_outputBuffer);
+    dispatch_release(_readySemaphore);
+}
+
+@end
+
+
+#pragma mark - Catalogs
+
+@interface PGArchiveCatalog ()
+
+/*!
+ @abstract Initializes a newly allocated catalog with the specified entries.
+ @param entries The file entries, keyed by relative path. Each is a dictionary with size, modification date, and permissions keys. May not be nil.
+ @param directoryRelativePaths The relative paths of the catalog's directories. May not be nil.
+ @param excludedRelativePaths The relative paths excluded from the catalog. May not be nil.
+ @return An initialized catalog.
+ */
+- (id)initWithEntries:(NSDictionary *)entries directoryRelativePaths:(NSArray *)directoryRelativePaths excludedRelativePaths:(NSSet *)excludedRelativePaths;
+
+/*!
+ @abstract Initializes a newly allocated catalog with the specified catalog data, as written to an archive or catalog file.
+ @param data The catalog data. May not be nil.
+ @return An initialized catalog, or nil if the data is malformed.
+ */
+- (id)initWithData:(NSData *)data;
+
+/*!
+ @abstract Returns the catalog as a binary property list, as written to an archive or catalog file.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ @return The catalog data, or nil if it could not be serialized.
+ */
+- (NSData *)dataRepresentation:(NSError **)errorOut;
+
+/*!
+ @abstract Returns the recorded POSIX permissions of the file at the specified path.
+ @param relativePath The file's path relative to the catalog's directory. May not be nil.
+ @return The file's permissions, or nil if the catalog has no such file.
+ */
+- (NSNumber *)permissionsForRelativePath:(NSString *)relativePath;
+
+@end
+
+
+@implementation PGArchiveCatalog {
+    // File entries keyed by relative path
+    NSDictionary *_entries;
+}
+
+// There’s no meaningful default values for our designated initializer, so we just don't recognize the -init message.
+- (id)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    return nil;
+}
+
+
+- (id)initWithEntries:(NSDictionary *)entries directoryRelativePaths:(NSArray *)directoryRelativePaths excludedRelativePaths:(NSSet *)excludedRelativePaths
+{
+    if (!(self = [super init])) return nil;
+    
+    _entries = [entries copy];
+    _relativePaths = PGArchiveSortedPaths([entries allKeys]);
+    _directoryRelativePaths = PGArchiveSortedPaths(directoryRelativePaths);
+    _excludedRelativePaths = [excludedRelativePaths copy];
+    return self;
+}
+
+
+- (id)initWithData:(NSData *)data
+{
+    NSDictionary *plist = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:NULL];
+    if (![plist isKindOfClass:[NSDictionary class]] || [[plist objectForKey:PGVersionArchiveCatalogKey] unsignedIntegerValue] != PGArchiveCatalogVersion) {
+        return nil;
+    }
+    
+    NSDictionary *entries = [plist objectForKey:PGFilesArchiveCatalogKey];
+    NSArray *directoryRelativePaths = [plist objectForKey:PGDirectoriesArchiveCatalogKey];
+    NSArray *excludedRelativePaths = [plist objectForKey:PGExcludedPathsArchiveCatalogKey];
+    if (![entries isKindOfClass:[NSDictionary class]] || ![directoryRelativePaths isKindOfClass:[NSArray class]] || 
+        ![excludedRelativePaths isKindOfClass:[NSArray class]]) {
+        return nil;
+    }
+    
+    // Catalogs decide which files an incremental extraction removes, so every path must be safe, not just those with records
+    for (NSString *relativePath in entries) {
+        NSDictionary *entry = [entries objectForKey:relativePath];
+        if (!PGArchiveIsSafeRelativePath(relativePath) || ![entry isKindOfClass:[NSDictionary class]] || 
+            ![[entry objectForKey:PGSizeArchiveCatalogEntryKey] isKindOfClass:[NSNumber class]] ||
+            ![[entry objectForKey:PGModificationDateArchiveCatalogEntryKey] isKindOfClass:[NSDate class]] ||
+            ![[entry objectForKey:PGPermissionsArchiveCatalogEntryKey] isKindOfClass:[NSNumber class]]) {
+            return nil;
+        }
+    }
+    
+    for (NSArray *paths in [NSArray arrayWithObjects:directoryRelativePaths, excludedRelativePaths, nil]) {
+        for (NSString *relativePath in paths) {
+            if (![relativePath isKindOfClass:[NSString class]] || !PGArchiveIsSafeRelativePath(relativePath)) return nil;
+        }
+    }
+    
+    return [self initWithEntries:entries directoryRelativePaths:directoryRelativePaths 
+           excludedRelativePaths:[NSSet setWithArray:excludedRelativePaths]];
+}
+
+
+- (id)initWithContentsOfFile:(NSString *)path error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    
+    NSData *data = [NSData dataWithContentsOfFile:path options:0 error:errorOut];
+    if (!data) return nil;
+    
+    self = [self initWithData:data];
+    if (!self && errorOut) *errorOut = PGArchiveMalformedError();
+    return self;
+}
+
+
+- (NSData *)dataRepresentation:(NSError **)errorOut
+{
+    NSDictionary *plist = [NSDictionary dictionaryWithObjectsAndKeys:[NSNumber numberWithUnsignedInteger:PGArchiveCatalogVersion], 
+                           PGVersionArchiveCatalogKey, _entries, PGFilesArchiveCatalogKey, _directoryRelativePaths, PGDirectoriesArchiveCatalogKey,
+                           PGArchiveSortedPaths([_excludedRelativePaths allObjects]), PGExcludedPathsArchiveCatalogKey, nil];
+    return [NSPropertyListSerialization dataWithPropertyList:plist format:NSPropertyListBinaryFormat_v1_0 options:0 error:errorOut];
+}
+
+
+- (BOOL)writeToFile:(NSString *)path error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    
+    NSError *error = nil;
+    NSData *data = [self dataRepresentation:&error];
+    if (!data || ![data writeToFile:path options:NSDataWritingAtomic error:&error]) {
+        if (errorOut) *errorOut = error;
+        return NO;
+    }
+    
+    return YES;
+}
+
+
+- (unsigned long long)sizeForRelativePath:(NSString *)relativePath
+{
+    return [[[_entries objectForKey:relativePath] objectForKey:PGSizeArchiveCatalogEntryKey] unsignedLongLongValue];
+}
+
+
+- (NSDate *)modificationDateForRelativePath:(NSString *)relativePath
+{
+    return [[_entries objectForKey:relativePath] objectForKey:PGModificationDateArchiveCatalogEntryKey];
+}
+
+
+- (NSNumber *)permissionsForRelativePath:(NSString *)relativePath
+{
+    return [[_entries objectForKey:relativePath] objectForKey:PGPermissionsArchiveCatalogEntryKey];
+}
+
+@end
+
+
+#pragma mark - Private Methods Interface
+
+@interface PGArchiver ()
+
+/*!
+ @abstract Returns the catalog of the specified directory.
+ 
+ @param path The path of the directory. May not be nil.
+ @param excludedRelativePaths The relative paths to exclude. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The catalog, or nil if the directory could not be read.
+ */
++ (PGArchiveCatalog *)catalogOfDirectoryAtPath:(NSString *)path excludedRelativePaths:(NSSet *)excludedRelativePaths error:(NSError **)errorOut;
+
+/*!
+ @abstract Returns newly allocated slots with buffers of the specified sizes.
+ 
+ @param count The number of slots.
+ @param inputCapacity The capacity of each slot's input buffer.
+ @param outputCapacity The capacity of each slot's output buffer.
+ 
+ @return The slots, or nil if their buffers could not be allocated.
+ */
++ (NSArray *)slotsWithCount:(NSUInteger)count inputCapacity:(size_t)inputCapacity outputCapacity:(size_t)outputCapacity;
+
+/*!
+ @abstract Moves the files extracted from an incremental archive into place and removes the files its catalog doesn't list.
+ 
+ @param stagingPath The path of the directory the changed files were extracted to. May not be nil.
+ @param path The path of the directory to update. May not be nil.
+ @param changedRelativePaths The relative paths of the extracted files. May not be nil.
+ @param catalog The archive's catalog. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the directory was updated.
+ */
++ (BOOL)applyExtractedFilesAtPath:(NSString *)stagingPath toDirectoryAtPath:(NSString *)path changedRelativePaths:(NSArray *)changedRelativePaths
+                           catalog:(PGArchiveCatalog *)catalog error:(NSError **)errorOut;
+
+@end
+
+
+#pragma mark -
+
+@implementation PGArchiver
+
+@synthesize chunkSize = _chunkSize;
+@synthesize maximumBufferedChunkCount = _maximumBufferedChunkCount;
+@synthesize compressionLevel = _compressionLevel;
+
+- (id)init
+{
+    if (!(self = [super init])) return nil;
+    
+    _chunkSize = PGArchiverDefaultChunkSize;
+    _maximumBufferedChunkCount = 2 * [[NSProcessInfo processInfo] activeProcessorCount];
+    _compressionLevel = Z_BEST_SPEED;
+    return self;
+}
+
+
+#pragma mark Archiving
+
++ (PGArchiveCatalog *)catalogOfDirectoryAtPath:(NSString *)path excludedRelativePaths:(NSSet *)excludedRelativePaths error:(NSError **)errorOut
+{
+    BOOL isDirectory = NO;
+    if (![[NSFileManager defaultManager] fileExistsAtPath:path isDirectory:&isDirectory] || !isDirectory) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileNoSuchFileError userInfo:nil];
+        return nil;
+    }
+    
+    // As with manifests, anything but regular files and directories, e.g., a symbolic link, is left out
+    NSMutableDictionary *entries = [NSMutableDictionary dictionary];
+    NSMutableArray *directoryRelativePaths = [NSMutableArray array];
+    NSDirectoryEnumerator *enumerator = [[NSFileManager defaultManager] enumeratorAtPath:path];
+    for (NSString *relativePath in enumerator) {
+        NSDictionary *attributes = [enumerator fileAttributes];
+        if ([excludedRelativePaths containsObject:relativePath]) {
+            if ([[attributes fileType] isEqualToString:NSFileTypeDirectory]) [enumerator skipDescendants];
+            continue;
+        }
+        
+        if ([[attributes fileType] isEqualToString:NSFileTypeDirectory]) {
+            [directoryRelativePaths addObject:relativePath];
+        } else if ([[attributes fileType] isEqualToString:NSFileTypeRegular]) {
+            NSDictionary *entry = [NSDictionary dictionaryWithObjectsAndKeys:[NSNumber numberWithUnsignedLongLong:[attributes fileSize]], 
+                                   PGSizeArchiveCatalogEntryKey, [attributes fileModificationDate], PGModificationDateArchiveCatalogEntryKey, 
+                                   [NSNumber numberWithUnsignedShort:[attributes filePosixPermissions]], PGPermissionsArchiveCatalogEntryKey, nil];
+            [entries setObject:entry forKey:relativePath];
+        }
+    }
+    
+    return [[PGArchiveCatalog alloc] initWithEntries:entries directoryRelativePaths:directoryRelativePaths excludedRelativePaths:excludedRelativePaths];
+}
+
+
++ (NSArray *)slotsWithCount:(NSUInteger)count inputCapacity:(size_t)inputCapacity outputCapacity:(size_t)outputCapacity
+{
+    NSMutableArray *slots = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; ++i) {
+        PGArchiveSlot *slot = [[PGArchiveSlot alloc] initWithInputCapacity:inputCapacity outputCapacity:outputCapacity];
+        if (!slot) return nil;
+        [slots addObject:slot];
+    }
+    
+    return slots;
+}
+
+
+- (PGArchiveCatalog *)archiveDirectoryAtPath:(NSString *)path toFileDescriptor:(int)fileDescriptor excludedRelativePaths:(NSSet *)excludedRelativePaths 
+                                 baseCatalog:(PGArchiveCatalog *)baseCatalog error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    
+    PGArchiveCatalog *catalog = [[self class] catalogOfDirectoryAtPath:path excludedRelativePaths:excludedRelativePaths ? excludedRelativePaths : [NSSet set]
+                                                                 error:errorOut];
+    if (!catalog) return nil;
+    
+    NSError *error = nil;
+    NSData *catalogData = [catalog dataRepresentation:&error];
+    if (!catalogData) {
+        if (errorOut) *errorOut = error;
+        return nil;
+    }
+    
+    size_t chunkSize = MAX(1, MIN([self chunkSize], PGArchiveMaximumChunkSize));
+    NSUInteger slotCount = MAX(1, [self maximumBufferedChunkCount]);
+    int compressionLevel = [self compressionLevel];
+    
+    NSArray *slots = [[self class] slotsWithCount:slotCount inputCapacity:chunkSize outputCapacity:compressBound(chunkSize)];
+    if (!slots) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOMEM userInfo:nil];
+        return nil;
+    }
+    
+    PGArchiveHeader header = { { PGArchiveMagic[0], PGArchiveMagic[1], PGArchiveMagic[2], PGArchiveMagic[3] }, 
+                               CFSwapInt32HostToLittle(PGArchiveVersion), CFSwapInt32HostToLittle(baseCatalog ? PGArchiveIncrementalFlag : 0),
+                               CFSwapInt32HostToLittle((uint32_t)chunkSize) };
+    int errorNumber = PGArchiveWriteFully(fileDescriptor, &header, sizeof(header));
+    if (errorNumber != 0) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errorNumber userInfo:nil];
+        return nil;
+    }
+    
+    // The first error from any stage of the pipeline. Once it's set, the writer stops writing and no more chunks are handed out.
+    __block int pipelineErrorNumber = 0;
+    dispatch_semaphore_t freeSemaphore = dispatch_semaphore_create(slotCount);
+    dispatch_group_t writerGroup = dispatch_group_create();
+    dispatch_queue_t workerQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    
+    // The writer takes slots in the order they were handed out, so the archive is in order even though workers finish out of order
+    dispatch_group_async(writerGroup, workerQueue, ^{
+        for (NSUInteger sequenceNumber = 0; ; ++sequenceNumber) {
+            PGArchiveSlot *slot = [slots objectAtIndex:sequenceNumber % slotCount];
+            dispatch_semaphore_wait([slot readySemaphore], DISPATCH_TIME_FOREVER);
+            
+            int writeErrorNumber = 0;
+            @synchronized (slots) {
+                writeErrorNumber = pipelineErrorNumber;
+            }
+            
+            if (writeErrorNumber == 0 && [slot recordData]) {
+                writeErrorNumber = PGArchiveWriteFully(fileDescriptor, [[slot recordData] bytes], [[slot recordData] length]);
+            }
+            
+            if (writeErrorNumber == 0 && [slot file]) {
+                PGArchiveChunkHeader chunkHeader = [slot chunkHeader];
+                size_t storedLength = CFSwapInt32LittleToHost(chunkHeader.storedLength);
+                BOOL compressed = (CFSwapInt32LittleToHost(chunkHeader.flags) & PGArchiveCompressedChunkFlag) != 0;
+                writeErrorNumber = PGArchiveWriteFully(fileDescriptor, &chunkHeader, sizeof(chunkHeader));
+                if (writeErrorNumber == 0) {
+                    writeErrorNumber = PGArchiveWriteFully(fileDescriptor, compressed ? [slot outputBuffer] : [slot inputBuffer], storedLength);
+                }
+            }
+            
+            if (writeErrorNumber != 0) {
+                @synchronized (slots) {
+                    if (pipelineErrorNumber == 0) pipelineErrorNumber = writeErrorNumber;
+                }
+            }
+            
+            BOOL end = [slot isEnd];
+            [slot setRecordData:nil];
+            [slot setFile:nil];
+            [slot setEnd:NO];
+            dispatch_semaphore_signal(freeSemaphore);
+            if (end) break;
+        }
+    });
+    
+    __block NSUInteger nextSequenceNumber = 0;
+    PGArchiveSlot *(^acquireSlot)(void) = ^{
+        dispatch_semaphore_wait(freeSemaphore, DISPATCH_TIME_FOREVER);
+        return (PGArchiveSlot *)[slots objectAtIndex:nextSequenceNumber++ % slotCount];
+    };
+    
+    BOOL (^hasFailed)(void) = ^{
+        BOOL failed = NO;
+        @synchronized (slots) {
+            failed = pipelineErrorNumber != 0;
+        }
+        
+        return failed;
+    };
+    
+    void (^fail)(int) = ^(int failureErrorNumber) {
+        @synchronized (slots) {
+            if (pipelineErrorNumber == 0) pipelineErrorNumber = failureErrorNumber;
+        }
+    };
+    
+    // Directories come first, so that files can be extracted into them
+    NSMutableArray *records = [NSMutableArray array];
+    for (NSString *relativePath in [catalog directoryRelativePaths]) {
+        [records addObject:[NSArray arrayWithObjects:relativePath, [NSNumber numberWithUnsignedInt:PGArchiveDirectoryRecord], nil]];
+    }
+    
+    for (NSString *relativePath in [catalog relativePaths]) {
+        // As with manifests, a file whose size and modification date haven't changed is assumed to be unchanged
+        BOOL unchanged = [[baseCatalog modificationDateForRelativePath:relativePath] isEqualToDate:[catalog modificationDateForRelativePath:relativePath]] &&
+            [baseCatalog sizeForRelativePath:relativePath] == [catalog sizeForRelativePath:relativePath];
+        [records addObject:[NSArray arrayWithObjects:relativePath, 
+                            [NSNumber numberWithUnsignedInt:unchanged ? PGArchiveUnchangedFileRecord : PGArchiveFileRecord], nil]];
+    }
+    
+    for (NSArray *record in records) {
+        if (hasFailed()) break;
+        
+        @autoreleasepool {
+            NSString *relativePath = [record objectAtIndex:0];
+            PGArchiveRecordType type = [[record objectAtIndex:1] unsignedIntValue];
+            uint64_t size = type == PGArchiveDirectoryRecord ? 0 : [catalog sizeForRelativePath:relativePath];
+            NSData *pathData = [relativePath dataUsingEncoding:NSUTF8StringEncoding];
+            
+            PGArchiveRecordHeader recordHeader = { CFSwapInt32HostToLittle(type), CFSwapInt32HostToLittle((uint32_t)[pathData length]), 
+                                                   CFSwapInt64HostToLittle(type == PGArchiveFileRecord || type == PGArchiveUnchangedFileRecord ? size : 0) };
+            NSMutableData *recordData = [NSMutableData dataWithBytes:&recordHeader length:sizeof(recordHeader)];
+            [recordData appendData:pathData];
+            
+            PGArchiveFile *file = nil;
+            if (type == PGArchiveFileRecord && size > 0) {
+                int inputFileDescriptor = open([[path stringByAppendingPathComponent:relativePath] fileSystemRepresentation], O_RDONLY);
+                if (inputFileDescriptor == -1) {
+                    fail(errno);
+                    break;
+                }
+                
+                file = [[PGArchiveFile alloc] initWithFileDescriptor:inputFileDescriptor];
+            }
+            
+            PGArchiveSlot *recordSlot = acquireSlot();
+            [recordSlot setRecordData:recordData];
+            dispatch_semaphore_signal([recordSlot readySemaphore]);
+            
+            for (uint64_t offset = 0; file && offset < size && !hasFailed(); offset += chunkSize) {
+                PGArchiveSlot *slot = acquireSlot();
+                [slot setFile:file];
+                [slot setOffset:offset];
+                [slot setLength:(size_t)MIN(chunkSize, size - offset)];
+                
+                dispatch_async(workerQueue, ^{
+                    size_t length = [slot length];
+                    size_t bytesRead = 0;
+                    while (bytesRead < length) {
+                        ssize_t result = pread([[slot file] fileDescriptor], [slot inputBuffer] + bytesRead, length - bytesRead, 
+                                               (off_t)([slot offset] + bytesRead));
+                        if (result == -1 && errno == EINTR) continue;
+                        if (result <= 0) break;
+                        bytesRead += result;
+                    }
+                    
+                    // A short read means the file shrank after it was cataloged
+                    if (bytesRead < length) {
+                        fail(errno != 0 ? errno : EIO);
+                    } else {
+                        uLongf compressedLength = [slot outputCapacity];
+                        BOOL compressed = compress2([slot outputBuffer], &compressedLength, [slot inputBuffer], length, compressionLevel) == Z_OK &&
+                            compressedLength < length;
+                        
+                        PGArchiveChunkHeader chunkHeader = { CFSwapInt32HostToLittle((uint32_t)(compressed ? compressedLength : length)), 
+                                                             CFSwapInt32HostToLittle(compressed ? PGArchiveCompressedChunkFlag : 0),
+                                                             CFSwapInt32HostToLittle((uint32_t)crc32(0, [slot inputBuffer], (uInt)length)), 0 };
+                        [slot setChunkHeader:chunkHeader];
+                    }
+                    
+                    dispatch_semaphore_signal([slot readySemaphore]);
+                });
+            }
+        }
+    }
+    
+    // The end record is handed to the writer even after a failure, since it's what stops the writer
+    PGArchiveRecordHeader endHeader = { CFSwapInt32HostToLittle(PGArchiveEndRecord), CFSwapInt32HostToLittle((uint32_t)[catalogData length]), 0 };
+    NSMutableData *endData = [NSMutableData dataWithBytes:&endHeader length:sizeof(endHeader)];
+    [endData appendData:catalogData];
+    
+    PGArchiveSlot *endSlot = acquireSlot();
+    [endSlot setRecordData:endData];
+    [endSlot setEnd:YES];
+    dispatch_semaphore_signal([endSlot readySemaphore]);
+    
+    dispatch_group_wait(writerGroup, DISPATCH_TIME_FOREVER);
+    dispatch_release(writerGroup);
+    dispatch_release(freeSemaphore);
+    
+    if (pipelineErrorNumber != 0) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:pipelineErrorNumber userInfo:nil];
+        return nil;
+    }
+    
+    return catalog;
+}
+
+
+#pragma mark Extracting
+
+- (PGArchiveCatalog *)extractArchiveFromFileDescriptor:(int)fileDescriptor toDirectoryAtPath:(NSString *)path error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    
+    PGArchiveHeader header;
+    int errorNumber = PGArchiveReadFully(fileDescriptor, &header, sizeof(header));
+    if (errorNumber != 0) {
+        if (errorOut) *errorOut = errorNumber == -1 ? PGArchiveMalformedError() : [NSError errorWithDomain:NSPOSIXErrorDomain code:errorNumber userInfo:nil];
+        return nil;
+    }
+    
+    size_t chunkSize = CFSwapInt32LittleToHost(header.chunkSize);
+    uint32_t flags = CFSwapInt32LittleToHost(header.flags);
+    if (memcmp(header.magic, PGArchiveMagic, sizeof(PGArchiveMagic)) != 0 || CFSwapInt32LittleToHost(header.version) != PGArchiveVersion ||
+        chunkSize == 0 || chunkSize > PGArchiveMaximumChunkSize || (flags & ~PGArchiveIncrementalFlag) != 0) {
+        if (errorOut) *errorOut = PGArchiveMalformedError();
+        return nil;
+    }
+    
+    // Full archives are extracted into a new directory; incremental ones are applied to an existing one
+    BOOL incremental = (flags & PGArchiveIncrementalFlag) != 0;
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    BOOL isDirectory = NO;
+    BOOL exists = [fileManager fileExistsAtPath:path isDirectory:&isDirectory];
+    if (incremental && (!exists || !isDirectory)) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileNoSuchFileError userInfo:nil];
+        return nil;
+    } else if (!incremental && exists) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteFileExistsError userInfo:nil];
+        return nil;
+    }
+    
+    // Extract into a directory beside the destination, so that moving files into place is a rename
+    NSString *stagingTemplate = [[path stringByDeletingLastPathComponent] stringByAppendingPathComponent:
+                                 [NSString stringWithFormat:@".%@.XXXXXX", [path lastPathComponent]]];
+    char *stagingPathBuffer = strdup([stagingTemplate fileSystemRepresentation]);
+    if (!mkdtemp(stagingPathBuffer)) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        free(stagingPathBuffer);
+        return nil;
+    }
+    
+    NSString *stagingPath = [fileManager stringWithFileSystemRepresentation:stagingPathBuffer length:strlen(stagingPathBuffer)];
+    free(stagingPathBuffer);
+    
+    NSUInteger slotCount = MAX(1, [self maximumBufferedChunkCount]);
+    NSMutableArray *freeSlots = [[[self class] slotsWithCount:slotCount inputCapacity:compressBound(chunkSize) outputCapacity:chunkSize] mutableCopy];
+    if (!freeSlots) {
+        [fileManager removeItemAtPath:stagingPath error:NULL];
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOMEM userInfo:nil];
+        return nil;
+    }
+    
+    // The first error from any stage of the pipeline, and whether it means the archive is malformed rather than that a system call failed
+    __block int pipelineErrorNumber = 0;
+    __block BOOL malformed = NO;
+    __block BOOL baseMismatch = NO;
+    dispatch_semaphore_t freeSemaphore = dispatch_semaphore_create(slotCount);
+    dispatch_group_t workerGroup = dispatch_group_create();
+    dispatch_queue_t workerQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    
+    void (^fail)(int, BOOL) = ^(int failureErrorNumber, BOOL failureMalformed) {
+        @synchronized (freeSlots) {
+            if (pipelineErrorNumber != 0) return;
+            pipelineErrorNumber = failureErrorNumber;
+            malformed = failureMalformed;
+        }
+    };
+    
+    BOOL (^hasFailed)(void) = ^{
+        BOOL failed = NO;
+        @synchronized (freeSlots) {
+            failed = pipelineErrorNumber != 0;
+        }
+        
+        return failed;
+    };
+    
+    NSMutableSet *recordedPaths = [NSMutableSet set];
+    NSMutableArray *changedRelativePaths = [NSMutableArray array];
+    NSData *catalogData = nil;
+    while (!hasFailed()) {
+        @autoreleasepool {
+            PGArchiveRecordHeader recordHeader;
+            errorNumber = PGArchiveReadFully(fileDescriptor, &recordHeader, sizeof(recordHeader));
+            if (errorNumber != 0) {
+                fail(errorNumber == -1 ? EIO : errorNumber, errorNumber == -1);
+                break;
+            }
+            
+            PGArchiveRecordType type = CFSwapInt32LittleToHost(recordHeader.type);
+            uint32_t pathLength = CFSwapInt32LittleToHost(recordHeader.pathLength);
+            uint64_t size = CFSwapInt64LittleToHost(recordHeader.size);
+            
+            if (type == PGArchiveEndRecord) {
+                if (pathLength > PGArchiveMaximumCatalogLength) {
+                    fail(EIO, YES);
+                    break;
+                }
+                
+                NSMutableData *data = [NSMutableData dataWithLength:pathLength];
+                errorNumber = PGArchiveReadFully(fileDescriptor, [data mutableBytes], pathLength);
+                if (errorNumber != 0) fail(errorNumber == -1 ? EIO : errorNumber, errorNumber == -1);
+                else catalogData = data;
+                break;
+            }
+            
+            if (type > PGArchiveDirectoryRecord || (type == PGArchiveUnchangedFileRecord && !incremental) || pathLength > PGArchiveMaximumPathLength) {
+                fail(EIO, YES);
+                break;
+            }
+            
+            NSMutableData *pathData = [NSMutableData dataWithLength:pathLength];
+            errorNumber = PGArchiveReadFully(fileDescriptor, [pathData mutableBytes], pathLength);
+            if (errorNumber != 0) {
+                fail(errorNumber == -1 ? EIO : errorNumber, errorNumber == -1);
+                break;
+            }
+            
+            // Never write outside the staging directory, whatever the archive says
+            NSString *relativePath = [[NSString alloc] initWithData:pathData encoding:NSUTF8StringEncoding];
+            if (!relativePath || !PGArchiveIsSafeRelativePath(relativePath) || [recordedPaths containsObject:relativePath]) {
+                fail(EIO, YES);
+                break;
+            }
+            
+            [recordedPaths addObject:relativePath];
+            NSString *stagedPath = [stagingPath stringByAppendingPathComponent:relativePath];
+            
+            if (type == PGArchiveDirectoryRecord) {
+                NSError *directoryError = nil;
+                if (![fileManager createDirectoryAtPath:stagedPath withIntermediateDirectories:YES attributes:nil error:&directoryError]) {
+                    fail([[directoryError domain] isEqualToString:NSPOSIXErrorDomain] ? (int)[directoryError code] : EIO, NO);
+                }
+                
+                continue;
+            } else if (type == PGArchiveUnchangedFileRecord) {
+                // The file must already be there from the base archive
+                struct stat fileStatus;
+                if (lstat([[path stringByAppendingPathComponent:relativePath] fileSystemRepresentation], &fileStatus) == -1 || 
+                    !S_ISREG(fileStatus.st_mode) || (uint64_t)fileStatus.st_size != size) {
+                    @synchronized (freeSlots) {
+                        baseMismatch = YES;
+                    }
+                    
+                    fail(ENOENT, NO);
+                }
+                
+                continue;
+            }
+            
+            [fileManager createDirectoryAtPath:[stagedPath stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil 
+                                         error:NULL];
+            int outputFileDescriptor = open([stagedPath fileSystemRepresentation], O_WRONLY | O_CREAT | O_EXCL, 0600);
+            if (outputFileDescriptor == -1 || ftruncate(outputFileDescriptor, (off_t)size) == -1) {
+                fail(errno, NO);
+                if (outputFileDescriptor != -1) close(outputFileDescriptor);
+                break;
+            }
+            
+            PGArchiveFile *file = [[PGArchiveFile alloc] initWithFileDescriptor:outputFileDescriptor];
+            [changedRelativePaths addObject:relativePath];
+            
+            for (uint64_t offset = 0; offset < size && !hasFailed(); offset += chunkSize) {
+                PGArchiveChunkHeader chunkHeader;
+                errorNumber = PGArchiveReadFully(fileDescriptor, &chunkHeader, sizeof(chunkHeader));
+                if (errorNumber != 0) {
+                    fail(errorNumber == -1 ? EIO : errorNumber, errorNumber == -1);
+                    break;
+                }
+                
+                size_t length = (size_t)MIN(chunkSize, size - offset);
+                size_t storedLength = CFSwapInt32LittleToHost(chunkHeader.storedLength);
+                BOOL compressed = (CFSwapInt32LittleToHost(chunkHeader.flags) & PGArchiveCompressedChunkFlag) != 0;
+                if (storedLength > compressBound(chunkSize) || (!compressed && storedLength != length)) {
+                    fail(EIO, YES);
+                    break;
+                }
+                
+                dispatch_semaphore_wait(freeSemaphore, DISPATCH_TIME_FOREVER);
+                PGArchiveSlot *slot = nil;
+                @synchronized (freeSlots) {
+                    slot = [freeSlots lastObject];
+                    [freeSlots removeLastObject];
+                }
+                
+                errorNumber = PGArchiveReadFully(fileDescriptor, [slot inputBuffer], storedLength);
+                if (errorNumber != 0) {
+                    fail(errorNumber == -1 ? EIO : errorNumber, errorNumber == -1);
+                    @synchronized (freeSlots) {
+                        [freeSlots addObject:slot];
+                    }
+                    
+                    dispatch_semaphore_signal(freeSemaphore);
+                    break;
+                }
+                
+                [slot setFile:file];
+                [slot setOffset:offset];
+                [slot setLength:length];
+                [slot setChunkHeader:chunkHeader];
+                
+                dispatch_group_async(workerGroup, workerQueue, ^{
+                    const uint8_t *bytes = [slot inputBuffer];
+                    uLongf uncompressedLength = length;
+                    if (compressed) {
+                        bytes = [slot outputBuffer];
+                        if (uncompress([slot outputBuffer], &uncompressedLength, [slot inputBuffer], storedLength) != Z_OK) uncompressedLength = 0;
+                    }
+                    
+                    if (uncompressedLength != length || crc32(0, bytes, (uInt)length) != CFSwapInt32LittleToHost([slot chunkHeader].checksum)) {
+                        fail(EIO, YES);
+                    } else {
+                        size_t bytesWritten = 0;
+                        while (bytesWritten < length) {
+                            ssize_t result = pwrite([[slot file] fileDescriptor], bytes + bytesWritten, length - bytesWritten, 
+                                                    (off_t)([slot offset] + bytesWritten));
+                            if (result == -1 && errno == EINTR) continue;
+                            if (result == -1) {
+                                fail(errno, NO);
+                                break;
+                            }
+                            
+                            bytesWritten += result;
+                        }
+                    }
+                    
+                    [slot setFile:nil];
+                    @synchronized (freeSlots) {
+                        [freeSlots addObject:slot];
+                    }
+                    
+                    dispatch_semaphore_signal(freeSemaphore);
+                });
+            }
+        }
+    }
+    
+    dispatch_group_wait(workerGroup, DISPATCH_TIME_FOREVER);
+    dispatch_release(workerGroup);
+    dispatch_release(freeSemaphore);
+    
+    // Every record must be in the catalog, and every file in the catalog must have had a record
+    PGArchiveCatalog *catalog = nil;
+    if (pipelineErrorNumber == 0) {
+        catalog = [[PGArchiveCatalog alloc] initWithData:catalogData];
+        NSUInteger recordCount = [[catalog relativePaths] count] + [[catalog directoryRelativePaths] count];
+        BOOL matches = catalog && [recordedPaths count] == recordCount;
+        for (NSArray *paths in [NSArray arrayWithObjects:[catalog relativePaths], [catalog directoryRelativePaths], nil]) {
+            for (NSString *relativePath in paths) {
+                if (!matches) break;
+                matches = [recordedPaths containsObject:relativePath];
+            }
+        }
+        
+        if (!matches) fail(EIO, YES);
+    }
+    
+    NSError *error = nil;
+    if (pipelineErrorNumber == 0) {
+        for (NSString *relativePath in changedRelativePaths) {
+            NSDictionary *attributes = [NSDictionary dictionaryWithObjectsAndKeys:[catalog modificationDateForRelativePath:relativePath], 
+                                        NSFileModificationDate, [catalog permissionsForRelativePath:relativePath], NSFilePosixPermissions, nil];
+            if (![fileManager setAttributes:attributes ofItemAtPath:[stagingPath stringByAppendingPathComponent:relativePath] error:&error]) break;
+        }
+        
+        if (!error) {
+            if (incremental) {
+                [[self class] applyExtractedFilesAtPath:stagingPath toDirectoryAtPath:path changedRelativePaths:changedRelativePaths catalog:catalog 
+                                                  error:&error];
+            } else {
+                [fileManager moveItemAtPath:stagingPath toPath:path error:&error];
+            }
+        }
+    } else if (baseMismatch) {
+        error = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperArchiveBaseMismatchError userInfo:nil];
+    } else if (malformed) {
+        error = PGArchiveMalformedError();
+    } else {
+        error = [NSError errorWithDomain:NSPOSIXErrorDomain code:pipelineErrorNumber userInfo:nil];
+    }
+    
+    [fileManager removeItemAtPath:stagingPath error:NULL];
+    if (error) {
+        if (errorOut) *errorOut = error;
+        return nil;
+    }
+    
+    return catalog;
+}
+
+
++ (BOOL)applyExtractedFilesAtPath:(NSString *)stagingPath toDirectoryAtPath:(NSString *)path changedRelativePaths:(NSArray *)changedRelativePaths
+                          catalog:(PGArchiveCatalog *)catalog error:(NSError **)errorOut
+{
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    for (NSString *relativePath in [catalog directoryRelativePaths]) {
+        NSString *directoryPath = [path stringByAppendingPathComponent:relativePath];
+        if (![fileManager createDirectoryAtPath:directoryPath withIntermediateDirectories:YES attributes:nil error:errorOut]) return NO;
+    }
+    
+    // rename(2) replaces each file atomically, so a reader sees either the old file or the new one
+    for (NSString *relativePath in changedRelativePaths) {
+        NSString *destinationPath = [path stringByAppendingPathComponent:relativePath];
+        if (rename([[stagingPath stringByAppendingPathComponent:relativePath] fileSystemRepresentation], 
+                   [destinationPath fileSystemRepresentation]) == -1) {
+            if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            return NO;
+        }
+    }
+    
+    // Remove files that were deleted since the base archive, leaving the excluded paths alone
+    NSSet *relativePaths = [NSSet setWithArray:[catalog relativePaths]];
+    NSMutableArray *removedPaths = [NSMutableArray array];
+    NSDirectoryEnumerator *enumerator = [fileManager enumeratorAtPath:path];
+    for (NSString *relativePath in enumerator) {
+        NSDictionary *attributes = [enumerator fileAttributes];
+        if (PGArchiveIsExcludedRelativePath(relativePath, [catalog excludedRelativePaths])) {
+            if ([[attributes fileType] isEqualToString:NSFileTypeDirectory]) [enumerator skipDescendants];
+            continue;
+        }
+        
+        if ([[attributes fileType] isEqualToString:NSFileTypeRegular] && ![relativePaths containsObject:relativePath]) {
+            [removedPaths addObject:relativePath];
+        }
+    }
+    
+    for (NSString *relativePath in removedPaths) {
+        if (![fileManager removeItemAtPath:[path stringByAppendingPathComponent:relativePath] error:errorOut]) return NO;
+    }
+    
+    return YES;
+}
+
+@end
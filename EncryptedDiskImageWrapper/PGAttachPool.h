@@ -0,0 +1,158 @@
+//
+//  PGAttachPool.h
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+@class PGAttachPool;
+@class PGEncryptedDiskImageWrapper;
+
+/*!
+ @abstract PGAttachLease instances represent a claim on a wrapper's mount point that was handed out by an attach pool.
+ @discussion The wrapper's disk image stays attached at least as long as the lease is held. Relinquish leases as soon as you're done with the mount
+     point. Leases that are deallocated without being relinquished are relinquished automatically.
+ */
+@interface PGAttachLease : NSObject
+
+/*! @abstract The attach pool that handed out the lease. */
+@property(readonly, strong) PGAttachPool *attachPool;
+
+/*! @abstract The standardized path of the leased wrapper. */
+@property(readonly, copy) NSString *wrapperPath;
+
+/*! @abstract The mount point of the leased wrapper's disk image. */
+@property(readonly, copy) NSString *mountPoint;
+
+/*!
+ @abstract Relinquishes the lease.
+ @discussion Once a wrapper has no leases, the pool detaches its disk image after the pool's idle timeout. Relinquishing a lease more than once has 
+     no effect.
+ */
+- (void)relinquish;
+
+/*!
+ @abstract Returns whether the lease has been relinquished.
+ @return Whether -relinquish has been invoked on the lease.
+ */
+- (BOOL)isRelinquished;
+
+@end
+
+
+/*!
+ @abstract PGAttachPool instances share attached encrypted disk images among their users.
+ @discussion Attach pools hand out reference-counted leases on wrappers' mount points, keyed by wrapper path. The first lease on a wrapper attaches
+     its disk image at a random subdirectory of the pool's mount root; lease requests that arrive while that attach is in progress wait for it rather
+     than running hdiutil again. Leases on wrappers that are already attached are handed out immediately. Once all of a wrapper's leases have been
+     relinquished, the pool waits for its idle timeout to pass before detaching the disk image, so that wrappers that are used repeatedly aren't
+     attached and detached each time.
+ 
+     Requests that are handed an already attached or attaching disk image count as hits; those that cause hdiutil to attach one count as misses.
+ 
+     Wrappers attached by a pool should not be attached or detached directly. The wrapper instance used to attach a disk image is the one passed
+     with the request that caused the attach; others with the same path are only used for their path. Attach pools are thread-safe.
+ */
+@interface PGAttachPool : NSObject
+
+/*! @abstract The directory in which the pool mounts disk images. */
+@property(readonly, copy) NSString *mountRoot;
+
+/*! @abstract The number of seconds a wrapper with no leases stays attached before it is detached. Defaults to 30. */
+@property(readwrite) NSTimeInterval idleTimeout;
+
+/*! @abstract The timeout of the pool's hdiutil tasks. If 0, the default, there is no timeout. */
+@property(readwrite) NSTimeInterval taskTimeout;
+
+/*!
+ @abstract Returns the process-wide attach pool.
+ @return The shared attach pool, which mounts disk images in the user's temporary directory.
+ */
++ (PGAttachPool *)sharedAttachPool;
+
+/*!
+ @abstract Initializes a newly allocated attach pool that mounts disk images in the specified directory.
+ @param mountRoot The directory in which to mount disk images. May not be nil.
+ @return An initialized attach pool.
+ */
+- (id)initWithMountRoot:(NSString *)mountRoot;
+
+/*!
+ @abstract Leases the mount point of the specified wrapper, attaching its disk image if necessary, and returns immediately.
+ @discussion The completion handler is invoked on an arbitrary queue once the lease is available.
+ 
+ @param wrapper The wrapper to lease. Must be authenticated and use the disk image backend. May not be nil.
+ @param handler The block to invoke with the lease. If the wrapper couldn't be attached, lease is nil and error describes the failure. May not be nil.
+ */
+- (void)leaseMountForWrapper:(PGEncryptedDiskImageWrapper *)wrapper completionHandler:(void (^)(PGAttachLease *lease, NSError *error))handler;
+
+/*!
+ @abstract Leases the mount point of the specified wrapper, attaching its disk image if necessary, and waits for the lease to be available.
+ 
+ @param wrapper The wrapper to lease. Must be authenticated and use the disk image backend. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The lease, or nil if the wrapper couldn't be attached.
+ */
+- (PGAttachLease *)leaseMountForWrapper:(PGEncryptedDiskImageWrapper *)wrapper error:(NSError **)errorOut;
+
+/*!
+ @abstract Returns the number of unrelinquished leases on the wrapper at the specified path.
+ @param path The wrapper's path. May not be nil.
+ @return The number of leases.
+ */
+- (NSUInteger)leaseCountForWrapperAtPath:(NSString *)path;
+
+/*!
+ @abstract Returns the mount point of the wrapper at the specified path if the pool has attached it.
+ @param path The wrapper's path. May not be nil.
+ @return The mount point, or nil if the pool doesn't have the wrapper attached.
+ */
+- (NSString *)mountPointForWrapperAtPath:(NSString *)path;
+
+/*!
+ @abstract Detaches every attached wrapper that has no leases without waiting for the idle timeout, and waits for them to be detached.
+ @discussion Applications should invoke this before they terminate. This must not be invoked from a lease completion handler.
+ 
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether every idle wrapper was detached successfully.
+ */
+- (BOOL)detachIdleWrappers:(NSError **)errorOut;
+
+/*!
+ @abstract Returns the number of lease requests that were handed an attached or attaching disk image.
+ @return The hit count.
+ */
+- (NSUInteger)hitCount;
+
+/*!
+ @abstract Returns the number of lease requests that required hdiutil to attach a disk image.
+ @return The miss count.
+ */
+- (NSUInteger)missCount;
+
+@end
@@ -0,0 +1,509 @@
+//
+//  PGAttachPool.m
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGAttachPool.h"
+
+#import "PGEncryptedDiskImageWrapper.h"
+
+
+#pragma mark Constants
+
+/*! @abstract The default number of seconds a wrapper with no leases stays attached. */
+static const NSTimeInterval PGAttachPoolDefaultIdleTimeout = 30.0;
+
+
+#pragma mark - Entries
+
+/*!
+ @abstract Constants for indicating what state a pool's wrapper is in.
+ */
+typedef NS_ENUM(NSUInteger, PGAttachPoolEntryState) {
+    /*! @abstract The wrapper's disk image is being attached. */
+    PGAttachPoolEntryAttaching = 1,
+    
+    /*! @abstract The wrapper's disk image is attached. */
+    PGAttachPoolEntryAttached,
+    
+    /*! @abstract The wrapper's disk image is being detached. */
+    PGAttachPoolEntryDetaching
+};
+
+
+/*!
+ @abstract PGAttachPoolEntry instances track the state of a wrapper in an attach pool.
+ @discussion Entries are only accessed on their pool's queue.
+ */
+@interface PGAttachPoolEntry : NSObject
+
+/*! @abstract The wrapper used to attach and detach the disk image. */
+@property(readonly, strong) PGEncryptedDiskImageWrapper *wrapper;
+
+/*! @abstract The wrapper's state. */
+@property(readwrite) PGAttachPoolEntryState state;
+
+/*! @abstract The wrapper's mount point, or nil if it isn't attached. */
+@property(readwrite, copy) NSString *mountPoint;
+
+/*! @abstract The number of unrelinquished leases on the wrapper. */
+@property(readwrite) NSUInteger leaseCount;
+
+/*! @abstract Incremented whenever the wrapper is leased, which invalidates any pending idle detach. */
+@property(readwrite) NSUInteger idleGeneration;
+
+/*! @abstract The completion handlers of lease requests waiting for the wrapper to be attached. */
+@property(readonly, strong) NSMutableArray *pendingHandlers;
+
+/*!
+ @abstract Initializes a newly allocated entry with the specified wrapper.
+ @param wrapper The wrapper. May not be nil.
+ @return An initialized entry.
+ */
+- (id)initWithWrapper:(PGEncryptedDiskImageWrapper *)wrapper;
+
+@end
+
+
+@implementation PGAttachPoolEntry
+
+- (id)initWithWrapper:(PGEncryptedDiskImageWrapper *)wrapper
+{
+    NSAssert(wrapper, @"nil wrapper");
+    
+    if (!(self = [super init])) return nil;
+    
+    _wrapper = wrapper;
+    _pendingHandlers = [[NSMutableArray alloc] init];
+    
+    return self;
+}
+
+@end
+
+
+#pragma mark - Private Methods Interface
+
+@interface PGAttachPool ()
+
+/*!
+ @abstract Releases a lease on the wrapper at the specified path, scheduling its detach if it was the last one.
+ @param path The standardized path of the leased wrapper. May not be nil.
+ */
+- (void)relinquishLeaseForWrapperAtPath:(NSString *)path;
+
+/*!
+ @abstract Starts attaching the specified entry's wrapper.
+ @discussion Must be invoked on the pool's queue. The entry's pending handlers are invoked once the attach finishes.
+ @param entry The entry whose wrapper should be attached. May not be nil.
+ */
+- (void)attachEntry:(PGAttachPoolEntry *)entry;
+
+/*!
+ @abstract Hands out leases to the specified entry's pending handlers.
+ @discussion Must be invoked on the pool's queue while the entry's wrapper is attached.
+ @param entry The entry whose pending handlers should be invoked. May not be nil.
+ */
+- (void)grantPendingLeasesForEntry:(PGAttachPoolEntry *)entry;
+
+/*!
+ @abstract Starts detaching the specified entry's wrapper.
+ @discussion Must be invoked on the pool's queue. If lease requests arrive while the wrapper is detaching, it is attached again afterward.
+ 
+ @param entry The entry whose wrapper should be detached. May not be nil.
+ @param handler A block to invoke on the pool's queue when the detach finishes. If it failed, error describes the failure. May be nil.
+ */
+- (void)detachEntry:(PGAttachPoolEntry *)entry completionHandler:(void (^)(NSError *error))handler;
+
+/*!
+ @abstract Detaches the specified entry's wrapper after the idle timeout unless it is leased again in the meantime.
+ @discussion Must be invoked on the pool's queue.
+ @param entry The entry whose wrapper should be detached. May not be nil.
+ */
+- (void)scheduleIdleDetachForEntry:(PGAttachPoolEntry *)entry;
+
+@end
+
+
+#pragma mark - Leases
+
+@interface PGAttachLease ()
+
+/*!
+ @abstract Initializes a newly allocated lease with the specified pool, wrapper path, and mount point.
+ @param attachPool The pool that handed out the lease. May not be nil.
+ @param wrapperPath The standardized path of the leased wrapper. May not be nil.
+ @param mountPoint The wrapper's mount point. May not be nil.
+ @return An initialized lease.
+ */
+- (id)initWithAttachPool:(PGAttachPool *)attachPool wrapperPath:(NSString *)wrapperPath mountPoint:(NSString *)mountPoint;
+
+@end
+
+
+@implementation PGAttachLease
+{
+    BOOL _relinquished;
+}
+
+@synthesize attachPool = _attachPool;
+@synthesize wrapperPath = _wrapperPath;
+@synthesize mountPoint = _mountPoint;
+
+- (id)init
+{
+    // There’s no meaningful default values for our designated initializer, so we just don't recognize the -init message.
+    [self doesNotRecognizeSelector:_cmd];
+    return nil;
+}
+
+
+- (id)initWithAttachPool:(PGAttachPool *)attachPool wrapperPath:(NSString *)wrapperPath mountPoint:(NSString *)mountPoint
+{
+    NSAssert(attachPool, @"nil attach pool");
+    NSAssert(wrapperPath, @"nil wrapper path");
+    NSAssert(mountPoint, @"nil mount point");
+    
+    if (!(self = [super init])) return nil;
+    
+    _attachPool = attachPool;
+    _wrapperPath = [wrapperPath copy];
+    _mountPoint = [mountPoint copy];
+    
+    return self;
+}
+
+
+- (void)dealloc
+{
+    if (!_relinquished) [_attachPool relinquishLeaseForWrapperAtPath:_wrapperPath];
+}
+
+
+- (void)relinquish
+{
+    @synchronized (self) {
+        if (_relinquished) return;
+        _relinquished = YES;
+    }
+    
+    [_attachPool relinquishLeaseForWrapperAtPath:_wrapperPath];
+}
+
+
+- (BOOL)isRelinquished
+{
+    @synchronized (self) {
+        return _relinquished;
+    }
+}
+
+@end
+
+
+#pragma mark -
+
+@implementation PGAttachPool
+{
+    dispatch_queue_t _queue;
+    NSMutableDictionary *_entries;
+    NSUInteger _hitCount;
+    NSUInteger _missCount;
+}
+
+@synthesize mountRoot = _mountRoot;
+@synthesize idleTimeout = _idleTimeout;
+@synthesize taskTimeout = _taskTimeout;
+
++ (PGAttachPool *)sharedAttachPool
+{
+    static PGAttachPool *sharedAttachPool = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedAttachPool = [[PGAttachPool alloc] initWithMountRoot:NSTemporaryDirectory()];
+    });
+    
+    return sharedAttachPool;
+}
+
+
+- (id)init
+{
+    // There’s no meaningful default values for our designated initializer, so we just don't recognize the -init message.
+    [self doesNotRecognizeSelector:_cmd];
+    return nil;
+}
+
+
+- (id)initWithMountRoot:(NSString *)mountRoot
+{
+    NSAssert(mountRoot, @"nil mount root");
+    
+    if (!(self = [super init])) return nil;
+    
+    _mountRoot = [mountRoot copy];
+    _idleTimeout = PGAttachPoolDefaultIdleTimeout;
+    _queue = dispatch_queue_create("com.quantumlenscap.PGAttachPool", DISPATCH_QUEUE_SERIAL);
+    _entries = [[NSMutableDictionary alloc] init];
+    
+    return self;
+}
+
+
+- (void)dealloc
+{
+    dispatch_release(_queue);
+}
+
+
+#pragma mark Leasing
+
+- (void)leaseMountForWrapper:(PGEncryptedDiskImageWrapper *)wrapper completionHandler:(void (^)(PGAttachLease *, NSError *))handler
+{
+    NSAssert(wrapper, @"nil wrapper");
+    NSAssert(handler, @"nil handler");
+    
+    NSString *path = [[wrapper wrapperPath] stringByStandardizingPath];
+    handler = [handler copy];
+    
+    dispatch_async(_queue, ^{
+        PGAttachPoolEntry *entry = [_entries objectForKey:path];
+        if (!entry) {
+            ++_missCount;
+            entry = [[PGAttachPoolEntry alloc] initWithWrapper:wrapper];
+            [_entries setObject:entry forKey:path];
+            [[entry pendingHandlers] addObject:handler];
+            [self attachEntry:entry];
+            return;
+        }
+        
+        // Detaching wrappers need to be attached again once they finish, so only requests that don't have to wait for that are hits
+        if ([entry state] == PGAttachPoolEntryDetaching) ++_missCount;
+        else ++_hitCount;
+        
+        [[entry pendingHandlers] addObject:handler];
+        if ([entry state] == PGAttachPoolEntryAttached) [self grantPendingLeasesForEntry:entry];
+    });
+}
+
+
+- (PGAttachLease *)leaseMountForWrapper:(PGEncryptedDiskImageWrapper *)wrapper error:(NSError **)errorOut
+{
+    __block PGAttachLease *lease = nil;
+    __block NSError *error = nil;
+    dispatch_semaphore_t leasedSemaphore = dispatch_semaphore_create(0);
+    
+    [self leaseMountForWrapper:wrapper completionHandler:^(PGAttachLease *newLease, NSError *leaseError) {
+        lease = newLease;
+        error = leaseError;
+        dispatch_semaphore_signal(leasedSemaphore);
+    }];
+    
+    dispatch_semaphore_wait(leasedSemaphore, DISPATCH_TIME_FOREVER);
+    dispatch_release(leasedSemaphore);
+    
+    if (!lease && errorOut) *errorOut = error;
+    return lease;
+}
+
+
+- (void)relinquishLeaseForWrapperAtPath:(NSString *)path
+{
+    dispatch_async(_queue, ^{
+        PGAttachPoolEntry *entry = [_entries objectForKey:path];
+        NSAssert([entry leaseCount] > 0, @"relinquished more leases than were handed out");
+        
+        [entry setLeaseCount:[entry leaseCount] - 1];
+        if ([entry leaseCount] == 0) [self scheduleIdleDetachForEntry:entry];
+    });
+}
+
+
+- (NSUInteger)leaseCountForWrapperAtPath:(NSString *)path
+{
+    NSAssert(path, @"nil path");
+    
+    __block NSUInteger leaseCount = 0;
+    dispatch_sync(_queue, ^{
+        leaseCount = [[_entries objectForKey:[path stringByStandardizingPath]] leaseCount];
+    });
+    
+    return leaseCount;
+}
+
+
+- (NSString *)mountPointForWrapperAtPath:(NSString *)path
+{
+    NSAssert(path, @"nil path");
+    
+    __block NSString *mountPoint = nil;
+    dispatch_sync(_queue, ^{
+        mountPoint = [[_entries objectForKey:[path stringByStandardizingPath]] mountPoint];
+    });
+    
+    return mountPoint;
+}
+
+
+- (NSUInteger)hitCount
+{
+    __block NSUInteger hitCount = 0;
+    dispatch_sync(_queue, ^{
+        hitCount = _hitCount;
+    });
+    
+    return hitCount;
+}
+
+
+- (NSUInteger)missCount
+{
+    __block NSUInteger missCount = 0;
+    dispatch_sync(_queue, ^{
+        missCount = _missCount;
+    });
+    
+    return missCount;
+}
+
+
+#pragma mark Attaching and Detaching
+
+- (void)attachEntry:(PGAttachPoolEntry *)entry
+{
+    [entry setState:PGAttachPoolEntryAttaching];
+    
+    PGEncryptedDiskImageWrapper *wrapper = [entry wrapper];
+    [wrapper attachAtRandomSubdirectoryOfPath:[self mountRoot] timeout:[self taskTimeout] 
+                            completionHandler:^(NSString *mountPoint, NSError *error) {
+        // If the wrapper was attached before it was handed to us, just use its mount point
+        if (!mountPoint && !error) mountPoint = [wrapper mountPoint];
+        
+        dispatch_async(_queue, ^{
+            if (mountPoint) {
+                [entry setState:PGAttachPoolEntryAttached];
+                [entry setMountPoint:mountPoint];
+                [self grantPendingLeasesForEntry:entry];
+                return;
+            }
+            
+            [_entries removeObjectForKey:[[wrapper wrapperPath] stringByStandardizingPath]];
+            for (void (^handler)(PGAttachLease *, NSError *) in [entry pendingHandlers]) {
+                dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                    handler(nil, error);
+                });
+            }
+            
+            [[entry pendingHandlers] removeAllObjects];
+        });
+    }];
+}
+
+
+- (void)grantPendingLeasesForEntry:(PGAttachPoolEntry *)entry
+{
+    NSString *path = [[[entry wrapper] wrapperPath] stringByStandardizingPath];
+    
+    [entry setLeaseCount:[entry leaseCount] + [[entry pendingHandlers] count]];
+    [entry setIdleGeneration:[entry idleGeneration] + 1];
+    
+    for (void (^handler)(PGAttachLease *, NSError *) in [entry pendingHandlers]) {
+        PGAttachLease *lease = [[PGAttachLease alloc] initWithAttachPool:self wrapperPath:path mountPoint:[entry mountPoint]];
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            handler(lease, nil);
+        });
+    }
+    
+    [[entry pendingHandlers] removeAllObjects];
+}
+
+
+- (void)detachEntry:(PGAttachPoolEntry *)entry completionHandler:(void (^)(NSError *))handler
+{
+    [entry setState:PGAttachPoolEntryDetaching];
+    handler = [handler copy];
+    
+    PGEncryptedDiskImageWrapper *wrapper = [entry wrapper];
+    [wrapper detachWithTimeout:[self taskTimeout] completionHandler:^(BOOL detached, NSError *error) {
+        dispatch_async(_queue, ^{
+            // If the detach failed, the disk image is still attached, so it can still be leased
+            if (!detached && [wrapper isAttached]) {
+                [entry setState:PGAttachPoolEntryAttached];
+                if ([[entry pendingHandlers] count] > 0) [self grantPendingLeasesForEntry:entry];
+                else if ([entry leaseCount] == 0) [self scheduleIdleDetachForEntry:entry];
+                
+                if (handler) handler(error);
+                return;
+            }
+            
+            [entry setMountPoint:nil];
+            if ([[entry pendingHandlers] count] > 0) {
+                [self attachEntry:entry];
+            } else {
+                [_entries removeObjectForKey:[[wrapper wrapperPath] stringByStandardizingPath]];
+            }
+            
+            if (handler) handler(nil);
+        });
+    }];
+}
+
+
+- (void)scheduleIdleDetachForEntry:(PGAttachPoolEntry *)entry
+{
+    NSUInteger idleGeneration = [entry idleGeneration];
+    dispatch_time_t idleTime = dispatch_time(DISPATCH_TIME_NOW, [self idleTimeout] * NSEC_PER_SEC);
+    
+    dispatch_after(idleTime, _queue, ^{
+        if ([entry state] != PGAttachPoolEntryAttached || [entry leaseCount] > 0 || [entry idleGeneration] != idleGeneration) return;
+        [self detachEntry:entry completionHandler:nil];
+    });
+}
+
+
+- (BOOL)detachIdleWrappers:(NSError **)errorOut
+{
+    __block NSError *error = nil;
+    dispatch_group_t detachGroup = dispatch_group_create();
+    
+    dispatch_sync(_queue, ^{
+        for (PGAttachPoolEntry *entry in [_entries allValues]) {
+            if ([entry state] != PGAttachPoolEntryAttached || [entry leaseCount] > 0) continue;
+            
+            dispatch_group_enter(detachGroup);
+            [self detachEntry:entry completionHandler:^(NSError *detachError) {
+                if (detachError && !error) error = detachError;
+                dispatch_group_leave(detachGroup);
+            }];
+        }
+    });
+    
+    dispatch_group_wait(detachGroup, DISPATCH_TIME_FOREVER);
+    dispatch_release(detachGroup);
+    
+    if (error && errorOut) *errorOut = error;
+    return error == nil;
+}
+
+@end
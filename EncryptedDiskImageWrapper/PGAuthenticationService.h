@@ -0,0 +1,132 @@
+//
+//  PGAuthenticationService.h
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+@class PGEncryptedDiskImageWrapper;
+
+/*!
+ @abstract PGAuthenticationService instances open wrappers with user names and passwords on a fixed number of workers.
+ @discussion Opening a wrapper with a password derives a key, which keeps a core busy for around 100 ms. When many users log in at once, opening 
+     each wrapper on the thread that asked would run hundreds of derivations at once and make every login slow. An authentication service instead 
+     queues requests and runs at most maximumConcurrentCount of them at once, so each derivation gets a core to itself and requests finish in 
+     roughly the order they arrived.
+ 
+     Requests are queued per user, and workers take the next request from each user with queued requests in turn, so a user who sends many 
+     requests, e.g., an attacker guessing passwords, only delays their own requests. Once maximumQueueDepth requests are queued, new requests are 
+     rejected immediately with PGEncryptedDiskImageWrapperAuthenticationOverloadedError rather than waiting behind a queue that will take too long 
+     to drain. A request whose timeout passes before a worker starts it fails with PGEncryptedDiskImageWrapperAuthenticationDeadlineExceededError 
+     without deriving a key; once a worker has started a request, it runs to completion.
+ 
+     The service keeps the current queue depth, the number of requests that were rejected or expired, and how long started requests waited in the 
+     queue. When PGInstrumentation is enabled, each wait is also recorded as a PGAuthenticationQueueWaitSpan, and each rejection increments 
+     PGAuthenticationShedCounter. Authentication services are thread-safe.
+ */
+@interface PGAuthenticationService : NSObject
+
+/*! @abstract The maximum number of requests that are run at once. Defaults to the number of active processors. */
+@property(readwrite) NSUInteger maximumConcurrentCount;
+
+/*! @abstract The maximum number of requests that may wait in the queue. Defaults to 256. */
+@property(readwrite) NSUInteger maximumQueueDepth;
+
+/*!
+ @abstract Returns the process-wide authentication service.
+ @return The shared authentication service.
+ */
++ (PGAuthenticationService *)sharedAuthenticationService;
+
+/*!
+ @abstract Queues a request to open the specified wrapper with the specified user name and password, and returns immediately.
+ @discussion The completion handler is invoked on a global concurrent queue, and may be invoked before this method returns if the request is 
+     rejected. The request keeps its worker until the handler returns.
+ 
+ @param path The path of the wrapper to open. May not be nil.
+ @param user The user name with which to open the wrapper. May not be nil.
+ @param password The password with which to open the wrapper. May not be nil.
+ @param timeout How long the request may wait in the queue before it fails. If 0, it waits as long as it takes.
+ @param handler The block to invoke with the opened wrapper, or nil and the error that occurred. May not be nil.
+ */
+- (void)openWrapperAtPath:(NSString *)path user:(NSString *)user password:(NSString *)password timeout:(NSTimeInterval)timeout 
+        completionHandler:(void (^)(PGEncryptedDiskImageWrapper *wrapper, NSError *error))handler;
+
+/*!
+ @abstract Queues a request to open the specified wrapper with the specified user name and password, and waits for it to finish.
+ 
+ @param path The path of the wrapper to open. May not be nil.
+ @param user The user name with which to open the wrapper. May not be nil.
+ @param password The password with which to open the wrapper. May not be nil.
+ @param timeout How long the request may wait in the queue before it fails. If 0, it waits as long as it takes.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The opened wrapper, or nil if an error occurred.
+ */
+- (PGEncryptedDiskImageWrapper *)openWrapperAtPath:(NSString *)path user:(NSString *)user password:(NSString *)password 
+                                           timeout:(NSTimeInterval)timeout error:(NSError **)errorOut;
+
+/*!
+ @abstract Returns the number of requests waiting in the queue.
+ @return The queue depth.
+ */
+- (NSUInteger)queueDepth;
+
+/*!
+ @abstract Returns the number of requests being run.
+ @return The number of running requests.
+ */
+- (NSUInteger)activeCount;
+
+/*!
+ @abstract Returns the number of requests that were rejected because the queue was full.
+ @return The number of rejected requests.
+ */
+- (NSUInteger)shedCount;
+
+/*!
+ @abstract Returns the number of requests that failed because their timeout passed while they were queued.
+ @return The number of expired requests.
+ */
+- (NSUInteger)expiredCount;
+
+/*!
+ @abstract Returns the mean time that requests waited in the queue before being started or expiring.
+ @return The mean wait time in seconds, or 0 if no request has left the queue.
+ */
+- (NSTimeInterval)averageWaitTime;
+
+/*!
+ @abstract Returns the longest time that a request waited in the queue before being started or expiring.
+ @return The maximum wait time in seconds, or 0 if no request has left the queue.
+ */
+- (NSTimeInterval)maximumWaitTime;
+
+/*!
+ @abstract Resets the rejected and expired counts and the wait times.
+ */
+- (void)resetStatistics;
+
+@end
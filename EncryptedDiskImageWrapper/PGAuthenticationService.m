@@ -0,0 +1,485 @@
+//
+//  PGAuthenticationService.m
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGAuthenticationService.h"
+
+#import "NSError+ConvenienceInitializers.h"
+#import "PGEncryptedDiskImageWrapper.h"
+#import "PGErrors.h"
+#import "PGInstrumentation.h"
+
+
+#pragma mark Constants
+
+/*! @abstract The default maximum number of requests that may wait in a service's queue. */
+static const NSUInteger PGAuthenticationServiceDefaultMaximumQueueDepth = 256;
+
+
+#pragma mark - Requests
+
+/*!
+ @abstract PGAuthenticationRequest instances describe a wrapper to be opened by an authentication service.
+ @discussion Requests are only accessed on their service's queue, except for their immutable properties.
+ */
+@interface PGAuthenticationRequest : NSObject
+
+/*! @abstract The path of the wrapper to open. */
+@property(readonly, copy) NSString *wrapperPath;
+
+/*! @abstract The user name with which to open the wrapper. */
+@property(readonly, copy) NSString *user;
+
+/*! @abstract The password with which to open the wrapper. */
+@property(readonly, copy) NSString *password;
+
+/*! @abstract The block to invoke once the request finishes. */
+@property(readonly, copy) void (^completionHandler)(PGEncryptedDiskImageWrapper *, NSError *);
+
+/*! @abstract The system uptime at which the request was queued. */
+@property(readonly) NSTimeInterval enqueueTime;
+
+/*! @abstract The start time of the request's queue wait span. */
+@property(readonly) uint64_t waitSpanStartTime;
+
+/*! @abstract Whether the request has left the queue, either because a worker started it or because it expired. */
+@property(readwrite, getter = isDequeued) BOOL dequeued;
+
+/*!
+ @abstract Initializes a newly allocated request, setting its enqueue time to now.
+ 
+ @param wrapperPath The path of the wrapper to open. May not be nil.
+ @param user The user name with which to open the wrapper. May not be nil.
+ @param password The password with which to open the wrapper. May not be nil.
+ @param completionHandler The block to invoke once the request finishes. May not be nil.
+ 
+ @return An initialized request.
+ */
+- (id)initWithWrapperPath:(NSString *)wrapperPath user:(NSString *)user password:(NSString *)password
+        completionHandler:(void (^)(PGEncryptedDiskImageWrapper *, NSError *))completionHandler;
+
+@end
+
+
+@implementation PGAuthenticationRequest
+
+@synthesize wrapperPath = _wrapperPath;
+@synthesize user = _user;
+@synthesize password = _password;
+@synthesize completionHandler = _completionHandler;
+@synthesize enqueueTime = _enqueueTime;
+@synthesize waitSpanStartTime = _waitSpanStartTime;
+@synthesize dequeued = _dequeued;
+
+- (id)initWithWrapperPath:(NSString *)wrapperPath user:(NSString *)user password:(NSString *)password
+        completionHandler:(void (^)(PGEncryptedDiskImageWrapper *, NSError *))completionHandler
+{
+    if (!(self = [super init])) return nil;
+    
+    _wrapperPath = [wrapperPath copy];
+    _user = [user copy];
+    _password = [password copy];
+    _completionHandler = [completionHandler copy];
+    _enqueueTime = [[NSProcessInfo processInfo] systemUptime];
+    _waitSpanStartTime = PGInstrumentationBeginSpan();
+    
+    return self;
+}
+
+@end
+
+
+#pragma mark - Private Methods Interface
+
+@interface PGAuthenticationService ()
+
+/*!
+ @abstract Adds the specified request to the back of its user's queue.
+ @discussion Must be invoked on the service's queue.
+ @param request The request to queue. May not be nil.
+ */
+- (void)enqueueRequest:(PGAuthenticationRequest *)request;
+
+/*!
+ @abstract Removes the specified request from its user's queue, e.g., because it expired.
+ @discussion Must be invoked on the service's queue.
+ @param request The request to remove. It must be queued. May not be nil.
+ */
+- (void)removeQueuedRequest:(PGAuthenticationRequest *)request;
+
+/*!
+ @abstract Starts queued requests, taking one from each user in turn, until every worker is busy or the queue is empty.
+ @discussion Must be invoked on the service's queue.
+ */
+- (void)startPendingRequests;
+
+/*!
+ @abstract Ends the specified request's wait span and adds its time in the queue to the wait statistics.
+ @discussion Must be invoked on the service's queue once the request has left the queue, whether it was started or expired.
+ @param request The request. May not be nil.
+ */
+- (void)recordWaitForRequest:(PGAuthenticationRequest *)request;
+
+/*!
+ @abstract Starts opening the specified request's wrapper on a worker.
+ @discussion Must be invoked on the service's queue.
+ @param request The request to start. May not be nil.
+ */
+- (void)startRequest:(PGAuthenticationRequest *)request;
+
+/*!
+ @abstract Fails the specified request without starting it.
+ @param request The request. May not be nil.
+ @param code The PGErrorDomain code of the error with which to fail the request.
+ @param description The localized description of the error. May not be nil.
+ */
+- (void)failRequest:(PGAuthenticationRequest *)request code:(NSInteger)code description:(NSString *)description;
+
+@end
+
+
+#pragma mark - Implementation
+
+@implementation PGAuthenticationService {
+    // All state below is only accessed on _queue
+    dispatch_queue_t _queue;
+    
+    // Queued requests keyed by user, and the users with queued requests in the order they will next be served
+    NSMutableDictionary *_queuedRequestsByUser;
+    NSMutableArray *_queuedUsers;
+    
+    NSUInteger _queueDepth;
+    NSUInteger _activeCount;
+    NSUInteger _shedCount;
+    NSUInteger _expiredCount;
+    NSUInteger _waitCount;
+    NSTimeInterval _totalWaitTime;
+    NSTimeInterval _maximumWaitTime;
+}
+
+@synthesize maximumConcurrentCount = _maximumConcurrentCount;
+@synthesize maximumQueueDepth = _maximumQueueDepth;
+
+- (id)init
+{
+    if (!(self = [super init])) return nil;
+    
+    _maximumConcurrentCount = [[NSProcessInfo processInfo] activeProcessorCount];
+    _maximumQueueDepth = PGAuthenticationServiceDefaultMaximumQueueDepth;
+    _queue = dispatch_queue_create("com.quantumlenscap.PGAuthenticationService", DISPATCH_QUEUE_SERIAL);
+    _queuedRequestsByUser = [[NSMutableDictionary alloc] init];
+    _queuedUsers = [[NSMutableArray alloc] init];
+    
+    return self;
+}
+
+
+- (void)dealloc
+{
+    dispatch_release(_queue);
+}
+
+
++ (PGAuthenticationService *)sharedAuthenticationService
+{
+    static PGAuthenticationService *sharedAuthenticationService = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedAuthenticationService = [[PGAuthenticationService alloc] init];
+    });
+    
+    return sharedAuthenticationService;
+}
+
+
+- (NSUInteger)maximumConcurrentCount
+{
+    __block NSUInteger maximumConcurrentCount = 0;
+    dispatch_sync(_queue, ^{
+        maximumConcurrentCount = _maximumConcurrentCount;
+    });
+    
+    return maximumConcurrentCount;
+}
+
+
+- (void)setMaximumConcurrentCount:(NSUInteger)maximumConcurrentCount
+{
+    dispatch_async(_queue, ^{
+        _maximumConcurrentCount = maximumConcurrentCount;
+        [self startPendingRequests];
+    });
+}
+
+
+- (NSUInteger)maximumQueueDepth
+{
+    __block NSUInteger maximumQueueDepth = 0;
+    dispatch_sync(_queue, ^{
+        maximumQueueDepth = _maximumQueueDepth;
+    });
+    
+    return maximumQueueDepth;
+}
+
+
+- (void)setMaximumQueueDepth:(NSUInteger)maximumQueueDepth
+{
+    dispatch_async(_queue, ^{
+        _maximumQueueDepth = maximumQueueDepth;
+    });
+}
+
+
+#pragma mark Opening Wrappers
+
+- (void)openWrapperAtPath:(NSString *)path user:(NSString *)user password:(NSString *)password timeout:(NSTimeInterval)timeout 
+        completionHandler:(void (^)(PGEncryptedDiskImageWrapper *, NSError *))handler
+{
+    NSAssert(path, @"nil path");
+    NSAssert(user, @"nil user");
+    NSAssert(password, @"nil password");
+    NSAssert(handler, @"nil handler");
+    
+    PGAuthenticationRequest *request = [[PGAuthenticationRequest alloc] initWithWrapperPath:path user:user password:password 
+                                                                          completionHandler:handler];
+    dispatch_async(_queue, ^{
+        // Workers only sit idle when the queue is empty, so a full queue means every worker is busy
+        if (_queueDepth >= _maximumQueueDepth && _activeCount >= MAX(_maximumConcurrentCount, 1U)) {
+            ++_shedCount;
+            PGInstrumentationIncrementCounter(PGAuthenticationShedCounter);
+            [self failRequest:request code:PGEncryptedDiskImageWrapperAuthenticationOverloadedError 
+                  description:NSLocalizedString(@"Too many authentication requests are waiting.", nil)];
+            return;
+        }
+        
+        [self enqueueRequest:request];
+        [self startPendingRequests];
+        
+        if (timeout > 0 && ![request isDequeued]) {
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeout * NSEC_PER_SEC)), _queue, ^{
+                if ([request isDequeued]) return;
+                
+                [self removeQueuedRequest:request];
+                [self recordWaitForRequest:request];
+                ++_expiredCount;
+                [self failRequest:request code:PGEncryptedDiskImageWrapperAuthenticationDeadlineExceededError 
+                      description:NSLocalizedString(@"The authentication request timed out before it could be started.", nil)];
+            });
+        }
+    });
+}
+
+
+- (PGEncryptedDiskImageWrapper *)openWrapperAtPath:(NSString *)path user:(NSString *)user password:(NSString *)password 
+                                           timeout:(NSTimeInterval)timeout error:(NSError **)errorOut
+{
+    __block PGEncryptedDiskImageWrapper *wrapper = nil;
+    __block NSError *error = nil;
+    dispatch_semaphore_t finishedSemaphore = dispatch_semaphore_create(0);
+    [self openWrapperAtPath:path user:user password:password timeout:timeout 
+          completionHandler:^(PGEncryptedDiskImageWrapper *openedWrapper, NSError *openError) {
+              wrapper = openedWrapper;
+              error = openError;
+              dispatch_semaphore_signal(finishedSemaphore);
+          }];
+    
+    dispatch_semaphore_wait(finishedSemaphore, DISPATCH_TIME_FOREVER);
+    dispatch_release(finishedSemaphore);
+    
+    if (!wrapper && errorOut) *errorOut = error;
+    return wrapper;
+}
+
+
+#pragma mark Statistics
+
+- (NSUInteger)queueDepth
+{
+    __block NSUInteger queueDepth = 0;
+    dispatch_sync(_queue, ^{
+        queueDepth = _queueDepth;
+    });
+    
+    return queueDepth;
+}
+
+
+- (NSUInteger)activeCount
+{
+    __block NSUInteger activeCount = 0;
+    dispatch_sync(_queue, ^{
+        activeCount = _activeCount;
+    });
+    
+    return activeCount;
+}
+
+
+- (NSUInteger)shedCount
+{
+    __block NSUInteger shedCount = 0;
+    dispatch_sync(_queue, ^{
+        shedCount = _shedCount;
+    });
+    
+    return shedCount;
+}
+
+
+- (NSUInteger)expiredCount
+{
+    __block NSUInteger expiredCount = 0;
+    dispatch_sync(_queue, ^{
+        expiredCount = _expiredCount;
+    });
+    
+    return expiredCount;
+}
+
+
+- (NSTimeInterval)averageWaitTime
+{
+    __block NSTimeInterval averageWaitTime = 0.0;
+    dispatch_sync(_queue, ^{
+        if (_waitCount > 0) averageWaitTime = _totalWaitTime / _waitCount;
+    });
+    
+    return averageWaitTime;
+}
+
+
+- (NSTimeInterval)maximumWaitTime
+{
+    __block NSTimeInterval maximumWaitTime = 0.0;
+    dispatch_sync(_queue, ^{
+        maximumWaitTime = _maximumWaitTime;
+    });
+    
+    return maximumWaitTime;
+}
+
+
+- (void)resetStatistics
+{
+    dispatch_sync(_queue, ^{
+        _shedCount = 0;
+        _expiredCount = 0;
+        _waitCount = 0;
+        _totalWaitTime = 0.0;
+        _maximumWaitTime = 0.0;
+    });
+}
+
+
+#pragma mark Private Methods
+
+- (void)enqueueRequest:(PGAuthenticationRequest *)request
+{
+    NSMutableArray *userRequests = [_queuedRequestsByUser objectForKey:[request user]];
+    if (!userRequests) {
+        userRequests = [NSMutableArray array];
+        [_queuedRequestsByUser setObject:userRequests forKey:[request user]];
+        [_queuedUsers addObject:[request user]];
+    }
+    
+    [userRequests addObject:request];
+    ++_queueDepth;
+}
+
+
+- (void)removeQueuedRequest:(PGAuthenticationRequest *)request
+{
+    NSMutableArray *userRequests = [_queuedRequestsByUser objectForKey:[request user]];
+    [userRequests removeObjectIdenticalTo:request];
+    if ([userRequests count] == 0) {
+        [_queuedRequestsByUser removeObjectForKey:[request user]];
+        [_queuedUsers removeObject:[request user]];
+    }
+    
+    [request setDequeued:YES];
+    --_queueDepth;
+}
+
+
+- (void)startPendingRequests
+{
+    // Serving users round-robin means a user with many queued requests waits behind everyone else's next request, not the other way around
+    while (_activeCount < MAX(_maximumConcurrentCount, 1U) && [_queuedUsers count] > 0) {
+        NSString *user = [_queuedUsers objectAtIndex:0];
+        PGAuthenticationRequest *request = [[_queuedRequestsByUser objectForKey:user] objectAtIndex:0];
+        [self removeQueuedRequest:request];
+        
+        if ([_queuedRequestsByUser objectForKey:user]) {
+            [_queuedUsers removeObjectAtIndex:0];
+            [_queuedUsers addObject:user];
+        }
+        
+        [self startRequest:request];
+    }
+}
+
+
+- (void)recordWaitForRequest:(PGAuthenticationRequest *)request
+{
+    NSTimeInterval waitTime = [[NSProcessInfo processInfo] systemUptime] - [request enqueueTime];
+    ++_waitCount;
+    _totalWaitTime += waitTime;
+    _maximumWaitTime = MAX(_maximumWaitTime, waitTime);
+    PGInstrumentationEndSpan(PGAuthenticationQueueWaitSpan, [request waitSpanStartTime]);
+}
+
+
+- (void)startRequest:(PGAuthenticationRequest *)request
+{
+    ++_activeCount;
+    [self recordWaitForRequest:request];
+    
+    // Opening blocks for the duration of key derivation, so it happens off of our queue
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        NSError *error = nil;
+        PGEncryptedDiskImageWrapper *wrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:[request wrapperPath] 
+                                                                                                      user:[request user]
+                                                                                                  password:[request password]
+                                                                                                     error:&error];
+        // The handler runs on the worker, so a slow handler holds its slot rather than letting more requests pile up behind it
+        [request completionHandler](wrapper, wrapper ? nil : error);
+        dispatch_async(_queue, ^{
+            --_activeCount;
+            [self startPendingRequests];
+        });
+    });
+}
+
+
+- (void)failRequest:(PGAuthenticationRequest *)request code:(NSInteger)code description:(NSString *)description
+{
+    NSError *error = [NSError errorWithDomain:PGErrorDomain code:code userInfoObjectsAndKeys:description, NSLocalizedDescriptionKey, nil];
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [request completionHandler](nil, error);
+    });
+}
+
+@end
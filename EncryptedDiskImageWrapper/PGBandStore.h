@@ -0,0 +1,188 @@
+//
+//  PGBandStore.h
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+/*! @abstract The default size of a band store's bands, in bytes. */
+extern const NSUInteger PGBandStoreDefaultBandSize;
+
+
+/*!
+ @abstract PGBandStore instances store encrypted data as a directory of fixed-size band files that can be read and written in-process.
+ @discussion A band store is a portable alternative to an encrypted sparse bundle disk image. Its contents are a flat, random-access byte array 
+     rather than a file system, and reading or writing it requires neither hdiutil nor a mount.
+ 
+     The store's data is split into bands of equal size, each of which is stored in its own file. Band files are only created when data is 
+     written to them, so a store takes up space proportional to the data written to it rather than to its length. Within a band, each 4 KB sector 
+     is encrypted independently using AES-256 in GCM mode with a random nonce, so sectors can be rewritten in place. Each sector's nonce and tag 
+     are kept in a tag file alongside its band, and the tag authenticates the sector's number as well as its contents, so a sector that has been 
+     modified or moved fails to read rather than decrypting to garbage. The tag file also holds an authenticated bitmap of the band's sectors 
+     that have been written, so a sector can't be made to read as zeros by zeroing or truncating it or its tag record. Only deleting a band's 
+     tag file along with its band file makes the whole band read as unwritten. Where GCM isn't available, and in stores created by earlier 
+     versions, sectors are instead encrypted in CBC mode with an initialization vector derived from the sector's number, and aren't 
+     authenticated. Sectors that have never been written are stored as holes and read as zeros.
+ 
+     The data is encrypted with a randomly generated volume key, which is itself encrypted with the password the store was created with. Bands are 
+     read and decrypted lazily, the first time they are accessed, and kept in a bounded cache of plaintext bands. Writes modify cached bands and 
+     are encrypted and written back when a band is evicted from the cache or when the store is flushed. Changes that haven't been flushed are 
+     lost if the process exits.
+ 
+     Band stores are not thread-safe.
+ */
+@interface PGBandStore : NSObject
+
+/*! @abstract The length of the store's contents, in bytes. */
+@property(readonly) unsigned long long length;
+
+/*! @abstract The size of the store's bands, in bytes. */
+@property(readonly) NSUInteger bandSize;
+
+/*! @abstract The size of the store's independently encrypted sectors, in bytes. */
+@property(readonly) NSUInteger sectorSize;
+
+/*! @abstract The maximum number of decrypted bands the store keeps in memory. Defaults to 32. */
+@property(readwrite, nonatomic) NSUInteger cacheCapacity;
+
+/*!
+ @abstract Creates a new, empty band store at the specified path.
+ 
+ @param path The path at which to create the band store. Nothing may exist at the path. May not be nil.
+ @param password The password with which to encrypt the store's volume key. May not be nil.
+ @param length The store's initial length. The store's contents are initially all zeros, but no space is allocated for them.
+ @param bandSize The size of the store's bands. Must be a positive multiple of the sector size.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The new band store, or nil if it could not be created.
+ */
++ (PGBandStore *)createBandStoreAtPath:(NSString *)path password:(NSString *)password length:(unsigned long long)length 
+                              bandSize:(NSUInteger)bandSize error:(NSError **)errorOut;
+
+/*!
+ @abstract Initializes a newly allocated band store with the band store at the specified path.
+ 
+ @param path The path of the band store. May not be nil.
+ @param password The password the store was created with. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return An initialized band store, or nil if the store could not be read or the password is incorrect.
+ */
+- (id)initWithContentsOfFile:(NSString *)path password:(NSString *)password error:(NSError **)errorOut;
+
+/*!
+ @abstract Changes the password with which the volume key of the band store at the specified path is encrypted.
+ @discussion The store's data is still encrypted with the same volume key, so none of its bands are rewritten. The store must not be open.
+ 
+ @param path The path of the band store. May not be nil.
+ @param oldPassword The store's current password. May not be nil.
+ @param newPassword The password with which to encrypt the volume key from now on. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the password was changed. If the old password is incorrect, the error's code is PGEncryptedDiskImageWrapperAuthenticationError.
+ */
++ (BOOL)changePasswordOfBandStoreAtPath:(NSString *)path fromPassword:(NSString *)oldPassword toPassword:(NSString *)newPassword 
+                                  error:(NSError **)errorOut;
+
+/*!
+ @abstract Reads data from the store into the specified buffer.
+ @discussion If a sector being read fails to decrypt or authenticate, the read fails with PGEncryptedDiskImageWrapperMalformedBandStoreError.
+     Other sectors in the same band can still be read.
+ 
+ @param buffer The buffer into which to read. Must be at least length bytes long. May not be NULL.
+ @param length The number of bytes to read.
+ @param offset The offset in the store at which to start reading.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The number of bytes read, which is less than length only if the read extends past the end of the store, or -1 if an error occurred.
+ */
+- (NSInteger)readBytes:(void *)buffer length:(NSUInteger)length atOffset:(unsigned long long)offset error:(NSError **)errorOut;
+
+/*!
+ @abstract Reads data from the store.
+ 
+ @param length The number of bytes to read.
+ @param offset The offset in the store at which to start reading.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The data read, which is shorter than length only if the read extends past the end of the store, or nil if an error occurred.
+ */
+- (NSData *)readDataOfLength:(NSUInteger)length atOffset:(unsigned long long)offset error:(NSError **)errorOut;
+
+/*!
+ @abstract Writes data to the store, extending the store if necessary.
+ @discussion Writing past the end of the store fills the gap with zeros. A sector that fails to authenticate can be overwritten in its entirety, 
+     after which it reads normally, but writing only part of it fails with PGEncryptedDiskImageWrapperMalformedBandStoreError.
+ 
+ @param bytes The bytes to write. May not be NULL.
+ @param length The number of bytes to write.
+ @param offset The offset in the store at which to start writing.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the data was written.
+ */
+- (BOOL)writeBytes:(const void *)bytes length:(NSUInteger)length atOffset:(unsigned long long)offset error:(NSError **)errorOut;
+
+/*!
+ @abstract Writes data to the store, extending the store if necessary.
+ 
+ @param data The data to write. May not be nil.
+ @param offset The offset in the store at which to start writing.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the data was written.
+ */
+- (BOOL)writeData:(NSData *)data atOffset:(unsigned long long)offset error:(NSError **)errorOut;
+
+/*!
+ @abstract Sets the length of the store.
+ @discussion Shortening the store discards the data past its new end and deletes band files that are no longer needed. Lengthening it appends 
+     zeros without allocating any space.
+ 
+ @param length The store's new length.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the store's length was changed.
+ */
+- (BOOL)truncateToLength:(unsigned long long)length error:(NSError **)errorOut;
+
+/*!
+ @abstract Encrypts and durably writes all modified bands and the store's length.
+ 
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the store was flushed.
+ */
+- (BOOL)flush:(NSError **)errorOut;
+
+@end
@@ -0,0 +1,1206 @@
+//
+//  PGBandStore.m
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGBandStore.h"
+
+#import <fcntl.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+#import "NSData+Crypto.h"
+#import "NSError+ConvenienceInitializers.h"
+#import "PGCryptoProvider.h"
+#import "PGErrors.h"
+#import "PGKeyArena.h"
+
+
+#pragma mark Constants and Functions
+
+const NSUInteger PGBandStoreDefaultBandSize = 1024 * 1024;
+
+/*! @abstract The size of the independently encrypted sectors in a band. */
+static const NSUInteger PGBandStoreSectorSize = 4096;
+
+/*! @abstract The default number of decrypted bands a band store keeps in memory. */
+static const NSUInteger PGBandStoreDefaultCacheCapacity = 32;
+
+/*!
+ @abstract The version of the band store format written by this class.
+ @discussion Version 2 stores encrypt their sectors with AES-GCM and keep each sector's nonce and tag in a tag file alongside its band. Stores
+     created where GCM isn't available are still written as version 1, so earlier versions can open them.
+ */
+static const NSUInteger PGBandStoreVersion = 2;
+
+/*! @abstract The earliest version of the band store format this class can read. Version 1 stores encrypt their sectors with AES-CBC. */
+static const NSUInteger PGBandStoreMinimumVersion = 1;
+
+/*! @abstract The length of the record in a tag file that authenticates one sector, which is the sector's nonce followed by its tag. */
+static const size_t PGBandStoreSectorTagLength = PGCryptoAESGCMNonceLength + PGCryptoAESGCMTagLength;
+
+/*!
+ @abstract The message whose HMAC, keyed with the volume key, is the key that authenticates bands' written sector bitmaps.
+ @discussion A tag file holds a tag record for each sector in its band, followed by a bitmap of the band's sectors that have been written and the
+     bitmap's HMAC. The HMAC covers the band's index too, so a bitmap can't be copied from one band to another.
+ */
+static NSString *const PGBandStoreWrittenSectorsKeyMessage = @"PGBandStore.WrittenSectors";
+
+/*! @abstract The name of the property list inside a band store that describes it. */
+static NSString *const PGBandStoreInfoFilename = @"Info.plist";
+
+/*! @abstract The name of the directory inside a band store that contains its band files. */
+static NSString *const PGBandStoreBandsDirectoryName = @"bands";
+
+/*! @abstract The name of the directory inside a band store that contains its bands' tag files. Only version 2 stores have one. */
+static NSString *const PGBandStoreTagsDirectoryName = @"tags";
+
+/*! @abstract The message whose HMAC, keyed with the volume key, verifies that the volume key was decrypted correctly. */
+static NSString *const PGBandStoreVerifierMessage = @"PGBandStore";
+
+/*! @abstract The info key whose value corresponds to the store's format version. */
+static NSString *const PGVersionBandStoreInfoKey = @"Version";
+
+/*! @abstract The info key whose value corresponds to the store's band size. */
+static NSString *const PGBandSizeBandStoreInfoKey = @"BandSize";
+
+/*! @abstract The info key whose value corresponds to the store's length. */
+static NSString *const PGLengthBandStoreInfoKey = @"Length";
+
+/*! @abstract The info key whose value corresponds to the salt used to encrypt the store's volume key. */
+static NSString *const PGSaltBandStoreInfoKey = @"Salt";
+
+/*! @abstract The info key whose value corresponds to the rounds value used to encrypt the store's volume key. */
+static NSString *const PGRoundsBandStoreInfoKey = @"Rounds";
+
+/*! @abstract The info key whose value corresponds to the initialization vector used to encrypt the store's volume key. */
+static NSString *const PGInitializationVectorBandStoreInfoKey = @"IV";
+
+/*! @abstract The info key whose value corresponds to the store's encrypted volume key. */
+static NSString *const PGSecretBandStoreInfoKey = @"Secret";
+
+/*!
+ @abstract The info key whose value corresponds to the PGEncryptionAlgorithm with which the store's volume key was encrypted.
+ @discussion Stores created by earlier versions don't have one, and their volume keys were encrypted with PGAES256CBCEncryptionAlgorithm.
+ */
+static NSString *const PGAlgorithmBandStoreInfoKey = @"Algorithm";
+
+/*!
+ @abstract The info key whose value corresponds to the PGEncryptionAlgorithm with which the store's sectors are encrypted.
+ @discussion Version 1 stores don't have one, and their sectors are encrypted with PGAES256CBCEncryptionAlgorithm.
+ */
+static NSString *const PGSectorAlgorithmBandStoreInfoKey = @"SectorAlgorithm";
+
+/*! @abstract The info key whose value corresponds to the store's volume key verifier. */
+static NSString *const PGVerifierBandStoreInfoKey = @"Verifier";
+
+
+/*!
+ @abstract Returns whether the specified bytes are all zero.
+ @param bytes The bytes to check. May not be NULL.
+ @param length The number of bytes to check.
+ @return Whether every byte is zero.
+ */
+static BOOL PGBandStoreBytesAreZero(const uint8_t *bytes, size_t length)
+{
+    for (size_t i = 0; i < length; ++i) {
+        if (bytes[i]) return NO;
+    }
+    
+    return YES;
+}
+
+
+/*!
+ @abstract Reads the specified file into a buffer until the buffer is full or the file ends.
+ @discussion A file that doesn't exist reads as empty.
+ 
+ @param path The path of the file. May not be nil.
+ @param buffer The buffer into which to read. May not be NULL.
+ @param capacity The length of the buffer.
+ @param lengthOut On return, the number of bytes read. May not be NULL.
+ @param existsOut On return, whether the file exists. May be NULL.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the file was read.
+ */
+static BOOL PGBandStoreReadFile(NSString *path, void *buffer, size_t capacity, size_t *lengthOut, BOOL *existsOut, NSError **errorOut)
+{
+    *lengthOut = 0;
+    if (existsOut) *existsOut = NO;
+    int fileDescriptor = open([path fileSystemRepresentation], O_RDONLY);
+    if (fileDescriptor == -1) {
+        if (errno == ENOENT) return YES;
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return NO;
+    }
+    
+    size_t totalLength = 0;
+    while (totalLength < capacity) {
+        ssize_t readLength = pread(fileDescriptor, (uint8_t *)buffer + totalLength, capacity - totalLength, totalLength);
+        if (readLength < 0 && errno == EINTR) continue;
+        if (readLength < 0) {
+            if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            close(fileDescriptor);
+            return NO;
+        } else if (readLength == 0) {
+            break;
+        }
+        
+        totalLength += readLength;
+    }
+    
+    close(fileDescriptor);
+    *lengthOut = totalLength;
+    if (existsOut) *existsOut = YES;
+    return YES;
+}
+
+
+/*!
+ @abstract Writes the specified bytes to a file descriptor at the specified offset, retrying until they've all been written.
+ @param fileDescriptor The file descriptor.
+ @param bytes The bytes to write. May not be NULL.
+ @param length The number of bytes to write.
+ @param offset The offset at which to write them.
+ @return Whether every byte was written. If not, errno is set.
+ */
+static BOOL PGBandStoreWriteFully(int fileDescriptor, const void *bytes, size_t length, off_t offset)
+{
+    size_t totalLength = 0;
+    while (totalLength < length) {
+        ssize_t writtenLength = pwrite(fileDescriptor, (const uint8_t *)bytes + totalLength, length - totalLength, offset + totalLength);
+        if (writtenLength < 0 && errno == EINTR) continue;
+        if (writtenLength < 0) return NO;
+        totalLength += writtenLength;
+    }
+    
+    return YES;
+}
+
+
+/*!
+ @abstract Returns an error describing a malformed band store.
+ @return The error.
+ */
+static NSError *PGBandStoreMalformedError(void)
+{
+    return [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperMalformedBandStoreError userInfo:nil];
+}
+
+
+#pragma mark - Bands
+
+/*!
+ @abstract PGBandStoreBand instances hold the decrypted contents of a cached band.
+ */
+@interface PGBandStoreBand : NSObject
+
+/*! @abstract The band's index in the store. */
+@property(readonly) NSUInteger index;
+
+/*! @abstract The band's decrypted contents. Always exactly one band long. */
+@property(readonly, strong) NSMutableData *bytes;
+
+/*! @abstract The indexes of the band's sectors that have been modified since they were last written. */
+@property(readonly, strong) NSMutableIndexSet *dirtySectors;
+
+/*! @abstract The indexes of the band's sectors that have been written to its file, or, if they're dirty, will be when it's next written. */
+@property(readonly, strong) NSMutableIndexSet *writtenSectors;
+
+/*! @abstract Whether sectors have been removed from writtenSectors since the band's bitmap was last written. */
+@property(readwrite) BOOL writtenSectorsDirty;
+
+/*! 
+ @abstract The indexes of the band's sectors that failed to decrypt or authenticate when the band was read.
+ @discussion These sectors are zeros in the band's bytes. Reads that include them fail, and they're only written again once they have been 
+     completely overwritten.
+ */
+@property(readonly, strong) NSMutableIndexSet *failedSectors;
+
+/*!
+ @abstract Initializes a newly allocated band with the specified index and contents.
+ @param index The band's index.
+ @param bytes The band's decrypted contents. May not be nil.
+ @return An initialized band.
+ */
+- (id)initWithIndex:(NSUInteger)index bytes:(NSMutableData *)bytes;
+
+@end
+
+
+@implementation PGBandStoreBand
+
+- (id)initWithIndex:(NSUInteger)index bytes:(NSMutableData *)bytes
+{
+    NSAssert(bytes, @"nil bytes");
+    
+    if (!(self = [super init])) return nil;
+    
+    _index = index;
+    _bytes = bytes;
+    _dirtySectors = [[NSMutableIndexSet alloc] init];
+    _writtenSectors = [[NSMutableIndexSet alloc] init];
+    _failedSectors = [[NSMutableIndexSet alloc] init];
+    
+    return self;
+}
+
+@end
+
+
+#pragma mark - Private Methods Interface
+
+@interface PGBandStore ()
+
+/*!
+ @abstract Initializes a newly allocated band store with the specified path, info, and volume key.
+ @discussion This is the designated initializer. It creates the cryptors used to encrypt and decrypt sectors.
+ 
+ @param path The path of the band store. May not be nil.
+ @param info The store's info dictionary. May not be nil.
+ @param volumeKey The store's decrypted volume key. May not be NULL. The key isn't retained, so it may be released as soon as this returns.
+ @param volumeKeyLength The length of the volume key.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return An initialized band store, or nil if an error occurred.
+ */
+- (id)initWithPath:(NSString *)path info:(NSDictionary *)info volumeKey:(const void *)volumeKey length:(size_t)volumeKeyLength 
+             error:(NSError **)errorOut;
+
+/*!
+ @abstract Reads and validates the info dictionary of the band store at the specified path.
+ @param path The path of the band store. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ @return The store's info dictionary, or nil if it's missing or malformed.
+ */
++ (NSDictionary *)infoForBandStoreAtPath:(NSString *)path error:(NSError **)errorOut;
+
+/*!
+ @abstract Decrypts the volume key in the specified info dictionary with the specified password and checks it against the info's verifier.
+ 
+ @param volumeKey The buffer into which to decrypt the volume key, which should be in the key arena. Must be PGKeyArenaBlockSize bytes long. 
+     May not be NULL.
+ @param volumeKeyLengthOut Upon return, the length of the volume key. May not be NULL.
+ @param info The store's info dictionary, which must already have been validated. May not be nil.
+ @param password The password with which the volume key was encrypted. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the volume key was decrypted. If the password is incorrect, the error's code is PGEncryptedDiskImageWrapperAuthenticationError.
+ */
++ (BOOL)getVolumeKey:(void *)volumeKey length:(size_t *)volumeKeyLengthOut info:(NSDictionary *)info password:(NSString *)password 
+               error:(NSError **)errorOut;
+
+/*!
+ @abstract Returns the path of the file for the band with the specified index.
+ @param bandIndex The band's index.
+ @return The band's file path.
+ */
+- (NSString *)pathForBandAtIndex:(NSUInteger)bandIndex;
+
+/*!
+ @abstract Returns the path of the tag file for the band with the specified index.
+ @param bandIndex The band's index.
+ @return The band's tag file path, or nil if the store's sectors aren't encrypted with AES-GCM.
+ */
+- (NSString *)pathForTagsOfBandAtIndex:(NSUInteger)bandIndex;
+
+/*!
+ @abstract Returns whether the band with the specified index has been written, i.e., whether it has a tag file or, if the store's sectors aren't 
+     encrypted with AES-GCM, a band file.
+ @param bandIndex The band's index.
+ @return Whether the band has been written.
+ */
+- (BOOL)bandExistsAtIndex:(NSUInteger)bandIndex;
+
+/*!
+ @abstract Returns the cached band with the specified index, reading and decrypting it if necessary.
+ @discussion The band becomes the most recently used band. If the cache is over capacity afterward, the least recently used bands are evicted.
+     Sectors that fail to decrypt or authenticate don't keep the band from being read; they're added to its failedSectors instead.
+ 
+ @param bandIndex The band's index.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The band, or nil if it could not be read.
+ */
+- (PGBandStoreBand *)bandAtIndex:(NSUInteger)bandIndex error:(NSError **)errorOut;
+
+/*!
+ @abstract Encrypts the specified band's dirty sectors and writes them to its file.
+ @discussion With AES-GCM, the sectors' ciphertext is written first, then their tag records, and then, if it has changed, the band's written 
+     sector bitmap. Both files are synchronized before the bitmap is written, so a sector is never marked as written before it has been.
+ 
+ @param band The band to write. May not be nil.
+ @param synchronize Whether to synchronize the band's file to disk after writing it.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the band was written.
+ */
+- (BOOL)writeBand:(PGBandStoreBand *)band synchronize:(BOOL)synchronize error:(NSError **)errorOut;
+
+/*!
+ @abstract Writes the specified band's dirty tag records to its tag file, followed by its written sector bitmap if specified.
+ @discussion The bitmap is written only after the tag records have been synchronized. A band that has no tag file yet gets a new one, which is 
+     created atomically along with its bitmap.
+ 
+ @param tags The band's tag records, of which those for its dirty sectors are written. May not be nil.
+ @param band The band whose tags to write. May not be nil.
+ @param writtenSectors The band's written sectors, or nil if its bitmap hasn't changed. Must not be nil if the band has no tag file.
+ @param synchronize Whether to synchronize the tag file to disk after writing it.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the tags were written.
+ */
+- (BOOL)writeTags:(NSData *)tags ofBand:(PGBandStoreBand *)band writtenSectors:(NSIndexSet *)writtenSectors synchronize:(BOOL)synchronize 
+            error:(NSError **)errorOut;
+
+/*!
+ @abstract Evicts the least recently used bands until the cache is within its capacity.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ @return Whether all evicted bands were written successfully.
+ */
+- (BOOL)evictBandsIfNeeded:(NSError **)errorOut;
+
+/*!
+ @abstract Encrypts or decrypts the specified sector.
+ @discussion With AES-GCM, encrypting a sector generates a random nonce and writes it and the sector's tag to the tag record, and decrypting 
+     fails with PGCryptoDecodeError unless the record authenticates the sector's ciphertext at its position in the store.
+ 
+ @param operation Whether to encrypt or decrypt.
+ @param sectorNumber The sector's number in the store, from which its initialization vector is derived, or which its tag authenticates.
+ @param input The sector's input. Must be one sector long. May not be NULL.
+ @param output The buffer into which to write the sector's output. Must be one sector long. May not be NULL.
+ @param tagRecord The sector's PGBandStoreSectorTagLength-byte tag record. May be NULL if the store's sectors aren't encrypted with AES-GCM.
+ 
+ @return PGCryptoSuccess if the sector was processed successfully, or the provider's status otherwise.
+ */
+- (PGCryptoStatus)cryptSectorWithOperation:(PGCryptoOperation)operation sectorNumber:(uint64_t)sectorNumber input:(const void *)input 
+                                    output:(void *)output tagRecord:(void *)tagRecord;
+
+/*!
+ @abstract Writes the HMAC that authenticates the specified written sector bitmap of the band with the specified index.
+ @param mac The buffer into which to write the HMAC. Must have room for PGCryptoHMACSHA256Length bytes. May not be NULL.
+ @param bandIndex The band's index.
+ @param bitmap The band's written sector bitmap, which has one bit for each of its sectors. May not be NULL.
+ */
+- (void)getWrittenSectorsMAC:(void *)mac forBandAtIndex:(NSUInteger)bandIndex bitmap:(const uint8_t *)bitmap;
+
+/*!
+ @abstract Atomically writes the store's info dictionary with its current length.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ @return Whether the info was written.
+ */
+- (BOOL)writeInfo:(NSError **)errorOut;
+
+@end
+
+
+#pragma mark - Implementation
+
+@implementation PGBandStore {
+    NSString *_path;
+    NSString *_bandsPath;
+    NSString *_tagsPath;
+    NSMutableDictionary *_info;
+    BOOL _infoDirty;
+    
+    // Sectors are encrypted in GCM mode with a random nonce each time they're written, authenticating the sector's number along with its 
+    // contents, or, in version 1 stores, in CBC mode with ESSIV initialization vectors, i.e., each sector's IV is its number encrypted in ECB 
+    // mode with a hash of the volume key. GCM seals each sector with the volume key itself, so it's kept in the key arena. The provider is fixed 
+    // when the store is opened.
+    const PGCryptoProvider *_provider;
+    PGEncryptionAlgorithm _sectorAlgorithm;
+    void *_volumeKey;
+    size_t _volumeKeyLength;
+    void *_writtenSectorsKey;
+    PGCryptoCipherRef _encryptor;
+    PGCryptoCipherRef _decryptor;
+    PGCryptoCipherRef _initializationVectorEncryptor;
+    
+    // Cached bands keyed by index, and their indexes from least to most recently used
+    NSMutableDictionary *_cachedBands;
+    NSMutableArray *_cachedBandIndexes;
+}
+
+
++ (PGBandStore *)createBandStoreAtPath:(NSString *)path password:(NSString *)password length:(unsigned long long)length 
+                              bandSize:(NSUInteger)bandSize error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    NSAssert(password, @"nil password");
+    NSAssert(bandSize > 0 && bandSize % PGBandStoreSectorSize == 0, @"Invalid band size %lu", (unsigned long)bandSize);
+    
+    // Generate a volume key in the key arena and encrypt it with the password. The data object only refers to the arena's copy.
+    void *volumeKeyBytes = PGKeyArenaAllocate(PGSymmetricKeyLength);
+    if (!volumeKeyBytes || ![NSData getRandomBytes:volumeKeyBytes length:PGSymmetricKeyLength]) {
+        PGKeyArenaRelease(volumeKeyBytes);
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:PGCryptoMemoryError userInfo:nil];
+        return nil;
+    }
+    
+    NSData *volumeKey = [NSData dataWithBytesNoCopy:volumeKeyBytes length:PGSymmetricKeyLength freeWhenDone:NO];
+    NSData *salt = nil;
+    NSNumber *rounds = nil;
+    NSData *iv = nil;
+    NSError *error = nil;
+    PGEncryptionAlgorithm algorithm = [NSData isEncryptionAlgorithmAvailable:PGAES256GCMEncryptionAlgorithm] ? PGAES256GCMEncryptionAlgorithm :
+        PGAES256CBCEncryptionAlgorithm;
+    NSData *secret = [volumeKey encryptedDataWithPassword:password algorithm:algorithm associatedData:nil salt:&salt rounds:&rounds 
+                                     initializationVector:&iv error:&error];
+    if (!secret) {
+        PGKeyArenaRelease(volumeKeyBytes);
+        if (errorOut) *errorOut = error;
+        return nil;
+    }
+    
+    NSData *verifier = [[PGBandStoreVerifierMessage dataUsingEncoding:NSUTF8StringEncoding] HMACSHA256DigestWithKey:volumeKey];
+    NSUInteger version = algorithm == PGAES256GCMEncryptionAlgorithm ? PGBandStoreVersion : PGBandStoreMinimumVersion;
+    NSMutableDictionary *info = [NSMutableDictionary dictionaryWithObjectsAndKeys:[NSNumber numberWithUnsignedInteger:version], 
+                                 PGVersionBandStoreInfoKey, [NSNumber numberWithUnsignedInteger:bandSize], PGBandSizeBandStoreInfoKey, 
+                                 [NSNumber numberWithUnsignedLongLong:length], PGLengthBandStoreInfoKey, salt, PGSaltBandStoreInfoKey, 
+                                 rounds, PGRoundsBandStoreInfoKey, iv, PGInitializationVectorBandStoreInfoKey, secret, PGSecretBandStoreInfoKey,
+                                 verifier, PGVerifierBandStoreInfoKey, [NSNumber numberWithUnsignedInt:algorithm], 
+                                 PGAlgorithmBandStoreInfoKey, nil];
+    if (algorithm == PGAES256GCMEncryptionAlgorithm) {
+        [info setObject:[NSNumber numberWithUnsignedInt:algorithm] forKey:PGSectorAlgorithmBandStoreInfoKey];
+    }
+    
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSDictionary *attributes = [NSDictionary dictionaryWithObject:[NSNumber numberWithShort:0700] forKey:NSFilePosixPermissions];
+    if (![fileManager createDirectoryAtPath:path withIntermediateDirectories:NO attributes:attributes error:&error] || 
+        ![fileManager createDirectoryAtPath:[path stringByAppendingPathComponent:PGBandStoreBandsDirectoryName] withIntermediateDirectories:NO
+                                 attributes:attributes error:&error] ||
+        (algorithm == PGAES256GCMEncryptionAlgorithm && 
+         ![fileManager createDirectoryAtPath:[path stringByAppendingPathComponent:PGBandStoreTagsDirectoryName] withIntermediateDirectories:NO 
+                                  attributes:attributes error:&error])) {
+        PGKeyArenaRelease(volumeKeyBytes);
+        if (errorOut) *errorOut = error;
+        return nil;
+    }
+    
+    PGBandStore *bandStore = [[self alloc] initWithPath:path info:info volumeKey:volumeKeyBytes length:PGSymmetricKeyLength error:errorOut];
+    PGKeyArenaRelease(volumeKeyBytes);
+    return [bandStore writeInfo:errorOut] ? bandStore : nil;
+}
+
+
++ (BOOL)changePasswordOfBandStoreAtPath:(NSString *)path fromPassword:(NSString *)oldPassword toPassword:(NSString *)newPassword 
+                                  error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    NSAssert(oldPassword, @"nil old password");
+    NSAssert(newPassword, @"nil new password");
+    
+    NSMutableDictionary *info = [[self infoForBandStoreAtPath:path error:errorOut] mutableCopy];
+    if (!info) return NO;
+    
+    void *volumeKeyBytes = PGKeyArenaAllocate(PGKeyArenaBlockSize);
+    size_t volumeKeyLength = 0;
+    if (!volumeKeyBytes || ![self getVolumeKey:volumeKeyBytes length:&volumeKeyLength info:info password:oldPassword error:errorOut]) {
+        if (!volumeKeyBytes && errorOut) *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:PGCryptoMemoryError userInfo:nil];
+        PGKeyArenaRelease(volumeKeyBytes);
+        return NO;
+    }
+    
+    // Only the volume key's encryption changes, so none of the bands need to be rewritten. The new salt and initialization vector replace the
+    // old ones along with the secret when the info is atomically rewritten.
+    NSData *volumeKey = [NSData dataWithBytesNoCopy:volumeKeyBytes length:volumeKeyLength freeWhenDone:NO];
+    NSData *salt = nil;
+    NSNumber *rounds = nil;
+    NSData *iv = nil;
+    NSError *error = nil;
+    NSData *secret = [volumeKey encryptedDataWithPassword:newPassword algorithm:[[info objectForKey:PGAlgorithmBandStoreInfoKey] unsignedIntValue] 
+                                           associatedData:nil salt:&salt rounds:&rounds initializationVector:&iv error:&error];
+    PGKeyArenaRelease(volumeKeyBytes);
+    if (!secret) {
+        if (errorOut) *errorOut = error;
+        return NO;
+    }
+    
+    [info setObject:salt forKey:PGSaltBandStoreInfoKey];
+    [info setObject:rounds forKey:PGRoundsBandStoreInfoKey];
+    [info setObject:iv forKey:PGInitializationVectorBandStoreInfoKey];
+    [info setObject:secret forKey:PGSecretBandStoreInfoKey];
+    
+    NSData *infoData = [NSPropertyListSerialization dataWithPropertyList:info format:NSPropertyListXMLFormat_v1_0 options:0 error:&error];
+    if (!infoData || ![infoData writeToFile:[path stringByAppendingPathComponent:PGBandStoreInfoFilename] options:NSDataWritingAtomic error:&error]) {
+        if (errorOut) *errorOut = error;
+        return NO;
+    }
+    
+    return YES;
+}
+
+
+// There’s no meaningful default values for our designated initializer, so we just don't recognize the -init message.
+- (id)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    return nil;
+}
+
+
+- (id)initWithContentsOfFile:(NSString *)path password:(NSString *)password error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    NSAssert(password, @"nil password");
+    
+    NSDictionary *info = [[self class] infoForBandStoreAtPath:path error:errorOut];
+    if (!info) return nil;
+    
+    // The volume key stays in the key arena throughout
+    void *volumeKey = PGKeyArenaAllocate(PGKeyArenaBlockSize);
+    size_t volumeKeyLength = 0;
+    BOOL authenticated = volumeKey && [[self class] getVolumeKey:volumeKey length:&volumeKeyLength info:info password:password error:errorOut];
+    if (authenticated) self = [self initWithPath:path info:info volumeKey:volumeKey length:volumeKeyLength error:errorOut];
+    PGKeyArenaRelease(volumeKey);
+    
+    if (!volumeKey && errorOut) *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:PGCryptoMemoryError userInfo:nil];
+    return authenticated ? self : nil;
+}
+
+
++ (NSDictionary *)infoForBandStoreAtPath:(NSString *)path error:(NSError **)errorOut
+{
+    NSDictionary *info = [NSDictionary dictionaryWithContentsOfFile:[path stringByAppendingPathComponent:PGBandStoreInfoFilename]];
+    NSData *salt = [info objectForKey:PGSaltBandStoreInfoKey];
+    NSNumber *rounds = [info objectForKey:PGRoundsBandStoreInfoKey];
+    NSData *iv = [info objectForKey:PGInitializationVectorBandStoreInfoKey];
+    NSData *secret = [info objectForKey:PGSecretBandStoreInfoKey];
+    NSData *verifier = [info objectForKey:PGVerifierBandStoreInfoKey];
+    NSUInteger bandSize = [[info objectForKey:PGBandSizeBandStoreInfoKey] unsignedIntegerValue];
+    NSUInteger version = [[info objectForKey:PGVersionBandStoreInfoKey] unsignedIntegerValue];
+    PGEncryptionAlgorithm sectorAlgorithm = [[info objectForKey:PGSectorAlgorithmBandStoreInfoKey] unsignedIntValue];
+    if (!(salt && rounds && iv && secret && verifier && [info objectForKey:PGLengthBandStoreInfoKey]) || 
+        version < PGBandStoreMinimumVersion || version > PGBandStoreVersion ||
+        sectorAlgorithm != (version == PGBandStoreMinimumVersion ? PGAES256CBCEncryptionAlgorithm : PGAES256GCMEncryptionAlgorithm) ||
+        bandSize == 0 || bandSize % PGBandStoreSectorSize != 0) {
+        if (errorOut) *errorOut = PGBandStoreMalformedError();
+        return nil;
+    }
+    
+    return info;
+}
+
+
++ (BOOL)getVolumeKey:(void *)volumeKey length:(size_t *)volumeKeyLengthOut info:(NSDictionary *)info password:(NSString *)password 
+               error:(NSError **)errorOut
+{
+    NSData *salt = [info objectForKey:PGSaltBandStoreInfoKey];
+    NSNumber *rounds = [info objectForKey:PGRoundsBandStoreInfoKey];
+    NSData *iv = [info objectForKey:PGInitializationVectorBandStoreInfoKey];
+    NSData *secret = [info objectForKey:PGSecretBandStoreInfoKey];
+    NSData *verifier = [info objectForKey:PGVerifierBandStoreInfoKey];
+    PGEncryptionAlgorithm algorithm = [[info objectForKey:PGAlgorithmBandStoreInfoKey] unsignedIntValue];
+    
+    // Decrypt the volume key and make sure it's the right one. With GCM, a wrong password always fails to decrypt; with CBC, it usually does, 
+    // but not always, so the verifier is still checked. The password's key stays in the key arena too.
+    NSError *error = nil;
+    void *passwordKey = PGKeyArenaAllocate(PGSymmetricKeyLength);
+    uint8_t verifierBytes[PGCryptoHMACSHA256Length];
+    BOOL authenticated = passwordKey && [iv length] >= [NSData initializationVectorLengthForAlgorithm:algorithm] &&
+        [NSData getSymmetricKey:passwordKey forPassword:password salt:salt rounds:rounds error:&error] &&
+        [secret getDecryptedBytes:volumeKey capacity:PGKeyArenaBlockSize length:volumeKeyLengthOut symmetricKey:passwordKey 
+                        keyLength:PGSymmetricKeyLength algorithm:algorithm associatedData:nil initializationVector:[iv bytes] error:&error];
+    if (authenticated) {
+        [[PGBandStoreVerifierMessage dataUsingEncoding:NSUTF8StringEncoding] getHMACSHA256Digest:verifierBytes withKeyBytes:volumeKey 
+                                                                                         length:*volumeKeyLengthOut];
+        authenticated = [[NSData dataWithBytesNoCopy:verifierBytes length:sizeof(verifierBytes) freeWhenDone:NO] 
+                         isEqualToDataInConstantTime:verifier];
+    }
+    
+    PGKeyArenaRelease(passwordKey);
+    
+    if (!authenticated) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperAuthenticationError underlyingError:error];
+        return NO;
+    }
+    
+    return YES;
+}
+
+
+- (id)initWithPath:(NSString *)path info:(NSDictionary *)info volumeKey:(const void *)volumeKey length:(size_t)volumeKeyLength 
+             error:(NSError **)errorOut
+{
+    if (!(self = [super init])) return nil;
+    
+    _path = [path copy];
+    _bandsPath = [path stringByAppendingPathComponent:PGBandStoreBandsDirectoryName];
+    _info = [info mutableCopy];
+    _sectorAlgorithm = [[info objectForKey:PGSectorAlgorithmBandStoreInfoKey] unsignedIntValue];
+    if (_sectorAlgorithm == PGAES256GCMEncryptionAlgorithm) _tagsPath = [path stringByAppendingPathComponent:PGBandStoreTagsDirectoryName];
+    _length = [[info objectForKey:PGLengthBandStoreInfoKey] unsignedLongLongValue];
+    _bandSize = [[info objectForKey:PGBandSizeBandStoreInfoKey] unsignedIntegerValue];
+    _sectorSize = PGBandStoreSectorSize;
+    _cacheCapacity = PGBandStoreDefaultCacheCapacity;
+    _cachedBands = [[NSMutableDictionary alloc] init];
+    _cachedBandIndexes = [[NSMutableArray alloc] init];
+    
+    _provider = PGCryptoDefaultProvider();
+    if (_sectorAlgorithm == PGAES256GCMEncryptionAlgorithm) {
+        _volumeKey = PGKeyArenaAllocate(volumeKeyLength);
+        if (!_volumeKey) {
+            if (errorOut) *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:PGCryptoMemoryError userInfo:nil];
+            return nil;
+        }
+        
+        memcpy(_volumeKey, volumeKey, volumeKeyLength);
+        _volumeKeyLength = volumeKeyLength;
+        
+        NSData *keyMessage = [PGBandStoreWrittenSectorsKeyMessage dataUsingEncoding:NSUTF8StringEncoding];
+        _writtenSectorsKey = PGKeyArenaAllocate(PGCryptoHMACSHA256Length);
+        PGCryptoStatus result = _writtenSectorsKey ? 
+            _provider->HMACSHA256(volumeKey, volumeKeyLength, [keyMessage bytes], [keyMessage length], _writtenSectorsKey) : PGCryptoMemoryError;
+        if (result != PGCryptoSuccess) {
+            if (errorOut) *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:result userInfo:nil];
+            return nil;
+        }
+        
+        return self;
+    }
+    
+    // The initialization vector key is as secret as the volume key, so it lives in the key arena too
+    void *initializationVectorKey = PGKeyArenaAllocate(PGCryptoDigestLength(PGCryptoDigestSHA256));
+    PGCryptoStatus result = initializationVectorKey ? 
+        _provider->digest(PGCryptoDigestSHA256, volumeKey, volumeKeyLength, initializationVectorKey) : PGCryptoMemoryError;
+    if (result == PGCryptoSuccess) {
+        result = _provider->cipherCreate(PGCryptoEncrypt, PGCryptoModeCBC, false, volumeKey, volumeKeyLength, NULL, &_encryptor);
+    }
+    
+    if (result == PGCryptoSuccess) {
+        result = _provider->cipherCreate(PGCryptoDecrypt, PGCryptoModeCBC, false, volumeKey, volumeKeyLength, NULL, &_decryptor);
+    }
+    
+    if (result == PGCryptoSuccess) {
+        result = _provider->cipherCreate(PGCryptoEncrypt, PGCryptoModeECB, false, initializationVectorKey, PGCryptoDigestLength(PGCryptoDigestSHA256),
+                                         NULL, &_initializationVectorEncryptor);
+    }
+    
+    PGKeyArenaRelease(initializationVectorKey);
+    
+    if (result != PGCryptoSuccess) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:result userInfo:nil];
+        return nil;
+    }
+    
+    return self;
+}
+
+
+- (void)dealloc
+{
+    if (_encryptor) _provider->cipherRelease(_encryptor);
+    if (_decryptor) _provider->cipherRelease(_decryptor);
+    if (_initializationVectorEncryptor) _provider->cipherRelease(_initializationVectorEncryptor);
+    PGKeyArenaRelease(_volumeKey);
+    PGKeyArenaRelease(_writtenSectorsKey);
+}
+
+
+- (void)setCacheCapacity:(NSUInteger)cacheCapacity
+{
+    NSAssert(cacheCapacity > 0, @"zero cache capacity");
+    _cacheCapacity = cacheCapacity;
+    [self evictBandsIfNeeded:NULL];
+}
+
+
+#pragma mark Reading and Writing
+
+- (NSInteger)readBytes:(void *)buffer length:(NSUInteger)length atOffset:(unsigned long long)offset error:(NSError **)errorOut
+{
+    NSAssert(buffer, @"NULL buffer");
+    
+    if (offset >= _length) return 0;
+    if (length > _length - offset) length = (NSUInteger)(_length - offset);
+    
+    NSUInteger totalLength = 0;
+    while (totalLength < length) {
+        unsigned long long position = offset + totalLength;
+        NSUInteger bandIndex = (NSUInteger)(position / _bandSize);
+        NSUInteger bandOffset = (NSUInteger)(position % _bandSize);
+        NSUInteger chunkLength = MIN(length - totalLength, _bandSize - bandOffset);
+        
+        // Bands that were never written read as zeros, and there's no point in caching them
+        if (![_cachedBands objectForKey:[NSNumber numberWithUnsignedInteger:bandIndex]] && ![self bandExistsAtIndex:bandIndex]) {
+            memset((uint8_t *)buffer + totalLength, 0, chunkLength);
+        } else {
+            PGBandStoreBand *band = [self bandAtIndex:bandIndex error:errorOut];
+            if (!band) return -1;
+            
+            NSUInteger firstSector = bandOffset / _sectorSize;
+            NSUInteger lastSector = (bandOffset + chunkLength - 1) / _sectorSize;
+            if ([[band failedSectors] intersectsIndexesInRange:NSMakeRange(firstSector, lastSector - firstSector + 1)]) {
+                if (errorOut) *errorOut = PGBandStoreMalformedError();
+                return -1;
+            }
+            
+            memcpy((uint8_t *)buffer + totalLength, (const uint8_t *)[[band bytes] bytes] + bandOffset, chunkLength);
+        }
+        
+        totalLength += chunkLength;
+    }
+    
+    return totalLength;
+}
+
+
+- (NSData *)readDataOfLength:(NSUInteger)length atOffset:(unsigned long long)offset error:(NSError **)errorOut
+{
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    NSInteger readLength = [self readBytes:[data mutableBytes] length:length atOffset:offset error:errorOut];
+    if (readLength < 0) return nil;
+    
+    [data setLength:readLength];
+    return data;
+}
+
+
+- (BOOL)writeBytes:(const void *)bytes length:(NSUInteger)length atOffset:(unsigned long long)offset error:(NSError **)errorOut
+{
+    NSAssert(bytes, @"NULL bytes");
+    
+    NSUInteger totalLength = 0;
+    while (totalLength < length) {
+        unsigned long long position = offset + totalLength;
+        NSUInteger bandIndex = (NSUInteger)(position / _bandSize);
+        NSUInteger bandOffset = (NSUInteger)(position % _bandSize);
+        NSUInteger chunkLength = MIN(length - totalLength, _bandSize - bandOffset);
+        
+        PGBandStoreBand *band = [self bandAtIndex:bandIndex error:errorOut];
+        if (!band) return NO;
+        
+        // A sector that failed to authenticate can be replaced, but not partially rewritten, since the rest of its contents are unknown
+        NSUInteger firstSector = bandOffset / _sectorSize;
+        NSUInteger lastSector = (bandOffset + chunkLength - 1) / _sectorSize;
+        if ((bandOffset % _sectorSize != 0 && [[band failedSectors] containsIndex:firstSector]) || 
+            ((bandOffset + chunkLength) % _sectorSize != 0 && [[band failedSectors] containsIndex:lastSector])) {
+            if (errorOut) *errorOut = PGBandStoreMalformedError();
+            return NO;
+        }
+        
+        memcpy((uint8_t *)[[band bytes] mutableBytes] + bandOffset, (const uint8_t *)bytes + totalLength, chunkLength);
+        [[band failedSectors] removeIndexesInRange:NSMakeRange(firstSector, lastSector - firstSector + 1)];
+        [[band dirtySectors] addIndexesInRange:NSMakeRange(firstSector, lastSector - firstSector + 1)];
+        
+        totalLength += chunkLength;
+    }
+    
+    if (offset + length > _length) {
+        _length = offset + length;
+        _infoDirty = YES;
+    }
+    
+    return [self evictBandsIfNeeded:errorOut];
+}
+
+
+- (BOOL)writeData:(NSData *)data atOffset:(unsigned long long)offset error:(NSError **)errorOut
+{
+    NSAssert(data, @"nil data");
+    return [self writeBytes:[data bytes] length:[data length] atOffset:offset error:errorOut];
+}
+
+
+- (BOOL)truncateToLength:(unsigned long long)length error:(NSError **)errorOut
+{
+    if (length < _length) {
+        // Everything past the new end must read as zeros if the store is lengthened again. Whole bands past the end are deleted, whole sectors 
+        // past the end of the last band are marked as unwritten in its bitmap, or without GCM, truncated to holes, and the last partial sector is 
+        // zeroed. Tag files are deleted before band files, since a band without a tag file reads as unwritten, while one without a band file 
+        // fails to read.
+        NSUInteger bandCount = (NSUInteger)((length + _bandSize - 1) / _bandSize);
+        for (NSNumber *bandIndex in [_cachedBands allKeys]) {
+            if ([bandIndex unsignedIntegerValue] >= bandCount) {
+                [_cachedBands removeObjectForKey:bandIndex];
+                [_cachedBandIndexes removeObject:bandIndex];
+            }
+        }
+        
+        NSArray *directoryPaths = _tagsPath ? [NSArray arrayWithObjects:_tagsPath, _bandsPath, nil] : [NSArray arrayWithObject:_bandsPath];
+        for (NSString *directoryPath in directoryPaths) {
+            for (NSString *bandFilename in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:directoryPath error:NULL]) {
+                unsigned long long bandIndex = strtoull([bandFilename UTF8String], NULL, 16);
+                if (bandIndex >= bandCount) {
+                    [[NSFileManager defaultManager] removeItemAtPath:[directoryPath stringByAppendingPathComponent:bandFilename] error:NULL];
+                }
+            }
+        }
+        
+        NSUInteger bandOffset = (NSUInteger)(length % _bandSize);
+        if (bandOffset != 0) {
+            NSUInteger lastBandIndex = bandCount - 1;
+            NSUInteger sectorCount = (bandOffset + _sectorSize - 1) / _sectorSize;
+            PGBandStoreBand *band = [_cachedBands objectForKey:[NSNumber numberWithUnsignedInteger:lastBandIndex]];
+            
+            // Truncating a tag file would cut off its bitmap, so with GCM, the band is read and its bitmap updated instead
+            NSString *bandPath = [self pathForBandAtIndex:lastBandIndex];
+            if (!_tagsPath && truncate([bandPath fileSystemRepresentation], sectorCount * _sectorSize) == -1 && errno != ENOENT) {
+                if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+                return NO;
+            }
+            
+            if ((_tagsPath || bandOffset % _sectorSize != 0) && !band && [self bandExistsAtIndex:lastBandIndex]) {
+                band = [self bandAtIndex:lastBandIndex error:errorOut];
+                if (!band) return NO;
+            }
+            
+            if (band) {
+                NSRange truncatedSectors = NSMakeRange(sectorCount, _bandSize / _sectorSize - sectorCount);
+                memset((uint8_t *)[[band bytes] mutableBytes] + bandOffset, 0, _bandSize - bandOffset);
+                [[band dirtySectors] removeIndexesInRange:truncatedSectors];
+                [[band failedSectors] removeIndexesInRange:truncatedSectors];
+                if ([[band writtenSectors] intersectsIndexesInRange:truncatedSectors]) {
+                    [[band writtenSectors] removeIndexesInRange:truncatedSectors];
+                    [band setWrittenSectorsDirty:YES];
+                }
+                
+                // The part of a sector that failed to authenticate that's before the new end is still unknown, so the sector stays failed
+                if (bandOffset % _sectorSize != 0 && ![[band failedSectors] containsIndex:sectorCount - 1]) {
+                    [[band dirtySectors] addIndex:sectorCount - 1];
+                }
+            }
+        }
+    }
+    
+    _length = length;
+    _infoDirty = YES;
+    return YES;
+}
+
+
+- (BOOL)flush:(NSError **)errorOut
+{
+    for (NSNumber *bandIndex in _cachedBandIndexes) {
+        PGBandStoreBand *band = [_cachedBands objectForKey:bandIndex];
+        if (([[band dirtySectors] count] || [band writtenSectorsDirty]) && ![self writeBand:band synchronize:YES error:errorOut]) return NO;
+    }
+    
+    return _infoDirty ? [self writeInfo:errorOut] : YES;
+}
+
+
+#pragma mark Private Methods
+
+- (NSString *)pathForBandAtIndex:(NSUInteger)bandIndex
+{
+    return [_bandsPath stringByAppendingPathComponent:[NSString stringWithFormat:@"%lx", (unsigned long)bandIndex]];
+}
+
+
+- (NSString *)pathForTagsOfBandAtIndex:(NSUInteger)bandIndex
+{
+    return [_tagsPath stringByAppendingPathComponent:[NSString stringWithFormat:@"%lx", (unsigned long)bandIndex]];
+}
+
+
+- (BOOL)bandExistsAtIndex:(NSUInteger)bandIndex
+{
+    NSString *path = _tagsPath ? [self pathForTagsOfBandAtIndex:bandIndex] : [self pathForBandAtIndex:bandIndex];
+    return [[NSFileManager defaultManager] fileExistsAtPath:path];
+}
+
+
+- (PGBandStoreBand *)bandAtIndex:(NSUInteger)bandIndex error:(NSError **)errorOut
+{
+    NSNumber *bandIndexNumber = [NSNumber numberWithUnsignedInteger:bandIndex];
+    PGBandStoreBand *band = [_cachedBands objectForKey:bandIndexNumber];
+    if (band) {
+        [_cachedBandIndexes removeObject:bandIndexNumber];
+        [_cachedBandIndexes addObject:bandIndexNumber];
+        return band;
+    }
+    
+    // Read whatever exists of the band's file and its tag file. Anything past the end of either file, or in a hole, is zeros.
+    NSUInteger sectorsPerBand = _bandSize / _sectorSize;
+    size_t bitmapLength = (sectorsPerBand + 7) / 8;
+    NSMutableData *bytes = [NSMutableData dataWithLength:_bandSize];
+    NSMutableData *ciphertext = [NSMutableData dataWithLength:_bandSize];
+    NSMutableData *tags = _tagsPath ? 
+        [NSMutableData dataWithLength:sectorsPerBand * PGBandStoreSectorTagLength + bitmapLength + PGCryptoHMACSHA256Length] : nil;
+    size_t totalLength = 0;
+    size_t tagsLength = 0;
+    BOOL tagsExist = NO;
+    if (!PGBandStoreReadFile([self pathForBandAtIndex:bandIndex], [ciphertext mutableBytes], _bandSize, &totalLength, NULL, errorOut) ||
+        (tags && !PGBandStoreReadFile([self pathForTagsOfBandAtIndex:bandIndex], [tags mutableBytes], [tags length], &tagsLength, &tagsExist, 
+                                      errorOut))) {
+        return nil;
+    }
+    
+    band = [[PGBandStoreBand alloc] initWithIndex:bandIndex bytes:bytes];
+    NSMutableIndexSet *writtenSectors = [band writtenSectors];
+    if (tags && tagsExist) {
+        // The tag file's bitmap says which sectors have been written, so zeroing or truncating a sector or its tag record doesn't make it read 
+        // as unwritten. A bitmap that is cut off or fails to authenticate can't be trusted, so every sector is treated as written. Those that 
+        // were only fail to authenticate until they're overwritten.
+        const uint8_t *bitmap = (const uint8_t *)[tags bytes] + sectorsPerBand * PGBandStoreSectorTagLength;
+        uint8_t mac[PGCryptoHMACSHA256Length];
+        [self getWrittenSectorsMAC:mac forBandAtIndex:bandIndex bitmap:bitmap];
+        NSData *storedMAC = [NSData dataWithBytesNoCopy:(void *)(bitmap + bitmapLength) length:sizeof(mac) freeWhenDone:NO];
+        NSData *expectedMAC = [NSData dataWithBytesNoCopy:mac length:sizeof(mac) freeWhenDone:NO];
+        if (tagsLength < [tags length] || ![expectedMAC isEqualToDataInConstantTime:storedMAC]) {
+            [writtenSectors addIndexesInRange:NSMakeRange(0, sectorsPerBand)];
+        } else {
+            for (NSUInteger sector = 0; sector < sectorsPerBand; ++sector) {
+                if (bitmap[sector / 8] & (1 << (sector % 8))) [writtenSectors addIndex:sector];
+            }
+        }
+    } else if (!tags) {
+        // Without GCM, sectors that have never been written are holes, which are all zeros
+        for (NSUInteger sector = 0; sector < sectorsPerBand && sector * _sectorSize < totalLength; ++sector) {
+            if (!PGBandStoreBytesAreZero((const uint8_t *)[ciphertext bytes] + sector * _sectorSize, _sectorSize)) [writtenSectors addIndex:sector];
+        }
+    }
+    
+    // Decrypt each sector that has been written. With GCM, that means it's authentic and in its original place. A sector that isn't is left as 
+    // zeros and remembered, so that the rest of the band can still be read and written.
+    __block PGCryptoStatus status = PGCryptoSuccess;
+    [writtenSectors enumerateIndexesUsingBlock:^(NSUInteger sector, BOOL *stop) {
+        uint8_t *sectorBytes = (uint8_t *)[bytes mutableBytes] + sector * _sectorSize;
+        status = [self cryptSectorWithOperation:PGCryptoDecrypt sectorNumber:(uint64_t)bandIndex * sectorsPerBand + sector 
+                                          input:(const uint8_t *)[ciphertext bytes] + sector * _sectorSize output:sectorBytes
+                                      tagRecord:tags ? (uint8_t *)[tags mutableBytes] + sector * PGBandStoreSectorTagLength : NULL];
+        if (status == PGCryptoDecodeError && tags) {
+            memset(sectorBytes, 0, _sectorSize);
+            [[band failedSectors] addIndex:sector];
+            status = PGCryptoSuccess;
+        }
+        
+        if (status != PGCryptoSuccess) *stop = YES;
+    }];
+    
+    if (status != PGCryptoSuccess) {
+        if (errorOut) *errorOut = PGBandStoreMalformedError();
+        return nil;
+    }
+    
+    [_cachedBands setObject:band forKey:bandIndexNumber];
+    [_cachedBandIndexes addObject:bandIndexNumber];
+    return band;
+}
+
+
+- (BOOL)writeBand:(PGBandStoreBand *)band synchronize:(BOOL)synchronize error:(NSError **)errorOut
+{
+    int fileDescriptor = open([[self pathForBandAtIndex:[band index]] fileSystemRepresentation], O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+    if (fileDescriptor == -1) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return NO;
+    }
+    
+    // Encrypt and write each contiguous run of dirty sectors with a single write apiece
+    NSUInteger sectorsPerBand = _bandSize / _sectorSize;
+    NSMutableData *ciphertext = [NSMutableData dataWithLength:_bandSize];
+    NSMutableData *tags = _tagsPath ? [NSMutableData dataWithLength:sectorsPerBand * PGBandStoreSectorTagLength] : nil;
+    __block BOOL success = YES;
+    __block NSError *error = nil;
+    [[band dirtySectors] enumerateRangesUsingBlock:^(NSRange range, BOOL *stop) {
+        for (NSUInteger sector = range.location; sector < NSMaxRange(range); ++sector) {
+            uint8_t *sectorTagRecord = tags ? (uint8_t *)[tags mutableBytes] + sector * PGBandStoreSectorTagLength : NULL;
+            PGCryptoStatus status = [self cryptSectorWithOperation:PGCryptoEncrypt sectorNumber:(uint64_t)[band index] * sectorsPerBand + sector 
+                                                             input:(const uint8_t *)[[band bytes] bytes] + sector * _sectorSize
+                                                            output:(uint8_t *)[ciphertext mutableBytes] + sector * _sectorSize
+                                                         tagRecord:sectorTagRecord];
+            if (status != PGCryptoSuccess) {
+                error = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:status userInfo:nil];
+                success = NO;
+                *stop = YES;
+                return;
+            }
+        }
+        
+        if (!PGBandStoreWriteFully(fileDescriptor, (const uint8_t *)[ciphertext bytes] + range.location * _sectorSize, range.length * _sectorSize, 
+                                   range.location * _sectorSize)) {
+            error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            success = NO;
+            *stop = YES;
+        }
+    }];
+    
+    // The bitmap only changes when sectors are written for the first time or the store is truncated, so it's usually left alone. When it does
+    // change, or the band has no tag file yet, the ciphertext and tag records must reach the disk first.
+    NSMutableIndexSet *writtenSectors = [[band writtenSectors] mutableCopy];
+    [writtenSectors addIndexes:[band dirtySectors]];
+    BOOL writtenSectorsChanged = tags && ([band writtenSectorsDirty] || ![writtenSectors isEqualToIndexSet:[band writtenSectors]] ||
+                                          ![self bandExistsAtIndex:[band index]]);
+    if (success && (synchronize || writtenSectorsChanged) && fsync(fileDescriptor) != 0) {
+        error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        success = NO;
+    }
+    
+    close(fileDescriptor);
+    
+    if (success && tags) success = [self writeTags:tags ofBand:band writtenSectors:(writtenSectorsChanged ? writtenSectors : nil) 
+                                       synchronize:synchronize error:&error];
+    
+    if (!success) {
+        if (errorOut) *errorOut = error;
+        return NO;
+    }
+    
+    [[band writtenSectors] addIndexes:[band dirtySectors]];
+    [[band dirtySectors] removeAllIndexes];
+    [band setWrittenSectorsDirty:NO];
+    return YES;
+}
+
+
+- (BOOL)writeTags:(NSData *)tags ofBand:(PGBandStoreBand *)band writtenSectors:(NSIndexSet *)writtenSectors synchronize:(BOOL)synchronize 
+            error:(NSError **)errorOut
+{
+    // A band's first tag file is written beside it and renamed into place, so a tag file without its bitmap is never left behind
+    NSString *tagsPath = [self pathForTagsOfBandAtIndex:[band index]];
+    NSString *newTagsPath = nil;
+    int fileDescriptor = open([tagsPath fileSystemRepresentation], O_WRONLY);
+    if (fileDescriptor == -1 && errno == ENOENT) {
+        newTagsPath = [tagsPath stringByAppendingPathExtension:@"new"];
+        fileDescriptor = open([newTagsPath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    }
+    
+    if (fileDescriptor == -1) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return NO;
+    }
+    
+    __block BOOL success = YES;
+    [[band dirtySectors] enumerateRangesUsingBlock:^(NSRange range, BOOL *stop) {
+        if (!PGBandStoreWriteFully(fileDescriptor, (const uint8_t *)[tags bytes] + range.location * PGBandStoreSectorTagLength, 
+                                   range.length * PGBandStoreSectorTagLength, range.location * PGBandStoreSectorTagLength)) {
+            success = NO;
+            *stop = YES;
+        }
+    }];
+    
+    if (success && writtenSectors) {
+        NSUInteger sectorsPerBand = _bandSize / _sectorSize;
+        size_t bitmapLength = (sectorsPerBand + 7) / 8;
+        NSMutableData *trailer = [NSMutableData dataWithLength:bitmapLength + PGCryptoHMACSHA256Length];
+        uint8_t *bitmap = [trailer mutableBytes];
+        [writtenSectors enumerateIndexesUsingBlock:^(NSUInteger sector, BOOL *stop) {
+            bitmap[sector / 8] |= 1 << (sector % 8);
+        }];
+        
+        [self getWrittenSectorsMAC:bitmap + bitmapLength forBandAtIndex:[band index] bitmap:bitmap];
+        success = (newTagsPath || fsync(fileDescriptor) == 0) && 
+            PGBandStoreWriteFully(fileDescriptor, bitmap, [trailer length], sectorsPerBand * PGBandStoreSectorTagLength);
+    }
+    
+    if (success && (synchronize || newTagsPath)) success = fsync(fileDescriptor) == 0;
+    if (success && newTagsPath) success = rename([newTagsPath fileSystemRepresentation], [tagsPath fileSystemRepresentation]) == 0;
+    
+    if (!success && errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+    close(fileDescriptor);
+    return success;
+}
+
+
+- (BOOL)evictBandsIfNeeded:(NSError **)errorOut
+{
+    while ([_cachedBandIndexes count] > _cacheCapacity) {
+        NSNumber *bandIndex = [_cachedBandIndexes objectAtIndex:0];
+        PGBandStoreBand *band = [_cachedBands objectForKey:bandIndex];
+        if (([[band dirtySectors] count] || [band writtenSectorsDirty]) && ![self writeBand:band synchronize:NO error:errorOut]) return NO;
+        
+        [_cachedBands removeObjectForKey:bandIndex];
+        [_cachedBandIndexes removeObjectAtIndex:0];
+    }
+    
+    return YES;
+}
+
+
+- (PGCryptoStatus)cryptSectorWithOperation:(PGCryptoOperation)operation sectorNumber:(uint64_t)sectorNumber input:(const void *)input 
+                                    output:(void *)output tagRecord:(void *)tagRecord
+{
+    uint64_t littleEndianSectorNumber = CFSwapInt64HostToLittle(sectorNumber);
+    if (_sectorAlgorithm == PGAES256GCMEncryptionAlgorithm) {
+        // The sector's number is authenticated along with its contents, so sectors can't be swapped with each other
+        NSAssert(tagRecord, @"NULL tag record");
+        uint8_t *nonce = tagRecord;
+        uint8_t *tag = nonce + PGCryptoAESGCMNonceLength;
+        if (operation == PGCryptoDecrypt) {
+            return _provider->GCMOpen(_volumeKey, _volumeKeyLength, nonce, &littleEndianSectorNumber, sizeof(littleEndianSectorNumber), input, 
+                                      _sectorSize, tag, output);
+        }
+        
+        PGCryptoStatus status = _provider->randomBytes(nonce, PGCryptoAESGCMNonceLength);
+        if (status != PGCryptoSuccess) return status;
+        return _provider->GCMSeal(_volumeKey, _volumeKeyLength, nonce, &littleEndianSectorNumber, sizeof(littleEndianSectorNumber), input, 
+                                  _sectorSize, output, tag);
+    }
+    
+    uint8_t sectorBlock[PGCryptoAESBlockSize] = { 0 };
+    uint8_t initializationVector[PGCryptoAESBlockSize];
+    memcpy(sectorBlock, &littleEndianSectorNumber, sizeof(littleEndianSectorNumber));
+    
+    size_t movedLength = 0;
+    PGCryptoStatus status = _provider->cipherUpdate(_initializationVectorEncryptor, sectorBlock, sizeof(sectorBlock), initializationVector, 
+                                                    sizeof(initializationVector), &movedLength);
+    if (status != PGCryptoSuccess) return status;
+    
+    PGCryptoCipherRef cipher = operation == PGCryptoEncrypt ? _encryptor : _decryptor;
+    status = _provider->cipherReset(cipher, initializationVector);
+    if (status == PGCryptoSuccess) status = _provider->cipherUpdate(cipher, input, _sectorSize, output, _sectorSize, &movedLength);
+    
+    // Sectors are a whole number of blocks, so a short result means the cipher is misconfigured
+    if (status == PGCryptoSuccess && movedLength != _sectorSize) status = PGCryptoAlignmentError;
+    return status;
+}
+
+
+- (void)getWrittenSectorsMAC:(void *)mac forBandAtIndex:(NSUInteger)bandIndex bitmap:(const uint8_t *)bitmap
+{
+    uint64_t littleEndianBandIndex = CFSwapInt64HostToLittle(bandIndex);
+    NSMutableData *message = [NSMutableData dataWithBytes:&littleEndianBandIndex length:sizeof(littleEndianBandIndex)];
+    [message appendBytes:bitmap length:(_bandSize / _sectorSize + 7) / 8];
+    [message getHMACSHA256Digest:mac withKeyBytes:_writtenSectorsKey length:PGCryptoHMACSHA256Length];
+}
+
+
+- (BOOL)writeInfo:(NSError **)errorOut
+{
+    [_info setObject:[NSNumber numberWithUnsignedLongLong:_length] forKey:PGLengthBandStoreInfoKey];
+    
+    NSError *error = nil;
+    NSData *infoData = [NSPropertyListSerialization dataWithPropertyList:_info format:NSPropertyListXMLFormat_v1_0 options:0 error:&error];
+    if (!infoData || ![infoData writeToFile:[_path stringByAppendingPathComponent:PGBandStoreInfoFilename] options:NSDataWritingAtomic error:&error]) {
+        if (errorOut) *errorOut = error;
+        return NO;
+    }
+    
+    _infoDirty = NO;
+    return YES;
+}
+
+@end
@@ -0,0 +1,122 @@
+//
+//  PGBulkAttachScheduler.h
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+@class PGEncryptedDiskImageWrapper;
+
+/*!
+ @abstract PGBulkAttachRequest instances describe a wrapper to be opened, and optionally attached, by a bulk attach scheduler.
+ @discussion Once the scheduler has finished with a request, its wrapper and error properties describe the outcome. A request may only be 
+     scheduled once.
+ */
+@interface PGBulkAttachRequest : NSObject
+
+/*! @abstract The path of the wrapper to open. */
+@property(readonly, copy) NSString *wrapperPath;
+
+/*! @abstract The user name with which to open the wrapper. */
+@property(readonly, copy) NSString *user;
+
+/*! @abstract The password with which to open the wrapper. */
+@property(readonly, copy) NSString *password;
+
+/*! @abstract The directory in a random subdirectory of which to attach the wrapper's disk image, or nil to only open the wrapper. */
+@property(readonly, copy) NSString *mountRoot;
+
+/*! @abstract The request's priority. Requests with higher priorities are started first. Defaults to 0. */
+@property(readwrite) NSInteger priority;
+
+/*! @abstract The opened wrapper, or nil if it hasn't been or couldn't be opened. If attaching failed, the wrapper is open but not attached. */
+@property(readonly, strong) PGEncryptedDiskImageWrapper *wrapper;
+
+/*! @abstract The error that caused the request to fail, or nil if it hasn't failed. */
+@property(readonly, strong) NSError *error;
+
+/*!
+ @abstract Initializes a newly allocated request.
+ 
+ @param wrapperPath The path of the wrapper to open. May not be nil.
+ @param user The user name with which to open the wrapper. May not be nil.
+ @param password The password with which to open the wrapper. May not be nil.
+ @param mountRoot The directory in a random subdirectory of which to attach the wrapper's disk image. If nil, the wrapper is opened but not 
+     attached.
+ 
+ @return An initialized request.
+ */
+- (id)initWithWrapperPath:(NSString *)wrapperPath user:(NSString *)user password:(NSString *)password mountRoot:(NSString *)mountRoot;
+
+@end
+
+
+/*!
+ @abstract PGBulkAttachScheduler instances open and attach many wrappers concurrently.
+ @discussion Each request goes through two stages: opening the wrapper, which is dominated by key derivation and so is CPU-bound, and attaching
+     its disk image, which waits on hdiutil. Each stage has its own concurrency limit, so that key derivation can keep every core busy while a
+     smaller number of hdiutil processes run. Within each stage, pending requests are started in order of decreasing priority, and in the order
+     they were scheduled among requests of equal priority.
+ 
+     Requests fail independently: a request whose wrapper can't be opened is finished immediately, without attaching, and doesn't affect any other
+     request. Requests from several batches may be scheduled at once, and share the scheduler's limits. Schedulers are thread-safe.
+ */
+@interface PGBulkAttachScheduler : NSObject
+
+/*! @abstract The maximum number of wrappers that are opened at once. Defaults to the number of active processors. */
+@property(readwrite) NSUInteger maximumOpenCount;
+
+/*! @abstract The maximum number of hdiutil tasks that run at once. Defaults to 4. */
+@property(readwrite) NSUInteger maximumAttachCount;
+
+/*! @abstract The timeout of the scheduler's hdiutil tasks. If 0, the default, there is no timeout. */
+@property(readwrite) NSTimeInterval taskTimeout;
+
+/*!
+ @abstract Schedules the specified requests and returns immediately.
+ @discussion The progress handler is invoked each time a request finishes, and the completion handler once all of them have. Both are invoked
+     serially on a private queue.
+ 
+ @param requests The requests to schedule. May not be nil.
+ @param progressHandler The block to invoke with each request as it finishes, the number of the batch's requests that have finished, and the 
+     total number of requests in the batch. May be nil.
+ @param completionHandler The block to invoke with the requests once all of them have finished. May be nil.
+ */
+- (void)scheduleRequests:(NSArray *)requests 
+         progressHandler:(void (^)(PGBulkAttachRequest *request, NSUInteger completedCount, NSUInteger totalCount))progressHandler
+       completionHandler:(void (^)(NSArray *requests))completionHandler;
+
+/*!
+ @abstract Schedules the specified requests and waits for all of them to finish.
+ 
+ @param requests The requests to schedule. May not be nil.
+ @param progressHandler The block to invoke with each request as it finishes, the number of requests that have finished, and the total number
+     of requests. It is invoked serially on a private queue. May be nil.
+ 
+ @return Whether every request succeeded. The error of each request that failed is set.
+ */
+- (BOOL)performRequests:(NSArray *)requests 
+        progressHandler:(void (^)(PGBulkAttachRequest *request, NSUInteger completedCount, NSUInteger totalCount))progressHandler;
+
+@end
@@ -0,0 +1,392 @@
+//
+//  PGBulkAttachScheduler.m
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGBulkAttachScheduler.h"
+
+#import "PGEncryptedDiskImageWrapper.h"
+
+
+#pragma mark Constants
+
+/*! @abstract The default maximum number of hdiutil tasks a scheduler runs at once. */
+static const NSUInteger PGBulkAttachSchedulerDefaultMaximumAttachCount = 4;
+
+
+#pragma mark - Batches
+
+/*!
+ @abstract PGBulkAttachBatch instances track the progress of a group of requests that were scheduled together.
+ @discussion Batches are only accessed on their scheduler's queue. Their handlers are invoked on the batch's own handler queue.
+ */
+@interface PGBulkAttachBatch : NSObject
+
+/*! @abstract The batch's requests. */
+@property(readonly, strong) NSArray *requests;
+
+/*! @abstract The number of the batch's requests that have finished. */
+@property(readwrite) NSUInteger completedCount;
+
+/*! @abstract The block to invoke as each request finishes. */
+@property(readonly, copy) void (^progressHandler)(PGBulkAttachRequest *, NSUInteger, NSUInteger);
+
+/*! @abstract The block to invoke once every request has finished. */
+@property(readonly, copy) void (^completionHandler)(NSArray *);
+
+/*! @abstract The serial queue on which the batch's handlers are invoked. */
+@property(readonly) dispatch_queue_t handlerQueue;
+
+/*!
+ @abstract Initializes a newly allocated batch.
+ 
+ @param requests The batch's requests. May not be nil.
+ @param progressHandler The block to invoke as each request finishes. May be nil.
+ @param completionHandler The block to invoke once every request has finished. May be nil.
+ 
+ @return An initialized batch.
+ */
+- (id)initWithRequests:(NSArray *)requests progressHandler:(void (^)(PGBulkAttachRequest *, NSUInteger, NSUInteger))progressHandler
+     completionHandler:(void (^)(NSArray *))completionHandler;
+
+@end
+
+
+@implementation PGBulkAttachBatch
+
+- (id)initWithRequests:(NSArray *)requests progressHandler:(void (^)(PGBulkAttachRequest *, NSUInteger, NSUInteger))progressHandler
+     completionHandler:(void (^)(NSArray *))completionHandler
+{
+    NSAssert(requests, @"nil requests");
+    
+    if (!(self = [super init])) return nil;
+    
+    _requests = [requests copy];
+    _progressHandler = [progressHandler copy];
+    _completionHandler = [completionHandler copy];
+    _handlerQueue = dispatch_queue_create("com.quantumlenscap.PGBulkAttachBatch", DISPATCH_QUEUE_SERIAL);
+    
+    return self;
+}
+
+
+- (void)dealloc
+{
+    dispatch_release(_handlerQueue);
+}
+
+@end
+
+
+#pragma mark - Requests
+
+@interface PGBulkAttachRequest ()
+
+@property(readwrite, strong) PGEncryptedDiskImageWrapper *wrapper;
+@property(readwrite, strong) NSError *error;
+
+/*! @abstract Whether the request has been scheduled. */
+@property(readwrite, getter=isScheduled) BOOL scheduled;
+
+/*! @abstract The batch the request was scheduled with, or nil if it isn't pending. This is cleared once the request finishes, since the batch
+    retains its requests. */
+@property(readwrite, strong) PGBulkAttachBatch *batch;
+
+/*! @abstract The order in which the request was scheduled, which breaks ties between requests with equal priorities. */
+@property(readwrite) NSUInteger sequenceNumber;
+
+@end
+
+
+@implementation PGBulkAttachRequest
+
+@synthesize wrapperPath = _wrapperPath;
+@synthesize user = _user;
+@synthesize password = _password;
+@synthesize mountRoot = _mountRoot;
+@synthesize priority = _priority;
+@synthesize wrapper = _wrapper;
+@synthesize error = _error;
+@synthesize scheduled = _scheduled;
+@synthesize batch = _batch;
+@synthesize sequenceNumber = _sequenceNumber;
+
+- (id)init
+{
+    // There’s no meaningful default values for our designated initializer, so we just don't recognize the -init message.
+    [self doesNotRecognizeSelector:_cmd];
+    return nil;
+}
+
+
+- (id)initWithWrapperPath:(NSString *)wrapperPath user:(NSString *)user password:(NSString *)password mountRoot:(NSString *)mountRoot
+{
+    NSAssert(wrapperPath, @"nil wrapper path");
+    NSAssert(user, @"nil user");
+    NSAssert(password, @"nil password");
+    
+    if (!(self = [super init])) return nil;
+    
+    _wrapperPath = [wrapperPath copy];
+    _user = [user copy];
+    _password = [password copy];
+    _mountRoot = [mountRoot copy];
+    
+    return self;
+}
+
+@end
+
+
+#pragma mark - Private Methods Interface
+
+@interface PGBulkAttachScheduler ()
+
+/*!
+ @abstract Inserts the specified request into the specified pending array, keeping it ordered by decreasing priority and then sequence number.
+ @discussion Must be invoked on the scheduler's queue.
+ 
+ @param request The request to insert. May not be nil.
+ @param pendingRequests The array into which to insert the request. May not be nil.
+ */
+- (void)enqueueRequest:(PGBulkAttachRequest *)request inPendingRequests:(NSMutableArray *)pendingRequests;
+
+/*!
+ @abstract Starts as many pending requests in each stage as the scheduler's limits allow.
+ @discussion Must be invoked on the scheduler's queue.
+ */
+- (void)startPendingRequests;
+
+/*!
+ @abstract Starts opening the specified request's wrapper.
+ @discussion Must be invoked on the scheduler's queue.
+ @param request The request whose wrapper should be opened. May not be nil.
+ */
+- (void)openWrapperForRequest:(PGBulkAttachRequest *)request;
+
+/*!
+ @abstract Starts attaching the specified request's wrapper.
+ @discussion Must be invoked on the scheduler's queue.
+ @param request The request whose wrapper should be attached. Its wrapper must be open. May not be nil.
+ */
+- (void)attachWrapperForRequest:(PGBulkAttachRequest *)request;
+
+/*!
+ @abstract Finishes the specified request, reporting its batch's progress.
+ @discussion Must be invoked on the scheduler's queue.
+ 
+ @param request The request to finish. May not be nil.
+ @param error The error that caused the request to fail, or nil if it succeeded.
+ */
+- (void)finishRequest:(PGBulkAttachRequest *)request error:(NSError *)error;
+
+@end
+
+
+#pragma mark - Implementation
+
+@implementation PGBulkAttachScheduler {
+    // All state below is only accessed on _queue
+    dispatch_queue_t _queue;
+    NSMutableArray *_pendingOpenRequests;
+    NSMutableArray *_pendingAttachRequests;
+    NSUInteger _openCount;
+    NSUInteger _attachCount;
+    NSUInteger _nextSequenceNumber;
+}
+
+@synthesize maximumOpenCount = _maximumOpenCount;
+@synthesize maximumAttachCount = _maximumAttachCount;
+@synthesize taskTimeout = _taskTimeout;
+
+- (id)init
+{
+    if (!(self = [super init])) return nil;
+    
+    _maximumOpenCount = [[NSProcessInfo processInfo] activeProcessorCount];
+    _maximumAttachCount = PGBulkAttachSchedulerDefaultMaximumAttachCount;
+    _queue = dispatch_queue_create("com.quantumlenscap.PGBulkAttachScheduler", DISPATCH_QUEUE_SERIAL);
+    _pendingOpenRequests = [[NSMutableArray alloc] init];
+    _pendingAttachRequests = [[NSMutableArray alloc] init];
+    
+    return self;
+}
+
+
+- (void)dealloc
+{
+    dispatch_release(_queue);
+}
+
+
+#pragma mark Scheduling
+
+- (void)scheduleRequests:(NSArray *)requests 
+         progressHandler:(void (^)(PGBulkAttachRequest *, NSUInteger, NSUInteger))progressHandler
+       completionHandler:(void (^)(NSArray *))completionHandler
+{
+    NSAssert(requests, @"nil requests");
+    
+    PGBulkAttachBatch *batch = [[PGBulkAttachBatch alloc] initWithRequests:requests progressHandler:progressHandler 
+                                                         completionHandler:completionHandler];
+    
+    dispatch_async(_queue, ^{
+        if ([requests count] == 0) {
+            if ([batch completionHandler]) dispatch_async([batch handlerQueue], ^{ [batch completionHandler](requests); });
+            return;
+        }
+        
+        for (PGBulkAttachRequest *request in requests) {
+            NSAssert(![request isScheduled], @"Request scheduled more than once");
+            [request setScheduled:YES];
+            [request setBatch:batch];
+            [request setSequenceNumber:_nextSequenceNumber++];
+            [self enqueueRequest:request inPendingRequests:_pendingOpenRequests];
+        }
+        
+        [self startPendingRequests];
+    });
+}
+
+
+- (BOOL)performRequests:(NSArray *)requests 
+        progressHandler:(void (^)(PGBulkAttachRequest *, NSUInteger, NSUInteger))progressHandler
+{
+    dispatch_semaphore_t finishedSemaphore = dispatch_semaphore_create(0);
+    [self scheduleRequests:requests progressHandler:progressHandler completionHandler:^(NSArray *finishedRequests) {
+        dispatch_semaphore_signal(finishedSemaphore);
+    }];
+    
+    dispatch_semaphore_wait(finishedSemaphore, DISPATCH_TIME_FOREVER);
+    dispatch_release(finishedSemaphore);
+    
+    for (PGBulkAttachRequest *request in requests) {
+        if ([request error]) return NO;
+    }
+    
+    return YES;
+}
+
+
+#pragma mark Private Methods
+
+- (void)enqueueRequest:(PGBulkAttachRequest *)request inPendingRequests:(NSMutableArray *)pendingRequests
+{
+    NSUInteger index = [pendingRequests indexOfObject:request inSortedRange:NSMakeRange(0, [pendingRequests count]) 
+                                              options:NSBinarySearchingInsertionIndex | NSBinarySearchingLastEqual
+                                      usingComparator:^NSComparisonResult(PGBulkAttachRequest *request1, PGBulkAttachRequest *request2) {
+                                          if ([request1 priority] != [request2 priority]) {
+                                              return [request1 priority] > [request2 priority] ? NSOrderedAscending : NSOrderedDescending;
+                                          }
+                                          
+                                          if ([request1 sequenceNumber] == [request2 sequenceNumber]) return NSOrderedSame;
+                                          return [request1 sequenceNumber] < [request2 sequenceNumber] ? NSOrderedAscending : NSOrderedDescending;
+                                      }];
+    
+    [pendingRequests insertObject:request atIndex:index];
+}
+
+
+- (void)startPendingRequests
+{
+    while (_openCount < MAX(_maximumOpenCount, 1U) && [_pendingOpenRequests count] > 0) {
+        PGBulkAttachRequest *request = [_pendingOpenRequests objectAtIndex:0];
+        [_pendingOpenRequests removeObjectAtIndex:0];
+        [self openWrapperForRequest:request];
+    }
+    
+    while (_attachCount < MAX(_maximumAttachCount, 1U) && [_pendingAttachRequests count] > 0) {
+        PGBulkAttachRequest *request = [_pendingAttachRequests objectAtIndex:0];
+        [_pendingAttachRequests removeObjectAtIndex:0];
+        [self attachWrapperForRequest:request];
+    }
+}
+
+
+- (void)openWrapperForRequest:(PGBulkAttachRequest *)request
+{
+    ++_openCount;
+    
+    // Opening blocks for the duration of key derivation, so it happens off of our queue
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        NSError *error = nil;
+        PGEncryptedDiskImageWrapper *wrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:[request wrapperPath] 
+                                                                                                      user:[request user]
+                                                                                                  password:[request password]
+                                                                                                     error:&error];
+        dispatch_async(_queue, ^{
+            --_openCount;
+            [request setWrapper:wrapper];
+            
+            if (!wrapper || ![request mountRoot]) {
+                [self finishRequest:request error:wrapper ? nil : error];
+            } else {
+                [self enqueueRequest:request inPendingRequests:_pendingAttachRequests];
+            }
+            
+            [self startPendingRequests];
+        });
+    });
+}
+
+
+- (void)attachWrapperForRequest:(PGBulkAttachRequest *)request
+{
+    ++_attachCount;
+    
+    [[request wrapper] attachAtRandomSubdirectoryOfPath:[request mountRoot] timeout:_taskTimeout 
+                                      completionHandler:^(NSString *mountPoint, NSError *error) {
+                                          dispatch_async(_queue, ^{
+                                              --_attachCount;
+                                              [self finishRequest:request error:mountPoint ? nil : error];
+                                              [self startPendingRequests];
+                                          });
+                                      }];
+}
+
+
+- (void)finishRequest:(PGBulkAttachRequest *)request error:(NSError *)error
+{
+    PGBulkAttachBatch *batch = [request batch];
+    NSUInteger completedCount = [batch completedCount] + 1;
+    NSUInteger totalCount = [[batch requests] count];
+    
+    [request setError:error];
+    [request setBatch:nil];
+    [batch setCompletedCount:completedCount];
+    
+    if ([batch progressHandler]) {
+        dispatch_async([batch handlerQueue], ^{
+            [batch progressHandler](request, completedCount, totalCount);
+        });
+    }
+    
+    if (completedCount == totalCount && [batch completionHandler]) {
+        dispatch_async([batch handlerQueue], ^{
+            [batch completionHandler]([batch requests]);
+        });
+    }
+}
+
+@end
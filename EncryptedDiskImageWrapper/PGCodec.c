@@ -0,0 +1,433 @@
+//
+//  PGCodec.c
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include "PGCodec.h"
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define PG_CODEC_NEON 1
+#endif
+
+
+#pragma mark Constants and Functions
+
+/*! @abstract The characters used for hexadecimal encoding, indexed by nibble. */
+static const char PGCodecHexDigits[16] = "0123456789abcdef";
+
+/*! @abstract The characters used for base64 encoding, indexed by sextet. */
+static const char PGCodecBase64Alphabet[64] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*! @abstract The value of each ASCII character in base64, or 0xFF if the character isn't in the base64 alphabet. */
+static const uint8_t PGCodecBase64Values[128] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,   62, 0xFF, 0xFF, 0xFF,   63,
+      52,   53,   54,   55,   56,   57,   58,   59,   60,   61, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF,    0,    1,    2,    3,    4,    5,    6,    7,    8,    9,   10,   11,   12,   13,   14,
+      15,   16,   17,   18,   19,   20,   21,   22,   23,   24,   25, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF,   26,   27,   28,   29,   30,   31,   32,   33,   34,   35,   36,   37,   38,   39,   40,
+      41,   42,   43,   44,   45,   46,   47,   48,   49,   50,   51, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+
+/*!
+ @abstract Returns the value of the specified hexadecimal digit.
+ @param character The digit.
+ @return The digit's value, or -1 if the character isn't a hexadecimal digit.
+ */
+static inline int PGCodecHexDigitValue(uint8_t character)
+{
+    if ((uint8_t)(character - '0') < 10) return character - '0';
+    
+    // Setting the 0x20 bit lowercases letters without turning any other character into one
+    character |= 0x20;
+    if ((uint8_t)(character - 'a') < 6) return character - 'a' + 10;
+    return -1;
+}
+
+
+/*!
+ @abstract Returns the base64 value of the specified character.
+ @param character The character.
+ @return The character's value, or 0xFF if the character isn't in the base64 alphabet.
+ */
+static inline uint8_t PGCodecBase64Value(uint8_t character)
+{
+    return character < 128 ? PGCodecBase64Values[character] : 0xFF;
+}
+
+
+#pragma mark - Hexadecimal
+
+size_t PGCodecHexEncodedLength(size_t byteCount)
+{
+    return 2 * byteCount;
+}
+
+
+void PGCodecHexEncode(const uint8_t *bytes, size_t byteCount, char *characters)
+{
+    size_t i = 0;
+    
+#if defined(__AVX2__)
+    const __m256i digits256 = _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+                                               '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m256i nibbleMask256 = _mm256_set1_epi8(0x0F);
+    for (; i + 32 <= byteCount; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i *)(bytes + i));
+        __m256i high = _mm256_shuffle_epi8(digits256, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibbleMask256));
+        __m256i low = _mm256_shuffle_epi8(digits256, _mm256_and_si256(input, nibbleMask256));
+        
+        // Unpacking interleaves within each 128-bit lane, so the lanes have to be put back in order
+        __m256i interleavedLow = _mm256_unpacklo_epi8(high, low);
+        __m256i interleavedHigh = _mm256_unpackhi_epi8(high, low);
+        _mm256_storeu_si256((__m256i *)(characters + 2 * i), _mm256_permute2x128_si256(interleavedLow, interleavedHigh, 0x20));
+        _mm256_storeu_si256((__m256i *)(characters + 2 * i + 32), _mm256_permute2x128_si256(interleavedLow, interleavedHigh, 0x31));
+    }
+#endif
+    
+#if defined(__SSSE3__)
+    const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+    for (; i + 16 <= byteCount; i += 16) {
+        __m128i input = _mm_loadu_si128((const __m128i *)(bytes + i));
+        __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(input, 4), nibbleMask));
+        __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(input, nibbleMask));
+        _mm_storeu_si128((__m128i *)(characters + 2 * i), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128((__m128i *)(characters + 2 * i + 16), _mm_unpackhi_epi8(high, low));
+    }
+#elif defined(PG_CODEC_NEON)
+    const uint8x16_t digits = vld1q_u8((const uint8_t *)PGCodecHexDigits);
+    for (; i + 16 <= byteCount; i += 16) {
+        uint8x16_t input = vld1q_u8(bytes + i);
+        uint8x16x2_t output;
+        output.val[0] = vqtbl1q_u8(digits, vshrq_n_u8(input, 4));
+        output.val[1] = vqtbl1q_u8(digits, vandq_u8(input, vdupq_n_u8(0x0F)));
+        vst2q_u8((uint8_t *)characters + 2 * i, output);
+    }
+#endif
+    
+    for (; i < byteCount; ++i) {
+        characters[2 * i] = PGCodecHexDigits[bytes[i] >> 4];
+        characters[2 * i + 1] = PGCodecHexDigits[bytes[i] & 0x0F];
+    }
+}
+
+
+bool PGCodecHexDecode(const char *characters, size_t characterCount, uint8_t *bytes)
+{
+    if (characterCount % 2) return false;
+    
+    const uint8_t *input = (const uint8_t *)characters;
+    size_t i = 0;
+    
+#if defined(__AVX2__)
+    const __m256i zero256 = _mm256_set1_epi8('0');
+    const __m256i lowercaseA256 = _mm256_set1_epi8('a');
+    const __m256i lowercaseBit256 = _mm256_set1_epi8(0x20);
+    const __m256i nine256 = _mm256_set1_epi8(9);
+    const __m256i five256 = _mm256_set1_epi8(5);
+    const __m256i ten256 = _mm256_set1_epi8(10);
+    const __m256i nibbleWeights256 = _mm256_set1_epi16(0x0110);
+    for (; i + 64 <= characterCount; i += 64) {
+        __m256i values[2];
+        for (int half = 0; half < 2; ++half) {
+            __m256i chunk = _mm256_loadu_si256((const __m256i *)(input + i + 32 * half));
+            
+            // Unsigned x <= n exactly when min(x, n) == x
+            __m256i digit = _mm256_sub_epi8(chunk, zero256);
+            __m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, nine256), digit);
+            __m256i letter = _mm256_sub_epi8(_mm256_or_si256(chunk, lowercaseBit256), lowercaseA256);
+            __m256i isLetter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, five256), letter);
+            if ((uint32_t)_mm256_movemask_epi8(_mm256_or_si256(isDigit, isLetter)) != 0xFFFFFFFF) return false;
+            
+            __m256i nibbles = _mm256_or_si256(_mm256_and_si256(isDigit, digit), _mm256_and_si256(isLetter, _mm256_add_epi8(letter, ten256)));
+            values[half] = _mm256_maddubs_epi16(nibbles, nibbleWeights256);
+        }
+        
+        // Packing works within each 128-bit lane, so the 64-bit quarters have to be put back in order
+        __m256i packed = _mm256_packus_epi16(values[0], values[1]);
+        _mm256_storeu_si256((__m256i *)(bytes + i / 2), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+#endif
+    
+#if defined(__SSSE3__)
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i lowercaseA = _mm_set1_epi8('a');
+    const __m128i lowercaseBit = _mm_set1_epi8(0x20);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i five = _mm_set1_epi8(5);
+    const __m128i ten = _mm_set1_epi8(10);
+    const __m128i nibbleWeights = _mm_set1_epi16(0x0110);
+    for (; i + 32 <= characterCount; i += 32) {
+        __m128i values[2];
+        for (int half = 0; half < 2; ++half) {
+            __m128i chunk = _mm_loadu_si128((const __m128i *)(input + i + 16 * half));
+            
+            // Unsigned x <= n exactly when min(x, n) == x
+            __m128i digit = _mm_sub_epi8(chunk, zero);
+            __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, nine), digit);
+            __m128i letter = _mm_sub_epi8(_mm_or_si128(chunk, lowercaseBit), lowercaseA);
+            __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(letter, five), letter);
+            if (_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) != 0xFFFF) return false;
+            
+            // Multiplying the high nibbles by 16 and adding the low nibbles combines each pair of nibbles into a 16-bit byte value
+            __m128i nibbles = _mm_or_si128(_mm_and_si128(isDigit, digit), _mm_and_si128(isLetter, _mm_add_epi8(letter, ten)));
+            values[half] = _mm_maddubs_epi16(nibbles, nibbleWeights);
+        }
+        
+        _mm_storeu_si128((__m128i *)(bytes + i / 2), _mm_packus_epi16(values[0], values[1]));
+    }
+#elif defined(PG_CODEC_NEON)
+    for (; i + 32 <= characterCount; i += 32) {
+        // Loading deinterleaves the high and low nibble characters of each byte
+        uint8x16x2_t chunk = vld2q_u8(input + i);
+        uint8x16_t nibbles[2];
+        for (int half = 0; half < 2; ++half) {
+            uint8x16_t digit = vsubq_u8(chunk.val[half], vdupq_n_u8('0'));
+            uint8x16_t isDigit = vcltq_u8(digit, vdupq_n_u8(10));
+            uint8x16_t letter = vsubq_u8(vorrq_u8(chunk.val[half], vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+            uint8x16_t isLetter = vcltq_u8(letter, vdupq_n_u8(6));
+            if (vminvq_u8(vorrq_u8(isDigit, isLetter)) != 0xFF) return false;
+            nibbles[half] = vbslq_u8(isDigit, digit, vaddq_u8(letter, vdupq_n_u8(10)));
+        }
+        
+        vst1q_u8(bytes + i / 2, vorrq_u8(vshlq_n_u8(nibbles[0], 4), nibbles[1]));
+    }
+#endif
+    
+    for (; i < characterCount; i += 2) {
+        int high = PGCodecHexDigitValue(input[i]);
+        int low = PGCodecHexDigitValue(input[i + 1]);
+        if (high < 0 || low < 0) return false;
+        bytes[i / 2] = (uint8_t)(high << 4 | low);
+    }
+    
+    return true;
+}
+
+
+#pragma mark - Base64
+
+size_t PGCodecBase64EncodedLength(size_t byteCount)
+{
+    return (byteCount + 2) / 3 * 4;
+}
+
+
+void PGCodecBase64Encode(const uint8_t *bytes, size_t byteCount, char *characters)
+{
+    size_t i = 0;
+    size_t j = 0;
+    
+#if defined(__SSSE3__)
+    // Each iteration encodes 12 bytes, but loads 16, so it stops while there are at least 4 bytes to spare
+    const __m128i spread = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    for (; i + 16 <= byteCount; i += 12, j += 16) {
+        __m128i input = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(bytes + i)), spread);
+        
+        // Move each sextet into its own byte. Multiplying shifts the sextets in each 16-bit half into place.
+        __m128i outer = _mm_mulhi_epu16(_mm_and_si128(input, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+        __m128i inner = _mm_mullo_epi16(_mm_and_si128(input, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+        __m128i sextets = _mm_or_si128(outer, inner);
+        
+        // Map each sextet to the offset that turns it into its character: 0-25 to 'A', 26-51 to 'a', 52-61 to '0', 62 to '+', and 63 to '/'
+        __m128i ranges = _mm_subs_epu8(sextets, _mm_set1_epi8(51));
+        ranges = _mm_or_si128(ranges, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), sextets), _mm_set1_epi8(13)));
+        const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, 
+                                              '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+        _mm_storeu_si128((__m128i *)(characters + j), _mm_add_epi8(_mm_shuffle_epi8(offsets, ranges), sextets));
+    }
+#elif defined(PG_CODEC_NEON)
+    const uint8x16x4_t alphabet = vld1q_u8_x4((const uint8_t *)PGCodecBase64Alphabet);
+    for (; i + 48 <= byteCount; i += 48, j += 64) {
+        // Loading deinterleaves the first, second, and third bytes of each group of three
+        uint8x16x3_t input = vld3q_u8(bytes + i);
+        uint8x16x4_t output;
+        output.val[0] = vshrq_n_u8(input.val[0], 2);
+        output.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(input.val[0], 4), vshrq_n_u8(input.val[1], 4)), vdupq_n_u8(0x3F));
+        output.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(input.val[1], 2), vshrq_n_u8(input.val[2], 6)), vdupq_n_u8(0x3F));
+        output.val[3] = vandq_u8(input.val[2], vdupq_n_u8(0x3F));
+        for (int k = 0; k < 4; ++k) {
+            output.val[k] = vqtbl4q_u8(alphabet, output.val[k]);
+        }
+        
+        vst4q_u8((uint8_t *)characters + j, output);
+    }
+#endif
+    
+    for (; i + 3 <= byteCount; i += 3, j += 4) {
+        uint32_t triple = (uint32_t)bytes[i] << 16 | (uint32_t)bytes[i + 1] << 8 | bytes[i + 2];
+        characters[j] = PGCodecBase64Alphabet[triple >> 18];
+        characters[j + 1] = PGCodecBase64Alphabet[(triple >> 12) & 0x3F];
+        characters[j + 2] = PGCodecBase64Alphabet[(triple >> 6) & 0x3F];
+        characters[j + 3] = PGCodecBase64Alphabet[triple & 0x3F];
+    }
+    
+    if (i < byteCount) {
+        uint32_t triple = (uint32_t)bytes[i] << 16 | (i + 1 < byteCount ? (uint32_t)bytes[i + 1] << 8 : 0);
+        characters[j] = PGCodecBase64Alphabet[triple >> 18];
+        characters[j + 1] = PGCodecBase64Alphabet[(triple >> 12) & 0x3F];
+        characters[j + 2] = i + 1 < byteCount ? PGCodecBase64Alphabet[(triple >> 6) & 0x3F] : '=';
+        characters[j + 3] = '=';
+    }
+}
+
+
+size_t PGCodecBase64DecodedLength(const char *characters, size_t characterCount)
+{
+    if (characterCount % 4) return SIZE_MAX;
+    if (characterCount == 0) return 0;
+    
+    size_t padding = characters[characterCount - 1] == '=' ? (characters[characterCount - 2] == '=' ? 2 : 1) : 0;
+    return characterCount / 4 * 3 - padding;
+}
+
+
+bool PGCodecBase64Decode(const char *characters, size_t characterCount, uint8_t *bytes)
+{
+    if (characterCount % 4) return false;
+    if (characterCount == 0) return true;
+    
+    const uint8_t *input = (const uint8_t *)characters;
+    size_t i = 0;
+    size_t j = 0;
+    
+    // The vector loops leave at least the last four characters for the scalar loop, which handles padding
+#if defined(__SSSE3__)
+    const __m128i lowNibbleMask = _mm_set1_epi8(0x2F);
+    const __m128i lowNibbleClasses = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i highNibbleClasses = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i offsets = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    for (; i + 16 + 4 <= characterCount; i += 16, j += 12) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(input + i));
+        
+        // A character is valid when the classes of its high and low nibbles don't share a bit
+        __m128i highNibbles = _mm_and_si128(_mm_srli_epi32(chunk, 4), lowNibbleMask);
+        __m128i lowNibbles = _mm_and_si128(chunk, lowNibbleMask);
+        __m128i classes = _mm_and_si128(_mm_shuffle_epi8(lowNibbleClasses, lowNibbles), _mm_shuffle_epi8(highNibbleClasses, highNibbles));
+        if (_mm_movemask_epi8(_mm_cmpgt_epi8(classes, _mm_setzero_si128()))) return false;
+        
+        // Every character but '/' can be mapped to its value by an offset that depends only on its high nibble
+        __m128i isSlash = _mm_cmpeq_epi8(chunk, lowNibbleMask);
+        __m128i sextets = _mm_add_epi8(chunk, _mm_shuffle_epi8(offsets, _mm_add_epi8(isSlash, highNibbles)));
+        
+        // Combine pairs of sextets into 12-bit values and pairs of those into 24-bit values, then gather the 3 bytes of each
+        __m128i pairs = _mm_maddubs_epi16(sextets, _mm_set1_epi32(0x01400140));
+        __m128i triples = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        uint8_t output[16];
+        _mm_storeu_si128((__m128i *)output, _mm_shuffle_epi8(triples, pack));
+        memcpy(bytes + j, output, 12);
+    }
+#elif defined(PG_CODEC_NEON)
+    const uint8x16x4_t lowValues = vld1q_u8_x4(PGCodecBase64Values);
+    const uint8x16x4_t highValues = vld1q_u8_x4(PGCodecBase64Values + 64);
+    for (; i + 64 + 4 <= characterCount; i += 64, j += 48) {
+        // Loading deinterleaves the four characters of each group. Table lookups yield 0 for out-of-range indexes, so characters past 
+        // the table have to be marked invalid explicitly.
+        uint8x16x4_t chunk = vld4q_u8(input + i);
+        uint8x16_t invalid = vdupq_n_u8(0);
+        for (int k = 0; k < 4; ++k) {
+            uint8x16_t character = chunk.val[k];
+            uint8x16_t value = vorrq_u8(vqtbl4q_u8(lowValues, character), vqtbl4q_u8(highValues, vsubq_u8(character, vdupq_n_u8(64))));
+            invalid = vorrq_u8(invalid, vorrq_u8(vcgeq_u8(character, vdupq_n_u8(128)), vcgtq_u8(value, vdupq_n_u8(63))));
+            chunk.val[k] = value;
+        }
+        
+        if (vmaxvq_u8(invalid)) return false;
+        
+        uint8x16x3_t output;
+        output.val[0] = vorrq_u8(vshlq_n_u8(chunk.val[0], 2), vshrq_n_u8(chunk.val[1], 4));
+        output.val[1] = vorrq_u8(vshlq_n_u8(chunk.val[1], 4), vshrq_n_u8(chunk.val[2], 2));
+        output.val[2] = vorrq_u8(vshlq_n_u8(chunk.val[2], 6), chunk.val[3]);
+        vst3q_u8(bytes + j, output);
+    }
+#endif
+    
+    for (; i < characterCount; i += 4) {
+        uint8_t values[4];
+        size_t valueCount = 4;
+        
+        // Only the last group may be padded, and only in its last two characters
+        if (i + 4 == characterCount && input[i + 3] == '=') valueCount = input[i + 2] == '=' ? 2 : 3;
+        for (size_t k = 0; k < valueCount; ++k) {
+            values[k] = PGCodecBase64Value(input[i + k]);
+            if (values[k] == 0xFF) return false;
+        }
+        
+        uint32_t triple = (uint32_t)values[0] << 18 | (uint32_t)values[1] << 12;
+        if (valueCount > 2) triple |= (uint32_t)values[2] << 6;
+        if (valueCount > 3) triple |= values[3];
+        
+        bytes[j++] = triple >> 16;
+        if (valueCount > 2) bytes[j++] = (triple >> 8) & 0xFF;
+        if (valueCount > 3) bytes[j++] = triple & 0xFF;
+    }
+    
+    return true;
+}
+
+
+#pragma mark - Grouping
+
+size_t PGCodecInterposedLength(size_t count, size_t groupLength, size_t separatorCount)
+{
+    if (count == 0) return 0;
+    return count + (count - 1) / groupLength * separatorCount;
+}
+
+
+void PGCodecInterpose(const void *elements, size_t count, size_t elementSize, size_t groupLength, const void *separator, 
+                      size_t separatorCount, void *output)
+{
+    const uint8_t *input = elements;
+    uint8_t *outputBytes = output;
+    size_t groupSize = groupLength * elementSize;
+    size_t separatorSize = separatorCount * elementSize;
+    size_t remainingSize = count * elementSize;
+    
+    // Copy whole groups, each followed by a separator, then whatever's left, so every byte is written exactly once
+    while (remainingSize > groupSize) {
+        memcpy(outputBytes, input, groupSize);
+        memcpy(outputBytes + groupSize, separator, separatorSize);
+        input += groupSize;
+        outputBytes += groupSize + separatorSize;
+        remainingSize -= groupSize;
+    }
+    
+    memcpy(outputBytes, input, remainingSize);
+}
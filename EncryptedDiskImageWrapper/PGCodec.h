@@ -0,0 +1,119 @@
+//
+//  PGCodec.h
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ PGCodec encodes and decodes hexadecimal and base64 text and groups strings with separators. Every function writes straight into a buffer that the
+ caller has allocated using the corresponding length function, so nothing is allocated and each input is read exactly once. Hexadecimal and base64
+ conversion process 16 or 32 bytes at a time with SSSE3 or AVX2 on Intel and NEON on ARM when the compiler targets them, and fall back to a scalar
+ implementation elsewhere and for leftover bytes. Text is ASCII and is neither NUL-terminated nor expected to be.
+ */
+
+/*!
+ @abstract Returns the number of characters needed to hexadecimal-encode the specified number of bytes.
+ @param byteCount The number of bytes.
+ @return The number of characters, which is twice the number of bytes.
+ */
+extern size_t PGCodecHexEncodedLength(size_t byteCount);
+
+/*!
+ @abstract Encodes the specified bytes as lowercase hexadecimal characters.
+ @param bytes The bytes to encode. May only be NULL if byteCount is 0.
+ @param byteCount The number of bytes to encode.
+ @param characters The buffer into which to write the characters. Must have room for PGCodecHexEncodedLength(byteCount) characters.
+ */
+extern void PGCodecHexEncode(const uint8_t *bytes, size_t byteCount, char *characters);
+
+/*!
+ @abstract Decodes the specified hexadecimal characters, which may be uppercase or lowercase.
+ @param characters The characters to decode. May only be NULL if characterCount is 0.
+ @param characterCount The number of characters to decode. Must be even.
+ @param bytes The buffer into which to write the decoded bytes. Must have room for characterCount / 2 bytes.
+ @return Whether every character was a hexadecimal digit. If not, the contents of bytes are undefined.
+ */
+extern bool PGCodecHexDecode(const char *characters, size_t characterCount, uint8_t *bytes);
+
+/*!
+ @abstract Returns the number of characters needed to base64-encode the specified number of bytes, including padding.
+ @param byteCount The number of bytes.
+ @return The number of characters.
+ */
+extern size_t PGCodecBase64EncodedLength(size_t byteCount);
+
+/*!
+ @abstract Encodes the specified bytes as padded base64 using the standard alphabet from RFC 4648.
+ @param bytes The bytes to encode. May only be NULL if byteCount is 0.
+ @param byteCount The number of bytes to encode.
+ @param characters The buffer into which to write the characters. Must have room for PGCodecBase64EncodedLength(byteCount) characters.
+ */
+extern void PGCodecBase64Encode(const uint8_t *bytes, size_t byteCount, char *characters);
+
+/*!
+ @abstract Returns the number of bytes that the specified padded base64 characters decode to.
+ @discussion Only the length and padding of the characters are examined, so the characters may still fail to decode.
+ @param characters The characters. May only be NULL if characterCount is 0.
+ @param characterCount The number of characters.
+ @return The number of bytes, or SIZE_MAX if characterCount is not a multiple of 4.
+ */
+extern size_t PGCodecBase64DecodedLength(const char *characters, size_t characterCount);
+
+/*!
+ @abstract Decodes the specified padded base64 characters, which must use the standard alphabet from RFC 4648 and contain no whitespace.
+ @param characters The characters to decode. May only be NULL if characterCount is 0.
+ @param characterCount The number of characters to decode. Must be a multiple of 4.
+ @param bytes The buffer into which to write the decoded bytes. Must have room for PGCodecBase64DecodedLength(characters, characterCount) bytes.
+ @return Whether the characters were valid base64. If not, the contents of bytes are undefined.
+ */
+extern bool PGCodecBase64Decode(const char *characters, size_t characterCount, uint8_t *bytes);
+
+/*!
+ @abstract Returns the number of elements in the result of interposing a separator between groups of the specified length.
+ @param count The number of elements being grouped.
+ @param groupLength The number of elements in each group. Must be positive.
+ @param separatorCount The number of elements in the separator.
+ @return The number of elements in the grouped result.
+ */
+extern size_t PGCodecInterposedLength(size_t count, size_t groupLength, size_t separatorCount);
+
+/*!
+ @abstract Copies the specified elements, interposing a separator between each adjacent group of the specified length.
+ @discussion Elements may be of any size, e.g., 1 for ASCII or UTF-8 text and 2 for UTF-16 text. If count isn't a multiple of groupLength, the last 
+     group is shorter than the others.
+ 
+ @param elements The elements to group. May only be NULL if count is 0.
+ @param count The number of elements to group.
+ @param elementSize The size in bytes of each element.
+ @param groupLength The number of elements in each group. Must be positive.
+ @param separator The separator elements. May only be NULL if separatorCount is 0.
+ @param separatorCount The number of elements in the separator.
+ @param output The buffer into which to write the grouped elements. Must not overlap elements and must have room for 
+     PGCodecInterposedLength(count, groupLength, separatorCount) elements.
+ */
+extern void PGCodecInterpose(const void *elements, size_t count, size_t elementSize, size_t groupLength, const void *separator, 
+                             size_t separatorCount, void *output);
@@ -0,0 +1,219 @@
+//
+//  PGCommonCryptoProvider.c
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include "PGCryptoProvider.h"
+
+#if PGCRYPTO_COMMONCRYPTO
+
+#include <stdint.h>
+#include <string.h>
+
+#include <CommonCrypto/CommonCryptor.h>
+#include <CommonCrypto/CommonDigest.h>
+#include <CommonCrypto/CommonHMAC.h>
+#include <CommonCrypto/CommonKeyDerivation.h>
+#include <Security/SecRandom.h>
+
+
+#pragma mark Random Bytes
+
+static PGCryptoStatus PGCommonCryptoRandomBytes(void *buffer, size_t length)
+{
+    return SecRandomCopyBytes(kSecRandomDefault, length, buffer) == 0 ? PGCryptoSuccess : PGCryptoMemoryError;
+}
+
+
+#pragma mark Digests and HMAC
+
+/*
+ The one-shot CommonCrypto digest functions take a 32-bit length, so inputs of 4 GB or more would be silently truncated. Those inputs are fed 
+ to the incremental functions in pieces instead.
+ */
+#define PGCommonCryptoDigestInPieces(function, contextType) do { \
+    if (length <= UINT32_MAX) { \
+        function(data, (CC_LONG)length, digest); \
+    } else { \
+        contextType context; \
+        function##_Init(&context); \
+        for (size_t offset = 0; offset < length; offset += UINT32_MAX) { \
+            size_t pieceLength = length - offset < UINT32_MAX ? length - offset : UINT32_MAX; \
+            function##_Update(&context, (const uint8_t *)data + offset, (CC_LONG)pieceLength); \
+        } \
+        function##_Final(digest, &context); \
+    } \
+} while (0)
+
+
+static PGCryptoStatus PGCommonCryptoDigest(PGCryptoDigestAlgorithm algorithm, const void *data, size_t length, void *digest)
+{
+    switch (algorithm) {
+        case PGCryptoDigestMD5:
+            PGCommonCryptoDigestInPieces(CC_MD5, CC_MD5_CTX);
+            return PGCryptoSuccess;
+        case PGCryptoDigestSHA1:
+            PGCommonCryptoDigestInPieces(CC_SHA1, CC_SHA1_CTX);
+            return PGCryptoSuccess;
+        case PGCryptoDigestSHA224:
+            PGCommonCryptoDigestInPieces(CC_SHA224, CC_SHA256_CTX);
+            return PGCryptoSuccess;
+        case PGCryptoDigestSHA256:
+            PGCommonCryptoDigestInPieces(CC_SHA256, CC_SHA256_CTX);
+            return PGCryptoSuccess;
+        case PGCryptoDigestSHA384:
+            PGCommonCryptoDigestInPieces(CC_SHA384, CC_SHA512_CTX);
+            return PGCryptoSuccess;
+        case PGCryptoDigestSHA512:
+            PGCommonCryptoDigestInPieces(CC_SHA512, CC_SHA512_CTX);
+            return PGCryptoSuccess;
+    }
+    
+    return PGCryptoParameterError;
+}
+
+
+static PGCryptoStatus PGCommonCryptoHMACSHA256(const void *key, size_t keyLength, const void *data, size_t length, void *mac)
+{
+    CCHmac(kCCHmacAlgSHA256, key, keyLength, data, length, mac);
+    return PGCryptoSuccess;
+}
+
+
+#pragma mark Key Derivation
+
+static PGCryptoStatus PGCommonCryptoDeriveKey(const void *password, size_t passwordLength, const void *salt, size_t saltLength, uint32_t rounds,
+                                              void *key, size_t keyLength)
+{
+    return CCKeyDerivationPBKDF(kCCPBKDF2, password, passwordLength, salt, saltLength, kCCPRFHmacAlgSHA256, rounds, key, keyLength) == kCCSuccess ?
+        PGCryptoSuccess : PGCryptoParameterError;
+}
+
+
+static uint32_t PGCommonCryptoCalibrateRounds(size_t passwordLength, size_t saltLength, size_t keyLength, uint32_t milliseconds)
+{
+    return CCCalibratePBKDF(kCCPBKDF2, passwordLength, saltLength, kCCPRFHmacAlgSHA256, keyLength, milliseconds);
+}
+
+
+#pragma mark Ciphers
+
+static PGCryptoStatus PGCommonCryptoCipherCreate(PGCryptoOperation operation, PGCryptoMode mode, bool padding, const void *key, size_t keyLength,
+                                                 const void *initializationVector, PGCryptoCipherRef *cipherOut)
+{
+    CCOptions options = (padding ? kCCOptionPKCS7Padding : 0) | (mode == PGCryptoModeECB ? kCCOptionECBMode : 0);
+    CCCryptorRef cryptor = NULL;
+    CCCryptorStatus result = CCCryptorCreate(operation == PGCryptoEncrypt ? kCCEncrypt : kCCDecrypt, kCCAlgorithmAES128, options, key, keyLength, 
+                                             initializationVector, &cryptor);
+    if (result != kCCSuccess) return result;
+    
+    *cipherOut = cryptor;
+    return PGCryptoSuccess;
+}
+
+
+static PGCryptoStatus PGCommonCryptoCipherReset(PGCryptoCipherRef cipher, const void *initializationVector)
+{
+    return CCCryptorReset(cipher, initializationVector);
+}
+
+
+static size_t PGCommonCryptoCipherOutputLength(PGCryptoCipherRef cipher, size_t inputLength, bool final)
+{
+    return CCCryptorGetOutputLength(cipher, inputLength, final);
+}
+
+
+static PGCryptoStatus PGCommonCryptoCipherUpdate(PGCryptoCipherRef cipher, const void *input, size_t inputLength, void *output, 
+                                                 size_t outputCapacity, size_t *outputLengthOut)
+{
+    return CCCryptorUpdate(cipher, input, inputLength, output, outputCapacity, outputLengthOut);
+}
+
+
+static PGCryptoStatus PGCommonCryptoCipherFinal(PGCryptoCipherRef cipher, void *output, size_t outputCapacity, size_t *outputLengthOut)
+{
+    return CCCryptorFinal(cipher, output, outputCapacity, outputLengthOut);
+}
+
+
+static void PGCommonCryptoCipherRelease(PGCryptoCipherRef cipher)
+{
+    CCCryptorRelease(cipher);
+}
+
+
+#pragma mark Authenticated Encryption
+
+/*
+ The SDK has no public AES-GCM interface. CCCryptorGCM() is private SPI whose behavior has changed between releases, so rather than depend on it,
+ this provider doesn't support GCM, and callers fall back to CBC unless the OpenSSL provider is used.
+ */
+static PGCryptoStatus PGCommonCryptoGCMSeal(const void *key, size_t keyLength, const void *nonce, const void *associatedData, 
+                                            size_t associatedDataLength, const void *input, size_t length, void *output, void *tag)
+{
+    return PGCryptoUnimplementedError;
+}
+
+
+static PGCryptoStatus PGCommonCryptoGCMOpen(const void *key, size_t keyLength, const void *nonce, const void *associatedData, 
+                                            size_t associatedDataLength, const void *input, size_t length, const void *tag, void *output)
+{
+    return PGCryptoUnimplementedError;
+}
+
+
+#pragma mark - Provider
+
+static const PGCryptoProvider PGCommonCryptoProvider = {
+    "CommonCrypto",
+    PGCommonCryptoRandomBytes,
+    PGCommonCryptoDigest,
+    PGCommonCryptoHMACSHA256,
+    PGCommonCryptoDeriveKey,
+    PGCommonCryptoCalibrateRounds,
+    PGCommonCryptoCipherCreate,
+    PGCommonCryptoCipherReset,
+    PGCommonCryptoCipherOutputLength,
+    PGCommonCryptoCipherUpdate,
+    PGCommonCryptoCipherFinal,
+    PGCommonCryptoCipherRelease,
+    PGCommonCryptoGCMSeal,
+    PGCommonCryptoGCMOpen
+};
+
+
+const PGCryptoProvider *PGCryptoCommonCryptoProvider(void)
+{
+    return &PGCommonCryptoProvider;
+}
+
+#else
+
+const PGCryptoProvider *PGCryptoCommonCryptoProvider(void)
+{
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,94 @@
+//
+//  PGCryptoProvider.c
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include "PGCryptoProvider.h"
+
+#include <pthread.h>
+
+
+/*! @abstract The provider set with PGCryptoSetDefaultProvider(), or NULL if none has been. */
+static const PGCryptoProvider *volatile PGCryptoSelectedProvider = NULL;
+
+
+const PGCryptoProvider *PGCryptoDefaultProvider(void)
+{
+    const PGCryptoProvider *provider = PGCryptoSelectedProvider;
+    if (provider) return provider;
+    
+    provider = PGCryptoCommonCryptoProvider();
+    return provider ? provider : PGCryptoOpenSSLProvider();
+}
+
+
+void PGCryptoSetDefaultProvider(const PGCryptoProvider *provider)
+{
+    PGCryptoSelectedProvider = provider;
+}
+
+
+/*! @abstract The providers compiled into this build, filled in once by PGCryptoFillAvailableProviders(). */
+static const PGCryptoProvider *PGCryptoProviders[2];
+static size_t PGCryptoProviderCount = 0;
+static pthread_once_t PGCryptoProvidersOnce = PTHREAD_ONCE_INIT;
+
+
+static void PGCryptoFillAvailableProviders(void)
+{
+    size_t count = 0;
+    if (PGCryptoCommonCryptoProvider()) PGCryptoProviders[count++] = PGCryptoCommonCryptoProvider();
+    if (PGCryptoOpenSSLProvider()) PGCryptoProviders[count++] = PGCryptoOpenSSLProvider();
+    PGCryptoProviderCount = count;
+}
+
+
+const PGCryptoProvider *const *PGCryptoAvailableProviders(size_t *countOut)
+{
+    // pthread_once makes the array's contents visible to every thread that sees its count
+    pthread_once(&PGCryptoProvidersOnce, PGCryptoFillAvailableProviders);
+    *countOut = PGCryptoProviderCount;
+    return PGCryptoProviders;
+}
+
+
+size_t PGCryptoDigestLength(PGCryptoDigestAlgorithm algorithm)
+{
+    switch (algorithm) {
+        case PGCryptoDigestMD5:
+            return 16;
+        case PGCryptoDigestSHA1:
+            return 20;
+        case PGCryptoDigestSHA224:
+            return 28;
+        case PGCryptoDigestSHA256:
+            return 32;
+        case PGCryptoDigestSHA384:
+            return 48;
+        case PGCryptoDigestSHA512:
+            return 64;
+    }
+    
+    return 0;
+}
@@ -0,0 +1,223 @@
+//
+//  PGCryptoProvider.h
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ PGCryptoProvider puts the cryptographic primitives that the rest of the library uses behind a table of functions, so that they can be supplied
+ by different libraries. There are two providers: one built on CommonCrypto and the Security framework, which is only available on Apple
+ platforms, and one built on OpenSSL's libcrypto, whose EVP layer uses the processor's AES and SHA instructions when they're available. Both
+ implement exactly the same algorithms, so data encrypted with one can be decrypted with the other.
+ 
+ Which providers are compiled in is controlled by PGCRYPTO_COMMONCRYPTO and PGCRYPTO_OPENSSL. By default, CommonCrypto is used on Apple platforms
+ and OpenSSL everywhere else. Defining PGCRYPTO_OPENSSL to 1 on an Apple platform builds both, which requires linking against libcrypto.
+ */
+
+#ifndef PGCRYPTO_COMMONCRYPTO
+#if defined(__APPLE__)
+#define PGCRYPTO_COMMONCRYPTO 1
+#else
+#define PGCRYPTO_COMMONCRYPTO 0
+#endif
+#endif
+
+#ifndef PGCRYPTO_OPENSSL
+#if defined(__APPLE__)
+#define PGCRYPTO_OPENSSL 0
+#else
+#define PGCRYPTO_OPENSSL 1
+#endif
+#endif
+
+
+#pragma mark Types and Constants
+
+/*!
+ @abstract The status codes returned by provider functions.
+ @discussion The values are the same as CommonCrypto's CCCryptorStatus values, so errors have the same codes regardless of the provider.
+ */
+typedef int32_t PGCryptoStatus;
+
+enum {
+    PGCryptoSuccess = 0,
+    PGCryptoParameterError = -4300,
+    PGCryptoBufferTooSmallError = -4301,
+    PGCryptoMemoryError = -4302,
+    PGCryptoAlignmentError = -4303,
+    PGCryptoDecodeError = -4304,
+    PGCryptoUnimplementedError = -4305
+};
+
+/*! @abstract The digest algorithms that providers support. */
+typedef enum {
+    PGCryptoDigestMD5 = 1,
+    PGCryptoDigestSHA1,
+    PGCryptoDigestSHA224,
+    PGCryptoDigestSHA256,
+    PGCryptoDigestSHA384,
+    PGCryptoDigestSHA512
+} PGCryptoDigestAlgorithm;
+
+/*! @abstract The operations that a cipher can perform. */
+typedef enum {
+    PGCryptoEncrypt = 0,
+    PGCryptoDecrypt
+} PGCryptoOperation;
+
+/*! @abstract The AES block cipher modes that providers support. */
+typedef enum {
+    PGCryptoModeCBC = 1,
+    PGCryptoModeECB
+} PGCryptoMode;
+
+enum {
+    /*! @abstract The AES block size in bytes. */
+    PGCryptoAESBlockSize = 16,
+    
+    /*! @abstract The length of an HMAC-SHA256 in bytes. */
+    PGCryptoHMACSHA256Length = 32,
+    
+    /*! @abstract The length of an AES-GCM nonce in bytes. */
+    PGCryptoAESGCMNonceLength = 12,
+    
+    /*! @abstract The length of an AES-GCM authentication tag in bytes. */
+    PGCryptoAESGCMTagLength = 16
+};
+
+/*! @abstract An opaque reference to a provider's cipher. A cipher may only be used with the provider that created it. */
+typedef void *PGCryptoCipherRef;
+
+/*!
+ @abstract A table of cryptographic primitives.
+ @discussion All functions are thread-safe, though an individual cipher may only be used by one thread at a time.
+ */
+typedef struct PGCryptoProvider {
+    /*! @abstract The provider's name, e.g., "CommonCrypto". */
+    const char *name;
+    
+    /*! @abstract Fills buffer with length cryptographically secure random bytes. */
+    PGCryptoStatus (*randomBytes)(void *buffer, size_t length);
+    
+    /*! @abstract Writes the digest of data to digest, which must have room for PGCryptoDigestLength(algorithm) bytes. */
+    PGCryptoStatus (*digest)(PGCryptoDigestAlgorithm algorithm, const void *data, size_t length, void *digest);
+    
+    /*! @abstract Writes the HMAC-SHA256 of data with key to mac, which must have room for PGCryptoHMACSHA256Length bytes. */
+    PGCryptoStatus (*HMACSHA256)(const void *key, size_t keyLength, const void *data, size_t length, void *mac);
+    
+    /*! @abstract Derives keyLength bytes of key from password and salt using PBKDF2 with HMAC-SHA256 and the specified number of rounds. */
+    PGCryptoStatus (*deriveKey)(const void *password, size_t passwordLength, const void *salt, size_t saltLength, uint32_t rounds, 
+                                void *key, size_t keyLength);
+    
+    /*! @abstract Returns the number of rounds for which deriveKey takes about the specified number of milliseconds on this machine. */
+    uint32_t (*calibrateRounds)(size_t passwordLength, size_t saltLength, size_t keyLength, uint32_t milliseconds);
+    
+    /*!
+     @abstract Creates an AES cipher whose key size is determined by keyLength, which must be 16, 24, or 32.
+     @discussion If padding is true, PKCS #7 padding is added when encrypting and removed when decrypting. Otherwise, the total input length
+         must be a multiple of the block size. The initialization vector is ignored in ECB mode and may be NULL, which is equivalent to zeros.
+     */
+    PGCryptoStatus (*cipherCreate)(PGCryptoOperation operation, PGCryptoMode mode, bool padding, const void *key, size_t keyLength, 
+                                   const void *initializationVector, PGCryptoCipherRef *cipherOut);
+    
+    /*! @abstract Discards any buffered input and restarts the cipher with the specified initialization vector, keeping its key. */
+    PGCryptoStatus (*cipherReset)(PGCryptoCipherRef cipher, const void *initializationVector);
+    
+    /*! @abstract Returns the maximum output of the next update with inputLength bytes, plus that of finishing afterward if final is true. */
+    size_t (*cipherOutputLength)(PGCryptoCipherRef cipher, size_t inputLength, bool final);
+    
+    /*! @abstract Processes input, writing up to outputCapacity bytes to output and the number written to outputLengthOut. */
+    PGCryptoStatus (*cipherUpdate)(PGCryptoCipherRef cipher, const void *input, size_t inputLength, void *output, size_t outputCapacity, 
+                                   size_t *outputLengthOut);
+    
+    /*! @abstract Finishes processing, writing any remaining output and the number of bytes written to outputLengthOut. */
+    PGCryptoStatus (*cipherFinal)(PGCryptoCipherRef cipher, void *output, size_t outputCapacity, size_t *outputLengthOut);
+    
+    /*! @abstract Releases the cipher. */
+    void (*cipherRelease)(PGCryptoCipherRef cipher);
+    
+    /*!
+     @abstract Encrypts input with AES-GCM, whose key size is determined by keyLength, and authenticates it along with the associated data.
+     @discussion Writes length bytes of ciphertext to output and PGCryptoAESGCMTagLength bytes of tag to tag. The nonce is 
+         PGCryptoAESGCMNonceLength bytes long and must never be used twice with the same key. The associated data may be NULL if its length is 0.
+     */
+    PGCryptoStatus (*GCMSeal)(const void *key, size_t keyLength, const void *nonce, const void *associatedData, size_t associatedDataLength, 
+                              const void *input, size_t length, void *output, void *tag);
+    
+    /*!
+     @abstract Decrypts input that was encrypted with GCMSeal, writing length bytes of plaintext to output.
+     @discussion Returns PGCryptoDecodeError if the tag doesn't match, i.e., if the key, nonce, associated data, ciphertext, or tag differ from 
+         those that were sealed, in which case output is zeroed.
+     */
+    PGCryptoStatus (*GCMOpen)(const void *key, size_t keyLength, const void *nonce, const void *associatedData, size_t associatedDataLength, 
+                              const void *input, size_t length, const void *tag, void *output);
+} PGCryptoProvider;
+
+
+#pragma mark - Providers
+
+/*!
+ @abstract Returns the provider built on CommonCrypto and the Security framework.
+ @return The provider, or NULL if it wasn't compiled in.
+ */
+extern const PGCryptoProvider *PGCryptoCommonCryptoProvider(void);
+
+/*!
+ @abstract Returns the provider built on OpenSSL's libcrypto.
+ @return The provider, or NULL if it wasn't compiled in.
+ */
+extern const PGCryptoProvider *PGCryptoOpenSSLProvider(void);
+
+/*!
+ @abstract Returns the provider that the library uses.
+ @discussion Unless another provider has been set with PGCryptoSetDefaultProvider(), this is the CommonCrypto provider if it was compiled in and
+     the OpenSSL provider otherwise.
+ @return The default provider.
+ */
+extern const PGCryptoProvider *PGCryptoDefaultProvider(void);
+
+/*!
+ @abstract Sets the provider that the library uses.
+ @discussion Data that was encrypted with one provider can be decrypted with any other, so this can be changed at any time. Operations that are
+     in progress, e.g., stream cryptors and open band stores, keep using the provider with which they were started.
+ @param provider The provider to use, or NULL to restore the default.
+ */
+extern void PGCryptoSetDefaultProvider(const PGCryptoProvider *provider);
+
+/*!
+ @abstract Returns the providers that were compiled in.
+ @param countOut On return, the number of providers. May not be NULL.
+ @return An array of the providers, which should not be freed.
+ */
+extern const PGCryptoProvider *const *PGCryptoAvailableProviders(size_t *countOut);
+
+/*!
+ @abstract Returns the length of digests computed with the specified algorithm.
+ @param algorithm The digest algorithm.
+ @return The digest length in bytes.
+ */
+extern size_t PGCryptoDigestLength(PGCryptoDigestAlgorithm algorithm);
@@ -26,32 +26,79 @@
 
 #import <Foundation/Foundation.h>
 
+#import "NSData+Crypto.h"
+#import "PGManifest.h"
+
 extern NSString *const PGEncryptionTypeVolumeOption;
 extern NSString *const PGGIDVolumeOption;
 extern NSString *const PGModeVolumeOption;
 extern NSString *const PGNameVolumeOption;
 extern NSString *const PGSizeVolumeOption;
 extern NSString *const PGUIDVolumeOption;
+extern NSString *const PGBackendVolumeOption;
+
+extern NSString *const PGDiskImageBackend;
+extern NSString *const PGBandStoreBackend;
+
+@class PGArchiveCatalog;
+@class PGBandStore;
+@class PGHDIUtilTask;
+@class PGTemplatePool;
 
 
 @interface PGEncryptedDiskImageWrapper : NSObject 
 
 @property(readonly, strong) NSString *wrapperPath;
 @property(readonly, strong) NSString *mountPoint;
+@property(readonly, copy) NSString *user;
 
 + (PGEncryptedDiskImageWrapper *)createEncryptedDiskImageWrapperAtPath:(NSString *)path masterPassword:(NSString *)masterPassword
                                                                   user:(NSString *)user password:(NSString *)password 
                                                          volumeOptions:(NSDictionary *)volumeOptions error:(NSError **)error;
++ (PGEncryptedDiskImageWrapper *)createEncryptedDiskImageWrapperAtPath:(NSString *)path masterPassword:(NSString *)masterPassword
+                                                                  user:(NSString *)user password:(NSString *)password 
+                                                         volumeOptions:(NSDictionary *)volumeOptions templatePool:(PGTemplatePool *)templatePool 
+                                                                 error:(NSError **)error;
++ (PGHDIUtilTask *)createEncryptedDiskImageWrapperAtPath:(NSString *)path masterPassword:(NSString *)masterPassword
+                                                    user:(NSString *)user password:(NSString *)password 
+                                           volumeOptions:(NSDictionary *)volumeOptions timeout:(NSTimeInterval)timeout
+                                       completionHandler:(void (^)(PGEncryptedDiskImageWrapper *wrapper, NSError *error))handler;
++ (PGHDIUtilTask *)createWrapperTemplateAtPath:(NSString *)path masterPassword:(NSString *)masterPassword 
+                                 volumeOptions:(NSDictionary *)volumeOptions timeout:(NSTimeInterval)timeout
+                             completionHandler:(void (^)(BOOL created, NSError *error))handler;
 
 - (id)initWithContentsOfFile:(NSString *)path user:(NSString *)user password:(NSString *)password error:(NSError **)error;
+- (id)initWithContentsOfFile:(NSString *)path sessionToken:(NSString *)sessionToken error:(NSError **)error;
 
 - (BOOL)attachAtPath:(NSString *)mountPoint error:(NSError **)error;
 - (NSString *)attachAtRandomSubdirectoryOfPath:(NSString *)mountRoot error:(NSError **)error;
 - (BOOL)detach:(NSError **)error;
+- (PGHDIUtilTask *)attachAtPath:(NSString *)mountPoint timeout:(NSTimeInterval)timeout completionHandler:(void (^)(BOOL attached, NSError *error))handler;
+- (PGHDIUtilTask *)attachAtRandomSubdirectoryOfPath:(NSString *)mountRoot timeout:(NSTimeInterval)timeout 
+                                  completionHandler:(void (^)(NSString *mountPoint, NSError *error))handler;
+- (PGHDIUtilTask *)detachWithTimeout:(NSTimeInterval)timeout completionHandler:(void (^)(BOOL detached, NSError *error))handler;
 - (BOOL)isAttached;
 
+- (PGBandStore *)openBandStore:(NSError **)error;
+
+- (BOOL)updateManifest:(NSError **)error;
+- (BOOL)verifyManifestWithOptions:(PGManifestOptions)options error:(NSError **)error;
+
+- (PGArchiveCatalog *)exportToFileDescriptor:(int)fileDescriptor baseCatalog:(PGArchiveCatalog *)baseCatalog error:(NSError **)error;
++ (PGArchiveCatalog *)importWrapperFromFileDescriptor:(int)fileDescriptor toPath:(NSString *)path error:(NSError **)error;
+
 - (void)setPassword:(NSString *)password forUser:(NSString *)user;
 - (void)removeUser:(NSString *)user;
 - (BOOL)saveUserTable;
+- (BOOL)setPassword:(NSString *)password forUser:(NSString *)user error:(NSError **)error;
+- (BOOL)removeUser:(NSString *)user error:(NSError **)error;
+- (BOOL)saveUserTable:(NSError **)error;
+- (BOOL)setPasswords:(NSDictionary *)passwordsByUser removeUsers:(NSArray *)usersToRemove 
+     progressHandler:(void (^)(NSUInteger completedCount, NSUInteger totalCount))progressHandler error:(NSError **)error;
++ (void)setKeyDerivationAlgorithm:(PGKeyDerivationAlgorithm)algorithm lanes:(NSUInteger)lanes;
+
+- (NSString *)issueSessionTokenWithTimeToLive:(NSTimeInterval)timeToLive error:(NSError **)error;
+- (BOOL)revokeSessionToken:(NSString *)sessionToken error:(NSError **)error;
+- (BOOL)revokeAllSessionTokensForUser:(NSString *)user error:(NSError **)error;
 
 @end
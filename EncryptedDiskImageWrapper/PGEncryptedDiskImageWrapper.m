@@ -26,59 +26,200 @@
 
 #import "PGEncryptedDiskImageWrapper.h"
 
+#import <fcntl.h>
+#import <sys/file.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
 #import "NSData+Crypto.h"
 #import "NSError+ConvenienceInitializers.h"
 #import "NSFileManager+TemporaryFiles.h"
 
 #import "PGAppUtilities.h"
+#import "PGArchive.h"
+#import "PGBandStore.h"
 #import "PGErrors.h"
+#import "PGHDIUtilTask.h"
+#import "PGInstrumentation.h"
+#import "PGManifest.h"
+#import "PGTemplatePool.h"
+#import "PGUserTable.h"
+#import "PGUserTableCache.h"
 
 
 #pragma mark Types and Constants
 
-/*! 
- @abstract Constants for indicating what verb hdiutil should perfom. 
- @discussion These constants are only used with the +executeHDIUtilTaskWithVerb:arguments:password:result:error: method.
- */
-typedef NS_ENUM(NSUInteger, PGHDIUtilVerb) {
-    /*! @abstract The create verb, which instructs hdiutil to creates a disk image. */
-    PGHDIUtilCreateVerb = 1,
-    
-    /*! @abstract The attach verb, which instructs hdiutil to attach a disk image and mount its volumes. */
-    PGHDIUtilAttachVerb,
-    
-    /*! @abstract The detach verb, which instructs hdiutil to unmount a disk image's volumes and detach it. */
-    PGHDIUtilDetachVerb
-};
-
-
 NSString *const PGEncryptionTypeVolumeOption = @"EncryptionType";
 NSString *const PGGIDVolumeOption = @"GID";
 NSString *const PGModeVolumeOption = @"Mode";
 NSString *const PGUIDVolumeOption = @"UID";
 NSString *const PGNameVolumeOption = @"VolumeName";
 NSString *const PGSizeVolumeOption = @"VolumeSize";
+NSString *const PGBackendVolumeOption = @"Backend";
+
+NSString *const PGDiskImageBackend = @"DiskImage";
+NSString *const PGBandStoreBackend = @"BandStore";
 
-/*! @abstract The user table entry key whose value corresponds to the entry's user. */
-static NSString *const PGUserUserTableEntryKey = @"User";
+/*! @abstract The session table entry key whose value corresponds to the entry's user. */
+static NSString *const PGUserSessionTableEntryKey = @"User";
 
-/*! @abstract The user table entry key whose value corresponds to the entry's salt. */
-static NSString *const PGSaltUserTableEntryKey = @"Salt";
+/*! @abstract The session table entry key whose value corresponds to the entry's expiration time, in whole seconds since 1970. */
+static NSString *const PGExpirationSessionTableEntryKey = @"Expiration";
 
-/*! @abstract The user table entry key whose value corresponds to the entry's rounds value. */
-static NSString *const PGRoundsUserTableEntryKey = @"Rounds";
+/*! @abstract The session table entry key whose value corresponds to the entry's HMAC verifier. */
+static NSString *const PGVerifierSessionTableEntryKey = @"Verifier";
 
-/*! @abstract The user table entry key whose value corresponds to the entry's initialization vector. */
-static NSString *const PGInitializationVectorUserTableEntryKey = @"IV";
+/*! @abstract The session table entry key whose value corresponds to the entry's initialization vector. */
+static NSString *const PGInitializationVectorSessionTableEntryKey = @"IV";
 
-/*! @abstract The user table entry key whose value corresponds to the entry's secret. */
-static NSString *const PGSecretUserTableEntryKey = @"Secret";
+/*! @abstract The session table entry key whose value corresponds to the entry's secret. */
+static NSString *const PGSecretSessionTableEntryKey = @"Secret";
+
+/*!
+ @abstract The session table entry key whose value corresponds to the PGEncryptionAlgorithm with which the entry's secret was encrypted.
+ @discussion Sessions issued by earlier versions don't have one, and their secrets were encrypted with PGAES256CBCEncryptionAlgorithm.
+ */
+static NSString *const PGAlgorithmSessionTableEntryKey = @"Algorithm";
+
+/*!
+ @abstract Returns the algorithm with which new user table and session secrets are encrypted.
+ @discussion GCM authenticates the secret along with the name of its user or session, so a wrong password or a secret that was moved to another
+     entry is always detected. Where the crypto provider can't do GCM, secrets are encrypted with CBC as before.
+ @return The algorithm with which to encrypt new secrets.
+ */
+static PGEncryptionAlgorithm PGSecretEncryptionAlgorithm(void)
+{
+    return [NSData isEncryptionAlgorithmAvailable:PGAES256GCMEncryptionAlgorithm] ? PGAES256GCMEncryptionAlgorithm : PGAES256CBCEncryptionAlgorithm;
+}
+
+/*!
+ @abstract The key derivation algorithm with which new user table entries are created.
+ @discussion PBKDF2 unless set with +setKeyDerivationAlgorithm:lanes:. Accessed while synchronized on the PGEncryptedDiskImageWrapper class.
+ */
+static PGKeyDerivationAlgorithm PGUserTableKeyDerivationAlgorithm = PGPBKDF2KeyDerivationAlgorithm;
+
+/*! @abstract The number of lanes with which new user table entries' keys are derived, or 0 for NSData (Crypto)'s default. */
+static NSUInteger PGUserTableKeyDerivationLanes = 0;
+
+/*! @abstract The number of random bytes in a session token's identifier. */
+static const NSUInteger PGSessionTokenIdentifierLength = 16;
+
+/*! @abstract The string that separates a session token's identifier from its key. */
+static NSString *const PGSessionTokenSeparator = @"-";
 
 /*! @abstract The name of the encrypted disk image file inside the encrypted disk image wrapper's bundle. */
 static NSString *const PGEncryptedDiskImageFilename = @"EncryptedDiskImage.sparsebundle";
 
+/*! @abstract The name of the band store inside the wrapper's bundle. Wrappers using the band store backend have it instead of a disk image. */
+static NSString *const PGBandStoreFilename = @"EncryptedBandStore.bands";
+
 /*! @abstract The name of the user table file inside the encrypted disk image wrapper's bundle. */
-static NSString *const PGUserTableFilename = @"UserTable.plist";
+static NSString *const PGUserTableFilename = @"UserTable.db";
+
+/*! @abstract The name of the property list user table file used by earlier versions, which is migrated to PGUserTableFilename when first changed. */
+static NSString *const PGLegacyUserTableFilename = @"UserTable.plist";
+
+/*! @abstract The name of the session table file inside the encrypted disk image wrapper's bundle. */
+static NSString *const PGSessionTableFilename = @"SessionTable.plist";
+
+/*! @abstract The name of the integrity manifest file inside the encrypted disk image wrapper's bundle. */
+static NSString *const PGManifestFilename = @"Manifest.plist";
+
+
+/*!
+ @abstract Opens the session table file at the specified path and acquires an exclusive advisory lock on it.
+ @discussion The file is created empty if it doesn't exist. Because writers replace the session table atomically while holding the lock on the 
+     old file, this function checks that the file it locked is still the one at the path and retries if it isn't. The lock is released when the
+     returned file descriptor is closed.
+ 
+ @param path The path of the session table file. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return A locked file descriptor, or -1 if an error occurred.
+ */
+static int PGOpenLockedSessionTable(NSString *path, NSError **errorOut)
+{
+    const char *fileSystemPath = [path fileSystemRepresentation];
+    
+    while (YES) {
+        int fileDescriptor = open(fileSystemPath, O_RDONLY | O_CREAT, S_IRUSR | S_IWUSR);
+        if (fileDescriptor == -1 || flock(fileDescriptor, LOCK_EX) == -1) {
+            if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            if (fileDescriptor != -1) close(fileDescriptor);
+            return -1;
+        }
+        
+        struct stat fileStatus, pathStatus;
+        if (fstat(fileDescriptor, &fileStatus) == 0 && stat(fileSystemPath, &pathStatus) == 0 && 
+            fileStatus.st_dev == pathStatus.st_dev && fileStatus.st_ino == pathStatus.st_ino) {
+            return fileDescriptor;
+        }
+        
+        // The session table we locked was replaced while we waited for the lock, so try again with the new one
+        close(fileDescriptor);
+    }
+}
+
+
+/*! @abstract The maximum number of parsed session tables kept by PGCachedSessionTable(). */
+static const NSUInteger PGSessionTableCacheCapacity = 64;
+
+/*! @abstract The identity and version of a session table file. Zeroed, padding included, before it's filled in, so it can be compared bytewise. */
+typedef struct {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec modificationTime;
+} PGSessionTableSignature;
+
+
+/*!
+ @abstract Returns the session table at the specified path, parsing it only if it has changed since it was last parsed.
+ @discussion Parsed tables are cached by path along with the signature of the file they were read from, which is taken just before the file is 
+     read. Each call stats the file, and only parses it again if its signature differs, so validating a session token doesn't take time 
+     proportional to the number of sessions. Session tables are always replaced rather than modified, so a changed table has a new signature.
+ 
+ @param path The path of the session table file. May not be nil.
+ 
+ @return The session table, including any expired entries, keyed by session identifier. If there is no session table, returns an empty
+     dictionary. The table is immutable and may be shared between threads.
+ */
+static NSDictionary *PGCachedSessionTable(NSString *path)
+{
+    static NSMutableDictionary *cache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [[NSMutableDictionary alloc] init];
+    });
+    
+    PGSessionTableSignature signature;
+    memset(&signature, 0, sizeof(signature));
+    
+    struct stat fileStatus;
+    if (stat([path fileSystemRepresentation], &fileStatus) == -1) return [NSDictionary dictionary];
+    signature.device = fileStatus.st_dev;
+    signature.inode = fileStatus.st_ino;
+    signature.size = fileStatus.st_size;
+    signature.modificationTime = fileStatus.st_mtimespec;
+    NSData *signatureData = [NSData dataWithBytes:&signature length:sizeof(signature)];
+    
+    // Each cached value is an array containing the signature and the table
+    @synchronized (cache) {
+        NSArray *cachedValue = [cache objectForKey:path];
+        if ([[cachedValue objectAtIndex:0] isEqualToData:signatureData]) return [cachedValue objectAtIndex:1];
+    }
+    
+    NSDictionary *sessionTable = [NSDictionary dictionaryWithContentsOfFile:path];
+    if (!sessionTable) sessionTable = [NSDictionary dictionary];
+    
+    @synchronized (cache) {
+        if ([cache count] >= PGSessionTableCacheCapacity) [cache removeAllObjects];
+        [cache setObject:[NSArray arrayWithObjects:signatureData, sessionTable, nil] forKey:path];
+    }
+    
+    return sessionTable;
+}
 
 
 #pragma mark - Private Methods Interface 
@@ -86,25 +227,128 @@ static NSString *const PGUserTableFilename = @"UserTable.plist";
 @interface PGEncryptedDiskImageWrapper ()
 
 /*!
- @abstract Executes hdiutil with the specified verb and arguments. 
- @discussion The arguments specified should not contain the verb string, i.e., "create", "attach", or "detach", as these will automatically be added to the 
-     argument list based on the verb specified. In addition, for the PGHDIUtilCreateVerb and PGHDIUtilAttachVerb verbs, "-plist" and "-stdinpass" will 
-     automatically be added to the argument list. As one might expect, in these cases the specified password is passed to hdiutil via its standard input
-     pipe, and hdiutil's output as a property list can be retrieved indirectly using the resultOut parameter. If the verb is PGHDIUtilDetachVerb, the
-     password and result parameters are ignored.
- 
- @param verb The verb that hdiutil should perform.
- @param arguments The arguments to be passed to hdiutil, excluding the verb, "-stdinpass", and "-plist". May not be nil.
- @param password The password to pass to hdiutil. May only be nil if the verb is PGHDIUtilDetachVerb.
- @param resultOut On input, a pointer to an NSDictionary object. Upon successful completion, points the hdiutil's output as a dictionary object. You 
-     may specify NULL for this parameter if you do not want the result dictionary.
+ @abstract Creates a temporary wrapper directory containing a user table for the specified user.
+ @discussion This is shared by the synchronous and asynchronous wrapper creation methods, which then create the wrapper's storage in the directory.
+ 
+ @param masterPassword The master password for the encrypted disk image. May not be nil.
+ @param user The user's name. May not be nil.
+ @param password The user's password. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The path of the temporary wrapper directory, or nil if it could not be created.
+ */
++ (NSString *)createTemporaryWrapperWithMasterPassword:(NSString *)masterPassword user:(NSString *)user password:(NSString *)password 
+                                                 error:(NSError **)errorOut;
+
+/*!
+ @abstract Writes a user table containing only the specified user to the wrapper directory at the specified path.
+ 
+ @param path The path of the wrapper directory. May not be nil.
+ @param masterPassword The master password for the encrypted disk image. May not be nil.
+ @param user The user's name. May not be nil.
+ @param password The user's password. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the user table was written.
+ */
++ (BOOL)writeUserTableInWrapperAtPath:(NSString *)path masterPassword:(NSString *)masterPassword user:(NSString *)user password:(NSString *)password 
+                                error:(NSError **)errorOut;
+
+/*!
+ @abstract Returns an hdiutil task that will create the encrypted disk image in the specified temporary wrapper.
+ 
+ @param temporaryWrapperPath The path of the temporary wrapper directory. May not be nil.
+ @param masterPassword The master password for the encrypted disk image. May not be nil.
+ @param volumeOptions The volume options dictionary. May not be nil.
+ 
+ @return An hdiutil task that creates the encrypted disk image. The task has not been launched.
+ */
++ (PGHDIUtilTask *)diskImageCreationTaskForTemporaryWrapperAtPath:(NSString *)temporaryWrapperPath masterPassword:(NSString *)masterPassword
+                                                    volumeOptions:(NSDictionary *)volumeOptions;
+
+/*!
+ @abstract Creates a band store in the specified temporary wrapper.
+ @discussion The band store's length is the volume size in the volume options. No space is allocated for it. Other volume options are ignored.
+ 
+ @param temporaryWrapperPath The path of the temporary wrapper directory. May not be nil.
+ @param masterPassword The master password, with which the band store's volume key is encrypted. May not be nil.
+ @param volumeOptions The volume options dictionary. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the band store was created.
+ */
++ (BOOL)createBandStoreInTemporaryWrapperAtPath:(NSString *)temporaryWrapperPath masterPassword:(NSString *)masterPassword
+                                  volumeOptions:(NSDictionary *)volumeOptions error:(NSError **)errorOut;
+
+/*!
+ @abstract Changes the master password with which the storage in the specified temporary wrapper was created.
+ @discussion A disk image's password is changed with hdiutil chpass. A band store's volume key is encrypted with the new password instead; its 
+     bands are left as they are.
+ 
+ @param temporaryWrapperPath The path of the temporary wrapper directory. May not be nil.
+ @param oldPassword The master password with which the storage was created. May not be nil.
+ @param newPassword The new master password. May not be nil.
+ @param volumeOptions The volume options with which the storage was created. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the master password was changed.
+ */
++ (BOOL)changeMasterPasswordOfTemporaryWrapperAtPath:(NSString *)temporaryWrapperPath fromPassword:(NSString *)oldPassword 
+                                          toPassword:(NSString *)newPassword volumeOptions:(NSDictionary *)volumeOptions error:(NSError **)errorOut;
+
+/*!
+ @abstract Finishes creating a wrapper once its storage has been created.
+ @discussion If the storage was created successfully, the temporary wrapper is moved into place and opened as the specified user. If anything 
+     fails, the temporary wrapper, or the wrapper it was moved to, is removed.
+ 
+ @param path The path at which to create the wrapper. May not be nil.
+ @param temporaryWrapperPath The path of the temporary wrapper directory. May not be nil.
+ @param user The user's name. May not be nil.
+ @param password The user's password. May not be nil.
+ @param storageError The error that occurred while creating the wrapper's disk image or band store, or nil if it was created successfully.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The new wrapper, or nil if an error occurred.
+ */
++ (PGEncryptedDiskImageWrapper *)finishCreatingWrapperAtPath:(NSString *)path temporaryWrapperPath:(NSString *)temporaryWrapperPath 
+                                                        user:(NSString *)user password:(NSString *)password 
+                                                storageError:(NSError *)storageError error:(NSError **)errorOut;
+
+/*!
+ @abstract Returns an hdiutil task that will attach the receiver's disk image with the specified arguments.
+ @param arguments The attach arguments following the disk image's path. May not be nil.
+ @return An hdiutil task that attaches the disk image. The task has not been launched.
+ */
+- (PGHDIUtilTask *)attachTaskWithArguments:(NSArray *)arguments;
+
+/*!
+ @abstract Finishes attaching the receiver's disk image once its hdiutil attach task has finished.
+ @discussion If hdiutil succeeded, the receiver's mount point is set from hdiutil's output.
+ 
+ @param result hdiutil's output.
+ @param hdiutilError The error with which the hdiutil task finished, or nil if it succeeded.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The mount point at which the disk image was attached, or nil if it wasn't.
+ */
+- (NSString *)finishAttachingWithResult:(NSDictionary *)result hdiutilError:(NSError *)hdiutilError error:(NSError **)errorOut;
+
+/*!
+ @abstract Finishes detaching the receiver's disk image once its hdiutil detach task has finished.
+ 
+ @param hdiutilError The error with which the hdiutil task finished, or nil if it succeeded.
  @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
      information. You may specify NULL for this parameter if you do not want the error information.
  
- @return A boolean indicating whether the task completed executing successfully. 
+ @return Whether the disk image was detached.
  */
-+ (BOOL)executeHDIUtilTaskWithVerb:(PGHDIUtilVerb)verb arguments:(NSArray *)arguments password:(NSString *)password 
-                            result:(NSDictionary **)resultOut error:(NSError **)errorOut;
+- (BOOL)finishDetachingWithHDIUtilError:(NSError *)hdiutilError error:(NSError **)errorOut;
 
 /*!
  @abstract Reads the options supplied in the volume options directory and returns an array of arguments suitable to pass to an hdiutil task.
@@ -131,282 +375,1092 @@ static NSString *const PGUserTableFilename = @"UserTable.plist";
  */
 + (NSDictionary *)userTableEntryForMasterPassword:(NSString *)masterPassword user:(NSString *)user password:(NSString *)password;
 
+/*!
+ @abstract Returns a dictionary to be used as the value for the user's key in an encrypted disk image's user table, using the specified key
+     derivation parameters.
+ @discussion This is identical to +userTableEntryForMasterPassword:user:password:, except that the caller may supply pre-calibrated parameters
+     so that calibration isn't repeated for every entry in a batch, and that encryption errors are returned indirectly.
+ 
+ @param masterPassword The master password for the user table's corresponding encrypted disk image. May not be nil.
+ @param user The user's name. May not be nil.
+ @param password The user's password. May not be nil.
+ @param parameters The key derivation parameters to use. If their rounds value is 0, the rest are calibrated.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return A dictionary to be used as the value for the user's key in an encrypted disk image's user table, or nil if an error occurred.
+ */
++ (NSDictionary *)userTableEntryForMasterPassword:(NSString *)masterPassword user:(NSString *)user password:(NSString *)password 
+                          keyDerivationParameters:(PGKeyDerivationParameters)parameters error:(NSError **)errorOut;
+
+/*!
+ @abstract Returns the uncalibrated key derivation parameters with which new user table entries are created.
+ @return Parameters with the algorithm and lanes set with +setKeyDerivationAlgorithm:lanes: and a rounds value of 0.
+ */
++ (PGKeyDerivationParameters)userTableKeyDerivationParameters;
+
+/*!
+ @abstract Returns the associated data with which the secret of a user table or session table entry is authenticated.
+ @discussion Binding a secret to its entry's name means that a secret copied into another entry fails to decrypt.
+ 
+ @param name The user's name for user table entries, or the session's identifier for session table entries. May not be nil.
+ @param algorithm The algorithm with which the secret is encrypted.
+ 
+ @return The name's UTF-8 bytes if the algorithm is authenticated, or nil otherwise.
+ */
++ (NSData *)associatedDataForSecretOfEntryNamed:(NSString *)name algorithm:(PGEncryptionAlgorithm)algorithm;
+
+/*!
+ @abstract Returns the verifier for a session with the specified attributes.
+ @discussion The verifier is the HMAC-SHA256 of the session's identifier, user, expiration time, and the salt of the user's user table entry, 
+     keyed with the session key. Because only the holder of the session token knows the session key, a matching verifier proves that the token 
+     was issued by this wrapper for the user and expiration time recorded in the session table. Setting a user's password gives their entry a new
+     salt, so it invalidates every session token issued to them before.
+ 
+ @param identifier The session's identifier. May not be nil.
+ @param user The session's user. May not be nil.
+ @param userSalt The salt of the user's user table entry. May not be nil.
+ @param expiration The session's expiration time, in whole seconds since 1970. May not be nil.
+ @param sessionKey The session's key. May not be nil.
+ 
+ @return The verifier for the session.
+ */
++ (NSData *)sessionVerifierForIdentifier:(NSString *)identifier user:(NSString *)user userSalt:(NSData *)userSalt expiration:(NSNumber *)expiration 
+                              sessionKey:(NSData *)sessionKey;
+
+/*!
+ @abstract Sets up the receiver's paths for the wrapper at the specified path and reads the wrapper's user table.
+ @discussion This is shared by the initializers, which authenticate the user once the user table has been read.
+ 
+ @param path The path of the encrypted disk image wrapper. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the wrapper exists and its user table could be read.
+ */
+- (BOOL)loadWrapperAtPath:(NSString *)path error:(NSError **)errorOut;
+
+/*!
+ @abstract Returns a user table the receiver may change.
+ @discussion Wrappers start out with the shared, read-only table from the user table cache. The first time this is invoked, the receiver opens a
+     private table from the user table file and uses it from then on.
+ 
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The receiver's private user table, or nil if it could not be opened.
+ */
+- (PGUserTable *)writableUserTable:(NSError **)errorOut;
+
+/*!
+ @abstract Reads the wrapper's session table and returns it without any expired entries.
+ @return The unexpired entries in the session table, keyed by session identifier. If there is no session table, returns an empty dictionary.
+ */
+- (NSMutableDictionary *)unexpiredSessionTable;
+
+/*!
+ @abstract Changes the wrapper's session table while holding an exclusive lock on it.
+ @discussion The session table is read, stripped of expired entries, changed by the block, and atomically replaced, all while the lock is held, 
+     so concurrent changes from any number of threads and processes are never lost. In particular, a revoked session can't be brought back by a
+     writer that read the table before it was revoked. Readers don't take the lock; they see either the old table or the new one.
+ 
+ @param block The block that changes the unexpired entries of the session table, keyed by session identifier. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the session table was written successfully.
+ */
+- (BOOL)changeSessionTableUsingBlock:(void (^)(NSMutableDictionary *sessionTable))block error:(NSError **)errorOut;
+
 @property(readwrite, copy) NSString *masterPassword;
 @property(readwrite, strong) NSString *mountPoint;
-@property(readwrite, strong) NSMutableDictionary *userTable;
+@property(readwrite, strong) PGUserTable *userTable;
 @property(readwrite, strong) NSString *wrapperPath;
+@property(readwrite, copy) NSString *user;
+
+@end
+
+
+#pragma mark - Implementation
+
+@implementation PGEncryptedDiskImageWrapper {
+    NSString *_wrapperPath;
+    NSString *_diskImagePath;
+    NSString *_bandStorePath;
+    NSString *_userTablePath;
+    NSString *_sessionTablePath;
+    NSString *_manifestPath;
+    
+    // Whether _userTable came from the user table cache and so must not be changed
+    BOOL _userTableIsShared;
+}
+
+
++ (PGEncryptedDiskImageWrapper *)createEncryptedDiskImageWrapperAtPath:(NSString *)path
+                                                        masterPassword:(NSString *)masterPassword
+                                                                  user:(NSString *)user
+                                                              password:(NSString *)password
+                                                         volumeOptions:(NSDictionary *)volumeOptions
+                                                                 error:(NSError **)errorOut
+{
+    return [self createEncryptedDiskImageWrapperAtPath:path masterPassword:masterPassword user:user password:password volumeOptions:volumeOptions 
+                                          templatePool:nil error:errorOut];
+}
+
+
++ (PGEncryptedDiskImageWrapper *)createEncryptedDiskImageWrapperAtPath:(NSString *)path
+                                                        masterPassword:(NSString *)masterPassword
+                                                                  user:(NSString *)user
+                                                              password:(NSString *)password
+                                                         volumeOptions:(NSDictionary *)volumeOptions
+                                                          templatePool:(PGTemplatePool *)templatePool
+                                                                 error:(NSError **)errorOut
+{
+    // A claimed template already has its storage, so all that's left is to change its randomly generated master password to ours and write its
+    // user table. Changing the password is much faster than creating the storage. The template is ours now, so it's removed if anything fails.
+    NSString *templateMasterPassword = nil;
+    NSString *templatePath = [templatePool claimTemplateForVolumeOptions:volumeOptions masterPassword:&templateMasterPassword];
+    if (templatePath) {
+        if (![self changeMasterPasswordOfTemporaryWrapperAtPath:templatePath fromPassword:templateMasterPassword toPassword:masterPassword 
+                                                  volumeOptions:volumeOptions error:errorOut] ||
+            ![self writeUserTableInWrapperAtPath:templatePath masterPassword:masterPassword user:user password:password error:errorOut]) {
+            [[NSFileManager defaultManager] removeItemAtPath:templatePath error:NULL];
+            return nil;
+        }
+        
+        return [self finishCreatingWrapperAtPath:path temporaryWrapperPath:templatePath user:user password:password storageError:nil 
+                                           error:errorOut];
+    }
+    
+    NSString *tempWrapperPath = [self createTemporaryWrapperWithMasterPassword:masterPassword user:user password:password error:errorOut];
+    if (!tempWrapperPath) return nil;
+    
+    NSError *error = nil;
+    if ([[volumeOptions objectForKey:PGBackendVolumeOption] isEqualToString:PGBandStoreBackend]) {
+        [self createBandStoreInTemporaryWrapperAtPath:tempWrapperPath masterPassword:masterPassword volumeOptions:volumeOptions error:&error];
+    } else {
+        PGHDIUtilTask *hdiutil = [self diskImageCreationTaskForTemporaryWrapperAtPath:tempWrapperPath masterPassword:masterPassword 
+                                                                        volumeOptions:volumeOptions];
+        [hdiutil launchAndWaitWithResult:NULL error:&error];
+    }
+    
+    return [self finishCreatingWrapperAtPath:path temporaryWrapperPath:tempWrapperPath user:user password:password storageError:error error:errorOut];
+}
+
+
++ (PGHDIUtilTask *)createEncryptedDiskImageWrapperAtPath:(NSString *)path
+                                          masterPassword:(NSString *)masterPassword
+                                                    user:(NSString *)user
+                                                password:(NSString *)password
+                                           volumeOptions:(NSDictionary *)volumeOptions
+                                                 timeout:(NSTimeInterval)timeout
+                                       completionHandler:(void (^)(PGEncryptedDiskImageWrapper *, NSError *))handler
+{
+    NSAssert(handler, @"nil handler");
+    
+    NSError *error = nil;
+    NSString *tempWrapperPath = [self createTemporaryWrapperWithMasterPassword:masterPassword user:user password:password error:&error];
+    if (!tempWrapperPath) {
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            handler(nil, error);
+        });
+        return nil;
+    }
+    
+    // Band stores are created in-process without hdiutil, so there's no task to return
+    if ([[volumeOptions objectForKey:PGBackendVolumeOption] isEqualToString:PGBandStoreBackend]) {
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            NSError *creationError = nil;
+            [self createBandStoreInTemporaryWrapperAtPath:tempWrapperPath masterPassword:masterPassword volumeOptions:volumeOptions error:&creationError];
+            PGEncryptedDiskImageWrapper *wrapper = [self finishCreatingWrapperAtPath:path temporaryWrapperPath:tempWrapperPath user:user 
+                                                                            password:password storageError:creationError error:&creationError];
+            handler(wrapper, creationError);
+        });
+        return nil;
+    }
+    
+    PGHDIUtilTask *hdiutil = [self diskImageCreationTaskForTemporaryWrapperAtPath:tempWrapperPath masterPassword:masterPassword 
+                                                                    volumeOptions:volumeOptions];
+    [hdiutil setTimeout:timeout];
+    [hdiutil launchWithCompletionHandler:^(NSDictionary *result, NSError *hdiutilError) {
+        NSError *creationError = nil;
+        PGEncryptedDiskImageWrapper *wrapper = [self finishCreatingWrapperAtPath:path temporaryWrapperPath:tempWrapperPath user:user 
+                                                                        password:password storageError:hdiutilError error:&creationError];
+        handler(wrapper, creationError);
+    }];
+    
+    return hdiutil;
+}
+
+
++ (PGHDIUtilTask *)createWrapperTemplateAtPath:(NSString *)path
+                                masterPassword:(NSString *)masterPassword
+                                 volumeOptions:(NSDictionary *)volumeOptions
+                                       timeout:(NSTimeInterval)timeout
+                             completionHandler:(void (^)(BOOL, NSError *))handler
+{
+    NSAssert(path, @"nil path");
+    NSAssert(handler, @"nil handler");
+    
+    NSError *error = nil;
+    NSDictionary *attributes = [NSDictionary dictionaryWithObject:[NSNumber numberWithShort:0700] forKey:NSFilePosixPermissions];
+    if (![[NSFileManager defaultManager] createDirectoryAtPath:path withIntermediateDirectories:NO attributes:attributes error:&error]) {
+        NSError *creationError = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperCreationError userInfoObjectsAndKeys:error,
+                                  NSUnderlyingErrorKey, NSLocalizedString(@"Failed to create the encrypted disk image wrapper directory.", nil),
+                                  NSLocalizedDescriptionKey, nil];
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            handler(NO, creationError);
+        });
+        return nil;
+    }
+    
+    void (^finishHandler)(NSError *) = ^(NSError *storageError) {
+        if (!storageError) {
+            handler(YES, nil);
+            return;
+        }
+        
+        [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+        handler(NO, [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperCreationError userInfoObjectsAndKeys:storageError,
+                     NSUnderlyingErrorKey, NSLocalizedString(@"Failed to create the encrypted disk image.", nil), NSLocalizedDescriptionKey, nil]);
+    };
+    
+    if ([[volumeOptions objectForKey:PGBackendVolumeOption] isEqualToString:PGBandStoreBackend]) {
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            NSError *creationError = nil;
+            [self createBandStoreInTemporaryWrapperAtPath:path masterPassword:masterPassword volumeOptions:volumeOptions error:&creationError];
+            finishHandler(creationError);
+        });
+        return nil;
+    }
+    
+    PGHDIUtilTask *hdiutil = [self diskImageCreationTaskForTemporaryWrapperAtPath:path masterPassword:masterPassword volumeOptions:volumeOptions];
+    [hdiutil setTimeout:timeout];
+    [hdiutil launchWithCompletionHandler:^(NSDictionary *result, NSError *hdiutilError) {
+        finishHandler(hdiutilError);
+    }];
+    
+    return hdiutil;
+}
+
+
+// There’s no meaningful default values for our designated initializer, so we just don't recognize the -init message.
+- (id)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    return nil;
+}
+
+
+- (id)initWithContentsOfFile:(NSString *)path user:(NSString *)user password:(NSString *)password error:(NSError **)errorOut
+{
+    if (!(self = [super init])) return nil;
+    if (![self loadWrapperAtPath:path error:errorOut]) return nil;
+
+    // Get the user's entry
+    NSDictionary *userEntry = [_userTable entryForUser:user];
+    if (!userEntry) {
+        PGInstrumentationIncrementCounter(PGAuthenticationFailureCounter);
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperAuthenticationError userInfoObjectsAndKeys:
+                                   NSLocalizedString(@"Bad user name or password.", nil), NSLocalizedDescriptionKey, nil];
+        return nil;
+    }
+    
+    // Get the data necessary to decrypt the master password
+    NSData *secret = [userEntry objectForKey:PGSecretUserTableEntryKey];
+    NSData *salt = [userEntry objectForKey:PGSaltUserTableEntryKey];
+    NSNumber *rounds = [userEntry objectForKey:PGRoundsUserTableEntryKey];
+    NSData *iv = [userEntry objectForKey:PGInitializationVectorUserTableEntryKey];
+    PGEncryptionAlgorithm algorithm = [[userEntry objectForKey:PGAlgorithmUserTableEntryKey] unsignedIntValue];
+    if (!(salt && rounds && iv && secret)) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperMalformedUserTableError userInfo:nil];
+        return nil;
+    }
+    
+    // Entries without a key derivation algorithm were derived with PBKDF2, and have no other parameters
+    PGKeyDerivationParameters parameters = { 
+        [[userEntry objectForKey:PGKeyDerivationUserTableEntryKey] unsignedIntValue], [rounds unsignedIntValue], 
+        [[userEntry objectForKey:PGBlockSizeUserTableEntryKey] unsignedIntValue], [[userEntry objectForKey:PGLanesUserTableEntryKey] unsignedIntValue]
+    };
+        
+    // Attempt to decrypt the master password
+    NSError *error = nil;
+    uint64_t startTime = PGInstrumentationBeginSpan();
+    NSData *masterPasswordData = [secret decryptedDataWithPassword:password algorithm:algorithm 
+                                                    associatedData:[[self class] associatedDataForSecretOfEntryNamed:user algorithm:algorithm] 
+                                           keyDerivationParameters:parameters salt:salt initializationVector:iv error:&error];
+    PGInstrumentationEndSpan(PGAuthenticationSpan, startTime);
+    
+    if (!masterPasswordData) {
+        PGInstrumentationIncrementCounter(PGAuthenticationFailureCounter);
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperAuthenticationError userInfoObjectsAndKeys:
+                                   error, NSUnderlyingErrorKey, NSLocalizedString(@"Bad user name or password.", nil), NSLocalizedDescriptionKey, nil];
+        return nil;
+    }
+    
+    // If we were unable to determine the master password, something went wrong, so return nil
+    [self setMasterPassword:[[NSString alloc] initWithData:masterPasswordData encoding:NSUTF8StringEncoding]];
+    [self setUser:user];
+    return _masterPassword ? self : nil;
+}
+
+
+- (id)initWithContentsOfFile:(NSString *)path sessionToken:(NSString *)sessionToken error:(NSError **)errorOut
+{
+    NSAssert(sessionToken, @"nil session token");
+    
+    if (!(self = [super init])) return nil;
+    if (![self loadWrapperAtPath:path error:errorOut]) return nil;
+    
+    // Split the token into its identifier and key, and look up the identifier's session
+    NSArray *tokenComponents = [sessionToken componentsSeparatedByString:PGSessionTokenSeparator];
+    NSString *identifier = nil;
+    NSData *sessionKey = nil;
+    if ([tokenComponents count] == 2) {
+        identifier = [tokenComponents objectAtIndex:0];
+        sessionKey = [NSData dataWithHexadecimalString:[tokenComponents objectAtIndex:1]];
+    }
+    
+    NSDictionary *sessionEntry = identifier ? [PGCachedSessionTable(_sessionTablePath) objectForKey:identifier] : nil;
+    NSString *user = [sessionEntry objectForKey:PGUserSessionTableEntryKey];
+    NSNumber *expiration = [sessionEntry objectForKey:PGExpirationSessionTableEntryKey];
+    NSData *verifier = [sessionEntry objectForKey:PGVerifierSessionTableEntryKey];
+    NSData *iv = [sessionEntry objectForKey:PGInitializationVectorSessionTableEntryKey];
+    NSData *secret = [sessionEntry objectForKey:PGSecretSessionTableEntryKey];
+    PGEncryptionAlgorithm algorithm = [[sessionEntry objectForKey:PGAlgorithmSessionTableEntryKey] unsignedIntValue];
+    NSData *userSalt = user ? [[_userTable entryForUser:user] objectForKey:PGSaltUserTableEntryKey] : nil;
+    
+    // The session is valid if it exists and hasn't expired, its user hasn't been removed or had their password changed since it was issued, and
+    // its verifier matches the token. The session table is only parsed if it has changed, so this takes a stat, a lookup, and a single HMAC.
+    if (!(sessionKey && user && expiration && verifier && iv && secret && userSalt) || 
+        [expiration longLongValue] <= (long long)[[NSDate date] timeIntervalSince1970] ||
+        ![[[self class] sessionVerifierForIdentifier:identifier user:user userSalt:userSalt expiration:expiration sessionKey:sessionKey] 
+          isEqualToDataInConstantTime:verifier]) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperAuthenticationError userInfoObjectsAndKeys:
+                                   NSLocalizedString(@"Invalid or expired session token.", nil), NSLocalizedDescriptionKey, nil];
+        return nil;
+    }
+    
+    // Decrypt the master password with the session key. No key derivation is necessary because the session key is random.
+    NSError *error = nil;
+    NSData *masterPasswordData = [secret decryptedDataWithSymmetricKey:sessionKey algorithm:algorithm 
+                                                        associatedData:[[self class] associatedDataForSecretOfEntryNamed:identifier algorithm:algorithm]
+                                                  initializationVector:iv error:&error];
+    if (!masterPasswordData) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperAuthenticationError userInfoObjectsAndKeys:
+                                   error, NSUnderlyingErrorKey, NSLocalizedString(@"Invalid or expired session token.", nil), NSLocalizedDescriptionKey, nil];
+        return nil;
+    }
+    
+    [self setMasterPassword:[[NSString alloc] initWithData:masterPasswordData encoding:NSUTF8StringEncoding]];
+    [self setUser:user];
+    return _masterPassword ? self : nil;
+}
+
+
+
+#pragma mark Mounting and Unmounting
+
+- (BOOL)attachAtPath:(NSString *)mountPath error:(NSError **)errorOut
+{
+    if ([self isAttached]) return NO;
+    
+    NSError *error = nil;
+    NSDictionary *result = nil; 
+    PGHDIUtilTask *hdiutil = [self attachTaskWithArguments:[NSArray arrayWithObjects:@"-mountpoint", mountPath, nil]];
+    [hdiutil launchAndWaitWithResult:&result error:&error];
+    return [self finishAttachingWithResult:result hdiutilError:error error:errorOut] != nil;
+}
+
+
+- (PGHDIUtilTask *)attachAtPath:(NSString *)mountPath timeout:(NSTimeInterval)timeout completionHandler:(void (^)(BOOL, NSError *))handler
+{
+    NSAssert(handler, @"nil handler");
+    
+    if ([self isAttached]) {
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            handler(NO, nil);
+        });
+        return nil;
+    }
+    
+    PGHDIUtilTask *hdiutil = [self attachTaskWithArguments:[NSArray arrayWithObjects:@"-mountpoint", mountPath, nil]];
+    [hdiutil setTimeout:timeout];
+    [hdiutil launchWithCompletionHandler:^(NSDictionary *result, NSError *hdiutilError) {
+        NSError *error = nil;
+        BOOL attached = [self finishAttachingWithResult:result hdiutilError:hdiutilError error:&error] != nil;
+        handler(attached, error);
+    }];
+    
+    return hdiutil;
+}
+
+
+- (NSString *)attachAtRandomSubdirectoryOfPath:(NSString *)mountRoot error:(NSError **)errorOut
+{
+    if ([self isAttached]) return nil;
+
+    NSError *error = nil;
+    NSDictionary *result = nil; 
+    PGHDIUtilTask *hdiutil = [self attachTaskWithArguments:[NSArray arrayWithObjects:@"-mountrandom", mountRoot, nil]];
+    [hdiutil launchAndWaitWithResult:&result error:&error];
+    return [self finishAttachingWithResult:result hdiutilError:error error:errorOut];
+}
+
+
+- (PGHDIUtilTask *)attachAtRandomSubdirectoryOfPath:(NSString *)mountRoot timeout:(NSTimeInterval)timeout 
+                                  completionHandler:(void (^)(NSString *, NSError *))handler
+{
+    NSAssert(handler, @"nil handler");
+    
+    if ([self isAttached]) {
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            handler(nil, nil);
+        });
+        return nil;
+    }
+    
+    PGHDIUtilTask *hdiutil = [self attachTaskWithArguments:[NSArray arrayWithObjects:@"-mountrandom", mountRoot, nil]];
+    [hdiutil setTimeout:timeout];
+    [hdiutil launchWithCompletionHandler:^(NSDictionary *result, NSError *hdiutilError) {
+        NSError *error = nil;
+        NSString *mountPoint = [self finishAttachingWithResult:result hdiutilError:hdiutilError error:&error];
+        handler(mountPoint, error);
+    }];
+    
+    return hdiutil;
+}
+
+
+- (BOOL)detach:(NSError **)errorOut
+{
+    if (![self isAttached]) return NO;
+    
+    NSError *error = nil;
+    PGHDIUtilTask *hdiutil = [[PGHDIUtilTask alloc] initWithVerb:PGHDIUtilDetachVerb arguments:[NSArray arrayWithObject:_mountPoint] password:nil];
+    [hdiutil launchAndWaitWithResult:NULL error:&error];
+    return [self finishDetachingWithHDIUtilError:error error:errorOut];
+}
+
+
+- (PGHDIUtilTask *)detachWithTimeout:(NSTimeInterval)timeout completionHandler:(void (^)(BOOL, NSError *))handler
+{
+    NSAssert(handler, @"nil handler");
+    
+    if (![self isAttached]) {
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            handler(NO, nil);
+        });
+        return nil;
+    }
+    
+    PGHDIUtilTask *hdiutil = [[PGHDIUtilTask alloc] initWithVerb:PGHDIUtilDetachVerb arguments:[NSArray arrayWithObject:_mountPoint] password:nil];
+    [hdiutil setTimeout:timeout];
+    [hdiutil launchWithCompletionHandler:^(NSDictionary *result, NSError *hdiutilError) {
+        NSError *error = nil;
+        BOOL detached = [self finishDetachingWithHDIUtilError:hdiutilError error:&error];
+        handler(detached, error);
+    }];
+    
+    return hdiutil;
+}
+
+
+- (BOOL)isAttached
+{
+    return _mountPoint != nil;
+}
+
+
+#pragma mark Band Stores
+
+- (PGBandStore *)openBandStore:(NSError **)errorOut
+{
+    if (![[NSFileManager defaultManager] fileExistsAtPath:_bandStorePath]) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileNoSuchFileError userInfo:nil];
+        return nil;
+    }
+    
+    return [[PGBandStore alloc] initWithContentsOfFile:_bandStorePath password:_masterPassword error:errorOut];
+}
+
+
+#pragma mark Integrity Manifests
+
+- (BOOL)updateManifest:(NSError **)errorOut
+{
+    // Start from the existing manifest, if there is one, so that only files that have changed since it was written are hashed. Its digests are 
+    // only reused if it's authentic. The session table changes whenever a token is issued, so it isn't covered.
+    PGManifest *manifest = [[PGManifest alloc] initWithContentsOfFile:_manifestPath password:_masterPassword error:NULL];
+    if (manifest) {
+        manifest = [manifest manifestByUpdatingWithDirectoryAtPath:_wrapperPath options:0 error:errorOut];
+    } else {
+        manifest = [PGManifest manifestWithDirectoryAtPath:_wrapperPath 
+                                     excludedRelativePaths:[NSSet setWithObjects:PGManifestFilename, PGSessionTableFilename, nil] error:errorOut];
+    }
+    
+    return manifest && [manifest writeToFile:_manifestPath password:_masterPassword error:errorOut];
+}
+
+
+- (BOOL)verifyManifestWithOptions:(PGManifestOptions)options error:(NSError **)errorOut
+{
+    // The manifest's authentication code is keyed with the master password, so someone who changes the wrapper's contents can't cover it up by 
+    // recomputing the manifest
+    PGManifest *manifest = [[PGManifest alloc] initWithContentsOfFile:_manifestPath password:_masterPassword error:errorOut];
+    PGManifest *currentManifest = [manifest manifestByUpdatingWithDirectoryAtPath:_wrapperPath options:options error:errorOut];
+    if (!currentManifest) return NO;
+    
+    NSArray *mismatchedPaths = [manifest relativePathsOfFilesDifferingFromManifest:currentManifest];
+    if ([mismatchedPaths count] > 0) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperManifestMismatchError 
+                                    userInfoObjectsAndKeys:NSLocalizedString(@"The wrapper's contents don't match its manifest.", nil), 
+                                   NSLocalizedDescriptionKey, mismatchedPaths, PGMismatchedPathsKey, nil];
+        return NO;
+    }
+    
+    return YES;
+}
+
+
+#pragma mark Backup and Restore
+
+- (PGArchiveCatalog *)exportToFileDescriptor:(int)fileDescriptor baseCatalog:(PGArchiveCatalog *)baseCatalog error:(NSError **)errorOut
+{
+    // Restoring the session table could bring back tokens that were revoked after the backup, so it is left out and restored wrappers start
+    // with no sessions
+    return [[[PGArchiver alloc] init] archiveDirectoryAtPath:_wrapperPath toFileDescriptor:fileDescriptor 
+                                       excludedRelativePaths:[NSSet setWithObject:PGSessionTableFilename] baseCatalog:baseCatalog error:errorOut];
+}
+
+
++ (PGArchiveCatalog *)importWrapperFromFileDescriptor:(int)fileDescriptor toPath:(NSString *)path error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    return [[[PGArchiver alloc] init] extractArchiveFromFileDescriptor:fileDescriptor toDirectoryAtPath:path error:errorOut];
+}
+
+
+#pragma mark User Table Management
+
+- (void)setPassword:(NSString *)password forUser:(NSString *)user
+{
+    [self setPassword:password forUser:user error:NULL];
+}
+
+
+- (void)removeUser:(NSString *)user
+{
+    [self removeUser:user error:NULL];
+}
+
+
+- (BOOL)saveUserTable
+{
+    return [self saveUserTable:NULL];
+}
+
+
+- (BOOL)setPassword:(NSString *)password forUser:(NSString *)user error:(NSError **)errorOut
+{
+    PGUserTable *userTable = [self writableUserTable:errorOut];
+    if (!userTable) return NO;
+    
+    NSDictionary *entry = [[self class] userTableEntryForMasterPassword:_masterPassword user:user password:password 
+                                                keyDerivationParameters:[[self class] userTableKeyDerivationParameters] error:errorOut];
+    if (!entry) return NO;
+    
+    [userTable setEntry:entry forUser:user];
+    return YES;
+}
 
-@end
 
+- (BOOL)removeUser:(NSString *)user error:(NSError **)errorOut
+{
+    PGUserTable *userTable = [self writableUserTable:errorOut];
+    if (!userTable) return NO;
+    
+    [userTable removeEntryForUser:user];
+    return YES;
+}
 
-#pragma mark - Implementation
 
-@implementation PGEncryptedDiskImageWrapper {
-    NSString *_wrapperPath;
-    NSString *_diskImagePath;
-    NSString *_userTablePath;
+- (BOOL)saveUserTable:(NSError **)errorOut
+{
+    PGUserTable *userTable = [self writableUserTable:errorOut];
+    return userTable && [userTable saveChanges:errorOut];
 }
 
 
-+ (PGEncryptedDiskImageWrapper *)createEncryptedDiskImageWrapperAtPath:(NSString *)path
-                                                        masterPassword:(NSString *)masterPassword
-                                                                  user:(NSString *)user
-                                                              password:(NSString *)password
-                                                         volumeOptions:(NSDictionary *)volumeOptions
-                                                                 error:(NSError **)errorOut
+- (BOOL)setPasswords:(NSDictionary *)passwordsByUser removeUsers:(NSArray *)usersToRemove 
+     progressHandler:(void (^)(NSUInteger, NSUInteger))progressHandler error:(NSError **)errorOut
 {
-    NSError *error = nil;
+    // Open the table before deriving anything, so that a table that can't be changed fails the batch before any progress is reported
+    PGUserTable *userTable = [self writableUserTable:errorOut];
+    if (!userTable) return NO;
     
-    // Create a temp wrapper directory in which to generate our wrapper
-    NSString *tempWrapperPath = [[NSFileManager defaultManager] createTemporaryDirectoryWithTemplate:@"PGEncryptedDiskImageWrapper.XXXXXX" error:&error];
-    if (!tempWrapperPath) {
-        if (errorOut) {
-            *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperCreationError userInfoObjectsAndKeys:error,
-                         NSUnderlyingErrorKey, NSLocalizedString(@"Failed to create the encrypted disk image wrapper directory.", nil),
-                         NSLocalizedDescriptionKey, nil];
+    NSArray *users = [passwordsByUser allKeys];
+    NSSet *removedUsers = [NSSet setWithArray:usersToRemove ? usersToRemove : [NSArray array]];
+    NSUInteger userCount = [users count];
+    NSUInteger totalCount = userCount + [removedUsers count];
+    
+    // Calibrating takes about as long as a derivation, so do it once for the whole batch using the average password length
+    NSUInteger totalPasswordLength = 0;
+    for (id password in [passwordsByUser allValues]) {
+        if ([password isKindOfClass:[NSString class]]) totalPasswordLength += [password length];
+    }
+    
+    PGKeyDerivationParameters parameters = [[self class] userTableKeyDerivationParameters];
+    if (userCount > 0) {
+        parameters = [NSData calibratedKeyDerivationParametersForAlgorithm:parameters.algorithm lanes:parameters.lanes 
+                                                            passwordLength:totalPasswordLength / userCount];
+    }
+    
+    NSString *masterPassword = _masterPassword;
+    
+    // Derive every entry concurrently. Each index is a self-contained job, and GCD hands the next one to whichever worker thread is free,
+    // so a slow derivation never holds up the rest of the batch. Progress is serialized on its own queue so the handler is never reentered.
+    // scrypt already spreads each derivation across the cores, and deriving several at once would multiply the memory it uses, so its 
+    // entries are derived one at a time.
+    NSMutableArray *results = [NSMutableArray arrayWithCapacity:userCount];
+    for (NSUInteger i = 0; i < userCount; i++) [results addObject:[NSNull null]];
+    
+    dispatch_queue_t progressQueue = dispatch_queue_create("com.quantumlenscap.PGEncryptedDiskImageWrapper.progress", DISPATCH_QUEUE_SERIAL);
+    __block NSUInteger completedCount = 0;
+    
+    BOOL derivesSerially = parameters.algorithm == PGScryptKeyDerivationAlgorithm;
+    dispatch_queue_t derivationQueue = derivesSerially ? 
+        dispatch_queue_create("com.quantumlenscap.PGEncryptedDiskImageWrapper.derivation", DISPATCH_QUEUE_SERIAL) : 
+        dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    
+    dispatch_apply(userCount, derivationQueue, ^(size_t i) {
+        @autoreleasepool {
+            NSString *user = [users objectAtIndex:i];
+            id password = [passwordsByUser objectForKey:user];
+            
+            id result = nil;
+            if (![user isKindOfClass:[NSString class]] || [user length] == 0 || ![password isKindOfClass:[NSString class]] ||
+                [password length] == 0 || [removedUsers containsObject:user]) {
+                result = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperInvalidUserEntryError userInfoObjectsAndKeys:
+                          NSLocalizedString(@"The user name or password is empty, or the user is also being removed.", nil), 
+                          NSLocalizedDescriptionKey, nil];
+            } else {
+                NSError *error = nil;
+                result = [[self class] userTableEntryForMasterPassword:masterPassword user:user password:password 
+                                               keyDerivationParameters:parameters error:&error];
+                if (!result) result = error;
+            }
+            
+            @synchronized (results) {
+                [results replaceObjectAtIndex:i withObject:result];
+            }
+            
+            if (progressHandler) {
+                dispatch_async(progressQueue, ^{
+                    progressHandler(++completedCount, totalCount);
+                });
+            }
         }
-        return nil;
+    });
+    
+    if (derivesSerially) dispatch_release(derivationQueue);
+    
+    // Nothing is committed unless every entry could be derived
+    NSMutableDictionary *userErrors = [NSMutableDictionary dictionary];
+    for (NSUInteger i = 0; i < userCount; i++) {
+        id result = [results objectAtIndex:i];
+        if ([result isKindOfClass:[NSError class]]) [userErrors setObject:result forKey:[users objectAtIndex:i]];
     }
     
-    // Create the user table
-    NSMutableDictionary *userTable = [[NSMutableDictionary alloc] init];
-    [userTable setObject:[self userTableEntryForMasterPassword:masterPassword user:user password:password] forKey:user];
-    if (![userTable writeToFile:[tempWrapperPath stringByAppendingPathComponent:PGUserTableFilename] atomically:YES]) {
-        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperCreationError userInfoObjectsAndKeys:
-                         NSLocalizedString(@"Failed to create the encrypted disk image's user table.", nil), NSLocalizedDescriptionKey, nil];
-        return nil;
+    if ([userErrors count] > 0) {
+        dispatch_sync(progressQueue, ^{ });
+        dispatch_release(progressQueue);
+        
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperUserProvisioningFailedError 
+                                    userInfoObjectsAndKeys:NSLocalizedString(@"One or more users could not be provisioned.", nil), 
+                                   NSLocalizedDescriptionKey, userErrors, PGUserErrorsKey, nil];
+        return NO;
+    }
+    
+    for (NSUInteger i = 0; i < userCount; i++) {
+        [userTable setEntry:[results objectAtIndex:i] forUser:[users objectAtIndex:i]];
+    }
+    
+    for (NSString *user in removedUsers) {
+        [userTable removeEntryForUser:user];
+        if (progressHandler) {
+            dispatch_async(progressQueue, ^{
+                progressHandler(++completedCount, totalCount);
+            });
+        }
+    }
+    
+    // Drain outstanding progress callbacks so that none are delivered after we return
+    dispatch_sync(progressQueue, ^{ });
+    dispatch_release(progressQueue);
+    
+    // The user table logs all pending changes as a single checksummed record, so the batch takes effect atomically, even across a crash
+    return [userTable saveChanges:errorOut];
+}
+
+
++ (void)setKeyDerivationAlgorithm:(PGKeyDerivationAlgorithm)algorithm lanes:(NSUInteger)lanes
+{
+    @synchronized ([PGEncryptedDiskImageWrapper class]) {
+        PGUserTableKeyDerivationAlgorithm = algorithm;
+        PGUserTableKeyDerivationLanes = lanes;
     }
+}
 
-    // Create the encrypted disk image
-    NSMutableArray *args = [self hdiutilTaskArgumentsForVolumeOptions:volumeOptions];
-    [args insertObject:[tempWrapperPath stringByAppendingPathComponent:PGEncryptedDiskImageFilename] atIndex:0];
-    if (![self executeHDIUtilTaskWithVerb:PGHDIUtilCreateVerb arguments:args password:masterPassword result:NULL error:&error]) {
-        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperCreationError userInfoObjectsAndKeys:error,
-                                   NSUnderlyingErrorKey, NSLocalizedString(@"Failed to create the encrypted disk image.", nil), NSLocalizedDescriptionKey, 
-                                   nil];
+
+#pragma mark Sessions
+
+- (NSString *)issueSessionTokenWithTimeToLive:(NSTimeInterval)timeToLive error:(NSError **)errorOut
+{
+    NSAssert(timeToLive > 0, @"non-positive time to live");
+    
+    NSString *identifier = [[NSData randomDataOfLength:PGSessionTokenIdentifierLength] hexadecimalString];
+    NSData *sessionKey = [NSData randomSymmetricKey];
+    NSNumber *expiration = [NSNumber numberWithLongLong:(long long)ceil([[NSDate date] timeIntervalSince1970] + timeToLive)];
+    
+    // Encrypt the master password with the session key, which only the token's holder will know
+    NSError *error = nil;
+    NSData *iv = nil;
+    PGEncryptionAlgorithm algorithm = PGSecretEncryptionAlgorithm();
+    NSData *secret = [[_masterPassword dataUsingEncoding:NSUTF8StringEncoding] 
+                      encryptedDataWithSymmetricKey:sessionKey algorithm:algorithm 
+                      associatedData:[[self class] associatedDataForSecretOfEntryNamed:identifier algorithm:algorithm]
+                      initializationVector:&iv error:&error];
+    if (!secret) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperSessionTableWriteFailedError 
+                                           underlyingError:error];
         return nil;
     }
     
-    // Move the disk image wrapper to URL
-    if (![[NSFileManager defaultManager] moveItemAtPath:tempWrapperPath toPath:path error:&error]) {
-        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperCreationError userInfoObjectsAndKeys: error, 
-                                   NSUnderlyingErrorKey, NSLocalizedString(@"Failed to save the encrypted disk image wrapper.", nil), 
-                                   NSLocalizedDescriptionKey, nil];
+    // Bind the session to the user's current entry, so that changing their password invalidates it
+    NSData *userSalt = [[_userTable entryForUser:_user] objectForKey:PGSaltUserTableEntryKey];
+    if (!userSalt) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperSessionTableWriteFailedError 
+                                    userInfoObjectsAndKeys:NSLocalizedString(@"The user no longer exists.", nil), NSLocalizedDescriptionKey, nil];
         return nil;
     }
-
-    return [[self alloc] initWithContentsOfFile:path user:user password:password error:errorOut];
+    
+    NSData *verifier = [[self class] sessionVerifierForIdentifier:identifier user:_user userSalt:userSalt expiration:expiration 
+                                                       sessionKey:sessionKey];
+    NSDictionary *sessionEntry = [NSDictionary dictionaryWithObjectsAndKeys:_user, PGUserSessionTableEntryKey, 
+                                  expiration, PGExpirationSessionTableEntryKey, verifier, PGVerifierSessionTableEntryKey, 
+                                  iv, PGInitializationVectorSessionTableEntryKey, secret, PGSecretSessionTableEntryKey, 
+                                  [NSNumber numberWithUnsignedInt:algorithm], PGAlgorithmSessionTableEntryKey, nil];
+    
+    BOOL written = [self changeSessionTableUsingBlock:^(NSMutableDictionary *sessionTable) {
+        [sessionTable setObject:sessionEntry forKey:identifier];
+    } error:errorOut];
+    if (!written) return nil;
+    
+    return [NSString stringWithFormat:@"%@%@%@", identifier, PGSessionTokenSeparator, [sessionKey hexadecimalString]];
 }
 
 
-// There’s no meaningful default values for our designated initializer, so we just don't recognize the -init message.
-- (id)init
+- (BOOL)revokeSessionToken:(NSString *)sessionToken error:(NSError **)errorOut
 {
-    [self doesNotRecognizeSelector:_cmd];
-    return nil;
+    NSAssert(sessionToken, @"nil session token");
+    
+    NSString *identifier = [[sessionToken componentsSeparatedByString:PGSessionTokenSeparator] objectAtIndex:0];
+    return [self changeSessionTableUsingBlock:^(NSMutableDictionary *sessionTable) {
+        [sessionTable removeObjectForKey:identifier];
+    } error:errorOut];
 }
 
 
-- (id)initWithContentsOfFile:(NSString *)path user:(NSString *)user password:(NSString *)password error:(NSError **)errorOut
+- (BOOL)revokeAllSessionTokensForUser:(NSString *)user error:(NSError **)errorOut
 {
-    if (!(self = [super init])) return nil;
+    NSAssert(user, @"nil user");
+    
+    return [self changeSessionTableUsingBlock:^(NSMutableDictionary *sessionTable) {
+        NSSet *identifiers = [sessionTable keysOfEntriesPassingTest:^BOOL(id identifier, id sessionEntry, BOOL *stop) {
+            return [[sessionEntry objectForKey:PGUserSessionTableEntryKey] isEqualToString:user];
+        }];
+        
+        [sessionTable removeObjectsForKeys:[identifiers allObjects]];
+    } error:errorOut];
+}
 
+
+#pragma mark Private Methods
+
+- (BOOL)loadWrapperAtPath:(NSString *)path error:(NSError **)errorOut
+{
     [self setWrapperPath:path];    
     _userTablePath = [_wrapperPath stringByAppendingPathComponent:PGUserTableFilename];
+    _sessionTablePath = [_wrapperPath stringByAppendingPathComponent:PGSessionTableFilename];
     _diskImagePath = [_wrapperPath stringByAppendingPathComponent:PGEncryptedDiskImageFilename];
-
-    // If the user table or disk image is missing, return an error
-    if (![[NSFileManager defaultManager] fileExistsAtPath:_userTablePath] || ![[NSFileManager defaultManager] fileExistsAtPath:_diskImagePath]) {
+    _bandStorePath = [_wrapperPath stringByAppendingPathComponent:PGBandStoreFilename];
+    _manifestPath = [_wrapperPath stringByAppendingPathComponent:PGManifestFilename];
+    
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSString *legacyUserTablePath = [_wrapperPath stringByAppendingPathComponent:PGLegacyUserTableFilename];
+    
+    // If the user table or the disk image or band store is missing, return an error
+    if (!([fileManager fileExistsAtPath:_userTablePath] || [fileManager fileExistsAtPath:legacyUserTablePath]) || 
+        !([fileManager fileExistsAtPath:_diskImagePath] || [fileManager fileExistsAtPath:_bandStorePath])) {
         if (errorOut) *errorOut = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileNoSuchFileError userInfo:nil];
-        return nil;
+        return NO;
     }
     
-    // Get the user table
-    [self setUserTable:[[NSMutableDictionary alloc] initWithContentsOfFile:_userTablePath]];
-    NSDictionary *userEntry = [_userTable objectForKey:user];
-    if (!userEntry) {
-        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperAuthenticationError userInfoObjectsAndKeys:
-                                   NSLocalizedString(@"Bad user name or password.", nil), NSLocalizedDescriptionKey, nil];
-        return nil;
+    // If the wrapper only has a property list user table, read it without writing anything, so wrappers on read-only media still open. It's
+    // migrated to the binary format when users are first changed. Otherwise, get the user table from the cache, which only maps it again if it
+    // has changed since another wrapper opened it.
+    NSError *error = nil;
+    uint64_t startTime = PGInstrumentationBeginSpan();
+    if (![fileManager fileExistsAtPath:_userTablePath]) {
+        [self setUserTable:[[PGUserTable alloc] initWithContentsOfPropertyListFile:legacyUserTablePath error:&error]];
+    } else {
+        [self setUserTable:[[PGUserTableCache sharedUserTableCache] userTableAtPath:_userTablePath error:&error]];
     }
     
-    // Get the data necessary to decrypt the master password
-    NSData *secret = [userEntry objectForKey:PGSecretUserTableEntryKey];
-    NSData *salt = [userEntry objectForKey:PGSaltUserTableEntryKey];
-    NSNumber *rounds = [userEntry objectForKey:PGRoundsUserTableEntryKey];
-    NSData *iv = [userEntry objectForKey:PGInitializationVectorUserTableEntryKey];
-    if (!(salt && rounds && iv && secret)) {
-        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperMalformedUserTableError userInfo:nil];
-        return nil;
+    _userTableIsShared = YES;
+    PGInstrumentationEndSpan(PGUserTableLoadSpan, startTime);
+    
+    if (!_userTable) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperMalformedUserTableError underlyingError:error];
+        return NO;
     }
+    
+    return YES;
+}
+
+
+- (PGUserTable *)writableUserTable:(NSError **)errorOut
+{
+    // Other wrappers may be reading the shared table, so changes go to a private copy. Once saved, they're in the table's log, and the cache 
+    // notices that the log has changed the next time a wrapper is opened.
+    if (_userTableIsShared) {
+        NSError *error = nil;
+        NSString *legacyUserTablePath = [_wrapperPath stringByAppendingPathComponent:PGLegacyUserTableFilename];
+        BOOL migrated = [[NSFileManager defaultManager] fileExistsAtPath:_userTablePath] || 
+            [PGUserTable migratePropertyListFile:legacyUserTablePath toTableAtPath:_userTablePath error:&error];
         
-    // Attempt to decrypt the master password
-    NSError *error = nil;
-    NSData *masterPasswordData = [secret decryptedDataWithPassword:password salt:salt rounds:rounds initializationVector:iv error:&error];
-    if (!masterPasswordData) {
-        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperAuthenticationError userInfoObjectsAndKeys:
-                                   error, NSUnderlyingErrorKey, NSLocalizedString(@"Bad user name or password.", nil), NSLocalizedDescriptionKey, nil];
-        return nil;
+        PGUserTable *userTable = migrated ? [[PGUserTable alloc] initWithContentsOfFile:_userTablePath error:&error] : nil;
+        if (!userTable) {
+            if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperMalformedUserTableError underlyingError:error];
+            return nil;
+        }
+        
+        [self setUserTable:userTable];
+        _userTableIsShared = NO;
     }
     
-    // If we were unable to determine the master password, something went wrong, so return nil
-    [self setMasterPassword:[[NSString alloc] initWithData:masterPasswordData encoding:NSUTF8StringEncoding]];
-    return _masterPassword ? self : nil;
+    return _userTable;
 }
 
 
+- (NSMutableDictionary *)unexpiredSessionTable
+{
+    NSMutableDictionary *sessionTable = [[NSMutableDictionary alloc] initWithContentsOfFile:_sessionTablePath];
+    if (!sessionTable) return [[NSMutableDictionary alloc] init];
+    
+    long long now = (long long)[[NSDate date] timeIntervalSince1970];
+    NSSet *expiredIdentifiers = [sessionTable keysOfEntriesPassingTest:^BOOL(id identifier, id sessionEntry, BOOL *stop) {
+        return [[sessionEntry objectForKey:PGExpirationSessionTableEntryKey] longLongValue] <= now;
+    }];
+    
+    [sessionTable removeObjectsForKeys:[expiredIdentifiers allObjects]];
+    return sessionTable;
+}
 
-#pragma mark Mounting and Unmounting
 
-- (BOOL)attachAtPath:(NSString *)mountPath error:(NSError **)errorOut
+- (BOOL)changeSessionTableUsingBlock:(void (^)(NSMutableDictionary *))block error:(NSError **)errorOut
 {
-    if ([self isAttached]) return NO;
+    NSAssert(block, @"nil block");
     
     NSError *error = nil;
-    
-    NSDictionary *result = nil; 
-    NSArray *args = [NSArray arrayWithObjects:_diskImagePath, @"-nobrowse", @"-mountpoint", mountPath, nil];
-    if (![[self class] executeHDIUtilTaskWithVerb:PGHDIUtilAttachVerb arguments:args password:_masterPassword result:&result error:&error]) {
-        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperAttachmentError userInfoObjectsAndKeys:error, 
-                                   NSUnderlyingErrorKey, NSLocalizedString(@"Failed to attach disk image.", nil), NSLocalizedDescriptionKey, nil];
+    int fileDescriptor = PGOpenLockedSessionTable(_sessionTablePath, &error);
+    if (fileDescriptor == -1) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperSessionTableWriteFailedError 
+                                    userInfoObjectsAndKeys:NSLocalizedString(@"Failed to lock the session table.", nil), NSLocalizedDescriptionKey, 
+                                   error, NSUnderlyingErrorKey, nil];
         return NO;
     }
     
-    for (NSDictionary *systemEntityDictionary in [result objectForKey:@"system-entities"]) {
-        NSString *entityMountPoint = [systemEntityDictionary objectForKey:@"mount-point"];
-        if (entityMountPoint) {
-            [self setMountPoint:entityMountPoint];
-            break;
-        }
+    // The table is replaced atomically before the lock on the old file is released, so waiting writers always read our changes
+    NSMutableDictionary *sessionTable = [self unexpiredSessionTable];
+    block(sessionTable);
+    BOOL written = [sessionTable writeToFile:_sessionTablePath atomically:YES];
+    close(fileDescriptor);
+    
+    if (!written) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperSessionTableWriteFailedError 
+                                    userInfoObjectsAndKeys:NSLocalizedString(@"Failed to save the session table.", nil), NSLocalizedDescriptionKey, nil];
+        return NO;
     }
     
-    return [self isAttached];
+    return YES;
 }
 
 
-- (NSString *)attachAtRandomSubdirectoryOfPath:(NSString *)mountRoot error:(NSError **)errorOut
++ (NSString *)createTemporaryWrapperWithMasterPassword:(NSString *)masterPassword user:(NSString *)user password:(NSString *)password 
+                                                 error:(NSError **)errorOut
 {
-    if ([self isAttached]) return nil;
-
     NSError *error = nil;
     
-    NSArray *args = [NSArray arrayWithObjects:_diskImagePath, @"-nobrowse", @"-mountrandom", mountRoot, nil];
-    
-    NSDictionary *result = nil; 
-    if (![[self class] executeHDIUtilTaskWithVerb:PGHDIUtilAttachVerb arguments:args password:_masterPassword result:&result error:&error]) {
-        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperAttachmentError userInfoObjectsAndKeys:error, 
-                                   NSUnderlyingErrorKey, NSLocalizedString(@"Failed to attach disk image.", nil), NSLocalizedDescriptionKey, nil];
-        return nil;
-    }
-    
-    for (NSDictionary *systemEntityDictionary in [result objectForKey:@"system-entities"]) {
-        NSString *entityMountPoint = [systemEntityDictionary objectForKey:@"mount-point"];
-        if (entityMountPoint) {
-            [self setMountPoint:entityMountPoint];
-            break;
+    // Create a temp wrapper directory in which to generate our wrapper
+    NSString *tempWrapperPath = [[NSFileManager defaultManager] createTemporaryDirectoryWithTemplate:@"PGEncryptedDiskImageWrapper.XXXXXX" error:&error];
+    if (!tempWrapperPath) {
+        if (errorOut) {
+            *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperCreationError userInfoObjectsAndKeys:error,
+                         NSUnderlyingErrorKey, NSLocalizedString(@"Failed to create the encrypted disk image wrapper directory.", nil),
+                         NSLocalizedDescriptionKey, nil];
         }
+        return nil;
     }
     
-    return _mountPoint;
+    if (![self writeUserTableInWrapperAtPath:tempWrapperPath masterPassword:masterPassword user:user password:password error:errorOut]) return nil;
+    return tempWrapperPath;
 }
 
 
-- (BOOL)detach:(NSError **)errorOut
++ (BOOL)writeUserTableInWrapperAtPath:(NSString *)path masterPassword:(NSString *)masterPassword user:(NSString *)user password:(NSString *)password 
+                                error:(NSError **)errorOut
 {
-    if (![self isAttached]) return NO;
-    
     NSError *error = nil;
-    if (![[self class] executeHDIUtilTaskWithVerb:PGHDIUtilDetachVerb arguments:[NSArray arrayWithObject:_mountPoint] password:nil result:NULL error:&error]) {
-        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperAttachmentError userInfoObjectsAndKeys:error, 
-                                   NSUnderlyingErrorKey, NSLocalizedString(@"Failed to detach disk image.", nil), NSLocalizedDescriptionKey, nil];
+    PGUserTable *userTable = [[PGUserTable alloc] init];
+    [userTable setEntry:[self userTableEntryForMasterPassword:masterPassword user:user password:password] forUser:user];
+    if (![userTable writeToFile:[path stringByAppendingPathComponent:PGUserTableFilename] error:&error]) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperCreationError userInfoObjectsAndKeys:error,
+                                   NSUnderlyingErrorKey, NSLocalizedString(@"Failed to create the encrypted disk image's user table.", nil), 
+                                   NSLocalizedDescriptionKey, nil];
         return NO;
     }
     
-    [self setMountPoint:nil];
-    
     return YES;
 }
 
 
-- (BOOL)isAttached
++ (PGHDIUtilTask *)diskImageCreationTaskForTemporaryWrapperAtPath:(NSString *)temporaryWrapperPath masterPassword:(NSString *)masterPassword
+                                                    volumeOptions:(NSDictionary *)volumeOptions
 {
-    return _mountPoint != nil;
+    NSMutableArray *args = [self hdiutilTaskArgumentsForVolumeOptions:volumeOptions];
+    [args insertObject:[temporaryWrapperPath stringByAppendingPathComponent:PGEncryptedDiskImageFilename] atIndex:0];
+    return [[PGHDIUtilTask alloc] initWithVerb:PGHDIUtilCreateVerb arguments:args password:masterPassword];
 }
 
 
-#pragma mark User Table Management
-
-- (void)setPassword:(NSString *)password forUser:(NSString *)user
++ (BOOL)createBandStoreInTemporaryWrapperAtPath:(NSString *)temporaryWrapperPath masterPassword:(NSString *)masterPassword
+                                  volumeOptions:(NSDictionary *)volumeOptions error:(NSError **)errorOut
 {
-    [_userTable setObject:[[self class] userTableEntryForMasterPassword:_masterPassword user:user password:password] forKey:user];
+    NSNumber *volumeSize = [volumeOptions objectForKey:PGSizeVolumeOption];
+    NSAssert(volumeSize, @"nil volume size");
+    
+    return [PGBandStore createBandStoreAtPath:[temporaryWrapperPath stringByAppendingPathComponent:PGBandStoreFilename] password:masterPassword 
+                                       length:[volumeSize unsignedLongLongValue] * 1024 * 1024 bandSize:PGBandStoreDefaultBandSize 
+                                        error:errorOut] != nil;
 }
 
 
-- (void)removeUser:(NSString *)user
++ (BOOL)changeMasterPasswordOfTemporaryWrapperAtPath:(NSString *)temporaryWrapperPath fromPassword:(NSString *)oldPassword 
+                                          toPassword:(NSString *)newPassword volumeOptions:(NSDictionary *)volumeOptions error:(NSError **)errorOut
 {
-    [_userTable removeObjectForKey:user];
+    NSError *error = nil;
+    BOOL changed = NO;
+    if ([[volumeOptions objectForKey:PGBackendVolumeOption] isEqualToString:PGBandStoreBackend]) {
+        changed = [PGBandStore changePasswordOfBandStoreAtPath:[temporaryWrapperPath stringByAppendingPathComponent:PGBandStoreFilename] 
+                                                  fromPassword:oldPassword toPassword:newPassword error:&error];
+    } else {
+        NSArray *args = [NSArray arrayWithObject:[temporaryWrapperPath stringByAppendingPathComponent:PGEncryptedDiskImageFilename]];
+        PGHDIUtilTask *hdiutil = [[PGHDIUtilTask alloc] initWithVerb:PGHDIUtilChangePasswordVerb arguments:args password:oldPassword 
+                                                         newPassword:newPassword];
+        changed = [hdiutil launchAndWaitWithResult:NULL error:&error];
+    }
+    
+    if (!changed && errorOut) {
+        *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperCreationError userInfoObjectsAndKeys:error, 
+                     NSUnderlyingErrorKey, NSLocalizedString(@"Failed to change the encrypted disk image's master password.", nil), 
+                     NSLocalizedDescriptionKey, nil];
+    }
+    
+    return changed;
 }
 
 
-- (BOOL)saveUserTable
++ (PGEncryptedDiskImageWrapper *)finishCreatingWrapperAtPath:(NSString *)path temporaryWrapperPath:(NSString *)temporaryWrapperPath 
+                                                        user:(NSString *)user password:(NSString *)password 
+                                                storageError:(NSError *)storageError error:(NSError **)errorOut
 {
-    return [_userTable writeToFile:_userTablePath atomically:YES];
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    if (storageError) {
+        [fileManager removeItemAtPath:temporaryWrapperPath error:NULL];
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperCreationError userInfoObjectsAndKeys:storageError,
+                                   NSUnderlyingErrorKey, NSLocalizedString(@"Failed to create the encrypted disk image.", nil), NSLocalizedDescriptionKey, 
+                                   nil];
+        return nil;
+    }
+    
+    // Move the disk image wrapper to URL
+    NSError *error = nil;
+    if (![fileManager moveItemAtPath:temporaryWrapperPath toPath:path error:&error]) {
+        [fileManager removeItemAtPath:temporaryWrapperPath error:NULL];
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperCreationError userInfoObjectsAndKeys: error, 
+                                   NSUnderlyingErrorKey, NSLocalizedString(@"Failed to save the encrypted disk image wrapper.", nil), 
+                                   NSLocalizedDescriptionKey, nil];
+        return nil;
+    }
+    
+    // The move fails rather than replacing anything already at the path, so what's there now is the wrapper we just created
+    PGEncryptedDiskImageWrapper *wrapper = [[self alloc] initWithContentsOfFile:path user:user password:password error:errorOut];
+    if (!wrapper) [fileManager removeItemAtPath:path error:NULL];
+    return wrapper;
 }
 
 
-#pragma mark Private Methods
+- (PGHDIUtilTask *)attachTaskWithArguments:(NSArray *)arguments
+{
+    NSMutableArray *args = [NSMutableArray arrayWithObjects:_diskImagePath, @"-nobrowse", nil];
+    [args addObjectsFromArray:arguments];
+    return [[PGHDIUtilTask alloc] initWithVerb:PGHDIUtilAttachVerb arguments:args password:_masterPassword];
+}
 
 
-+ (BOOL)executeHDIUtilTaskWithVerb:(PGHDIUtilVerb)verb arguments:(NSArray *)arguments password:(NSString *)masterPassword 
-                            result:(NSDictionary **)resultOut error:(NSError **)errorOut
+- (NSString *)finishAttachingWithResult:(NSDictionary *)result hdiutilError:(NSError *)hdiutilError error:(NSError **)errorOut
 {
-    NSAssert(verb == PGHDIUtilCreateVerb || verb == PGHDIUtilAttachVerb || verb == PGHDIUtilDetachVerb, @"Invalid verb %lu", verb);
-    NSAssert(verb == PGHDIUtilDetachVerb || masterPassword, @"Master password required for verb (%lu)", verb);
-    
-    NSTask *hdiutil = [[NSTask alloc] init];
-    [hdiutil setLaunchPath:@"/usr/bin/hdiutil"];
-    [hdiutil setStandardInput:[NSPipe pipe]];
-    [hdiutil setStandardOutput:[NSPipe pipe]];
-    [hdiutil setStandardError:[NSPipe pipe]];
-
-    NSMutableArray *args = [NSMutableArray arrayWithArray:arguments];
+    if (hdiutilError) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperAttachmentError userInfoObjectsAndKeys:hdiutilError, 
+                                   NSUnderlyingErrorKey, NSLocalizedString(@"Failed to attach disk image.", nil), NSLocalizedDescriptionKey, nil];
+        return nil;
+    }
     
-    if (verb == PGHDIUtilDetachVerb) {
-        [args insertObject:@"detach" atIndex:0];
-    } else {
-        [args insertObject:(verb == PGHDIUtilAttachVerb ? @"attach" : @"create") atIndex:0];
-        [args addObject:@"-plist"];
-        [args addObject:@"-stdinpass"];
-        
-        // Convert the password to a C string so that it's null-terminated
-        const char *passwordCString = [masterPassword cStringUsingEncoding:NSUTF8StringEncoding];
-        
-        // Write everything to stdin before we even launch
-        [[[hdiutil standardInput] fileHandleForWriting] writeData:[NSData dataWithBytes:passwordCString length:[masterPassword length] + 1]];
+    for (NSDictionary *systemEntityDictionary in [result objectForKey:@"system-entities"]) {
+        NSString *entityMountPoint = [systemEntityDictionary objectForKey:@"mount-point"];
+        if (entityMountPoint) {
+            [self setMountPoint:entityMountPoint];
+            break;
+        }
     }
+    
+    return _mountPoint;
+}
 
-    // Let the app finish executing, then read from its standard input and error pipes
-    [hdiutil setArguments:args];
-    [hdiutil launch];
-    [hdiutil waitUntilExit];
 
-    if ([hdiutil terminationStatus] != 0) {
-        NSData *stderrData = [[[hdiutil standardError] fileHandleForReading] readDataToEndOfFile];
-        
-        if (errorOut) {
-            NSString *stderrString = [[NSString alloc] initWithData:stderrData encoding:NSUTF8StringEncoding];
-            *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperAuthenticationError userInfoObjectsAndKeys:
-                         stderrString, PGTaskStandardErrorKey, NSLocalizedString(@"Error executing hdiutil", nil), NSLocalizedDescriptionKey, nil];
-        }
+- (BOOL)finishDetachingWithHDIUtilError:(NSError *)hdiutilError error:(NSError **)errorOut
+{
+    if (hdiutilError) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperAttachmentError userInfoObjectsAndKeys:hdiutilError, 
+                                   NSUnderlyingErrorKey, NSLocalizedString(@"Failed to detach disk image.", nil), NSLocalizedDescriptionKey, nil];
         return NO;
     }
+    
+    [self setMountPoint:nil];
+    
+    return YES;
+}
 
-    if (verb != PGHDIUtilDetachVerb && resultOut) {
-        NSData *hdiutilStandardOutputData = [[[hdiutil standardOutput] fileHandleForReading] readDataToEndOfFile];
-        *resultOut = [NSPropertyListSerialization propertyListWithData:hdiutilStandardOutputData options:NSPropertyListImmutable format:NULL error:errorOut];
-    }
 
-    return YES;
++ (NSData *)sessionVerifierForIdentifier:(NSString *)identifier user:(NSString *)user userSalt:(NSData *)userSalt expiration:(NSNumber *)expiration 
+                              sessionKey:(NSData *)sessionKey
+{
+    NSString *message = [NSString stringWithFormat:@"%@\n%@\n%lld\n", identifier, user, [expiration longLongValue]];
+    NSMutableData *messageData = [[message dataUsingEncoding:NSUTF8StringEncoding] mutableCopy];
+    [messageData appendData:userSalt];
+    return [messageData HMACSHA256DigestWithKey:sessionKey];
 }
 
 
@@ -459,20 +1513,59 @@ static NSString *const PGUserTableFilename = @"UserTable.plist";
 
 
 + (NSDictionary *)userTableEntryForMasterPassword:(NSString *)masterPassword user:(NSString *)user password:(NSString *)password
+{
+    return [self userTableEntryForMasterPassword:masterPassword user:user password:password 
+                         keyDerivationParameters:[self userTableKeyDerivationParameters] error:NULL];
+}
+
+
++ (NSDictionary *)userTableEntryForMasterPassword:(NSString *)masterPassword user:(NSString *)user password:(NSString *)password 
+                          keyDerivationParameters:(PGKeyDerivationParameters)parameters error:(NSError **)errorOut
 {
     NSAssert(masterPassword, @"nil master password");
     NSAssert(user, @"nil user");
     NSAssert(password, @"nil user");
     
     NSData *salt = nil;
-    NSNumber *rounds = nil;
     NSData *iv = nil;
     NSData *masterPasswordData = [masterPassword dataUsingEncoding:NSUTF8StringEncoding];
-    NSData *secret = [masterPasswordData encryptedDataWithPassword:password salt:&salt rounds:&rounds initializationVector:&iv error:NULL];
+    PGEncryptionAlgorithm algorithm = PGSecretEncryptionAlgorithm();
+    NSData *secret = [masterPasswordData encryptedDataWithPassword:password algorithm:algorithm 
+                                                    associatedData:[self associatedDataForSecretOfEntryNamed:user algorithm:algorithm]
+                                           keyDerivationParameters:&parameters salt:&salt initializationVector:&iv error:errorOut];
+    if (!secret) return nil;
+    
+    NSMutableDictionary *entry = [NSMutableDictionary dictionaryWithObjectsAndKeys:user, PGUserUserTableEntryKey, salt, PGSaltUserTableEntryKey, 
+                                  [NSNumber numberWithUnsignedInt:parameters.rounds], PGRoundsUserTableEntryKey, 
+                                  iv, PGInitializationVectorUserTableEntryKey, secret, PGSecretUserTableEntryKey, 
+                                  [NSNumber numberWithUnsignedInt:algorithm], PGAlgorithmUserTableEntryKey, nil];
+    
+    // PBKDF2 entries are left exactly as earlier versions wrote them
+    if (parameters.algorithm != PGPBKDF2KeyDerivationAlgorithm) {
+        [entry setObject:[NSNumber numberWithUnsignedInt:parameters.algorithm] forKey:PGKeyDerivationUserTableEntryKey];
+        [entry setObject:[NSNumber numberWithUnsignedInt:parameters.blockSize] forKey:PGBlockSizeUserTableEntryKey];
+        [entry setObject:[NSNumber numberWithUnsignedInt:parameters.lanes] forKey:PGLanesUserTableEntryKey];
+    }
+    
+    return entry;
+}
+
+
++ (PGKeyDerivationParameters)userTableKeyDerivationParameters
+{
+    PGKeyDerivationParameters parameters = { PGPBKDF2KeyDerivationAlgorithm, 0, 0, 0 };
+    @synchronized ([PGEncryptedDiskImageWrapper class]) {
+        parameters.algorithm = PGUserTableKeyDerivationAlgorithm;
+        parameters.lanes = (uint32_t)PGUserTableKeyDerivationLanes;
+    }
     
-    return [NSDictionary dictionaryWithObjectsAndKeys:user, PGUserUserTableEntryKey, salt, PGSaltUserTableEntryKey, 
-            rounds, PGRoundsUserTableEntryKey, iv, PGInitializationVectorUserTableEntryKey,
-            secret, PGSecretUserTableEntryKey, nil];
+    return parameters;
+}
+
+
++ (NSData *)associatedDataForSecretOfEntryNamed:(NSString *)name algorithm:(PGEncryptionAlgorithm)algorithm
+{
+    return algorithm == PGAES256GCMEncryptionAlgorithm ? [name dataUsingEncoding:NSUTF8StringEncoding] : nil;
 }
 
 @end
@@ -29,6 +29,8 @@
 extern NSString *const PGErrorDomain;
 
 extern NSString *const PGTaskStandardErrorKey;
+extern NSString *const PGUserErrorsKey;
+extern NSString *const PGMismatchedPathsKey;
 
 enum {
     // hdiutil-related errors
@@ -42,4 +44,31 @@ enum {
     // User table errors
     PGEncryptedDiskImageWrapperMalformedUserTableError,
     PGEncryptedDiskImageWrapperUserTableWriteFailedError,
+    
+    // Session table errors
+    PGEncryptedDiskImageWrapperSessionTableWriteFailedError,
+    
+    // Task errors
+    PGEncryptedDiskImageWrapperTaskTimedOutError,
+    PGEncryptedDiskImageWrapperTaskCancelledError,
+    PGEncryptedDiskImageWrapperTaskFailedError,
+    
+    // Band store errors
+    PGEncryptedDiskImageWrapperMalformedBandStoreError,
+    
+    // User provisioning errors
+    PGEncryptedDiskImageWrapperInvalidUserEntryError,
+    PGEncryptedDiskImageWrapperUserProvisioningFailedError,
+    
+    // Manifest errors
+    PGEncryptedDiskImageWrapperMalformedManifestError,
+    PGEncryptedDiskImageWrapperManifestMismatchError,
+    
+    // Archive errors
+    PGEncryptedDiskImageWrapperMalformedArchiveError,
+    PGEncryptedDiskImageWrapperArchiveBaseMismatchError,
+    
+    // Authentication service errors
+    PGEncryptedDiskImageWrapperAuthenticationOverloadedError,
+    PGEncryptedDiskImageWrapperAuthenticationDeadlineExceededError,
 }; 
@@ -29,3 +29,5 @@
 NSString *const PGErrorDomain = @"com.quantumlenscap.PGErrorDomain";
 
 NSString *const PGTaskStandardErrorKey = @"PGTaskStandardError";
+NSString *const PGUserErrorsKey = @"PGUserErrors";
+NSString *const PGMismatchedPathsKey = @"PGMismatchedPaths";
@@ -0,0 +1,154 @@
+//
+//  PGHDIUtilTask.h
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+/*! 
+ @abstract Constants for indicating what verb hdiutil should perfom. 
+ @discussion These constants are only used to initialize PGHDIUtilTask instances.
+ */
+typedef NS_ENUM(NSUInteger, PGHDIUtilVerb) {
+    /*! @abstract The create verb, which instructs hdiutil to creates a disk image. */
+    PGHDIUtilCreateVerb = 1,
+    
+    /*! @abstract The attach verb, which instructs hdiutil to attach a disk image and mount its volumes. */
+    PGHDIUtilAttachVerb,
+    
+    /*! @abstract The detach verb, which instructs hdiutil to unmount a disk image's volumes and detach it. */
+    PGHDIUtilDetachVerb,
+    
+    /*! @abstract The chpass verb, which instructs hdiutil to change the password of an encrypted disk image. */
+    PGHDIUtilChangePasswordVerb
+};
+
+
+/*!
+ @abstract PGHDIUtilTask instances execute hdiutil asynchronously.
+ @discussion The arguments specified should not contain the verb string, i.e., "create", "attach", or "detach", as these will automatically be added 
+     to the argument list based on the verb specified. In addition, for the PGHDIUtilCreateVerb and PGHDIUtilAttachVerb verbs, "-plist" and 
+     "-stdinpass" will automatically be added to the argument list. As one might expect, in these cases the specified password is passed to hdiutil 
+     via its standard input pipe, and hdiutil's output is parsed as a property list and passed to the completion handler. For the
+     PGHDIUtilChangePasswordVerb verb, "-oldstdinpass" and "-newstdinpass" are added instead, and the old and new passwords are passed via 
+     standard input in that order.
+ 
+     hdiutil's standard output and standard error are drained as the task runs, so its output may be arbitrarily large. Tasks may be given a 
+     timeout and may be cancelled at any time. In either case, hdiutil is terminated and the completion handler receives an appropriate error. If 
+     hdiutil can't be launched or exits with a nonzero status, the error's code is PGEncryptedDiskImageWrapperTaskFailedError.
+ 
+     Tasks execute the program at +defaultLaunchPath unless they are given a different launch path. Tests use this to run a stub that plays back 
+     canned hdiutil output on systems without hdiutil.
+ 
+     A task may only be launched once. Tasks keep themselves alive until they finish.
+ */
+@interface PGHDIUtilTask : NSObject
+
+/*! @abstract The verb that hdiutil should perform. */
+@property(readonly) PGHDIUtilVerb verb;
+
+/*! @abstract The arguments to be passed to hdiutil, excluding the verb, "-stdinpass", and "-plist". */
+@property(readonly, copy) NSArray *arguments;
+
+/*! @abstract The path of the program the task executes. Defaults to the value of +defaultLaunchPath when the task is initialized. */
+@property(readwrite, copy) NSString *launchPath;
+
+/*! @abstract The number of seconds after launch at which the task is terminated if it hasn't finished. If 0, the default, there is no timeout. */
+@property(readwrite) NSTimeInterval timeout;
+
+/*!
+ @abstract Returns the launch path with which new tasks are initialized.
+ @return The default launch path. Initially, this is /usr/bin/hdiutil.
+ */
++ (NSString *)defaultLaunchPath;
+
+/*!
+ @abstract Sets the launch path with which new tasks are initialized.
+ @param launchPath The new default launch path. If nil, the default is reset to /usr/bin/hdiutil.
+ */
++ (void)setDefaultLaunchPath:(NSString *)launchPath;
+
+/*!
+ @abstract Initializes a newly allocated hdiutil task with the specified verb, arguments, and password.
+ @discussion The verb may not be PGHDIUtilChangePasswordVerb, which requires a new password.
+ 
+ @param verb The verb that hdiutil should perform.
+ @param arguments The arguments to be passed to hdiutil, excluding the verb, "-stdinpass", and "-plist". May not be nil.
+ @param password The password to pass to hdiutil. May only be nil if the verb is PGHDIUtilDetachVerb.
+ 
+ @return An initialized hdiutil task.
+ */
+- (id)initWithVerb:(PGHDIUtilVerb)verb arguments:(NSArray *)arguments password:(NSString *)password;
+
+/*!
+ @abstract Initializes a newly allocated hdiutil task with the specified verb, arguments, password, and new password.
+ @discussion This is the designated initializer.
+ 
+ @param verb The verb that hdiutil should perform.
+ @param arguments The arguments to be passed to hdiutil, excluding the verb and the arguments added for it. May not be nil.
+ @param password The password to pass to hdiutil. For PGHDIUtilChangePasswordVerb, this is the disk image's current password. May only be nil 
+     if the verb is PGHDIUtilDetachVerb.
+ @param newPassword The password to which to change the disk image's password. Must be nil unless the verb is PGHDIUtilChangePasswordVerb, in 
+     which case it may not be nil.
+ 
+ @return An initialized hdiutil task.
+ */
+- (id)initWithVerb:(PGHDIUtilVerb)verb arguments:(NSArray *)arguments password:(NSString *)password newPassword:(NSString *)newPassword;
+
+/*!
+ @abstract Launches hdiutil and returns immediately.
+ @discussion The completion handler is invoked on an arbitrary queue once hdiutil has exited and its output has been read. 
+ 
+ @param handler The block to invoke when the task finishes. If the task succeeded, error is nil and result is hdiutil's output as a property list, 
+     or nil if the verb is PGHDIUtilDetachVerb or PGHDIUtilChangePasswordVerb. Otherwise, result is nil and error describes the failure. May not be nil.
+ */
+- (void)launchWithCompletionHandler:(void (^)(NSDictionary *result, NSError *error))handler;
+
+/*!
+ @abstract Launches hdiutil and waits for it to finish.
+ 
+ @param resultOut On input, a pointer to an NSDictionary object. Upon successful completion, points the hdiutil's output as a dictionary object. You 
+     may specify NULL for this parameter if you do not want the result dictionary.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return A boolean indicating whether the task completed executing successfully. 
+ */
+- (BOOL)launchAndWaitWithResult:(NSDictionary **)resultOut error:(NSError **)errorOut;
+
+/*!
+ @abstract Cancels the task.
+ @discussion If the task is running, hdiutil is terminated. If it hasn't been launched yet, it finishes as soon as it is. Either way, the completion
+     handler receives a PGEncryptedDiskImageWrapperTaskCancelledError error. If an attach task is cancelled after hdiutil has attached the image 
+     but before the task has finished, the image is detached before the completion handler is invoked. Cancelling a finished task has no effect.
+ */
+- (void)cancel;
+
+/*!
+ @abstract Returns whether the task has been cancelled.
+ @return Whether -cancel has been invoked on the task.
+ */
+- (BOOL)isCancelled;
+
+@end
@@ -0,0 +1,435 @@
+//
+//  PGHDIUtilTask.m
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGHDIUtilTask.h"
+
+#import <unistd.h>
+
+#import "NSError+ConvenienceInitializers.h"
+#import "PGErrors.h"
+#import "PGInstrumentation.h"
+
+
+#pragma mark Constants
+
+/*! @abstract The path of hdiutil, which is the default launch path unless it's changed with +setDefaultLaunchPath:. */
+static NSString *const PGHDIUtilLaunchPath = @"/usr/bin/hdiutil";
+
+/*! @abstract The size of the buffer used to read hdiutil's output. */
+static const size_t PGHDIUtilTaskReadBufferSize = 64 * 1024;
+
+/*! @abstract The launch path with which new tasks are initialized. Access is serialized on the PGHDIUtilTask class. */
+static NSString *PGHDIUtilDefaultLaunchPath = nil;
+
+
+/*!
+ @abstract Returns the name of the instrumentation span for running a task with the specified verb.
+ @param verb The task's verb.
+ @return One of PGHDIUtilCreateSpan, PGHDIUtilAttachSpan, PGHDIUtilDetachSpan, or PGHDIUtilChangePasswordSpan.
+ */
+static NSString *PGHDIUtilSpanForVerb(PGHDIUtilVerb verb)
+{
+    switch (verb) {
+        case PGHDIUtilCreateVerb:
+            return PGHDIUtilCreateSpan;
+        case PGHDIUtilAttachVerb:
+            return PGHDIUtilAttachSpan;
+        case PGHDIUtilChangePasswordVerb:
+            return PGHDIUtilChangePasswordSpan;
+        default:
+            return PGHDIUtilDetachSpan;
+    }
+}
+
+
+#pragma mark - Private Methods Interface
+
+@interface PGHDIUtilTask ()
+
+/*!
+ @abstract Returns the full argument list for hdiutil, including the verb and any arguments added for it.
+ @return The arguments with which to launch hdiutil.
+ */
+- (NSArray *)taskArguments;
+
+/*!
+ @abstract Creates and resumes a dispatch source that reads the specified file handle into the specified data until end-of-file.
+ @discussion The group is entered before the source is resumed and left when it reaches end-of-file. Must be invoked on the receiver's queue.
+ 
+ @param fileHandle The file handle to read. May not be nil.
+ @param data The data to which to append what's read. May not be nil.
+ @param group The dispatch group that tracks the task's completion. May not be NULL.
+ 
+ @return The dispatch source, which the caller must release.
+ */
+- (dispatch_source_t)drainFileHandle:(NSFileHandle *)fileHandle intoData:(NSMutableData *)data group:(dispatch_group_t)group;
+
+/*!
+ @abstract Returns the result or error with which the task finished.
+ @discussion Must be invoked on the receiver's queue after hdiutil has exited and its output has been read.
+ 
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. May not be NULL.
+ 
+ @return hdiutil's output as a property list, or nil if the verb is PGHDIUtilDetachVerb or PGHDIUtilChangePasswordVerb or an error occurred.
+ */
+- (NSDictionary *)resultWithError:(NSError **)errorOut;
+
+/*!
+ @abstract Detaches the image that an attach task attached before it was cancelled, then invokes the specified handler.
+ @discussion Must be invoked on the receiver's queue after hdiutil has exited successfully and its output has been read.
+ @param handler The block to invoke once the image has been detached, whether or not detaching succeeded. May not be nil.
+ */
+- (void)detachCancelledAttachmentWithCompletionHandler:(void (^)(void))handler;
+
+/*!
+ @abstract Returns an error with the specified code and description for a task that didn't finish on its own.
+ @param code The error code.
+ @param description The localized description of the error.
+ @return The error.
+ */
++ (NSError *)errorWithCode:(NSInteger)code description:(NSString *)description;
+
+@end
+
+
+#pragma mark - Implementation
+
+@implementation PGHDIUtilTask {
+    NSString *_password;
+    NSString *_newPassword;
+    
+    // All state below is only accessed on _queue
+    dispatch_queue_t _queue;
+    NSTask *_task;
+    NSMutableData *_standardOutputData;
+    NSMutableData *_standardErrorData;
+    BOOL _launched;
+    BOOL _finished;
+    BOOL _timedOut;
+    BOOL _cancelled;
+}
+
+
++ (NSString *)defaultLaunchPath
+{
+    @synchronized(self) {
+        return PGHDIUtilDefaultLaunchPath ? PGHDIUtilDefaultLaunchPath : PGHDIUtilLaunchPath;
+    }
+}
+
+
++ (void)setDefaultLaunchPath:(NSString *)launchPath
+{
+    @synchronized(self) {
+        PGHDIUtilDefaultLaunchPath = [launchPath copy];
+    }
+}
+
+
+// There’s no meaningful default values for our designated initializer, so we just don't recognize the -init message.
+- (id)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    return nil;
+}
+
+
+- (id)initWithVerb:(PGHDIUtilVerb)verb arguments:(NSArray *)arguments password:(NSString *)password
+{
+    return [self initWithVerb:verb arguments:arguments password:password newPassword:nil];
+}
+
+
+- (id)initWithVerb:(PGHDIUtilVerb)verb arguments:(NSArray *)arguments password:(NSString *)password newPassword:(NSString *)newPassword
+{
+    NSAssert(verb == PGHDIUtilCreateVerb || verb == PGHDIUtilAttachVerb || verb == PGHDIUtilDetachVerb || verb == PGHDIUtilChangePasswordVerb, 
+             @"Invalid verb %lu", verb);
+    NSAssert(arguments, @"nil arguments");
+    NSAssert(verb == PGHDIUtilDetachVerb || password, @"Master password required for verb (%lu)", verb);
+    NSAssert((verb == PGHDIUtilChangePasswordVerb) == (newPassword != nil), @"New password required for chpass and only for chpass");
+    
+    if (!(self = [super init])) return nil;
+    
+    _verb = verb;
+    _arguments = [arguments copy];
+    _password = [password copy];
+    _newPassword = [newPassword copy];
+    _launchPath = [[[self class] defaultLaunchPath] copy];
+    _queue = dispatch_queue_create("com.quantumlenscap.PGHDIUtilTask", DISPATCH_QUEUE_SERIAL);
+    _standardOutputData = [[NSMutableData alloc] init];
+    _standardErrorData = [[NSMutableData alloc] init];
+    
+    return self;
+}
+
+
+- (void)dealloc
+{
+    dispatch_release(_queue);
+}
+
+
+#pragma mark Launching
+
+- (void)launchWithCompletionHandler:(void (^)(NSDictionary *, NSError *))handler
+{
+    NSAssert(handler, @"nil handler");
+    
+    dispatch_async(_queue, ^{
+        NSAssert(!_launched, @"Task launched more than once");
+        _launched = YES;
+        
+        if (_cancelled) {
+            _finished = YES;
+            handler(nil, [[self class] errorWithCode:PGEncryptedDiskImageWrapperTaskCancelledError 
+                                         description:NSLocalizedString(@"hdiutil was cancelled.", nil)]);
+            return;
+        }
+        
+        // NSTask raises an exception rather than failing gracefully if it can't launch the program
+        if (![[NSFileManager defaultManager] isExecutableFileAtPath:_launchPath]) {
+            _finished = YES;
+            handler(nil, [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperTaskFailedError userInfoObjectsAndKeys:
+                          [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOENT userInfo:nil], NSUnderlyingErrorKey, 
+                          NSLocalizedString(@"Error executing hdiutil", nil), NSLocalizedDescriptionKey, nil]);
+            return;
+        }
+        
+        _task = [[NSTask alloc] init];
+        [_task setLaunchPath:_launchPath];
+        [_task setArguments:[self taskArguments]];
+        [_task setStandardInput:[NSPipe pipe]];
+        [_task setStandardOutput:[NSPipe pipe]];
+        [_task setStandardError:[NSPipe pipe]];
+        
+        // Write the null-terminated password to stdin before we even launch, then close it so hdiutil sees end-of-file. chpass reads the new 
+        // password right after the old one.
+        NSFileHandle *standardInput = [[_task standardInput] fileHandleForWriting];
+        for (NSString *password in [NSArray arrayWithObjects:_password, _newPassword, nil]) {
+            const char *passwordCString = [password cStringUsingEncoding:NSUTF8StringEncoding];
+            [standardInput writeData:[NSData dataWithBytes:passwordCString length:strlen(passwordCString) + 1]];
+        }
+        
+        [standardInput closeFile];
+        
+        // The task is finished once it has exited and both of its output pipes have reached end-of-file. Draining the pipes while the task
+        // runs keeps hdiutil from blocking when its output fills a pipe's buffer.
+        dispatch_group_t group = dispatch_group_create();
+        dispatch_group_enter(group);
+        [_task setTerminationHandler:^(NSTask *task) {
+            dispatch_group_leave(group);
+        }];
+        
+        dispatch_source_t standardOutputSource = [self drainFileHandle:[[_task standardOutput] fileHandleForReading] intoData:_standardOutputData 
+                                                                 group:group];
+        dispatch_source_t standardErrorSource = [self drainFileHandle:[[_task standardError] fileHandleForReading] intoData:_standardErrorData
+                                                                group:group];
+        uint64_t startTime = PGInstrumentationBeginSpan();
+        [_task launch];
+        PGInstrumentationEndSpan(PGHDIUtilSpawnSpan, startTime);
+        
+        if (_timeout > 0) {
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(_timeout * NSEC_PER_SEC)), _queue, ^{
+                if (_finished || _cancelled) return;
+                _timedOut = YES;
+                [_task terminate];
+            });
+        }
+        
+        dispatch_group_notify(group, _queue, ^{
+            _finished = YES;
+            dispatch_release(standardOutputSource);
+            dispatch_release(standardErrorSource);
+            
+            NSError *error = nil;
+            NSDictionary *result = [self resultWithError:&error];
+            PGInstrumentationEndSpan(PGHDIUtilSpanForVerb(_verb), startTime);
+            if (error) PGInstrumentationIncrementCounter(PGHDIUtilFailureCounter);
+            
+            // A cancel that arrives after hdiutil attached the image but before we got here reports cancellation, so the image can't be 
+            // left mounted behind the caller's back
+            if (_cancelled && _verb == PGHDIUtilAttachVerb && !_timedOut && [_task terminationStatus] == 0) {
+                [self detachCancelledAttachmentWithCompletionHandler:^{
+                    handler(nil, error);
+                }];
+                return;
+            }
+            
+            handler(result, error);
+        });
+        
+        dispatch_release(group);
+    });
+}
+
+
+- (BOOL)launchAndWaitWithResult:(NSDictionary **)resultOut error:(NSError **)errorOut
+{
+    __block NSDictionary *result = nil;
+    __block NSError *error = nil;
+    
+    dispatch_semaphore_t finishedSemaphore = dispatch_semaphore_create(0);
+    [self launchWithCompletionHandler:^(NSDictionary *taskResult, NSError *taskError) {
+        result = taskResult;
+        error = taskError;
+        dispatch_semaphore_signal(finishedSemaphore);
+    }];
+    
+    dispatch_semaphore_wait(finishedSemaphore, DISPATCH_TIME_FOREVER);
+    dispatch_release(finishedSemaphore);
+    
+    if (error) {
+        if (errorOut) *errorOut = error;
+        return NO;
+    }
+    
+    if (resultOut) *resultOut = result;
+    return YES;
+}
+
+
+- (void)cancel
+{
+    dispatch_async(_queue, ^{
+        if (_finished) return;
+        _cancelled = YES;
+        if (_launched) [_task terminate];
+    });
+}
+
+
+- (BOOL)isCancelled
+{
+    __block BOOL cancelled = NO;
+    dispatch_sync(_queue, ^{
+        cancelled = _cancelled;
+    });
+    
+    return cancelled;
+}
+
+
+#pragma mark Private Methods
+
+- (NSArray *)taskArguments
+{
+    NSMutableArray *args = [NSMutableArray arrayWithArray:_arguments];
+    
+    if (_verb == PGHDIUtilDetachVerb) {
+        [args insertObject:@"detach" atIndex:0];
+    } else if (_verb == PGHDIUtilChangePasswordVerb) {
+        [args insertObject:@"chpass" atIndex:0];
+        [args addObject:@"-oldstdinpass"];
+        [args addObject:@"-newstdinpass"];
+    } else {
+        [args insertObject:(_verb == PGHDIUtilAttachVerb ? @"attach" : @"create") atIndex:0];
+        [args addObject:@"-plist"];
+        [args addObject:@"-stdinpass"];
+    }
+    
+    return args;
+}
+
+
+- (dispatch_source_t)drainFileHandle:(NSFileHandle *)fileHandle intoData:(NSMutableData *)data group:(dispatch_group_t)group
+{
+    int fileDescriptor = [fileHandle fileDescriptor];
+    dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, fileDescriptor, 0, _queue);
+    
+    dispatch_group_enter(group);
+    dispatch_source_set_event_handler(source, ^{
+        uint8_t buffer[PGHDIUtilTaskReadBufferSize];
+        ssize_t readLength = read(fileDescriptor, buffer, sizeof(buffer));
+        if (readLength > 0) {
+            [data appendBytes:buffer length:readLength];
+        } else if (readLength == 0 || errno != EINTR) {
+            dispatch_source_cancel(source);
+        }
+    });
+    
+    // Capturing the file handle keeps its file descriptor open until the source is done with it
+    dispatch_source_set_cancel_handler(source, ^{
+        [fileHandle closeFile];
+        dispatch_group_leave(group);
+    });
+    
+    dispatch_resume(source);
+    return source;
+}
+
+
+- (NSDictionary *)resultWithError:(NSError **)errorOut
+{
+    if (_cancelled) {
+        *errorOut = [[self class] errorWithCode:PGEncryptedDiskImageWrapperTaskCancelledError description:NSLocalizedString(@"hdiutil was cancelled.", nil)];
+        return nil;
+    } else if (_timedOut) {
+        *errorOut = [[self class] errorWithCode:PGEncryptedDiskImageWrapperTaskTimedOutError description:NSLocalizedString(@"hdiutil timed out.", nil)];
+        return nil;
+    }
+    
+    if ([_task terminationStatus] != 0) {
+        NSString *stderrString = [[NSString alloc] initWithData:_standardErrorData encoding:NSUTF8StringEncoding];
+        *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperTaskFailedError userInfoObjectsAndKeys:
+                     stderrString, PGTaskStandardErrorKey, NSLocalizedString(@"Error executing hdiutil", nil), NSLocalizedDescriptionKey, nil];
+        return nil;
+    }
+    
+    if (_verb == PGHDIUtilDetachVerb || _verb == PGHDIUtilChangePasswordVerb) return nil;
+    return [NSPropertyListSerialization propertyListWithData:_standardOutputData options:NSPropertyListImmutable format:NULL error:errorOut];
+}
+
+
+- (void)detachCancelledAttachmentWithCompletionHandler:(void (^)(void))handler
+{
+    NSDictionary *result = [NSPropertyListSerialization propertyListWithData:_standardOutputData options:NSPropertyListImmutable format:NULL 
+                                                                        error:NULL];
+    NSString *mountPoint = nil;
+    for (NSDictionary *systemEntityDictionary in [result objectForKey:@"system-entities"]) {
+        mountPoint = [systemEntityDictionary objectForKey:@"mount-point"];
+        if (mountPoint) break;
+    }
+    
+    if (!mountPoint) {
+        handler();
+        return;
+    }
+    
+    PGHDIUtilTask *detachTask = [[PGHDIUtilTask alloc] initWithVerb:PGHDIUtilDetachVerb arguments:[NSArray arrayWithObject:mountPoint] password:nil];
+    [detachTask setLaunchPath:_launchPath];
+    [detachTask launchWithCompletionHandler:^(NSDictionary *detachResult, NSError *detachError) {
+        handler();
+    }];
+}
+
+
++ (NSError *)errorWithCode:(NSInteger)code description:(NSString *)description
+{
+    return [NSError errorWithDomain:PGErrorDomain code:code userInfoObjectsAndKeys:description, NSLocalizedDescriptionKey, nil];
+}
+
+@end
@@ -0,0 +1,211 @@
+//
+//  PGInstrumentation.h
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+#pragma mark Span and Counter Names
+
+/*! @abstract The span for mapping a wrapper's user table. */
+extern NSString *const PGUserTableLoadSpan;
+
+/*! @abstract The span for calibrating the number of key derivation rounds for a password. */
+extern NSString *const PGKeyCalibrationSpan;
+
+/*! @abstract The span for deriving a symmetric key from a password. */
+extern NSString *const PGKeyDerivationSpan;
+
+/*! @abstract The span for encrypting or decrypting data in one shot with a symmetric key. */
+extern NSString *const PGCryptSpan;
+
+/*! @abstract The span for decrypting a user's copy of the master password when a wrapper is opened. */
+extern NSString *const PGAuthenticationSpan;
+
+/*! @abstract The span for which a request waits in an authentication service's queue before a worker starts it. */
+extern NSString *const PGAuthenticationQueueWaitSpan;
+
+/*! @abstract The span for spawning an hdiutil process. */
+extern NSString *const PGHDIUtilSpawnSpan;
+
+/*! @abstract The spans for running an hdiutil task to completion, from launch until its output has been read, by verb. */
+extern NSString *const PGHDIUtilCreateSpan;
+extern NSString *const PGHDIUtilAttachSpan;
+extern NSString *const PGHDIUtilDetachSpan;
+extern NSString *const PGHDIUtilChangePasswordSpan;
+
+/*! @abstract The counter for failed attempts to open a wrapper with a user name and password. */
+extern NSString *const PGAuthenticationFailureCounter;
+
+/*! @abstract The counter for authentication requests that an authentication service rejected because its queue was full. */
+extern NSString *const PGAuthenticationShedCounter;
+
+/*! @abstract The counter for hdiutil tasks that finished with an error. */
+extern NSString *const PGHDIUtilFailureCounter;
+
+
+#pragma mark - Statistic Keys
+
+/*! @abstract The number of times a span was recorded, as an NSNumber. */
+extern NSString *const PGSpanCountStatisticKey;
+
+/*! @abstract The total, minimum, maximum, and mean durations of a span in nanoseconds, as NSNumbers. */
+extern NSString *const PGSpanTotalStatisticKey;
+extern NSString *const PGSpanMinimumStatisticKey;
+extern NSString *const PGSpanMaximumStatisticKey;
+extern NSString *const PGSpanMeanStatisticKey;
+
+/*!
+ @abstract The 50th, 90th, and 99th percentile durations of a span in nanoseconds, as NSNumbers.
+ @discussion Percentiles are computed from a histogram with four buckets per power of two, so they are within 25% of the exact value.
+ */
+extern NSString *const PGSpan50thPercentileStatisticKey;
+extern NSString *const PGSpan90thPercentileStatisticKey;
+extern NSString *const PGSpan99thPercentileStatisticKey;
+
+
+#pragma mark - Recording
+
+/*!
+ @abstract Returns the start time of a span, or 0 if instrumentation is disabled.
+ @discussion Start times come from a monotonic clock. Pass the result to PGInstrumentationEndSpan() when the span ends. When instrumentation is
+     disabled, this only reads a flag.
+ @return The start time of the span, or 0 if instrumentation is disabled.
+ */
+extern uint64_t PGInstrumentationBeginSpan(void);
+
+/*!
+ @abstract Records a span that started at the specified time and ends now.
+ @discussion Does nothing if startTime is 0, i.e., if instrumentation was disabled when the span began. Spans may end on a different thread than 
+     the one on which they began.
+ 
+ @param name The name of the span. This should be one of the PG*Span constants, and must never contain user data. May not be nil.
+ @param startTime The start time returned by PGInstrumentationBeginSpan().
+ */
+extern void PGInstrumentationEndSpan(NSString *name, uint64_t startTime);
+
+/*!
+ @abstract Increments the specified counter if instrumentation is enabled.
+ @param name The name of the counter. This should be one of the PG*Counter constants, and must never contain user data. May not be nil.
+ */
+extern void PGInstrumentationIncrementCounter(NSString *name);
+
+
+#pragma mark - PGInstrumentation
+
+/*!
+ @abstract PGInstrumentation collects latency statistics and counters for the phases of wrapper operations.
+ @discussion Instrumentation is process-wide and disabled by default. While it is enabled, every span recorded by the library, e.g., deriving a key
+     or running hdiutil, is added to a histogram for its name, and counters are incremented. If tracing is also enabled, each span is additionally
+     kept as an event that can be exported in the Chrome trace event format and viewed in chrome://tracing.
+ 
+     Only span and counter names, timestamps, durations, and thread IDs are ever recorded. User names, passwords, paths, and keys are not.
+ 
+     Recording happens asynchronously on a private queue, so it adds little latency to the operation being measured. The accessors below wait for
+     all spans that ended before they were invoked to be recorded. PGInstrumentation is thread-safe.
+ */
+@interface PGInstrumentation : NSObject
+
+/*!
+ @abstract Returns whether instrumentation is enabled.
+ @return Whether spans and counters are being recorded.
+ */
++ (BOOL)isEnabled;
+
+/*!
+ @abstract Sets whether instrumentation is enabled.
+ @param enabled Whether to record spans and counters.
+ */
++ (void)setEnabled:(BOOL)enabled;
+
+/*!
+ @abstract Returns whether individual spans are kept for trace export.
+ @return Whether tracing is enabled.
+ */
++ (BOOL)isTracing;
+
+/*!
+ @abstract Sets whether individual spans are kept for trace export.
+ @discussion Tracing only has an effect while instrumentation is enabled. At most 100,000 events are kept; later ones are dropped.
+ @param tracing Whether to keep trace events.
+ */
++ (void)setTracing:(BOOL)tracing;
+
+/*!
+ @abstract Sets the block that is invoked for every recorded span.
+ @discussion The handler is invoked serially on a private queue. It must not invoke any of PGInstrumentation's methods.
+ @param handler The block to invoke with the span's name and duration in nanoseconds, or nil to remove the current handler.
+ */
++ (void)setSpanHandler:(void (^)(NSString *name, uint64_t duration))handler;
+
+/*!
+ @abstract Returns statistics for every span that has been recorded.
+ @return A dictionary whose keys are span names and whose values are dictionaries keyed by the PGSpan*StatisticKey constants.
+ */
++ (NSDictionary *)spanStatistics;
+
+/*!
+ @abstract Returns statistics for the span with the specified name.
+ @param name The name of the span. May not be nil.
+ @return A dictionary keyed by the PGSpan*StatisticKey constants, or nil if the span has never been recorded.
+ */
++ (NSDictionary *)statisticsForSpanNamed:(NSString *)name;
+
+/*!
+ @abstract Returns the values of every counter that has been incremented.
+ @return A dictionary whose keys are counter names and whose values are NSNumbers.
+ */
++ (NSDictionary *)counters;
+
+/*!
+ @abstract Returns the value of the counter with the specified name.
+ @param name The name of the counter. May not be nil.
+ @return The counter's value, or 0 if it has never been incremented.
+ */
++ (NSUInteger)valueForCounterNamed:(NSString *)name;
+
+/*!
+ @abstract Returns the recorded trace events in the Chrome trace event JSON format.
+ @discussion Each span is a complete ("X") event whose timestamp is relative to the earliest recorded event.
+ @return The trace as UTF-8 encoded JSON data.
+ */
++ (NSData *)traceJSONData;
+
+/*!
+ @abstract Writes the recorded trace events to the specified file in the Chrome trace event JSON format.
+ 
+ @param path The path of the file to write. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the trace was written successfully.
+ */
++ (BOOL)writeTraceToFile:(NSString *)path error:(NSError **)errorOut;
+
+/*!
+ @abstract Discards all recorded statistics, counters, and trace events.
+ */
++ (void)reset;
+
+@end
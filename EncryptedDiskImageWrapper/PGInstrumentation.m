@@ -0,0 +1,413 @@
+//
+//  PGInstrumentation.m
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGInstrumentation.h"
+
+#import <mach/mach_time.h>
+#import <pthread.h>
+
+
+#pragma mark Constants
+
+NSString *const PGUserTableLoadSpan = @"UserTable.load";
+NSString *const PGKeyCalibrationSpan = @"Crypto.calibrate";
+NSString *const PGKeyDerivationSpan = @"Crypto.deriveKey";
+NSString *const PGCryptSpan = @"Crypto.crypt";
+NSString *const PGAuthenticationSpan = @"Wrapper.authenticate";
+NSString *const PGAuthenticationQueueWaitSpan = @"AuthenticationService.wait";
+NSString *const PGHDIUtilSpawnSpan = @"HDIUtil.spawn";
+NSString *const PGHDIUtilCreateSpan = @"HDIUtil.create";
+NSString *const PGHDIUtilAttachSpan = @"HDIUtil.attach";
+NSString *const PGHDIUtilDetachSpan = @"HDIUtil.detach";
+NSString *const PGHDIUtilChangePasswordSpan = @"HDIUtil.chpass";
+
+NSString *const PGAuthenticationFailureCounter = @"Wrapper.authenticationFailures";
+NSString *const PGAuthenticationShedCounter = @"AuthenticationService.shed";
+NSString *const PGHDIUtilFailureCounter = @"HDIUtil.failures";
+
+NSString *const PGSpanCountStatisticKey = @"count";
+NSString *const PGSpanTotalStatisticKey = @"total";
+NSString *const PGSpanMinimumStatisticKey = @"min";
+NSString *const PGSpanMaximumStatisticKey = @"max";
+NSString *const PGSpanMeanStatisticKey = @"mean";
+NSString *const PGSpan50thPercentileStatisticKey = @"p50";
+NSString *const PGSpan90thPercentileStatisticKey = @"p90";
+NSString *const PGSpan99thPercentileStatisticKey = @"p99";
+
+enum {
+    /*! @abstract The number of histogram buckets. Durations below 4ns get a bucket each; each power of two above that is split into four. */
+    PGInstrumentationBucketCount = 252
+};
+
+/*! @abstract The maximum number of trace events that are kept. */
+static const NSUInteger PGInstrumentationMaximumTraceEventCount = 100000;
+
+
+#pragma mark - State
+
+/*! @abstract Whether spans and counters are recorded. Read without synchronization on every span, so it is the only cost when disabled. */
+static volatile BOOL PGInstrumentationEnabled = NO;
+
+/*! @abstract Whether individual spans are kept as trace events. */
+static volatile BOOL PGInstrumentationTracing = NO;
+
+/*! @abstract The serial queue on which all of the state below is accessed. */
+static dispatch_queue_t PGInstrumentationQueue = NULL;
+
+/*! @abstract Maps span names to PGInstrumentationSpanRecord instances. */
+static NSMutableDictionary *PGInstrumentationSpanRecords = nil;
+
+/*! @abstract Maps counter names to NSNumbers. */
+static NSMutableDictionary *PGInstrumentationCounters = nil;
+
+/*! @abstract The trace events, each of which is a dictionary of the span's name, start time, duration, and thread. */
+static NSMutableArray *PGInstrumentationTraceEvents = nil;
+
+/*! @abstract The block invoked for every recorded span. */
+static void (^PGInstrumentationSpanHandler)(NSString *, uint64_t) = nil;
+
+/*! @abstract The ratio used to convert mach_absolute_time() values to nanoseconds. */
+static mach_timebase_info_data_t PGInstrumentationTimebase;
+
+
+#pragma mark - Span Records
+
+/*!
+ @abstract PGInstrumentationSpanRecord instances hold the summary statistics and duration histogram of a span.
+ @discussion Span records are only accessed on PGInstrumentationQueue.
+ */
+@interface PGInstrumentationSpanRecord : NSObject {
+    uint64_t _count;
+    uint64_t _total;
+    uint64_t _minimum;
+    uint64_t _maximum;
+    uint64_t _buckets[PGInstrumentationBucketCount];
+}
+
+/*!
+ @abstract Adds the specified duration to the record.
+ @param duration The span's duration in nanoseconds.
+ */
+- (void)addDuration:(uint64_t)duration;
+
+/*!
+ @abstract Returns the record's statistics.
+ @return A dictionary keyed by the PGSpan*StatisticKey constants.
+ */
+- (NSDictionary *)statistics;
+
+/*!
+ @abstract Returns the approximate duration below which the specified fraction of the recorded durations fall.
+ @param fraction The fraction of durations, between 0 and 1.
+ @return The approximate duration in nanoseconds.
+ */
+- (uint64_t)durationAtFraction:(double)fraction;
+
+@end
+
+
+/*!
+ @abstract Returns the index of the histogram bucket for the specified duration.
+ @param duration The duration in nanoseconds.
+ @return The bucket index.
+ */
+static NSUInteger PGInstrumentationBucketForDuration(uint64_t duration)
+{
+    if (duration < 4) return (NSUInteger)duration;
+    
+    // Bucket by the position of the most significant bit and the two bits below it
+    unsigned exponent = 63 - __builtin_clzll(duration);
+    return (exponent - 1) * 4 + (NSUInteger)((duration >> (exponent - 2)) & 3);
+}
+
+
+/*!
+ @abstract Returns the duration in the middle of the specified histogram bucket.
+ @param bucket The bucket index.
+ @return The duration in nanoseconds.
+ */
+static uint64_t PGInstrumentationMidpointOfBucket(NSUInteger bucket)
+{
+    if (bucket < 4) return bucket;
+    
+    unsigned exponent = (unsigned)(bucket / 4) + 1;
+    uint64_t lowerBound = (uint64_t)(4 + bucket % 4) << (exponent - 2);
+    return lowerBound + ((1ULL << (exponent - 2)) >> 1);
+}
+
+
+@implementation PGInstrumentationSpanRecord
+
+- (void)addDuration:(uint64_t)duration
+{
+    if (_count == 0 || duration < _minimum) _minimum = duration;
+    if (duration > _maximum) _maximum = duration;
+    _count++;
+    _total += duration;
+    _buckets[PGInstrumentationBucketForDuration(duration)]++;
+}
+
+
+- (uint64_t)durationAtFraction:(double)fraction
+{
+    uint64_t rank = (uint64_t)ceil(fraction * _count);
+    if (rank == 0) rank = 1;
+    
+    uint64_t cumulativeCount = 0;
+    for (NSUInteger bucket = 0; bucket < PGInstrumentationBucketCount; bucket++) {
+        cumulativeCount += _buckets[bucket];
+        if (cumulativeCount >= rank) {
+            // Clamp to the exact extremes so that percentiles never fall outside the recorded range
+            uint64_t duration = PGInstrumentationMidpointOfBucket(bucket);
+            return MIN(MAX(duration, _minimum), _maximum);
+        }
+    }
+    
+    return _maximum;
+}
+
+
+- (NSDictionary *)statistics
+{
+    return [NSDictionary dictionaryWithObjectsAndKeys:[NSNumber numberWithUnsignedLongLong:_count], PGSpanCountStatisticKey,
+            [NSNumber numberWithUnsignedLongLong:_total], PGSpanTotalStatisticKey, 
+            [NSNumber numberWithUnsignedLongLong:_minimum], PGSpanMinimumStatisticKey,
+            [NSNumber numberWithUnsignedLongLong:_maximum], PGSpanMaximumStatisticKey,
+            [NSNumber numberWithUnsignedLongLong:_total / _count], PGSpanMeanStatisticKey,
+            [NSNumber numberWithUnsignedLongLong:[self durationAtFraction:0.5]], PGSpan50thPercentileStatisticKey,
+            [NSNumber numberWithUnsignedLongLong:[self durationAtFraction:0.9]], PGSpan90thPercentileStatisticKey,
+            [NSNumber numberWithUnsignedLongLong:[self durationAtFraction:0.99]], PGSpan99thPercentileStatisticKey, nil];
+}
+
+@end
+
+
+#pragma mark - Recording
+
+/*!
+ @abstract Converts the specified mach_absolute_time() interval to nanoseconds.
+ @param ticks The interval in mach_absolute_time() units.
+ @return The interval in nanoseconds.
+ */
+static uint64_t PGInstrumentationNanosecondsForTicks(uint64_t ticks)
+{
+    return ticks * PGInstrumentationTimebase.numer / PGInstrumentationTimebase.denom;
+}
+
+
+uint64_t PGInstrumentationBeginSpan(void)
+{
+    return PGInstrumentationEnabled ? mach_absolute_time() : 0;
+}
+
+
+void PGInstrumentationEndSpan(NSString *name, uint64_t startTime)
+{
+    if (!startTime) return;
+    NSCAssert(name, @"nil name");
+    
+    uint64_t duration = PGInstrumentationNanosecondsForTicks(mach_absolute_time() - startTime);
+    mach_port_t thread = pthread_mach_thread_np(pthread_self());
+    
+    dispatch_async(PGInstrumentationQueue, ^{
+        PGInstrumentationSpanRecord *record = [PGInstrumentationSpanRecords objectForKey:name];
+        if (!record) {
+            record = [[PGInstrumentationSpanRecord alloc] init];
+            [PGInstrumentationSpanRecords setObject:record forKey:name];
+        }
+        
+        [record addDuration:duration];
+        
+        if (PGInstrumentationTracing && [PGInstrumentationTraceEvents count] < PGInstrumentationMaximumTraceEventCount) {
+            [PGInstrumentationTraceEvents addObject:[NSDictionary dictionaryWithObjectsAndKeys:name, @"name", 
+                                                     [NSNumber numberWithUnsignedLongLong:PGInstrumentationNanosecondsForTicks(startTime)], @"start",
+                                                     [NSNumber numberWithUnsignedLongLong:duration], @"duration",
+                                                     [NSNumber numberWithUnsignedInt:thread], @"thread", nil]];
+        }
+        
+        if (PGInstrumentationSpanHandler) PGInstrumentationSpanHandler(name, duration);
+    });
+}
+
+
+void PGInstrumentationIncrementCounter(NSString *name)
+{
+    if (!PGInstrumentationEnabled) return;
+    NSCAssert(name, @"nil name");
+    
+    dispatch_async(PGInstrumentationQueue, ^{
+        NSUInteger value = [[PGInstrumentationCounters objectForKey:name] unsignedIntegerValue];
+        [PGInstrumentationCounters setObject:[NSNumber numberWithUnsignedInteger:value + 1] forKey:name];
+    });
+}
+
+
+#pragma mark - Implementation
+
+@implementation PGInstrumentation
+
++ (void)initialize
+{
+    if (self != [PGInstrumentation class]) return;
+    
+    mach_timebase_info(&PGInstrumentationTimebase);
+    PGInstrumentationQueue = dispatch_queue_create("com.quantumlenscap.PGInstrumentation", DISPATCH_QUEUE_SERIAL);
+    PGInstrumentationSpanRecords = [[NSMutableDictionary alloc] init];
+    PGInstrumentationCounters = [[NSMutableDictionary alloc] init];
+    PGInstrumentationTraceEvents = [[NSMutableArray alloc] init];
+}
+
+
++ (BOOL)isEnabled
+{
+    return PGInstrumentationEnabled;
+}
+
+
++ (void)setEnabled:(BOOL)enabled
+{
+    PGInstrumentationEnabled = enabled;
+}
+
+
++ (BOOL)isTracing
+{
+    return PGInstrumentationTracing;
+}
+
+
++ (void)setTracing:(BOOL)tracing
+{
+    PGInstrumentationTracing = tracing;
+}
+
+
++ (void)setSpanHandler:(void (^)(NSString *, uint64_t))handler
+{
+    dispatch_sync(PGInstrumentationQueue, ^{
+        PGInstrumentationSpanHandler = [handler copy];
+    });
+}
+
+
+#pragma mark Statistics
+
++ (NSDictionary *)spanStatistics
+{
+    NSMutableDictionary *spanStatistics = [NSMutableDictionary dictionary];
+    dispatch_sync(PGInstrumentationQueue, ^{
+        [PGInstrumentationSpanRecords enumerateKeysAndObjectsUsingBlock:^(NSString *name, PGInstrumentationSpanRecord *record, BOOL *stop) {
+            [spanStatistics setObject:[record statistics] forKey:name];
+        }];
+    });
+    
+    return spanStatistics;
+}
+
+
++ (NSDictionary *)statisticsForSpanNamed:(NSString *)name
+{
+    NSAssert(name, @"nil name");
+    
+    __block NSDictionary *statistics = nil;
+    dispatch_sync(PGInstrumentationQueue, ^{
+        statistics = [[PGInstrumentationSpanRecords objectForKey:name] statistics];
+    });
+    
+    return statistics;
+}
+
+
++ (NSDictionary *)counters
+{
+    __block NSDictionary *counters = nil;
+    dispatch_sync(PGInstrumentationQueue, ^{
+        counters = [PGInstrumentationCounters copy];
+    });
+    
+    return counters;
+}
+
+
++ (NSUInteger)valueForCounterNamed:(NSString *)name
+{
+    NSAssert(name, @"nil name");
+    return [[[self counters] objectForKey:name] unsignedIntegerValue];
+}
+
+
+#pragma mark Traces
+
++ (NSData *)traceJSONData
+{
+    __block NSArray *events = nil;
+    dispatch_sync(PGInstrumentationQueue, ^{
+        events = [PGInstrumentationTraceEvents copy];
+    });
+    
+    // Chrome expects timestamps and durations in microseconds. Make timestamps relative to the earliest event so they're easy to read.
+    uint64_t earliestStart = UINT64_MAX;
+    for (NSDictionary *event in events) {
+        earliestStart = MIN(earliestStart, [[event objectForKey:@"start"] unsignedLongLongValue]);
+    }
+    
+    NSNumber *processIdentifier = [NSNumber numberWithInt:[[NSProcessInfo processInfo] processIdentifier]];
+    NSMutableArray *traceEvents = [NSMutableArray arrayWithCapacity:[events count]];
+    for (NSDictionary *event in events) {
+        NSString *name = [event objectForKey:@"name"];
+        uint64_t start = [[event objectForKey:@"start"] unsignedLongLongValue];
+        uint64_t duration = [[event objectForKey:@"duration"] unsignedLongLongValue];
+        NSRange separatorRange = [name rangeOfString:@"."];
+        NSString *category = separatorRange.location != NSNotFound ? [name substringToIndex:separatorRange.location] : name;
+        
+        [traceEvents addObject:[NSDictionary dictionaryWithObjectsAndKeys:name, @"name", category, @"cat", @"X", @"ph",
+                                [NSNumber numberWithDouble:(start - earliestStart) / 1000.0], @"ts",
+                                [NSNumber numberWithDouble:duration / 1000.0], @"dur",
+                                processIdentifier, @"pid", [event objectForKey:@"thread"], @"tid", nil]];
+    }
+    
+    NSDictionary *trace = [NSDictionary dictionaryWithObjectsAndKeys:traceEvents, @"traceEvents", @"ns", @"displayTimeUnit", nil];
+    return [NSJSONSerialization dataWithJSONObject:trace options:0 error:NULL];
+}
+
+
++ (BOOL)writeTraceToFile:(NSString *)path error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    return [[self traceJSONData] writeToFile:path options:NSDataWritingAtomic error:errorOut];
+}
+
+
++ (void)reset
+{
+    dispatch_sync(PGInstrumentationQueue, ^{
+        [PGInstrumentationSpanRecords removeAllObjects];
+        [PGInstrumentationCounters removeAllObjects];
+        [PGInstrumentationTraceEvents removeAllObjects];
+    });
+}
+
+@end
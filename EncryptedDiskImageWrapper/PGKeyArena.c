@@ -0,0 +1,129 @@
+//
+//  PGKeyArena.c
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include "PGKeyArena.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+
+#pragma mark Types and Variables
+
+/*! @abstract A free block. The link is cleared before the block is handed out. */
+typedef struct PGKeyArenaFreeBlock {
+    struct PGKeyArenaFreeBlock *next;
+} PGKeyArenaFreeBlock;
+
+/*! @abstract Protects the arena's variables. */
+static pthread_mutex_t PGKeyArenaMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*! @abstract The arena's free blocks, most recently released first. */
+static PGKeyArenaFreeBlock *PGKeyArenaFreeList = NULL;
+
+/*! @abstract Whether any of the arena's pages couldn't be locked. */
+static bool PGKeyArenaHasUnlockedPage = false;
+
+
+#pragma mark Functions
+
+/*!
+ @abstract Maps and locks a new page and adds its blocks to the free list.
+ @discussion Must be called with PGKeyArenaMutex held.
+ @return Whether the page was mapped.
+ */
+static bool PGKeyArenaGrow(void)
+{
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    uint8_t *page = mmap(NULL, pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (page == MAP_FAILED) return false;
+    
+    if (mlock(page, pageSize) != 0) PGKeyArenaHasUnlockedPage = true;
+    
+#if defined(MADV_DONTDUMP)
+    // Keep keys out of core dumps where the system lets us
+    madvise(page, pageSize, MADV_DONTDUMP);
+#endif
+    
+    // Push the blocks in reverse so that they're handed out in address order
+    for (size_t offset = pageSize; offset >= PGKeyArenaBlockSize; offset -= PGKeyArenaBlockSize) {
+        PGKeyArenaFreeBlock *block = (PGKeyArenaFreeBlock *)(page + offset - PGKeyArenaBlockSize);
+        block->next = PGKeyArenaFreeList;
+        PGKeyArenaFreeList = block;
+    }
+    
+    return true;
+}
+
+
+void *PGKeyArenaAllocate(size_t length)
+{
+    if (length > PGKeyArenaBlockSize) return NULL;
+    
+    pthread_mutex_lock(&PGKeyArenaMutex);
+    PGKeyArenaFreeBlock *block = PGKeyArenaFreeList;
+    if (!block && PGKeyArenaGrow()) block = PGKeyArenaFreeList;
+    if (block) PGKeyArenaFreeList = block->next;
+    pthread_mutex_unlock(&PGKeyArenaMutex);
+    
+    // The rest of the block was zeroed when it was released or mapped
+    if (block) block->next = NULL;
+    return block;
+}
+
+
+void PGKeyArenaRelease(void *block)
+{
+    if (!block) return;
+    
+    PGKeyArenaZero(block, PGKeyArenaBlockSize);
+    
+    pthread_mutex_lock(&PGKeyArenaMutex);
+    ((PGKeyArenaFreeBlock *)block)->next = PGKeyArenaFreeList;
+    PGKeyArenaFreeList = block;
+    pthread_mutex_unlock(&PGKeyArenaMutex);
+}
+
+
+bool PGKeyArenaIsLocked(void)
+{
+    pthread_mutex_lock(&PGKeyArenaMutex);
+    bool locked = !PGKeyArenaHasUnlockedPage;
+    pthread_mutex_unlock(&PGKeyArenaMutex);
+    return locked;
+}
+
+
+void PGKeyArenaZero(void *bytes, size_t length)
+{
+    if (length == 0) return;
+    memset(bytes, 0, length);
+    
+    // Tell the compiler that the memory is read afterward, so that the memset isn't eliminated as a dead store
+    __asm__ __volatile__("" : : "r"(bytes) : "memory");
+}
@@ -0,0 +1,70 @@
+//
+//  PGKeyArena.h
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ PGKeyArena hands out small blocks of memory for key material. Blocks are carved out of pages that are locked into memory with mlock, so keys
+ are never written to swap, and every block is zeroed when it's released, so keys never linger in freed memory. Released blocks go on a free
+ list and are handed out again, so once the arena has grown to the number of keys in use at once, allocating and releasing a key neither touches
+ the heap nor makes a system call. Pages are never returned to the system. The arena is shared by the whole process and may be used from any
+ thread.
+ */
+
+enum {
+    /*! @abstract The size of each block in the arena, and thus the largest amount of key material that can be allocated at once. */
+    PGKeyArenaBlockSize = 64
+};
+
+/*!
+ @abstract Allocates a block of key memory from the arena.
+ @discussion The arena grows by a page when it has no free blocks. If the page can't be locked, e.g., because the process has reached its 
+     RLIMIT_MEMLOCK, the page is used anyway; its blocks are still zeroed on release.
+ @param length The number of bytes needed. Must be at most PGKeyArenaBlockSize.
+ @return A zeroed block of at least length bytes, or NULL if length is too large or the arena couldn't grow.
+ */
+extern void *PGKeyArenaAllocate(size_t length);
+
+/*!
+ @abstract Zeroes the specified block and returns it to the arena.
+ @param block The block to release, which must have been returned by PGKeyArenaAllocate. May be NULL.
+ */
+extern void PGKeyArenaRelease(void *block);
+
+/*!
+ @abstract Returns whether the pages backing the arena are all locked into memory.
+ @return Whether every page was successfully locked. If the arena has no pages yet, returns true.
+ */
+extern bool PGKeyArenaIsLocked(void);
+
+/*!
+ @abstract Zeroes the specified memory in a way that the compiler can't optimize away.
+ @discussion Use this instead of memset for memory that held key material and is about to be freed or go out of scope.
+ @param bytes The memory to zero. May only be NULL if length is 0.
+ @param length The number of bytes to zero.
+ */
+extern void PGKeyArenaZero(void *bytes, size_t length);
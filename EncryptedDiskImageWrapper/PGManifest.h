@@ -0,0 +1,174 @@
+//
+//  PGManifest.h
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+
+#import <Foundation/Foundation.h>
+
+/*! @abstract Options that control how a manifest is updated from a directory. */
+typedef NS_OPTIONS(NSUInteger, PGManifestOptions) {
+    /*!
+     @abstract Re-hashes every file, instead of only those whose size or modification date differ from the manifest's.
+     @discussion This also detects corruption that leaves a file's size and modification date unchanged, but takes time proportional to the 
+         amount of data in the directory.
+     */
+    PGManifestRehashAllFiles = 1 << 0
+};
+
+
+/*!
+ @abstract PGManifest instances record digests of the files in a directory so that later corruption or tampering can be detected.
+ @discussion A manifest records the size, modification date, and digest of each regular file beneath a directory, and a root digest that covers
+     all of them. Each file's digest is the root of a Merkle tree of SHA-256 digests over the file's 1 MB chunks. Files are read a window at a 
+     time into a fixed-size buffer rather than read into memory whole, their chunks are hashed in parallel on all cores, and many files are 
+     hashed at once, so building a manifest is limited by disk bandwidth rather than by a single core, and files of any size can be hashed. The 
+     root digest is the root of a Merkle tree over the files' paths and digests, in path order.
+ 
+     The root digest alone only detects corruption, since anyone who can change a file can also recompute the manifest. To detect tampering, 
+     write the manifest with a password and read it back with the same one. The manifest file then also records an HMAC-SHA256 of the root 
+     digest, keyed with a key derived from the password with PBKDF2, which can't be recomputed without the password.
+ 
+     Building a manifest from an earlier one, or comparing a directory with a manifest, only re-hashes files whose size or modification date 
+     has changed since the manifest was built. Checking a large, mostly unchanged directory such as a sparse bundle's bands therefore costs 
+     little more than reading each file's attributes. Use PGManifestRehashAllFiles to check every file's contents.
+ 
+     Files must not be modified while they are being hashed. Manifests are immutable and may be used from any thread.
+ */
+@interface PGManifest : NSObject
+
+/*! @abstract The digest covering the paths and contents of every file in the manifest. */
+@property(readonly, strong) NSData *rootDigest;
+
+/*! @abstract The paths of the files in the manifest, relative to its directory, in ascending order. */
+@property(readonly, strong) NSArray *relativePaths;
+
+/*! @abstract The paths relative to the manifest's directory that are excluded from it, along with everything beneath them. */
+@property(readonly, strong) NSSet *excludedRelativePaths;
+
+/*!
+ @abstract Returns the Merkle tree digest of the contents of the file at the specified path.
+ @discussion This is the digest that manifests record for each file. The file is read into a fixed-size buffer a window at a time and its chunks are
+     hashed in parallel, so files of any size can be hashed without reading them into memory whole. If the file is truncated while it's being 
+     hashed, this fails with EIO.
+ 
+ @param path The path of the file to hash. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The file's digest, or nil if the file could not be read.
+ */
++ (NSData *)digestOfFileAtPath:(NSString *)path error:(NSError **)errorOut;
+
+/*!
+ @abstract Builds a manifest of the files beneath the specified directory.
+ 
+ @param path The path of the directory. May not be nil.
+ @param excludedRelativePaths The paths, relative to the directory, of files and directories to leave out of the manifest. May be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The new manifest, or nil if the directory or one of its files could not be read.
+ */
++ (PGManifest *)manifestWithDirectoryAtPath:(NSString *)path excludedRelativePaths:(NSSet *)excludedRelativePaths error:(NSError **)errorOut;
+
+/*!
+ @abstract Initializes a newly allocated manifest with a manifest file written by -writeToFile:error:.
+ 
+ @param path The path of the manifest file. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return An initialized manifest, or nil if the file could not be read or is malformed.
+ */
+- (id)initWithContentsOfFile:(NSString *)path error:(NSError **)errorOut;
+
+/*!
+ @abstract Initializes a newly allocated manifest with a manifest file written by -writeToFile:password:error:, checking its authentication code.
+ @discussion This derives the authentication key from the password, so it takes as long as the key derivation was calibrated to take.
+ 
+ @param path The path of the manifest file. May not be nil.
+ @param password The password with which the manifest was written. If nil, the authentication code isn't checked.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return An initialized manifest, or nil if the file could not be read or is malformed. If the manifest has no authentication code, or it 
+     doesn't match the one derived from the password, the error's code is PGEncryptedDiskImageWrapperManifestMismatchError.
+ */
+- (id)initWithContentsOfFile:(NSString *)path password:(NSString *)password error:(NSError **)errorOut;
+
+/*!
+ @abstract Atomically writes the manifest to the specified file.
+ 
+ @param path The path of the manifest file. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the manifest was written.
+ */
+- (BOOL)writeToFile:(NSString *)path error:(NSError **)errorOut;
+
+/*!
+ @abstract Atomically writes the manifest to the specified file along with an authentication code derived from the specified password.
+ @discussion If the receiver was read with -initWithContentsOfFile:password:error: and a password, or updated from a manifest that was, the 
+     manifest file's key derivation salt and rounds are reused. Otherwise, new ones are generated and calibrated.
+ 
+ @param path The path of the manifest file. May not be nil.
+ @param password The password from which to derive the authentication key. If nil, no authentication code is written.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the manifest was written.
+ */
+- (BOOL)writeToFile:(NSString *)path password:(NSString *)password error:(NSError **)errorOut;
+
+/*!
+ @abstract Returns the recorded digest of the file at the specified path.
+ @param relativePath The file's path relative to the manifest's directory. May not be nil.
+ @return The file's digest, or nil if the manifest has no such file.
+ */
+- (NSData *)digestForRelativePath:(NSString *)relativePath;
+
+/*!
+ @abstract Builds a manifest of the current contents of the specified directory, reusing this manifest's digests where possible.
+ @discussion Files whose size and modification date match the receiver's records aren't re-hashed unless options includes 
+     PGManifestRehashAllFiles. The new manifest excludes the same paths as the receiver.
+ 
+ @param path The path of the directory, which should be the one the receiver was built from. May not be nil.
+ @param options Options that control which files are re-hashed.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The new manifest, or nil if the directory or one of its files could not be read.
+ */
+- (PGManifest *)manifestByUpdatingWithDirectoryAtPath:(NSString *)path options:(PGManifestOptions)options error:(NSError **)errorOut;
+
+/*!
+ @abstract Returns the relative paths of the files that differ between the receiver and the specified manifest.
+ @param manifest The manifest to compare with. May not be nil.
+ @return The paths, in ascending order, of files that are in only one of the manifests or whose digests differ. Empty if the manifests match.
+ */
+- (NSArray *)relativePathsOfFilesDifferingFromManifest:(PGManifest *)manifest;
+
+@end
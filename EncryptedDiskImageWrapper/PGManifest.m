@@ -0,0 +1,617 @@
+//
+//  PGManifest.m
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+
+#import "PGManifest.h"
+
+#import <fcntl.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+#import "NSData+Crypto.h"
+#import "PGCryptoProvider.h"
+#import "PGErrors.h"
+#import "PGKeyArena.h"
+
+
+#pragma mark Constants and Functions
+
+enum {
+    /*! @abstract The length of the SHA-256 digests that make up a manifest's Merkle trees. */
+    PGManifestDigestLength = 32
+};
+
+/*! @abstract The size of the chunks whose digests are the leaves of a file's Merkle tree. */
+static const size_t PGManifestChunkSize = 1024 * 1024;
+
+/*!
+ @abstract The number of chunks of a file that are read into memory and hashed at once.
+ @discussion Several files are hashed at once, each with its own window buffer, so this is kept small enough that their buffers fit in memory.
+ */
+static const size_t PGManifestChunksPerWindow = 8;
+
+/*! @abstract The byte prepended to the digest of a leaf's data before hashing it again, so that leaves can't be mistaken for interior nodes. */
+static const uint8_t PGManifestLeafPrefix = 0x00;
+
+/*! @abstract The byte prepended to the concatenated digests of an interior node's children before hashing them. */
+static const uint8_t PGManifestNodePrefix = 0x01;
+
+/*! @abstract The version of the manifest file format written by this class. */
+static const NSUInteger PGManifestVersion = 1;
+
+/*! @abstract The manifest file key whose value corresponds to the file format version. */
+static NSString *const PGVersionManifestKey = @"Version";
+
+/*! @abstract The manifest file key whose value corresponds to the manifest's root digest. */
+static NSString *const PGRootDigestManifestKey = @"RootDigest";
+
+/*! @abstract The manifest file key whose value corresponds to the salt from which the manifest's authentication key is derived. */
+static NSString *const PGSaltManifestKey = @"Salt";
+
+/*! @abstract The manifest file key whose value corresponds to the number of rounds with which the manifest's authentication key is derived. */
+static NSString *const PGRoundsManifestKey = @"Rounds";
+
+/*! @abstract The manifest file key whose value corresponds to the HMAC-SHA256 of the root digest with the manifest's authentication key. */
+static NSString *const PGAuthenticationCodeManifestKey = @"AuthenticationCode";
+
+/*! @abstract The manifest file key whose value is an array of the manifest's excluded relative paths. */
+static NSString *const PGExcludedPathsManifestKey = @"ExcludedPaths";
+
+/*! @abstract The manifest file key whose value is a dictionary of file entries keyed by relative path. */
+static NSString *const PGFilesManifestKey = @"Files";
+
+/*! @abstract The file entry key whose value corresponds to the file's size in bytes. */
+static NSString *const PGSizeManifestEntryKey = @"Size";
+
+/*! @abstract The file entry key whose value corresponds to the file's modification date. */
+static NSString *const PGModificationDateManifestEntryKey = @"ModificationDate";
+
+/*! @abstract The file entry key whose value corresponds to the file's digest. */
+static NSString *const PGDigestManifestEntryKey = @"Digest";
+
+
+/*!
+ @abstract Computes the Merkle tree leaf digest of the specified data.
+ @param bytes The data. May only be NULL if length is 0.
+ @param length The length of the data.
+ @param digest The buffer in which to store the digest. Must be at least PGManifestDigestLength bytes long.
+ */
+static void PGManifestLeafDigest(const void *bytes, size_t length, uint8_t *digest)
+{
+    const PGCryptoProvider *provider = PGCryptoDefaultProvider();
+    uint8_t input[1 + PGManifestDigestLength];
+    input[0] = PGManifestLeafPrefix;
+    provider->digest(PGCryptoDigestSHA256, bytes, length, input + 1);
+    provider->digest(PGCryptoDigestSHA256, input, sizeof(input), digest);
+}
+
+
+/*!
+ @abstract Reduces the specified Merkle tree leaf digests to the tree's root digest in place.
+ @discussion Each level's digests are hashed in pairs to form the next level. A digest without a sibling is promoted to the next level unchanged.
+ @param digests The leaf digests, which are overwritten. The root digest is stored in the first PGManifestDigestLength bytes.
+ @param count The number of leaf digests. Must be at least 1.
+ */
+static void PGManifestReduceDigests(uint8_t *digests, size_t count)
+{
+    const PGCryptoProvider *provider = PGCryptoDefaultProvider();
+    uint8_t input[1 + 2 * PGManifestDigestLength];
+    input[0] = PGManifestNodePrefix;
+    
+    while (count > 1) {
+        size_t parentCount = 0;
+        for (size_t i = 0; i < count; i += 2, ++parentCount) {
+            uint8_t *parent = digests + parentCount * PGManifestDigestLength;
+            if (i + 1 < count) {
+                // The children are copied out before the parent is written, so the parent may overwrite the left child
+                memcpy(input + 1, digests + i * PGManifestDigestLength, 2 * PGManifestDigestLength);
+                provider->digest(PGCryptoDigestSHA256, input, sizeof(input), parent);
+            } else {
+                memmove(parent, digests + i * PGManifestDigestLength, PGManifestDigestLength);
+            }
+        }
+        
+        count = parentCount;
+    }
+}
+
+
+/*!
+ @abstract Computes the Merkle tree digest of the contents of the specified file.
+ @discussion The file is read into a buffer PGManifestChunksPerWindow chunks at a time, and the chunks in each window are hashed in parallel. 
+     The file is read rather than mapped so that a file that is truncated while it's being hashed produces an error instead of a SIGBUS.
+ 
+ @param fileDescriptor A file descriptor open for reading on the file.
+ @param length The length of the file.
+ @param digest The buffer in which to store the digest. Must be at least PGManifestDigestLength bytes long.
+ 
+ @return 0 if the digest was computed; EIO if the file became shorter than length while it was being read; or another errno value if the file
+     could not be read or memory could not be allocated.
+ */
+static int PGManifestDigestFileDescriptor(int fileDescriptor, uint64_t length, uint8_t *digest)
+{
+    // An empty file has a single, empty chunk
+    uint64_t chunkCount = length == 0 ? 1 : (length + PGManifestChunkSize - 1) / PGManifestChunkSize;
+    if (chunkCount > SIZE_MAX / PGManifestDigestLength) return EFBIG;
+    
+    const uint64_t windowSize = PGManifestChunksPerWindow * PGManifestChunkSize;
+    uint8_t *chunkDigests = malloc((size_t)chunkCount * PGManifestDigestLength);
+    uint8_t *window = length > 0 ? malloc((size_t)MIN(windowSize, length)) : NULL;
+    if (!chunkDigests || (length > 0 && !window)) {
+        free(chunkDigests);
+        free(window);
+        return ENOMEM;
+    }
+    
+    if (length == 0) PGManifestLeafDigest(NULL, 0, chunkDigests);
+    
+    for (uint64_t windowOffset = 0; windowOffset < length; windowOffset += windowSize) {
+        size_t windowLength = (size_t)MIN(windowSize, length - windowOffset);
+        for (size_t readLength = 0; readLength < windowLength; ) {
+            ssize_t result = pread(fileDescriptor, window + readLength, windowLength - readLength, (off_t)(windowOffset + readLength));
+            if (result <= 0 && !(result == -1 && errno == EINTR)) {
+                int errorNumber = result == 0 ? EIO : errno;
+                free(window);
+                free(chunkDigests);
+                return errorNumber;
+            }
+            
+            if (result > 0) readLength += result;
+        }
+        
+        uint8_t *windowDigests = chunkDigests + (size_t)(windowOffset / PGManifestChunkSize) * PGManifestDigestLength;
+        size_t windowChunkCount = (windowLength + PGManifestChunkSize - 1) / PGManifestChunkSize;
+        dispatch_apply(windowChunkCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+            size_t chunkOffset = i * PGManifestChunkSize;
+            PGManifestLeafDigest(window + chunkOffset, MIN(PGManifestChunkSize, windowLength - chunkOffset), 
+                                 windowDigests + i * PGManifestDigestLength);
+        });
+    }
+    
+    free(window);
+    PGManifestReduceDigests(chunkDigests, (size_t)chunkCount);
+    memcpy(digest, chunkDigests, PGManifestDigestLength);
+    free(chunkDigests);
+    return 0;
+}
+
+
+/*!
+ @abstract Returns the root digest of a manifest with the specified entries.
+ @discussion Each leaf of the tree is the digest of a file's relative path in UTF-8, a NUL byte, and the file's digest. The leaves are in 
+     ascending path order. A manifest with no files has the leaf digest of empty data as its root.
+ 
+ @param relativePaths The relative paths of the manifest's files, in ascending order. May not be nil.
+ @param entries The manifest's file entries, keyed by relative path. May not be nil.
+ 
+ @return The root digest.
+ */
+static NSData *PGManifestRootDigest(NSArray *relativePaths, NSDictionary *entries)
+{
+    NSUInteger count = [relativePaths count];
+    NSMutableData *digests = [NSMutableData dataWithLength:MAX(count, 1) * PGManifestDigestLength];
+    if (count == 0) PGManifestLeafDigest(NULL, 0, [digests mutableBytes]);
+    
+    uint8_t separator = 0;
+    for (NSUInteger i = 0; i < count; ++i) {
+        NSString *relativePath = [relativePaths objectAtIndex:i];
+        NSMutableData *leaf = [[relativePath dataUsingEncoding:NSUTF8StringEncoding] mutableCopy];
+        [leaf appendBytes:&separator length:sizeof(separator)];
+        [leaf appendData:[[entries objectForKey:relativePath] objectForKey:PGDigestManifestEntryKey]];
+        PGManifestLeafDigest([leaf bytes], [leaf length], (uint8_t *)[digests mutableBytes] + i * PGManifestDigestLength);
+    }
+    
+    PGManifestReduceDigests([digests mutableBytes], MAX(count, 1));
+    [digests setLength:PGManifestDigestLength];
+    return digests;
+}
+
+
+/*!
+ @abstract Returns the specified paths sorted by their Unicode code points, which is the order in which a manifest's files are hashed.
+ @param paths The paths to sort. May not be nil.
+ @return The sorted paths.
+ */
+static NSArray *PGManifestSortedPaths(NSArray *paths)
+{
+    return [paths sortedArrayUsingComparator:^NSComparisonResult(NSString *path1, NSString *path2) {
+        return [path1 compare:path2 options:NSLiteralSearch];
+    }];
+}
+
+
+/*!
+ @abstract Returns an error describing a malformed manifest file.
+ @return The error.
+ */
+static NSError *PGManifestMalformedError(void)
+{
+    return [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperMalformedManifestError userInfo:nil];
+}
+
+
+/*!
+ @abstract Returns the authentication code of a manifest with the specified root digest.
+ @discussion The authentication key is derived from the password with PBKDF2 and only ever exists in the key arena.
+ 
+ @param rootDigest The manifest's root digest. May not be nil.
+ @param password The password from which to derive the authentication key. May not be nil.
+ @param salt The salt from which to derive the authentication key. May not be nil.
+ @param rounds The number of rounds with which to derive the authentication key. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The HMAC-SHA256 of the root digest, or nil if the key could not be derived.
+ */
+static NSData *PGManifestAuthenticationCode(NSData *rootDigest, NSString *password, NSData *salt, NSNumber *rounds, NSError **errorOut)
+{
+    void *key = PGKeyArenaAllocate(PGSymmetricKeyLength);
+    if (!key) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGCommonCryptoErrorDomain code:PGCryptoMemoryError userInfo:nil];
+        return nil;
+    }
+    
+    NSData *authenticationCode = nil;
+    if ([NSData getSymmetricKey:key forPassword:password salt:salt rounds:rounds error:errorOut]) {
+        uint8_t authenticationCodeBytes[PGCryptoHMACSHA256Length];
+        [rootDigest getHMACSHA256Digest:authenticationCodeBytes withKeyBytes:key length:PGSymmetricKeyLength];
+        authenticationCode = [NSData dataWithBytes:authenticationCodeBytes length:sizeof(authenticationCodeBytes)];
+    }
+    
+    PGKeyArenaRelease(key);
+    return authenticationCode;
+}
+
+
+#pragma mark - Private Methods Interface
+
+@interface PGManifest ()
+
+/*! @abstract The salt from which the manifest's authentication key was derived, or nil if it wasn't read from an authenticated manifest file. */
+@property(readwrite, strong) NSData *keyDerivationSalt;
+
+/*! @abstract The number of rounds with which the manifest's authentication key was derived, or nil if keyDerivationSalt is nil. */
+@property(readwrite, strong) NSNumber *keyDerivationRounds;
+
+/*!
+ @abstract Initializes a newly allocated manifest with the specified file entries.
+ @param entries The file entries, keyed by relative path. Each is a dictionary with size, modification date, and digest keys. May not be nil.
+ @param excludedRelativePaths The relative paths excluded from the manifest. May not be nil.
+ @return An initialized manifest.
+ */
+- (id)initWithEntries:(NSDictionary *)entries excludedRelativePaths:(NSSet *)excludedRelativePaths;
+
+/*!
+ @abstract Builds a manifest of the files beneath the specified directory, reusing digests from the specified entries where possible.
+ 
+ @param path The path of the directory. May not be nil.
+ @param excludedRelativePaths The relative paths to exclude. May not be nil.
+ @param previousEntries File entries from an earlier manifest of the directory. Files whose size and modification date match their entries 
+     aren't re-hashed. May be nil, in which case every file is hashed.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The new manifest, or nil if the directory or one of its files could not be read.
+ */
++ (PGManifest *)manifestWithDirectoryAtPath:(NSString *)path excludedRelativePaths:(NSSet *)excludedRelativePaths 
+                             previousEntries:(NSDictionary *)previousEntries error:(NSError **)errorOut;
+
+@end
+
+
+#pragma mark - Implementation
+
+@implementation PGManifest {
+    // File entries keyed by relative path
+    NSDictionary *_entries;
+}
+
+#pragma mark Hashing Files
+
++ (NSData *)digestOfFileAtPath:(NSString *)path error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    
+    int fileDescriptor = open([path fileSystemRepresentation], O_RDONLY);
+    if (fileDescriptor == -1) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return nil;
+    }
+    
+    struct stat fileStatus;
+    if (fstat(fileDescriptor, &fileStatus) == -1) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        close(fileDescriptor);
+        return nil;
+    }
+    
+    uint8_t digest[PGManifestDigestLength];
+    int errorNumber = PGManifestDigestFileDescriptor(fileDescriptor, fileStatus.st_size, digest);
+    close(fileDescriptor);
+    if (errorNumber != 0) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errorNumber userInfo:nil];
+        return nil;
+    }
+    
+    return [NSData dataWithBytes:digest length:sizeof(digest)];
+}
+
+
+#pragma mark Building Manifests
+
++ (PGManifest *)manifestWithDirectoryAtPath:(NSString *)path excludedRelativePaths:(NSSet *)excludedRelativePaths error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    return [self manifestWithDirectoryAtPath:path excludedRelativePaths:excludedRelativePaths ? excludedRelativePaths : [NSSet set]
+                             previousEntries:nil error:errorOut];
+}
+
+
++ (PGManifest *)manifestWithDirectoryAtPath:(NSString *)path excludedRelativePaths:(NSSet *)excludedRelativePaths 
+                             previousEntries:(NSDictionary *)previousEntries error:(NSError **)errorOut
+{
+    BOOL isDirectory = NO;
+    if (![[NSFileManager defaultManager] fileExistsAtPath:path isDirectory:&isDirectory] || !isDirectory) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileNoSuchFileError userInfo:nil];
+        return nil;
+    }
+    
+    // Gather every regular file's attributes. Anything else, e.g., a symbolic link, is left out, so a file replaced by one shows up as missing.
+    NSMutableDictionary *entries = [NSMutableDictionary dictionary];
+    NSDirectoryEnumerator *enumerator = [[NSFileManager defaultManager] enumeratorAtPath:path];
+    for (NSString *relativePath in enumerator) {
+        NSDictionary *attributes = [enumerator fileAttributes];
+        if ([excludedRelativePaths containsObject:relativePath]) {
+            if ([[attributes fileType] isEqualToString:NSFileTypeDirectory]) [enumerator skipDescendants];
+            continue;
+        }
+        
+        if (![[attributes fileType] isEqualToString:NSFileTypeRegular]) continue;
+        
+        NSMutableDictionary *entry = [NSMutableDictionary dictionaryWithObjectsAndKeys:
+                                      [NSNumber numberWithUnsignedLongLong:[attributes fileSize]], PGSizeManifestEntryKey, 
+                                      [attributes fileModificationDate], PGModificationDateManifestEntryKey, nil];
+        
+        NSDictionary *previousEntry = [previousEntries objectForKey:relativePath];
+        if ([[previousEntry objectForKey:PGSizeManifestEntryKey] isEqualToNumber:[entry objectForKey:PGSizeManifestEntryKey]] &&
+            [[previousEntry objectForKey:PGModificationDateManifestEntryKey] isEqualToDate:[entry objectForKey:PGModificationDateManifestEntryKey]]) {
+            [entry setObject:[previousEntry objectForKey:PGDigestManifestEntryKey] forKey:PGDigestManifestEntryKey];
+        }
+        
+        [entries setObject:entry forKey:relativePath];
+    }
+    
+    // Hash the files that need it concurrently. Each file's chunks are also hashed concurrently, so a few large files keep every core busy 
+    // just as well as many small ones.
+    NSMutableArray *pathsToHash = [NSMutableArray array];
+    for (NSString *relativePath in entries) {
+        if (![[entries objectForKey:relativePath] objectForKey:PGDigestManifestEntryKey]) [pathsToHash addObject:relativePath];
+    }
+    
+    __block NSError *hashError = nil;
+    dispatch_apply([pathsToHash count], dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        @autoreleasepool {
+            NSString *relativePath = [pathsToHash objectAtIndex:i];
+            NSError *error = nil;
+            NSData *digest = [self digestOfFileAtPath:[path stringByAppendingPathComponent:relativePath] error:&error];
+            
+            @synchronized (entries) {
+                if (digest) {
+                    [[entries objectForKey:relativePath] setObject:digest forKey:PGDigestManifestEntryKey];
+                } else if (!hashError) {
+                    hashError = error;
+                }
+            }
+        }
+    });
+    
+    if (hashError) {
+        if (errorOut) *errorOut = hashError;
+        return nil;
+    }
+    
+    return [[self alloc] initWithEntries:entries excludedRelativePaths:excludedRelativePaths];
+}
+
+
+// There’s no meaningful default values for our designated initializer, so we just don't recognize the -init message.
+- (id)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    return nil;
+}
+
+
+- (id)initWithEntries:(NSDictionary *)entries excludedRelativePaths:(NSSet *)excludedRelativePaths
+{
+    if (!(self = [super init])) return nil;
+    
+    _entries = [entries copy];
+    _excludedRelativePaths = [excludedRelativePaths copy];
+    _relativePaths = PGManifestSortedPaths([entries allKeys]);
+    _rootDigest = PGManifestRootDigest(_relativePaths, _entries);
+    return self;
+}
+
+
+- (PGManifest *)manifestByUpdatingWithDirectoryAtPath:(NSString *)path options:(PGManifestOptions)options error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    PGManifest *manifest = [[self class] manifestWithDirectoryAtPath:path excludedRelativePaths:_excludedRelativePaths 
+                                                     previousEntries:(options & PGManifestRehashAllFiles) ? nil : _entries error:errorOut];
+    
+    // Keep the key derivation parameters, so that writing the new manifest doesn't have to calibrate new ones
+    [manifest setKeyDerivationSalt:[self keyDerivationSalt]];
+    [manifest setKeyDerivationRounds:[self keyDerivationRounds]];
+    return manifest;
+}
+
+
+#pragma mark Reading and Writing
+
+- (id)initWithContentsOfFile:(NSString *)path error:(NSError **)errorOut
+{
+    return [self initWithContentsOfFile:path password:nil error:errorOut];
+}
+
+
+- (id)initWithContentsOfFile:(NSString *)path password:(NSString *)password error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    
+    NSData *data = [NSData dataWithContentsOfFile:path options:0 error:errorOut];
+    if (!data) return nil;
+    
+    NSDictionary *plist = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:NULL];
+    if (![plist isKindOfClass:[NSDictionary class]] || [[plist objectForKey:PGVersionManifestKey] unsignedIntegerValue] != PGManifestVersion) {
+        if (errorOut) *errorOut = PGManifestMalformedError();
+        return nil;
+    }
+    
+    NSDictionary *entries = [plist objectForKey:PGFilesManifestKey];
+    NSArray *excludedRelativePaths = [plist objectForKey:PGExcludedPathsManifestKey];
+    NSData *rootDigest = [plist objectForKey:PGRootDigestManifestKey];
+    NSData *salt = [plist objectForKey:PGSaltManifestKey];
+    NSNumber *rounds = [plist objectForKey:PGRoundsManifestKey];
+    NSData *authenticationCode = [plist objectForKey:PGAuthenticationCodeManifestKey];
+    BOOL valid = [entries isKindOfClass:[NSDictionary class]] && [excludedRelativePaths isKindOfClass:[NSArray class]] && 
+        [rootDigest isKindOfClass:[NSData class]] && (!salt || [salt isKindOfClass:[NSData class]]) && 
+        (!rounds || [rounds isKindOfClass:[NSNumber class]]) && (!authenticationCode || [authenticationCode isKindOfClass:[NSData class]]);
+    
+    if (valid) {
+        for (NSString *relativePath in entries) {
+            NSDictionary *entry = [entries objectForKey:relativePath];
+            if (![entry isKindOfClass:[NSDictionary class]] || ![[entry objectForKey:PGSizeManifestEntryKey] isKindOfClass:[NSNumber class]] ||
+                ![[entry objectForKey:PGModificationDateManifestEntryKey] isKindOfClass:[NSDate class]] ||
+                ![[entry objectForKey:PGDigestManifestEntryKey] isKindOfClass:[NSData class]] || 
+                [[entry objectForKey:PGDigestManifestEntryKey] length] != PGManifestDigestLength) {
+                valid = NO;
+                break;
+            }
+        }
+    }
+    
+    if (!valid) {
+        if (errorOut) *errorOut = PGManifestMalformedError();
+        return nil;
+    }
+    
+    // The recorded root digest must be the one the entries produce, which catches corruption. It doesn't catch tampering, since anyone can 
+    // recompute an unkeyed digest; only the authentication code, which can't be computed without the password, does that.
+    self = [self initWithEntries:entries excludedRelativePaths:[NSSet setWithArray:excludedRelativePaths]];
+    if (self && ![_rootDigest isEqualToData:rootDigest]) {
+        if (errorOut) *errorOut = PGManifestMalformedError();
+        return nil;
+    }
+    
+    if (self && password) {
+        NSError *error = nil;
+        NSData *expectedAuthenticationCode = salt && rounds && authenticationCode ? 
+            PGManifestAuthenticationCode(_rootDigest, password, salt, rounds, &error) : nil;
+        if (![expectedAuthenticationCode isEqualToDataInConstantTime:authenticationCode]) {
+            if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperManifestMismatchError 
+                                        userInfoObjectsAndKeys:NSLocalizedString(@"The manifest isn't authentic.", nil), NSLocalizedDescriptionKey, 
+                                       error, NSUnderlyingErrorKey, nil];
+            return nil;
+        }
+        
+        [self setKeyDerivationSalt:salt];
+        [self setKeyDerivationRounds:rounds];
+    }
+    
+    return self;
+}
+
+
+- (BOOL)writeToFile:(NSString *)path error:(NSError **)errorOut
+{
+    return [self writeToFile:path password:nil error:errorOut];
+}
+
+
+- (BOOL)writeToFile:(NSString *)path password:(NSString *)password error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    
+    NSMutableDictionary *plist = [NSMutableDictionary dictionaryWithObjectsAndKeys:[NSNumber numberWithUnsignedInteger:PGManifestVersion], 
+                                  PGVersionManifestKey, _rootDigest, PGRootDigestManifestKey, 
+                                  PGManifestSortedPaths([_excludedRelativePaths allObjects]), PGExcludedPathsManifestKey, _entries, 
+                                  PGFilesManifestKey, nil];
+    
+    NSError *error = nil;
+    if (password) {
+        NSData *salt = [self keyDerivationSalt];
+        NSNumber *rounds = [self keyDerivationRounds];
+        if (!salt || !rounds) {
+            salt = [NSData randomDataOfLength:PGKeyDerivationSaltLength];
+            rounds = [NSData calibratedRoundsForPasswordLength:[password length]];
+        }
+        
+        NSData *authenticationCode = PGManifestAuthenticationCode(_rootDigest, password, salt, rounds, errorOut);
+        if (!authenticationCode) return NO;
+        
+        [plist setObject:salt forKey:PGSaltManifestKey];
+        [plist setObject:rounds forKey:PGRoundsManifestKey];
+        [plist setObject:authenticationCode forKey:PGAuthenticationCodeManifestKey];
+    }
+    
+    // Manifests of large directories have many entries, so use the compact binary format
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:plist format:NSPropertyListBinaryFormat_v1_0 options:0 error:&error];
+    if (!data || ![data writeToFile:path options:NSDataWritingAtomic error:&error]) {
+        if (errorOut) *errorOut = error;
+        return NO;
+    }
+    
+    return YES;
+}
+
+
+#pragma mark Comparing Manifests
+
+- (NSData *)digestForRelativePath:(NSString *)relativePath
+{
+    return [[_entries objectForKey:relativePath] objectForKey:PGDigestManifestEntryKey];
+}
+
+
+- (NSArray *)relativePathsOfFilesDifferingFromManifest:(PGManifest *)manifest
+{
+    NSAssert(manifest, @"nil manifest");
+    
+    NSMutableSet *differingPaths = [NSMutableSet set];
+    for (NSString *relativePath in _relativePaths) {
+        NSData *digest = [manifest digestForRelativePath:relativePath];
+        if (!digest || ![digest isEqualToData:[self digestForRelativePath:relativePath]]) [differingPaths addObject:relativePath];
+    }
+    
+    for (NSString *relativePath in [manifest relativePaths]) {
+        if (![self digestForRelativePath:relativePath]) [differingPaths addObject:relativePath];
+    }
+    
+    return PGManifestSortedPaths([differingPaths allObjects]);
+}
+
+@end
@@ -0,0 +1,447 @@
+//
+//  PGOpenSSLCryptoProvider.c
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include "PGCryptoProvider.h"
+
+#if PGCRYPTO_OPENSSL
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+
+#pragma mark Constants
+
+enum {
+    /*!
+     @abstract The largest number of bytes passed to a single EVP update call.
+     @discussion EVP takes int lengths, so longer inputs are split. This is a multiple of the block size so that chunks stay block-aligned.
+     */
+    PGOpenSSLMaximumChunkLength = 1 << 30
+};
+
+/*! @abstract The minimum time in nanoseconds that a calibration probe must take for its timing to be trusted. */
+static const uint64_t PGOpenSSLCalibrationMinimumProbeTime = 10 * 1000 * 1000;
+
+/*! @abstract The initialization vector used in place of a NULL one, which CommonCrypto treats as zeros. */
+static const uint8_t PGOpenSSLZeroInitializationVector[PGCryptoAESBlockSize] = { 0 };
+
+
+#pragma mark Random Bytes
+
+static PGCryptoStatus PGOpenSSLRandomBytes(void *buffer, size_t length)
+{
+    while (length > 0) {
+        int chunkLength = length < PGOpenSSLMaximumChunkLength ? (int)length : PGOpenSSLMaximumChunkLength;
+        if (RAND_bytes(buffer, chunkLength) != 1) return PGCryptoMemoryError;
+        
+        buffer = (uint8_t *)buffer + chunkLength;
+        length -= chunkLength;
+    }
+    
+    return PGCryptoSuccess;
+}
+
+
+#pragma mark Digests and HMAC
+
+/*!
+ @abstract Returns the EVP message digest for the specified algorithm.
+ @param algorithm The digest algorithm.
+ @return The message digest, or NULL if the algorithm is unknown.
+ */
+static const EVP_MD *PGOpenSSLMessageDigest(PGCryptoDigestAlgorithm algorithm)
+{
+    switch (algorithm) {
+        case PGCryptoDigestMD5:
+            return EVP_md5();
+        case PGCryptoDigestSHA1:
+            return EVP_sha1();
+        case PGCryptoDigestSHA224:
+            return EVP_sha224();
+        case PGCryptoDigestSHA256:
+            return EVP_sha256();
+        case PGCryptoDigestSHA384:
+            return EVP_sha384();
+        case PGCryptoDigestSHA512:
+            return EVP_sha512();
+    }
+    
+    return NULL;
+}
+
+
+static PGCryptoStatus PGOpenSSLDigest(PGCryptoDigestAlgorithm algorithm, const void *data, size_t length, void *digest)
+{
+    const EVP_MD *messageDigest = PGOpenSSLMessageDigest(algorithm);
+    if (!messageDigest) return PGCryptoParameterError;
+    
+    return EVP_Digest(data, length, digest, NULL, messageDigest, NULL) == 1 ? PGCryptoSuccess : PGCryptoMemoryError;
+}
+
+
+static PGCryptoStatus PGOpenSSLHMACSHA256(const void *key, size_t keyLength, const void *data, size_t length, void *mac)
+{
+    if (keyLength > INT_MAX) return PGCryptoParameterError;
+    return HMAC(EVP_sha256(), key, (int)keyLength, data, length, mac, NULL) ? PGCryptoSuccess : PGCryptoMemoryError;
+}
+
+
+#pragma mark Key Derivation
+
+static PGCryptoStatus PGOpenSSLDeriveKey(const void *password, size_t passwordLength, const void *salt, size_t saltLength, uint32_t rounds,
+                                         void *key, size_t keyLength)
+{
+    if (passwordLength > INT_MAX || saltLength > INT_MAX || rounds == 0 || rounds > INT_MAX || keyLength > INT_MAX) return PGCryptoParameterError;
+    
+    return PKCS5_PBKDF2_HMAC(password, (int)passwordLength, salt, (int)saltLength, (int)rounds, EVP_sha256(), (int)keyLength, key) == 1 ?
+        PGCryptoSuccess : PGCryptoParameterError;
+}
+
+
+/*! @abstract Returns the current time in nanoseconds from an arbitrary, monotonically increasing clock. */
+static uint64_t PGOpenSSLMonotonicTime(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+
+static uint32_t PGOpenSSLCalibrateRounds(size_t passwordLength, size_t saltLength, size_t keyLength, uint32_t milliseconds)
+{
+    // Derive a key from zeros with an increasing number of rounds until the derivation takes long enough to time reliably, then scale
+    uint8_t *buffer = calloc(passwordLength + saltLength + keyLength, 1);
+    uint8_t *password = buffer;
+    uint8_t *salt = buffer + passwordLength;
+    uint8_t *key = salt + saltLength;
+    
+    uint32_t rounds = 1000;
+    uint64_t elapsedTime = 0;
+    while (1) {
+        uint64_t startTime = PGOpenSSLMonotonicTime();
+        PGOpenSSLDeriveKey(password, passwordLength, salt, saltLength, rounds, key, keyLength);
+        elapsedTime = PGOpenSSLMonotonicTime() - startTime;
+        
+        if (elapsedTime >= PGOpenSSLCalibrationMinimumProbeTime || rounds > INT_MAX / 2) break;
+        rounds *= 2;
+    }
+    
+    free(buffer);
+    
+    uint64_t calibratedRounds = (uint64_t)rounds * milliseconds * 1000000 / (elapsedTime ? elapsedTime : 1);
+    if (calibratedRounds < 1) return 1;
+    return calibratedRounds > INT_MAX ? INT_MAX : (uint32_t)calibratedRounds;
+}
+
+
+#pragma mark Ciphers
+
+/*! @abstract The state behind an OpenSSL provider cipher. */
+typedef struct PGOpenSSLCipher {
+    EVP_CIPHER_CTX *context;
+    PGCryptoOperation operation;
+    bool padding;
+    
+    /*! @abstract The number of input bytes that EVP has buffered but not yet output. */
+    size_t bufferedLength;
+} PGOpenSSLCipher;
+
+
+static PGCryptoStatus PGOpenSSLCipherCreate(PGCryptoOperation operation, PGCryptoMode mode, bool padding, const void *key, size_t keyLength,
+                                            const void *initializationVector, PGCryptoCipherRef *cipherOut)
+{
+    const EVP_CIPHER *evpCipher = NULL;
+    switch (keyLength) {
+        case 16:
+            evpCipher = mode == PGCryptoModeECB ? EVP_aes_128_ecb() : EVP_aes_128_cbc();
+            break;
+        case 24:
+            evpCipher = mode == PGCryptoModeECB ? EVP_aes_192_ecb() : EVP_aes_192_cbc();
+            break;
+        case 32:
+            evpCipher = mode == PGCryptoModeECB ? EVP_aes_256_ecb() : EVP_aes_256_cbc();
+            break;
+        default:
+            return PGCryptoParameterError;
+    }
+    
+    if (!initializationVector) initializationVector = PGOpenSSLZeroInitializationVector;
+    
+    EVP_CIPHER_CTX *context = EVP_CIPHER_CTX_new();
+    if (!context) return PGCryptoMemoryError;
+    
+    if (EVP_CipherInit_ex(context, evpCipher, NULL, key, initializationVector, operation == PGCryptoEncrypt) != 1) {
+        EVP_CIPHER_CTX_free(context);
+        return PGCryptoParameterError;
+    }
+    
+    EVP_CIPHER_CTX_set_padding(context, padding);
+    
+    PGOpenSSLCipher *cipher = malloc(sizeof(PGOpenSSLCipher));
+    if (!cipher) {
+        EVP_CIPHER_CTX_free(context);
+        return PGCryptoMemoryError;
+    }
+    
+    cipher->context = context;
+    cipher->operation = operation;
+    cipher->padding = padding;
+    cipher->bufferedLength = 0;
+    
+    *cipherOut = cipher;
+    return PGCryptoSuccess;
+}
+
+
+static PGCryptoStatus PGOpenSSLCipherReset(PGCryptoCipherRef cipherRef, const void *initializationVector)
+{
+    PGOpenSSLCipher *cipher = cipherRef;
+    
+    if (!initializationVector) initializationVector = PGOpenSSLZeroInitializationVector;
+    
+    // Reinitializing without a cipher or key keeps both but discards buffered input and installs the new initialization vector
+    if (EVP_CipherInit_ex(cipher->context, NULL, NULL, NULL, initializationVector, -1) != 1) return PGCryptoParameterError;
+    EVP_CIPHER_CTX_set_padding(cipher->context, cipher->padding);
+    
+    cipher->bufferedLength = 0;
+    return PGCryptoSuccess;
+}
+
+
+static size_t PGOpenSSLCipherOutputLength(PGCryptoCipherRef cipherRef, size_t inputLength, bool final)
+{
+    PGOpenSSLCipher *cipher = cipherRef;
+    size_t totalLength = cipher->bufferedLength + inputLength;
+    
+    // Updates only output whole blocks. Finishing outputs the rest, plus a block of padding when encrypting.
+    if (!final) return totalLength - totalLength % PGCryptoAESBlockSize;
+    if (cipher->padding && cipher->operation == PGCryptoEncrypt) return (totalLength / PGCryptoAESBlockSize + 1) * PGCryptoAESBlockSize;
+    return totalLength;
+}
+
+
+static PGCryptoStatus PGOpenSSLCipherUpdate(PGCryptoCipherRef cipherRef, const void *input, size_t inputLength, void *output, 
+                                            size_t outputCapacity, size_t *outputLengthOut)
+{
+    PGOpenSSLCipher *cipher = cipherRef;
+    
+    // EVP doesn't know how big the output buffer is, so check up front
+    size_t requiredLength = PGOpenSSLCipherOutputLength(cipher, inputLength, false);
+    if (outputCapacity < requiredLength) {
+        *outputLengthOut = requiredLength;
+        return PGCryptoBufferTooSmallError;
+    }
+    
+    size_t outputLength = 0;
+    for (size_t offset = 0; offset < inputLength; ) {
+        int chunkLength = inputLength - offset < PGOpenSSLMaximumChunkLength ? (int)(inputLength - offset) : PGOpenSSLMaximumChunkLength;
+        int chunkOutputLength = 0;
+        if (EVP_CipherUpdate(cipher->context, (uint8_t *)output + outputLength, &chunkOutputLength, (const uint8_t *)input + offset, 
+                             chunkLength) != 1) {
+            return PGCryptoParameterError;
+        }
+        
+        offset += chunkLength;
+        outputLength += chunkOutputLength;
+    }
+    
+    cipher->bufferedLength = cipher->bufferedLength + inputLength - outputLength;
+    *outputLengthOut = outputLength;
+    return PGCryptoSuccess;
+}
+
+
+static PGCryptoStatus PGOpenSSLCipherFinal(PGCryptoCipherRef cipherRef, void *output, size_t outputCapacity, size_t *outputLengthOut)
+{
+    PGOpenSSLCipher *cipher = cipherRef;
+    
+    size_t requiredLength = PGOpenSSLCipherOutputLength(cipher, 0, true);
+    if (outputCapacity < requiredLength) {
+        *outputLengthOut = requiredLength;
+        return PGCryptoBufferTooSmallError;
+    }
+    
+    // Without padding, leftover input can't be processed. With it, a failure when decrypting means the padding was bad.
+    if (!cipher->padding && cipher->bufferedLength % PGCryptoAESBlockSize != 0) return PGCryptoAlignmentError;
+    
+    int outputLength = 0;
+    if (EVP_CipherFinal_ex(cipher->context, output, &outputLength) != 1) {
+        return cipher->operation == PGCryptoDecrypt ? PGCryptoDecodeError : PGCryptoAlignmentError;
+    }
+    
+    cipher->bufferedLength = 0;
+    *outputLengthOut = outputLength;
+    return PGCryptoSuccess;
+}
+
+
+static void PGOpenSSLCipherRelease(PGCryptoCipherRef cipherRef)
+{
+    PGOpenSSLCipher *cipher = cipherRef;
+    EVP_CIPHER_CTX_free(cipher->context);
+    free(cipher);
+}
+
+
+#pragma mark Authenticated Encryption
+
+/*!
+ @abstract Returns the EVP AES-GCM cipher for the specified key length.
+ @param keyLength The key length in bytes.
+ @return The cipher, or NULL if the key length isn't 16, 24, or 32.
+ */
+static const EVP_CIPHER *PGOpenSSLGCMCipher(size_t keyLength)
+{
+    switch (keyLength) {
+        case 16:
+            return EVP_aes_128_gcm();
+        case 24:
+            return EVP_aes_192_gcm();
+        case 32:
+            return EVP_aes_256_gcm();
+    }
+    
+    return NULL;
+}
+
+
+/*!
+ @abstract Feeds input to an initialized GCM context in chunks that fit in an int.
+ @discussion If output is NULL, the input is authenticated as associated data. Otherwise, it's encrypted or decrypted into output.
+ @return Whether every update succeeded.
+ */
+static bool PGOpenSSLGCMUpdate(EVP_CIPHER_CTX *context, const void *input, size_t length, void *output)
+{
+    for (size_t offset = 0; offset < length; ) {
+        int chunkLength = length - offset < PGOpenSSLMaximumChunkLength ? (int)(length - offset) : PGOpenSSLMaximumChunkLength;
+        int outputLength = 0;
+        if (EVP_CipherUpdate(context, output ? (uint8_t *)output + offset : NULL, &outputLength, (const uint8_t *)input + offset, 
+                             chunkLength) != 1) {
+            return false;
+        }
+        
+        offset += chunkLength;
+    }
+    
+    return true;
+}
+
+
+static PGCryptoStatus PGOpenSSLGCMSeal(const void *key, size_t keyLength, const void *nonce, const void *associatedData, 
+                                       size_t associatedDataLength, const void *input, size_t length, void *output, void *tag)
+{
+    // EVP's GCM implementation uses AES-NI and carry-less multiplication when they're available, and interleaves blocks, since CTR mode 
+    // doesn't chain them
+    const EVP_CIPHER *evpCipher = PGOpenSSLGCMCipher(keyLength);
+    if (!evpCipher) return PGCryptoParameterError;
+    
+    EVP_CIPHER_CTX *context = EVP_CIPHER_CTX_new();
+    if (!context) return PGCryptoMemoryError;
+    
+    // GCM doesn't pad, so finishing never outputs anything, but EVP still wants somewhere to put it
+    uint8_t finalBlock[PGCryptoAESBlockSize];
+    int finalLength = 0;
+    bool success = EVP_EncryptInit_ex(context, evpCipher, NULL, NULL, NULL) == 1 &&
+        EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_SET_IVLEN, PGCryptoAESGCMNonceLength, NULL) == 1 &&
+        EVP_EncryptInit_ex(context, NULL, NULL, key, nonce) == 1 &&
+        PGOpenSSLGCMUpdate(context, associatedData, associatedDataLength, NULL) &&
+        PGOpenSSLGCMUpdate(context, input, length, output) &&
+        EVP_EncryptFinal_ex(context, finalBlock, &finalLength) == 1 &&
+        EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_GET_TAG, PGCryptoAESGCMTagLength, tag) == 1;
+    
+    EVP_CIPHER_CTX_free(context);
+    return success ? PGCryptoSuccess : PGCryptoParameterError;
+}
+
+
+static PGCryptoStatus PGOpenSSLGCMOpen(const void *key, size_t keyLength, const void *nonce, const void *associatedData, 
+                                       size_t associatedDataLength, const void *input, size_t length, const void *tag, void *output)
+{
+    const EVP_CIPHER *evpCipher = PGOpenSSLGCMCipher(keyLength);
+    if (!evpCipher) return PGCryptoParameterError;
+    
+    EVP_CIPHER_CTX *context = EVP_CIPHER_CTX_new();
+    if (!context) return PGCryptoMemoryError;
+    
+    // EVP_CIPHER_CTX_ctrl takes a non-const tag, but only copies it when setting
+    bool success = EVP_DecryptInit_ex(context, evpCipher, NULL, NULL, NULL) == 1 &&
+        EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_SET_IVLEN, PGCryptoAESGCMNonceLength, NULL) == 1 &&
+        EVP_DecryptInit_ex(context, NULL, NULL, key, nonce) == 1 &&
+        PGOpenSSLGCMUpdate(context, associatedData, associatedDataLength, NULL) &&
+        PGOpenSSLGCMUpdate(context, input, length, output) &&
+        EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_SET_TAG, PGCryptoAESGCMTagLength, (void *)tag) == 1;
+    
+    // Finishing verifies the tag
+    uint8_t finalBlock[PGCryptoAESBlockSize];
+    int finalLength = 0;
+    PGCryptoStatus result = success ? PGCryptoSuccess : PGCryptoParameterError;
+    if (success && EVP_DecryptFinal_ex(context, finalBlock, &finalLength) != 1) result = PGCryptoDecodeError;
+    
+    EVP_CIPHER_CTX_free(context);
+    if (result != PGCryptoSuccess && length > 0) memset(output, 0, length);
+    return result;
+}
+
+
+#pragma mark - Provider
+
+static const PGCryptoProvider PGOpenSSLProvider = {
+    "OpenSSL",
+    PGOpenSSLRandomBytes,
+    PGOpenSSLDigest,
+    PGOpenSSLHMACSHA256,
+    PGOpenSSLDeriveKey,
+    PGOpenSSLCalibrateRounds,
+    PGOpenSSLCipherCreate,
+    PGOpenSSLCipherReset,
+    PGOpenSSLCipherOutputLength,
+    PGOpenSSLCipherUpdate,
+    PGOpenSSLCipherFinal,
+    PGOpenSSLCipherRelease,
+    PGOpenSSLGCMSeal,
+    PGOpenSSLGCMOpen
+};
+
+
+const PGCryptoProvider *PGCryptoOpenSSLProvider(void)
+{
+    return &PGOpenSSLProvider;
+}
+
+#else
+
+const PGCryptoProvider *PGCryptoOpenSSLProvider(void)
+{
+    return NULL;
+}
+
+#endif
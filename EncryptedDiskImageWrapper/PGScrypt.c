@@ -0,0 +1,351 @@
+//
+//  PGScrypt.c
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include "PGScrypt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#include <mach/mach_time.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "PGKeyArena.h"
+
+
+#pragma mark Constants and Types
+
+const size_t PGScryptMaximumMemoryLength = (size_t)1 << 30;
+
+/*! @abstract The minimum time, in nanoseconds, that a calibration probe must take before it's scaled up to the target time. */
+static const uint64_t PGScryptCalibrationMinimumProbeTime = 20000000;
+
+/*! @abstract The largest cost parameter that's supported. Integerify only uses the low 32 bits of the last block, so N must be less than 2^32. */
+static const uint32_t PGScryptMaximumCost = (uint32_t)1 << 31;
+
+/*! @abstract The state shared by the lanes of a derivation. */
+typedef struct PGScryptContext {
+    /*! @abstract The lanes' blocks, each 128 * blockSize bytes, which are mixed in place. */
+    uint8_t *blocks;
+    
+    /*! @abstract The lanes' workspaces, each of which holds cost + 2 blocks of 32 * blockSize words. */
+    uint32_t *workspaces;
+    
+    uint32_t cost;
+    uint32_t blockSize;
+} PGScryptContext;
+
+
+#pragma mark Functions
+
+/*! @abstract Returns the 32-bit little-endian integer at the specified address. */
+static inline uint32_t PGScryptDecodeLittleEndian(const uint8_t *bytes)
+{
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+
+/*! @abstract Stores the specified integer at the specified address in little-endian byte order. */
+static inline void PGScryptEncodeLittleEndian(uint8_t *bytes, uint32_t value)
+{
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+    bytes[2] = (uint8_t)(value >> 16);
+    bytes[3] = (uint8_t)(value >> 24);
+}
+
+
+/*! @abstract Returns value rotated left by the specified number of bits. */
+static inline uint32_t PGScryptRotate(uint32_t value, unsigned bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+
+/*!
+ @abstract Applies the Salsa20/8 core to the specified 64-byte block in place.
+ @param block The block, as 16 words in host byte order.
+ */
+static void PGScryptSalsa208(uint32_t block[16])
+{
+    uint32_t x[16];
+    memcpy(x, block, sizeof(x));
+    
+    for (unsigned i = 0; i < 8; i += 2) {
+        // Columns
+        x[4] ^= PGScryptRotate(x[0] + x[12], 7);    x[8] ^= PGScryptRotate(x[4] + x[0], 9);
+        x[12] ^= PGScryptRotate(x[8] + x[4], 13);   x[0] ^= PGScryptRotate(x[12] + x[8], 18);
+        x[9] ^= PGScryptRotate(x[5] + x[1], 7);     x[13] ^= PGScryptRotate(x[9] + x[5], 9);
+        x[1] ^= PGScryptRotate(x[13] + x[9], 13);   x[5] ^= PGScryptRotate(x[1] + x[13], 18);
+        x[14] ^= PGScryptRotate(x[10] + x[6], 7);   x[2] ^= PGScryptRotate(x[14] + x[10], 9);
+        x[6] ^= PGScryptRotate(x[2] + x[14], 13);   x[10] ^= PGScryptRotate(x[6] + x[2], 18);
+        x[3] ^= PGScryptRotate(x[15] + x[11], 7);   x[7] ^= PGScryptRotate(x[3] + x[15], 9);
+        x[11] ^= PGScryptRotate(x[7] + x[3], 13);   x[15] ^= PGScryptRotate(x[11] + x[7], 18);
+        
+        // Rows
+        x[1] ^= PGScryptRotate(x[0] + x[3], 7);     x[2] ^= PGScryptRotate(x[1] + x[0], 9);
+        x[3] ^= PGScryptRotate(x[2] + x[1], 13);    x[0] ^= PGScryptRotate(x[3] + x[2], 18);
+        x[6] ^= PGScryptRotate(x[5] + x[4], 7);     x[7] ^= PGScryptRotate(x[6] + x[5], 9);
+        x[4] ^= PGScryptRotate(x[7] + x[6], 13);    x[5] ^= PGScryptRotate(x[4] + x[7], 18);
+        x[11] ^= PGScryptRotate(x[10] + x[9], 7);   x[8] ^= PGScryptRotate(x[11] + x[10], 9);
+        x[9] ^= PGScryptRotate(x[8] + x[11], 13);   x[10] ^= PGScryptRotate(x[9] + x[8], 18);
+        x[12] ^= PGScryptRotate(x[15] + x[14], 7);  x[13] ^= PGScryptRotate(x[12] + x[15], 9);
+        x[14] ^= PGScryptRotate(x[13] + x[12], 13); x[15] ^= PGScryptRotate(x[14] + x[13], 18);
+    }
+    
+    for (unsigned i = 0; i < 16; ++i) block[i] += x[i];
+}
+
+
+/*!
+ @abstract Applies scryptBlockMix with Salsa20/8 to the specified block in place.
+ @param block The block of 2 * blockSize 64-byte sub-blocks, as words in host byte order.
+ @param scratch A buffer the same size as block.
+ @param blockSize The block size parameter (r).
+ */
+static void PGScryptBlockMix(uint32_t *block, uint32_t *scratch, uint32_t blockSize)
+{
+    uint32_t x[16];
+    memcpy(x, &block[(2 * blockSize - 1) * 16], sizeof(x));
+    
+    for (size_t i = 0; i < 2 * blockSize; ++i) {
+        for (unsigned j = 0; j < 16; ++j) x[j] ^= block[i * 16 + j];
+        PGScryptSalsa208(x);
+        memcpy(&scratch[i * 16], x, sizeof(x));
+    }
+    
+    // Even sub-blocks make up the first half of the output and odd ones the second
+    for (size_t i = 0; i < blockSize; ++i) {
+        memcpy(&block[i * 16], &scratch[2 * i * 16], sizeof(x));
+        memcpy(&block[(blockSize + i) * 16], &scratch[(2 * i + 1) * 16], sizeof(x));
+    }
+}
+
+
+/*!
+ @abstract Applies scryptROMix to one lane's block in place. This is the memory-hard part of the derivation.
+ @discussion Invoked concurrently by PGScryptMixLanes(), once for each lane.
+ @param context The derivation's PGScryptContext.
+ @param lane The index of the lane.
+ */
+static void PGScryptMixLane(void *context, size_t lane)
+{
+    const PGScryptContext *scryptContext = context;
+    uint32_t cost = scryptContext->cost;
+    uint32_t blockSize = scryptContext->blockSize;
+    size_t blockWords = 32 * (size_t)blockSize;
+    
+    uint8_t *bytes = scryptContext->blocks + lane * blockWords * sizeof(uint32_t);
+    uint32_t *v = scryptContext->workspaces + lane * ((size_t)cost + 2) * blockWords;
+    uint32_t *x = v + (size_t)cost * blockWords;
+    uint32_t *scratch = x + blockWords;
+    
+    for (size_t k = 0; k < blockWords; ++k) x[k] = PGScryptDecodeLittleEndian(&bytes[k * 4]);
+    
+    // Fill V sequentially, then read it back in an order that depends on its contents
+    for (size_t i = 0; i < cost; ++i) {
+        memcpy(&v[i * blockWords], x, blockWords * sizeof(uint32_t));
+        PGScryptBlockMix(x, scratch, blockSize);
+    }
+    
+    for (size_t i = 0; i < cost; ++i) {
+        const uint32_t *vj = &v[(size_t)(x[(2 * blockSize - 1) * 16] & (cost - 1)) * blockWords];
+        for (size_t k = 0; k < blockWords; ++k) x[k] ^= vj[k];
+        PGScryptBlockMix(x, scratch, blockSize);
+    }
+    
+    for (size_t k = 0; k < blockWords; ++k) PGScryptEncodeLittleEndian(&bytes[k * 4], x[k]);
+}
+
+
+#if !defined(__APPLE__)
+/*! @abstract The state shared by the threads that mix a derivation's lanes without GCD. */
+typedef struct PGScryptLaneQueue {
+    /*! @abstract The derivation's context. */
+    PGScryptContext *context;
+    
+    /*! @abstract Protects nextLane. */
+    pthread_mutex_t mutex;
+    
+    /*! @abstract The index of the next lane to mix. */
+    size_t nextLane;
+    
+    /*! @abstract The number of lanes. */
+    size_t laneCount;
+} PGScryptLaneQueue;
+
+
+/*!
+ @abstract Mixes lanes from the specified lane queue until none are left.
+ @param laneQueue The PGScryptLaneQueue to take lanes from.
+ @return NULL.
+ */
+static void *PGScryptMixQueuedLanes(void *laneQueue)
+{
+    PGScryptLaneQueue *queue = laneQueue;
+    for (;;) {
+        pthread_mutex_lock(&queue->mutex);
+        size_t lane = queue->nextLane < queue->laneCount ? queue->nextLane++ : SIZE_MAX;
+        pthread_mutex_unlock(&queue->mutex);
+        
+        if (lane == SIZE_MAX) return NULL;
+        PGScryptMixLane(queue->context, lane);
+    }
+}
+#endif
+
+
+/*!
+ @abstract Mixes each of a derivation's lanes, concurrently where possible.
+ @discussion Uses dispatch_apply_f on Apple platforms. Elsewhere, up to one thread per online processor takes lanes from a shared counter, 
+     and the calling thread mixes any lanes that are left if threads can't be created.
+ @param context The derivation's context.
+ @param lanes The number of lanes.
+ */
+static void PGScryptMixLanes(PGScryptContext *context, uint32_t lanes)
+{
+#if defined(__APPLE__)
+    dispatch_apply_f(lanes, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), context, PGScryptMixLane);
+#else
+    PGScryptLaneQueue queue = { context, PTHREAD_MUTEX_INITIALIZER, 0, lanes };
+    
+    long processorCount = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t threadCount = processorCount > 1 ? (size_t)processorCount - 1 : 0;
+    if (threadCount > lanes - 1) threadCount = lanes - 1;
+    
+    pthread_t threads[threadCount > 0 ? threadCount : 1];
+    size_t startedCount = 0;
+    while (startedCount < threadCount && pthread_create(&threads[startedCount], NULL, PGScryptMixQueuedLanes, &queue) == 0) {
+        ++startedCount;
+    }
+    
+    PGScryptMixQueuedLanes(&queue);
+    for (size_t i = 0; i < startedCount; ++i) pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&queue.mutex);
+#endif
+}
+
+
+size_t PGScryptMemoryLength(uint32_t cost, uint32_t blockSize, uint32_t lanes)
+{
+    // Each lane needs V's cost blocks plus two more for mixing, and the lanes' input blocks take one more apiece
+    uint64_t laneBlocks = (uint64_t)cost + 3;
+    uint64_t blockLength = 128 * (uint64_t)blockSize;
+    if (lanes != 0 && blockLength != 0 && laneBlocks > UINT64_MAX / blockLength / lanes) return SIZE_MAX;
+    
+    uint64_t length = laneBlocks * blockLength * lanes;
+    return length > SIZE_MAX ? SIZE_MAX : (size_t)length;
+}
+
+
+PGCryptoStatus PGScryptDeriveKey(const void *password, size_t passwordLength, const void *salt, size_t saltLength, uint32_t cost, 
+                                 uint32_t blockSize, uint32_t lanes, void *key, size_t keyLength)
+{
+    if (cost < 2 || (cost & (cost - 1)) != 0 || cost > PGScryptMaximumCost || blockSize == 0 || lanes == 0 || 
+        (uint64_t)blockSize * lanes >= ((uint64_t)1 << 30) || PGScryptMemoryLength(cost, blockSize, lanes) > PGScryptMaximumMemoryLength) {
+        return PGCryptoParameterError;
+    }
+    
+    size_t blocksLength = 128 * (size_t)blockSize * lanes;
+    size_t workspacesLength = ((size_t)cost + 2) * 128 * blockSize * lanes;
+    uint8_t *blocks = malloc(blocksLength);
+    uint32_t *workspaces = malloc(workspacesLength);
+    if (!blocks || !workspaces) {
+        free(blocks);
+        free(workspaces);
+        return PGCryptoMemoryError;
+    }
+    
+    // Stretch the password into one block per lane, mix the lanes concurrently, and compress the mixed blocks into the key
+    const PGCryptoProvider *provider = PGCryptoDefaultProvider();
+    PGCryptoStatus status = provider->deriveKey(password, passwordLength, salt, saltLength, 1, blocks, blocksLength);
+    if (status == PGCryptoSuccess) {
+        PGScryptContext context = { blocks, workspaces, cost, blockSize };
+        PGScryptMixLanes(&context, lanes);
+        status = provider->deriveKey(password, passwordLength, blocks, blocksLength, 1, key, keyLength);
+    }
+    
+    PGKeyArenaZero(blocks, blocksLength);
+    PGKeyArenaZero(workspaces, workspacesLength);
+    free(blocks);
+    free(workspaces);
+    return status;
+}
+
+
+/*! @abstract Returns the current time in nanoseconds from an arbitrary, monotonically increasing clock. */
+static uint64_t PGScryptMonotonicTime(void)
+{
+#if defined(__APPLE__)
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0) mach_timebase_info(&timebase);
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+#endif
+}
+
+
+uint32_t PGScryptCalibrateCost(uint32_t blockSize, uint32_t lanes, uint32_t milliseconds, size_t maximumMemoryLength)
+{
+    if (maximumMemoryLength > PGScryptMaximumMemoryLength) maximumMemoryLength = PGScryptMaximumMemoryLength;
+    
+    // Derive a key with an increasing cost until the derivation takes long enough to time reliably. All the lanes run, so the time is 
+    // wall-clock time with whatever concurrency the machine can give them.
+    uint8_t key[PGCryptoHMACSHA256Length];
+    uint32_t cost = PGScryptMinimumCost;
+    uint64_t elapsedTime = 0;
+    while (1) {
+        uint64_t startTime = PGScryptMonotonicTime();
+        PGCryptoStatus status = PGScryptDeriveKey(NULL, 0, NULL, 0, cost, blockSize, lanes, key, sizeof(key));
+        elapsedTime = PGScryptMonotonicTime() - startTime;
+        
+        if (status != PGCryptoSuccess || elapsedTime >= PGScryptCalibrationMinimumProbeTime || cost >= PGScryptMaximumCost || 
+            PGScryptMemoryLength(cost * 2, blockSize, lanes) > maximumMemoryLength) {
+            break;
+        }
+        
+        cost *= 2;
+    }
+    
+    // Time is linear in the cost, so scale the probe up or down to the power of two whose estimated time is nearest the target
+    double costTime = (double)elapsedTime / cost;
+    double targetTime = (double)milliseconds * 1000000;
+    while (cost < PGScryptMaximumCost && PGScryptMemoryLength(cost * 2, blockSize, lanes) <= maximumMemoryLength && 
+           3 * costTime * cost < 2 * targetTime) {
+        cost *= 2;
+    }
+    
+    while (cost > PGScryptMinimumCost && 3 * costTime * cost > 4 * targetTime) cost /= 2;
+    return cost;
+}
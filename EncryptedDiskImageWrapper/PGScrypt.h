@@ -0,0 +1,94 @@
+//
+//  PGScrypt.h
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "PGCryptoProvider.h"
+
+/*
+ PGScrypt derives keys from passwords with scrypt (RFC 7914). Unlike PBKDF2, whose only cost is time, scrypt makes every guess fill and then 
+ randomly read back a buffer whose size is set by its cost parameter, so attackers can't trade memory for speed on GPUs or custom hardware. Its
+ parallelization parameter splits the work into independent lanes, each with its own buffer, which are mixed concurrently on GCD's global queue. 
+ On a many-core machine, a derivation with several lanes takes about as long as one with a single lane, but an attacker has to do all of them.
+ 
+ The PBKDF2-HMAC-SHA256 steps at either end of the derivation use the default crypto provider, so scrypt is available with any provider.
+ */
+
+enum {
+    /*! @abstract The block size parameter (r) recommended by the scrypt paper, which makes each block 1 KB. */
+    PGScryptDefaultBlockSize = 8,
+    
+    /*! @abstract The smallest cost parameter (N) that the calibrator chooses. */
+    PGScryptMinimumCost = 1 << 10
+};
+
+/*!
+ @abstract The most memory that a derivation may use.
+ @discussion Parameters are stored alongside the data they protect, so this keeps a corrupt or malicious user table entry from making a 
+     derivation exhaust memory.
+ */
+extern const size_t PGScryptMaximumMemoryLength;
+
+/*!
+ @abstract Returns the number of bytes of memory that a derivation with the specified parameters uses.
+ @param cost The cost parameter (N).
+ @param blockSize The block size parameter (r).
+ @param lanes The parallelization parameter (p).
+ @return The memory used by all the lanes together, or SIZE_MAX if that would overflow.
+ */
+extern size_t PGScryptMemoryLength(uint32_t cost, uint32_t blockSize, uint32_t lanes);
+
+/*!
+ @abstract Derives keyLength bytes of key from password and salt using scrypt.
+ @discussion All of the lanes' memory is allocated up front and zeroed before it is freed.
+ @param password The password. May only be NULL if passwordLength is 0.
+ @param passwordLength The length of the password in bytes.
+ @param salt The salt. May only be NULL if saltLength is 0.
+ @param saltLength The length of the salt in bytes.
+ @param cost The cost parameter (N), which must be a power of two greater than 1.
+ @param blockSize The block size parameter (r), which must be positive.
+ @param lanes The parallelization parameter (p), which must be positive. blockSize * lanes must be less than 2^30.
+ @param key The buffer into which to write the key. May not be NULL.
+ @param keyLength The length of the key in bytes.
+ @return PGCryptoSuccess; PGCryptoParameterError if the parameters are invalid or would use more than PGScryptMaximumMemoryLength bytes; 
+     PGCryptoMemoryError if the memory couldn't be allocated; or the default provider's status if PBKDF2 failed.
+ */
+extern PGCryptoStatus PGScryptDeriveKey(const void *password, size_t passwordLength, const void *salt, size_t saltLength, uint32_t cost, 
+                                        uint32_t blockSize, uint32_t lanes, void *key, size_t keyLength);
+
+/*!
+ @abstract Returns the cost parameter for which a derivation takes about the specified wall-clock time on this machine.
+ @discussion The derivation is timed with all of its lanes running concurrently, so the result accounts for the number of cores available to
+     them. The cost is rounded to the nearest power of two, is at least PGScryptMinimumCost, and is limited so that the derivation uses at most
+     maximumMemoryLength bytes; on machines fast enough to reach that limit, derivations take less than the target time.
+ @param blockSize The block size parameter (r).
+ @param lanes The parallelization parameter (p).
+ @param milliseconds The target wall-clock time of a derivation.
+ @param maximumMemoryLength The most memory that a derivation may use.
+ @return The calibrated cost parameter (N).
+ */
+extern uint32_t PGScryptCalibrateCost(uint32_t blockSize, uint32_t lanes, uint32_t milliseconds, size_t maximumMemoryLength);
@@ -0,0 +1,141 @@
+//
+//  PGTemplatePool.h
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+/*!
+ @abstract PGTemplatePool instances keep blank wrappers ready so that new wrappers can be created without waiting for hdiutil.
+ @discussion A template is a wrapper directory whose disk image or band store has been created with its own randomly generated master password, 
+     but which has no user table yet. Set a depth for each set of volume options with which wrappers will be created, and the pool prepares that many templates in
+     the background, running at most maximumPreparationCount preparations at once. Passing the pool to 
+     +createEncryptedDiskImageWrapperAtPath:masterPassword:user:password:volumeOptions:templatePool:error: claims one of its templates, so creating 
+     the wrapper only involves changing the template's master password to the one passed to the creation method, writing its user table, and 
+     renaming the template into place, and the pool then prepares a replacement. If any of that fails, the claimed template is removed.
+ 
+     Claims that are handed a template count as hits; those that find none ready count as misses and fall back to creating the wrapper with hdiutil. If preparing a template fails, the pool stops preparing templates with those volume options 
+     until the next claim for them, so that a persistent failure doesn't run hdiutil in a loop.
+ 
+     Templates are kept in the pool's directory, which should be on the same volume as the wrappers created from them so that claiming one is a 
+     rename rather than a copy. Templates' master passwords are only kept in memory, so templates are not reused across processes: initializing a 
+     pool removes any templates an earlier pool left in its directory, and pools may not share a directory. Invoke -removeAllTemplates: before 
+     the application terminates. Template pools are thread-safe.
+ */
+@interface PGTemplatePool : NSObject
+
+/*! @abstract The directory in which the pool keeps its templates. */
+@property(readonly, copy) NSString *directory;
+
+/*! @abstract The maximum number of templates that are prepared at once. Defaults to 1. */
+@property(readwrite) NSUInteger maximumPreparationCount;
+
+/*! @abstract The timeout of the pool's hdiutil tasks. If 0, the default, there is no timeout. */
+@property(readwrite) NSTimeInterval taskTimeout;
+
+/*!
+ @abstract Initializes a newly allocated template pool that keeps templates in the specified directory.
+ 
+ @param directory The directory in which to keep templates. It is created if it doesn't exist. Any templates already in it are removed. May not
+     be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return An initialized template pool, or nil if the directory could not be created.
+ */
+- (id)initWithDirectory:(NSString *)directory error:(NSError **)errorOut;
+
+/*!
+ @abstract Sets the number of templates to keep ready for the specified volume options and starts preparing any that are missing.
+ @discussion If the depth is lowered, surplus ready templates are removed.
+ 
+ @param depth The number of templates to keep ready. If 0, the pool stops keeping templates for the volume options.
+ @param volumeOptions The volume options with which the templates are created. May not be nil.
+ */
+- (void)setDepth:(NSUInteger)depth forVolumeOptions:(NSDictionary *)volumeOptions;
+
+/*!
+ @abstract Returns the number of templates the pool keeps ready for the specified volume options.
+ @param volumeOptions The volume options. May not be nil.
+ @return The depth set with -setDepth:forVolumeOptions:, or 0 if none was set.
+ */
+- (NSUInteger)targetDepthForVolumeOptions:(NSDictionary *)volumeOptions;
+
+/*!
+ @abstract Returns the number of templates that are ready to be claimed for the specified volume options.
+ @param volumeOptions The volume options. May not be nil.
+ @return The number of ready templates, which doesn't include those being prepared.
+ */
+- (NSUInteger)depthForVolumeOptions:(NSDictionary *)volumeOptions;
+
+/*!
+ @abstract Removes a ready template for the specified volume options from the pool and starts preparing its replacement.
+ @discussion The caller owns the returned directory and must move it into place or remove it. The pool keeps no copy of the template's master 
+     password once it has been claimed. This is normally only invoked by PGEncryptedDiskImageWrapper.
+ 
+ @param volumeOptions The volume options with which the wrapper is being created. May not be nil.
+ @param masterPasswordOut On input, a pointer to a string object. Upon return, points to the master password with which the template's disk image
+     or band store was created, or nil if no template is ready. May not be NULL.
+ 
+ @return The path of the template's directory, or nil if no template is ready.
+ */
+- (NSString *)claimTemplateForVolumeOptions:(NSDictionary *)volumeOptions masterPassword:(NSString **)masterPasswordOut;
+
+/*!
+ @abstract Waits until the pool has no templates being prepared.
+ @discussion This returns once every depth has been reached or preparation has stopped because of a failure.
+ */
+- (void)waitUntilIdle;
+
+/*!
+ @abstract Stops keeping templates for any volume options and removes every ready template.
+ @discussion This waits for templates that are being prepared to finish, and removes them too. Applications should invoke this before they 
+     terminate.
+ 
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether every template was removed.
+ */
+- (BOOL)removeAllTemplates:(NSError **)errorOut;
+
+/*!
+ @abstract Returns the number of claims that were handed a template.
+ @return The hit count.
+ */
+- (NSUInteger)hitCount;
+
+/*!
+ @abstract Returns the number of claims that found no template ready.
+ @return The miss count.
+ */
+- (NSUInteger)missCount;
+
+/*!
+ @abstract Returns the fraction of claims that were handed a template.
+ @return The hit count divided by the total number of claims, or 0 if there have been none.
+ */
+- (double)hitRate;
+
+@end
@@ -0,0 +1,430 @@
+//
+//  PGTemplatePool.m
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGTemplatePool.h"
+
+#import "NSData+Crypto.h"
+#import "NSError+ConvenienceInitializers.h"
+#import "PGEncryptedDiskImageWrapper.h"
+#import "PGErrors.h"
+
+
+#pragma mark Constants
+
+/*! @abstract The default maximum number of templates that are prepared at once. */
+static const NSUInteger PGTemplatePoolDefaultMaximumPreparationCount = 1;
+
+/*! @abstract The prefix of the names of template directories in a pool's directory. */
+static NSString *const PGTemplatePoolTemplatePrefix = @"Template.";
+
+
+#pragma mark - Entries
+
+/*!
+ @abstract PGTemplatePoolEntry instances track the templates a pool keeps for one set of volume options.
+ @discussion Entries are only accessed on their pool's queue.
+ */
+@interface PGTemplatePoolEntry : NSObject
+
+/*! @abstract The volume options with which the entry's templates are created. */
+@property(readonly, copy) NSDictionary *volumeOptions;
+
+/*! @abstract The number of templates to keep ready. */
+@property(readwrite) NSUInteger targetDepth;
+
+/*! @abstract The paths of the templates that are ready to be claimed, oldest first. */
+@property(readonly, strong) NSMutableArray *readyPaths;
+
+/*! @abstract The master passwords of the ready templates, keyed by their paths. */
+@property(readonly, strong) NSMutableDictionary *masterPasswords;
+
+/*! @abstract The number of templates being prepared. */
+@property(readwrite) NSUInteger preparingCount;
+
+/*! @abstract Whether preparation has stopped because the last attempt failed. Cleared by the next claim or depth change. */
+@property(readwrite, getter = isSuspended) BOOL suspended;
+
+/*!
+ @abstract Initializes a newly allocated entry with the specified volume options.
+ @param volumeOptions The volume options. May not be nil.
+ @return An initialized entry.
+ */
+- (id)initWithVolumeOptions:(NSDictionary *)volumeOptions;
+
+@end
+
+
+@implementation PGTemplatePoolEntry
+
+- (id)initWithVolumeOptions:(NSDictionary *)volumeOptions
+{
+    NSAssert(volumeOptions, @"nil volume options");
+    
+    if (!(self = [super init])) return nil;
+    
+    _volumeOptions = [volumeOptions copy];
+    _readyPaths = [[NSMutableArray alloc] init];
+    _masterPasswords = [[NSMutableDictionary alloc] init];
+    
+    return self;
+}
+
+@end
+
+
+#pragma mark - Private Methods Interface
+
+@interface PGTemplatePool ()
+
+/*!
+ @abstract Returns the entry for the specified volume options, creating it if necessary.
+ @discussion Must be invoked on the pool's queue.
+ @param volumeOptions The volume options. May not be nil.
+ @return The entry.
+ */
+- (PGTemplatePoolEntry *)entryForVolumeOptions:(NSDictionary *)volumeOptions;
+
+/*!
+ @abstract Starts preparing templates for entries that are below their target depth, up to the maximum preparation count.
+ @discussion Must be invoked on the pool's queue.
+ */
+- (void)refill;
+
+/*!
+ @abstract Starts preparing a template for the specified entry.
+ @discussion Must be invoked on the pool's queue. When the preparation finishes, the template is added to the entry's ready templates if the entry
+     still needs it, and the pool is refilled.
+ 
+ @param entry The entry for which to prepare a template. May not be nil.
+ */
+- (void)prepareTemplateForEntry:(PGTemplatePoolEntry *)entry;
+
+/*!
+ @abstract Removes ready templates from the specified entry until it has no more than its target depth.
+ @discussion Must be invoked on the pool's queue.
+ @param entry The entry whose surplus templates should be removed. May not be nil.
+ */
+- (void)removeSurplusTemplatesForEntry:(PGTemplatePoolEntry *)entry;
+
+@end
+
+
+#pragma mark -
+
+@implementation PGTemplatePool
+{
+    dispatch_queue_t _queue;
+    dispatch_group_t _preparationGroup;
+    NSMutableDictionary *_entries;
+    NSUInteger _preparingCount;
+    NSUInteger _hitCount;
+    NSUInteger _missCount;
+}
+
+@synthesize directory = _directory;
+@synthesize maximumPreparationCount = _maximumPreparationCount;
+@synthesize taskTimeout = _taskTimeout;
+
+- (id)init
+{
+    // There’s no meaningful default values for our designated initializer, so we just don't recognize the -init message.
+    [self doesNotRecognizeSelector:_cmd];
+    return nil;
+}
+
+
+- (id)initWithDirectory:(NSString *)directory error:(NSError **)errorOut
+{
+    NSAssert(directory, @"nil directory");
+    
+    NSError *error = nil;
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSDictionary *attributes = [NSDictionary dictionaryWithObject:[NSNumber numberWithShort:0700] forKey:NSFilePosixPermissions];
+    if (![fileManager createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:attributes error:&error]) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperCreationError userInfoObjectsAndKeys:error,
+                                   NSUnderlyingErrorKey, NSLocalizedString(@"Failed to create the template pool's directory.", nil), 
+                                   NSLocalizedDescriptionKey, nil];
+        return nil;
+    }
+    
+    // Templates' master passwords are only kept in memory, so templates left behind by an earlier pool, e.g., one whose process crashed, can 
+    // never be claimed
+    for (NSString *name in [fileManager contentsOfDirectoryAtPath:directory error:NULL]) {
+        if ([name hasPrefix:PGTemplatePoolTemplatePrefix]) [fileManager removeItemAtPath:[directory stringByAppendingPathComponent:name] error:NULL];
+    }
+    
+    if (!(self = [super init])) return nil;
+    
+    _directory = [directory copy];
+    _maximumPreparationCount = PGTemplatePoolDefaultMaximumPreparationCount;
+    _queue = dispatch_queue_create("com.quantumlenscap.PGTemplatePool", DISPATCH_QUEUE_SERIAL);
+    _preparationGroup = dispatch_group_create();
+    _entries = [[NSMutableDictionary alloc] init];
+    
+    return self;
+}
+
+
+- (void)dealloc
+{
+    dispatch_release(_preparationGroup);
+    dispatch_release(_queue);
+}
+
+
+- (NSUInteger)maximumPreparationCount
+{
+    @synchronized (self) {
+        return _maximumPreparationCount;
+    }
+}
+
+
+- (void)setMaximumPreparationCount:(NSUInteger)maximumPreparationCount
+{
+    @synchronized (self) {
+        _maximumPreparationCount = maximumPreparationCount;
+    }
+    
+    dispatch_async(_queue, ^{
+        [self refill];
+    });
+}
+
+
+#pragma mark Depths
+
+- (void)setDepth:(NSUInteger)depth forVolumeOptions:(NSDictionary *)volumeOptions
+{
+    NSAssert(volumeOptions, @"nil volume options");
+    
+    dispatch_sync(_queue, ^{
+        PGTemplatePoolEntry *entry = [self entryForVolumeOptions:volumeOptions];
+        [entry setTargetDepth:depth];
+        [entry setSuspended:NO];
+        [self removeSurplusTemplatesForEntry:entry];
+        [self refill];
+    });
+}
+
+
+- (NSUInteger)targetDepthForVolumeOptions:(NSDictionary *)volumeOptions
+{
+    NSAssert(volumeOptions, @"nil volume options");
+    
+    __block NSUInteger targetDepth = 0;
+    dispatch_sync(_queue, ^{
+        targetDepth = [[_entries objectForKey:volumeOptions] targetDepth];
+    });
+    
+    return targetDepth;
+}
+
+
+- (NSUInteger)depthForVolumeOptions:(NSDictionary *)volumeOptions
+{
+    NSAssert(volumeOptions, @"nil volume options");
+    
+    __block NSUInteger depth = 0;
+    dispatch_sync(_queue, ^{
+        depth = [[[_entries objectForKey:volumeOptions] readyPaths] count];
+    });
+    
+    return depth;
+}
+
+
+#pragma mark Claiming Templates
+
+- (NSString *)claimTemplateForVolumeOptions:(NSDictionary *)volumeOptions masterPassword:(NSString **)masterPasswordOut
+{
+    NSAssert(volumeOptions, @"nil volume options");
+    NSAssert(masterPasswordOut, @"NULL master password pointer");
+    
+    __block NSString *templatePath = nil;
+    __block NSString *masterPassword = nil;
+    dispatch_sync(_queue, ^{
+        PGTemplatePoolEntry *entry = [_entries objectForKey:volumeOptions];
+        if ([[entry readyPaths] count] == 0) {
+            ++_missCount;
+        } else {
+            ++_hitCount;
+            templatePath = [[entry readyPaths] objectAtIndex:0];
+            masterPassword = [[entry masterPasswords] objectForKey:templatePath];
+            [[entry readyPaths] removeObjectAtIndex:0];
+            [[entry masterPasswords] removeObjectForKey:templatePath];
+        }
+        
+        [entry setSuspended:NO];
+        [self refill];
+    });
+    
+    *masterPasswordOut = masterPassword;
+    return templatePath;
+}
+
+
+- (NSUInteger)hitCount
+{
+    __block NSUInteger hitCount = 0;
+    dispatch_sync(_queue, ^{
+        hitCount = _hitCount;
+    });
+    
+    return hitCount;
+}
+
+
+- (NSUInteger)missCount
+{
+    __block NSUInteger missCount = 0;
+    dispatch_sync(_queue, ^{
+        missCount = _missCount;
+    });
+    
+    return missCount;
+}
+
+
+- (double)hitRate
+{
+    __block double hitRate = 0.0;
+    dispatch_sync(_queue, ^{
+        if (_hitCount + _missCount > 0) hitRate = (double)_hitCount / (_hitCount + _missCount);
+    });
+    
+    return hitRate;
+}
+
+
+#pragma mark Preparing and Removing Templates
+
+- (PGTemplatePoolEntry *)entryForVolumeOptions:(NSDictionary *)volumeOptions
+{
+    PGTemplatePoolEntry *entry = [_entries objectForKey:volumeOptions];
+    if (!entry) {
+        entry = [[PGTemplatePoolEntry alloc] initWithVolumeOptions:volumeOptions];
+        [_entries setObject:entry forKey:[entry volumeOptions]];
+    }
+    
+    return entry;
+}
+
+
+- (void)refill
+{
+    NSUInteger maximumPreparationCount = [self maximumPreparationCount];
+    for (PGTemplatePoolEntry *entry in [_entries allValues]) {
+        while (_preparingCount < maximumPreparationCount && ![entry isSuspended] && 
+               [[entry readyPaths] count] + [entry preparingCount] < [entry targetDepth]) {
+            [self prepareTemplateForEntry:entry];
+        }
+    }
+}
+
+
+- (void)prepareTemplateForEntry:(PGTemplatePoolEntry *)entry
+{
+    NSString *templateName = [PGTemplatePoolTemplatePrefix stringByAppendingString:[[NSProcessInfo processInfo] globallyUniqueString]];
+    NSString *templatePath = [_directory stringByAppendingPathComponent:templateName];
+    
+    // Each template gets its own master password until it's claimed and changed to the creator's, so that learning one template's password
+    // doesn't open any of the others.
+    NSString *masterPassword = [NSData randomlyGeneratedPassword];
+    
+    ++_preparingCount;
+    [entry setPreparingCount:[entry preparingCount] + 1];
+    dispatch_group_enter(_preparationGroup);
+    
+    [PGEncryptedDiskImageWrapper createWrapperTemplateAtPath:templatePath masterPassword:masterPassword volumeOptions:[entry volumeOptions] 
+                                                     timeout:[self taskTimeout] completionHandler:^(BOOL created, NSError *error) {
+        dispatch_async(_queue, ^{
+            --_preparingCount;
+            [entry setPreparingCount:[entry preparingCount] - 1];
+            
+            // The depth may have been lowered while the template was being prepared
+            if (created && [[entry readyPaths] count] + [entry preparingCount] < [entry targetDepth]) {
+                [[entry readyPaths] addObject:templatePath];
+                [[entry masterPasswords] setObject:masterPassword forKey:templatePath];
+            } else if (created) {
+                [[NSFileManager defaultManager] removeItemAtPath:templatePath error:NULL];
+            } else {
+                [entry setSuspended:YES];
+            }
+            
+            // Start the next preparation before leaving the group, so that -waitUntilIdle waits for the pool to be refilled completely
+            [self refill];
+            dispatch_group_leave(_preparationGroup);
+        });
+    }];
+}
+
+
+- (void)removeSurplusTemplatesForEntry:(PGTemplatePoolEntry *)entry
+{
+    NSMutableArray *readyPaths = [entry readyPaths];
+    while ([readyPaths count] > [entry targetDepth]) {
+        [[NSFileManager defaultManager] removeItemAtPath:[readyPaths lastObject] error:NULL];
+        [[entry masterPasswords] removeObjectForKey:[readyPaths lastObject]];
+        [readyPaths removeLastObject];
+    }
+}
+
+
+- (void)waitUntilIdle
+{
+    dispatch_group_wait(_preparationGroup, DISPATCH_TIME_FOREVER);
+}
+
+
+- (BOOL)removeAllTemplates:(NSError **)errorOut
+{
+    dispatch_sync(_queue, ^{
+        for (PGTemplatePoolEntry *entry in [_entries allValues]) {
+            [entry setTargetDepth:0];
+        }
+    });
+    
+    // Templates that finish preparing now are removed as surplus
+    [self waitUntilIdle];
+    
+    __block NSError *error = nil;
+    dispatch_sync(_queue, ^{
+        for (PGTemplatePoolEntry *entry in [_entries allValues]) {
+            for (NSString *templatePath in [entry readyPaths]) {
+                NSError *removeError = nil;
+                if (![[NSFileManager defaultManager] removeItemAtPath:templatePath error:&removeError] && !error) error = removeError;
+            }
+        }
+        
+        [_entries removeAllObjects];
+    });
+    
+    if (error && errorOut) *errorOut = error;
+    return error == nil;
+}
+
+@end
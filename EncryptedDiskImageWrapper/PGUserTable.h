@@ -0,0 +1,219 @@
+//
+//  PGUserTable.h
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+/*! @abstract The user table entry key whose value corresponds to the entry's user. */
+extern NSString *const PGUserUserTableEntryKey;
+
+/*! @abstract The user table entry key whose value corresponds to the entry's salt. */
+extern NSString *const PGSaltUserTableEntryKey;
+
+/*! @abstract The user table entry key whose value corresponds to the entry's rounds value. */
+extern NSString *const PGRoundsUserTableEntryKey;
+
+/*! @abstract The user table entry key whose value corresponds to the entry's initialization vector. */
+extern NSString *const PGInitializationVectorUserTableEntryKey;
+
+/*! @abstract The user table entry key whose value corresponds to the entry's secret. */
+extern NSString *const PGSecretUserTableEntryKey;
+
+/*!
+ @abstract The user table entry key whose value corresponds to the PGEncryptionAlgorithm with which the entry's secret was encrypted.
+ @discussion Entries written by earlier versions don't have one, and their secrets were encrypted with PGAES256CBCEncryptionAlgorithm.
+ */
+extern NSString *const PGAlgorithmUserTableEntryKey;
+
+/*!
+ @abstract The user table entry key whose value corresponds to the PGKeyDerivationAlgorithm with which the entry's key was derived.
+ @discussion Entries whose keys were derived with PGPBKDF2KeyDerivationAlgorithm, including all entries written by earlier versions, don't have
+     one. For other algorithms, the rounds value is the algorithm's cost parameter.
+ */
+extern NSString *const PGKeyDerivationUserTableEntryKey;
+
+/*! @abstract The user table entry key whose value corresponds to the block size parameter of the entry's key derivation, if it isn't PBKDF2. */
+extern NSString *const PGBlockSizeUserTableEntryKey;
+
+/*! @abstract The user table entry key whose value corresponds to the number of lanes of the entry's key derivation, if it isn't PBKDF2. */
+extern NSString *const PGLanesUserTableEntryKey;
+
+
+/*!
+ @abstract PGUserTable instances store the user table of an encrypted disk image wrapper in a compact binary file.
+ @discussion A user table file consists of a header, an array of fixed-size records, an open-addressed hash index of those records keyed by user
+     name, and a heap containing each record's variable-length data. When a user table is read from a file, the file is memory-mapped and nothing 
+     is parsed up front, so opening a table takes constant time regardless of how many users it contains. Looking up a user hashes the name, 
+     probes the index, and decodes only the matching record.
+ 
+     Changes made with -setEntry:forUser: and -removeEntryForUser: are kept in memory on top of the mapped file until they are saved with 
+     -saveChanges: or the table is written with -writeToFile:error:. Entries are dictionaries whose keys are the PG*UserTableEntryKey constants.
+ 
+     Saving changes doesn't rewrite the table file. Instead, the changes are appended to a write-ahead log next to it, which has the same name with
+     a "log" extension. Appends are serialized across processes with an advisory lock on the log, so concurrent writers never lose each other's 
+     changes, and saving takes time proportional to the size of the changes rather than the size of the table. All the changes saved at once 
+     are appended as a single checksummed record, so they take effect together: neither a crash nor a reader that reads the log mid-append 
+     sees only some of them. Readers never take the lock. They 
+     replay the log on top of the mapped table when they are opened and pick up other writers' changes with -refresh:. When the log grows large,
+     saving changes compacts the table in the background, folding the log into a new table file.
+ 
+     User tables are not thread-safe, but separate instances may be used concurrently from any number of threads and processes. The exception is 
+     a table that has been made read-only with -makeReadOnly. A read-only table has no pending changes and nothing that changes it may be invoked 
+     on it, so -entryForUser:, -enumerateEntriesUsingBlock:, and -writeToFile:error: may be invoked on one instance from any number of threads at 
+     once. PGUserTableCache hands out read-only tables.
+ */
+@interface PGUserTable : NSObject
+
+/*!
+ @abstract Whether the table is read-only.
+ @discussion Read-only tables raise an assertion if -setEntry:forUser:, -removeEntryForUser:, -saveChanges:, or -refresh: is invoked on them.
+ */
+@property(readonly, getter=isReadOnly) BOOL readOnly;
+
+/*!
+ @abstract Initializes a newly allocated user table by memory-mapping the specified user table file and replaying its log.
+ @discussion Only the file's header is validated. Records are validated as they are accessed. Log records that are incomplete or corrupt, e.g.,
+     because they are still being written or a writer crashed, mark the end of the log.
+ 
+ @param path The path of the user table file. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return An initialized user table, or nil if the file could not be mapped or is not a user table file.
+ */
+- (id)initWithContentsOfFile:(NSString *)path error:(NSError **)errorOut;
+
+/*!
+ @abstract Initializes a newly allocated user table with the entries of a property list user table.
+ @discussion Property list user tables were used by earlier versions of PGEncryptedDiskImageWrapper. They contain a dictionary whose keys are user
+     names and whose values are user table entries. This method exists to read such tables without writing anything, and to migrate them to the
+     binary format. The entries are unsaved changes, so the receiver may not be made read-only.
+ 
+ @param path The path of the property list user table. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return An initialized user table, or nil if the property list could not be read.
+ */
+- (id)initWithContentsOfPropertyListFile:(NSString *)path error:(NSError **)errorOut;
+
+/*!
+ @abstract Makes the table read-only so that it may be shared between threads.
+ @discussion The table must not have unsaved changes. Once a table is read-only, it can't be made writable again.
+ */
+- (void)makeReadOnly;
+
+/*!
+ @abstract Returns the entry for the specified user.
+ @param user The user's name. May not be nil.
+ @return The entry for the user, or nil if there is no such user or the user's record is malformed.
+ */
+- (NSDictionary *)entryForUser:(NSString *)user;
+
+/*!
+ @abstract Sets the entry for the specified user, replacing any existing entry.
+ @param entry The user's new entry. May not be nil.
+ @param user The user's name. May not be nil.
+ */
+- (void)setEntry:(NSDictionary *)entry forUser:(NSString *)user;
+
+/*!
+ @abstract Removes the entry for the specified user, if there is one.
+ @param user The user's name. May not be nil.
+ */
+- (void)removeEntryForUser:(NSString *)user;
+
+/*!
+ @abstract Invokes the specified block with each user and entry in the table.
+ @discussion Unlike -entryForUser:, this decodes every record, so it takes time proportional to the number of users.
+ @param block The block to invoke. Setting *stop to YES stops the enumeration. May not be nil.
+ */
+- (void)enumerateEntriesUsingBlock:(void (^)(NSString *user, NSDictionary *entry, BOOL *stop))block;
+
+/*!
+ @abstract Atomically writes the table, including any unsaved changes, to the specified path in the binary user table format.
+ @discussion The file and its directory are flushed to permanent storage before this returns, so the table survives a crash.
+ 
+ @param path The path to which to write the table. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the table was written successfully.
+ */
+- (BOOL)writeToFile:(NSString *)path error:(NSError **)errorOut;
+
+/*!
+ @abstract Durably appends the receiver's unsaved changes to its table's log.
+ @discussion The receiver must have been initialized with -initWithContentsOfFile:error:. After the changes are appended, the receiver is 
+     refreshed, so it also reflects any changes saved by other writers. If the log has grown large, a compaction is started in the background.
+ 
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the changes were saved.
+ */
+- (BOOL)saveChanges:(NSError **)errorOut;
+
+/*!
+ @abstract Updates the receiver with changes saved by other writers since it was opened or last refreshed.
+ @discussion Ordinarily this only reads records appended to the log. If the table has been compacted since, the receiver remaps the table file
+     and rereads the new log. Unsaved changes are unaffected. The receiver must have been initialized with -initWithContentsOfFile:error:.
+ 
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the receiver was refreshed successfully.
+ */
+- (BOOL)refresh:(NSError **)errorOut;
+
+/*!
+ @abstract Folds the log of the user table file at the specified path into the table file and empties the log.
+ @discussion The log's lock is held throughout, so writers wait for compaction to finish. Readers are unaffected: the table file and log are 
+     each replaced atomically, and readers that opened them before compaction continue to see a consistent table.
+ 
+ @param path The path of the user table file. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the table was compacted.
+ */
++ (BOOL)compactTableAtPath:(NSString *)path error:(NSError **)errorOut;
+
+/*!
+ @abstract Writes the entries of a property list user table to a new user table file at the specified path, unless that file already exists.
+ @discussion The table's log lock is held throughout, so of several processes migrating the same table at once, only the first writes it, and 
+     none of them write while another is saving changes. The property list is left in place for earlier versions that only read it, but changes
+     saved after the migration are not written back to it.
+ 
+ @param propertyListPath The path of the property list user table. May not be nil.
+ @param path The path of the user table file. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the user table file exists once the method returns.
+ */
++ (BOOL)migratePropertyListFile:(NSString *)propertyListPath toTableAtPath:(NSString *)path error:(NSError **)errorOut;
+
+@end
@@ -0,0 +1,1064 @@
+//
+//  PGUserTable.m
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGUserTable.h"
+
+#import <fcntl.h>
+#import <sys/file.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+
+#import "NSError+ConvenienceInitializers.h"
+#import "PGErrors.h"
+#import "PGUserTableFormat.h"
+
+
+#pragma mark Types, Constants, and Functions
+
+NSString *const PGUserUserTableEntryKey = @"User";
+NSString *const PGSaltUserTableEntryKey = @"Salt";
+NSString *const PGRoundsUserTableEntryKey = @"Rounds";
+NSString *const PGInitializationVectorUserTableEntryKey = @"IV";
+NSString *const PGSecretUserTableEntryKey = @"Secret";
+NSString *const PGAlgorithmUserTableEntryKey = @"Algorithm";
+NSString *const PGKeyDerivationUserTableEntryKey = @"KeyDerivation";
+NSString *const PGBlockSizeUserTableEntryKey = @"BlockSize";
+NSString *const PGLanesUserTableEntryKey = @"Lanes";
+
+/*! @abstract The magic number at the start of every user table log file: "PGUL". */
+static const uint32_t PGUserTableLogMagic = 0x4C554750;
+
+/*!
+ @abstract The version of the user table log file format written by this class.
+ @discussion Version 2 set records may end with an algorithm and key derivation parameters. Version 3 adds batch records, which hold all the
+     changes saved at once. Builds that only understand an earlier version would treat such a record as a torn write and truncate it, so they 
+     must refuse newer logs instead. Version 1 and 2 logs are still read, and are folded into the table and replaced with a current log the 
+     first time changes are saved.
+ */
+static const uint32_t PGUserTableLogVersion = 3;
+
+/*! @abstract The oldest version of the user table log file format that this class can read. */
+static const uint32_t PGUserTableLogMinimumVersion = 1;
+
+/*! @abstract The size of a user table's log, in bytes, above which saving changes triggers a background compaction. */
+static const off_t PGUserTableLogCompactionThreshold = 256 * 1024;
+
+/*! @abstract Log record operations. */
+enum {
+    PGUserTableLogSetOperation = 1,
+    PGUserTableLogRemoveOperation = 2,
+    PGUserTableLogBatchOperation = 3
+};
+
+/*! @abstract The header at the beginning of a user table log file. */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} PGUserTableLogHeader;
+
+/*!
+ @abstract The header at the beginning of each record in a user table log file.
+ @discussion The header is followed by length bytes of payload. The payload starts with a one-byte operation. Set and remove payloads then 
+     contain the user's name, and set payloads then contain the entry's salt, initialization vector, secret, rounds value, and, if the entry 
+     has one, its algorithm, followed by its key derivation algorithm, block size, and lanes if its key wasn't derived with PBKDF2. Batch 
+     payloads contain set and remove payloads, each stored as a field, and their changes take effect together or not at all. Variable-length 
+     fields are stored as a 32-bit length followed by that many bytes. The checksum is the low 32 bits of the payload's FNV-1a hash. A record 
+     whose payload is incomplete, malformed, or whose checksum doesn't match marks the end of the log; it is either being written or was torn by
+     a crash.
+ */
+typedef struct {
+    uint32_t length;
+    uint32_t checksum;
+} PGUserTableLogRecordHeader;
+
+
+/*!
+ @abstract Returns the path of the log file for the user table file at the specified path.
+ @param path The path of the user table file.
+ @return The path of the table's log file, which has the same name with a "log" extension.
+ */
+static NSString *PGUserTableLogPath(NSString *path)
+{
+    return [[path stringByDeletingPathExtension] stringByAppendingPathExtension:@"log"];
+}
+
+
+/*!
+ @abstract Writes the entire contents of the buffer to the specified file descriptor.
+ @discussion Interrupted and partial writes are retried.
+ @return Whether all the data was written. If not, errno is set.
+ */
+static BOOL PGUserTableWriteFully(int fileDescriptor, const void *buffer, size_t length)
+{
+    size_t totalLength = 0;
+    while (totalLength < length) {
+        ssize_t writtenLength = write(fileDescriptor, (const uint8_t *)buffer + totalLength, length - totalLength);
+        if (writtenLength < 0) {
+            if (errno == EINTR) continue;
+            return NO;
+        }
+        
+        totalLength += writtenLength;
+    }
+    
+    return YES;
+}
+
+
+/*!
+ @abstract Flushes the specified file's data to permanent storage.
+ @discussion On Darwin, fsync() only pushes data to the drive, which may keep it in a volatile cache, so F_FULLFSYNC is used where the file 
+     system supports it.
+ @return Whether the file was flushed. If not, errno is set.
+ */
+static BOOL PGUserTableSynchronize(int fileDescriptor)
+{
+#ifdef F_FULLFSYNC
+    if (fcntl(fileDescriptor, F_FULLFSYNC) == 0) return YES;
+#endif
+    return fsync(fileDescriptor) == 0;
+}
+
+
+/*!
+ @abstract Flushes the directory containing the specified path, so that a file renamed into it survives a crash.
+ @return Whether the directory was flushed. If not, errno is set.
+ */
+static BOOL PGUserTableSynchronizeDirectory(NSString *path)
+{
+    int directoryDescriptor = open([[path stringByDeletingLastPathComponent] fileSystemRepresentation], O_RDONLY);
+    if (directoryDescriptor == -1) return NO;
+    
+    BOOL success = PGUserTableSynchronize(directoryDescriptor);
+    int errorNumber = errno;
+    close(directoryDescriptor);
+    errno = errorNumber;
+    return success;
+}
+
+
+/*!
+ @abstract Durably and atomically replaces the file at the specified path with the specified data.
+ @discussion The data is written to a temporary file in the same directory, which is flushed and renamed into place, and then the directory is 
+     flushed. Unlike -[NSData writeToFile:options:error:], once this returns, the new file survives a crash, so it's safe to discard the 
+     data it replaces, e.g., a log that has been folded into it.
+ 
+ @param data The data to write. May not be nil.
+ @param path The path of the file. May not be nil.
+ @return Whether the file was replaced. If not, errno is set.
+ */
+static BOOL PGUserTableWriteFileDurably(NSData *data, NSString *path)
+{
+    char *temporaryPath = strdup([[path stringByAppendingString:@".XXXXXX"] fileSystemRepresentation]);
+    int fileDescriptor = mkstemp(temporaryPath);
+    if (fileDescriptor == -1) {
+        free(temporaryPath);
+        return NO;
+    }
+    
+    BOOL success = PGUserTableWriteFully(fileDescriptor, [data bytes], [data length]) && PGUserTableSynchronize(fileDescriptor) && 
+        rename(temporaryPath, [path fileSystemRepresentation]) == 0 && PGUserTableSynchronizeDirectory(path);
+    int errorNumber = errno;
+    if (!success) unlink(temporaryPath);
+    
+    close(fileDescriptor);
+    free(temporaryPath);
+    errno = errorNumber;
+    return success;
+}
+
+
+/*!
+ @abstract Appends a variable-length log record field to the specified data.
+ @param data The data to append to. May not be nil.
+ @param fieldData The field's contents. May be nil, in which case an empty field is appended.
+ */
+static void PGUserTableLogAppendField(NSMutableData *data, NSData *fieldData)
+{
+    uint32_t length = CFSwapInt32HostToLittle((uint32_t)[fieldData length]);
+    [data appendBytes:&length length:sizeof(length)];
+    if (fieldData) [data appendData:fieldData];
+}
+
+
+/*!
+ @abstract Reads a variable-length log record field and advances the cursor past it.
+ @param cursor A pointer to the current read position. May not be NULL.
+ @param end The end of the payload.
+ @return The field's contents, or nil if the field extends past the end of the payload.
+ */
+static NSData *PGUserTableLogReadField(const uint8_t **cursor, const uint8_t *end)
+{
+    uint32_t length = 0;
+    if ((size_t)(end - *cursor) < sizeof(length)) return nil;
+    memcpy(&length, *cursor, sizeof(length));
+    length = CFSwapInt32LittleToHost(length);
+    *cursor += sizeof(length);
+    
+    if ((size_t)(end - *cursor) < length) return nil;
+    NSData *fieldData = [NSData dataWithBytes:*cursor length:length];
+    *cursor += length;
+    return fieldData;
+}
+
+
+/*!
+ @abstract Returns the specified entry with the specified key derivation parameters added.
+ @discussion Entries whose keys were derived with PBKDF2 have no key derivation parameters, so that they're the same as those of earlier versions.
+ @param entry The entry. May not be nil.
+ @param keyDerivation The PGKeyDerivationAlgorithm with which the entry's key was derived.
+ @param blockSize The block size parameter of the key derivation.
+ @param lanes The number of lanes of the key derivation.
+ @return The entry with the parameters, or entry itself if keyDerivation is PBKDF2.
+ */
+static NSDictionary *PGUserTableEntryWithKeyDerivation(NSDictionary *entry, uint32_t keyDerivation, uint32_t blockSize, uint32_t lanes)
+{
+    if (keyDerivation == 0) return entry;
+    
+    NSMutableDictionary *entryWithKeyDerivation = [entry mutableCopy];
+    [entryWithKeyDerivation setObject:[NSNumber numberWithUnsignedInt:keyDerivation] forKey:PGKeyDerivationUserTableEntryKey];
+    [entryWithKeyDerivation setObject:[NSNumber numberWithUnsignedInt:blockSize] forKey:PGBlockSizeUserTableEntryKey];
+    [entryWithKeyDerivation setObject:[NSNumber numberWithUnsignedInt:lanes] forKey:PGLanesUserTableEntryKey];
+    return entryWithKeyDerivation;
+}
+
+
+/*!
+ @abstract Appends the log record payload for the specified change to the specified data.
+ @param payload The data to append to. May not be nil.
+ @param user The changed user. May not be nil.
+ @param entry The user's new entry, or NSNull if the user was removed.
+ */
+static void PGUserTableLogAppendChangePayload(NSMutableData *payload, NSString *user, id entry)
+{
+    BOOL removal = entry == [NSNull null];
+    uint8_t operation = removal ? PGUserTableLogRemoveOperation : PGUserTableLogSetOperation;
+    
+    [payload appendBytes:&operation length:sizeof(operation)];
+    PGUserTableLogAppendField(payload, [user dataUsingEncoding:NSUTF8StringEncoding]);
+    if (!removal) {
+        PGUserTableLogAppendField(payload, [entry objectForKey:PGSaltUserTableEntryKey]);
+        PGUserTableLogAppendField(payload, [entry objectForKey:PGInitializationVectorUserTableEntryKey]);
+        PGUserTableLogAppendField(payload, [entry objectForKey:PGSecretUserTableEntryKey]);
+        uint32_t rounds = CFSwapInt32HostToLittle([[entry objectForKey:PGRoundsUserTableEntryKey] unsignedIntValue]);
+        [payload appendBytes:&rounds length:sizeof(rounds)];
+        
+        // Entries without an algorithm or key derivation parameters are logged exactly as earlier versions logged them
+        NSNumber *algorithmNumber = [entry objectForKey:PGAlgorithmUserTableEntryKey];
+        uint32_t keyDerivation = [[entry objectForKey:PGKeyDerivationUserTableEntryKey] unsignedIntValue];
+        if (algorithmNumber || keyDerivation) {
+            uint32_t algorithm = CFSwapInt32HostToLittle([algorithmNumber unsignedIntValue]);
+            [payload appendBytes:&algorithm length:sizeof(algorithm)];
+        }
+        
+        if (keyDerivation) {
+            uint32_t keyDerivationFields[3] = { 
+                CFSwapInt32HostToLittle(keyDerivation), 
+                CFSwapInt32HostToLittle([[entry objectForKey:PGBlockSizeUserTableEntryKey] unsignedIntValue]),
+                CFSwapInt32HostToLittle([[entry objectForKey:PGLanesUserTableEntryKey] unsignedIntValue]) 
+            };
+            [payload appendBytes:keyDerivationFields length:sizeof(keyDerivationFields)];
+        }
+    }
+}
+
+
+/*!
+ @abstract Returns a complete log record, including its header, for the specified changes.
+ @discussion A single change is logged as a set or remove record, exactly as earlier versions logged it. Several changes are logged as one batch
+     record, so that a crash while it's being written, or a reader that reads the log while it's being written, never sees only some of them.
+ @param changes The changes, keyed by user. Each value is the user's new entry, or NSNull if the user was removed. May not be empty.
+ @return The log record for the changes.
+ */
+static NSData *PGUserTableLogRecordForChanges(NSDictionary *changes)
+{
+    NSMutableData *payload = [[NSMutableData alloc] init];
+    if ([changes count] == 1) {
+        NSString *user = [[changes allKeys] lastObject];
+        PGUserTableLogAppendChangePayload(payload, user, [changes objectForKey:user]);
+    } else {
+        uint8_t operation = PGUserTableLogBatchOperation;
+        [payload appendBytes:&operation length:sizeof(operation)];
+        for (NSString *user in changes) {
+            NSMutableData *changePayload = [[NSMutableData alloc] init];
+            PGUserTableLogAppendChangePayload(changePayload, user, [changes objectForKey:user]);
+            PGUserTableLogAppendField(payload, changePayload);
+        }
+    }
+    
+    PGUserTableLogRecordHeader header = { CFSwapInt32HostToLittle((uint32_t)[payload length]), 
+                                          CFSwapInt32HostToLittle((uint32_t)PGUserTableHash([payload bytes], [payload length])) };
+    NSMutableData *record = [[NSMutableData alloc] initWithBytes:&header length:sizeof(header)];
+    [record appendData:payload];
+    return record;
+}
+
+
+/*!
+ @abstract Decodes a set or remove log record payload and adds its change to the specified changes.
+ @param payload The payload. May not be NULL.
+ @param length The length of the payload.
+ @param changes The changes to which to add the payload's change, keyed by user. Removed users map to NSNull. May not be nil.
+ @return Whether the payload was a well-formed set or remove payload. If not, changes is unmodified.
+ */
+static BOOL PGUserTableLogReadChangePayload(const uint8_t *payload, size_t length, NSMutableDictionary *changes)
+{
+    const uint8_t *cursor = payload;
+    const uint8_t *end = payload + length;
+    if (cursor == end) return NO;
+    
+    uint8_t operation = *cursor++;
+    NSData *userData = PGUserTableLogReadField(&cursor, end);
+    NSString *user = userData ? [[NSString alloc] initWithData:userData encoding:NSUTF8StringEncoding] : nil;
+    if (!user) return NO;
+    
+    if (operation == PGUserTableLogRemoveOperation) {
+        [changes setObject:[NSNull null] forKey:user];
+        return YES;
+    } else if (operation != PGUserTableLogSetOperation) {
+        return NO;
+    }
+    
+    NSData *salt = PGUserTableLogReadField(&cursor, end);
+    NSData *initializationVector = PGUserTableLogReadField(&cursor, end);
+    NSData *secret = PGUserTableLogReadField(&cursor, end);
+    // The rounds value is followed by an optional algorithm, which is in turn followed by optional key derivation parameters
+    uint32_t fields[5] = { 0 };
+    size_t remainingLength = end - cursor;
+    if (!(salt && initializationVector && secret) || 
+        (remainingLength != sizeof(uint32_t) && remainingLength != 2 * sizeof(uint32_t) && remainingLength != sizeof(fields))) {
+        return NO;
+    }
+    
+    memcpy(fields, cursor, remainingLength);
+    
+    NSDictionary *entry = [NSDictionary dictionaryWithObjectsAndKeys:user, PGUserUserTableEntryKey, salt, PGSaltUserTableEntryKey, 
+                           [NSNumber numberWithUnsignedInt:CFSwapInt32LittleToHost(fields[0])], PGRoundsUserTableEntryKey, 
+                           initializationVector, PGInitializationVectorUserTableEntryKey, secret, PGSecretUserTableEntryKey, 
+                           [NSNumber numberWithUnsignedInt:CFSwapInt32LittleToHost(fields[1])], PGAlgorithmUserTableEntryKey, nil];
+    entry = PGUserTableEntryWithKeyDerivation(entry, CFSwapInt32LittleToHost(fields[2]), CFSwapInt32LittleToHost(fields[3]), 
+                                              CFSwapInt32LittleToHost(fields[4]));
+    [changes setObject:entry forKey:user];
+    return YES;
+}
+
+
+/*!
+ @abstract Opens the log file at the specified path and acquires an exclusive advisory lock on it.
+ @discussion The log file is created if it doesn't exist. Because compaction replaces the log file while holding the lock on the old one, this 
+     function checks that the file it locked is still the one at the path and retries if it isn't. The lock is released when the returned file
+     descriptor is closed.
+ 
+ @param logPath The path of the log file. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return A locked file descriptor open for appending, or -1 if an error occurred.
+ */
+static int PGUserTableOpenLockedLog(NSString *logPath, NSError **errorOut)
+{
+    const char *logFileSystemPath = [logPath fileSystemRepresentation];
+    
+    while (YES) {
+        int fileDescriptor = open(logFileSystemPath, O_RDWR | O_APPEND | O_CREAT, S_IRUSR | S_IWUSR);
+        if (fileDescriptor == -1 || flock(fileDescriptor, LOCK_EX) == -1) {
+            if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            if (fileDescriptor != -1) close(fileDescriptor);
+            return -1;
+        }
+        
+        struct stat fileStatus, pathStatus;
+        if (fstat(fileDescriptor, &fileStatus) == 0 && stat(logFileSystemPath, &pathStatus) == 0 && 
+            fileStatus.st_dev == pathStatus.st_dev && fileStatus.st_ino == pathStatus.st_ino) {
+            // A brand new log needs its header before any records are appended, and its directory entry must survive a crash along with them
+            if (fileStatus.st_size == 0) {
+                PGUserTableLogHeader header = { CFSwapInt32HostToLittle(PGUserTableLogMagic), CFSwapInt32HostToLittle(PGUserTableLogVersion) };
+                if (!PGUserTableWriteFully(fileDescriptor, &header, sizeof(header)) || !PGUserTableSynchronizeDirectory(logPath)) {
+                    if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+                    close(fileDescriptor);
+                    return -1;
+                }
+            }
+            
+            return fileDescriptor;
+        }
+        
+        // The log we locked was replaced while we waited for the lock, so try again with the new one
+        close(fileDescriptor);
+    }
+}
+
+
+/*!
+ @abstract Atomically and durably replaces the log file at the specified path with an empty one.
+ @discussion The caller must hold the lock on the existing log file, and must have durably written anything in the log that should be kept.
+ 
+ @param logPath The path of the log file. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the log was replaced.
+ */
+static BOOL PGUserTableReplaceLogWithEmptyLog(NSString *logPath, NSError **errorOut)
+{
+    char *temporaryPath = strdup([[logPath stringByAppendingString:@".XXXXXX"] fileSystemRepresentation]);
+    int fileDescriptor = mkstemp(temporaryPath);
+    if (fileDescriptor == -1) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        free(temporaryPath);
+        return NO;
+    }
+    
+    PGUserTableLogHeader header = { CFSwapInt32HostToLittle(PGUserTableLogMagic), CFSwapInt32HostToLittle(PGUserTableLogVersion) };
+    BOOL success = PGUserTableWriteFully(fileDescriptor, &header, sizeof(header)) && PGUserTableSynchronize(fileDescriptor) &&
+        rename(temporaryPath, [logPath fileSystemRepresentation]) == 0 && PGUserTableSynchronizeDirectory(logPath);
+    if (!success) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        unlink(temporaryPath);
+    }
+    
+    close(fileDescriptor);
+    free(temporaryPath);
+    return success;
+}
+
+
+#pragma mark - Private Methods Interface
+
+@interface PGUserTable ()
+
+/*!
+ @abstract Returns the entry for the mapped record at the specified index.
+ @param recordIndex The index of the record. Must be less than the mapped record count.
+ @param userOut If not NULL, on output points to the record's user name.
+ @return The record's entry, or nil if the record refers to data outside the heap.
+ */
+- (NSDictionary *)entryForRecordAtIndex:(uint32_t)recordIndex user:(NSString **)userOut;
+
+/*!
+ @abstract Returns the mapped record at the specified index.
+ @discussion Version 1 records are shorter than PGUserTableRecord, so their key derivation fields must not be read.
+ @param recordIndex The index of the record. Must be less than the mapped record count.
+ @return The record.
+ */
+- (const PGUserTableRecord *)recordAtIndex:(uint32_t)recordIndex;
+
+/*!
+ @abstract Returns the bytes referred to by the specified heap reference.
+ @param reference The heap reference.
+ @return A pointer to the bytes, or NULL if the reference refers to data outside the heap.
+ */
+- (const uint8_t *)bytesForHeapReference:(PGUserTableHeapReference)reference;
+
+/*!
+ @abstract Memory-maps the receiver's user table file, replacing any existing mapping.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ @return Whether the file was mapped and has a valid header.
+ */
+- (BOOL)mapTableFile:(NSError **)errorOut;
+
+/*!
+ @abstract Discards the receiver's mapping and logged changes, then maps the table file and reads its entire log.
+ @discussion The log is opened before the table file is mapped. Compaction replaces the table file before the log, so this order guarantees that 
+     the log we read is never older than the table we map. Reading a log on top of a table that already includes its changes is harmless.
+ 
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return Whether the table and log were read successfully.
+ */
+- (BOOL)reload:(NSError **)errorOut;
+
+/*!
+ @abstract Reads any complete records that have been appended to the receiver's log since it was last read.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ @return Whether the log was read successfully.
+ */
+- (BOOL)readLogTail:(NSError **)errorOut;
+
+/*!
+ @abstract Decodes a log record payload and applies its changes to the receiver's logged changes.
+ @param payload The record's payload. May not be NULL.
+ @param length The length of the payload.
+ @return Whether the payload was well-formed. If not, none of its changes are applied.
+ */
+- (BOOL)applyLogRecordPayload:(const uint8_t *)payload length:(size_t)length;
+
+@end
+
+
+#pragma mark - Implementation
+
+@implementation PGUserTable {
+    // The mapped file and the regions of it we use. _mappedBytes is NULL and _layout is zeroed if the table wasn't read from a file.
+    void *_mappedBytes;
+    size_t _mappedLength;
+    PGUserTableLayout _layout;
+    
+    // The table file's path and its log. _logFileDescriptor is -1 if the log wasn't open when we last read it.
+    NSString *_path;
+    NSString *_logPath;
+    int _logFileDescriptor;
+    off_t _logOffset;
+    uint32_t _logVersion;
+    
+    // Changes read from the log and unsaved changes, keyed by user. Removed users map to NSNull.
+    NSMutableDictionary *_loggedChanges;
+    NSMutableDictionary *_changes;
+}
+
+
+@synthesize readOnly = _readOnly;
+
+
+- (id)init
+{
+    if (!(self = [super init])) return nil;
+    _logFileDescriptor = -1;
+    _loggedChanges = [[NSMutableDictionary alloc] init];
+    _changes = [[NSMutableDictionary alloc] init];
+    return self;
+}
+
+
+- (id)initWithContentsOfFile:(NSString *)path error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    
+    if (!(self = [self init])) return nil;
+    
+    _path = [path copy];
+    _logPath = PGUserTableLogPath(path);
+    return [self reload:errorOut] ? self : nil;
+}
+
+
+- (id)initWithContentsOfPropertyListFile:(NSString *)path error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    
+    if (!(self = [self init])) return nil;
+    
+    NSDictionary *propertyListTable = [[NSDictionary alloc] initWithContentsOfFile:path];
+    if (!propertyListTable) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperMalformedUserTableError userInfo:nil];
+        return nil;
+    }
+    
+    [_changes addEntriesFromDictionary:propertyListTable];
+    return self;
+}
+
+
+- (void)dealloc
+{
+    if (_mappedBytes) munmap(_mappedBytes, _mappedLength);
+    if (_logFileDescriptor != -1) close(_logFileDescriptor);
+}
+
+
+- (void)makeReadOnly
+{
+    NSAssert([_changes count] == 0, @"user table has unsaved changes");
+    _readOnly = YES;
+}
+
+
+#pragma mark Entries
+
+- (NSDictionary *)entryForUser:(NSString *)user
+{
+    NSAssert(user, @"nil user");
+    
+    id change = [_changes objectForKey:user];
+    if (!change) change = [_loggedChanges objectForKey:user];
+    if (change) return change == [NSNull null] ? nil : change;
+    if (!_mappedBytes) return nil;
+    
+    const char *userBytes = [user UTF8String];
+    uint32_t recordIndex = PGUserTableLayoutFindUser(&_layout, userBytes, strlen(userBytes));
+    return recordIndex != PGUserTableEmptyBucket ? [self entryForRecordAtIndex:recordIndex user:NULL] : nil;
+}
+
+
+- (void)setEntry:(NSDictionary *)entry forUser:(NSString *)user
+{
+    NSAssert(entry, @"nil entry");
+    NSAssert(user, @"nil user");
+    NSAssert(!_readOnly, @"user table is read-only");
+    [_changes setObject:entry forKey:user];
+}
+
+
+- (void)removeEntryForUser:(NSString *)user
+{
+    NSAssert(user, @"nil user");
+    NSAssert(!_readOnly, @"user table is read-only");
+    [_changes setObject:[NSNull null] forKey:user];
+}
+
+
+- (void)enumerateEntriesUsingBlock:(void (^)(NSString *, NSDictionary *, BOOL *))block
+{
+    NSAssert(block, @"nil block");
+    
+    BOOL stop = NO;
+    
+    // Mapped records that haven't been changed come first
+    for (uint32_t recordIndex = 0; recordIndex < _layout.recordCount && !stop; ++recordIndex) {
+        NSString *user = nil;
+        NSDictionary *entry = [self entryForRecordAtIndex:recordIndex user:&user];
+        if (entry && ![_changes objectForKey:user] && ![_loggedChanges objectForKey:user]) block(user, entry, &stop);
+    }
+    
+    // Then logged changes that haven't been changed again, and finally unsaved changes, skipping removals
+    for (NSString *user in _loggedChanges) {
+        if (stop) break;
+        
+        id entry = [_loggedChanges objectForKey:user];
+        if (entry != [NSNull null] && ![_changes objectForKey:user]) block(user, entry, &stop);
+    }
+    
+    for (NSString *user in _changes) {
+        if (stop) break;
+        
+        id entry = [_changes objectForKey:user];
+        if (entry != [NSNull null]) block(user, entry, &stop);
+    }
+}
+
+
+#pragma mark Writing
+
+- (BOOL)writeToFile:(NSString *)path error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    
+    NSMutableArray *users = [[NSMutableArray alloc] init];
+    NSMutableArray *entries = [[NSMutableArray alloc] init];
+    [self enumerateEntriesUsingBlock:^(NSString *user, NSDictionary *entry, BOOL *stop) {
+        [users addObject:user];
+        [entries addObject:entry];
+    }];
+    
+    uint32_t recordCount = (uint32_t)[users count];
+    uint32_t bucketCount = PGUserTableBucketCountForRecordCount(recordCount);
+    
+    // Only write the newer format if some entry needs it, so that earlier versions can still read the table otherwise
+    BOOL hasKeyDerivation = NO;
+    for (NSDictionary *entry in entries) {
+        if ([[entry objectForKey:PGKeyDerivationUserTableEntryKey] unsignedIntValue] != 0) {
+            hasKeyDerivation = YES;
+            break;
+        }
+    }
+    
+    uint32_t version = hasKeyDerivation ? PGUserTableVersion : PGUserTableVersion1;
+    size_t recordSize = hasKeyDerivation ? sizeof(PGUserTableRecord) : PGUserTableVersion1RecordSize;
+    
+    // Lay out the file: header, records, index, and heap, keeping the records 8-byte aligned
+    uint64_t recordsOffset = sizeof(PGUserTableHeader);
+    uint64_t bucketsOffset = recordsOffset + (uint64_t)recordCount * recordSize;
+    uint64_t heapOffset = bucketsOffset + (uint64_t)bucketCount * sizeof(uint32_t);
+    
+    NSMutableData *recordsData = [NSMutableData dataWithLength:recordCount * recordSize];
+    NSMutableData *bucketsData = [NSMutableData dataWithLength:bucketCount * sizeof(uint32_t)];
+    NSMutableData *heapData = [[NSMutableData alloc] init];
+    uint8_t *records = [recordsData mutableBytes];
+    uint32_t *buckets = [bucketsData mutableBytes];
+    memset(buckets, 0xFF, bucketCount * sizeof(uint32_t));
+    
+    // Appends data to the heap and returns a little-endian reference to it
+    PGUserTableHeapReference (^appendToHeap)(const void *, NSUInteger) = ^(const void *bytes, NSUInteger length) {
+        PGUserTableHeapReference reference = { CFSwapInt32HostToLittle((uint32_t)[heapData length]), CFSwapInt32HostToLittle((uint32_t)length) };
+        [heapData appendBytes:bytes length:length];
+        return reference;
+    };
+    
+    for (uint32_t recordIndex = 0; recordIndex < recordCount; ++recordIndex) {
+        NSDictionary *entry = [entries objectAtIndex:recordIndex];
+        NSData *userData = [[users objectAtIndex:recordIndex] dataUsingEncoding:NSUTF8StringEncoding];
+        NSData *salt = [entry objectForKey:PGSaltUserTableEntryKey];
+        NSData *initializationVector = [entry objectForKey:PGInitializationVectorUserTableEntryKey];
+        NSData *secret = [entry objectForKey:PGSecretUserTableEntryKey];
+        
+        PGUserTableRecord *record = (PGUserTableRecord *)(records + recordIndex * recordSize);
+        uint64_t userHash = PGUserTableHash([userData bytes], [userData length]);
+        record->userHash = CFSwapInt64HostToLittle(userHash);
+        record->user = appendToHeap([userData bytes], [userData length]);
+        record->salt = appendToHeap([salt bytes], [salt length]);
+        record->initializationVector = appendToHeap([initializationVector bytes], [initializationVector length]);
+        record->secret = appendToHeap([secret bytes], [secret length]);
+        record->rounds = CFSwapInt32HostToLittle([[entry objectForKey:PGRoundsUserTableEntryKey] unsignedIntValue]);
+        record->algorithm = CFSwapInt32HostToLittle([[entry objectForKey:PGAlgorithmUserTableEntryKey] unsignedIntValue]);
+        if (hasKeyDerivation) {
+            record->keyDerivation = CFSwapInt32HostToLittle([[entry objectForKey:PGKeyDerivationUserTableEntryKey] unsignedIntValue]);
+            record->blockSize = CFSwapInt32HostToLittle([[entry objectForKey:PGBlockSizeUserTableEntryKey] unsignedIntValue]);
+            record->lanes = CFSwapInt32HostToLittle([[entry objectForKey:PGLanesUserTableEntryKey] unsignedIntValue]);
+        }
+        
+        PGUserTableIndexInsert(buckets, bucketCount, userHash, recordIndex);
+    }
+    
+    PGUserTableHeader header = {
+        CFSwapInt32HostToLittle(PGUserTableMagic), CFSwapInt32HostToLittle(version), 
+        CFSwapInt32HostToLittle(recordCount), CFSwapInt32HostToLittle(bucketCount),
+        CFSwapInt64HostToLittle(recordsOffset), CFSwapInt64HostToLittle(bucketsOffset),
+        CFSwapInt64HostToLittle(heapOffset), CFSwapInt64HostToLittle([heapData length])
+    };
+    
+    NSMutableData *fileData = [[NSMutableData alloc] initWithCapacity:heapOffset + [heapData length]];
+    [fileData appendBytes:&header length:sizeof(header)];
+    [fileData appendData:recordsData];
+    [fileData appendData:bucketsData];
+    [fileData appendData:heapData];
+    
+    // Compaction empties the log as soon as this returns, so the table must already be on disk by then
+    if (!PGUserTableWriteFileDurably(fileData, path)) {
+        NSError *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperUserTableWriteFailedError underlyingError:error];
+        return NO;
+    }
+    
+    return YES;
+}
+
+
+#pragma mark Logging
+
+- (BOOL)saveChanges:(NSError **)errorOut
+{
+    NSAssert(_path, @"user table was not read from a file");
+    NSAssert(!_readOnly, @"user table is read-only");
+    if ([_changes count] == 0) return YES;
+    
+    // All the changes go in one record, so that they take effect together even if we crash while appending it
+    NSData *record = PGUserTableLogRecordForChanges(_changes);
+    
+    // Append the record with a single write while holding the lock, so that concurrent writers' records never interleave
+    NSError *error = nil;
+    int logFileDescriptor = PGUserTableOpenLockedLog(_logPath, &error);
+    if (logFileDescriptor == -1) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperUserTableWriteFailedError underlyingError:error];
+        return NO;
+    }
+    
+    // Catch up on the log first. Since we hold the lock, anything past the last complete record was left by a writer that crashed, and must be
+    // truncated or our record would be unreachable behind it.
+    struct stat logStatus;
+    BOOL written = [self refresh:&error];
+    if (written && _logVersion < PGUserTableLogVersion) {
+        // Our record can't go in an older log, since older builds would truncate it. Fold the log and our changes into the table instead, 
+        // the way compaction does, and start a current log.
+        written = [self writeToFile:_path error:&error] && PGUserTableReplaceLogWithEmptyLog(_logPath, &error);
+        close(logFileDescriptor);
+        if (!written) {
+            if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperUserTableWriteFailedError underlyingError:error];
+            return NO;
+        }
+        
+        [_changes removeAllObjects];
+        [self reload:NULL];
+        return YES;
+    } else if (written) {
+        written = fstat(logFileDescriptor, &logStatus) == 0 && (logStatus.st_size == _logOffset || ftruncate(logFileDescriptor, _logOffset) == 0) &&
+            PGUserTableWriteFully(logFileDescriptor, [record bytes], [record length]) && PGUserTableSynchronize(logFileDescriptor) && 
+            fstat(logFileDescriptor, &logStatus) == 0;
+        if (!written) error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+    }
+    
+    if (!written) {
+        close(logFileDescriptor);
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperUserTableWriteFailedError underlyingError:error];
+        return NO;
+    }
+    
+    // Our record is now the last one in the log, so reading it back leaves it in effect
+    [self readLogTail:NULL];
+    [_changes removeAllObjects];
+    close(logFileDescriptor);
+    
+    if (logStatus.st_size > PGUserTableLogCompactionThreshold) {
+        NSString *path = _path;
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+            [PGUserTable compactTableAtPath:path error:NULL];
+        });
+    }
+    
+    return YES;
+}
+
+
+- (BOOL)refresh:(NSError **)errorOut
+{
+    NSAssert(_path, @"user table was not read from a file");
+    NSAssert(!_readOnly, @"user table is read-only");
+    
+    // If the log has been replaced by a compaction since we opened it, start over. Otherwise, just read what's been appended.
+    struct stat pathStatus, fileStatus;
+    BOOL logExists = stat([_logPath fileSystemRepresentation], &pathStatus) == 0;
+    BOOL logReplaced = NO;
+    if (_logFileDescriptor == -1) {
+        logReplaced = logExists;
+    } else {
+        logReplaced = !logExists || fstat(_logFileDescriptor, &fileStatus) == -1 || fileStatus.st_dev != pathStatus.st_dev || 
+            fileStatus.st_ino != pathStatus.st_ino;
+    }
+    
+    return logReplaced ? [self reload:errorOut] : [self readLogTail:errorOut];
+}
+
+
++ (BOOL)compactTableAtPath:(NSString *)path error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    
+    NSString *logPath = PGUserTableLogPath(path);
+    int logFileDescriptor = PGUserTableOpenLockedLog(logPath, errorOut);
+    if (logFileDescriptor == -1) return NO;
+    
+    // While we hold the lock, nobody can append to the log, so the table we read is complete. Readers don't take the lock, and both files are
+    // replaced atomically, so they can keep reading throughout.
+    PGUserTable *userTable = [[self alloc] initWithContentsOfFile:path error:errorOut];
+    BOOL success = userTable && [userTable writeToFile:path error:errorOut] && PGUserTableReplaceLogWithEmptyLog(logPath, errorOut);
+    
+    close(logFileDescriptor);
+    return success;
+}
+
+
++ (BOOL)migratePropertyListFile:(NSString *)propertyListPath toTableAtPath:(NSString *)path error:(NSError **)errorOut
+{
+    NSAssert(propertyListPath, @"nil property list path");
+    NSAssert(path, @"nil path");
+    
+    int logFileDescriptor = PGUserTableOpenLockedLog(PGUserTableLogPath(path), errorOut);
+    if (logFileDescriptor == -1) return NO;
+    
+    // Another process may have migrated the table while we waited for the lock, and may have saved changes to it since
+    BOOL success = [[NSFileManager defaultManager] fileExistsAtPath:path];
+    if (!success) {
+        PGUserTable *userTable = [[self alloc] initWithContentsOfPropertyListFile:propertyListPath error:errorOut];
+        success = userTable && [userTable writeToFile:path error:errorOut];
+    }
+    
+    close(logFileDescriptor);
+    return success;
+}
+
+
+#pragma mark Private Methods
+
+- (BOOL)reload:(NSError **)errorOut
+{
+    if (_logFileDescriptor != -1) close(_logFileDescriptor);
+    _logFileDescriptor = open([_logPath fileSystemRepresentation], O_RDONLY);
+    _logOffset = 0;
+    _logVersion = 0;
+    [_loggedChanges removeAllObjects];
+    
+    if (_logFileDescriptor == -1 && errno != ENOENT) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return NO;
+    }
+    
+    return [self mapTableFile:errorOut] && [self readLogTail:errorOut];
+}
+
+
+- (BOOL)readLogTail:(NSError **)errorOut
+{
+    if (_logFileDescriptor == -1) return YES;
+    
+    struct stat logStatus;
+    if (fstat(_logFileDescriptor, &logStatus) == -1) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return NO;
+    }
+    
+    if (logStatus.st_size <= _logOffset) return YES;
+    
+    size_t length = (size_t)(logStatus.st_size - _logOffset);
+    NSMutableData *tail = [NSMutableData dataWithLength:length];
+    ssize_t readLength = pread(_logFileDescriptor, [tail mutableBytes], length, _logOffset);
+    if (readLength < 0) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return NO;
+    }
+    
+    const uint8_t *cursor = [tail bytes];
+    const uint8_t *end = cursor + readLength;
+    
+    // A new log's header may not have been written yet, in which case there's nothing to read
+    if (_logOffset == 0) {
+        if ((size_t)(end - cursor) < sizeof(PGUserTableLogHeader)) return YES;
+        
+        PGUserTableLogHeader header;
+        memcpy(&header, cursor, sizeof(header));
+        uint32_t version = CFSwapInt32LittleToHost(header.version);
+        if (CFSwapInt32LittleToHost(header.magic) != PGUserTableLogMagic || version < PGUserTableLogMinimumVersion || 
+            version > PGUserTableLogVersion) {
+            if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperMalformedUserTableError userInfo:nil];
+            return NO;
+        }
+        
+        _logVersion = version;
+        cursor += sizeof(header);
+        _logOffset += sizeof(header);
+    }
+    
+    // Apply complete records until we reach the end or a record that's still being written
+    while ((size_t)(end - cursor) >= sizeof(PGUserTableLogRecordHeader)) {
+        PGUserTableLogRecordHeader header;
+        memcpy(&header, cursor, sizeof(header));
+        uint32_t payloadLength = CFSwapInt32LittleToHost(header.length);
+        const uint8_t *payload = cursor + sizeof(header);
+        
+        if ((size_t)(end - payload) < payloadLength) break;
+        if ((uint32_t)PGUserTableHash(payload, payloadLength) != CFSwapInt32LittleToHost(header.checksum)) break;
+        if (![self applyLogRecordPayload:payload length:payloadLength]) break;
+        
+        cursor = payload + payloadLength;
+        _logOffset += sizeof(header) + payloadLength;
+    }
+    
+    return YES;
+}
+
+
+- (BOOL)applyLogRecordPayload:(const uint8_t *)payload length:(size_t)length
+{
+    if (length == 0) return NO;
+    if (payload[0] != PGUserTableLogBatchOperation) return PGUserTableLogReadChangePayload(payload, length, _loggedChanges);
+    
+    // Decode the whole batch before applying any of it, so that a malformed batch has no effect
+    NSMutableDictionary *changes = [[NSMutableDictionary alloc] init];
+    const uint8_t *cursor = payload + 1;
+    const uint8_t *end = payload + length;
+    while (cursor < end) {
+        NSData *changePayload = PGUserTableLogReadField(&cursor, end);
+        if (!changePayload || !PGUserTableLogReadChangePayload([changePayload bytes], [changePayload length], changes)) return NO;
+    }
+    
+    [_loggedChanges addEntriesFromDictionary:changes];
+    return YES;
+}
+
+
+- (BOOL)mapTableFile:(NSError **)errorOut
+{
+    if (_mappedBytes) {
+        munmap(_mappedBytes, _mappedLength);
+        _mappedBytes = NULL;
+        memset(&_layout, 0, sizeof(_layout));
+    }
+    
+    int fileDescriptor = open([_path fileSystemRepresentation], O_RDONLY);
+    if (fileDescriptor == -1) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return NO;
+    }
+    
+    struct stat fileStatus;
+    if (fstat(fileDescriptor, &fileStatus) == -1) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        close(fileDescriptor);
+        return NO;
+    }
+    
+    if ((size_t)fileStatus.st_size < sizeof(PGUserTableHeader)) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperMalformedUserTableError userInfo:nil];
+        close(fileDescriptor);
+        return NO;
+    }
+    
+    // The mapping stays valid after the file is closed, and even after the file is atomically replaced
+    _mappedLength = fileStatus.st_size;
+    _mappedBytes = mmap(NULL, _mappedLength, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    close(fileDescriptor);
+    if (_mappedBytes == MAP_FAILED) {
+        _mappedBytes = NULL;
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return NO;
+    }
+    
+    if (!PGUserTableLayoutInitialize(&_layout, _mappedBytes, _mappedLength)) {
+        munmap(_mappedBytes, _mappedLength);
+        _mappedBytes = NULL;
+        if (errorOut) *errorOut = [NSError errorWithDomain:PGErrorDomain code:PGEncryptedDiskImageWrapperMalformedUserTableError userInfo:nil];
+        return NO;
+    }
+    
+    return YES;
+}
+
+
+- (const PGUserTableRecord *)recordAtIndex:(uint32_t)recordIndex
+{
+    return PGUserTableLayoutRecordAtIndex(&_layout, recordIndex);
+}
+
+
+- (NSDictionary *)entryForRecordAtIndex:(uint32_t)recordIndex user:(NSString **)userOut
+{
+    const PGUserTableRecord *record = [self recordAtIndex:recordIndex];
+    PGUserTableHeapReference userReference = { CFSwapInt32LittleToHost(record->user.offset), CFSwapInt32LittleToHost(record->user.length) };
+    PGUserTableHeapReference saltReference = { CFSwapInt32LittleToHost(record->salt.offset), CFSwapInt32LittleToHost(record->salt.length) };
+    PGUserTableHeapReference ivReference = { CFSwapInt32LittleToHost(record->initializationVector.offset), 
+                                             CFSwapInt32LittleToHost(record->initializationVector.length) };
+    PGUserTableHeapReference secretReference = { CFSwapInt32LittleToHost(record->secret.offset), CFSwapInt32LittleToHost(record->secret.length) };
+    
+    const uint8_t *userBytes = [self bytesForHeapReference:userReference];
+    const uint8_t *saltBytes = [self bytesForHeapReference:saltReference];
+    const uint8_t *ivBytes = [self bytesForHeapReference:ivReference];
+    const uint8_t *secretBytes = [self bytesForHeapReference:secretReference];
+    if (!(userBytes && saltBytes && ivBytes && secretBytes)) return nil;
+    
+    NSString *user = [[NSString alloc] initWithBytes:userBytes length:userReference.length encoding:NSUTF8StringEncoding];
+    if (!user) return nil;
+    if (userOut) *userOut = user;
+    
+    NSDictionary *entry = [NSDictionary dictionaryWithObjectsAndKeys:user, PGUserUserTableEntryKey, 
+                           [NSData dataWithBytes:saltBytes length:saltReference.length], PGSaltUserTableEntryKey, 
+                           [NSNumber numberWithUnsignedInt:CFSwapInt32LittleToHost(record->rounds)], PGRoundsUserTableEntryKey, 
+                           [NSData dataWithBytes:ivBytes length:ivReference.length], PGInitializationVectorUserTableEntryKey,
+                           [NSData dataWithBytes:secretBytes length:secretReference.length], PGSecretUserTableEntryKey, 
+                           [NSNumber numberWithUnsignedInt:CFSwapInt32LittleToHost(record->algorithm)], PGAlgorithmUserTableEntryKey, nil];
+    if (_layout.recordSize < sizeof(PGUserTableRecord)) return entry;
+    
+    return PGUserTableEntryWithKeyDerivation(entry, CFSwapInt32LittleToHost(record->keyDerivation), CFSwapInt32LittleToHost(record->blockSize),
+                                             CFSwapInt32LittleToHost(record->lanes));
+}
+
+
+- (const uint8_t *)bytesForHeapReference:(PGUserTableHeapReference)reference
+{
+    return PGUserTableLayoutHeapBytes(&_layout, reference);
+}
+
+@end
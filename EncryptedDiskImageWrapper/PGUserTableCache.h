@@ -0,0 +1,108 @@
+//
+//  PGUserTableCache.h
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+@class PGUserTable;
+
+/*!
+ @abstract PGUserTableCache instances share opened user tables among the wrappers in a process that use the same user table file.
+ @discussion Opening a user table maps its file and replays its log. When many wrappers are opened on the same path, the cache does that once and 
+     hands every opener the same table. Each lookup stats the table file and its log, and the cached table is only handed out if neither's device, 
+     inode, size, and modification date have changed since it was opened; otherwise the table is opened again and replaces the cached one. Saving 
+     changes appends to the log and compacting replaces both files, so either is noticed by the next lookup. Tables that were already handed out 
+     remain valid and keep seeing the files as they were when they were opened.
+ 
+     Tables from the cache are shared, so they are made read-only with -[PGUserTable makeReadOnly] before they're handed out. Reading a read-only 
+     table is safe from any number of threads at once, and trying to change one raises an assertion. To change a user table, open a private one 
+     with -[PGUserTable initWithContentsOfFile:error:].
+ 
+     When the cache holds countLimit tables, opening another evicts the least recently used one. User table caches are thread-safe.
+ */
+@interface PGUserTableCache : NSObject
+
+/*! @abstract The maximum number of tables the cache holds. Defaults to 64. */
+@property(readwrite) NSUInteger countLimit;
+
+/*!
+ @abstract Returns the shared user table cache, which PGEncryptedDiskImageWrapper uses to open user tables.
+ @return The shared user table cache.
+ */
++ (PGUserTableCache *)sharedUserTableCache;
+
+/*!
+ @abstract Returns a shared, read-only user table for the user table file at the specified path, opening it if it isn't cached or has changed.
+ 
+ @param path The path of the user table file. May not be nil.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ 
+ @return The user table, or nil if the file could not be opened.
+ */
+- (PGUserTable *)userTableAtPath:(NSString *)path error:(NSError **)errorOut;
+
+/*!
+ @abstract Removes the table for the specified path from the cache, if there is one.
+ @param path The path of the user table file. May not be nil.
+ */
+- (void)removeUserTableAtPath:(NSString *)path;
+
+/*!
+ @abstract Removes every table from the cache and resets its counters.
+ */
+- (void)removeAllUserTables;
+
+/*!
+ @abstract Returns the number of tables in the cache.
+ @return The number of cached tables.
+ */
+- (NSUInteger)count;
+
+/*!
+ @abstract Returns the number of bytes of user table files and logs the cached tables have mapped or replayed into memory.
+ @return The cached tables' memory footprint in bytes.
+ */
+- (unsigned long long)footprint;
+
+/*!
+ @abstract Returns the number of lookups that were handed a cached table.
+ @return The hit count.
+ */
+- (NSUInteger)hitCount;
+
+/*!
+ @abstract Returns the number of lookups that had to open a table because none was cached or the cached one had changed.
+ @return The miss count.
+ */
+- (NSUInteger)missCount;
+
+/*!
+ @abstract Returns the fraction of lookups that were handed a cached table.
+ @return The hit count divided by the total number of lookups, or 0 if there have been none.
+ */
+- (double)hitRate;
+
+@end
@@ -0,0 +1,361 @@
+//
+//  PGUserTableCache.m
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGUserTableCache.h"
+
+#import <sys/stat.h>
+
+#import "PGUserTable.h"
+
+
+#pragma mark Constants and Functions
+
+/*! @abstract The default maximum number of tables a cache holds. */
+static const NSUInteger PGUserTableCacheDefaultCountLimit = 64;
+
+/*! @abstract The identity and version of a file, as reported by stat(2). All fields are 0 if the file doesn't exist. */
+typedef struct {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec modificationTime;
+} PGUserTableCacheFileSignature;
+
+/*! @abstract The identity and version of a user table file and its log. */
+typedef struct {
+    PGUserTableCacheFileSignature table;
+    PGUserTableCacheFileSignature log;
+} PGUserTableCacheSignature;
+
+
+/*!
+ @abstract Gets the signature of the file at the specified path.
+ @param path The path of the file. May not be nil.
+ @param signature On output, the file's signature. It is zeroed if the file doesn't exist. May not be NULL.
+ @return 0 if the file was stat'ed or doesn't exist, or an errno value.
+ */
+static int PGUserTableCacheGetFileSignature(NSString *path, PGUserTableCacheFileSignature *signature)
+{
+    // Zero the whole structure, padding included, so that signatures can be compared with memcmp
+    memset(signature, 0, sizeof(*signature));
+    
+    struct stat fileStatus;
+    if (stat([path fileSystemRepresentation], &fileStatus) == -1) return errno == ENOENT ? 0 : errno;
+    
+    signature->device = fileStatus.st_dev;
+    signature->inode = fileStatus.st_ino;
+    signature->size = fileStatus.st_size;
+    signature->modificationTime = fileStatus.st_mtimespec;
+    return 0;
+}
+
+
+#pragma mark - Entries
+
+/*!
+ @abstract PGUserTableCacheEntry instances hold a cached user table and the signature of the files it was opened from.
+ @discussion Entries are only accessed on their cache's queue.
+ */
+@interface PGUserTableCacheEntry : NSObject
+
+/*! @abstract The cached table. */
+@property(readonly, strong) PGUserTable *table;
+
+/*! @abstract The signature of the table file and its log from just before the table was opened. */
+@property(readonly) PGUserTableCacheSignature signature;
+
+/*! @abstract When the entry was last used, as a value of the cache's use counter. */
+@property(readwrite) uint64_t lastUse;
+
+/*!
+ @abstract Initializes a newly allocated entry with the specified table and signature.
+ @param table The table. May not be nil.
+ @param signature The signature of the table file and its log.
+ @return An initialized entry.
+ */
+- (id)initWithTable:(PGUserTable *)table signature:(PGUserTableCacheSignature)signature;
+
+/*!
+ @abstract Returns the number of bytes of the table file and log the entry's table has mapped or replayed.
+ @return The entry's footprint in bytes.
+ */
+- (unsigned long long)footprint;
+
+@end
+
+
+@implementation PGUserTableCacheEntry
+
+@synthesize table = _table;
+@synthesize signature = _signature;
+@synthesize lastUse = _lastUse;
+
+- (id)initWithTable:(PGUserTable *)table signature:(PGUserTableCacheSignature)signature
+{
+    if (!(self = [super init])) return nil;
+    
+    _table = table;
+    _signature = signature;
+    return self;
+}
+
+
+- (unsigned long long)footprint
+{
+    return _signature.table.size + _signature.log.size;
+}
+
+@end
+
+
+#pragma mark - Private Methods Interface
+
+@interface PGUserTableCache ()
+
+/*!
+ @abstract Removes the least recently used entries until the cache holds no more than countLimit tables.
+ @discussion This must only be invoked on the cache's queue.
+ */
+- (void)evictEntriesOverCountLimit;
+
+@end
+
+
+#pragma mark -
+
+@implementation PGUserTableCache {
+    // Serializes access to the entries and counters
+    dispatch_queue_t _queue;
+    
+    // Entries keyed by standardized path
+    NSMutableDictionary *_entries;
+    
+    // Incremented on every use of an entry, to order entries for eviction
+    uint64_t _useCount;
+    
+    NSUInteger _hitCount;
+    NSUInteger _missCount;
+}
+
+@synthesize countLimit = _countLimit;
+
+- (id)init
+{
+    if (!(self = [super init])) return nil;
+    
+    _countLimit = PGUserTableCacheDefaultCountLimit;
+    _queue = dispatch_queue_create("com.quantumlenscap.PGUserTableCache", DISPATCH_QUEUE_SERIAL);
+    _entries = [[NSMutableDictionary alloc] init];
+    return self;
+}
+
+
+- (void)dealloc
+{
+    dispatch_release(_queue);
+}
+
+
++ (PGUserTableCache *)sharedUserTableCache
+{
+    static PGUserTableCache *sharedUserTableCache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedUserTableCache = [[PGUserTableCache alloc] init];
+    });
+    
+    return sharedUserTableCache;
+}
+
+
+- (NSUInteger)countLimit
+{
+    __block NSUInteger countLimit = 0;
+    dispatch_sync(_queue, ^{
+        countLimit = _countLimit;
+    });
+    
+    return countLimit;
+}
+
+
+- (void)setCountLimit:(NSUInteger)countLimit
+{
+    dispatch_sync(_queue, ^{
+        _countLimit = countLimit;
+        [self evictEntriesOverCountLimit];
+    });
+}
+
+
+#pragma mark Looking Up Tables
+
+- (PGUserTable *)userTableAtPath:(NSString *)path error:(NSError **)errorOut
+{
+    NSAssert(path, @"nil path");
+    
+    // The signature is taken before the table is opened, so if the files change in between, the cached signature is out of date and the next 
+    // lookup reopens the table rather than handing out a stale one
+    NSString *key = [path stringByStandardizingPath];
+    PGUserTableCacheSignature signature;
+    int errorNumber = PGUserTableCacheGetFileSignature(key, &signature.table);
+    if (errorNumber == 0) errorNumber = PGUserTableCacheGetFileSignature([[key stringByDeletingPathExtension] stringByAppendingPathExtension:@"log"], 
+                                                                         &signature.log);
+    if (errorNumber != 0) {
+        if (errorOut) *errorOut = [NSError errorWithDomain:NSPOSIXErrorDomain code:errorNumber userInfo:nil];
+        return nil;
+    }
+    
+    __block PGUserTable *table = nil;
+    dispatch_sync(_queue, ^{
+        PGUserTableCacheEntry *entry = [_entries objectForKey:key];
+        PGUserTableCacheSignature entrySignature = signature;
+        if (entry) entrySignature = [entry signature];
+        
+        if (entry && memcmp(&entrySignature, &signature, sizeof(signature)) == 0) {
+            ++_hitCount;
+            [entry setLastUse:++_useCount];
+            table = [entry table];
+        } else {
+            ++_missCount;
+        }
+    });
+    
+    if (table) return table;
+    
+    // Open the table off the queue so that lookups of other paths aren't held up. Concurrent misses for the same path each open the table, and 
+    // the last one opened is cached.
+    table = [[PGUserTable alloc] initWithContentsOfFile:key error:errorOut];
+    if (!table) return nil;
+    [table makeReadOnly];
+    
+    dispatch_sync(_queue, ^{
+        PGUserTableCacheEntry *entry = [[PGUserTableCacheEntry alloc] initWithTable:table signature:signature];
+        [entry setLastUse:++_useCount];
+        [_entries setObject:entry forKey:key];
+        [self evictEntriesOverCountLimit];
+    });
+    
+    return table;
+}
+
+
+- (void)removeUserTableAtPath:(NSString *)path
+{
+    NSAssert(path, @"nil path");
+    
+    dispatch_sync(_queue, ^{
+        [_entries removeObjectForKey:[path stringByStandardizingPath]];
+    });
+}
+
+
+- (void)removeAllUserTables
+{
+    dispatch_sync(_queue, ^{
+        [_entries removeAllObjects];
+        _hitCount = 0;
+        _missCount = 0;
+    });
+}
+
+
+- (void)evictEntriesOverCountLimit
+{
+    while ([_entries count] > _countLimit) {
+        __block NSString *leastRecentlyUsedKey = nil;
+        __block uint64_t leastRecentUse = UINT64_MAX;
+        [_entries enumerateKeysAndObjectsUsingBlock:^(NSString *key, PGUserTableCacheEntry *entry, BOOL *stop) {
+            if ([entry lastUse] < leastRecentUse) {
+                leastRecentUse = [entry lastUse];
+                leastRecentlyUsedKey = key;
+            }
+        }];
+        
+        [_entries removeObjectForKey:leastRecentlyUsedKey];
+    }
+}
+
+
+#pragma mark Statistics
+
+- (NSUInteger)count
+{
+    __block NSUInteger count = 0;
+    dispatch_sync(_queue, ^{
+        count = [_entries count];
+    });
+    
+    return count;
+}
+
+
+- (unsigned long long)footprint
+{
+    __block unsigned long long footprint = 0;
+    dispatch_sync(_queue, ^{
+        for (PGUserTableCacheEntry *entry in [_entries objectEnumerator]) {
+            footprint += [entry footprint];
+        }
+    });
+    
+    return footprint;
+}
+
+
+- (NSUInteger)hitCount
+{
+    __block NSUInteger hitCount = 0;
+    dispatch_sync(_queue, ^{
+        hitCount = _hitCount;
+    });
+    
+    return hitCount;
+}
+
+
+- (NSUInteger)missCount
+{
+    __block NSUInteger missCount = 0;
+    dispatch_sync(_queue, ^{
+        missCount = _missCount;
+    });
+    
+    return missCount;
+}
+
+
+- (double)hitRate
+{
+    __block double hitRate = 0.0;
+    dispatch_sync(_queue, ^{
+        if (_hitCount + _missCount > 0) hitRate = (double)_hitCount / (_hitCount + _missCount);
+    });
+    
+    return hitRate;
+}
+
+@end
@@ -0,0 +1,129 @@
+//
+//  PGUserTableFormat.c
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include "PGUserTableFormat.h"
+
+#include <string.h>
+
+
+#pragma mark Functions
+
+uint64_t PGUserTableHash(const void *bytes, size_t length)
+{
+    const uint8_t *byteArray = bytes;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= byteArray[i];
+        hash *= 0x100000001b3ULL;
+    }
+    
+    return hash;
+}
+
+
+uint32_t PGUserTableBucketCountForRecordCount(uint32_t recordCount)
+{
+    uint32_t bucketCount = PGUserTableMinimumBucketCount;
+    while (bucketCount < 2 * (uint64_t)recordCount) bucketCount <<= 1;
+    return bucketCount;
+}
+
+
+void PGUserTableIndexInsert(uint32_t *buckets, uint32_t bucketCount, uint64_t userHash, uint32_t recordIndex)
+{
+    uint32_t bucket = userHash & (bucketCount - 1);
+    while (buckets[bucket] != PGUserTableEmptyBucket) bucket = (bucket + 1) & (bucketCount - 1);
+    buckets[bucket] = PGUserTableEncode32(recordIndex);
+}
+
+
+bool PGUserTableLayoutInitialize(PGUserTableLayout *layout, const void *bytes, size_t length)
+{
+    if (length < sizeof(PGUserTableHeader)) return false;
+    
+    const PGUserTableHeader *header = bytes;
+    uint32_t version = PGUserTableDecode32(header->version);
+    uint32_t recordCount = PGUserTableDecode32(header->recordCount);
+    uint32_t bucketCount = PGUserTableDecode32(header->bucketCount);
+    uint64_t recordsOffset = PGUserTableDecode64(header->recordsOffset);
+    uint64_t bucketsOffset = PGUserTableDecode64(header->bucketsOffset);
+    uint64_t heapOffset = PGUserTableDecode64(header->heapOffset);
+    uint64_t heapLength = PGUserTableDecode64(header->heapLength);
+    size_t recordSize = version == PGUserTableVersion1 ? PGUserTableVersion1RecordSize : sizeof(PGUserTableRecord);
+    
+    // Make sure that every region the header describes lies within the file
+    bool valid = PGUserTableDecode32(header->magic) == PGUserTableMagic && (version == PGUserTableVersion || version == PGUserTableVersion1) &&
+        bucketCount >= PGUserTableMinimumBucketCount && (bucketCount & (bucketCount - 1)) == 0 && recordCount < bucketCount &&
+        recordsOffset <= length && (uint64_t)recordCount * recordSize <= length - recordsOffset &&
+        recordsOffset % sizeof(uint64_t) == 0 && bucketsOffset % sizeof(uint32_t) == 0 &&
+        bucketsOffset <= length && (uint64_t)bucketCount * sizeof(uint32_t) <= length - bucketsOffset &&
+        heapOffset <= length && heapLength <= length - heapOffset;
+    if (!valid) return false;
+    
+    layout->records = (const uint8_t *)bytes + recordsOffset;
+    layout->buckets = (const uint32_t *)((const uint8_t *)bytes + bucketsOffset);
+    layout->heap = (const uint8_t *)bytes + heapOffset;
+    layout->recordSize = recordSize;
+    layout->heapLength = heapLength;
+    layout->recordCount = recordCount;
+    layout->bucketCount = bucketCount;
+    return true;
+}
+
+
+const PGUserTableRecord *PGUserTableLayoutRecordAtIndex(const PGUserTableLayout *layout, uint32_t recordIndex)
+{
+    return (const PGUserTableRecord *)(layout->records + (size_t)recordIndex * layout->recordSize);
+}
+
+
+const uint8_t *PGUserTableLayoutHeapBytes(const PGUserTableLayout *layout, PGUserTableHeapReference reference)
+{
+    if ((uint64_t)reference.offset + reference.length > layout->heapLength) return NULL;
+    return layout->heap + reference.offset;
+}
+
+
+uint32_t PGUserTableLayoutFindUser(const PGUserTableLayout *layout, const void *user, size_t userLength)
+{
+    uint32_t bucketCount = layout->bucketCount;
+    if (bucketCount == 0) return PGUserTableEmptyBucket;
+    
+    uint64_t userHash = PGUserTableHash(user, userLength);
+    for (uint32_t probe = 0, bucket = userHash & (bucketCount - 1); probe < bucketCount; ++probe, bucket = (bucket + 1) & (bucketCount - 1)) {
+        uint32_t recordIndex = PGUserTableDecode32(layout->buckets[bucket]);
+        if (recordIndex == PGUserTableEmptyBucket || recordIndex >= layout->recordCount) return PGUserTableEmptyBucket;
+        
+        const PGUserTableRecord *record = PGUserTableLayoutRecordAtIndex(layout, recordIndex);
+        if (PGUserTableDecode64(record->userHash) != userHash) continue;
+        
+        PGUserTableHeapReference userReference = { PGUserTableDecode32(record->user.offset), PGUserTableDecode32(record->user.length) };
+        const uint8_t *recordUserBytes = PGUserTableLayoutHeapBytes(layout, userReference);
+        if (recordUserBytes && userReference.length == userLength && memcmp(recordUserBytes, user, userLength) == 0) return recordIndex;
+    }
+    
+    return PGUserTableEmptyBucket;
+}
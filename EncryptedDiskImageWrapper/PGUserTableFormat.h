@@ -0,0 +1,229 @@
+//
+//  PGUserTableFormat.h
+//  EncryptedDiskImageWrapper
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ PGUserTableFormat describes the user table file format and reads it in place. A user table file has a header, fixed-size records, an open
+ addressing hash index keyed by user name, and a heap of variable-length fields. PGUserTable writes these files and memory-maps them, and uses
+ these functions to validate a mapped file and look users up in it. They're plain C, so the same code can be benchmarked on platforms without
+ Foundation (see PGPortableBenchmarks.c).
+ 
+ All integers in a user table file are stored little-endian. Offsets are relative to the beginning of the file, except for those in records, 
+ which are relative to the beginning of the heap.
+ */
+
+/*! @abstract The magic number at the start of every user table file: "PGUT". */
+static const uint32_t PGUserTableMagic = 0x54554750;
+
+/*!
+ @abstract The version of the user table file format used when any entry has key derivation parameters.
+ @discussion Version 2 records have key derivation fields at the end. Tables without such entries are written as version 1, which earlier 
+     versions can read.
+ */
+static const uint32_t PGUserTableVersion = 2;
+
+/*! @abstract The earliest version of the user table file format, whose records end before the key derivation fields. */
+static const uint32_t PGUserTableVersion1 = 1;
+
+/*! @abstract The value of an empty slot in the hash index. Other slots contain a record index. */
+static const uint32_t PGUserTableEmptyBucket = UINT32_MAX;
+
+/*! @abstract The minimum number of slots in the hash index. */
+static const uint32_t PGUserTableMinimumBucketCount = 8;
+
+/*! @abstract The header at the beginning of a user table file. */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordCount;
+    uint32_t bucketCount;
+    uint64_t recordsOffset;
+    uint64_t bucketsOffset;
+    uint64_t heapOffset;
+    uint64_t heapLength;
+} PGUserTableHeader;
+
+/*! @abstract A reference to a run of bytes in a user table file's heap. */
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+} PGUserTableHeapReference;
+
+/*!
+ @abstract A fixed-size user table record. Each record corresponds to one user table entry.
+ @discussion The algorithm field was reserved and always 0 in tables written by earlier versions, which is PGAES256CBCEncryptionAlgorithm. 
+     Version 1 records end after the algorithm field, and their keys were derived with PBKDF2. A keyDerivation of 0 is 
+     PGPBKDF2KeyDerivationAlgorithm, whose records have no block size or lanes.
+ */
+typedef struct {
+    uint64_t userHash;
+    PGUserTableHeapReference user;
+    PGUserTableHeapReference salt;
+    PGUserTableHeapReference initializationVector;
+    PGUserTableHeapReference secret;
+    uint32_t rounds;
+    uint32_t algorithm;
+    uint32_t keyDerivation;
+    uint32_t blockSize;
+    uint32_t lanes;
+    uint32_t reserved;
+} PGUserTableRecord;
+
+/*! @abstract The size of a version 1 user table record. */
+static const size_t PGUserTableVersion1RecordSize = offsetof(PGUserTableRecord, keyDerivation);
+
+/*!
+ @abstract The regions of a validated user table file.
+ @discussion A layout points into the bytes with which it was initialized, which must stay valid for as long as it is used.
+ */
+typedef struct {
+    const uint8_t *records;
+    const uint32_t *buckets;
+    const uint8_t *heap;
+    size_t recordSize;
+    uint64_t heapLength;
+    uint32_t recordCount;
+    uint32_t bucketCount;
+} PGUserTableLayout;
+
+/*!
+ @abstract Returns the 64-bit FNV-1a hash of the specified bytes.
+ @param bytes The bytes to hash. May only be NULL if length is 0.
+ @param length The number of bytes to hash.
+ @return The hash of the bytes
+ */
+extern uint64_t PGUserTableHash(const void *bytes, size_t length);
+
+/*!
+ @abstract Returns the smallest power of two that is at least twice the specified record count.
+ @discussion Keeping the index at most half full keeps linear probe sequences short.
+ @param recordCount The number of records in the table.
+ @return The number of slots the table's hash index should have.
+ */
+extern uint32_t PGUserTableBucketCountForRecordCount(uint32_t recordCount);
+
+/*!
+ @abstract Inserts a record into a hash index that is being written.
+ @discussion The record goes in the first free slot at or after the user's hash. Empty slots must have been set to PGUserTableEmptyBucket.
+ @param buckets The index's slots. May not be NULL.
+ @param bucketCount The number of slots, which must be a power of two greater than the number of records.
+ @param userHash The hash of the record's user name.
+ @param recordIndex The index of the record, which is stored little-endian.
+ */
+extern void PGUserTableIndexInsert(uint32_t *buckets, uint32_t bucketCount, uint64_t userHash, uint32_t recordIndex);
+
+/*!
+ @abstract Validates the header of a user table file and initializes a layout describing its regions.
+ @discussion Every region the header describes must lie within the file. Records are not validated until they are accessed.
+ @param layout The layout to initialize. May not be NULL.
+ @param bytes The contents of the file, which must be 8-byte aligned, e.g., because they were memory-mapped.
+ @param length The length of the file in bytes.
+ @return Whether the file is a user table file whose version is understood. If not, the layout is left unchanged.
+ */
+extern bool PGUserTableLayoutInitialize(PGUserTableLayout *layout, const void *bytes, size_t length);
+
+/*!
+ @abstract Returns the record at the specified index.
+ @param layout The layout of the table. May not be NULL.
+ @param recordIndex The index of the record, which must be less than the table's record count.
+ @return The record. Only the first recordSize bytes of it are in the file.
+ */
+extern const PGUserTableRecord *PGUserTableLayoutRecordAtIndex(const PGUserTableLayout *layout, uint32_t recordIndex);
+
+/*!
+ @abstract Returns the bytes in the heap to which the specified reference refers.
+ @param layout The layout of the table. May not be NULL.
+ @param reference The reference, in host byte order.
+ @return The referenced bytes, or NULL if they don't lie within the heap.
+ */
+extern const uint8_t *PGUserTableLayoutHeapBytes(const PGUserTableLayout *layout, PGUserTableHeapReference reference);
+
+/*!
+ @abstract Looks up the record for the specified user by probing the hash index.
+ @discussion Hashes are compared before names, so a lookup usually reads just one slot and one record. A slot that refers to a record that 
+     doesn't exist ends the probe, as if it were empty.
+ @param layout The layout of the table. May not be NULL.
+ @param user The user's name as UTF-8. May only be NULL if userLength is 0.
+ @param userLength The length of the user's name in bytes.
+ @return The index of the user's record, or PGUserTableEmptyBucket if the user has none.
+ */
+extern uint32_t PGUserTableLayoutFindUser(const PGUserTableLayout *layout, const void *user, size_t userLength);
+
+/*!
+ @abstract Converts a 32-bit value read from a user table file to host byte order.
+ @param value The value as stored in the file.
+ @return The value in host byte order.
+ */
+static inline uint32_t PGUserTableDecode32(uint32_t value)
+{
+    const uint8_t *bytes = (const uint8_t *)&value;
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+
+/*!
+ @abstract Converts a 64-bit value read from a user table file to host byte order.
+ @param value The value as stored in the file.
+ @return The value in host byte order.
+ */
+static inline uint64_t PGUserTableDecode64(uint64_t value)
+{
+    const uint8_t *bytes = (const uint8_t *)&value;
+    uint64_t result = 0;
+    for (int i = 7; i >= 0; --i) result = result << 8 | bytes[i];
+    return result;
+}
+
+
+/*!
+ @abstract Converts a 32-bit value in host byte order to the form in which it's stored in a user table file.
+ @param value The value in host byte order.
+ @return The value as stored in the file.
+ */
+static inline uint32_t PGUserTableEncode32(uint32_t value)
+{
+    uint32_t result;
+    uint8_t *bytes = (uint8_t *)&result;
+    for (int i = 0; i < 4; ++i) bytes[i] = (uint8_t)(value >> (8 * i));
+    return result;
+}
+
+
+/*!
+ @abstract Converts a 64-bit value in host byte order to the form in which it's stored in a user table file.
+ @param value The value in host byte order.
+ @return The value as stored in the file.
+ */
+static inline uint64_t PGUserTableEncode64(uint64_t value)
+{
+    uint64_t result;
+    uint8_t *bytes = (uint8_t *)&result;
+    for (int i = 0; i < 8; ++i) bytes[i] = (uint8_t)(value >> (8 * i));
+    return result;
+}
@@ -0,0 +1,88 @@
+//
+//  PGBenchmarkRunner.h
+//  EncryptedDiskImageWrapperBenchmarks
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+/*!
+ @abstract PGBenchmarkRunner instances time blocks of code and collect the results as a machine-readable report.
+ @discussion Each benchmark is identified by a name and an optional parameter, e.g., a payload size or user count, so that a single benchmark can 
+     be run across a sweep of parameter values. A benchmark's block is run once to warm up and then a fixed number of timed iterations. The report 
+     summarizes each benchmark's iteration times with their minimum, maximum, mean, and 50th, 90th, and 99th percentiles, all in nanoseconds. 
+     Benchmarks that process a known number of bytes per iteration also report their median throughput.
+ */
+@interface PGBenchmarkRunner : NSObject
+
+/*! @abstract The number of timed iterations of each benchmark. */
+@property(readonly) NSUInteger iterations;
+
+/*! @abstract If non-nil, only benchmarks whose names contain this string are run. */
+@property(readonly, copy) NSString *filter;
+
+/*!
+ @abstract Initializes a newly allocated benchmark runner.
+ @param iterations The number of timed iterations of each benchmark. Must be positive.
+ @param filter If non-nil, only benchmarks whose names contain this string are run.
+ @return An initialized benchmark runner.
+ */
+- (id)initWithIterations:(NSUInteger)iterations filter:(NSString *)filter;
+
+/*!
+ @abstract Returns whether the benchmark with the specified name would be run.
+ @discussion Use this to skip expensive setup for benchmarks that are filtered out.
+ @param name The benchmark's name. May not be nil.
+ @return Whether the benchmark matches the runner's filter.
+ */
+- (BOOL)shouldRunBenchmarkNamed:(NSString *)name;
+
+/*!
+ @abstract Times the specified block and adds its results to the report.
+ @discussion Does nothing if the benchmark doesn't match the runner's filter. Each iteration is run inside its own autorelease pool.
+ 
+ @param name The benchmark's name. May not be nil.
+ @param parameterName The name of the parameter the benchmark is being run with, e.g., "bytes" or "users". May be nil if the benchmark takes no
+     parameter.
+ @param parameterValue The value of the parameter. Ignored if parameterName is nil.
+ @param bytesPerIteration The number of bytes each iteration processes, or 0 if throughput isn't meaningful for the benchmark.
+ @param block The code to time. May not be nil.
+ */
+- (void)runBenchmarkNamed:(NSString *)name parameterName:(NSString *)parameterName parameterValue:(NSUInteger)parameterValue
+        bytesPerIteration:(NSUInteger)bytesPerIteration block:(void (^)(void))block;
+
+/*!
+ @abstract Returns a report of the results of every benchmark run so far.
+ @return A JSON-compatible dictionary containing the report.
+ */
+- (NSDictionary *)report;
+
+/*!
+ @abstract Returns the report as JSON data.
+ @param errorOut On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object containing the error
+     information. You may specify NULL for this parameter if you do not want the error information.
+ @return The report as JSON data, or nil if it couldn't be serialized.
+ */
+- (NSData *)reportJSONData:(NSError **)errorOut;
+
+@end
@@ -0,0 +1,181 @@
+//
+//  PGBenchmarkRunner.m
+//  EncryptedDiskImageWrapperBenchmarks
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGBenchmarkRunner.h"
+
+#import <mach/mach_time.h>
+
+
+#pragma mark Constants and Functions
+
+/*! @abstract The version of the report format, which should be incremented whenever the format changes incompatibly. */
+static const NSUInteger PGBenchmarkReportVersion = 1;
+
+
+/*!
+ @abstract Returns the specified percentile of a sorted array of samples using the nearest-rank method.
+ @param samples The samples, sorted in ascending order. May not be NULL.
+ @param count The number of samples. Must be positive.
+ @param percentile The percentile, between 0 and 100.
+ @return The sample at the percentile.
+ */
+static uint64_t PGBenchmarkPercentile(const uint64_t *samples, NSUInteger count, double percentile)
+{
+    NSUInteger rank = (NSUInteger)ceil(percentile / 100.0 * count);
+    return samples[rank > 0 ? rank - 1 : 0];
+}
+
+
+/*!
+ @abstract Compares two samples for qsort.
+ */
+static int PGBenchmarkCompareSamples(const void *sample1, const void *sample2)
+{
+    uint64_t value1 = *(const uint64_t *)sample1;
+    uint64_t value2 = *(const uint64_t *)sample2;
+    return value1 < value2 ? -1 : (value1 > value2 ? 1 : 0);
+}
+
+
+#pragma mark -
+
+@implementation PGBenchmarkRunner
+{
+    NSMutableArray *_results;
+    mach_timebase_info_data_t _timebase;
+}
+
+@synthesize iterations = _iterations;
+@synthesize filter = _filter;
+
+- (id)init
+{
+    // There’s no meaningful default values for our designated initializer, so we just don't recognize the -init message.
+    [self doesNotRecognizeSelector:_cmd];
+    return nil;
+}
+
+
+- (id)initWithIterations:(NSUInteger)iterations filter:(NSString *)filter
+{
+    NSAssert(iterations > 0, @"no iterations");
+    
+    if (!(self = [super init])) return nil;
+    
+    _iterations = iterations;
+    _filter = [filter copy];
+    _results = [[NSMutableArray alloc] init];
+    mach_timebase_info(&_timebase);
+    
+    return self;
+}
+
+
+- (BOOL)shouldRunBenchmarkNamed:(NSString *)name
+{
+    NSAssert(name, @"nil name");
+    return !_filter || [name rangeOfString:_filter].location != NSNotFound;
+}
+
+
+- (void)runBenchmarkNamed:(NSString *)name parameterName:(NSString *)parameterName parameterValue:(NSUInteger)parameterValue
+        bytesPerIteration:(NSUInteger)bytesPerIteration block:(void (^)(void))block
+{
+    NSAssert(block, @"nil block");
+    if (![self shouldRunBenchmarkNamed:name]) return;
+    
+    // Warm up caches and lazily initialized state before timing anything
+    @autoreleasepool {
+        block();
+    }
+    
+    uint64_t *samples = malloc(_iterations * sizeof(uint64_t));
+    for (NSUInteger i = 0; i < _iterations; ++i) {
+        @autoreleasepool {
+            uint64_t startTime = mach_absolute_time();
+            block();
+            samples[i] = (mach_absolute_time() - startTime) * _timebase.numer / _timebase.denom;
+        }
+    }
+    
+    qsort(samples, _iterations, sizeof(uint64_t), PGBenchmarkCompareSamples);
+    
+    uint64_t total = 0;
+    for (NSUInteger i = 0; i < _iterations; ++i) {
+        total += samples[i];
+    }
+    
+    uint64_t median = PGBenchmarkPercentile(samples, _iterations, 50);
+    NSMutableDictionary *result = [NSMutableDictionary dictionaryWithObjectsAndKeys:name, @"name",
+                                   [NSNumber numberWithUnsignedInteger:_iterations], @"iterations",
+                                   [NSNumber numberWithUnsignedLongLong:samples[0]], @"min",
+                                   [NSNumber numberWithUnsignedLongLong:samples[_iterations - 1]], @"max",
+                                   [NSNumber numberWithUnsignedLongLong:total / _iterations], @"mean",
+                                   [NSNumber numberWithUnsignedLongLong:median], @"p50",
+                                   [NSNumber numberWithUnsignedLongLong:PGBenchmarkPercentile(samples, _iterations, 90)], @"p90",
+                                   [NSNumber numberWithUnsignedLongLong:PGBenchmarkPercentile(samples, _iterations, 99)], @"p99", nil];
+    free(samples);
+    
+    if (parameterName) {
+        [result setObject:parameterName forKey:@"parameter"];
+        [result setObject:[NSNumber numberWithUnsignedInteger:parameterValue] forKey:@"value"];
+    }
+    
+    if (bytesPerIteration > 0 && median > 0) {
+        [result setObject:[NSNumber numberWithDouble:bytesPerIteration * 1e9 / median] forKey:@"bytesPerSecond"];
+    }
+    
+    [_results addObject:result];
+}
+
+
+- (NSDictionary *)report
+{
+    NSDateFormatter *dateFormatter = [[NSDateFormatter alloc] init];
+    [dateFormatter setLocale:[[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"]];
+    [dateFormatter setTimeZone:[NSTimeZone timeZoneWithName:@"UTC"]];
+    [dateFormatter setDateFormat:@"yyyy-MM-dd'T'HH:mm:ss'Z'"];
+    
+    NSProcessInfo *processInfo = [NSProcessInfo processInfo];
+    NSDictionary *host = [NSDictionary dictionaryWithObjectsAndKeys:[processInfo hostName], @"name",
+                          [processInfo operatingSystemVersionString], @"operatingSystem",
+                          [NSNumber numberWithUnsignedInteger:[processInfo activeProcessorCount]], @"processors",
+                          [NSNumber numberWithUnsignedLongLong:[processInfo physicalMemory]], @"memory", nil];
+    
+    return [NSDictionary dictionaryWithObjectsAndKeys:[NSNumber numberWithUnsignedInteger:PGBenchmarkReportVersion], @"version",
+            [dateFormatter stringFromDate:[NSDate date]], @"date",
+            host, @"host",
+            @"ns", @"unit",
+            [_results copy], @"results", nil];
+}
+
+
+- (NSData *)reportJSONData:(NSError **)errorOut
+{
+    return [NSJSONSerialization dataWithJSONObject:[self report] options:NSJSONWritingPrettyPrinted error:errorOut];
+}
+
+@end
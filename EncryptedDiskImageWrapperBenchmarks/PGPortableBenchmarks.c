@@ -0,0 +1,784 @@
+//
+//  PGPortableBenchmarks.c
+//  EncryptedDiskImageWrapperBenchmarks
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <mach/mach_time.h>
+#endif
+
+#include "PGCodec.h"
+#include "PGScrypt.h"
+#include "PGUserTableFormat.h"
+
+/*
+ Runs the benchmarks whose code is plain C -- the crypto providers, scrypt, the codecs, and the user table's file format and lookup -- without
+ Foundation, so that they can be run headless on any POSIX system. The report has the same format as the one the main benchmark suite writes,
+ and benchmarks have the same names, so the two can be compared directly. Build it from the repository's root with
+
+   cc -O2 -std=gnu99 -IEncryptedDiskImageWrapper -o PGPortableBenchmarks EncryptedDiskImageWrapperBenchmarks/PGPortableBenchmarks.c \
+       EncryptedDiskImageWrapper/PGCodec.c EncryptedDiskImageWrapper/PGCryptoProvider.c EncryptedDiskImageWrapper/PGCommonCryptoProvider.c \
+       EncryptedDiskImageWrapper/PGOpenSSLCryptoProvider.c EncryptedDiskImageWrapper/PGKeyArena.c EncryptedDiskImageWrapper/PGScrypt.c \
+       EncryptedDiskImageWrapper/PGUserTableFormat.c -lcrypto -lpthread -lm
+
+ and run it with the same options as the main suite:
+
+   -iterations N   The number of timed iterations of each benchmark. Defaults to 20.
+   -filter NAME    Only runs benchmarks whose names contain NAME.
+   -output PATH    Writes the report to PATH instead of standard output.
+
+ UserTable.open maps a table and reads one entry the way PGUserTable does, and UserTable.lookup reads a random user's entry from a mapped
+ table. Both copy the entry's fields, but don't pay for the Foundation objects that PGUserTable puts them in.
+ */
+
+
+#pragma mark Constants and Types
+
+/*! @abstract The version of the report format. This matches the main benchmark suite's. */
+static const unsigned PGPortableBenchmarkReportVersion = 1;
+
+/*! @abstract The default number of timed iterations of each benchmark. */
+static const size_t PGPortableBenchmarkDefaultIterations = 20;
+
+/*! @abstract The result of one benchmark, with times in nanoseconds. */
+typedef struct {
+    char name[64];
+    const char *parameterName;
+    size_t parameterValue;
+    size_t iterations;
+    uint64_t min, max, mean, p50, p90, p99;
+    double bytesPerSecond;
+} PGPortableBenchmarkResult;
+
+/*! @abstract Runs benchmarks and collects their results. */
+typedef struct {
+    size_t iterations;
+    const char *filter;
+    PGPortableBenchmarkResult *results;
+    size_t resultCount;
+    size_t resultCapacity;
+} PGPortableBenchmarkRunner;
+
+/*! @abstract A function that runs one iteration of a benchmark. */
+typedef void (*PGPortableBenchmarkFunction)(void *context);
+
+
+#pragma mark - Runner
+
+/*!
+ @abstract Returns the current time of a monotonic clock in nanoseconds.
+ */
+static uint64_t PGPortableBenchmarkTime(void)
+{
+#if defined(__APPLE__)
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0) mach_timebase_info(&timebase);
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+#endif
+}
+
+
+/*!
+ @abstract Returns the specified percentile of a sorted array of samples using the nearest-rank method.
+ @param samples The samples, sorted in ascending order. May not be NULL.
+ @param count The number of samples. Must be positive.
+ @param percentile The percentile, between 0 and 100.
+ @return The sample at the percentile.
+ */
+static uint64_t PGPortableBenchmarkPercentile(const uint64_t *samples, size_t count, double percentile)
+{
+    size_t rank = (size_t)ceil(percentile / 100.0 * count);
+    return samples[rank > 0 ? rank - 1 : 0];
+}
+
+
+/*!
+ @abstract Compares two samples for qsort.
+ */
+static int PGPortableBenchmarkCompareSamples(const void *sample1, const void *sample2)
+{
+    uint64_t value1 = *(const uint64_t *)sample1;
+    uint64_t value2 = *(const uint64_t *)sample2;
+    return value1 < value2 ? -1 : (value1 > value2 ? 1 : 0);
+}
+
+
+/*!
+ @abstract Returns whether the runner's filter allows the benchmark with the specified name to run.
+ */
+static bool PGPortableBenchmarkShouldRun(const PGPortableBenchmarkRunner *runner, const char *name)
+{
+    return !runner->filter || strstr(name, runner->filter) != NULL;
+}
+
+
+/*!
+ @abstract Runs a benchmark once to warm up, then the runner's number of times, and records the distribution of its times.
+ @param runner The runner. May not be NULL.
+ @param name The benchmark's name. If the runner's filter doesn't allow it, nothing is run.
+ @param parameterName The name of the parameter the benchmark varies, or NULL if it has none.
+ @param parameterValue The parameter's value. Ignored if parameterName is NULL.
+ @param bytesPerIteration The number of bytes each iteration processes, or 0 if throughput isn't meaningful.
+ @param function The function that runs one iteration. May not be NULL.
+ @param context The context passed to the function.
+ */
+static void PGPortableBenchmarkRun(PGPortableBenchmarkRunner *runner, const char *name, const char *parameterName, size_t parameterValue,
+                                   size_t bytesPerIteration, PGPortableBenchmarkFunction function, void *context)
+{
+    if (!PGPortableBenchmarkShouldRun(runner, name)) return;
+
+    // Warm up caches and lazily initialized state before timing anything
+    function(context);
+
+    uint64_t *samples = malloc(runner->iterations * sizeof(uint64_t));
+    for (size_t i = 0; i < runner->iterations; ++i) {
+        uint64_t startTime = PGPortableBenchmarkTime();
+        function(context);
+        samples[i] = PGPortableBenchmarkTime() - startTime;
+    }
+
+    qsort(samples, runner->iterations, sizeof(uint64_t), PGPortableBenchmarkCompareSamples);
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < runner->iterations; ++i) {
+        total += samples[i];
+    }
+
+    if (runner->resultCount == runner->resultCapacity) {
+        runner->resultCapacity = runner->resultCapacity ? runner->resultCapacity * 2 : 64;
+        runner->results = realloc(runner->results, runner->resultCapacity * sizeof(PGPortableBenchmarkResult));
+    }
+
+    PGPortableBenchmarkResult *result = &runner->results[runner->resultCount++];
+    memset(result, 0, sizeof(*result));
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->parameterName = parameterName;
+    result->parameterValue = parameterValue;
+    result->iterations = runner->iterations;
+    result->min = samples[0];
+    result->max = samples[runner->iterations - 1];
+    result->mean = total / runner->iterations;
+    result->p50 = PGPortableBenchmarkPercentile(samples, runner->iterations, 50);
+    result->p90 = PGPortableBenchmarkPercentile(samples, runner->iterations, 90);
+    result->p99 = PGPortableBenchmarkPercentile(samples, runner->iterations, 99);
+    if (bytesPerIteration > 0 && result->p50 > 0) result->bytesPerSecond = bytesPerIteration * 1e9 / result->p50;
+    free(samples);
+}
+
+
+/*!
+ @abstract Writes the runner's report as JSON in the same format as PGBenchmarkRunner's.
+ @param runner The runner. May not be NULL.
+ @param file The file to which to write the report. May not be NULL.
+ */
+static void PGPortableBenchmarkWriteReport(const PGPortableBenchmarkRunner *runner, FILE *file)
+{
+    char date[32];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    char hostName[256] = "";
+    gethostname(hostName, sizeof(hostName) - 1);
+    struct utsname system;
+    uname(&system);
+    unsigned long long memory = (unsigned long long)sysconf(_SC_PHYS_PAGES) * (unsigned long long)sysconf(_SC_PAGESIZE);
+
+    fprintf(file, "{\n  \"version\" : %u,\n  \"date\" : \"%s\",\n", PGPortableBenchmarkReportVersion, date);
+    fprintf(file, "  \"host\" : {\n    \"name\" : \"%s\",\n    \"operatingSystem\" : \"%s %s\",\n    \"processors\" : %ld,\n"
+            "    \"memory\" : %llu\n  },\n", hostName, system.sysname, system.release, sysconf(_SC_NPROCESSORS_ONLN), memory);
+    fprintf(file, "  \"unit\" : \"ns\",\n  \"results\" : [");
+
+    for (size_t i = 0; i < runner->resultCount; ++i) {
+        const PGPortableBenchmarkResult *result = &runner->results[i];
+        fprintf(file, "%s\n    {\n      \"name\" : \"%s\",\n      \"iterations\" : %zu,\n", i > 0 ? "," : "", result->name, result->iterations);
+        fprintf(file, "      \"min\" : %llu,\n      \"max\" : %llu,\n      \"mean\" : %llu,\n", (unsigned long long)result->min,
+                (unsigned long long)result->max, (unsigned long long)result->mean);
+        fprintf(file, "      \"p50\" : %llu,\n      \"p90\" : %llu,\n      \"p99\" : %llu", (unsigned long long)result->p50,
+                (unsigned long long)result->p90, (unsigned long long)result->p99);
+        if (result->parameterName) {
+            fprintf(file, ",\n      \"parameter\" : \"%s\",\n      \"value\" : %zu", result->parameterName, result->parameterValue);
+        }
+
+        if (result->bytesPerSecond > 0) fprintf(file, ",\n      \"bytesPerSecond\" : %.0f", result->bytesPerSecond);
+        fprintf(file, "\n    }");
+    }
+
+    fprintf(file, "\n  ]\n}\n");
+}
+
+
+#pragma mark - Crypto Benchmarks
+
+/*! @abstract The state shared by the crypto benchmarks' iterations. */
+typedef struct {
+    const PGCryptoProvider *provider;
+    const uint8_t *input;
+    size_t length;
+    uint8_t *output;
+    size_t outputCapacity;
+    uint8_t key[32];
+    uint8_t initializationVector[PGCryptoAESBlockSize];
+    uint8_t tag[PGCryptoAESGCMTagLength];
+    uint32_t rounds;
+} PGPortableCryptoContext;
+
+
+static void PGPortableDeriveKey(void *context)
+{
+    PGPortableCryptoContext *crypto = context;
+    uint8_t key[32];
+    crypto->provider->deriveKey(crypto->input, crypto->length, crypto->key, 24, crypto->rounds, key, sizeof(key));
+}
+
+
+static void PGPortableDigest(void *context)
+{
+    PGPortableCryptoContext *crypto = context;
+    crypto->provider->digest(PGCryptoDigestSHA256, crypto->input, crypto->length, crypto->output);
+}
+
+
+/*!
+ @abstract Runs input through a new AES-256-CBC cipher with padding, like NSData's symmetric encryption methods do.
+ @return The number of bytes written to the output, or 0 if the cipher failed.
+ */
+static size_t PGPortableCipher(PGPortableCryptoContext *crypto, PGCryptoOperation operation, const uint8_t *input, size_t length)
+{
+    const PGCryptoProvider *provider = crypto->provider;
+    PGCryptoCipherRef cipher = NULL;
+    if (provider->cipherCreate(operation, PGCryptoModeCBC, true, crypto->key, sizeof(crypto->key), crypto->initializationVector,
+                               &cipher) != PGCryptoSuccess) {
+        return 0;
+    }
+
+    size_t updateLength = 0, finalLength = 0;
+    bool succeeded = provider->cipherUpdate(cipher, input, length, crypto->output, crypto->outputCapacity, &updateLength) == PGCryptoSuccess &&
+        provider->cipherFinal(cipher, crypto->output + updateLength, crypto->outputCapacity - updateLength, &finalLength) == PGCryptoSuccess;
+    provider->cipherRelease(cipher);
+    return succeeded ? updateLength + finalLength : 0;
+}
+
+
+static void PGPortableEncrypt(void *context)
+{
+    PGPortableCipher(context, PGCryptoEncrypt, ((PGPortableCryptoContext *)context)->input, ((PGPortableCryptoContext *)context)->length);
+}
+
+
+/*! @abstract The context of a decryption benchmark, whose ciphertext must be decrypted into a separate buffer. */
+typedef struct {
+    PGPortableCryptoContext crypto;
+    const uint8_t *ciphertext;
+    size_t ciphertextLength;
+} PGPortableDecryptContext;
+
+
+static void PGPortableDecrypt(void *context)
+{
+    PGPortableDecryptContext *decrypt = context;
+    PGPortableCipher(&decrypt->crypto, PGCryptoDecrypt, decrypt->ciphertext, decrypt->ciphertextLength);
+}
+
+
+static void PGPortableSeal(void *context)
+{
+    PGPortableCryptoContext *crypto = context;
+    uint8_t tag[PGCryptoAESGCMTagLength];
+    crypto->provider->GCMSeal(crypto->key, sizeof(crypto->key), crypto->initializationVector, NULL, 0, crypto->input, crypto->length,
+                              crypto->output, tag);
+}
+
+
+static void PGPortableOpen(void *context)
+{
+    PGPortableDecryptContext *decrypt = context;
+    PGPortableCryptoContext *crypto = &decrypt->crypto;
+    crypto->provider->GCMOpen(crypto->key, sizeof(crypto->key), crypto->initializationVector, NULL, 0, decrypt->ciphertext,
+                              decrypt->ciphertextLength, crypto->tag, crypto->output);
+}
+
+
+/*!
+ @abstract Runs the key derivation, digest, and encryption benchmarks with the specified crypto provider.
+ @discussion Benchmarks run with the default provider have unqualified names, e.g., AES.encrypt. Those run with other providers are prefixed
+     with the provider's name, e.g., OpenSSL.AES.encrypt. AES.encryptBuffer and PBKDF.calibrate aren't run, since they only differ from the
+     other benchmarks in the Objective-C code around the provider.
+ @param runner The runner with which to run the benchmarks. May not be NULL.
+ @param provider The crypto provider to benchmark. May not be NULL.
+ */
+static void PGRunCryptoBenchmarks(PGPortableBenchmarkRunner *runner, const PGCryptoProvider *provider)
+{
+    const char *prefix = provider == PGCryptoDefaultProvider() ? "" : provider->name;
+    const char *separator = provider == PGCryptoDefaultProvider() ? "" : ".";
+    char deriveName[64], digestName[64], encryptName[64], decryptName[64], sealName[64], openName[64];
+    snprintf(deriveName, sizeof(deriveName), "%s%sPBKDF.derive", prefix, separator);
+    snprintf(digestName, sizeof(digestName), "%s%sSHA256.digest", prefix, separator);
+    snprintf(encryptName, sizeof(encryptName), "%s%sAES.encrypt", prefix, separator);
+    snprintf(decryptName, sizeof(decryptName), "%s%sAES.decrypt", prefix, separator);
+    snprintf(sealName, sizeof(sealName), "%s%sAESGCM.encrypt", prefix, separator);
+    snprintf(openName, sizeof(openName), "%s%sAESGCM.decrypt", prefix, separator);
+
+    PGPortableCryptoContext crypto = { .provider = provider };
+    provider->randomBytes(crypto.key, sizeof(crypto.key));
+    provider->randomBytes(crypto.initializationVector, sizeof(crypto.initializationVector));
+
+    size_t passwordLengths[] = { 8, 32, 128 };
+    for (size_t i = 0; i < sizeof(passwordLengths) / sizeof(size_t) && PGPortableBenchmarkShouldRun(runner, deriveName); ++i) {
+        uint8_t password[128];
+        provider->randomBytes(password, passwordLengths[i]);
+        crypto.input = password;
+        crypto.length = passwordLengths[i];
+        crypto.rounds = provider->calibrateRounds(crypto.length, 24, 32, 100);
+        PGPortableBenchmarkRun(runner, deriveName, "passwordLength", crypto.length, 0, PGPortableDeriveKey, &crypto);
+    }
+
+    size_t payloadSizes[] = { 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+    for (size_t i = 0; i < sizeof(payloadSizes) / sizeof(size_t); ++i) {
+        size_t payloadSize = payloadSizes[i];
+        if (!PGPortableBenchmarkShouldRun(runner, digestName) && !PGPortableBenchmarkShouldRun(runner, encryptName) &&
+            !PGPortableBenchmarkShouldRun(runner, decryptName) && !PGPortableBenchmarkShouldRun(runner, sealName) &&
+            !PGPortableBenchmarkShouldRun(runner, openName)) {
+            continue;
+        }
+
+        uint8_t *plaintext = malloc(payloadSize);
+        provider->randomBytes(plaintext, payloadSize);
+        crypto.input = plaintext;
+        crypto.length = payloadSize;
+        crypto.outputCapacity = payloadSize + PGCryptoAESBlockSize;
+        crypto.output = malloc(crypto.outputCapacity);
+
+        PGPortableBenchmarkRun(runner, digestName, "bytes", payloadSize, payloadSize, PGPortableDigest, &crypto);
+        PGPortableBenchmarkRun(runner, encryptName, "bytes", payloadSize, payloadSize, PGPortableEncrypt, &crypto);
+
+        PGPortableDecryptContext decrypt = { crypto };
+        uint8_t *ciphertext = malloc(crypto.outputCapacity);
+        decrypt.crypto.output = ciphertext;
+        decrypt.ciphertextLength = PGPortableCipher(&decrypt.crypto, PGCryptoEncrypt, plaintext, payloadSize);
+        decrypt.ciphertext = ciphertext;
+        decrypt.crypto.output = crypto.output;
+        PGPortableBenchmarkRun(runner, decryptName, "bytes", payloadSize, payloadSize, PGPortableDecrypt, &decrypt);
+
+        // Skip GCM on providers that can't do it rather than timing their failures
+        decrypt.ciphertextLength = payloadSize;
+        if (provider->GCMSeal(crypto.key, sizeof(crypto.key), crypto.initializationVector, NULL, 0, plaintext, payloadSize, ciphertext,
+                              decrypt.crypto.tag) == PGCryptoSuccess) {
+            PGPortableBenchmarkRun(runner, sealName, "bytes", payloadSize, payloadSize, PGPortableSeal, &crypto);
+            PGPortableBenchmarkRun(runner, openName, "bytes", payloadSize, payloadSize, PGPortableOpen, &decrypt);
+        }
+
+        free(ciphertext);
+        free(crypto.output);
+        free(plaintext);
+    }
+}
+
+
+#pragma mark - Scrypt and Codec Benchmarks
+
+/*! @abstract The context of a scrypt benchmark. */
+typedef struct {
+    uint8_t password[32];
+    uint8_t salt[24];
+    uint32_t lanes;
+} PGPortableScryptContext;
+
+
+static void PGPortableScryptDerive(void *context)
+{
+    PGPortableScryptContext *scrypt = context;
+    uint8_t key[32];
+    PGScryptDeriveKey(scrypt->password, sizeof(scrypt->password), scrypt->salt, sizeof(scrypt->salt), 1 << 14, PGScryptDefaultBlockSize,
+                      scrypt->lanes, key, sizeof(key));
+}
+
+
+/*!
+ @abstract Runs the scrypt key derivation benchmarks.
+ @discussion Each run derives one key at a fixed cost with 1, 2, and 4 lanes, like the main suite's.
+ @param runner The runner with which to run the benchmarks. May not be NULL.
+ */
+static void PGRunScryptBenchmarks(PGPortableBenchmarkRunner *runner)
+{
+    PGPortableScryptContext scrypt;
+    PGCryptoDefaultProvider()->randomBytes(scrypt.password, sizeof(scrypt.password));
+    PGCryptoDefaultProvider()->randomBytes(scrypt.salt, sizeof(scrypt.salt));
+
+    uint32_t laneCounts[] = { 1, 2, 4 };
+    for (size_t i = 0; i < sizeof(laneCounts) / sizeof(uint32_t); ++i) {
+        scrypt.lanes = laneCounts[i];
+        PGPortableBenchmarkRun(runner, "Scrypt.derive", "lanes", scrypt.lanes, 0, PGPortableScryptDerive, &scrypt);
+    }
+}
+
+
+/*! @abstract The state shared by the codec benchmarks' iterations. */
+typedef struct {
+    const uint8_t *bytes;
+    size_t length;
+    const char *hexadecimalString;
+    size_t hexadecimalLength;
+    const char *base64String;
+    size_t base64Length;
+} PGPortableCodecContext;
+
+
+// Each iteration allocates its output, as the Foundation methods that wrap these functions do
+static void PGPortableHexEncode(void *context)
+{
+    PGPortableCodecContext *codec = context;
+    char *characters = malloc(PGCodecHexEncodedLength(codec->length) + 1);
+    PGCodecHexEncode(codec->bytes, codec->length, characters);
+    free(characters);
+}
+
+
+static void PGPortableHexDecode(void *context)
+{
+    PGPortableCodecContext *codec = context;
+    uint8_t *bytes = malloc(codec->hexadecimalLength / 2 + 1);
+    PGCodecHexDecode(codec->hexadecimalString, codec->hexadecimalLength, bytes);
+    free(bytes);
+}
+
+
+static void PGPortableBase64Encode(void *context)
+{
+    PGPortableCodecContext *codec = context;
+    char *characters = malloc(PGCodecBase64EncodedLength(codec->length) + 1);
+    PGCodecBase64Encode(codec->bytes, codec->length, characters);
+    free(characters);
+}
+
+
+static void PGPortableBase64Decode(void *context)
+{
+    PGPortableCodecContext *codec = context;
+    uint8_t *bytes = malloc(PGCodecBase64DecodedLength(codec->base64String, codec->base64Length) + 1);
+    PGCodecBase64Decode(codec->base64String, codec->base64Length, bytes);
+    free(bytes);
+}
+
+
+static void PGPortableInterpose(void *context)
+{
+    PGPortableCodecContext *codec = context;
+    char *characters = malloc(PGCodecInterposedLength(codec->hexadecimalLength, 4, 1) + 1);
+    PGCodecInterpose(codec->hexadecimalString, codec->hexadecimalLength, sizeof(char), 4, "-", 1, characters);
+    free(characters);
+}
+
+
+/*!
+ @abstract Runs the hexadecimal and base64 encoding and string grouping benchmarks.
+ @param runner The runner with which to run the benchmarks. May not be NULL.
+ */
+static void PGRunCodecBenchmarks(PGPortableBenchmarkRunner *runner)
+{
+    size_t payloadSizes[] = { 16, 1024, 64 * 1024, 1024 * 1024 };
+    for (size_t i = 0; i < sizeof(payloadSizes) / sizeof(size_t); ++i) {
+        size_t payloadSize = payloadSizes[i];
+        uint8_t *bytes = malloc(payloadSize);
+        PGCryptoDefaultProvider()->randomBytes(bytes, payloadSize);
+
+        PGPortableCodecContext codec = { bytes, payloadSize };
+        codec.hexadecimalLength = PGCodecHexEncodedLength(payloadSize);
+        char *hexadecimalString = malloc(codec.hexadecimalLength);
+        PGCodecHexEncode(bytes, payloadSize, hexadecimalString);
+        codec.hexadecimalString = hexadecimalString;
+
+        codec.base64Length = PGCodecBase64EncodedLength(payloadSize);
+        char *base64String = malloc(codec.base64Length);
+        PGCodecBase64Encode(bytes, payloadSize, base64String);
+        codec.base64String = base64String;
+
+        PGPortableBenchmarkRun(runner, "Hex.encode", "bytes", payloadSize, payloadSize, PGPortableHexEncode, &codec);
+        PGPortableBenchmarkRun(runner, "Hex.decode", "bytes", payloadSize, payloadSize, PGPortableHexDecode, &codec);
+        PGPortableBenchmarkRun(runner, "Base64.encode", "bytes", payloadSize, payloadSize, PGPortableBase64Encode, &codec);
+        PGPortableBenchmarkRun(runner, "Base64.decode", "bytes", payloadSize, payloadSize, PGPortableBase64Decode, &codec);
+        PGPortableBenchmarkRun(runner, "Grouping.interpose", "characters", codec.hexadecimalLength, codec.hexadecimalLength,
+                               PGPortableInterpose, &codec);
+
+        free(base64String);
+        free(hexadecimalString);
+        free(bytes);
+    }
+}
+
+
+#pragma mark - User Table Benchmarks
+
+/*!
+ @abstract Writes a version 1 user table with the specified number of users named user0, user1, and so on.
+ @discussion Each entry has the same field lengths as those the library writes: a 24-byte salt, a 16-byte initialization vector, and a 48-byte
+     secret. The layout is the one PGUserTable's -writeToFile:error: produces.
+ @return Whether the table was written.
+ */
+static bool PGPortableWriteUserTable(const char *path, uint32_t recordCount)
+{
+    uint32_t bucketCount = PGUserTableBucketCountForRecordCount(recordCount);
+    size_t recordSize = PGUserTableVersion1RecordSize;
+    uint8_t *records = calloc(recordCount, recordSize);
+    uint32_t *buckets = malloc(bucketCount * sizeof(uint32_t));
+    memset(buckets, 0xFF, bucketCount * sizeof(uint32_t));
+
+    size_t heapCapacity = (size_t)recordCount * (16 + 24 + 16 + 48);
+    uint8_t *heap = malloc(heapCapacity);
+    uint32_t heapLength = 0;
+
+    uint8_t fields[24 + 16 + 48];
+    PGCryptoDefaultProvider()->randomBytes(fields, sizeof(fields));
+
+    for (uint32_t recordIndex = 0; recordIndex < recordCount; ++recordIndex) {
+        char user[16];
+        uint32_t userLength = (uint32_t)snprintf(user, sizeof(user), "user%u", recordIndex);
+        const void *fieldBytes[] = { user, fields, fields + 24, fields + 40 };
+        uint32_t fieldLengths[] = { userLength, 24, 16, 48 };
+
+        PGUserTableRecord *record = (PGUserTableRecord *)(records + recordIndex * recordSize);
+        PGUserTableHeapReference *references[] = { &record->user, &record->salt, &record->initializationVector, &record->secret };
+        for (int i = 0; i < 4; ++i) {
+            references[i]->offset = PGUserTableEncode32(heapLength);
+            references[i]->length = PGUserTableEncode32(fieldLengths[i]);
+            memcpy(heap + heapLength, fieldBytes[i], fieldLengths[i]);
+            heapLength += fieldLengths[i];
+        }
+
+        uint64_t userHash = PGUserTableHash(user, userLength);
+        record->userHash = PGUserTableEncode64(userHash);
+        record->rounds = PGUserTableEncode32(100000);
+        PGUserTableIndexInsert(buckets, bucketCount, userHash, recordIndex);
+    }
+
+    uint64_t recordsOffset = sizeof(PGUserTableHeader);
+    uint64_t bucketsOffset = recordsOffset + (uint64_t)recordCount * recordSize;
+    uint64_t heapOffset = bucketsOffset + (uint64_t)bucketCount * sizeof(uint32_t);
+    PGUserTableHeader header = {
+        PGUserTableEncode32(PGUserTableMagic), PGUserTableEncode32(PGUserTableVersion1),
+        PGUserTableEncode32(recordCount), PGUserTableEncode32(bucketCount),
+        PGUserTableEncode64(recordsOffset), PGUserTableEncode64(bucketsOffset),
+        PGUserTableEncode64(heapOffset), PGUserTableEncode64(heapLength)
+    };
+
+    FILE *file = fopen(path, "wb");
+    bool written = file && fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(records, recordSize, recordCount, file) == recordCount &&
+        fwrite(buckets, sizeof(uint32_t), bucketCount, file) == bucketCount &&
+        fwrite(heap, 1, heapLength, file) == heapLength;
+    if (file && fclose(file) != 0) written = false;
+
+    free(heap);
+    free(buckets);
+    free(records);
+    return written;
+}
+
+
+/*! @abstract The context of a user table benchmark. */
+typedef struct {
+    const char *path;
+    const char *logPath;
+    PGUserTableLayout layout;
+    uint32_t userCount;
+} PGPortableUserTableContext;
+
+
+/*!
+ @abstract Copies the fields of the specified record out of the table, the way PGUserTable copies them into an entry's NSData objects.
+ @return Whether every field was within the table's heap.
+ */
+static bool PGPortableCopyEntry(const PGUserTableLayout *layout, uint32_t recordIndex)
+{
+    const PGUserTableRecord *record = PGUserTableLayoutRecordAtIndex(layout, recordIndex);
+    PGUserTableHeapReference references[] = { record->user, record->salt, record->initializationVector, record->secret };
+    bool copied = true;
+    for (int i = 0; i < 4; ++i) {
+        PGUserTableHeapReference reference = { PGUserTableDecode32(references[i].offset), PGUserTableDecode32(references[i].length) };
+        const uint8_t *bytes = PGUserTableLayoutHeapBytes(layout, reference);
+        if (!bytes) {
+            copied = false;
+            continue;
+        }
+
+        void *field = malloc(reference.length);
+        memcpy(field, bytes, reference.length);
+        free(field);
+    }
+
+    return copied;
+}
+
+
+// Mirrors -reload: and -mapTableFile:, which open the log before mapping the table, then -entryForUser:
+static void PGPortableUserTableOpen(void *context)
+{
+    PGPortableUserTableContext *userTable = context;
+    int logFileDescriptor = open(userTable->logPath, O_RDONLY);
+    if (logFileDescriptor == -1 && errno != ENOENT) return;
+    if (logFileDescriptor != -1) close(logFileDescriptor);
+
+    int fileDescriptor = open(userTable->path, O_RDONLY);
+    if (fileDescriptor == -1) return;
+
+    struct stat fileStatus;
+    if (fstat(fileDescriptor, &fileStatus) == -1 || (size_t)fileStatus.st_size < sizeof(PGUserTableHeader)) {
+        close(fileDescriptor);
+        return;
+    }
+
+    size_t length = fileStatus.st_size;
+    void *bytes = mmap(NULL, length, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    close(fileDescriptor);
+    if (bytes == MAP_FAILED) return;
+
+    PGUserTableLayout layout;
+    if (PGUserTableLayoutInitialize(&layout, bytes, length)) {
+        uint32_t recordIndex = PGUserTableLayoutFindUser(&layout, "user0", 5);
+        if (recordIndex != PGUserTableEmptyBucket) PGPortableCopyEntry(&layout, recordIndex);
+    }
+
+    munmap(bytes, length);
+}
+
+
+static void PGPortableUserTableLookup(void *context)
+{
+    PGPortableUserTableContext *userTable = context;
+    char user[16];
+    int userLength = snprintf(user, sizeof(user), "user%u", (unsigned)(rand() % userTable->userCount));
+    uint32_t recordIndex = PGUserTableLayoutFindUser(&userTable->layout, user, userLength);
+    if (recordIndex != PGUserTableEmptyBucket) PGPortableCopyEntry(&userTable->layout, recordIndex);
+}
+
+
+/*!
+ @abstract Runs the user table open and lookup benchmarks.
+ @param runner The runner with which to run the benchmarks. May not be NULL.
+ @param temporaryDirectory A directory in which to write user tables. May not be NULL.
+ */
+static void PGRunUserTableBenchmarks(PGPortableBenchmarkRunner *runner, const char *temporaryDirectory)
+{
+    if (!PGPortableBenchmarkShouldRun(runner, "UserTable.open") && !PGPortableBenchmarkShouldRun(runner, "UserTable.lookup")) return;
+
+    uint32_t userCounts[] = { 1000, 100000, 1000000 };
+    for (size_t i = 0; i < sizeof(userCounts) / sizeof(uint32_t); ++i) {
+        char path[1024], logPath[sizeof(path) + 4];
+        snprintf(path, sizeof(path), "%s/Users-%u.db", temporaryDirectory, userCounts[i]);
+        snprintf(logPath, sizeof(logPath), "%s.log", path);
+        if (!PGPortableWriteUserTable(path, userCounts[i])) {
+            fprintf(stderr, "Skipping user table benchmarks with %u users: could not write table\n", userCounts[i]);
+            continue;
+        }
+
+        PGPortableUserTableContext userTable = { path, logPath };
+        userTable.userCount = userCounts[i];
+        PGPortableBenchmarkRun(runner, "UserTable.open", "users", userCounts[i], 0, PGPortableUserTableOpen, &userTable);
+
+        int fileDescriptor = open(path, O_RDONLY);
+        struct stat fileStatus;
+        void *bytes = MAP_FAILED;
+        if (fileDescriptor != -1 && fstat(fileDescriptor, &fileStatus) == 0) {
+            bytes = mmap(NULL, fileStatus.st_size, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+        }
+
+        if (fileDescriptor != -1) close(fileDescriptor);
+        if (bytes != MAP_FAILED) {
+            if (PGUserTableLayoutInitialize(&userTable.layout, bytes, fileStatus.st_size)) {
+                PGPortableBenchmarkRun(runner, "UserTable.lookup", "users", userCounts[i], 0, PGPortableUserTableLookup, &userTable);
+            }
+
+            munmap(bytes, fileStatus.st_size);
+        }
+
+        unlink(path);
+    }
+}
+
+
+#pragma mark - Main
+
+int main(int argc, const char *argv[])
+{
+    PGPortableBenchmarkRunner runner = { PGPortableBenchmarkDefaultIterations };
+    const char *outputPath = NULL;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-iterations") == 0) {
+            long iterations = strtol(argv[i + 1], NULL, 10);
+            if (iterations > 0) runner.iterations = iterations;
+        } else if (strcmp(argv[i], "-filter") == 0) {
+            runner.filter = argv[i + 1];
+        } else if (strcmp(argv[i], "-output") == 0) {
+            outputPath = argv[i + 1];
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    char temporaryDirectory[] = "/tmp/PGPortableBenchmarks.XXXXXX";
+    if (!mkdtemp(temporaryDirectory)) {
+        fprintf(stderr, "Could not create temporary directory: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    srand((unsigned)time(NULL));
+
+    size_t providerCount = 0;
+    const PGCryptoProvider *const *providers = PGCryptoAvailableProviders(&providerCount);
+    for (size_t i = 0; i < providerCount; ++i) {
+        PGRunCryptoBenchmarks(&runner, providers[i]);
+    }
+
+    PGRunScryptBenchmarks(&runner);
+    PGRunCodecBenchmarks(&runner);
+    PGRunUserTableBenchmarks(&runner, temporaryDirectory);
+    rmdir(temporaryDirectory);
+
+    FILE *output = outputPath ? fopen(outputPath, "w") : stdout;
+    if (!output) {
+        fprintf(stderr, "Could not write report to %s: %s\n", outputPath, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    PGPortableBenchmarkWriteReport(&runner, output);
+    if (output != stdout) fclose(output);
+    free(runner.results);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,560 @@
+//
+//  main.m
+//  EncryptedDiskImageWrapperBenchmarks
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+#import <fcntl.h>
+#import <stdio.h>
+#import <stdlib.h>
+#import <unistd.h>
+
+#import "NSData+Crypto.h"
+#import "NSFileManager+TemporaryFiles.h"
+#import "NSString+Grouping.h"
+#import "PGArchive.h"
+#import "PGBenchmarkRunner.h"
+#import "PGBulkAttachScheduler.h"
+#import "PGCryptoProvider.h"
+#import "PGEncryptedDiskImageWrapper.h"
+#import "PGHDIUtilTask.h"
+#import "PGInstrumentation.h"
+#import "PGManifest.h"
+#import "PGScrypt.h"
+#import "PGTemplatePool.h"
+#import "PGUserTable.h"
+#import "PGUserTableCache.h"
+#import "PGUserTableTestEntry.h"
+
+/*
+ Runs the benchmark suite and writes a JSON report to standard output or the file given by -output. Options are read from the argument domain of 
+ the standard user defaults:
+ 
+   -iterations N   The number of timed iterations of each benchmark. Defaults to 20.
+   -filter NAME    Only runs benchmarks whose names contain NAME.
+   -output PATH    Writes the report to PATH instead of standard output.
+   -hdiutil PATH   The program hdiutil benchmarks run. Defaults to the hdiutil stub next to this executable. The real hdiutil is never run 
+                   unless it's given explicitly.
+   -trace PATH     Enables instrumentation and writes a Chrome trace of every instrumented phase to PATH. Timings include the small cost
+                   of instrumentation.
+ */
+
+/*! @abstract The default number of timed iterations of each benchmark. */
+static const NSUInteger PGBenchmarkDefaultIterations = 20;
+
+
+/*!
+ @abstract Runs the key derivation, digest, and encryption benchmarks with the specified crypto provider.
+ @discussion Benchmarks run with the default provider have unqualified names, e.g., AES.encrypt. Those run with other providers are prefixed 
+     with the provider's name, e.g., OpenSSL.AES.encrypt.
+ @param runner The runner with which to run the benchmarks. May not be nil.
+ @param provider The crypto provider to benchmark. May not be NULL.
+ */
+static void PGRunCryptoBenchmarks(PGBenchmarkRunner *runner, const PGCryptoProvider *provider)
+{
+    NSString *prefix = provider == PGCryptoDefaultProvider() ? @"" : [NSString stringWithFormat:@"%s.", provider->name];
+    NSString *calibrateName = [prefix stringByAppendingString:@"PBKDF.calibrate"];
+    NSString *deriveName = [prefix stringByAppendingString:@"PBKDF.derive"];
+    NSString *digestName = [prefix stringByAppendingString:@"SHA256.digest"];
+    NSString *encryptName = [prefix stringByAppendingString:@"AES.encrypt"];
+    NSString *decryptName = [prefix stringByAppendingString:@"AES.decrypt"];
+    NSString *encryptBufferName = [prefix stringByAppendingString:@"AES.encryptBuffer"];
+    NSString *sealName = [prefix stringByAppendingString:@"AESGCM.encrypt"];
+    NSString *openName = [prefix stringByAppendingString:@"AESGCM.decrypt"];
+    
+    NSUInteger passwordLengths[] = { 8, 32, 128 };
+    for (NSUInteger i = 0; i < sizeof(passwordLengths) / sizeof(NSUInteger); ++i) {
+        NSUInteger passwordLength = passwordLengths[i];
+        NSData *password = [[[NSData randomDataOfLength:passwordLength] hexadecimalString] dataUsingEncoding:NSUTF8StringEncoding];
+        NSData *salt = [NSData randomDataOfLength:24];
+        
+        __block unsigned rounds = 0;
+        [runner runBenchmarkNamed:calibrateName parameterName:@"passwordLength" parameterValue:passwordLength bytesPerIteration:0 block:^{
+            rounds = provider->calibrateRounds(passwordLength, [salt length], 32, 100);
+        }];
+        
+        if (![runner shouldRunBenchmarkNamed:deriveName]) continue;
+        if (rounds == 0) rounds = provider->calibrateRounds(passwordLength, [salt length], 32, 100);
+        
+        [runner runBenchmarkNamed:deriveName parameterName:@"passwordLength" parameterValue:passwordLength bytesPerIteration:0 block:^{
+            uint8_t key[32];
+            provider->deriveKey([password bytes], [password length], [salt bytes], [salt length], rounds, key, sizeof(key));
+        }];
+    }
+    
+    // The NSData methods use the default provider, so make this one the default while they run
+    PGCryptoSetDefaultProvider(provider);
+    
+    NSData *key = [NSData randomSymmetricKey];
+    NSUInteger payloadSizes[] = { 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+    for (NSUInteger i = 0; i < sizeof(payloadSizes) / sizeof(NSUInteger); ++i) {
+        NSUInteger payloadSize = payloadSizes[i];
+        if (![runner shouldRunBenchmarkNamed:digestName] && ![runner shouldRunBenchmarkNamed:encryptName] && 
+            ![runner shouldRunBenchmarkNamed:decryptName] && ![runner shouldRunBenchmarkNamed:encryptBufferName] && 
+            ![runner shouldRunBenchmarkNamed:sealName] && 
+            ![runner shouldRunBenchmarkNamed:openName]) {
+            continue;
+        }
+        
+        NSData *plaintext = [NSData randomDataOfLength:payloadSize];
+        NSData *initializationVector = nil;
+        NSData *ciphertext = [plaintext encryptedDataWithSymmetricKey:key initializationVector:&initializationVector error:NULL];
+        
+        [runner runBenchmarkNamed:digestName parameterName:@"bytes" parameterValue:payloadSize bytesPerIteration:payloadSize block:^{
+            [plaintext SHA256Digest];
+        }];
+        
+        [runner runBenchmarkNamed:encryptName parameterName:@"bytes" parameterValue:payloadSize bytesPerIteration:payloadSize block:^{
+            NSData *iv = nil;
+            [plaintext encryptedDataWithSymmetricKey:key initializationVector:&iv error:NULL];
+        }];
+        
+        [runner runBenchmarkNamed:decryptName parameterName:@"bytes" parameterValue:payloadSize bytesPerIteration:payloadSize block:^{
+            [ciphertext decryptedDataWithSymmetricKey:key initializationVector:initializationVector error:NULL];
+        }];
+        
+        // The buffer variant reuses one output buffer, so the difference from AES.encrypt is the cost of allocating the output
+        NSMutableData *outputBuffer = [NSMutableData dataWithLength:[NSData encryptedLengthForLength:payloadSize 
+                                                                                            algorithm:PGAES256CBCEncryptionAlgorithm]];
+        [runner runBenchmarkNamed:encryptBufferName parameterName:@"bytes" parameterValue:payloadSize bytesPerIteration:payloadSize block:^{
+            size_t length = 0;
+            [plaintext getEncryptedBytes:[outputBuffer mutableBytes] capacity:[outputBuffer length] length:&length symmetricKey:[key bytes] 
+                               keyLength:[key length] algorithm:PGAES256CBCEncryptionAlgorithm associatedData:nil 
+                    initializationVector:[initializationVector bytes] error:NULL];
+        }];
+        
+        // Skip GCM on providers that can't do it rather than timing their failures
+        NSData *nonce = nil;
+        NSData *sealedData = [plaintext encryptedDataWithSymmetricKey:key algorithm:PGAES256GCMEncryptionAlgorithm associatedData:nil 
+                                                 initializationVector:&nonce error:NULL];
+        if (!sealedData) continue;
+        
+        [runner runBenchmarkNamed:sealName parameterName:@"bytes" parameterValue:payloadSize bytesPerIteration:payloadSize block:^{
+            NSData *iv = nil;
+            [plaintext encryptedDataWithSymmetricKey:key algorithm:PGAES256GCMEncryptionAlgorithm associatedData:nil initializationVector:&iv 
+                                               error:NULL];
+        }];
+        
+        [runner runBenchmarkNamed:openName parameterName:@"bytes" parameterValue:payloadSize bytesPerIteration:payloadSize block:^{
+            [sealedData decryptedDataWithSymmetricKey:key algorithm:PGAES256GCMEncryptionAlgorithm associatedData:nil initializationVector:nonce 
+                                                error:NULL];
+        }];
+    }
+    
+    PGCryptoSetDefaultProvider(NULL);
+}
+
+
+/*!
+ @abstract Runs the scrypt key derivation benchmarks.
+ @discussion Each run derives one key at a fixed cost with 1, 2, and 4 lanes. The lanes run concurrently, so on a machine with enough cores 
+     the time per iteration should stay roughly flat as the lane count, and with it the total work, grows.
+ @param runner The runner with which to run the benchmarks. May not be nil.
+ */
+static void PGRunScryptBenchmarks(PGBenchmarkRunner *runner)
+{
+    NSData *password = [[[NSData randomDataOfLength:16] hexadecimalString] dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *salt = [NSData randomDataOfLength:PGKeyDerivationSaltLength];
+    
+    uint32_t laneCounts[] = { 1, 2, 4 };
+    for (NSUInteger i = 0; i < sizeof(laneCounts) / sizeof(uint32_t); ++i) {
+        uint32_t lanes = laneCounts[i];
+        [runner runBenchmarkNamed:@"Scrypt.derive" parameterName:@"lanes" parameterValue:lanes bytesPerIteration:0 block:^{
+            uint8_t key[32];
+            PGScryptDeriveKey([password bytes], [password length], [salt bytes], [salt length], 1 << 14, PGScryptDefaultBlockSize, lanes, 
+                              key, sizeof(key));
+        }];
+    }
+}
+
+
+/*!
+ @abstract Runs the hexadecimal and base64 encoding and string grouping benchmarks.
+ @param runner The runner with which to run the benchmarks. May not be nil.
+ */
+static void PGRunCodecBenchmarks(PGBenchmarkRunner *runner)
+{
+    NSUInteger payloadSizes[] = { 16, 1024, 64 * 1024, 1024 * 1024 };
+    for (NSUInteger i = 0; i < sizeof(payloadSizes) / sizeof(NSUInteger); ++i) {
+        NSUInteger payloadSize = payloadSizes[i];
+        NSData *data = [NSData randomDataOfLength:payloadSize];
+        NSString *hexadecimalString = [data hexadecimalString];
+        
+        [runner runBenchmarkNamed:@"Hex.encode" parameterName:@"bytes" parameterValue:payloadSize bytesPerIteration:payloadSize block:^{
+            [data hexadecimalString];
+        }];
+        
+        [runner runBenchmarkNamed:@"Hex.decode" parameterName:@"bytes" parameterValue:payloadSize bytesPerIteration:payloadSize block:^{
+            [NSData dataWithHexadecimalString:hexadecimalString];
+        }];
+        
+        NSString *base64String = [data base64String];
+        [runner runBenchmarkNamed:@"Base64.encode" parameterName:@"bytes" parameterValue:payloadSize bytesPerIteration:payloadSize block:^{
+            [data base64String];
+        }];
+        
+        [runner runBenchmarkNamed:@"Base64.decode" parameterName:@"bytes" parameterValue:payloadSize bytesPerIteration:payloadSize block:^{
+            [NSData dataWithBase64String:base64String];
+        }];
+        
+        [runner runBenchmarkNamed:@"Grouping.interpose" parameterName:@"characters" parameterValue:[hexadecimalString length] 
+                bytesPerIteration:[hexadecimalString length] block:^{
+            [hexadecimalString stringByInterposingString:@"-" betweenSubstringsOfLength:4];
+        }];
+    }
+}
+
+
+/*!
+ @abstract Runs the user table benchmarks.
+ @param runner The runner with which to run the benchmarks. May not be nil.
+ @param temporaryDirectory A directory in which to write user tables. May not be nil.
+ */
+static void PGRunUserTableBenchmarks(PGBenchmarkRunner *runner, NSString *temporaryDirectory)
+{
+    BOOL shouldRun = NO;
+    for (NSString *name in [NSArray arrayWithObjects:@"UserTable.write", @"UserTable.open", @"UserTable.cachedOpen", @"UserTable.lookup", @"UserTable.saveChanges", nil]) {
+        shouldRun = shouldRun || [runner shouldRunBenchmarkNamed:name];
+    }
+    
+    if (!shouldRun) return;
+    
+    NSUInteger userCounts[] = { 1000, 100000, 1000000 };
+    for (NSUInteger i = 0; i < sizeof(userCounts) / sizeof(NSUInteger); ++i) {
+        NSUInteger userCount = userCounts[i];
+        NSString *path = [temporaryDirectory stringByAppendingPathComponent:[NSString stringWithFormat:@"UserTable-%lu.db", (unsigned long)userCount]];
+        
+        PGUserTable *userTable = [[PGUserTable alloc] init];
+        for (NSUInteger user = 0; user < userCount; ++user) {
+            NSString *userName = [NSString stringWithFormat:@"user%lu", (unsigned long)user];
+            [userTable setEntry:PGUserTableTestEntry(userName) forUser:userName];
+        }
+        
+        [runner runBenchmarkNamed:@"UserTable.write" parameterName:@"users" parameterValue:userCount bytesPerIteration:0 block:^{
+            [userTable writeToFile:path error:NULL];
+        }];
+        
+        [userTable writeToFile:path error:NULL];
+        [runner runBenchmarkNamed:@"UserTable.open" parameterName:@"users" parameterValue:userCount bytesPerIteration:0 block:^{
+            PGUserTable *openedTable = [[PGUserTable alloc] initWithContentsOfFile:path error:NULL];
+            [openedTable entryForUser:@"user0"];
+        }];
+        
+        // After the first open, the cache only stats the table and its log
+        PGUserTableCache *cache = [[PGUserTableCache alloc] init];
+        [runner runBenchmarkNamed:@"UserTable.cachedOpen" parameterName:@"users" parameterValue:userCount bytesPerIteration:0 block:^{
+            [[cache userTableAtPath:path error:NULL] entryForUser:@"user0"];
+        }];
+        
+        PGUserTable *openedTable = [[PGUserTable alloc] initWithContentsOfFile:path error:NULL];
+        [runner runBenchmarkNamed:@"UserTable.lookup" parameterName:@"users" parameterValue:userCount bytesPerIteration:0 block:^{
+            [openedTable entryForUser:[NSString stringWithFormat:@"user%u", arc4random_uniform((uint32_t)userCount)]];
+        }];
+        
+        NSDictionary *entry = PGUserTableTestEntry(@"benchmark");
+        [runner runBenchmarkNamed:@"UserTable.saveChanges" parameterName:@"users" parameterValue:userCount bytesPerIteration:0 block:^{
+            [openedTable setEntry:entry forUser:@"benchmark"];
+            [openedTable saveChanges:NULL];
+        }];
+    }
+}
+
+
+/*!
+ @abstract Runs the manifest benchmarks, which build and verify manifests of directories of band-sized files.
+ @param runner The runner with which to run the benchmarks. May not be nil.
+ @param temporaryDirectory A directory in which to create the band directories. May not be nil.
+ */
+static void PGRunManifestBenchmarks(PGBenchmarkRunner *runner, NSString *temporaryDirectory)
+{
+    if (![runner shouldRunBenchmarkNamed:@"Manifest.build"] && ![runner shouldRunBenchmarkNamed:@"Manifest.verify"]) return;
+    
+    const NSUInteger bandSize = 64 * 1024;
+    NSUInteger bandCounts[] = { 100, 1000, 10000 };
+    for (NSUInteger i = 0; i < sizeof(bandCounts) / sizeof(NSUInteger); ++i) {
+        NSUInteger bandCount = bandCounts[i];
+        NSString *path = [temporaryDirectory stringByAppendingPathComponent:[NSString stringWithFormat:@"Bands-%lu", (unsigned long)bandCount]];
+        [[NSFileManager defaultManager] createDirectoryAtPath:path withIntermediateDirectories:YES attributes:nil error:NULL];
+        
+        NSData *band = [NSData randomDataOfLength:bandSize];
+        for (NSUInteger bandIndex = 0; bandIndex < bandCount; ++bandIndex) {
+            [band writeToFile:[path stringByAppendingPathComponent:[NSString stringWithFormat:@"%lx", (unsigned long)bandIndex]] atomically:NO];
+        }
+        
+        [runner runBenchmarkNamed:@"Manifest.build" parameterName:@"bands" parameterValue:bandCount bytesPerIteration:bandCount * bandSize block:^{
+            [PGManifest manifestWithDirectoryAtPath:path excludedRelativePaths:nil error:NULL];
+        }];
+        
+        // With nothing changed, verification only reads each band's attributes
+        PGManifest *manifest = [PGManifest manifestWithDirectoryAtPath:path excludedRelativePaths:nil error:NULL];
+        [runner runBenchmarkNamed:@"Manifest.verify" parameterName:@"bands" parameterValue:bandCount bytesPerIteration:0 block:^{
+            [manifest relativePathsOfFilesDifferingFromManifest:[manifest manifestByUpdatingWithDirectoryAtPath:path options:0 error:NULL]];
+        }];
+        
+        [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    }
+}
+
+
+/*!
+ @abstract Runs the archive benchmarks, which export and import a directory of band-sized files with different numbers of chunks in flight.
+ @param runner The runner with which to run the benchmarks. May not be nil.
+ @param temporaryDirectory A directory in which to create the band directory and archive. May not be nil.
+ */
+static void PGRunArchiveBenchmarks(PGBenchmarkRunner *runner, NSString *temporaryDirectory)
+{
+    if (![runner shouldRunBenchmarkNamed:@"Archive.export"] && ![runner shouldRunBenchmarkNamed:@"Archive.import"]) return;
+    
+    // Random bands don't compress, like the encrypted bands of a real wrapper
+    const NSUInteger bandSize = 4 * 1024 * 1024;
+    const NSUInteger bandCount = 16;
+    NSString *path = [temporaryDirectory stringByAppendingPathComponent:@"ArchiveBands"];
+    NSString *archivePath = [temporaryDirectory stringByAppendingPathComponent:@"Archive"];
+    NSString *restoredPath = [temporaryDirectory stringByAppendingPathComponent:@"ArchiveRestored"];
+    [[NSFileManager defaultManager] createDirectoryAtPath:path withIntermediateDirectories:YES attributes:nil error:NULL];
+    for (NSUInteger bandIndex = 0; bandIndex < bandCount; ++bandIndex) {
+        [[NSData randomDataOfLength:bandSize] writeToFile:[path stringByAppendingPathComponent:[NSString stringWithFormat:@"%lx", (unsigned long)bandIndex]]
+                                               atomically:NO];
+    }
+    
+    NSUInteger bufferedChunkCounts[] = { 1, 2, 4, 8, 16 };
+    for (NSUInteger i = 0; i < sizeof(bufferedChunkCounts) / sizeof(NSUInteger); ++i) {
+        PGArchiver *archiver = [[PGArchiver alloc] init];
+        [archiver setMaximumBufferedChunkCount:bufferedChunkCounts[i]];
+        
+        [runner runBenchmarkNamed:@"Archive.export" parameterName:@"chunks" parameterValue:bufferedChunkCounts[i] 
+                bytesPerIteration:bandCount * bandSize block:^{
+            int fileDescriptor = open([archivePath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0600);
+            [archiver archiveDirectoryAtPath:path toFileDescriptor:fileDescriptor excludedRelativePaths:nil baseCatalog:nil error:NULL];
+            close(fileDescriptor);
+        }];
+        
+        // Full archives can only be extracted to a new directory, so each iteration also removes the last one's
+        int fileDescriptor = open([archivePath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        [archiver archiveDirectoryAtPath:path toFileDescriptor:fileDescriptor excludedRelativePaths:nil baseCatalog:nil error:NULL];
+        close(fileDescriptor);
+        
+        [runner runBenchmarkNamed:@"Archive.import" parameterName:@"chunks" parameterValue:bufferedChunkCounts[i] 
+                bytesPerIteration:bandCount * bandSize block:^{
+            [[NSFileManager defaultManager] removeItemAtPath:restoredPath error:NULL];
+            int archiveFileDescriptor = open([archivePath fileSystemRepresentation], O_RDONLY);
+            [archiver extractArchiveFromFileDescriptor:archiveFileDescriptor toDirectoryAtPath:restoredPath error:NULL];
+            close(archiveFileDescriptor);
+        }];
+    }
+    
+    [[NSFileManager defaultManager] removeItemAtPath:restoredPath error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:archivePath error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+
+/*!
+ @abstract Runs the hdiutil benchmarks, which measure the fixed cost of running hdiutil and reading its output.
+ @param runner The runner with which to run the benchmarks. May not be nil.
+ @param temporaryDirectory A directory to pass to hdiutil as a mount point. May not be nil.
+ */
+static void PGRunHDIUtilBenchmarks(PGBenchmarkRunner *runner, NSString *temporaryDirectory)
+{
+    [runner runBenchmarkNamed:@"HDIUtil.detach" parameterName:nil parameterValue:0 bytesPerIteration:0 block:^{
+        PGHDIUtilTask *hdiutil = [[PGHDIUtilTask alloc] initWithVerb:PGHDIUtilDetachVerb arguments:[NSArray arrayWithObject:temporaryDirectory] 
+                                                            password:nil];
+        [hdiutil launchAndWaitWithResult:NULL error:NULL];
+    }];
+    
+    // The stub pads its attach output with this many extra entities, which measures the cost of reading and parsing hdiutil's output
+    NSUInteger paddings[] = { 0, 100, 1000 };
+    for (NSUInteger i = 0; i < sizeof(paddings) / sizeof(NSUInteger); ++i) {
+        setenv("PGHDIUTIL_STUB_PADDING", [[NSString stringWithFormat:@"%lu", (unsigned long)paddings[i]] UTF8String], 1);
+        
+        [runner runBenchmarkNamed:@"HDIUtil.attach" parameterName:@"entities" parameterValue:paddings[i] bytesPerIteration:0 block:^{
+            NSArray *arguments = [NSArray arrayWithObjects:@"image.sparsebundle", @"-nobrowse", @"-mountpoint", temporaryDirectory, nil];
+            PGHDIUtilTask *hdiutil = [[PGHDIUtilTask alloc] initWithVerb:PGHDIUtilAttachVerb arguments:arguments password:@"password"];
+            [hdiutil launchAndWaitWithResult:NULL error:NULL];
+        }];
+    }
+    
+    unsetenv("PGHDIUTIL_STUB_PADDING");
+}
+
+
+/*!
+ @abstract Runs the bulk attach benchmarks, which compare opening and attaching wrappers one at a time with using a bulk attach scheduler.
+ @param runner The runner with which to run the benchmarks. May not be nil.
+ @param temporaryDirectory A directory in which to create wrappers and mount their disk images. May not be nil.
+ */
+static void PGRunBulkAttachBenchmarks(PGBenchmarkRunner *runner, NSString *temporaryDirectory)
+{
+    if (![runner shouldRunBenchmarkNamed:@"BulkAttach.sequential"] && ![runner shouldRunBenchmarkNamed:@"BulkAttach.scheduled"]) return;
+    
+    const NSUInteger wrapperCount = 8;
+    NSDictionary *volumeOptions = [NSDictionary dictionaryWithObjectsAndKeys:@"Benchmark", PGNameVolumeOption, 
+                                   [NSNumber numberWithUnsignedInteger:5], PGSizeVolumeOption, nil];
+    NSString *wrapperPath = [temporaryDirectory stringByAppendingPathComponent:@"BulkAttach0.edi"];
+    if (![PGEncryptedDiskImageWrapper createEncryptedDiskImageWrapperAtPath:wrapperPath masterPassword:[NSData randomlyGeneratedPassword] 
+                                                                       user:@"user" password:@"password" volumeOptions:volumeOptions error:NULL]) {
+        fprintf(stderr, "Skipping bulk attach benchmarks: could not create wrapper\n");
+        return;
+    }
+    
+    NSMutableArray *wrapperPaths = [NSMutableArray arrayWithObject:wrapperPath];
+    for (NSUInteger i = 1; i < wrapperCount; ++i) {
+        NSString *copyPath = [temporaryDirectory stringByAppendingPathComponent:[NSString stringWithFormat:@"BulkAttach%lu.edi", (unsigned long)i]];
+        [[NSFileManager defaultManager] copyItemAtPath:wrapperPath toPath:copyPath error:NULL];
+        [wrapperPaths addObject:copyPath];
+    }
+    
+    [runner runBenchmarkNamed:@"BulkAttach.sequential" parameterName:@"wrappers" parameterValue:wrapperCount bytesPerIteration:0 block:^{
+        for (NSString *path in wrapperPaths) {
+            PGEncryptedDiskImageWrapper *wrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:path user:@"user" 
+                                                                                                      password:@"password" error:NULL];
+            [wrapper attachAtRandomSubdirectoryOfPath:temporaryDirectory error:NULL];
+            [wrapper detach:NULL];
+        }
+    }];
+    
+    PGBulkAttachScheduler *scheduler = [[PGBulkAttachScheduler alloc] init];
+    [runner runBenchmarkNamed:@"BulkAttach.scheduled" parameterName:@"wrappers" parameterValue:wrapperCount bytesPerIteration:0 block:^{
+        NSMutableArray *requests = [NSMutableArray arrayWithCapacity:wrapperCount];
+        for (NSString *path in wrapperPaths) {
+            [requests addObject:[[PGBulkAttachRequest alloc] initWithWrapperPath:path user:@"user" password:@"password" 
+                                                                       mountRoot:temporaryDirectory]];
+        }
+        
+        [scheduler performRequests:requests progressHandler:nil];
+        for (PGBulkAttachRequest *request in requests) [[request wrapper] detach:NULL];
+    }];
+}
+
+
+/*!
+ @abstract Runs the wrapper creation benchmarks, which compare creating wrappers with hdiutil with claiming them from a template pool.
+ @param runner The runner with which to run the benchmarks. May not be nil.
+ @param temporaryDirectory A directory in which to create wrappers and keep templates. May not be nil.
+ */
+static void PGRunTemplatePoolBenchmarks(PGBenchmarkRunner *runner, NSString *temporaryDirectory)
+{
+    NSString *masterPassword = [NSData randomlyGeneratedPassword];
+    NSDictionary *volumeOptions = [NSDictionary dictionaryWithObjectsAndKeys:@"Benchmark", PGNameVolumeOption, 
+                                   [NSNumber numberWithUnsignedInteger:5], PGSizeVolumeOption, nil];
+    __block NSUInteger wrapperCount = 0;
+    
+    [runner runBenchmarkNamed:@"Create.direct" parameterName:nil parameterValue:0 bytesPerIteration:0 block:^{
+        NSString *path = [temporaryDirectory stringByAppendingPathComponent:[NSString stringWithFormat:@"Create%lu.edi", (unsigned long)wrapperCount++]];
+        [PGEncryptedDiskImageWrapper createEncryptedDiskImageWrapperAtPath:path masterPassword:masterPassword user:@"user" password:@"password" 
+                                                             volumeOptions:volumeOptions error:NULL];
+    }];
+    
+    if (![runner shouldRunBenchmarkNamed:@"Create.template"]) return;
+    
+    // Keep a template ready for every iteration, so that each one is a hit regardless of how quickly the pool refills
+    PGTemplatePool *templatePool = [[PGTemplatePool alloc] initWithDirectory:[temporaryDirectory stringByAppendingPathComponent:@"Templates"] 
+                                                                       error:NULL];
+    [templatePool setDepth:[runner iterations] forVolumeOptions:volumeOptions];
+    [templatePool waitUntilIdle];
+    
+    [runner runBenchmarkNamed:@"Create.template" parameterName:nil parameterValue:0 bytesPerIteration:0 block:^{
+        NSString *path = [temporaryDirectory stringByAppendingPathComponent:[NSString stringWithFormat:@"Create%lu.edi", (unsigned long)wrapperCount++]];
+        [PGEncryptedDiskImageWrapper createEncryptedDiskImageWrapperAtPath:path masterPassword:masterPassword user:@"user" password:@"password" 
+                                                             volumeOptions:volumeOptions templatePool:templatePool error:NULL];
+    }];
+    
+    [templatePool removeAllTemplates:NULL];
+}
+
+
+int main (int argc, const char * argv[])
+{
+    @autoreleasepool {
+        NSUserDefaults *userDefaults = [NSUserDefaults standardUserDefaults];
+        NSInteger iterations = [userDefaults integerForKey:@"iterations"];
+        PGBenchmarkRunner *runner = [[PGBenchmarkRunner alloc] initWithIterations:iterations > 0 ? iterations : PGBenchmarkDefaultIterations
+                                                                           filter:[userDefaults stringForKey:@"filter"]];
+        
+        NSString *tracePath = [userDefaults stringForKey:@"trace"];
+        if (tracePath) {
+            [PGInstrumentation setEnabled:YES];
+            [PGInstrumentation setTracing:YES];
+        }
+        
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        NSString *temporaryDirectory = [fileManager createTemporaryDirectoryWithTemplate:@"EncryptedDiskImageWrapperBenchmarks.XXXXXX" error:NULL];
+        if (!temporaryDirectory) {
+            fprintf(stderr, "Could not create temporary directory\n");
+            return 1;
+        }
+        
+        size_t providerCount = 0;
+        const PGCryptoProvider *const *providers = PGCryptoAvailableProviders(&providerCount);
+        for (size_t i = 0; i < providerCount; ++i) {
+            PGRunCryptoBenchmarks(runner, providers[i]);
+        }
+        
+        if (providerCount < 2) {
+            fprintf(stderr, "Skipping provider comparison: only the %s provider was compiled in; define PGCRYPTO_OPENSSL=1 to build both\n", 
+                    providers[0]->name);
+        }
+        
+        PGRunScryptBenchmarks(runner);
+        PGRunCodecBenchmarks(runner);
+        PGRunUserTableBenchmarks(runner, temporaryDirectory);
+        PGRunManifestBenchmarks(runner, temporaryDirectory);
+        PGRunArchiveBenchmarks(runner, temporaryDirectory);
+        
+        NSString *executableDirectory = [[[[NSProcessInfo processInfo] arguments] objectAtIndex:0] stringByDeletingLastPathComponent];
+        NSString *hdiutilPath = [userDefaults stringForKey:@"hdiutil"];
+        if (!hdiutilPath) hdiutilPath = [executableDirectory stringByAppendingPathComponent:@"hdiutil-stub.sh"];
+        
+        if ([fileManager isExecutableFileAtPath:hdiutilPath]) {
+            [PGHDIUtilTask setDefaultLaunchPath:hdiutilPath];
+            PGRunHDIUtilBenchmarks(runner, temporaryDirectory);
+            PGRunBulkAttachBenchmarks(runner, temporaryDirectory);
+            PGRunTemplatePoolBenchmarks(runner, temporaryDirectory);
+        } else {
+            fprintf(stderr, "Skipping hdiutil benchmarks: %s is not executable\n", [hdiutilPath fileSystemRepresentation]);
+        }
+        
+        [fileManager removeItemAtPath:temporaryDirectory error:NULL];
+        
+        NSError *error = nil;
+        if (tracePath && ![PGInstrumentation writeTraceToFile:tracePath error:&error]) {
+            fprintf(stderr, "Could not write trace: %s\n", [[error description] UTF8String]);
+            return 1;
+        }
+        
+        NSData *reportData = [runner reportJSONData:&error];
+        NSString *outputPath = [userDefaults stringForKey:@"output"];
+        if (!reportData || (outputPath && ![reportData writeToFile:outputPath options:NSDataWritingAtomic error:&error])) {
+            fprintf(stderr, "Could not write report: %s\n", [[error description] UTF8String]);
+            return 1;
+        }
+        
+        if (!outputPath) {
+            fwrite([reportData bytes], 1, [reportData length], stdout);
+            fputc('\n', stdout);
+        }
+    }
+    
+    return 0;
+}
@@ -0,0 +1,464 @@
+//
+//  PGArchiveTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGArchiveTestCase.h"
+
+#import <fcntl.h>
+#import <unistd.h>
+
+#import "NSData+Crypto.h"
+#import "NSFileManager+TemporaryFiles.h"
+#import "PGArchive.h"
+#import "PGBandStore.h"
+#import "PGEncryptedDiskImageWrapper.h"
+#import "PGErrors.h"
+
+/*! @abstract The chunk size the tests' archivers use, which is small so that files span many chunks. */
+static const NSUInteger PGArchiveTestChunkSize = 4096;
+
+
+/*!
+ @abstract Writes an archive of the specified directory to the specified file.
+ @param archiver The archiver. May not be nil.
+ @param path The path of the directory to archive. May not be nil.
+ @param archivePath The path of the archive file. May not be nil.
+ @param baseCatalog The catalog of the base archive, or nil to write a full archive.
+ @param errorOut On output, the error that occurred, if any.
+ @return The directory's catalog, or nil if an error occurred.
+ */
+static PGArchiveCatalog *PGArchiveTestArchive(PGArchiver *archiver, NSString *path, NSString *archivePath, PGArchiveCatalog *baseCatalog, 
+                                              NSError **errorOut)
+{
+    int fileDescriptor = open([archivePath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    PGArchiveCatalog *catalog = [archiver archiveDirectoryAtPath:path toFileDescriptor:fileDescriptor 
+                                           excludedRelativePaths:[NSSet setWithObject:@"Excluded"] baseCatalog:baseCatalog error:errorOut];
+    close(fileDescriptor);
+    return catalog;
+}
+
+
+/*!
+ @abstract Extracts the specified archive file to the specified directory.
+ @param archiver The archiver. May not be nil.
+ @param archivePath The path of the archive file. May not be nil.
+ @param path The path of the directory to extract to. May not be nil.
+ @param errorOut On output, the error that occurred, if any.
+ @return The archive's catalog, or nil if an error occurred.
+ */
+static PGArchiveCatalog *PGArchiveTestExtract(PGArchiver *archiver, NSString *archivePath, NSString *path, NSError **errorOut)
+{
+    int fileDescriptor = open([archivePath fileSystemRepresentation], O_RDONLY);
+    PGArchiveCatalog *catalog = [archiver extractArchiveFromFileDescriptor:fileDescriptor toDirectoryAtPath:path error:errorOut];
+    close(fileDescriptor);
+    return catalog;
+}
+
+
+/*!
+ @abstract Returns whether the regular files and directories beneath two directories are the same, ignoring the specified relative paths.
+ @param path1 The first directory. May not be nil.
+ @param path2 The second directory. May not be nil.
+ @param ignoredRelativePaths The paths to ignore. May not be nil.
+ @return Whether the directories' contents are the same.
+ */
+static BOOL PGArchiveTestDirectoriesAreEqual(NSString *path1, NSString *path2, NSSet *ignoredRelativePaths)
+{
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSMutableSet *relativePaths1 = [NSMutableSet setWithArray:[fileManager subpathsAtPath:path1]];
+    NSMutableSet *relativePaths2 = [NSMutableSet setWithArray:[fileManager subpathsAtPath:path2]];
+    [relativePaths1 minusSet:ignoredRelativePaths];
+    [relativePaths2 minusSet:ignoredRelativePaths];
+    if (![relativePaths1 isEqualToSet:relativePaths2]) return NO;
+    
+    for (NSString *relativePath in relativePaths1) {
+        if (![fileManager contentsEqualAtPath:[path1 stringByAppendingPathComponent:relativePath] 
+                                      andPath:[path2 stringByAppendingPathComponent:relativePath]]) {
+            return NO;
+        }
+    }
+    
+    return YES;
+}
+
+
+/*!
+ @abstract Appends a record header and path to the specified archive data.
+ @param data The archive data. May not be nil.
+ @param type The record type.
+ @param path The record's path. May not be nil.
+ @param size The record's size.
+ */
+static void PGArchiveTestAppendRecord(NSMutableData *data, uint32_t type, NSString *path, uint64_t size)
+{
+    NSData *pathData = [path dataUsingEncoding:NSUTF8StringEncoding];
+    uint32_t type32 = CFSwapInt32HostToLittle(type);
+    uint32_t pathLength = CFSwapInt32HostToLittle((uint32_t)[pathData length]);
+    uint64_t size64 = CFSwapInt64HostToLittle(size);
+    [data appendBytes:&type32 length:sizeof(type32)];
+    [data appendBytes:&pathLength length:sizeof(pathLength)];
+    [data appendBytes:&size64 length:sizeof(size64)];
+    [data appendData:pathData];
+}
+
+
+@implementation PGArchiveTestCase
+
+- (void)setUp
+{
+    [super setUp];
+    temporaryDirectory = [[NSFileManager defaultManager] createTemporaryDirectoryWithTemplate:@"PGArchiveTestCase.XXXXXX" error:NULL];
+    contentsPath = [temporaryDirectory stringByAppendingPathComponent:@"Contents"];
+    
+    // A directory like a sparse bundle, with bands of sizes around the chunk size, a compressible file, nested and empty directories, and a 
+    // file to exclude
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    [fileManager createDirectoryAtPath:[contentsPath stringByAppendingPathComponent:@"bands"] withIntermediateDirectories:YES attributes:nil 
+                                 error:NULL];
+    [fileManager createDirectoryAtPath:[contentsPath stringByAppendingPathComponent:@"Nested/Empty"] withIntermediateDirectories:YES attributes:nil 
+                                 error:NULL];
+    
+    NSUInteger lengths[] = { 0, 1, PGArchiveTestChunkSize - 1, PGArchiveTestChunkSize, PGArchiveTestChunkSize + 1, 5 * PGArchiveTestChunkSize + 7 };
+    for (NSUInteger i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i) {
+        NSString *bandPath = [contentsPath stringByAppendingPathComponent:[NSString stringWithFormat:@"bands/%lx", (unsigned long)i]];
+        [[NSData randomDataOfLength:lengths[i]] writeToFile:bandPath atomically:NO];
+    }
+    
+    [[NSMutableData dataWithLength:10 * PGArchiveTestChunkSize] writeToFile:[contentsPath stringByAppendingPathComponent:@"Nested/Zeros"] 
+                                                                 atomically:NO];
+    [[@"info" dataUsingEncoding:NSUTF8StringEncoding] writeToFile:[contentsPath stringByAppendingPathComponent:@"Info.plist"] atomically:NO];
+    [[@"excluded" dataUsingEncoding:NSUTF8StringEncoding] writeToFile:[contentsPath stringByAppendingPathComponent:@"Excluded"] atomically:NO];
+}
+
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:temporaryDirectory error:NULL];
+    [super tearDown];
+}
+
+
+- (void)testRoundTrip
+{
+    NSError *error = nil;
+    NSString *archivePath = [temporaryDirectory stringByAppendingPathComponent:@"Archive"];
+    
+    // Fewer buffered chunks than chunks in a file make the pipeline reuse its slots
+    for (NSUInteger bufferedChunkCount = 1; bufferedChunkCount <= 8; bufferedChunkCount *= 2) {
+        NSString *restoredPath = [temporaryDirectory stringByAppendingPathComponent:[NSString stringWithFormat:@"Restored%lu", 
+                                                                                      (unsigned long)bufferedChunkCount]];
+        PGArchiver *archiver = [[PGArchiver alloc] init];
+        [archiver setChunkSize:PGArchiveTestChunkSize];
+        [archiver setMaximumBufferedChunkCount:bufferedChunkCount];
+        
+        PGArchiveCatalog *catalog = PGArchiveTestArchive(archiver, contentsPath, archivePath, nil, &error);
+        STAssertNotNil(catalog, @"Failed to archive directory: %@", error);
+        STAssertEquals([[catalog relativePaths] count], (NSUInteger)8, @"Wrong number of files in catalog");
+        STAssertTrue([[catalog directoryRelativePaths] containsObject:@"Nested/Empty"], @"Empty directory not in catalog");
+        
+        PGArchiveCatalog *extractedCatalog = PGArchiveTestExtract(archiver, archivePath, restoredPath, &error);
+        STAssertNotNil(extractedCatalog, @"Failed to extract archive: %@", error);
+        STAssertEqualObjects([extractedCatalog relativePaths], [catalog relativePaths], @"Extracted catalog differs");
+        STAssertTrue(PGArchiveTestDirectoriesAreEqual(contentsPath, restoredPath, [NSSet setWithObject:@"Excluded"]), @"Restored contents differ");
+        
+        // Modification dates are restored, so the restored directory's catalog matches
+        NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:[restoredPath stringByAppendingPathComponent:@"bands/5"] 
+                                                                                   error:NULL];
+        STAssertEqualsWithAccuracy([[attributes fileModificationDate] timeIntervalSinceReferenceDate], 
+                                   [[catalog modificationDateForRelativePath:@"bands/5"] timeIntervalSinceReferenceDate], 1.0, 
+                                   @"Modification date not restored");
+    }
+    
+    // The zeros compress, so the archive is smaller than the files in it
+    unsigned long long totalSize = 0;
+    for (NSString *relativePath in [[NSFileManager defaultManager] subpathsAtPath:contentsPath]) {
+        totalSize += [[[NSFileManager defaultManager] attributesOfItemAtPath:[contentsPath stringByAppendingPathComponent:relativePath] 
+                                                                       error:NULL] fileSize];
+    }
+    
+    unsigned long long archiveSize = [[[NSFileManager defaultManager] attributesOfItemAtPath:archivePath error:NULL] fileSize];
+    STAssertTrue(archiveSize < totalSize, @"Archive wasn't compressed");
+    
+    // Full archives can't be extracted over an existing directory
+    STAssertNil(PGArchiveTestExtract([[PGArchiver alloc] init], archivePath, contentsPath, &error), @"Extracted over existing directory");
+}
+
+
+- (void)testExcludedPaths
+{
+    NSError *error = nil;
+    NSString *archivePath = [temporaryDirectory stringByAppendingPathComponent:@"Archive"];
+    NSString *restoredPath = [temporaryDirectory stringByAppendingPathComponent:@"Restored"];
+    
+    PGArchiver *archiver = [[PGArchiver alloc] init];
+    int fileDescriptor = open([archivePath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    PGArchiveCatalog *catalog = [archiver archiveDirectoryAtPath:contentsPath toFileDescriptor:fileDescriptor 
+                                           excludedRelativePaths:[NSSet setWithObjects:@"Excluded", @"Nested", nil] baseCatalog:nil error:&error];
+    close(fileDescriptor);
+    STAssertNotNil(catalog, @"Failed to archive directory: %@", error);
+    STAssertEqualObjects([catalog excludedRelativePaths], ([NSSet setWithObjects:@"Excluded", @"Nested", nil]), @"Wrong excluded paths");
+    
+    STAssertNotNil(PGArchiveTestExtract(archiver, archivePath, restoredPath, &error), @"Failed to extract archive: %@", error);
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    STAssertFalse([fileManager fileExistsAtPath:[restoredPath stringByAppendingPathComponent:@"Excluded"]], @"Excluded file restored");
+    STAssertFalse([fileManager fileExistsAtPath:[restoredPath stringByAppendingPathComponent:@"Nested"]], @"Excluded directory restored");
+    STAssertTrue([fileManager fileExistsAtPath:[restoredPath stringByAppendingPathComponent:@"bands/5"]], @"Band not restored");
+}
+
+
+- (void)testIncrementalArchive
+{
+    NSError *error = nil;
+    NSString *fullArchivePath = [temporaryDirectory stringByAppendingPathComponent:@"Full"];
+    NSString *incrementalArchivePath = [temporaryDirectory stringByAppendingPathComponent:@"Incremental"];
+    NSString *restoredPath = [temporaryDirectory stringByAppendingPathComponent:@"Restored"];
+    
+    PGArchiver *archiver = [[PGArchiver alloc] init];
+    [archiver setChunkSize:PGArchiveTestChunkSize];
+    PGArchiveCatalog *baseCatalog = PGArchiveTestArchive(archiver, contentsPath, fullArchivePath, nil, &error);
+    STAssertNotNil(baseCatalog, @"Failed to archive directory: %@", error);
+    STAssertNotNil(PGArchiveTestExtract(archiver, fullArchivePath, restoredPath, &error), @"Failed to extract archive: %@", error);
+    
+    // Incremental archives can't be extracted into a new directory
+    PGArchiveCatalog *catalog = PGArchiveTestArchive(archiver, contentsPath, incrementalArchivePath, baseCatalog, &error);
+    STAssertNotNil(catalog, @"Failed to archive unchanged directory: %@", error);
+    STAssertNil(PGArchiveTestExtract(archiver, incrementalArchivePath, [temporaryDirectory stringByAppendingPathComponent:@"Missing"], &error), 
+                @"Extracted incremental archive into new directory");
+    
+    // Change a band's size, add a band and a directory, and remove a band
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    [[NSData randomDataOfLength:3 * PGArchiveTestChunkSize] writeToFile:[contentsPath stringByAppendingPathComponent:@"bands/4"] atomically:NO];
+    [[NSData randomDataOfLength:PGArchiveTestChunkSize] writeToFile:[contentsPath stringByAppendingPathComponent:@"bands/6"] atomically:NO];
+    [fileManager createDirectoryAtPath:[contentsPath stringByAppendingPathComponent:@"Added"] withIntermediateDirectories:NO attributes:nil 
+                                 error:NULL];
+    [fileManager removeItemAtPath:[contentsPath stringByAppendingPathComponent:@"bands/1"] error:NULL];
+    
+    catalog = PGArchiveTestArchive(archiver, contentsPath, incrementalArchivePath, baseCatalog, &error);
+    STAssertNotNil(catalog, @"Failed to archive changed directory: %@", error);
+    unsigned long long fullSize = [[fileManager attributesOfItemAtPath:fullArchivePath error:NULL] fileSize];
+    unsigned long long incrementalSize = [[fileManager attributesOfItemAtPath:incrementalArchivePath error:NULL] fileSize];
+    STAssertTrue(incrementalSize < fullSize, @"Incremental archive included unchanged files");
+    
+    // Applying the incremental archive leaves excluded files alone
+    [[@"local" dataUsingEncoding:NSUTF8StringEncoding] writeToFile:[restoredPath stringByAppendingPathComponent:@"Excluded"] atomically:NO];
+    STAssertNotNil(PGArchiveTestExtract(archiver, incrementalArchivePath, restoredPath, &error), @"Failed to extract incremental archive: %@", error);
+    STAssertTrue(PGArchiveTestDirectoriesAreEqual(contentsPath, restoredPath, [NSSet setWithObject:@"Excluded"]), @"Restored contents differ");
+    STAssertEqualObjects([NSData dataWithContentsOfFile:[restoredPath stringByAppendingPathComponent:@"Excluded"]], 
+                         [@"local" dataUsingEncoding:NSUTF8StringEncoding], @"Excluded file changed");
+    
+    NSArray *stagingPaths = [[fileManager contentsOfDirectoryAtPath:temporaryDirectory error:NULL] filteredArrayUsingPredicate:
+                             [NSPredicate predicateWithFormat:@"SELF BEGINSWITH '.'"]];
+    STAssertEquals([stagingPaths count], (NSUInteger)0, @"Staging directories left behind");
+}
+
+
+- (void)testIncrementalBaseMismatch
+{
+    NSError *error = nil;
+    NSString *fullArchivePath = [temporaryDirectory stringByAppendingPathComponent:@"Full"];
+    NSString *incrementalArchivePath = [temporaryDirectory stringByAppendingPathComponent:@"Incremental"];
+    NSString *restoredPath = [temporaryDirectory stringByAppendingPathComponent:@"Restored"];
+    
+    PGArchiver *archiver = [[PGArchiver alloc] init];
+    PGArchiveCatalog *baseCatalog = PGArchiveTestArchive(archiver, contentsPath, fullArchivePath, nil, &error);
+    STAssertNotNil(PGArchiveTestExtract(archiver, fullArchivePath, restoredPath, &error), @"Failed to extract archive: %@", error);
+    
+    [[NSData randomDataOfLength:PGArchiveTestChunkSize] writeToFile:[contentsPath stringByAppendingPathComponent:@"bands/6"] atomically:NO];
+    STAssertNotNil(PGArchiveTestArchive(archiver, contentsPath, incrementalArchivePath, baseCatalog, &error), 
+                   @"Failed to archive changed directory: %@", error);
+    
+    // An unchanged file that isn't what the base archive had means the directory wasn't restored from it, so nothing is applied
+    [[NSData data] writeToFile:[restoredPath stringByAppendingPathComponent:@"bands/5"] atomically:NO];
+    STAssertNil(PGArchiveTestExtract(archiver, incrementalArchivePath, restoredPath, &error), @"Extracted over mismatched base");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperArchiveBaseMismatchError, @"Wrong error for mismatched base: %@", error);
+    STAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[restoredPath stringByAppendingPathComponent:@"bands/6"]], 
+                  @"Changed file applied to mismatched base");
+}
+
+
+- (void)testMalformedArchives
+{
+    NSError *error = nil;
+    NSString *archivePath = [temporaryDirectory stringByAppendingPathComponent:@"Archive"];
+    NSString *malformedArchivePath = [temporaryDirectory stringByAppendingPathComponent:@"Malformed"];
+    NSString *restoredPath = [temporaryDirectory stringByAppendingPathComponent:@"Restored"];
+    
+    // Random bands don't compress, so their bytes appear in the archive as they are
+    PGArchiver *archiver = [[PGArchiver alloc] init];
+    STAssertNotNil(PGArchiveTestArchive(archiver, contentsPath, archivePath, nil, &error), @"Failed to archive directory: %@", error);
+    NSData *archiveData = [NSData dataWithContentsOfFile:archivePath];
+    NSData *bandData = [NSData dataWithContentsOfFile:[contentsPath stringByAppendingPathComponent:@"bands/5"]];
+    NSRange bandRange = [archiveData rangeOfData:[bandData subdataWithRange:NSMakeRange(0, 64)] options:0 range:NSMakeRange(0, [archiveData length])];
+    STAssertTrue(bandRange.location != NSNotFound, @"Band not stored uncompressed");
+    
+    NSMutableArray *malformedArchives = [NSMutableArray array];
+    [malformedArchives addObject:[archiveData subdataWithRange:NSMakeRange(0, [archiveData length] - 10)]];
+    [malformedArchives addObject:[archiveData subdataWithRange:NSMakeRange(0, 8)]];
+    
+    NSMutableData *corruptArchive = [archiveData mutableCopy];
+    ((uint8_t *)[corruptArchive mutableBytes])[bandRange.location + 10] ^= 0x01;
+    [malformedArchives addObject:corruptArchive];
+    
+    NSMutableData *badMagicArchive = [archiveData mutableCopy];
+    ((uint8_t *)[badMagicArchive mutableBytes])[0] = 'X';
+    [malformedArchives addObject:badMagicArchive];
+    
+    // A record whose path leaves the directory
+    NSMutableData *escapingArchive = [[archiveData subdataWithRange:NSMakeRange(0, 16)] mutableCopy];
+    PGArchiveTestAppendRecord(escapingArchive, 1, @"../Escaped", 0);
+    PGArchiveTestAppendRecord(escapingArchive, 0, @"", 0);
+    [malformedArchives addObject:escapingArchive];
+    
+    for (NSData *malformedArchive in malformedArchives) {
+        [malformedArchive writeToFile:malformedArchivePath atomically:NO];
+        error = nil;
+        STAssertNil(PGArchiveTestExtract(archiver, malformedArchivePath, restoredPath, &error), @"Extracted malformed archive");
+        STAssertEqualObjects([error domain], PGErrorDomain, @"Wrong error domain for malformed archive: %@", error);
+        STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperMalformedArchiveError, @"Wrong error for malformed archive: %@", error);
+        STAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:restoredPath], @"Malformed archive partially extracted");
+    }
+    
+    STAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[temporaryDirectory stringByAppendingPathComponent:@"Escaped"]], 
+                  @"Extracted file outside directory");
+    NSArray *stagingPaths = [[[NSFileManager defaultManager] contentsOfDirectoryAtPath:temporaryDirectory error:NULL] filteredArrayUsingPredicate:
+                             [NSPredicate predicateWithFormat:@"SELF BEGINSWITH '.'"]];
+    STAssertEquals([stagingPaths count], (NSUInteger)0, @"Staging directories left behind");
+}
+
+
+- (void)testPipe
+{
+    NSError *error = nil;
+    NSString *restoredPath = [temporaryDirectory stringByAppendingPathComponent:@"Restored"];
+    int fileDescriptors[2];
+    STAssertEquals(pipe(fileDescriptors), 0, @"Failed to create pipe");
+    
+    // Archiving and extracting at once through a pipe only works if neither needs to seek
+    PGArchiver *archiver = [[PGArchiver alloc] init];
+    [archiver setChunkSize:PGArchiveTestChunkSize];
+    __block PGArchiveCatalog *catalog = nil;
+    int writeFileDescriptor = fileDescriptors[1];
+    dispatch_group_t group = dispatch_group_create();
+    dispatch_group_async(group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        catalog = [[[PGArchiver alloc] init] archiveDirectoryAtPath:contentsPath toFileDescriptor:writeFileDescriptor excludedRelativePaths:nil 
+                                                        baseCatalog:nil error:NULL];
+        close(writeFileDescriptor);
+    });
+    
+    PGArchiveCatalog *extractedCatalog = [archiver extractArchiveFromFileDescriptor:fileDescriptors[0] toDirectoryAtPath:restoredPath error:&error];
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    dispatch_release(group);
+    close(fileDescriptors[0]);
+    
+    STAssertNotNil(catalog, @"Failed to archive directory");
+    STAssertNotNil(extractedCatalog, @"Failed to extract archive: %@", error);
+    STAssertTrue(PGArchiveTestDirectoriesAreEqual(contentsPath, restoredPath, [NSSet set]), @"Restored contents differ");
+}
+
+
+- (void)testCatalogReadAndWrite
+{
+    NSError *error = nil;
+    NSString *archivePath = [temporaryDirectory stringByAppendingPathComponent:@"Archive"];
+    NSString *catalogPath = [temporaryDirectory stringByAppendingPathComponent:@"Catalog.plist"];
+    
+    PGArchiveCatalog *catalog = PGArchiveTestArchive([[PGArchiver alloc] init], contentsPath, archivePath, nil, &error);
+    STAssertTrue([catalog writeToFile:catalogPath error:&error], @"Failed to write catalog: %@", error);
+    
+    PGArchiveCatalog *readCatalog = [[PGArchiveCatalog alloc] initWithContentsOfFile:catalogPath error:&error];
+    STAssertNotNil(readCatalog, @"Failed to read catalog: %@", error);
+    STAssertEqualObjects([readCatalog relativePaths], [catalog relativePaths], @"Relative paths differ");
+    STAssertEqualObjects([readCatalog directoryRelativePaths], [catalog directoryRelativePaths], @"Directory paths differ");
+    STAssertEqualObjects([readCatalog excludedRelativePaths], [catalog excludedRelativePaths], @"Excluded paths differ");
+    for (NSString *relativePath in [catalog relativePaths]) {
+        STAssertEquals([readCatalog sizeForRelativePath:relativePath], [catalog sizeForRelativePath:relativePath], @"Size differs");
+        STAssertEqualObjects([readCatalog modificationDateForRelativePath:relativePath], [catalog modificationDateForRelativePath:relativePath], 
+                             @"Modification date differs");
+    }
+    
+    [[@"garbage" dataUsingEncoding:NSUTF8StringEncoding] writeToFile:catalogPath atomically:NO];
+    STAssertNil([[PGArchiveCatalog alloc] initWithContentsOfFile:catalogPath error:&error], @"Read malformed catalog");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperMalformedArchiveError, @"Wrong error for malformed catalog: %@", error);
+}
+
+
+- (void)testWrapperArchive
+{
+    NSError *error = nil;
+    NSString *wrapperPath = [temporaryDirectory stringByAppendingPathComponent:@"Test.edi"];
+    NSString *restoredPath = [temporaryDirectory stringByAppendingPathComponent:@"Restored.edi"];
+    NSString *archivePath = [temporaryDirectory stringByAppendingPathComponent:@"Archive"];
+    NSDictionary *volumeOptions = [NSDictionary dictionaryWithObjectsAndKeys:PGBandStoreBackend, PGBackendVolumeOption, 
+                                   [NSNumber numberWithUnsignedInteger:5], PGSizeVolumeOption, nil];
+    PGEncryptedDiskImageWrapper *wrapper = [PGEncryptedDiskImageWrapper createEncryptedDiskImageWrapperAtPath:wrapperPath masterPassword:@"master"
+                                                                                                         user:@"user" password:@"password" 
+                                                                                                volumeOptions:volumeOptions error:&error];
+    STAssertNotNil(wrapper, @"Failed to create wrapper: %@", error);
+    
+    PGBandStore *bandStore = [wrapper openBandStore:&error];
+    NSData *data = [NSData randomDataOfLength:4096];
+    STAssertTrue([bandStore writeData:data atOffset:0 error:&error] && [bandStore flush:&error], @"Failed to write band store: %@", error);
+    NSString *sessionToken = [wrapper issueSessionTokenWithTimeToLive:60 error:&error];
+    STAssertNotNil(sessionToken, @"Failed to issue session token: %@", error);
+    
+    int fileDescriptor = open([archivePath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    PGArchiveCatalog *catalog = [wrapper exportToFileDescriptor:fileDescriptor baseCatalog:nil error:&error];
+    close(fileDescriptor);
+    STAssertNotNil(catalog, @"Failed to export wrapper: %@", error);
+    
+    fileDescriptor = open([archivePath fileSystemRepresentation], O_RDONLY);
+    STAssertNotNil([PGEncryptedDiskImageWrapper importWrapperFromFileDescriptor:fileDescriptor toPath:restoredPath error:&error], 
+                   @"Failed to import wrapper: %@", error);
+    close(fileDescriptor);
+    
+    // The restored wrapper opens with the same password and has the same data, but sessions aren't restored
+    PGEncryptedDiskImageWrapper *restoredWrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:restoredPath user:@"user" 
+                                                                                                      password:@"password" error:&error];
+    STAssertNotNil(restoredWrapper, @"Failed to open restored wrapper: %@", error);
+    STAssertEqualObjects([[restoredWrapper openBandStore:&error] readDataOfLength:[data length] atOffset:0 error:&error], data, 
+                         @"Restored band store differs: %@", error);
+    STAssertNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:restoredPath sessionToken:sessionToken error:NULL], 
+                @"Session restored with wrapper");
+    
+    // An incremental export only carries the bands written since the full one. Bands don't change size, so wait long enough for the 
+    // rewritten band's modification date to differ.
+    [NSThread sleepForTimeInterval:1.1];
+    NSData *changedData = [NSData randomDataOfLength:4096];
+    STAssertTrue([bandStore writeData:changedData atOffset:0 error:&error] && [bandStore flush:&error], @"Failed to write band store: %@", error);
+    fileDescriptor = open([archivePath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    STAssertNotNil([wrapper exportToFileDescriptor:fileDescriptor baseCatalog:catalog error:&error], @"Failed to export changes: %@", error);
+    close(fileDescriptor);
+    
+    fileDescriptor = open([archivePath fileSystemRepresentation], O_RDONLY);
+    STAssertNotNil([PGEncryptedDiskImageWrapper importWrapperFromFileDescriptor:fileDescriptor toPath:restoredPath error:&error], 
+                   @"Failed to import changes: %@", error);
+    close(fileDescriptor);
+    
+    restoredWrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:restoredPath user:@"user" password:@"password" error:&error];
+    STAssertEqualObjects([[restoredWrapper openBandStore:&error] readDataOfLength:[changedData length] atOffset:0 error:&error], changedData, 
+                         @"Changes not restored: %@", error);
+}
+
+@end
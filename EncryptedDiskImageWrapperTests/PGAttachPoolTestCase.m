@@ -0,0 +1,178 @@
+//
+//  PGAttachPoolTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGAttachPoolTestCase.h"
+
+#import <stdlib.h>
+
+#import "NSData+Crypto.h"
+#import "PGAttachPool.h"
+#import "PGEncryptedDiskImageWrapper.h"
+
+@implementation PGAttachPoolTestCase
+
+- (void)setUp
+{
+    [super setUp];
+    NSDictionary *volumeOptions = [NSDictionary dictionaryWithObjectsAndKeys:@"Test Volume", PGNameVolumeOption, 
+                                   [NSNumber numberWithUnsignedInteger:5], PGSizeVolumeOption, nil];
+    wrapper = [PGEncryptedDiskImageWrapper createEncryptedDiskImageWrapperAtPath:[temporaryDirectory stringByAppendingPathComponent:@"test.edi"]
+                                                                  masterPassword:[NSData randomlyGeneratedPassword] 
+                                                                            user:@"user1"
+                                                                        password:@"password1"
+                                                                   volumeOptions:volumeOptions
+                                                                           error:NULL];
+    
+    [self logStubInvocations];
+}
+
+
+- (void)testCoalescedLeases
+{
+    STAssertNotNil(wrapper, @"Failed to create wrapper");
+    setenv("PGHDIUTIL_STUB_DELAY", "1", 1);
+    
+    PGAttachPool *attachPool = [[PGAttachPool alloc] initWithMountRoot:temporaryDirectory];
+    NSMutableArray *leases = [NSMutableArray array];
+    dispatch_group_t leaseGroup = dispatch_group_create();
+    
+    // These all arrive while the first attach is still running, so they should share it
+    for (NSUInteger i = 0; i < 8; ++i) {
+        dispatch_group_enter(leaseGroup);
+        [attachPool leaseMountForWrapper:wrapper completionHandler:^(PGAttachLease *lease, NSError *error) {
+            @synchronized (leases) {
+                if (lease) [leases addObject:lease];
+            }
+            
+            dispatch_group_leave(leaseGroup);
+        }];
+    }
+    
+    dispatch_group_wait(leaseGroup, DISPATCH_TIME_FOREVER);
+    dispatch_release(leaseGroup);
+    
+    STAssertEquals([leases count], (NSUInteger)8, @"Wrong number of leases");
+    STAssertEquals([self stubInvocationCountForVerb:@"attach"], (NSUInteger)1, @"Concurrent leases weren't coalesced");
+    STAssertEquals([attachPool missCount], (NSUInteger)1, @"Wrong miss count");
+    STAssertEquals([attachPool hitCount], (NSUInteger)7, @"Wrong hit count");
+    
+    NSString *mountPoint = [[leases objectAtIndex:0] mountPoint];
+    STAssertNotNil(mountPoint, @"Lease has no mount point");
+    STAssertEqualObjects([leases valueForKey:@"mountPoint"], [NSArray arrayWithObjects:mountPoint, mountPoint, mountPoint, mountPoint, mountPoint, 
+                                                              mountPoint, mountPoint, mountPoint, nil], @"Leases have different mount points");
+    STAssertEquals([attachPool leaseCountForWrapperAtPath:[wrapper wrapperPath]], (NSUInteger)8, @"Wrong lease count");
+    
+    // Leases on an attached wrapper are handed out without running hdiutil
+    PGAttachLease *lease = [attachPool leaseMountForWrapper:wrapper error:NULL];
+    STAssertEqualObjects([lease mountPoint], mountPoint, @"Wrong mount point");
+    STAssertEquals([attachPool hitCount], (NSUInteger)8, @"Wrong hit count");
+    STAssertEquals([self stubInvocationCountForVerb:@"attach"], (NSUInteger)1, @"Attached wrapper was attached again");
+    
+    [lease relinquish];
+    [lease relinquish];
+    [leases makeObjectsPerformSelector:@selector(relinquish)];
+    STAssertEquals([attachPool leaseCountForWrapperAtPath:[wrapper wrapperPath]], (NSUInteger)0, @"Wrong lease count after relinquishing");
+    STAssertTrue([attachPool detachIdleWrappers:NULL], @"Failed to detach idle wrappers");
+}
+
+
+- (void)testIdleDetach
+{
+    STAssertNotNil(wrapper, @"Failed to create wrapper");
+    
+    PGAttachPool *attachPool = [[PGAttachPool alloc] initWithMountRoot:temporaryDirectory];
+    [attachPool setIdleTimeout:0.5];
+    
+    NSError *error = nil;
+    PGAttachLease *lease = [attachPool leaseMountForWrapper:wrapper error:&error];
+    STAssertNotNil(lease, @"Lease failed with error: %@", error);
+    [lease relinquish];
+    
+    // Leasing again within the idle timeout keeps the wrapper attached
+    lease = [attachPool leaseMountForWrapper:wrapper error:&error];
+    STAssertEquals([attachPool hitCount], (NSUInteger)1, @"Idle wrapper wasn't reused");
+    [NSThread sleepForTimeInterval:1.0];
+    STAssertEquals([self stubInvocationCountForVerb:@"detach"], (NSUInteger)0, @"Leased wrapper was detached");
+    
+    [lease relinquish];
+    [NSThread sleepForTimeInterval:1.5];
+    STAssertEquals([self stubInvocationCountForVerb:@"detach"], (NSUInteger)1, @"Idle wrapper wasn't detached");
+    STAssertNil([attachPool mountPointForWrapperAtPath:[wrapper wrapperPath]], @"Detached wrapper still has a mount point");
+    STAssertFalse([wrapper isAttached], @"Wrapper is detached, but status says otherwise");
+    
+    lease = [attachPool leaseMountForWrapper:wrapper error:&error];
+    STAssertNotNil(lease, @"Lease after detaching failed with error: %@", error);
+    STAssertEquals([attachPool missCount], (NSUInteger)2, @"Wrong miss count");
+    STAssertEquals([self stubInvocationCountForVerb:@"attach"], (NSUInteger)2, @"Wrong number of attaches");
+    
+    [lease relinquish];
+    [attachPool detachIdleWrappers:NULL];
+}
+
+
+- (void)testAttachFailure
+{
+    STAssertNotNil(wrapper, @"Failed to create wrapper");
+    setenv("PGHDIUTIL_STUB_STATUS", "1", 1);
+    
+    PGAttachPool *attachPool = [[PGAttachPool alloc] initWithMountRoot:temporaryDirectory];
+    NSError *error = nil;
+    STAssertNil([attachPool leaseMountForWrapper:wrapper error:&error], @"Lease succeeded despite attach failing");
+    STAssertNotNil(error, @"No error for failed attach");
+    STAssertEquals([attachPool leaseCountForWrapperAtPath:[wrapper wrapperPath]], (NSUInteger)0, @"Failed attach has leases");
+    
+    // Failures aren't remembered
+    unsetenv("PGHDIUTIL_STUB_STATUS");
+    PGAttachLease *lease = [attachPool leaseMountForWrapper:wrapper error:&error];
+    STAssertNotNil(lease, @"Lease failed with error: %@", error);
+    STAssertEquals([attachPool missCount], (NSUInteger)2, @"Wrong miss count");
+    
+    [lease relinquish];
+    [attachPool detachIdleWrappers:NULL];
+}
+
+
+- (void)testDetachIdleWrappers
+{
+    STAssertNotNil(wrapper, @"Failed to create wrapper");
+    
+    PGAttachPool *attachPool = [[PGAttachPool alloc] initWithMountRoot:temporaryDirectory];
+    NSError *error = nil;
+    PGAttachLease *lease = [attachPool leaseMountForWrapper:wrapper error:&error];
+    STAssertNotNil(lease, @"Lease failed with error: %@", error);
+    
+    // Leased wrappers aren't idle
+    STAssertTrue([attachPool detachIdleWrappers:&error], @"Failed to detach idle wrappers with error: %@", error);
+    STAssertEquals([self stubInvocationCountForVerb:@"detach"], (NSUInteger)0, @"Leased wrapper was detached");
+    STAssertEqualObjects([attachPool mountPointForWrapperAtPath:[wrapper wrapperPath]], [lease mountPoint], @"Wrong mount point");
+    
+    [lease relinquish];
+    STAssertTrue([attachPool detachIdleWrappers:&error], @"Failed to detach idle wrappers with error: %@", error);
+    STAssertEquals([self stubInvocationCountForVerb:@"detach"], (NSUInteger)1, @"Idle wrapper wasn't detached");
+    STAssertFalse([wrapper isAttached], @"Wrapper is detached, but status says otherwise");
+}
+
+@end
@@ -0,0 +1,205 @@
+//
+//  PGAuthenticationServiceTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGAuthenticationServiceTestCase.h"
+
+#import "NSFileManager+TemporaryFiles.h"
+#import "PGAuthenticationService.h"
+#import "PGEncryptedDiskImageWrapper.h"
+#import "PGErrors.h"
+
+
+@implementation PGAuthenticationServiceTestCase
+
+- (void)setUp
+{
+    [super setUp];
+    temporaryDirectory = [[NSFileManager defaultManager] createTemporaryDirectoryWithTemplate:@"PGAuthenticationServiceTestCase.XXXXXX" 
+                                                                                        error:NULL];
+    
+    // Band store wrappers don't need hdiutil
+    NSError *error = nil;
+    wrapperPath = [temporaryDirectory stringByAppendingPathComponent:@"Test.edi"];
+    NSDictionary *volumeOptions = [NSDictionary dictionaryWithObjectsAndKeys:PGBandStoreBackend, PGBackendVolumeOption, 
+                                   [NSNumber numberWithUnsignedInteger:5], PGSizeVolumeOption, nil];
+    STAssertNotNil([PGEncryptedDiskImageWrapper createEncryptedDiskImageWrapperAtPath:wrapperPath masterPassword:@"master" user:@"user1" 
+                                                                             password:@"password1" volumeOptions:volumeOptions error:&error],
+                   @"Failed to create wrapper: %@", error);
+}
+
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:temporaryDirectory error:NULL];
+    [super tearDown];
+}
+
+
+- (void)testOpenWrapper
+{
+    NSError *error = nil;
+    PGAuthenticationService *service = [[PGAuthenticationService alloc] init];
+    STAssertEquals([service maximumConcurrentCount], [[NSProcessInfo processInfo] activeProcessorCount], @"Wrong default concurrency");
+    
+    PGEncryptedDiskImageWrapper *wrapper = [service openWrapperAtPath:wrapperPath user:@"user1" password:@"password1" timeout:0 error:&error];
+    STAssertNotNil(wrapper, @"Failed to open wrapper: %@", error);
+    STAssertEqualObjects([wrapper user], @"user1", @"Wrong user");
+    
+    STAssertNil([service openWrapperAtPath:wrapperPath user:@"user1" password:@"wrong" timeout:0 error:&error], @"Opened with wrong password");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperAuthenticationError, @"Wrong error for wrong password: %@", error);
+    
+    STAssertEquals([service queueDepth], (NSUInteger)0, @"Requests left in queue");
+    STAssertEquals([service shedCount] + [service expiredCount], (NSUInteger)0, @"Requests rejected");
+}
+
+
+- (void)testConcurrencyLimit
+{
+    PGAuthenticationService *service = [[PGAuthenticationService alloc] init];
+    [service setMaximumConcurrentCount:1];
+    
+    // Requests are queued on the service's serial queue, so by the time the statistics are read, all of them have been queued
+    dispatch_group_t group = dispatch_group_create();
+    for (NSUInteger i = 0; i < 4; ++i) {
+        dispatch_group_enter(group);
+        [service openWrapperAtPath:wrapperPath user:@"user1" password:@"password1" timeout:0 
+                 completionHandler:^(PGEncryptedDiskImageWrapper *wrapper, NSError *error) {
+                     STAssertNotNil(wrapper, @"Failed to open wrapper: %@", error);
+                     dispatch_group_leave(group);
+                 }];
+    }
+    
+    STAssertEquals([service activeCount], (NSUInteger)1, @"Concurrency limit exceeded");
+    STAssertEquals([service queueDepth], (NSUInteger)3, @"Wrong queue depth");
+    
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    dispatch_release(group);
+    
+    // The last request waited for the three before it
+    STAssertTrue([service maximumWaitTime] > 0.0, @"No wait time recorded");
+    STAssertTrue([service averageWaitTime] <= [service maximumWaitTime], @"Average wait exceeds maximum");
+    
+    [service resetStatistics];
+    STAssertEquals([service maximumWaitTime], 0.0, @"Statistics not reset");
+}
+
+
+- (void)testLoadShedding
+{
+    PGAuthenticationService *service = [[PGAuthenticationService alloc] init];
+    [service setMaximumConcurrentCount:1];
+    [service setMaximumQueueDepth:2];
+    
+    // One request runs, two wait, and the rest are rejected
+    __block NSUInteger overloadedCount = 0;
+    dispatch_group_t group = dispatch_group_create();
+    for (NSUInteger i = 0; i < 5; ++i) {
+        dispatch_group_enter(group);
+        [service openWrapperAtPath:wrapperPath user:@"user1" password:@"password1" timeout:0 
+                 completionHandler:^(PGEncryptedDiskImageWrapper *wrapper, NSError *error) {
+                     if ([error code] == PGEncryptedDiskImageWrapperAuthenticationOverloadedError) {
+                         @synchronized (service) {
+                             ++overloadedCount;
+                         }
+                     }
+                     
+                     dispatch_group_leave(group);
+                 }];
+    }
+    
+    STAssertEquals([service queueDepth], (NSUInteger)2, @"Queue grew past its maximum depth");
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    dispatch_release(group);
+    
+    STAssertEquals(overloadedCount, (NSUInteger)2, @"Wrong number of requests rejected");
+    STAssertEquals([service shedCount], (NSUInteger)2, @"Wrong shed count");
+}
+
+
+- (void)testDeadlines
+{
+    PGAuthenticationService *service = [[PGAuthenticationService alloc] init];
+    [service setMaximumConcurrentCount:1];
+    
+    // Several key derivations take far longer than the last request's timeout, so it expires without being started
+    dispatch_group_t group = dispatch_group_create();
+    for (NSUInteger i = 0; i < 4; ++i) {
+        dispatch_group_enter(group);
+        [service openWrapperAtPath:wrapperPath user:@"user1" password:@"password1" timeout:0 
+                 completionHandler:^(PGEncryptedDiskImageWrapper *wrapper, NSError *error) {
+                     dispatch_group_leave(group);
+                 }];
+    }
+    
+    __block NSError *expiredError = nil;
+    dispatch_group_enter(group);
+    [service openWrapperAtPath:wrapperPath user:@"user1" password:@"password1" timeout:0.001 
+             completionHandler:^(PGEncryptedDiskImageWrapper *wrapper, NSError *error) {
+                 expiredError = error;
+                 dispatch_group_leave(group);
+             }];
+    
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    dispatch_release(group);
+    
+    STAssertEquals([expiredError code], (NSInteger)PGEncryptedDiskImageWrapperAuthenticationDeadlineExceededError, 
+                   @"Wrong error for expired request: %@", expiredError);
+    STAssertEquals([service expiredCount], (NSUInteger)1, @"Wrong expired count");
+    STAssertTrue([service maximumWaitTime] >= 0.001, @"Expired request's wait not recorded");
+    STAssertEquals([service queueDepth], (NSUInteger)0, @"Expired request left in queue");
+}
+
+
+- (void)testFairScheduling
+{
+    PGAuthenticationService *service = [[PGAuthenticationService alloc] init];
+    [service setMaximumConcurrentCount:1];
+    
+    // With one worker, requests finish in the order they're started. The first runs at once; the rest are queued, and user1's request is served 
+    // after the attacker's first rather than after all of them.
+    NSArray *users = [NSArray arrayWithObjects:@"user1", @"attacker", @"attacker", @"attacker", @"user1", nil];
+    NSMutableArray *completedUsers = [NSMutableArray array];
+    dispatch_group_t group = dispatch_group_create();
+    for (NSString *user in users) {
+        dispatch_group_enter(group);
+        [service openWrapperAtPath:wrapperPath user:user password:@"password1" timeout:0 
+                 completionHandler:^(PGEncryptedDiskImageWrapper *wrapper, NSError *error) {
+                     @synchronized (completedUsers) {
+                         [completedUsers addObject:user];
+                     }
+                     
+                     dispatch_group_leave(group);
+                 }];
+    }
+    
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    dispatch_release(group);
+    
+    NSArray *expectedUsers = [NSArray arrayWithObjects:@"user1", @"attacker", @"user1", @"attacker", @"attacker", nil];
+    STAssertEqualObjects(completedUsers, expectedUsers, @"Requests weren't served round-robin by user");
+}
+
+@end
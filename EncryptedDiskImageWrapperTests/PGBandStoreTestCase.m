@@ -0,0 +1,352 @@
+//
+//  PGBandStoreTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGBandStoreTestCase.h"
+
+#import "NSData+Crypto.h"
+#import "NSFileManager+TemporaryFiles.h"
+#import "PGBandStore.h"
+#import "PGCryptoProvider.h"
+#import "PGEncryptedDiskImageWrapper.h"
+#import "PGErrors.h"
+
+/*! @abstract The band size used by most tests, which is small enough that tests span many bands. */
+static const NSUInteger PGBandStoreTestBandSize = 64 * 1024;
+
+@implementation PGBandStoreTestCase
+
+- (void)setUp
+{
+    [super setUp];
+    temporaryDirectory = [[NSFileManager defaultManager] createTemporaryDirectoryWithTemplate:@"PGBandStoreTestCase.XXXXXX" error:NULL];
+    bandStorePath = [temporaryDirectory stringByAppendingPathComponent:@"Test.bands"];
+}
+
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:temporaryDirectory error:NULL];
+    [super tearDown];
+}
+
+
+- (void)testRoundTrip
+{
+    NSError *error = nil;
+    PGBandStore *bandStore = [PGBandStore createBandStoreAtPath:bandStorePath password:@"password" length:0 bandSize:PGBandStoreTestBandSize 
+                                                          error:&error];
+    STAssertNotNil(bandStore, @"Failed to create band store with error: %@", error);
+    
+    // A tiny cache forces bands to be evicted and reread. Writes at odd offsets and lengths span sector and band boundaries.
+    [bandStore setCacheCapacity:2];
+    NSMutableData *expectedData = [NSMutableData data];
+    for (NSUInteger i = 0; i < 64; ++i) {
+        NSUInteger offset = arc4random_uniform(8 * PGBandStoreTestBandSize);
+        NSData *data = [NSData randomDataOfLength:arc4random_uniform(3 * PGBandStoreTestBandSize) + 1];
+        if (offset + [data length] > [expectedData length]) [expectedData setLength:offset + [data length]];
+        [expectedData replaceBytesInRange:NSMakeRange(offset, [data length]) withBytes:[data bytes]];
+        STAssertTrue([bandStore writeData:data atOffset:offset error:&error], @"Write failed with error: %@", error);
+    }
+    
+    STAssertEquals([bandStore length], (unsigned long long)[expectedData length], @"Wrong length");
+    STAssertEqualObjects([bandStore readDataOfLength:[expectedData length] atOffset:0 error:&error], expectedData, @"Wrong contents");
+    STAssertTrue([bandStore flush:&error], @"Flush failed with error: %@", error);
+    
+    bandStore = [[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:@"password" error:&error];
+    STAssertNotNil(bandStore, @"Failed to open band store with error: %@", error);
+    STAssertEquals([bandStore length], (unsigned long long)[expectedData length], @"Wrong length after reopening");
+    STAssertEqualObjects([bandStore readDataOfLength:[expectedData length] atOffset:0 error:&error], expectedData, @"Wrong contents after reopening");
+    
+    // Reads past the end are short
+    STAssertEquals([[bandStore readDataOfLength:100 atOffset:[expectedData length] - 10 error:&error] length], (NSUInteger)10, @"Wrong read length");
+}
+
+
+- (void)testSparseAllocation
+{
+    NSError *error = nil;
+    unsigned long long length = 1024ULL * PGBandStoreTestBandSize;
+    PGBandStore *bandStore = [PGBandStore createBandStoreAtPath:bandStorePath password:@"password" length:length bandSize:PGBandStoreTestBandSize 
+                                                          error:&error];
+    
+    // Only the band that's written gets a file, and everything else reads as zeros
+    NSData *data = [NSData randomDataOfLength:100];
+    [bandStore writeData:data atOffset:length / 2 error:&error];
+    [bandStore flush:&error];
+    
+    NSString *bandsPath = [bandStorePath stringByAppendingPathComponent:@"bands"];
+    STAssertEquals([[[NSFileManager defaultManager] contentsOfDirectoryAtPath:bandsPath error:NULL] count], (NSUInteger)1, @"Wrong number of bands");
+    
+    bandStore = [[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:@"password" error:&error];
+    STAssertEqualObjects([bandStore readDataOfLength:100 atOffset:length / 2 error:&error], data, @"Wrong contents");
+    STAssertEqualObjects([bandStore readDataOfLength:PGBandStoreTestBandSize atOffset:0 error:&error], 
+                         [NSMutableData dataWithLength:PGBandStoreTestBandSize], @"Unwritten band isn't zeros");
+    STAssertEqualObjects([bandStore readDataOfLength:100 atOffset:length / 2 + 100 error:&error], [NSMutableData dataWithLength:100], 
+                         @"Unwritten part of band isn't zeros");
+}
+
+
+- (void)testTruncate
+{
+    NSError *error = nil;
+    PGBandStore *bandStore = [PGBandStore createBandStoreAtPath:bandStorePath password:@"password" length:0 bandSize:PGBandStoreTestBandSize 
+                                                          error:&error];
+    NSData *data = [NSData randomDataOfLength:4 * PGBandStoreTestBandSize];
+    [bandStore writeData:data atOffset:0 error:&error];
+    [bandStore flush:&error];
+    
+    // Truncating in the middle of a sector and then extending again exposes zeros, not the old data, both before and after flushing
+    NSUInteger truncatedLength = PGBandStoreTestBandSize + 1000;
+    STAssertTrue([bandStore truncateToLength:truncatedLength error:&error], @"Truncate failed with error: %@", error);
+    STAssertTrue([bandStore truncateToLength:[data length] error:&error], @"Extend failed with error: %@", error);
+    
+    NSMutableData *expectedData = [NSMutableData dataWithLength:[data length]];
+    [expectedData replaceBytesInRange:NSMakeRange(0, truncatedLength) withBytes:[data bytes]];
+    STAssertEqualObjects([bandStore readDataOfLength:[data length] atOffset:0 error:&error], expectedData, @"Wrong contents after truncating");
+    
+    [bandStore flush:&error];
+    bandStore = [[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:@"password" error:&error];
+    STAssertEqualObjects([bandStore readDataOfLength:[data length] atOffset:0 error:&error], expectedData, 
+                         @"Wrong contents after truncating and reopening");
+    
+    NSString *bandsPath = [bandStorePath stringByAppendingPathComponent:@"bands"];
+    STAssertEquals([[[NSFileManager defaultManager] contentsOfDirectoryAtPath:bandsPath error:NULL] count], (NSUInteger)2, 
+                   @"Bands past the end weren't deleted");
+}
+
+
+- (void)testWrongPassword
+{
+    NSError *error = nil;
+    [PGBandStore createBandStoreAtPath:bandStorePath password:@"password" length:0 bandSize:PGBandStoreTestBandSize error:&error];
+    STAssertNil([[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:@"wrongpassword" error:&error], 
+                @"Opened band store with wrong password");
+}
+
+
+- (void)testChangePassword
+{
+    NSError *error = nil;
+    PGBandStore *bandStore = [PGBandStore createBandStoreAtPath:bandStorePath password:@"password" length:0 bandSize:PGBandStoreTestBandSize 
+                                                          error:&error];
+    NSData *data = [NSData randomDataOfLength:3 * [bandStore sectorSize]];
+    [bandStore writeData:data atOffset:0 error:&error];
+    STAssertTrue([bandStore flush:&error], @"Flush failed with error: %@", error);
+    
+    STAssertFalse([PGBandStore changePasswordOfBandStoreAtPath:bandStorePath fromPassword:@"wrongpassword" toPassword:@"newpassword" error:&error], 
+                  @"Changed password without the old password");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperAuthenticationError, @"Wrong error code");
+    STAssertTrue([PGBandStore changePasswordOfBandStoreAtPath:bandStorePath fromPassword:@"password" toPassword:@"newpassword" error:&error], 
+                 @"Failed to change password with error: %@", error);
+    
+    // The volume key is only re-encrypted, so existing bands are still readable with the new password
+    STAssertNil([[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:@"password" error:NULL], @"Opened band store with old password");
+    bandStore = [[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:@"newpassword" error:&error];
+    STAssertNotNil(bandStore, @"Failed to open band store with new password with error: %@", error);
+    STAssertEqualObjects([bandStore readDataOfLength:[data length] atOffset:0 error:&error], data, @"Wrong contents after changing password");
+}
+
+
+- (void)testSectorsAreAuthenticated
+{
+    if (![NSData isEncryptionAlgorithmAvailable:PGAES256GCMEncryptionAlgorithm]) {
+        STFail(@"AES-GCM is unavailable, so band store sectors can't be authenticated");
+        return;
+    }
+    
+    NSError *error = nil;
+    PGBandStore *bandStore = [PGBandStore createBandStoreAtPath:bandStorePath password:@"password" length:0 bandSize:PGBandStoreTestBandSize 
+                                                          error:&error];
+    NSUInteger sectorSize = [bandStore sectorSize];
+    [bandStore writeData:[NSData randomDataOfLength:2 * sectorSize] atOffset:0 error:&error];
+    STAssertTrue([bandStore flush:&error], @"Flush failed with error: %@", error);
+    
+    NSString *bandPath = [[bandStorePath stringByAppendingPathComponent:@"bands"] stringByAppendingPathComponent:@"0"];
+    NSString *tagsPath = [[bandStorePath stringByAppendingPathComponent:@"tags"] stringByAppendingPathComponent:@"0"];
+    NSData *band = [NSData dataWithContentsOfFile:bandPath];
+    NSData *tags = [NSData dataWithContentsOfFile:tagsPath];
+    NSUInteger tagRecordLength = PGCryptoAESGCMNonceLength + PGCryptoAESGCMTagLength;
+    STAssertEquals([band length], 2 * sectorSize, @"Wrong band file length");
+    STAssertTrue([tags length] > (PGBandStoreTestBandSize / sectorSize) * tagRecordLength, @"Tag file has no bitmap");
+    
+    // Flipping a bit in a sector makes it fail to decrypt
+    NSMutableData *tamperedBand = [band mutableCopy];
+    ((uint8_t *)[tamperedBand mutableBytes])[sectorSize + 17] ^= 0x01;
+    [tamperedBand writeToFile:bandPath atomically:YES];
+    bandStore = [[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:@"password" error:&error];
+    error = nil;
+    STAssertNil([bandStore readDataOfLength:2 * sectorSize atOffset:0 error:&error], @"Read tampered sector");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperMalformedBandStoreError, @"Wrong error code");
+    STAssertNotNil([bandStore readDataOfLength:sectorSize atOffset:0 error:&error], 
+                   @"Failed to read untampered sector in the same band with error: %@", error);
+    
+    // So does moving a sector and its tag record to another sector's place
+    NSMutableData *swappedBand = [band mutableCopy];
+    NSMutableData *swappedTags = [tags mutableCopy];
+    [swappedBand replaceBytesInRange:NSMakeRange(0, sectorSize) withBytes:(const uint8_t *)[band bytes] + sectorSize];
+    [swappedTags replaceBytesInRange:NSMakeRange(0, tagRecordLength) withBytes:(const uint8_t *)[tags bytes] + tagRecordLength];
+    [swappedBand writeToFile:bandPath atomically:YES];
+    [swappedTags writeToFile:tagsPath atomically:YES];
+    bandStore = [[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:@"password" error:&error];
+    STAssertNil([bandStore readDataOfLength:sectorSize atOffset:0 error:&error], @"Read sector moved from elsewhere");
+    
+    // Zeroing a sector's tag record doesn't make it read as unwritten
+    NSMutableData *zeroedTags = [tags mutableCopy];
+    [zeroedTags resetBytesInRange:NSMakeRange(0, tagRecordLength)];
+    [band writeToFile:bandPath atomically:YES];
+    [zeroedTags writeToFile:tagsPath atomically:YES];
+    bandStore = [[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:@"password" error:&error];
+    STAssertNil([bandStore readDataOfLength:sectorSize atOffset:0 error:&error], @"Read sector without its tag record");
+}
+
+
+- (void)testWrittenSectorsAreAuthenticated
+{
+    if (![NSData isEncryptionAlgorithmAvailable:PGAES256GCMEncryptionAlgorithm]) {
+        STFail(@"AES-GCM is unavailable, so band store sectors can't be authenticated");
+        return;
+    }
+    
+    NSError *error = nil;
+    PGBandStore *bandStore = [PGBandStore createBandStoreAtPath:bandStorePath password:@"password" length:0 bandSize:PGBandStoreTestBandSize 
+                                                          error:&error];
+    NSUInteger sectorSize = [bandStore sectorSize];
+    NSUInteger tagRecordLength = PGCryptoAESGCMNonceLength + PGCryptoAESGCMTagLength;
+    NSUInteger bitmapOffset = (PGBandStoreTestBandSize / sectorSize) * tagRecordLength;
+    [bandStore writeData:[NSData randomDataOfLength:2 * sectorSize] atOffset:0 error:&error];
+    [bandStore truncateToLength:4 * sectorSize error:&error];
+    STAssertTrue([bandStore flush:&error], @"Flush failed with error: %@", error);
+    
+    NSString *bandPath = [[bandStorePath stringByAppendingPathComponent:@"bands"] stringByAppendingPathComponent:@"0"];
+    NSString *tagsPath = [[bandStorePath stringByAppendingPathComponent:@"tags"] stringByAppendingPathComponent:@"0"];
+    NSData *band = [NSData dataWithContentsOfFile:bandPath];
+    NSData *tags = [NSData dataWithContentsOfFile:tagsPath];
+    
+    // Zeroing a written sector along with its tag record doesn't make it read as unwritten
+    NSMutableData *zeroedBand = [band mutableCopy];
+    NSMutableData *zeroedTags = [tags mutableCopy];
+    [zeroedBand resetBytesInRange:NSMakeRange(sectorSize, sectorSize)];
+    [zeroedTags resetBytesInRange:NSMakeRange(tagRecordLength, tagRecordLength)];
+    [zeroedBand writeToFile:bandPath atomically:YES];
+    [zeroedTags writeToFile:tagsPath atomically:YES];
+    bandStore = [[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:@"password" error:&error];
+    STAssertNil([bandStore readDataOfLength:sectorSize atOffset:sectorSize error:&error], @"Read zeroed sector as unwritten");
+    
+    // Nor does truncating the band file or deleting it
+    [[band subdataWithRange:NSMakeRange(0, sectorSize)] writeToFile:bandPath atomically:YES];
+    [tags writeToFile:tagsPath atomically:YES];
+    bandStore = [[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:@"password" error:&error];
+    STAssertNil([bandStore readDataOfLength:sectorSize atOffset:sectorSize error:&error], @"Read truncated sector as unwritten");
+    
+    [[NSFileManager defaultManager] removeItemAtPath:bandPath error:NULL];
+    bandStore = [[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:@"password" error:&error];
+    STAssertNil([bandStore readDataOfLength:sectorSize atOffset:0 error:&error], @"Read sector from deleted band file as unwritten");
+    
+    // Clearing a sector's bit in the bitmap or truncating the tag file makes every sector in the band suspect, so even unwritten sectors fail
+    [band writeToFile:bandPath atomically:YES];
+    NSMutableData *clearedTags = [tags mutableCopy];
+    ((uint8_t *)[clearedTags mutableBytes])[bitmapOffset] &= ~0x02;
+    [clearedTags writeToFile:tagsPath atomically:YES];
+    bandStore = [[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:@"password" error:&error];
+    STAssertNotNil([bandStore readDataOfLength:sectorSize atOffset:0 error:&error], @"Failed to read authentic sector with error: %@", error);
+    STAssertNil([bandStore readDataOfLength:sectorSize atOffset:2 * sectorSize error:&error], @"Read sector with a tampered bitmap");
+    
+    [[tags subdataWithRange:NSMakeRange(0, bitmapOffset)] writeToFile:tagsPath atomically:YES];
+    bandStore = [[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:@"password" error:&error];
+    STAssertNil([bandStore readDataOfLength:sectorSize atOffset:2 * sectorSize error:&error], @"Read sector with a truncated bitmap");
+}
+
+
+- (void)testUnauthenticatedSectorsCanBeOverwritten
+{
+    if (![NSData isEncryptionAlgorithmAvailable:PGAES256GCMEncryptionAlgorithm]) {
+        STFail(@"AES-GCM is unavailable, so band store sectors can't be authenticated");
+        return;
+    }
+    
+    NSError *error = nil;
+    PGBandStore *bandStore = [PGBandStore createBandStoreAtPath:bandStorePath password:@"password" length:0 bandSize:PGBandStoreTestBandSize 
+                                                          error:&error];
+    NSUInteger sectorSize = [bandStore sectorSize];
+    NSData *data = [NSData randomDataOfLength:2 * sectorSize];
+    [bandStore writeData:data atOffset:0 error:&error];
+    STAssertTrue([bandStore flush:&error], @"Flush failed with error: %@", error);
+    
+    NSString *bandPath = [[bandStorePath stringByAppendingPathComponent:@"bands"] stringByAppendingPathComponent:@"0"];
+    NSMutableData *tamperedBand = [[NSData dataWithContentsOfFile:bandPath] mutableCopy];
+    ((uint8_t *)[tamperedBand mutableBytes])[sectorSize + 17] ^= 0x01;
+    [tamperedBand writeToFile:bandPath atomically:YES];
+    bandStore = [[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:@"password" error:&error];
+    
+    // The tampered sector can't be partially rewritten, since the rest of it is unknown, but it can be replaced
+    STAssertFalse([bandStore writeData:[NSData randomDataOfLength:100] atOffset:sectorSize + 100 error:&error], @"Partially rewrote tampered sector");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperMalformedBandStoreError, @"Wrong error code");
+    
+    NSData *replacement = [NSData randomDataOfLength:sectorSize];
+    STAssertTrue([bandStore writeData:replacement atOffset:sectorSize error:&error], @"Failed to replace tampered sector with error: %@", error);
+    STAssertEqualObjects([bandStore readDataOfLength:sectorSize atOffset:sectorSize error:&error], replacement, @"Wrong replaced contents");
+    STAssertTrue([bandStore flush:&error], @"Flush failed with error: %@", error);
+    
+    bandStore = [[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:@"password" error:&error];
+    NSMutableData *expectedData = [data mutableCopy];
+    [expectedData replaceBytesInRange:NSMakeRange(sectorSize, sectorSize) withBytes:[replacement bytes]];
+    STAssertEqualObjects([bandStore readDataOfLength:2 * sectorSize atOffset:0 error:&error], expectedData, @"Wrong contents after reopening");
+}
+
+
+- (void)testWrapperBackend
+{
+    NSError *error = nil;
+    NSString *wrapperPath = [temporaryDirectory stringByAppendingPathComponent:@"test.edi"];
+    NSDictionary *volumeOptions = [NSDictionary dictionaryWithObjectsAndKeys:[NSNumber numberWithUnsignedInteger:5], PGSizeVolumeOption, 
+                                   PGBandStoreBackend, PGBackendVolumeOption, nil];
+    
+    // Band store wrappers don't need hdiutil at all
+    PGEncryptedDiskImageWrapper *wrapper = [PGEncryptedDiskImageWrapper createEncryptedDiskImageWrapperAtPath:wrapperPath
+                                                                                               masterPassword:[NSData randomlyGeneratedPassword] 
+                                                                                                         user:@"user1"
+                                                                                                     password:@"password1"
+                                                                                                volumeOptions:volumeOptions
+                                                                                                        error:&error];
+    STAssertNotNil(wrapper, @"Failed to create wrapper with error: %@", error);
+    
+    PGBandStore *bandStore = [wrapper openBandStore:&error];
+    STAssertNotNil(bandStore, @"Failed to open band store with error: %@", error);
+    STAssertEquals([bandStore length], 5ULL * 1024 * 1024, @"Wrong band store length");
+    
+    NSData *data = [NSData randomDataOfLength:10000];
+    [bandStore writeData:data atOffset:12345 error:&error];
+    [bandStore flush:&error];
+    
+    // Other users of the wrapper see the same data
+    [wrapper setPassword:@"password2" forUser:@"user2"];
+    [wrapper saveUserTable];
+    wrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:@"user2" password:@"password2" error:&error];
+    bandStore = [wrapper openBandStore:&error];
+    STAssertEqualObjects([bandStore readDataOfLength:10000 atOffset:12345 error:&error], data, @"Wrong contents for second user");
+}
+
+@end
@@ -0,0 +1,186 @@
+//
+//  PGBulkAttachSchedulerTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGBulkAttachSchedulerTestCase.h"
+
+#import <stdlib.h>
+
+#import "NSData+Crypto.h"
+#import "PGBulkAttachScheduler.h"
+#import "PGEncryptedDiskImageWrapper.h"
+
+/*! @abstract The number of wrappers each test opens. */
+static const NSUInteger PGBulkAttachSchedulerTestWrapperCount = 6;
+
+
+@implementation PGBulkAttachSchedulerTestCase
+
+- (void)setUp
+{
+    [super setUp];
+    NSDictionary *volumeOptions = [NSDictionary dictionaryWithObjectsAndKeys:@"Test Volume", PGNameVolumeOption, 
+                                   [NSNumber numberWithUnsignedInteger:5], PGSizeVolumeOption, nil];
+    NSString *wrapperPath = [temporaryDirectory stringByAppendingPathComponent:@"test0.edi"];
+    PGEncryptedDiskImageWrapper *wrapper = [PGEncryptedDiskImageWrapper createEncryptedDiskImageWrapperAtPath:wrapperPath
+                                                                                               masterPassword:[NSData randomlyGeneratedPassword] 
+                                                                                                         user:@"user1"
+                                                                                                     password:@"password1"
+                                                                                                volumeOptions:volumeOptions
+                                                                                                        error:NULL];
+    STAssertNotNil(wrapper, @"Failed to create wrapper");
+    
+    // Copies of a wrapper are just as good as new ones and are much faster to make
+    wrapperPaths = [NSMutableArray arrayWithObject:wrapperPath];
+    for (NSUInteger i = 1; i < PGBulkAttachSchedulerTestWrapperCount; ++i) {
+        NSString *copyPath = [temporaryDirectory stringByAppendingPathComponent:[NSString stringWithFormat:@"test%lu.edi", (unsigned long)i]];
+        STAssertTrue([[NSFileManager defaultManager] copyItemAtPath:wrapperPath toPath:copyPath error:NULL], @"Failed to copy wrapper");
+        [wrapperPaths addObject:copyPath];
+    }
+    
+    [self logStubInvocations];
+}
+
+
+- (void)testAttach
+{
+    NSMutableArray *requests = [NSMutableArray array];
+    for (NSString *wrapperPath in wrapperPaths) {
+        [requests addObject:[[PGBulkAttachRequest alloc] initWithWrapperPath:wrapperPath user:@"user1" password:@"password1" 
+                                                                   mountRoot:temporaryDirectory]];
+    }
+    
+    NSMutableArray *completedCounts = [NSMutableArray array];
+    PGBulkAttachScheduler *scheduler = [[PGBulkAttachScheduler alloc] init];
+    BOOL succeeded = [scheduler performRequests:requests progressHandler:^(PGBulkAttachRequest *request, NSUInteger completedCount, 
+                                                                           NSUInteger totalCount) {
+        STAssertEquals(totalCount, PGBulkAttachSchedulerTestWrapperCount, @"Wrong total count");
+        [completedCounts addObject:[NSNumber numberWithUnsignedInteger:completedCount]];
+    }];
+    
+    STAssertTrue(succeeded, @"Bulk attach failed");
+    STAssertEquals([completedCounts count], PGBulkAttachSchedulerTestWrapperCount, @"Progress not reported for every request");
+    STAssertEqualObjects([completedCounts lastObject], [NSNumber numberWithUnsignedInteger:PGBulkAttachSchedulerTestWrapperCount], 
+                         @"Progress didn't reach the total");
+    
+    for (PGBulkAttachRequest *request in requests) {
+        STAssertNil([request error], @"Request failed with error: %@", [request error]);
+        STAssertTrue([[request wrapper] isAttached], @"Wrapper not attached");
+        STAssertTrue([[request wrapper] detach:NULL], @"Failed to detach wrapper");
+    }
+}
+
+
+- (void)testFailuresAreIndependent
+{
+    NSMutableArray *requests = [NSMutableArray array];
+    for (NSString *wrapperPath in wrapperPaths) {
+        [requests addObject:[[PGBulkAttachRequest alloc] initWithWrapperPath:wrapperPath user:@"user1" password:@"password1" 
+                                                                   mountRoot:temporaryDirectory]];
+    }
+    
+    PGBulkAttachRequest *wrongPasswordRequest = [[PGBulkAttachRequest alloc] initWithWrapperPath:[wrapperPaths objectAtIndex:0] user:@"user1" 
+                                                                                        password:@"wrongpassword" mountRoot:temporaryDirectory];
+    NSString *missingWrapperPath = [temporaryDirectory stringByAppendingPathComponent:@"missing.edi"];
+    PGBulkAttachRequest *missingWrapperRequest = [[PGBulkAttachRequest alloc] initWithWrapperPath:missingWrapperPath user:@"user1" 
+                                                                                         password:@"password1" mountRoot:temporaryDirectory];
+    [requests replaceObjectAtIndex:0 withObject:wrongPasswordRequest];
+    [requests replaceObjectAtIndex:1 withObject:missingWrapperRequest];
+    
+    PGBulkAttachScheduler *scheduler = [[PGBulkAttachScheduler alloc] init];
+    STAssertFalse([scheduler performRequests:requests progressHandler:nil], @"Bulk attach with bad requests succeeded");
+    
+    STAssertNotNil([wrongPasswordRequest error], @"Request with wrong password succeeded");
+    STAssertNil([wrongPasswordRequest wrapper], @"Wrapper opened with wrong password");
+    STAssertNotNil([missingWrapperRequest error], @"Request for missing wrapper succeeded");
+    
+    for (PGBulkAttachRequest *request in [requests subarrayWithRange:NSMakeRange(2, [requests count] - 2)]) {
+        STAssertNil([request error], @"Request failed with error: %@", [request error]);
+        STAssertTrue([[request wrapper] detach:NULL], @"Failed to detach wrapper");
+    }
+    
+    // Requests that failed to open never ran hdiutil
+    NSString *log = [NSString stringWithContentsOfFile:stubLogPath encoding:NSUTF8StringEncoding error:NULL];
+    NSArray *attachLines = [[log componentsSeparatedByString:@"\n"] filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"SELF == 'attach'"]];
+    STAssertEquals([attachLines count], [requests count] - 2, @"Failed requests were attached");
+}
+
+
+- (void)testPriorityOrder
+{
+    // With one request opened at a time, requests finish strictly in priority order, and in scheduling order among equal priorities
+    NSInteger priorities[] = { 0, 5, -1, 5, 10, 0 };
+    NSMutableArray *requests = [NSMutableArray array];
+    for (NSUInteger i = 0; i < PGBulkAttachSchedulerTestWrapperCount; ++i) {
+        PGBulkAttachRequest *request = [[PGBulkAttachRequest alloc] initWithWrapperPath:[wrapperPaths objectAtIndex:i] user:@"user1" 
+                                                                               password:@"password1" mountRoot:nil];
+        [request setPriority:priorities[i]];
+        [requests addObject:request];
+    }
+    
+    NSMutableArray *finishedRequests = [NSMutableArray array];
+    PGBulkAttachScheduler *scheduler = [[PGBulkAttachScheduler alloc] init];
+    [scheduler setMaximumOpenCount:1];
+    STAssertTrue([scheduler performRequests:requests progressHandler:^(PGBulkAttachRequest *request, NSUInteger completedCount, 
+                                                                       NSUInteger totalCount) {
+        [finishedRequests addObject:request];
+    }], @"Bulk open failed");
+    
+    NSArray *expectedOrder = [NSArray arrayWithObjects:[requests objectAtIndex:4], [requests objectAtIndex:1], [requests objectAtIndex:3], 
+                              [requests objectAtIndex:0], [requests objectAtIndex:5], [requests objectAtIndex:2], nil];
+    STAssertEqualObjects(finishedRequests, expectedOrder, @"Requests didn't finish in priority order");
+    
+    for (PGBulkAttachRequest *request in requests) {
+        STAssertNotNil([request wrapper], @"Wrapper not opened");
+        STAssertFalse([[request wrapper] isAttached], @"Wrapper attached without a mount root");
+    }
+}
+
+
+- (void)testAttachLimit
+{
+    setenv("PGHDIUTIL_STUB_DELAY", "0.5", 1);
+    
+    NSMutableArray *requests = [NSMutableArray array];
+    for (NSString *wrapperPath in wrapperPaths) {
+        [requests addObject:[[PGBulkAttachRequest alloc] initWithWrapperPath:wrapperPath user:@"user1" password:@"password1" 
+                                                                   mountRoot:temporaryDirectory]];
+    }
+    
+    // With two hdiutil tasks at a time, six attaches take at least three rounds of the stub's delay
+    PGBulkAttachScheduler *scheduler = [[PGBulkAttachScheduler alloc] init];
+    [scheduler setMaximumAttachCount:2];
+    
+    NSDate *startDate = [NSDate date];
+    STAssertTrue([scheduler performRequests:requests progressHandler:nil], @"Bulk attach failed");
+    STAssertTrue([[NSDate date] timeIntervalSinceDate:startDate] >= 1.5, @"More hdiutil tasks ran at once than allowed");
+    
+    unsetenv("PGHDIUTIL_STUB_DELAY");
+    for (PGBulkAttachRequest *request in requests) {
+        STAssertTrue([[request wrapper] detach:NULL], @"Failed to detach wrapper");
+    }
+}
+
+@end
@@ -0,0 +1,127 @@
+//
+//  PGCodecTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGCodecTestCase.h"
+
+#import "NSData+Crypto.h"
+#import "NSString+Grouping.h"
+#import "PGCodec.h"
+
+@implementation PGCodecTestCase
+
+- (void)testHexadecimalRoundTrip
+{
+    uint8_t bytes[] = { 0x00, 0x01, 0x7F, 0x80, 0xAB, 0xFF };
+    NSData *data = [NSData dataWithBytes:bytes length:sizeof(bytes)];
+    STAssertEqualObjects([data hexadecimalString], @"00017f80abff", @"Wrong hexadecimal string");
+    STAssertEqualObjects([NSData dataWithHexadecimalString:@"00017F80ABff"], data, @"Wrong data for mixed-case string");
+    STAssertEqualObjects([[NSData data] hexadecimalString], @"", @"Wrong hexadecimal string for empty data");
+    
+    // Lengths on either side of the vector widths exercise both the vector and scalar code
+    for (NSUInteger length = 0; length < 200; ++length) {
+        data = [NSData randomDataOfLength:length];
+        NSString *hexadecimalString = [data hexadecimalString];
+        STAssertEquals([hexadecimalString length], 2 * length, @"Wrong length for %lu bytes", (unsigned long)length);
+        STAssertEqualObjects([NSData dataWithHexadecimalString:hexadecimalString], data, @"Round trip failed for %lu bytes", (unsigned long)length);
+        STAssertEqualObjects([NSData dataWithHexadecimalString:[hexadecimalString uppercaseString]], data, 
+                             @"Uppercase round trip failed for %lu bytes", (unsigned long)length);
+    }
+}
+
+
+- (void)testInvalidHexadecimal
+{
+    STAssertNil([NSData dataWithHexadecimalString:@"abc"], @"Decoded odd-length string");
+    STAssertNil([NSData dataWithHexadecimalString:@"0x12"], @"Decoded string with prefix");
+    STAssertNil([NSData dataWithHexadecimalString:@"12 34"], @"Decoded string with whitespace");
+    STAssertNil([NSData dataWithHexadecimalString:@"12é34"], @"Decoded string with non-ASCII character");
+    
+    // Invalid characters are caught wherever they are, including inside vector-sized chunks
+    NSString *hexadecimalString = [[NSData randomDataOfLength:64] hexadecimalString];
+    for (NSUInteger i = 0; i < [hexadecimalString length]; i += 7) {
+        NSString *invalidString = [hexadecimalString stringByReplacingCharactersInRange:NSMakeRange(i, 1) withString:@"g"];
+        STAssertNil([NSData dataWithHexadecimalString:invalidString], @"Decoded string with invalid character at %lu", (unsigned long)i);
+    }
+}
+
+
+- (void)testBase64Vectors
+{
+    // Test vectors from RFC 4648
+    NSArray *inputs = [NSArray arrayWithObjects:@"", @"f", @"fo", @"foo", @"foob", @"fooba", @"foobar", nil];
+    NSArray *outputs = [NSArray arrayWithObjects:@"", @"Zg==", @"Zm8=", @"Zm9v", @"Zm9vYg==", @"Zm9vYmE=", @"Zm9vYmFy", nil];
+    
+    for (NSUInteger i = 0; i < [inputs count]; ++i) {
+        NSData *data = [[inputs objectAtIndex:i] dataUsingEncoding:NSUTF8StringEncoding];
+        STAssertEqualObjects([data base64String], [outputs objectAtIndex:i], @"Wrong encoding of %@", [inputs objectAtIndex:i]);
+        STAssertEqualObjects([NSData dataWithBase64String:[outputs objectAtIndex:i]], data, @"Wrong decoding of %@", [outputs objectAtIndex:i]);
+    }
+}
+
+
+- (void)testBase64RoundTrip
+{
+    for (NSUInteger length = 0; length < 200; ++length) {
+        NSData *data = [NSData randomDataOfLength:length];
+        NSString *base64String = [data base64String];
+        STAssertEquals([base64String length], (NSUInteger)PGCodecBase64EncodedLength(length), @"Wrong length for %lu bytes", (unsigned long)length);
+        STAssertEqualObjects([NSData dataWithBase64String:base64String], data, @"Round trip failed for %lu bytes", (unsigned long)length);
+    }
+}
+
+
+- (void)testInvalidBase64
+{
+    STAssertNil([NSData dataWithBase64String:@"Zm9"], @"Decoded unpadded string");
+    STAssertNil([NSData dataWithBase64String:@"Zm9v\nYmFy"], @"Decoded string with whitespace");
+    STAssertNil([NSData dataWithBase64String:@"Zg==Zm9v"], @"Decoded string with padding in the middle");
+    STAssertNil([NSData dataWithBase64String:@"Z==="], @"Decoded string with too much padding");
+    STAssertNil([NSData dataWithBase64String:@"Zm-_"], @"Decoded URL-safe alphabet");
+    
+    NSString *base64String = [[NSData randomDataOfLength:96] base64String];
+    for (NSUInteger i = 0; i < [base64String length]; i += 5) {
+        NSString *invalidString = [base64String stringByReplacingCharactersInRange:NSMakeRange(i, 1) withString:@"*"];
+        STAssertNil([NSData dataWithBase64String:invalidString], @"Decoded string with invalid character at %lu", (unsigned long)i);
+    }
+}
+
+
+- (void)testGrouping
+{
+    STAssertEqualObjects([@"abcdefghij" stringByInterposingString:@"-" betweenSubstringsOfLength:3], @"abc-def-ghi-j", @"Wrong grouping");
+    STAssertEqualObjects([@"abcdefghi" stringByInterposingString:@" - " betweenSubstringsOfLength:3], @"abc - def - ghi", @"Wrong even grouping");
+    STAssertEqualObjects([@"abc" stringByInterposingString:@"-" betweenSubstringsOfLength:3], @"abc", @"Single group was separated");
+    STAssertEqualObjects([@"abc" stringByInterposingString:@"-" betweenSubstringsOfLength:4], @"abc", @"Short string was separated");
+    STAssertEqualObjects([@"étéété" stringByInterposingString:@"•" betweenSubstringsOfLength:2], 
+                         @"ét•éé•té", @"Wrong grouping of non-ASCII string");
+    
+    NSString *hexadecimalString = [[NSData randomDataOfLength:1000] hexadecimalString];
+    NSArray *groups = [[hexadecimalString stringByInterposingString:@"-" betweenSubstringsOfLength:5] componentsSeparatedByString:@"-"];
+    STAssertEquals([groups count], (NSUInteger)400, @"Wrong number of groups");
+    STAssertEqualObjects([groups componentsJoinedByString:@""], hexadecimalString, @"Groups don't reconstruct the string");
+}
+
+@end
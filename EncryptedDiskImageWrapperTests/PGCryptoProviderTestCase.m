@@ -0,0 +1,408 @@
+//
+//  PGCryptoProviderTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGCryptoProviderTestCase.h"
+
+#import "NSData+Crypto.h"
+#import "PGCryptoProvider.h"
+
+// Key and plaintext from NIST SP 800-38A, F.2.5 and F.1.5
+static NSString *const PGTestAES256Key = @"603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4";
+static NSString *const PGTestAESInitializationVector = @"000102030405060708090a0b0c0d0e0f";
+static NSString *const PGTestAESPlaintext = @"6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+                                            @"30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710";
+static NSString *const PGTestAESCBCCiphertext = @"f58c4c04d6e5f1ba779eabfb5f7bfbd69cfc4e967edb808d679f777bc6702c7d"
+                                                @"39f23369a9d9bacfa530e26304231461b2eb05e2c39be9fcda6c19078c6a9d1b";
+static NSString *const PGTestAESECBCiphertext = @"f3eed1bdb5d2a03c064b5a7e3db181f8591ccb10d410ed26dc5ba74a31362870"
+                                                @"b6ed21b99ca6f4f9f153e7b1beafed1d23304b7a39f9f3ff067d8d8f9e24ecc7";
+
+// Test case 16 from The Galois/Counter Mode of Operation (GCM), McGrew and Viega
+static NSString *const PGTestGCMKey = @"feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308";
+static NSString *const PGTestGCMNonce = @"cafebabefacedbaddecaf888";
+static NSString *const PGTestGCMPlaintext = @"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+                                            @"1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39";
+static NSString *const PGTestGCMAssociatedData = @"feedfacedeadbeeffeedfacedeadbeefabaddad2";
+static NSString *const PGTestGCMCiphertext = @"522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+                                             @"8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662";
+static NSString *const PGTestGCMTag = @"76fc6ece0f4e1768cddf8853bb2d551b";
+
+
+#pragma mark Private Methods Interface
+
+@interface PGCryptoProviderTestCase ()
+
+/*!
+ @abstract Encrypts or decrypts the specified data with the specified provider, feeding it to the cipher in chunks.
+ 
+ @param provider The provider to use. May not be NULL.
+ @param operation Either PGCryptoEncrypt or PGCryptoDecrypt.
+ @param mode The cipher mode.
+ @param padding Whether to use PKCS #7 padding.
+ @param key The key. May not be nil.
+ @param initializationVector The initialization vector. May be nil in ECB mode.
+ @param input The data to process. May not be nil.
+ @param chunkLength The length of each chunk. Must be positive.
+ 
+ @return The output, or nil if an error occurred.
+ */
+- (NSData *)cryptWithProvider:(const PGCryptoProvider *)provider operation:(PGCryptoOperation)operation mode:(PGCryptoMode)mode 
+                      padding:(BOOL)padding key:(NSData *)key initializationVector:(NSData *)initializationVector input:(NSData *)input 
+                  chunkLength:(NSUInteger)chunkLength;
+
+@end
+
+
+#pragma mark
+
+@implementation PGCryptoProviderTestCase
+
+- (void)tearDown
+{
+    PGCryptoSetDefaultProvider(NULL);
+    [super tearDown];
+}
+
+
+- (NSData *)cryptWithProvider:(const PGCryptoProvider *)provider operation:(PGCryptoOperation)operation mode:(PGCryptoMode)mode 
+                      padding:(BOOL)padding key:(NSData *)key initializationVector:(NSData *)initializationVector input:(NSData *)input 
+                  chunkLength:(NSUInteger)chunkLength
+{
+    PGCryptoCipherRef cipher = NULL;
+    if (provider->cipherCreate(operation, mode, padding, [key bytes], [key length], [initializationVector bytes], &cipher) != PGCryptoSuccess) {
+        return nil;
+    }
+    
+    NSMutableData *output = [NSMutableData data];
+    PGCryptoStatus result = PGCryptoSuccess;
+    for (NSUInteger offset = 0; offset < [input length] && result == PGCryptoSuccess; offset += chunkLength) {
+        NSUInteger length = MIN(chunkLength, [input length] - offset);
+        size_t capacity = provider->cipherOutputLength(cipher, length, false);
+        NSMutableData *chunkOutput = [NSMutableData dataWithLength:capacity];
+        size_t outputLength = 0;
+        result = provider->cipherUpdate(cipher, (const uint8_t *)[input bytes] + offset, length, [chunkOutput mutableBytes], capacity, &outputLength);
+        [output appendBytes:[chunkOutput bytes] length:outputLength];
+    }
+    
+    if (result == PGCryptoSuccess) {
+        size_t capacity = provider->cipherOutputLength(cipher, 0, true);
+        NSMutableData *finalOutput = [NSMutableData dataWithLength:capacity];
+        size_t outputLength = 0;
+        result = provider->cipherFinal(cipher, [finalOutput mutableBytes], capacity, &outputLength);
+        [output appendBytes:[finalOutput bytes] length:outputLength];
+    }
+    
+    provider->cipherRelease(cipher);
+    return result == PGCryptoSuccess ? output : nil;
+}
+
+
+- (void)testDigestVectors
+{
+    size_t providerCount = 0;
+    const PGCryptoProvider *const *providers = PGCryptoAvailableProviders(&providerCount);
+    STAssertTrue(providerCount > 0, @"No providers available");
+    
+    // Digests of "abc" from RFC 1321 and FIPS 180-2
+    NSDictionary *digests = [NSDictionary dictionaryWithObjectsAndKeys:
+                             @"900150983cd24fb0d6963f7d28e17f72", [NSNumber numberWithInt:PGCryptoDigestMD5],
+                             @"a9993e364706816aba3e25717850c26c9cd0d89d", [NSNumber numberWithInt:PGCryptoDigestSHA1],
+                             @"23097d223405d8228642a477bda255b32aadbce4bda0b3f7e36c9da7", [NSNumber numberWithInt:PGCryptoDigestSHA224],
+                             @"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", [NSNumber numberWithInt:PGCryptoDigestSHA256],
+                             @"cb00753f45a35e8bb5a03d699ac65007272c32ab0eded1631a8b605a43ff5bed8086072ba1e7cc2358baeca134c825a7", 
+                             [NSNumber numberWithInt:PGCryptoDigestSHA384],
+                             @"ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a2192992a274fc1a836ba3c23a3feebbd"
+                             @"454d4423643ce80e2a9ac94fa54ca49f", [NSNumber numberWithInt:PGCryptoDigestSHA512], nil];
+    
+    for (size_t i = 0; i < providerCount; ++i) {
+        for (NSNumber *algorithm in digests) {
+            NSMutableData *digest = [NSMutableData dataWithLength:PGCryptoDigestLength([algorithm intValue])];
+            STAssertEquals(providers[i]->digest([algorithm intValue], "abc", 3, [digest mutableBytes]), PGCryptoSuccess, @"%s digest failed", 
+                           providers[i]->name);
+            STAssertEqualObjects([digest hexadecimalString], [digests objectForKey:algorithm], @"Wrong %s digest for algorithm %@", 
+                                 providers[i]->name, algorithm);
+        }
+    }
+}
+
+
+- (void)testHMACVectors
+{
+    size_t providerCount = 0;
+    const PGCryptoProvider *const *providers = PGCryptoAvailableProviders(&providerCount);
+    
+    // Test cases 1 and 2 from RFC 4231
+    NSData *key1 = [NSData dataWithHexadecimalString:@"0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b"];
+    NSData *data1 = [@"Hi There" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *key2 = [@"Jefe" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *data2 = [@"what do ya want for nothing?" dataUsingEncoding:NSUTF8StringEncoding];
+    
+    for (size_t i = 0; i < providerCount; ++i) {
+        NSMutableData *mac = [NSMutableData dataWithLength:PGCryptoHMACSHA256Length];
+        providers[i]->HMACSHA256([key1 bytes], [key1 length], [data1 bytes], [data1 length], [mac mutableBytes]);
+        STAssertEqualObjects([mac hexadecimalString], @"b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7", @"Wrong %s HMAC", 
+                             providers[i]->name);
+        
+        providers[i]->HMACSHA256([key2 bytes], [key2 length], [data2 bytes], [data2 length], [mac mutableBytes]);
+        STAssertEqualObjects([mac hexadecimalString], @"5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843", @"Wrong %s HMAC", 
+                             providers[i]->name);
+    }
+}
+
+
+- (void)testKeyDerivationVectors
+{
+    size_t providerCount = 0;
+    const PGCryptoProvider *const *providers = PGCryptoAvailableProviders(&providerCount);
+    
+    // PBKDF2-HMAC-SHA256 test vector from RFC 7914, section 11
+    NSString *expectedKey = @"55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc"
+                            @"49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783";
+    for (size_t i = 0; i < providerCount; ++i) {
+        NSMutableData *key = [NSMutableData dataWithLength:64];
+        STAssertEquals(providers[i]->deriveKey("passwd", 6, "salt", 4, 1, [key mutableBytes], [key length]), PGCryptoSuccess, 
+                       @"%s key derivation failed", providers[i]->name);
+        STAssertEqualObjects([key hexadecimalString], expectedKey, @"Wrong %s key", providers[i]->name);
+        STAssertTrue(providers[i]->calibrateRounds(8, 24, 32, 10) > 0, @"%s calibrated zero rounds", providers[i]->name);
+    }
+}
+
+
+- (void)testCipherVectors
+{
+    size_t providerCount = 0;
+    const PGCryptoProvider *const *providers = PGCryptoAvailableProviders(&providerCount);
+    
+    NSData *key = [NSData dataWithHexadecimalString:PGTestAES256Key];
+    NSData *initializationVector = [NSData dataWithHexadecimalString:PGTestAESInitializationVector];
+    NSData *plaintext = [NSData dataWithHexadecimalString:PGTestAESPlaintext];
+    NSData *cbcCiphertext = [NSData dataWithHexadecimalString:PGTestAESCBCCiphertext];
+    NSData *ecbCiphertext = [NSData dataWithHexadecimalString:PGTestAESECBCiphertext];
+    
+    for (size_t i = 0; i < providerCount; ++i) {
+        const PGCryptoProvider *provider = providers[i];
+        STAssertEqualObjects([self cryptWithProvider:provider operation:PGCryptoEncrypt mode:PGCryptoModeCBC padding:NO key:key 
+                                initializationVector:initializationVector input:plaintext chunkLength:64], 
+                             cbcCiphertext, @"Wrong %s CBC encryption", provider->name);
+        STAssertEqualObjects([self cryptWithProvider:provider operation:PGCryptoDecrypt mode:PGCryptoModeCBC padding:NO key:key 
+                                initializationVector:initializationVector input:cbcCiphertext chunkLength:64], 
+                             plaintext, @"Wrong %s CBC decryption", provider->name);
+        STAssertEqualObjects([self cryptWithProvider:provider operation:PGCryptoEncrypt mode:PGCryptoModeECB padding:NO key:key 
+                                initializationVector:nil input:plaintext chunkLength:64], 
+                             ecbCiphertext, @"Wrong %s ECB encryption", provider->name);
+        STAssertEqualObjects([self cryptWithProvider:provider operation:PGCryptoDecrypt mode:PGCryptoModeECB padding:NO key:key 
+                                initializationVector:nil input:ecbCiphertext chunkLength:64], 
+                             plaintext, @"Wrong %s ECB decryption", provider->name);
+        
+        // Unpadded input must be a whole number of blocks, and keys must be a valid AES length
+        STAssertNil([self cryptWithProvider:provider operation:PGCryptoEncrypt mode:PGCryptoModeCBC padding:NO key:key 
+                       initializationVector:initializationVector input:[plaintext subdataWithRange:NSMakeRange(0, 20)] chunkLength:64], 
+                    @"%s encrypted a partial block without padding", provider->name);
+        
+        PGCryptoCipherRef cipher = NULL;
+        STAssertEquals(provider->cipherCreate(PGCryptoEncrypt, PGCryptoModeCBC, true, [key bytes], 31, NULL, &cipher), PGCryptoParameterError,
+                       @"%s accepted an invalid key length", provider->name);
+    }
+}
+
+
+- (void)testChunkedCipher
+{
+    size_t providerCount = 0;
+    const PGCryptoProvider *const *providers = PGCryptoAvailableProviders(&providerCount);
+    
+    NSData *key = [NSData dataWithHexadecimalString:PGTestAES256Key];
+    NSData *initializationVector = [NSData dataWithHexadecimalString:PGTestAESInitializationVector];
+    NSData *plaintext = [NSData randomDataOfLength:1000];
+    
+    for (size_t i = 0; i < providerCount; ++i) {
+        const PGCryptoProvider *provider = providers[i];
+        
+        // Padding always adds between one byte and one block, and chunk boundaries don't affect the output
+        for (NSUInteger length = 0; length <= 64; length += 7) {
+            NSData *input = [plaintext subdataWithRange:NSMakeRange(0, length)];
+            NSData *ciphertext = [self cryptWithProvider:provider operation:PGCryptoEncrypt mode:PGCryptoModeCBC padding:YES key:key 
+                                    initializationVector:initializationVector input:input chunkLength:1000];
+            STAssertEquals([ciphertext length], (length / PGCryptoAESBlockSize + 1) * PGCryptoAESBlockSize, @"Wrong %s ciphertext length", 
+                           provider->name);
+            
+            for (NSUInteger chunkLength = 1; chunkLength <= 33; chunkLength += 8) {
+                STAssertEqualObjects([self cryptWithProvider:provider operation:PGCryptoEncrypt mode:PGCryptoModeCBC padding:YES key:key 
+                                        initializationVector:initializationVector input:input chunkLength:chunkLength], 
+                                     ciphertext, @"Wrong %s ciphertext with %lu-byte chunks", provider->name, (unsigned long)chunkLength);
+                STAssertEqualObjects([self cryptWithProvider:provider operation:PGCryptoDecrypt mode:PGCryptoModeCBC padding:YES key:key 
+                                        initializationVector:initializationVector input:ciphertext chunkLength:chunkLength], 
+                                     input, @"Wrong %s plaintext with %lu-byte chunks", provider->name, (unsigned long)chunkLength);
+            }
+        }
+        
+        // Resetting discards buffered input and restarts with the new initialization vector
+        NSData *cbcCiphertext = [NSData dataWithHexadecimalString:PGTestAESCBCCiphertext];
+        NSData *vectorPlaintext = [NSData dataWithHexadecimalString:PGTestAESPlaintext];
+        PGCryptoCipherRef cipher = NULL;
+        provider->cipherCreate(PGCryptoEncrypt, PGCryptoModeCBC, false, [key bytes], [key length], NULL, &cipher);
+        
+        uint8_t output[64];
+        size_t outputLength = 0;
+        STAssertEquals(provider->cipherUpdate(cipher, [vectorPlaintext bytes], 64, output, 63, &outputLength), PGCryptoBufferTooSmallError, 
+                       @"%s wrote past the end of the output buffer", provider->name);
+        provider->cipherUpdate(cipher, [vectorPlaintext bytes], 5, output, sizeof(output), &outputLength);
+        STAssertEquals(provider->cipherReset(cipher, [initializationVector bytes]), PGCryptoSuccess, @"%s reset failed", provider->name);
+        provider->cipherUpdate(cipher, [vectorPlaintext bytes], 64, output, sizeof(output), &outputLength);
+        STAssertEqualObjects([NSData dataWithBytes:output length:outputLength], cbcCiphertext, @"Wrong %s ciphertext after reset", provider->name);
+        provider->cipherRelease(cipher);
+    }
+}
+
+
+- (void)testBadPadding
+{
+    size_t providerCount = 0;
+    const PGCryptoProvider *const *providers = PGCryptoAvailableProviders(&providerCount);
+    
+    NSData *key = [NSData dataWithHexadecimalString:PGTestAES256Key];
+    NSData *initializationVector = [NSData dataWithHexadecimalString:PGTestAESInitializationVector];
+    
+    for (size_t i = 0; i < providerCount; ++i) {
+        const PGCryptoProvider *provider = providers[i];
+        
+        // A block of zeros encrypted without padding decrypts to a final byte of 0, which is never valid padding
+        NSData *cbcCiphertext = [self cryptWithProvider:provider operation:PGCryptoEncrypt mode:PGCryptoModeCBC padding:NO key:key 
+                                   initializationVector:initializationVector input:[NSMutableData dataWithLength:32] chunkLength:32];
+        PGCryptoCipherRef cipher = NULL;
+        provider->cipherCreate(PGCryptoDecrypt, PGCryptoModeCBC, true, [key bytes], [key length], [initializationVector bytes], &cipher);
+        
+        uint8_t output[128];
+        size_t outputLength = 0;
+        provider->cipherUpdate(cipher, [cbcCiphertext bytes], [cbcCiphertext length], output, sizeof(output), &outputLength);
+        STAssertEquals(provider->cipherFinal(cipher, output + outputLength, sizeof(output) - outputLength, &outputLength), PGCryptoDecodeError,
+                       @"%s accepted bad padding", provider->name);
+        provider->cipherRelease(cipher);
+    }
+}
+
+
+- (void)testGCMVectors
+{
+    size_t providerCount = 0;
+    const PGCryptoProvider *const *providers = PGCryptoAvailableProviders(&providerCount);
+    
+    NSData *key = [NSData dataWithHexadecimalString:PGTestGCMKey];
+    NSData *nonce = [NSData dataWithHexadecimalString:PGTestGCMNonce];
+    NSData *plaintext = [NSData dataWithHexadecimalString:PGTestGCMPlaintext];
+    NSData *associatedData = [NSData dataWithHexadecimalString:PGTestGCMAssociatedData];
+    NSData *ciphertext = [NSData dataWithHexadecimalString:PGTestGCMCiphertext];
+    NSData *tag = [NSData dataWithHexadecimalString:PGTestGCMTag];
+    
+    for (size_t i = 0; i < providerCount; ++i) {
+        const PGCryptoProvider *provider = providers[i];
+        
+        uint8_t output[64];
+        uint8_t outputTag[PGCryptoAESGCMTagLength];
+        PGCryptoStatus status = provider->GCMSeal([key bytes], [key length], [nonce bytes], [associatedData bytes], [associatedData length], 
+                                                  [plaintext bytes], [plaintext length], output, outputTag);
+        
+        // The CommonCrypto provider doesn't support GCM
+        if (status == PGCryptoUnimplementedError) continue;
+        
+        STAssertEquals(status, PGCryptoSuccess, @"%s GCM encryption failed", provider->name);
+        STAssertEqualObjects([NSData dataWithBytes:output length:[plaintext length]], ciphertext, @"Wrong %s GCM ciphertext", provider->name);
+        STAssertEqualObjects([NSData dataWithBytes:outputTag length:sizeof(outputTag)], tag, @"Wrong %s GCM tag", provider->name);
+        
+        STAssertEquals(provider->GCMOpen([key bytes], [key length], [nonce bytes], [associatedData bytes], [associatedData length], 
+                                         [ciphertext bytes], [ciphertext length], [tag bytes], output), PGCryptoSuccess, 
+                       @"%s GCM decryption failed", provider->name);
+        STAssertEqualObjects([NSData dataWithBytes:output length:[ciphertext length]], plaintext, @"Wrong %s GCM plaintext", provider->name);
+        
+        // Changing a single bit of the ciphertext or associated data must fail authentication and must not release any plaintext
+        NSMutableData *tamperedCiphertext = [ciphertext mutableCopy];
+        ((uint8_t *)[tamperedCiphertext mutableBytes])[7] ^= 0x01;
+        STAssertEquals(provider->GCMOpen([key bytes], [key length], [nonce bytes], [associatedData bytes], [associatedData length], 
+                                         [tamperedCiphertext bytes], [tamperedCiphertext length], [tag bytes], output), PGCryptoDecodeError, 
+                       @"%s accepted tampered ciphertext", provider->name);
+        STAssertEqualObjects([NSData dataWithBytes:output length:[ciphertext length]], [NSMutableData dataWithLength:[ciphertext length]], 
+                             @"%s released unauthenticated plaintext", provider->name);
+        
+        NSMutableData *tamperedAssociatedData = [associatedData mutableCopy];
+        ((uint8_t *)[tamperedAssociatedData mutableBytes])[0] ^= 0x80;
+        STAssertEquals(provider->GCMOpen([key bytes], [key length], [nonce bytes], [tamperedAssociatedData bytes], [tamperedAssociatedData length], 
+                                         [ciphertext bytes], [ciphertext length], [tag bytes], output), PGCryptoDecodeError, 
+                       @"%s accepted tampered associated data", provider->name);
+    }
+}
+
+
+- (void)testProvidersInteroperate
+{
+    size_t providerCount = 0;
+    const PGCryptoProvider *const *providers = PGCryptoAvailableProviders(&providerCount);
+    if (providerCount < 2) {
+        NSLog(@"Skipping %@: only the %s provider was compiled in; define PGCRYPTO_OPENSSL=1 to build both", NSStringFromSelector(_cmd), 
+              providers[0]->name);
+        return;
+    }
+    
+    
+    // Data encrypted through NSData (Crypto) with each provider can be decrypted with every other
+    NSData *plaintext = [NSData randomDataOfLength:4099];
+    NSNumber *rounds = [NSNumber numberWithUnsignedInt:1000];
+    for (size_t i = 0; i < providerCount; ++i) {
+        PGCryptoSetDefaultProvider(providers[i]);
+        
+        NSData *salt = nil;
+        NSNumber *encryptionRounds = rounds;
+        NSData *initializationVector = nil;
+        NSError *error = nil;
+        NSData *ciphertext = [plaintext encryptedDataWithPassword:@"password" salt:&salt rounds:&encryptionRounds 
+                                             initializationVector:&initializationVector error:&error];
+        STAssertNotNil(ciphertext, @"%s encryption failed: %@", providers[i]->name, error);
+        STAssertEqualObjects(encryptionRounds, rounds, @"Rounds changed");
+        
+        for (size_t j = 0; j < providerCount; ++j) {
+            PGCryptoSetDefaultProvider(providers[j]);
+            STAssertEqualObjects([ciphertext decryptedDataWithPassword:@"password" salt:salt rounds:rounds initializationVector:initializationVector 
+                                                                 error:&error], 
+                                 plaintext, @"%s could not decrypt %s ciphertext: %@", providers[j]->name, providers[i]->name, error);
+        }
+    }
+}
+
+
+- (void)testDefaultProvider
+{
+    size_t providerCount = 0;
+    const PGCryptoProvider *const *providers = PGCryptoAvailableProviders(&providerCount);
+    const PGCryptoProvider *defaultProvider = PGCryptoDefaultProvider();
+    STAssertTrue(defaultProvider != NULL, @"No default provider");
+    STAssertTrue(defaultProvider == (PGCryptoCommonCryptoProvider() ? PGCryptoCommonCryptoProvider() : PGCryptoOpenSSLProvider()), 
+                 @"Wrong default provider");
+    
+    PGCryptoSetDefaultProvider(providers[providerCount - 1]);
+    STAssertTrue(PGCryptoDefaultProvider() == providers[providerCount - 1], @"Default provider not set");
+    PGCryptoSetDefaultProvider(NULL);
+    STAssertTrue(PGCryptoDefaultProvider() == defaultProvider, @"Default provider not restored");
+}
+
+@end
@@ -0,0 +1,513 @@
+//
+//  PGDataCryptoTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGDataCryptoTestCase.h"
+
+#import "NSData+Crypto.h"
+#import "NSFileManager+TemporaryFiles.h"
+#import "PGCryptoProvider.h"
+#import "PGScrypt.h"
+
+/*!
+ @abstract Decrypts the specified stream ciphertext with a stream cryptor, feeding it in one piece.
+ @return The plaintext, or nil if decryption failed.
+ */
+static NSData *PGDataCryptoTestDecryptStream(NSData *ciphertext, NSData *salt, NSNumber *rounds, NSData *iv, NSError **errorOut)
+{
+    PGStreamCryptor *decryptor = [[PGStreamCryptor alloc] initForDecryptionWithPassword:@"password" salt:salt rounds:rounds 
+                                                                   initializationVector:iv error:errorOut];
+    NSMutableData *plaintext = [[decryptor updateWithData:ciphertext error:errorOut] mutableCopy];
+    NSData *finalPlaintext = plaintext ? [decryptor finish:errorOut] : nil;
+    if (!finalPlaintext) return nil;
+    
+    [plaintext appendData:finalPlaintext];
+    return plaintext;
+}
+
+
+@implementation PGDataCryptoTestCase
+
+- (void)setUp
+{
+    [super setUp];
+    temporaryDirectory = [[NSFileManager defaultManager] createTemporaryDirectoryWithTemplate:@"PGDataCryptoTestCase.XXXXXX" error:NULL];
+}
+
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:temporaryDirectory error:NULL];
+    [super tearDown];
+}
+
+
+- (void)testStreamCryptorMatchesOneShotEncryption
+{
+    NSError *error = nil;
+    NSData *plaintext = [NSData randomDataOfLength:100003];
+    
+    NSData *salt = nil;
+    NSNumber *rounds = nil;
+    NSData *iv = nil;
+    PGStreamCryptor *encryptor = [[PGStreamCryptor alloc] initForEncryptionWithPassword:@"password" algorithm:PGAES256CBCEncryptionAlgorithm 
+                                                                                   salt:&salt rounds:&rounds initializationVector:&iv error:&error];
+    STAssertNotNil(encryptor, @"Failed to create encryptor with error: %@", error);
+    
+    // Feed the plaintext in uneven chunks
+    NSMutableData *ciphertext = [NSMutableData data];
+    NSUInteger chunkLength = 1;
+    for (NSUInteger offset = 0; offset < [plaintext length]; offset += chunkLength, chunkLength = chunkLength * 3 + 1) {
+        NSRange range = NSMakeRange(offset, MIN(chunkLength, [plaintext length] - offset));
+        [ciphertext appendData:[encryptor updateWithData:[plaintext subdataWithRange:range] error:&error]];
+    }
+    
+    [ciphertext appendData:[encryptor finish:&error]];
+
+    // The streamed ciphertext must be decryptable with the one-shot method
+    NSData *decryptedData = [ciphertext decryptedDataWithPassword:@"password" salt:salt rounds:rounds initializationVector:iv error:&error];
+    STAssertEqualObjects(decryptedData, plaintext, @"Streamed ciphertext did not decrypt to the original plaintext: %@", error);
+}
+
+
+- (void)testFileDescriptorRoundTrip
+{
+    NSError *error = nil;
+    NSString *plaintextPath = [temporaryDirectory stringByAppendingPathComponent:@"plaintext"];
+    NSString *ciphertextPath = [temporaryDirectory stringByAppendingPathComponent:@"ciphertext"];
+    NSString *decryptedPath = [temporaryDirectory stringByAppendingPathComponent:@"decrypted"];
+    
+    // Use enough data to wrap around the buffer ring several times, and a length that isn't a multiple of the block size
+    NSData *plaintext = [NSData randomDataOfLength:5 * 1024 * 1024 + 7];
+    STAssertTrue([plaintext writeToFile:plaintextPath atomically:NO], @"Failed to write plaintext");
+
+    NSData *salt = nil;
+    NSNumber *rounds = nil;
+    NSData *iv = nil;
+    STAssertTrue([NSData encryptFileAtPath:plaintextPath toPath:ciphertextPath password:@"password" salt:&salt rounds:&rounds 
+                      initializationVector:&iv error:&error], @"Encryption failed with error: %@", error);
+    STAssertTrue([NSData decryptFileAtPath:ciphertextPath toPath:decryptedPath password:@"password" salt:salt rounds:rounds 
+                      initializationVector:iv error:&error], @"Decryption failed with error: %@", error);
+    
+    STAssertEqualObjects([NSData dataWithContentsOfFile:decryptedPath], plaintext, @"Round trip did not preserve the plaintext");
+    
+    // Empty input must round trip too
+    [[NSData data] writeToFile:plaintextPath atomically:NO];
+    STAssertTrue([NSData encryptFileAtPath:plaintextPath toPath:ciphertextPath password:@"password" salt:&salt rounds:&rounds 
+                      initializationVector:&iv error:&error], @"Encryption of empty file failed with error: %@", error);
+    STAssertTrue([NSData decryptFileAtPath:ciphertextPath toPath:decryptedPath password:@"password" salt:salt rounds:rounds 
+                      initializationVector:iv error:&error], @"Decryption of empty file failed with error: %@", error);
+    STAssertEquals([[NSData dataWithContentsOfFile:decryptedPath] length], (NSUInteger)0, @"Empty file did not round trip");
+}
+
+
+- (void)testFileDescriptorDecryptionWithWrongPassword
+{
+    NSError *error = nil;
+    NSString *plaintextPath = [temporaryDirectory stringByAppendingPathComponent:@"plaintext"];
+    NSString *ciphertextPath = [temporaryDirectory stringByAppendingPathComponent:@"ciphertext"];
+    NSString *decryptedPath = [temporaryDirectory stringByAppendingPathComponent:@"decrypted"];
+    
+    [[NSData randomDataOfLength:4096] writeToFile:plaintextPath atomically:NO];
+    
+    NSData *salt = nil;
+    NSNumber *rounds = nil;
+    NSData *iv = nil;
+    [NSData encryptFileAtPath:plaintextPath toPath:ciphertextPath password:@"password" salt:&salt rounds:&rounds initializationVector:&iv error:&error];
+    
+    STAssertFalse([NSData decryptFileAtPath:ciphertextPath toPath:decryptedPath password:@"wrongpassword" salt:salt rounds:rounds 
+                       initializationVector:iv error:&error], @"Decryption with wrong password succeeded");
+    STAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:decryptedPath], @"Failed decryption left its output file behind");
+}
+
+
+- (void)testGCMStreamRoundTrip
+{
+    if (![NSData isEncryptionAlgorithmAvailable:PGAES256GCMEncryptionAlgorithm]) {
+        STFail(@"AES-GCM is unavailable, so GCM streams can't be tested");
+        return;
+    }
+    
+    // Lengths around the 64 KB chunk size, including exact multiples, whose last chunk is full, and empty streams, whose only chunk is empty
+    NSUInteger chunkSize = 64 * 1024;
+    NSUInteger lengths[] = { 0, 1, chunkSize - 1, chunkSize, chunkSize + 1, 3 * chunkSize, 3 * chunkSize + 12345 };
+    for (NSUInteger i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i) {
+        NSError *error = nil;
+        NSData *plaintext = [NSData randomDataOfLength:lengths[i]];
+        NSData *salt = nil;
+        NSNumber *rounds = nil;
+        NSData *iv = nil;
+        PGStreamCryptor *encryptor = [[PGStreamCryptor alloc] initForEncryptionWithPassword:@"password" salt:&salt rounds:&rounds 
+                                                                       initializationVector:&iv error:&error];
+        STAssertNotNil(encryptor, @"Failed to create encryptor with error: %@", error);
+        STAssertEquals([iv length], (NSUInteger)12, @"Wrong initialization vector length");
+        
+        // Feed the plaintext in uneven pieces
+        NSMutableData *ciphertext = [NSMutableData data];
+        NSUInteger pieceLength = 1;
+        for (NSUInteger offset = 0; offset < [plaintext length]; offset += pieceLength, pieceLength = pieceLength * 3 + 1) {
+            NSRange range = NSMakeRange(offset, MIN(pieceLength, [plaintext length] - offset));
+            [ciphertext appendData:[encryptor updateWithData:[plaintext subdataWithRange:range] error:&error]];
+        }
+        
+        [ciphertext appendData:[encryptor finish:&error]];
+        
+        // Every chunk, including the last, carries a 16-byte tag
+        NSUInteger chunkCount = [plaintext length] == 0 ? 1 : ([plaintext length] + chunkSize - 1) / chunkSize;
+        STAssertEquals([ciphertext length], [plaintext length] + chunkCount * 16, @"Wrong ciphertext length for %lu bytes", 
+                       (unsigned long)lengths[i]);
+        STAssertEqualObjects(PGDataCryptoTestDecryptStream(ciphertext, salt, rounds, iv, &error), plaintext, 
+                             @"Stream of %lu bytes did not round trip: %@", (unsigned long)lengths[i], error);
+    }
+}
+
+
+- (void)testGCMStreamDetectsTampering
+{
+    if (![NSData isEncryptionAlgorithmAvailable:PGAES256GCMEncryptionAlgorithm]) {
+        STFail(@"AES-GCM is unavailable, so GCM streams can't be tested");
+        return;
+    }
+    
+    NSError *error = nil;
+    NSUInteger encryptedChunkSize = 64 * 1024 + 16;
+    NSData *salt = nil;
+    NSNumber *rounds = nil;
+    NSData *iv = nil;
+    PGStreamCryptor *encryptor = [[PGStreamCryptor alloc] initForEncryptionWithPassword:@"password" salt:&salt rounds:&rounds 
+                                                                   initializationVector:&iv error:&error];
+    NSMutableData *ciphertext = [[encryptor updateWithData:[NSData randomDataOfLength:3 * 64 * 1024 + 100] error:&error] mutableCopy];
+    [ciphertext appendData:[encryptor finish:&error]];
+    STAssertNotNil(PGDataCryptoTestDecryptStream(ciphertext, salt, rounds, iv, &error), @"Untampered stream failed with error: %@", error);
+    
+    // A flipped bit
+    NSMutableData *tamperedCiphertext = [ciphertext mutableCopy];
+    ((uint8_t *)[tamperedCiphertext mutableBytes])[encryptedChunkSize + 100] ^= 0x01;
+    error = nil;
+    STAssertNil(PGDataCryptoTestDecryptStream(tamperedCiphertext, salt, rounds, iv, &error), @"Decrypted modified stream");
+    STAssertEqualObjects([error domain], PGCommonCryptoErrorDomain, @"Wrong error domain");
+    STAssertEquals([error code], (NSInteger)PGCryptoDecodeError, @"Wrong error code");
+    
+    // Truncation at a chunk boundary, which leaves only whole chunks
+    NSData *truncatedCiphertext = [ciphertext subdataWithRange:NSMakeRange(0, 2 * encryptedChunkSize)];
+    STAssertNil(PGDataCryptoTestDecryptStream(truncatedCiphertext, salt, rounds, iv, &error), @"Decrypted truncated stream");
+    STAssertNil(PGDataCryptoTestDecryptStream([NSData data], salt, rounds, iv, &error), @"Decrypted empty stream");
+    
+    // Reordered chunks
+    NSMutableData *reorderedCiphertext = [ciphertext mutableCopy];
+    [reorderedCiphertext replaceBytesInRange:NSMakeRange(0, encryptedChunkSize) 
+                                   withBytes:(const uint8_t *)[ciphertext bytes] + encryptedChunkSize];
+    [reorderedCiphertext replaceBytesInRange:NSMakeRange(encryptedChunkSize, encryptedChunkSize) withBytes:[ciphertext bytes]];
+    STAssertNil(PGDataCryptoTestDecryptStream(reorderedCiphertext, salt, rounds, iv, &error), @"Decrypted reordered stream");
+    
+    // Data appended after the last chunk
+    NSMutableData *extendedCiphertext = [ciphertext mutableCopy];
+    [extendedCiphertext appendData:[NSData randomDataOfLength:100]];
+    STAssertNil(PGDataCryptoTestDecryptStream(extendedCiphertext, salt, rounds, iv, &error), @"Decrypted extended stream");
+}
+
+
+- (void)testAuthenticatedEncryptionRoundTrip
+{
+    NSError *error = nil;
+    if (![NSData isEncryptionAlgorithmAvailable:PGAES256GCMEncryptionAlgorithm]) {
+        STFail(@"AES-GCM is unavailable, so authenticated encryption can't be tested");
+        return;
+    }
+    
+    NSData *plaintext = [NSData randomDataOfLength:1000];
+    NSData *associatedData = [@"user" dataUsingEncoding:NSUTF8StringEncoding];
+    
+    NSData *salt = nil;
+    NSNumber *rounds = nil;
+    NSData *iv = nil;
+    NSData *ciphertext = [plaintext encryptedDataWithPassword:@"password" algorithm:PGAES256GCMEncryptionAlgorithm associatedData:associatedData 
+                                                         salt:&salt rounds:&rounds initializationVector:&iv error:&error];
+    STAssertNotNil(ciphertext, @"Encryption failed with error: %@", error);
+    STAssertEquals([ciphertext length], [plaintext length] + PGCryptoAESGCMTagLength, @"Wrong ciphertext length");
+    STAssertEquals([iv length], (NSUInteger)PGCryptoAESGCMNonceLength, @"Wrong nonce length");
+    
+    NSData *decryptedData = [ciphertext decryptedDataWithPassword:@"password" algorithm:PGAES256GCMEncryptionAlgorithm associatedData:associatedData
+                                                             salt:salt rounds:rounds initializationVector:iv error:&error];
+    STAssertEqualObjects(decryptedData, plaintext, @"Round trip did not preserve the plaintext: %@", error);
+    
+    // Empty plaintext still carries a tag
+    NSData *key = [NSData randomSymmetricKey];
+    NSData *emptyCiphertext = [[NSData data] encryptedDataWithSymmetricKey:key algorithm:PGAES256GCMEncryptionAlgorithm associatedData:nil 
+                                                      initializationVector:&iv error:&error];
+    STAssertEquals([emptyCiphertext length], (NSUInteger)PGCryptoAESGCMTagLength, @"Wrong ciphertext length for empty plaintext");
+    STAssertEqualObjects([emptyCiphertext decryptedDataWithSymmetricKey:key algorithm:PGAES256GCMEncryptionAlgorithm associatedData:nil 
+                                                   initializationVector:iv error:&error], 
+                         [NSData data], @"Empty plaintext did not round trip: %@", error);
+}
+
+
+- (void)testAuthenticatedDecryptionFailures
+{
+    NSError *error = nil;
+    if (![NSData isEncryptionAlgorithmAvailable:PGAES256GCMEncryptionAlgorithm]) {
+        STFail(@"AES-GCM is unavailable, so authenticated decryption failures can't be tested");
+        return;
+    }
+    
+    NSData *plaintext = [NSData randomDataOfLength:100];
+    NSData *associatedData = [@"user" dataUsingEncoding:NSUTF8StringEncoding];
+    
+    NSData *salt = nil;
+    NSNumber *rounds = [NSNumber numberWithUnsignedInt:1000];
+    NSData *iv = nil;
+    NSData *ciphertext = [plaintext encryptedDataWithPassword:@"password" algorithm:PGAES256GCMEncryptionAlgorithm associatedData:associatedData 
+                                                         salt:&salt rounds:&rounds initializationVector:&iv error:&error];
+    
+    // Unlike CBC, a wrong password always fails rather than sometimes producing garbage
+    error = nil;
+    STAssertNil([ciphertext decryptedDataWithPassword:@"wrongpassword" algorithm:PGAES256GCMEncryptionAlgorithm associatedData:associatedData 
+                                                 salt:salt rounds:rounds initializationVector:iv error:&error], 
+                @"Decryption with wrong password succeeded");
+    STAssertEquals([error code], (NSInteger)PGCryptoDecodeError, @"Wrong error for wrong password: %@", error);
+    
+    STAssertNil([ciphertext decryptedDataWithPassword:@"password" algorithm:PGAES256GCMEncryptionAlgorithm 
+                                       associatedData:[@"other" dataUsingEncoding:NSUTF8StringEncoding] salt:salt rounds:rounds 
+                                 initializationVector:iv error:&error], 
+                @"Decryption with wrong associated data succeeded");
+    
+    NSMutableData *tamperedCiphertext = [ciphertext mutableCopy];
+    ((uint8_t *)[tamperedCiphertext mutableBytes])[[tamperedCiphertext length] - 1] ^= 0x01;
+    STAssertNil([tamperedCiphertext decryptedDataWithPassword:@"password" algorithm:PGAES256GCMEncryptionAlgorithm associatedData:associatedData 
+                                                         salt:salt rounds:rounds initializationVector:iv error:&error], 
+                @"Decryption of tampered ciphertext succeeded");
+    
+    STAssertNil([[ciphertext subdataWithRange:NSMakeRange(0, PGCryptoAESGCMTagLength - 1)] 
+                 decryptedDataWithPassword:@"password" algorithm:PGAES256GCMEncryptionAlgorithm associatedData:associatedData salt:salt 
+                 rounds:rounds initializationVector:iv error:&error], 
+                @"Decryption of truncated ciphertext succeeded");
+}
+
+
+- (void)testCBCAlgorithmMatchesLegacyMethods
+{
+    NSError *error = nil;
+    NSData *plaintext = [NSData randomDataOfLength:1000];
+    
+    NSData *salt = nil;
+    NSNumber *rounds = [NSNumber numberWithUnsignedInt:1000];
+    NSData *iv = nil;
+    NSData *ciphertext = [plaintext encryptedDataWithPassword:@"password" salt:&salt rounds:&rounds initializationVector:&iv error:&error];
+    
+    // Data encrypted before algorithms existed must decrypt with the CBC algorithm
+    NSData *decryptedData = [ciphertext decryptedDataWithPassword:@"password" algorithm:PGAES256CBCEncryptionAlgorithm associatedData:nil 
+                                                             salt:salt rounds:rounds initializationVector:iv error:&error];
+    STAssertEqualObjects(decryptedData, plaintext, @"CBC algorithm could not decrypt legacy ciphertext: %@", error);
+}
+
+
+- (void)testBufferDigestsMatchDataDigests
+{
+    NSData *data = [NSData randomDataOfLength:1000];
+    uint8_t digest[64];  // Large enough for any supported digest
+    
+    [data getDigest:digest usingAlgorithm:PGCryptoDigestSHA256];
+    STAssertEqualObjects([NSData dataWithBytes:digest length:PGCryptoDigestLength(PGCryptoDigestSHA256)], [data SHA256Digest], 
+                         @"Buffer SHA-256 digest doesn't match");
+    [data getDigest:digest usingAlgorithm:PGCryptoDigestSHA512];
+    STAssertEqualObjects([NSData dataWithBytes:digest length:PGCryptoDigestLength(PGCryptoDigestSHA512)], [data SHA512Digest], 
+                         @"Buffer SHA-512 digest doesn't match");
+    
+    NSData *key = [NSData randomSymmetricKey];
+    [data getHMACSHA256Digest:digest withKeyBytes:[key bytes] length:[key length]];
+    STAssertEqualObjects([NSData dataWithBytes:digest length:PGCryptoDigestLength(PGCryptoDigestSHA256)], [data HMACSHA256DigestWithKey:key], 
+                         @"Buffer HMAC doesn't match");
+}
+
+
+- (void)testBufferEncryptionMatchesDataEncryption
+{
+    NSError *error = nil;
+    NSData *plaintext = [NSData randomDataOfLength:1000];
+    
+    NSData *salt = nil;
+    NSNumber *rounds = [NSNumber numberWithUnsignedInt:1000];
+    NSData *iv = nil;
+    NSData *ciphertext = [plaintext encryptedDataWithPassword:@"password" salt:&salt rounds:&rounds initializationVector:&iv error:&error];
+    
+    // A key derived into a buffer decrypts what the password methods encrypted
+    uint8_t key[PGSymmetricKeyLength];
+    STAssertTrue([NSData getSymmetricKey:key forPassword:@"password" salt:salt rounds:rounds error:&error], @"Key derivation failed: %@", error);
+    
+    NSMutableData *buffer = [NSMutableData dataWithLength:[ciphertext length]];
+    size_t length = 0;
+    STAssertTrue([ciphertext getDecryptedBytes:[buffer mutableBytes] capacity:[buffer length] length:&length symmetricKey:key keyLength:sizeof(key)
+                                     algorithm:PGAES256CBCEncryptionAlgorithm associatedData:nil initializationVector:[iv bytes] error:&error], 
+                 @"Buffer decryption failed: %@", error);
+    STAssertEqualObjects([buffer subdataWithRange:NSMakeRange(0, length)], plaintext, @"Buffer decryption didn't preserve the plaintext");
+    
+    // Buffer encryption produces exactly what the data methods would with the same initialization vector
+    NSData *keyData = [NSData dataWithBytes:key length:sizeof(key)];
+    NSArray *algorithms = [NSArray arrayWithObjects:[NSNumber numberWithInt:PGAES256CBCEncryptionAlgorithm], 
+                           [NSNumber numberWithInt:PGAES256GCMEncryptionAlgorithm], nil];
+    for (NSNumber *algorithmNumber in algorithms) {
+        PGEncryptionAlgorithm algorithm = [algorithmNumber intValue];
+        if (![NSData isEncryptionAlgorithmAvailable:algorithm]) {
+            STFail(@"Algorithm %d is unavailable, so it can't be tested", algorithm);
+            continue;
+        }
+        
+        NSData *associatedData = algorithm == PGAES256GCMEncryptionAlgorithm ? [@"user" dataUsingEncoding:NSUTF8StringEncoding] : nil;
+        NSData *dataCiphertext = [plaintext encryptedDataWithSymmetricKey:keyData algorithm:algorithm associatedData:associatedData 
+                                                     initializationVector:&iv error:&error];
+        STAssertEquals([iv length], [NSData initializationVectorLengthForAlgorithm:algorithm], @"Wrong initialization vector length");
+        STAssertEquals([dataCiphertext length], [NSData encryptedLengthForLength:[plaintext length] algorithm:algorithm], 
+                       @"Wrong encrypted length for algorithm %d", algorithm);
+        
+        buffer = [NSMutableData dataWithLength:[NSData encryptedLengthForLength:[plaintext length] algorithm:algorithm]];
+        STAssertTrue([plaintext getEncryptedBytes:[buffer mutableBytes] capacity:[buffer length] length:&length symmetricKey:key 
+                                        keyLength:sizeof(key) algorithm:algorithm associatedData:associatedData initializationVector:[iv bytes]
+                                            error:&error], 
+                     @"Buffer encryption failed for algorithm %d: %@", algorithm, error);
+        STAssertEqualObjects([buffer subdataWithRange:NSMakeRange(0, length)], dataCiphertext, @"Buffer ciphertext doesn't match for algorithm %d", 
+                             algorithm);
+    }
+}
+
+
+- (void)testBufferEncryptionErrors
+{
+    NSError *error = nil;
+    NSData *plaintext = [NSData randomDataOfLength:100];
+    uint8_t key[PGSymmetricKeyLength];
+    uint8_t iv[PGCryptoAESBlockSize];
+    [NSData getRandomBytes:key length:sizeof(key)];
+    [NSData getRandomBytes:iv length:sizeof(iv)];
+    
+    uint8_t buffer[200];
+    size_t length = 0;
+    STAssertFalse([plaintext getEncryptedBytes:buffer capacity:[plaintext length] length:&length symmetricKey:key keyLength:sizeof(key) 
+                                     algorithm:PGAES256CBCEncryptionAlgorithm associatedData:nil initializationVector:iv error:&error], 
+                  @"Encryption into a buffer without room for padding succeeded");
+    STAssertEquals([error code], (NSInteger)PGCryptoBufferTooSmallError, @"Wrong error for small buffer: %@", error);
+    STAssertEquals(length, (size_t)0, @"Wrong length after failure");
+    
+    STAssertTrue([plaintext getEncryptedBytes:buffer capacity:sizeof(buffer) length:&length symmetricKey:key keyLength:sizeof(key) 
+                                    algorithm:PGAES256CBCEncryptionAlgorithm associatedData:nil initializationVector:iv error:&error], 
+                 @"Encryption failed: %@", error);
+    
+    NSData *ciphertext = [NSData dataWithBytes:buffer length:length];
+    error = nil;
+    STAssertFalse([ciphertext getDecryptedBytes:buffer capacity:[plaintext length] / 2 length:&length symmetricKey:key keyLength:sizeof(key) 
+                                      algorithm:PGAES256CBCEncryptionAlgorithm associatedData:nil initializationVector:iv error:&error], 
+                  @"Decryption into a buffer that's too small succeeded");
+    STAssertEquals([error code], (NSInteger)PGCryptoBufferTooSmallError, @"Wrong error for small buffer: %@", error);
+}
+
+
+- (void)testScryptKeyDerivation
+{
+    NSError *error = nil;
+    NSData *plaintext = [NSData randomDataOfLength:100];
+    NSString *password = @"pässword";
+    
+    // Small explicit parameters keep the test fast. They're left as they are rather than calibrated.
+    PGKeyDerivationParameters parameters = { PGScryptKeyDerivationAlgorithm, 1024, PGScryptDefaultBlockSize, 2 };
+    NSData *salt = nil;
+    NSData *iv = nil;
+    NSData *ciphertext = [plaintext encryptedDataWithPassword:password algorithm:PGAES256CBCEncryptionAlgorithm associatedData:nil 
+                                      keyDerivationParameters:&parameters salt:&salt initializationVector:&iv error:&error];
+    STAssertNotNil(ciphertext, @"scrypt encryption failed: %@", error);
+    STAssertEquals(parameters.rounds, (uint32_t)1024, @"Explicit parameters were changed");
+    STAssertEquals([salt length], (NSUInteger)PGKeyDerivationSaltLength, @"Wrong salt length");
+    
+    STAssertEqualObjects([ciphertext decryptedDataWithPassword:password algorithm:PGAES256CBCEncryptionAlgorithm associatedData:nil 
+                                       keyDerivationParameters:parameters salt:salt initializationVector:iv error:&error], plaintext, 
+                         @"scrypt decryption failed: %@", error);
+    
+    // The key is scrypt of the password's UTF-8 bytes
+    const char *passwordBytes = [password UTF8String];
+    uint8_t expectedKey[PGSymmetricKeyLength];
+    uint8_t key[PGSymmetricKeyLength];
+    PGScryptDeriveKey(passwordBytes, strlen(passwordBytes), [salt bytes], [salt length], parameters.rounds, parameters.blockSize, 
+                      parameters.lanes, expectedKey, sizeof(expectedKey));
+    STAssertTrue([NSData getSymmetricKey:key forPassword:password salt:salt keyDerivationParameters:parameters error:&error], 
+                 @"Key derivation failed: %@", error);
+    STAssertTrue(memcmp(key, expectedKey, sizeof(key)) == 0, @"Derived key isn't scrypt of the password");
+    
+    // Every parameter is part of the key
+    PGKeyDerivationParameters otherLanes = parameters;
+    otherLanes.lanes = 3;
+    NSData *decryptedData = [ciphertext decryptedDataWithPassword:password algorithm:PGAES256CBCEncryptionAlgorithm associatedData:nil 
+                                          keyDerivationParameters:otherLanes salt:salt initializationVector:iv error:&error];
+    STAssertFalse([decryptedData isEqualToData:plaintext], @"Decrypted with the wrong number of lanes");
+    
+    // Parameters that need too much memory fail without trying
+    PGKeyDerivationParameters tooLarge = { PGScryptKeyDerivationAlgorithm, 1 << 30, PGScryptDefaultBlockSize, 64 };
+    error = nil;
+    STAssertFalse([NSData getSymmetricKey:key forPassword:password salt:salt keyDerivationParameters:tooLarge error:&error], 
+                  @"Derived a key with parameters that need too much memory");
+    STAssertEquals([error code], (NSInteger)PGCryptoParameterError, @"Wrong error for too much memory: %@", error);
+    
+    // Calibration fills in everything but the algorithm
+    PGKeyDerivationParameters calibrated = [NSData calibratedKeyDerivationParametersForAlgorithm:PGScryptKeyDerivationAlgorithm lanes:2 
+                                                                                  passwordLength:[password length]];
+    STAssertEquals(calibrated.algorithm, PGScryptKeyDerivationAlgorithm, @"Calibration changed the algorithm");
+    STAssertEquals(calibrated.lanes, (uint32_t)2, @"Calibration changed the lanes");
+    STAssertEquals(calibrated.blockSize, (uint32_t)PGScryptDefaultBlockSize, @"Wrong calibrated block size");
+    STAssertTrue(calibrated.rounds >= PGScryptMinimumCost && (calibrated.rounds & (calibrated.rounds - 1)) == 0, @"Wrong calibrated cost");
+    
+    calibrated = [NSData calibratedKeyDerivationParametersForAlgorithm:PGScryptKeyDerivationAlgorithm lanes:0 passwordLength:[password length]];
+    STAssertEquals(calibrated.lanes, (uint32_t)MIN([[NSProcessInfo processInfo] activeProcessorCount], PGScryptMaximumDefaultLanes), 
+                   @"Default lanes aren't one per processor up to the maximum");
+    STAssertTrue(calibrated.rounds >= PGScryptMinimumCalibratedCost, @"Calibrated cost is below the minimum");
+    
+    // Many lanes keep the minimum cost per lane, so the total memory exceeds the calibration limit
+    calibrated = [NSData calibratedKeyDerivationParametersForAlgorithm:PGScryptKeyDerivationAlgorithm lanes:16 passwordLength:[password length]];
+    STAssertTrue(calibrated.rounds >= PGScryptMinimumCalibratedCost, @"Cost per lane shrank with many lanes");
+}
+
+
+- (void)testKeyDerivationParametersMatchRounds
+{
+    NSError *error = nil;
+    NSData *plaintext = [NSData randomDataOfLength:100];
+    
+    // PBKDF2 parameters derive the same key as the rounds methods, so existing data still decrypts
+    NSData *salt = nil;
+    NSNumber *rounds = [NSNumber numberWithUnsignedInt:1000];
+    NSData *iv = nil;
+    NSData *ciphertext = [plaintext encryptedDataWithPassword:@"pässword" salt:&salt rounds:&rounds initializationVector:&iv error:&error];
+    
+    PGKeyDerivationParameters parameters = { PGPBKDF2KeyDerivationAlgorithm, 1000, 0, 0 };
+    STAssertEqualObjects([ciphertext decryptedDataWithPassword:@"pässword" algorithm:PGAES256CBCEncryptionAlgorithm associatedData:nil 
+                                       keyDerivationParameters:parameters salt:salt initializationVector:iv error:&error], plaintext, 
+                         @"PBKDF2 parameters didn't decrypt data encrypted with rounds: %@", error);
+    
+    // A rounds value of 0 is calibrated
+    parameters.rounds = 0;
+    ciphertext = [plaintext encryptedDataWithPassword:@"password" algorithm:PGAES256CBCEncryptionAlgorithm associatedData:nil 
+                              keyDerivationParameters:&parameters salt:&salt initializationVector:&iv error:&error];
+    STAssertTrue(parameters.rounds > 0, @"Rounds weren't calibrated");
+    STAssertEqualObjects([ciphertext decryptedDataWithPassword:@"password" salt:salt rounds:[NSNumber numberWithUnsignedInt:parameters.rounds] 
+                                          initializationVector:iv error:&error], plaintext, @"Rounds didn't decrypt data encrypted with parameters");
+}
+
+@end
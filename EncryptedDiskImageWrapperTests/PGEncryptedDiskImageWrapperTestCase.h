@@ -39,5 +39,11 @@
 - (void)testInit;
 - (void)testAttach;
 - (void)testUserTableManagement;
+- (void)testBulkUserProvisioning;
+- (void)testUserTableErrors;
+- (void)testSessionTokens;
+- (void)testConcurrentSessionTableChanges;
+- (void)testSecretsAreBoundToUsers;
+- (void)testScryptUserEntries;
 
 @end
@@ -28,6 +28,8 @@
 
 #import "NSData+Crypto.h"
 #import "NSFileManager+TemporaryFiles.h"
+#import "PGErrors.h"
+#import "PGUserTable.h"
 
 @implementation PGEncryptedDiskImageWrapperTestCase
 
@@ -158,4 +160,269 @@
     STAssertNil(wrapper, @"Initialization with invalid user succeeded.");
 }
 
+
+- (void)testBulkUserProvisioning
+{
+    NSError *error = nil;
+    
+    PGEncryptedDiskImageWrapper *wrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath 
+                                                                                                  user:@"user1" 
+                                                                                              password:@"password1" 
+                                                                                                 error:&error];
+    [wrapper setPassword:@"password2" forUser:@"user2"];
+    STAssertTrue([wrapper saveUserTable], @"Failed to save user table");
+    
+    NSMutableDictionary *passwords = [NSMutableDictionary dictionary];
+    for (NSUInteger i = 3; i < 11; i++) {
+        [passwords setObject:[NSString stringWithFormat:@"password%lu", (unsigned long)i] forKey:[NSString stringWithFormat:@"user%lu", (unsigned long)i]];
+    }
+    
+    // An invalid entry fails the whole batch and nothing is committed
+    NSMutableDictionary *invalidPasswords = [passwords mutableCopy];
+    [invalidPasswords setObject:@"" forKey:@"user11"];
+    STAssertFalse([wrapper setPasswords:invalidPasswords removeUsers:[NSArray arrayWithObject:@"user2"] progressHandler:nil error:&error], 
+                  @"Provisioning with an empty password succeeded");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperUserProvisioningFailedError, @"Wrong error code");
+    NSDictionary *userErrors = [[error userInfo] objectForKey:PGUserErrorsKey];
+    STAssertEquals([userErrors count], (NSUInteger)1, @"Wrong number of per-user errors");
+    STAssertEquals([[userErrors objectForKey:@"user11"] code], (NSInteger)PGEncryptedDiskImageWrapperInvalidUserEntryError, @"Wrong user error");
+    
+    STAssertNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:@"user3" password:@"password3" error:&error],
+                @"Failed batch was committed");
+    STAssertNotNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:@"user2" password:@"password2" error:&error],
+                   @"Failed batch removed a user");
+    
+    // A valid batch commits every entry and removal, and reports progress for each of them
+    __block NSUInteger lastCompletedCount = 0;
+    __block BOOL progressIsMonotonic = YES;
+    BOOL provisioned = [wrapper setPasswords:passwords removeUsers:[NSArray arrayWithObject:@"user2"] 
+                             progressHandler:^(NSUInteger completedCount, NSUInteger totalCount) {
+                                 if (completedCount != lastCompletedCount + 1 || totalCount != 9) progressIsMonotonic = NO;
+                                 lastCompletedCount = completedCount;
+                             } error:&error];
+    
+    STAssertTrue(provisioned, @"Provisioning failed with error: %@", error);
+    STAssertTrue(progressIsMonotonic, @"Progress was not reported in order");
+    STAssertEquals(lastCompletedCount, (NSUInteger)9, @"Progress was not reported for every entry");
+    
+    for (NSString *user in passwords) {
+        STAssertNotNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:user password:[passwords objectForKey:user] 
+                                                                             error:&error], @"Initialization with provisioned user failed");
+    }
+    
+    STAssertNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:@"user2" password:@"password2" error:&error],
+                @"Initialization with removed user succeeded");
+    STAssertNotNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:@"user1" password:@"password1" error:&error],
+                   @"Initialization with untouched user failed");
+}
+
+
+- (void)testUserTableErrors
+{
+    NSError *error = nil;
+    
+    PGEncryptedDiskImageWrapper *wrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath 
+                                                                                                  user:@"user1" 
+                                                                                              password:@"password1" 
+                                                                                                 error:&error];
+    
+    // The wrapper reads the shared table until it first changes users, so removing the file makes opening a writable table fail
+    STAssertTrue([[NSFileManager defaultManager] removeItemAtPath:[wrapperPath stringByAppendingPathComponent:@"UserTable.db"] error:&error], 
+                 @"Failed to remove user table with error: %@", error);
+    
+    error = nil;
+    STAssertFalse([wrapper setPassword:@"password2" forUser:@"user2" error:&error], @"Set a password without a user table");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperMalformedUserTableError, @"Wrong error code: %@", error);
+    
+    error = nil;
+    STAssertFalse([wrapper removeUser:@"user1" error:&error], @"Removed a user without a user table");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperMalformedUserTableError, @"Wrong error code: %@", error);
+    
+    // A batch fails before deriving anything, so no progress is reported
+    __block NSUInteger progressCount = 0;
+    error = nil;
+    STAssertFalse([wrapper setPasswords:[NSDictionary dictionaryWithObject:@"password2" forKey:@"user2"] removeUsers:nil 
+                        progressHandler:^(NSUInteger completedCount, NSUInteger totalCount) { progressCount++; } error:&error], 
+                  @"Provisioned users without a user table");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperMalformedUserTableError, @"Wrong error code: %@", error);
+    STAssertEquals(progressCount, (NSUInteger)0, @"Reported progress for a batch that couldn't be saved");
+}
+
+
+- (void)testSessionTokens
+{
+    NSError *error = nil;
+    
+    PGEncryptedDiskImageWrapper *wrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath 
+                                                                                                  user:@"user1" 
+                                                                                              password:@"password1" 
+                                                                                                 error:&error];
+    
+    NSString *token = [wrapper issueSessionTokenWithTimeToLive:60 error:&error];
+    STAssertNotNil(token, @"Failed to issue session token with error: %@", error);
+    
+    // A valid token opens the wrapper as the user who requested it
+    PGEncryptedDiskImageWrapper *sessionWrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath sessionToken:token error:&error];
+    STAssertNotNil(sessionWrapper, @"Initialization with session token failed with error: %@", error);
+    STAssertEqualObjects([sessionWrapper user], @"user1", @"Session wrapper has the wrong user");
+    STAssertTrue([sessionWrapper attachAtPath:mountPoint error:&error], @"Attach with session token failed");
+    STAssertTrue([sessionWrapper detach:&error], @"Detach failed");
+    
+    // Tampered tokens don't
+    NSString *tamperedToken = [token stringByReplacingCharactersInRange:NSMakeRange([token length] - 1, 1) 
+                                                             withString:[token hasSuffix:@"0"] ? @"1" : @"0"];
+    STAssertNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath sessionToken:tamperedToken error:&error], 
+                @"Initialization with tampered session token succeeded");
+    STAssertNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath sessionToken:@"garbage" error:&error], 
+                @"Initialization with malformed session token succeeded");
+
+    // Revoked tokens don't either
+    STAssertTrue([wrapper revokeSessionToken:token error:&error], @"Failed to revoke session token");
+    STAssertNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath sessionToken:token error:&error], 
+                @"Initialization with revoked session token succeeded");
+
+    // Nor do expired ones
+    token = [wrapper issueSessionTokenWithTimeToLive:1 error:&error];
+    [NSThread sleepForTimeInterval:2];
+    STAssertNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath sessionToken:token error:&error], 
+                @"Initialization with expired session token succeeded");
+    
+    // Or ones whose user has been removed
+    [wrapper setPassword:@"password2" forUser:@"user2"];
+    [wrapper saveUserTable];
+    wrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:@"user2" password:@"password2" error:&error];
+    token = [wrapper issueSessionTokenWithTimeToLive:60 error:&error];
+    [wrapper removeUser:@"user2"];
+    [wrapper saveUserTable];
+    STAssertNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath sessionToken:token error:&error], 
+                @"Initialization with session token for removed user succeeded");
+    
+    // Or ones whose user's password has been changed since they were issued
+    wrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:@"user1" password:@"password1" error:&error];
+    token = [wrapper issueSessionTokenWithTimeToLive:60 error:&error];
+    STAssertNotNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath sessionToken:token error:&error], 
+                   @"Initialization with session token failed with error: %@", error);
+    [wrapper setPassword:@"newPassword1" forUser:@"user1"];
+    [wrapper saveUserTable];
+    STAssertNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath sessionToken:token error:&error], 
+                @"Initialization with session token issued before a password change succeeded");
+}
+
+
+- (void)testConcurrentSessionTableChanges
+{
+    NSError *error = nil;
+    NSMutableArray *wrappers = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 4; ++i) {
+        PGEncryptedDiskImageWrapper *wrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:@"user1" 
+                                                                                                  password:@"password1" error:&error];
+        STAssertNotNil(wrapper, @"Initialization failed with error: %@", error);
+        if (wrapper) [wrappers addObject:wrapper];
+    }
+    
+    // Each wrapper revokes tokens while the others issue them. Without the lock, writers would overwrite each other's changes, losing tokens
+    // and bringing revoked ones back.
+    NSMutableArray *revokedTokens = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 8; ++i) {
+        NSString *token = [[wrappers objectAtIndex:0] issueSessionTokenWithTimeToLive:60 error:&error];
+        STAssertNotNil(token, @"Failed to issue session token with error: %@", error);
+        if (token) [revokedTokens addObject:token];
+    }
+    
+    NSMutableArray *issuedTokens = [NSMutableArray array];
+    dispatch_apply([wrappers count], dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        PGEncryptedDiskImageWrapper *wrapper = [wrappers objectAtIndex:i];
+        for (NSUInteger j = 0; j < [revokedTokens count]; ++j) {
+            if (i == 0) {
+                [wrapper revokeSessionToken:[revokedTokens objectAtIndex:j] error:NULL];
+            } else {
+                NSString *token = [wrapper issueSessionTokenWithTimeToLive:60 error:NULL];
+                @synchronized (issuedTokens) {
+                    if (token) [issuedTokens addObject:token];
+                }
+            }
+        }
+    });
+    
+    STAssertEquals([issuedTokens count], ([wrappers count] - 1) * [revokedTokens count], @"Failed to issue session tokens");
+    for (NSString *token in issuedTokens) {
+        STAssertNotNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath sessionToken:token error:&error], 
+                       @"Session token was lost with error: %@", error);
+    }
+    
+    for (NSString *token in revokedTokens) {
+        STAssertNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath sessionToken:token error:NULL], 
+                    @"Revoked session token was brought back");
+    }
+}
+
+
+- (void)testSecretsAreBoundToUsers
+{
+    NSError *error = nil;
+    if (![NSData isEncryptionAlgorithmAvailable:PGAES256GCMEncryptionAlgorithm]) {
+        STFail(@"AES-GCM is unavailable, so binding secrets to users can't be tested");
+        return;
+    }
+    
+    PGEncryptedDiskImageWrapper *wrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath 
+                                                                                                  user:@"user1" 
+                                                                                              password:@"password1" 
+                                                                                                 error:&error];
+    [wrapper setPassword:@"password2" forUser:@"user2"];
+    STAssertTrue([wrapper saveUserTable], @"Failed to save user table");
+    
+    // Copying user1's entry over user2's would let anyone who knows user1's password in as user2 if the secret weren't bound to its user
+    NSString *userTablePath = [wrapperPath stringByAppendingPathComponent:@"UserTable.db"];
+    PGUserTable *userTable = [[PGUserTable alloc] initWithContentsOfFile:userTablePath error:&error];
+    NSMutableDictionary *entry = [[userTable entryForUser:@"user1"] mutableCopy];
+    STAssertEquals([[entry objectForKey:PGAlgorithmUserTableEntryKey] unsignedIntValue], (unsigned)PGAES256GCMEncryptionAlgorithm, 
+                   @"New secret was not encrypted with GCM");
+    
+    [entry setObject:@"user2" forKey:PGUserUserTableEntryKey];
+    [userTable setEntry:entry forUser:@"user2"];
+    STAssertTrue([userTable saveChanges:&error], @"Failed to save changes with error: %@", error);
+    
+    STAssertNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:@"user2" password:@"password1" error:&error], 
+                @"Initialization with a secret moved from another user succeeded");
+    STAssertNotNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:@"user1" password:@"password1" error:&error], 
+                   @"Initialization as the secret's own user failed with error: %@", error);
+}
+
+
+- (void)testScryptUserEntries
+{
+    NSError *error = nil;
+    PGEncryptedDiskImageWrapper *wrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath 
+                                                                                                  user:@"user1" 
+                                                                                              password:@"password1" 
+                                                                                                 error:&error];
+    
+    // New entries use scrypt with the configured lanes, and the existing PBKDF2 entry keeps working alongside them
+    [PGEncryptedDiskImageWrapper setKeyDerivationAlgorithm:PGScryptKeyDerivationAlgorithm lanes:2];
+    [wrapper setPassword:@"password2" forUser:@"user2"];
+    BOOL provisioned = [wrapper setPasswords:[NSDictionary dictionaryWithObjectsAndKeys:@"password3", @"user3", @"password4", @"user4", nil] 
+                                 removeUsers:nil progressHandler:nil error:&error];
+    [PGEncryptedDiskImageWrapper setKeyDerivationAlgorithm:PGPBKDF2KeyDerivationAlgorithm lanes:0];
+    STAssertTrue(provisioned, @"Failed to provision scrypt users with error: %@", error);
+    
+    PGUserTable *userTable = [[PGUserTable alloc] initWithContentsOfFile:[wrapperPath stringByAppendingPathComponent:@"UserTable.db"] error:&error];
+    STAssertNil([[userTable entryForUser:@"user1"] objectForKey:PGKeyDerivationUserTableEntryKey], @"PBKDF2 entry has a key derivation");
+    for (NSString *user in [NSArray arrayWithObjects:@"user2", @"user3", @"user4", nil]) {
+        NSDictionary *entry = [userTable entryForUser:user];
+        STAssertEquals([[entry objectForKey:PGKeyDerivationUserTableEntryKey] unsignedIntValue], (unsigned)PGScryptKeyDerivationAlgorithm, 
+                       @"%@'s entry wasn't derived with scrypt", user);
+        STAssertEquals([[entry objectForKey:PGLanesUserTableEntryKey] unsignedIntValue], 2U, @"%@'s entry has the wrong lanes", user);
+    }
+    
+    for (NSUInteger i = 1; i <= 4; ++i) {
+        NSString *user = [NSString stringWithFormat:@"user%lu", (unsigned long)i];
+        NSString *password = [NSString stringWithFormat:@"password%lu", (unsigned long)i];
+        STAssertNotNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:user password:password error:&error], 
+                       @"Initialization as %@ failed with error: %@", user, error);
+        STAssertNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:user password:@"wrong" error:&error], 
+                    @"Initialization as %@ with the wrong password succeeded", user);
+    }
+}
+
 @end
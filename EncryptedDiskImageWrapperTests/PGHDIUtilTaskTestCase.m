@@ -0,0 +1,159 @@
+//
+//  PGHDIUtilTaskTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGHDIUtilTaskTestCase.h"
+
+#import <stdlib.h>
+
+#import "NSData+Crypto.h"
+#import "PGEncryptedDiskImageWrapper.h"
+#import "PGErrors.h"
+#import "PGHDIUtilTask.h"
+
+@implementation PGHDIUtilTaskTestCase
+
+- (void)testAttachResult
+{
+    // Enough output to fill a pipe's buffer several times over, which would deadlock if the output weren't drained as the task runs
+    setenv("PGHDIUTIL_STUB_PADDING", "4000", 1);
+    
+    NSError *error = nil;
+    NSDictionary *result = nil;
+    NSArray *arguments = [NSArray arrayWithObjects:@"image.sparsebundle", @"-nobrowse", @"-mountpoint", temporaryDirectory, nil];
+    PGHDIUtilTask *hdiutil = [[PGHDIUtilTask alloc] initWithVerb:PGHDIUtilAttachVerb arguments:arguments password:@"password"];
+    STAssertTrue([hdiutil launchAndWaitWithResult:&result error:&error], @"Attach failed with error: %@", error);
+    
+    NSArray *systemEntities = [result objectForKey:@"system-entities"];
+    STAssertEquals([systemEntities count], (NSUInteger)4001, @"Wrong number of system entities");
+    STAssertEqualObjects([[systemEntities lastObject] objectForKey:@"mount-point"], temporaryDirectory, @"Wrong mount point");
+}
+
+
+- (void)testFailure
+{
+    setenv("PGHDIUTIL_STUB_STATUS", "1", 1);
+    
+    NSError *error = nil;
+    PGHDIUtilTask *hdiutil = [[PGHDIUtilTask alloc] initWithVerb:PGHDIUtilDetachVerb arguments:[NSArray arrayWithObject:temporaryDirectory] password:nil];
+    STAssertFalse([hdiutil launchAndWaitWithResult:NULL error:&error], @"Failed task succeeded");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperTaskFailedError, @"Wrong error code");
+    STAssertTrue([[[error userInfo] objectForKey:PGTaskStandardErrorKey] rangeOfString:@"stub failure"].location != NSNotFound, 
+                 @"Error doesn't include standard error");
+    
+    [PGHDIUtilTask setDefaultLaunchPath:[temporaryDirectory stringByAppendingPathComponent:@"nonexistent"]];
+    hdiutil = [[PGHDIUtilTask alloc] initWithVerb:PGHDIUtilDetachVerb arguments:[NSArray arrayWithObject:temporaryDirectory] password:nil];
+    STAssertFalse([hdiutil launchAndWaitWithResult:NULL error:&error], @"Task with nonexistent launch path succeeded");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperTaskFailedError, @"Wrong error code");
+}
+
+
+- (void)testTimeout
+{
+    setenv("PGHDIUTIL_STUB_DELAY", "10", 1);
+    
+    NSError *error = nil;
+    PGHDIUtilTask *hdiutil = [[PGHDIUtilTask alloc] initWithVerb:PGHDIUtilDetachVerb arguments:[NSArray arrayWithObject:temporaryDirectory] password:nil];
+    [hdiutil setTimeout:0.5];
+    
+    NSDate *startDate = [NSDate date];
+    STAssertFalse([hdiutil launchAndWaitWithResult:NULL error:&error], @"Task succeeded despite timing out");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperTaskTimedOutError, @"Wrong error code");
+    STAssertTrue(-[startDate timeIntervalSinceNow] < 5, @"Task wasn't terminated when it timed out");
+}
+
+
+- (void)testCancellation
+{
+    setenv("PGHDIUTIL_STUB_DELAY", "10", 1);
+    
+    PGHDIUtilTask *hdiutil = [[PGHDIUtilTask alloc] initWithVerb:PGHDIUtilDetachVerb arguments:[NSArray arrayWithObject:temporaryDirectory] password:nil];
+    
+    __block NSError *error = nil;
+    dispatch_semaphore_t finishedSemaphore = dispatch_semaphore_create(0);
+    NSDate *startDate = [NSDate date];
+    [hdiutil launchWithCompletionHandler:^(NSDictionary *result, NSError *taskError) {
+        error = taskError;
+        dispatch_semaphore_signal(finishedSemaphore);
+    }];
+    
+    [NSThread sleepForTimeInterval:0.5];
+    [hdiutil cancel];
+    dispatch_semaphore_wait(finishedSemaphore, DISPATCH_TIME_FOREVER);
+    dispatch_release(finishedSemaphore);
+    
+    STAssertTrue([hdiutil isCancelled], @"Task isn't cancelled");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperTaskCancelledError, @"Wrong error code");
+    STAssertTrue(-[startDate timeIntervalSinceNow] < 5, @"Task wasn't terminated when it was cancelled");
+}
+
+
+- (void)testAsynchronousWrapperOperations
+{
+    NSString *wrapperPath = [temporaryDirectory stringByAppendingPathComponent:@"test.edi"];
+    NSDictionary *volumeOptions = [NSDictionary dictionaryWithObjectsAndKeys:@"Test Volume", PGNameVolumeOption, 
+                                   [NSNumber numberWithUnsignedInteger:5], PGSizeVolumeOption, nil];
+    
+    __block PGEncryptedDiskImageWrapper *wrapper = nil;
+    __block NSString *mountPoint = nil;
+    __block BOOL success = NO;
+    __block NSError *error = nil;
+    dispatch_semaphore_t finishedSemaphore = dispatch_semaphore_create(0);
+    
+    [PGEncryptedDiskImageWrapper createEncryptedDiskImageWrapperAtPath:wrapperPath masterPassword:[NSData randomlyGeneratedPassword] user:@"user1" 
+                                                              password:@"password1" volumeOptions:volumeOptions timeout:30
+                                                     completionHandler:^(PGEncryptedDiskImageWrapper *newWrapper, NSError *creationError) {
+        wrapper = newWrapper;
+        error = creationError;
+        dispatch_semaphore_signal(finishedSemaphore);
+    }];
+    
+    dispatch_semaphore_wait(finishedSemaphore, DISPATCH_TIME_FOREVER);
+    STAssertNotNil(wrapper, @"Failed to create wrapper with error: %@", error);
+    
+    [wrapper attachAtRandomSubdirectoryOfPath:temporaryDirectory timeout:30 completionHandler:^(NSString *newMountPoint, NSError *attachError) {
+        mountPoint = newMountPoint;
+        error = attachError;
+        dispatch_semaphore_signal(finishedSemaphore);
+    }];
+    
+    dispatch_semaphore_wait(finishedSemaphore, DISPATCH_TIME_FOREVER);
+    STAssertNotNil(mountPoint, @"Random attach failed with error: %@", error);
+    STAssertEqualObjects([wrapper mountPoint], mountPoint, @"Wrapper has the wrong mount point");
+    
+    [wrapper detachWithTimeout:30 completionHandler:^(BOOL detached, NSError *detachError) {
+        success = detached;
+        error = detachError;
+        dispatch_semaphore_signal(finishedSemaphore);
+    }];
+    
+    dispatch_semaphore_wait(finishedSemaphore, DISPATCH_TIME_FOREVER);
+    STAssertTrue(success, @"Detach failed with error: %@", error);
+    STAssertFalse([wrapper isAttached], @"Wrapper is detached, but status says otherwise");
+    
+    dispatch_release(finishedSemaphore);
+}
+
+@end
@@ -0,0 +1,179 @@
+//
+//  PGInstrumentationTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGInstrumentationTestCase.h"
+
+#import "NSData+Crypto.h"
+#import "PGInstrumentation.h"
+
+@implementation PGInstrumentationTestCase
+
+- (void)setUp
+{
+    [super setUp];
+    [PGInstrumentation reset];
+}
+
+
+- (void)tearDown
+{
+    [PGInstrumentation setEnabled:NO];
+    [PGInstrumentation setTracing:NO];
+    [PGInstrumentation setSpanHandler:nil];
+    [PGInstrumentation reset];
+    [super tearDown];
+}
+
+
+- (void)testDisabled
+{
+    STAssertFalse([PGInstrumentation isEnabled], @"Instrumentation is enabled by default");
+    STAssertEquals(PGInstrumentationBeginSpan(), (uint64_t)0, @"Span began while disabled");
+    
+    NSData *salt = nil;
+    NSNumber *rounds = nil;
+    NSData *iv = nil;
+    [[NSData randomDataOfLength:64] encryptedDataWithPassword:@"password" salt:&salt rounds:&rounds initializationVector:&iv error:NULL];
+    PGInstrumentationIncrementCounter(PGAuthenticationFailureCounter);
+    
+    STAssertEquals([[PGInstrumentation spanStatistics] count], (NSUInteger)0, @"Spans recorded while disabled");
+    STAssertEquals([[PGInstrumentation counters] count], (NSUInteger)0, @"Counters incremented while disabled");
+}
+
+
+- (void)testSpanStatistics
+{
+    [PGInstrumentation setEnabled:YES];
+    
+    NSData *data = [NSData randomDataOfLength:1024];
+    NSData *salt = nil;
+    NSNumber *rounds = nil;
+    NSData *iv = nil;
+    NSData *encryptedData = [data encryptedDataWithPassword:@"password" salt:&salt rounds:&rounds initializationVector:&iv error:NULL];
+    STAssertEqualObjects([encryptedData decryptedDataWithPassword:@"password" salt:salt rounds:rounds initializationVector:iv error:NULL], data,
+                         @"Decrypted data doesn't match");
+    
+    STAssertEqualObjects([[PGInstrumentation statisticsForSpanNamed:PGKeyCalibrationSpan] objectForKey:PGSpanCountStatisticKey], 
+                         [NSNumber numberWithUnsignedInteger:1], @"Wrong number of calibrations");
+    STAssertEqualObjects([[PGInstrumentation statisticsForSpanNamed:PGKeyDerivationSpan] objectForKey:PGSpanCountStatisticKey], 
+                         [NSNumber numberWithUnsignedInteger:2], @"Wrong number of key derivations");
+    STAssertNil([PGInstrumentation statisticsForSpanNamed:PGHDIUtilAttachSpan], @"Statistics for unrecorded span");
+    
+    // Record spans of known relative lengths and check that the statistics are consistent
+    for (NSUInteger i = 0; i < 100; i++) {
+        uint64_t startTime = PGInstrumentationBeginSpan();
+        STAssertTrue(startTime != 0, @"Span didn't begin while enabled");
+        usleep((useconds_t)(i % 10 == 0 ? 2000 : 100));
+        PGInstrumentationEndSpan(@"Test.sleep", startTime);
+    }
+    
+    NSDictionary *statistics = [PGInstrumentation statisticsForSpanNamed:@"Test.sleep"];
+    uint64_t count = [[statistics objectForKey:PGSpanCountStatisticKey] unsignedLongLongValue];
+    uint64_t total = [[statistics objectForKey:PGSpanTotalStatisticKey] unsignedLongLongValue];
+    uint64_t minimum = [[statistics objectForKey:PGSpanMinimumStatisticKey] unsignedLongLongValue];
+    uint64_t maximum = [[statistics objectForKey:PGSpanMaximumStatisticKey] unsignedLongLongValue];
+    uint64_t mean = [[statistics objectForKey:PGSpanMeanStatisticKey] unsignedLongLongValue];
+    uint64_t p50 = [[statistics objectForKey:PGSpan50thPercentileStatisticKey] unsignedLongLongValue];
+    uint64_t p90 = [[statistics objectForKey:PGSpan90thPercentileStatisticKey] unsignedLongLongValue];
+    uint64_t p99 = [[statistics objectForKey:PGSpan99thPercentileStatisticKey] unsignedLongLongValue];
+    
+    STAssertEquals(count, (uint64_t)100, @"Wrong span count");
+    STAssertEquals(mean, total / count, @"Wrong mean");
+    STAssertTrue(minimum >= 100 * NSEC_PER_USEC, @"Minimum is shorter than the shortest sleep");
+    STAssertTrue(maximum >= 2 * NSEC_PER_MSEC, @"Maximum is shorter than the longest sleep");
+    STAssertTrue(minimum <= p50 && p50 <= p90 && p90 <= p99 && p99 <= maximum, @"Percentiles are out of order");
+    STAssertTrue(p50 < 2 * NSEC_PER_MSEC, @"Median includes the long sleeps");
+    STAssertTrue(p99 >= 2 * NSEC_PER_MSEC * 3 / 4, @"99th percentile excludes the long sleeps");
+}
+
+
+- (void)testCounters
+{
+    [PGInstrumentation setEnabled:YES];
+    for (NSUInteger i = 0; i < 3; i++) PGInstrumentationIncrementCounter(PGHDIUtilFailureCounter);
+    STAssertEquals([PGInstrumentation valueForCounterNamed:PGHDIUtilFailureCounter], (NSUInteger)3, @"Wrong counter value");
+    STAssertEquals([PGInstrumentation valueForCounterNamed:PGAuthenticationFailureCounter], (NSUInteger)0, @"Wrong value for unused counter");
+    
+    [PGInstrumentation setEnabled:NO];
+    PGInstrumentationIncrementCounter(PGHDIUtilFailureCounter);
+    STAssertEquals([PGInstrumentation valueForCounterNamed:PGHDIUtilFailureCounter], (NSUInteger)3, @"Counter incremented while disabled");
+    
+    [PGInstrumentation reset];
+    STAssertEquals([[PGInstrumentation counters] count], (NSUInteger)0, @"Counters not reset");
+}
+
+
+- (void)testSpanHandler
+{
+    NSMutableArray *names = [NSMutableArray array];
+    [PGInstrumentation setSpanHandler:^(NSString *name, uint64_t duration) {
+        [names addObject:name];
+    }];
+    
+    [PGInstrumentation setEnabled:YES];
+    PGInstrumentationEndSpan(@"Test.first", PGInstrumentationBeginSpan());
+    PGInstrumentationEndSpan(@"Test.second", PGInstrumentationBeginSpan());
+    
+    // Reading statistics waits for the spans to be recorded, and the handler is invoked as they are
+    [PGInstrumentation spanStatistics];
+    STAssertEqualObjects(names, ([NSArray arrayWithObjects:@"Test.first", @"Test.second", nil]), @"Handler not invoked for each span in order");
+}
+
+
+- (void)testTraceExport
+{
+    NSString *password = @"correct horse battery staple";
+    [PGInstrumentation setEnabled:YES];
+    [PGInstrumentation setTracing:YES];
+    
+    NSData *salt = nil;
+    NSNumber *rounds = nil;
+    NSData *iv = nil;
+    [[password dataUsingEncoding:NSUTF8StringEncoding] encryptedDataWithPassword:password salt:&salt rounds:&rounds initializationVector:&iv 
+                                                                            error:NULL];
+    
+    NSData *traceData = [PGInstrumentation traceJSONData];
+    NSDictionary *trace = [NSJSONSerialization JSONObjectWithData:traceData options:0 error:NULL];
+    NSArray *events = [trace objectForKey:@"traceEvents"];
+    STAssertEquals([events count], (NSUInteger)3, @"Wrong number of trace events");
+    
+    NSMutableSet *names = [NSMutableSet set];
+    for (NSDictionary *event in events) {
+        [names addObject:[event objectForKey:@"name"]];
+        STAssertEqualObjects([event objectForKey:@"ph"], @"X", @"Event is not a complete event");
+        STAssertNotNil([event objectForKey:@"ts"], @"Event has no timestamp");
+        STAssertNotNil([event objectForKey:@"dur"], @"Event has no duration");
+        STAssertNotNil([event objectForKey:@"tid"], @"Event has no thread");
+    }
+    
+    STAssertEqualObjects(names, ([NSSet setWithObjects:PGKeyCalibrationSpan, PGKeyDerivationSpan, PGCryptSpan, nil]), @"Wrong trace events");
+    
+    NSString *traceString = [[NSString alloc] initWithData:traceData encoding:NSUTF8StringEncoding];
+    STAssertTrue([traceString rangeOfString:password].location == NSNotFound, @"Trace contains the password");
+    STAssertTrue([traceString rangeOfString:[salt hexadecimalString]].location == NSNotFound, @"Trace contains the salt");
+}
+
+@end
@@ -0,0 +1,121 @@
+//
+//  PGKeyArenaTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+
+#import "PGKeyArenaTestCase.h"
+
+#import "PGKeyArena.h"
+
+@implementation PGKeyArenaTestCase
+
+- (void)testAllocation
+{
+    // Allocate enough blocks to span several pages, so the arena has to grow
+    const NSUInteger blockCount = 1024;
+    uint8_t *blocks[blockCount];
+    uint8_t zeroes[PGKeyArenaBlockSize] = { 0 };
+    
+    for (NSUInteger i = 0; i < blockCount; ++i) {
+        blocks[i] = PGKeyArenaAllocate(PGKeyArenaBlockSize);
+        STAssertTrue(blocks[i] != NULL, @"Couldn't allocate block %lu", (unsigned long)i);
+        STAssertTrue(memcmp(blocks[i], zeroes, PGKeyArenaBlockSize) == 0, @"Block %lu isn't zeroed", (unsigned long)i);
+        memset(blocks[i], (int)i, PGKeyArenaBlockSize);
+    }
+    
+    // No two blocks overlap, so each one still holds what was written to it
+    for (NSUInteger i = 0; i < blockCount; ++i) {
+        for (NSUInteger j = 0; j < PGKeyArenaBlockSize; ++j) {
+            STAssertEquals(blocks[i][j], (uint8_t)i, @"Block %lu was overwritten", (unsigned long)i);
+        }
+        
+        PGKeyArenaRelease(blocks[i]);
+    }
+    
+    PGKeyArenaRelease(NULL);
+    void *emptyBlock = PGKeyArenaAllocate(0);
+    STAssertTrue(emptyBlock != NULL, @"Couldn't allocate an empty block");
+    PGKeyArenaRelease(emptyBlock);
+}
+
+
+- (void)testReleaseZeroesBlocks
+{
+    uint8_t zeroes[PGKeyArenaBlockSize] = { 0 };
+    uint8_t *block = PGKeyArenaAllocate(32);
+    memset(block, 0xA5, PGKeyArenaBlockSize);
+    PGKeyArenaRelease(block);
+    
+    // Released blocks are reused before the arena grows, so the next allocation returns the same block
+    uint8_t *reusedBlock = PGKeyArenaAllocate(PGKeyArenaBlockSize);
+    STAssertTrue(reusedBlock == block, @"Released block wasn't reused");
+    STAssertTrue(memcmp(reusedBlock, zeroes, PGKeyArenaBlockSize) == 0, @"Released block wasn't zeroed");
+    PGKeyArenaRelease(reusedBlock);
+}
+
+
+- (void)testOversizedAllocation
+{
+    STAssertTrue(PGKeyArenaAllocate(PGKeyArenaBlockSize + 1) == NULL, @"Allocated block larger than the block size");
+    STAssertTrue(PGKeyArenaAllocate(SIZE_MAX) == NULL, @"Allocated block of maximum size");
+}
+
+
+- (void)testConcurrentAllocation
+{
+    __block BOOL failed = NO;
+    dispatch_apply(64, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t iteration) {
+        for (NSUInteger i = 0; i < 256; ++i) {
+            uint8_t *block = PGKeyArenaAllocate(PGKeyArenaBlockSize);
+            if (!block) {
+                failed = YES;
+                return;
+            }
+            
+            // If another thread held the same block, it would overwrite the pattern before we check it
+            memset(block, (int)iteration, PGKeyArenaBlockSize);
+            for (NSUInteger j = 0; j < PGKeyArenaBlockSize; ++j) {
+                if (block[j] != (uint8_t)iteration) failed = YES;
+            }
+            
+            PGKeyArenaRelease(block);
+        }
+    });
+    
+    STAssertFalse(failed, @"Blocks were shared between threads");
+}
+
+
+- (void)testZero
+{
+    uint8_t bytes[100];
+    uint8_t zeroes[100] = { 0 };
+    memset(bytes, 0xFF, sizeof(bytes));
+    PGKeyArenaZero(bytes, sizeof(bytes));
+    STAssertTrue(memcmp(bytes, zeroes, sizeof(bytes)) == 0, @"Bytes weren't zeroed");
+    PGKeyArenaZero(NULL, 0);
+}
+
+@end
@@ -0,0 +1,328 @@
+//
+//  PGManifestTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+
+#import "PGManifestTestCase.h"
+
+#import "NSData+Crypto.h"
+#import "NSFileManager+TemporaryFiles.h"
+#import "PGEncryptedDiskImageWrapper.h"
+#import "PGErrors.h"
+#import "PGManifest.h"
+
+/*! @abstract The size of the chunks that form the leaves of a file's Merkle tree. */
+static const NSUInteger PGManifestTestChunkSize = 1024 * 1024;
+
+
+/*!
+ @abstract Returns the Merkle tree leaf digest of the specified data.
+ @param data The data. May not be nil.
+ @return The leaf digest.
+ */
+static NSData *PGManifestTestLeafDigest(NSData *data)
+{
+    NSMutableData *input = [NSMutableData dataWithLength:1];
+    [input appendData:[data SHA256Digest]];
+    return [input SHA256Digest];
+}
+
+
+/*!
+ @abstract Returns the Merkle tree interior node digest of the specified children.
+ @param left The left child's digest. May not be nil.
+ @param right The right child's digest. May not be nil.
+ @return The node digest.
+ */
+static NSData *PGManifestTestNodeDigest(NSData *left, NSData *right)
+{
+    uint8_t prefix = 0x01;
+    NSMutableData *input = [NSMutableData dataWithBytes:&prefix length:sizeof(prefix)];
+    [input appendData:left];
+    [input appendData:right];
+    return [input SHA256Digest];
+}
+
+
+@implementation PGManifestTestCase
+
+- (void)setUp
+{
+    [super setUp];
+    temporaryDirectory = [[NSFileManager defaultManager] createTemporaryDirectoryWithTemplate:@"PGManifestTestCase.XXXXXX" error:NULL];
+    contentsPath = [temporaryDirectory stringByAppendingPathComponent:@"Contents"];
+    
+    // A directory like a sparse bundle, with a few bands, a nested directory, and a file to exclude
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    [fileManager createDirectoryAtPath:[contentsPath stringByAppendingPathComponent:@"bands"] withIntermediateDirectories:YES attributes:nil 
+                                 error:NULL];
+    for (NSUInteger i = 0; i < 8; ++i) {
+        NSString *bandPath = [contentsPath stringByAppendingPathComponent:[NSString stringWithFormat:@"bands/%lx", (unsigned long)i]];
+        [[NSData randomDataOfLength:100 * 1024] writeToFile:bandPath atomically:NO];
+    }
+    
+    [[@"info" dataUsingEncoding:NSUTF8StringEncoding] writeToFile:[contentsPath stringByAppendingPathComponent:@"Info.plist"] atomically:NO];
+    [[@"excluded" dataUsingEncoding:NSUTF8StringEncoding] writeToFile:[contentsPath stringByAppendingPathComponent:@"Excluded"] atomically:NO];
+}
+
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:temporaryDirectory error:NULL];
+    [super tearDown];
+}
+
+
+- (void)testFileDigests
+{
+    NSError *error = nil;
+    NSString *filePath = [temporaryDirectory stringByAppendingPathComponent:@"File"];
+    
+    // Empty files and files of up to one chunk have a single leaf
+    NSArray *lengths = [NSArray arrayWithObjects:[NSNumber numberWithUnsignedInteger:0], [NSNumber numberWithUnsignedInteger:1], 
+                        [NSNumber numberWithUnsignedInteger:PGManifestTestChunkSize], nil];
+    for (NSNumber *length in lengths) {
+        NSData *data = [NSData randomDataOfLength:[length unsignedIntegerValue]];
+        [data writeToFile:filePath atomically:NO];
+        STAssertEqualObjects([PGManifest digestOfFileAtPath:filePath error:&error], PGManifestTestLeafDigest(data), 
+                             @"Wrong digest for %@ bytes: %@", length, error);
+    }
+    
+    // Three chunks make a tree whose third leaf has no sibling and is promoted
+    NSData *data = [NSData randomDataOfLength:2 * PGManifestTestChunkSize + 1];
+    [data writeToFile:filePath atomically:NO];
+    NSData *firstLeaf = PGManifestTestLeafDigest([data subdataWithRange:NSMakeRange(0, PGManifestTestChunkSize)]);
+    NSData *secondLeaf = PGManifestTestLeafDigest([data subdataWithRange:NSMakeRange(PGManifestTestChunkSize, PGManifestTestChunkSize)]);
+    NSData *thirdLeaf = PGManifestTestLeafDigest([data subdataWithRange:NSMakeRange(2 * PGManifestTestChunkSize, 1)]);
+    STAssertEqualObjects([PGManifest digestOfFileAtPath:filePath error:&error], 
+                         PGManifestTestNodeDigest(PGManifestTestNodeDigest(firstLeaf, secondLeaf), thirdLeaf), 
+                         @"Wrong digest for multiple chunks: %@", error);
+    
+    // Files larger than a mapping window are hashed a window at a time, and changing any chunk changes the digest
+    NSMutableData *largeData = [[NSData randomDataOfLength:70 * PGManifestTestChunkSize] mutableCopy];
+    [largeData writeToFile:filePath atomically:NO];
+    NSData *largeDigest = [PGManifest digestOfFileAtPath:filePath error:&error];
+    STAssertNotNil(largeDigest, @"Failed to hash large file: %@", error);
+    ((uint8_t *)[largeData mutableBytes])[[largeData length] - 1] ^= 0x01;
+    [largeData writeToFile:filePath atomically:NO];
+    STAssertFalse([[PGManifest digestOfFileAtPath:filePath error:&error] isEqualToData:largeDigest], @"Digest didn't change");
+    
+    STAssertNil([PGManifest digestOfFileAtPath:[temporaryDirectory stringByAppendingPathComponent:@"Missing"] error:&error], 
+                @"Hashed missing file");
+    STAssertEqualObjects([error domain], NSPOSIXErrorDomain, @"Wrong error domain for missing file");
+}
+
+
+- (void)testReadAndWrite
+{
+    NSError *error = nil;
+    PGManifest *manifest = [PGManifest manifestWithDirectoryAtPath:contentsPath excludedRelativePaths:[NSSet setWithObject:@"Excluded"] 
+                                                             error:&error];
+    STAssertNotNil(manifest, @"Failed to build manifest: %@", error);
+    STAssertEquals([[manifest relativePaths] count], (NSUInteger)9, @"Wrong number of files");
+    STAssertEqualObjects([[manifest relativePaths] objectAtIndex:0], @"Info.plist", @"Paths aren't sorted");
+    STAssertNil([manifest digestForRelativePath:@"Excluded"], @"Excluded file is in the manifest");
+    STAssertEqualObjects([manifest digestForRelativePath:@"bands/3"], 
+                         [PGManifest digestOfFileAtPath:[contentsPath stringByAppendingPathComponent:@"bands/3"] error:NULL], @"Wrong file digest");
+    
+    NSString *manifestPath = [temporaryDirectory stringByAppendingPathComponent:@"Manifest.plist"];
+    STAssertTrue([manifest writeToFile:manifestPath error:&error], @"Failed to write manifest: %@", error);
+    
+    PGManifest *readManifest = [[PGManifest alloc] initWithContentsOfFile:manifestPath error:&error];
+    STAssertNotNil(readManifest, @"Failed to read manifest: %@", error);
+    STAssertEqualObjects([readManifest rootDigest], [manifest rootDigest], @"Root digest changed");
+    STAssertEqualObjects([readManifest relativePaths], [manifest relativePaths], @"Paths changed");
+    STAssertEqualObjects([readManifest excludedRelativePaths], [manifest excludedRelativePaths], @"Excluded paths changed");
+    STAssertEquals([[readManifest relativePathsOfFilesDifferingFromManifest:manifest] count], (NSUInteger)0, @"Manifests differ");
+    
+    // Building the same directory again produces the same root
+    PGManifest *rebuiltManifest = [PGManifest manifestWithDirectoryAtPath:contentsPath excludedRelativePaths:[NSSet setWithObject:@"Excluded"]
+                                                                    error:&error];
+    STAssertEqualObjects([rebuiltManifest rootDigest], [manifest rootDigest], @"Rebuilt manifest has a different root digest");
+}
+
+
+- (void)testDetectsChanges
+{
+    NSError *error = nil;
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    PGManifest *manifest = [PGManifest manifestWithDirectoryAtPath:contentsPath excludedRelativePaths:nil error:&error];
+    
+    // Change, remove, and add a band. The changed band's length differs, so the change is noticed even if its modification date doesn't.
+    [[NSData randomDataOfLength:50 * 1024] writeToFile:[contentsPath stringByAppendingPathComponent:@"bands/1"] atomically:NO];
+    [fileManager removeItemAtPath:[contentsPath stringByAppendingPathComponent:@"bands/2"] error:NULL];
+    [[NSData randomDataOfLength:10] writeToFile:[contentsPath stringByAppendingPathComponent:@"bands/8"] atomically:NO];
+    
+    PGManifest *currentManifest = [manifest manifestByUpdatingWithDirectoryAtPath:contentsPath options:0 error:&error];
+    STAssertNotNil(currentManifest, @"Failed to update manifest: %@", error);
+    
+    NSArray *expectedPaths = [NSArray arrayWithObjects:@"bands/1", @"bands/2", @"bands/8", nil];
+    STAssertEqualObjects([manifest relativePathsOfFilesDifferingFromManifest:currentManifest], expectedPaths, @"Wrong differing paths");
+    STAssertEqualObjects([currentManifest relativePathsOfFilesDifferingFromManifest:manifest], expectedPaths, @"Comparison isn't symmetric");
+    STAssertFalse([[currentManifest rootDigest] isEqualToData:[manifest rootDigest]], @"Root digest didn't change");
+    
+    // Renaming a file without changing its contents changes the root digest
+    [fileManager moveItemAtPath:[contentsPath stringByAppendingPathComponent:@"bands/8"] 
+                         toPath:[contentsPath stringByAppendingPathComponent:@"bands/9"] error:NULL];
+    PGManifest *renamedManifest = [currentManifest manifestByUpdatingWithDirectoryAtPath:contentsPath options:0 error:&error];
+    STAssertFalse([[renamedManifest rootDigest] isEqualToData:[currentManifest rootDigest]], @"Root digest didn't change after rename");
+}
+
+
+- (void)testIncrementalUpdate
+{
+    NSError *error = nil;
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    PGManifest *manifest = [PGManifest manifestWithDirectoryAtPath:contentsPath excludedRelativePaths:nil error:&error];
+    
+    // Overwrite a band with data of the same length and put back its modification date, as silent corruption would
+    NSString *bandPath = [contentsPath stringByAppendingPathComponent:@"bands/5"];
+    NSDate *modificationDate = [[fileManager attributesOfItemAtPath:bandPath error:NULL] fileModificationDate];
+    [[NSData randomDataOfLength:100 * 1024] writeToFile:bandPath atomically:NO];
+    [fileManager setAttributes:[NSDictionary dictionaryWithObject:modificationDate forKey:NSFileModificationDate] ofItemAtPath:bandPath error:NULL];
+    
+    // An incremental update trusts the unchanged attributes, but re-hashing everything catches the change
+    PGManifest *incrementalManifest = [manifest manifestByUpdatingWithDirectoryAtPath:contentsPath options:0 error:&error];
+    STAssertEquals([[manifest relativePathsOfFilesDifferingFromManifest:incrementalManifest] count], (NSUInteger)0, 
+                   @"Incremental update re-hashed an unchanged file");
+    
+    PGManifest *fullManifest = [manifest manifestByUpdatingWithDirectoryAtPath:contentsPath options:PGManifestRehashAllFiles error:&error];
+    STAssertEqualObjects([manifest relativePathsOfFilesDifferingFromManifest:fullManifest], [NSArray arrayWithObject:@"bands/5"], 
+                         @"Full update didn't detect the corrupt band");
+    
+    // Touching a file makes an incremental update re-hash it, but its digest doesn't change
+    NSString *touchedPath = [contentsPath stringByAppendingPathComponent:@"bands/6"];
+    [fileManager setAttributes:[NSDictionary dictionaryWithObject:[NSDate dateWithTimeIntervalSinceNow:60] forKey:NSFileModificationDate] 
+                  ofItemAtPath:touchedPath error:NULL];
+    PGManifest *touchedManifest = [fullManifest manifestByUpdatingWithDirectoryAtPath:contentsPath options:0 error:&error];
+    STAssertEquals([[fullManifest relativePathsOfFilesDifferingFromManifest:touchedManifest] count], (NSUInteger)0, 
+                   @"Touched file's digest changed");
+}
+
+
+- (void)testMalformedManifest
+{
+    NSError *error = nil;
+    PGManifest *manifest = [PGManifest manifestWithDirectoryAtPath:contentsPath excludedRelativePaths:nil error:&error];
+    NSString *manifestPath = [temporaryDirectory stringByAppendingPathComponent:@"Manifest.plist"];
+    [manifest writeToFile:manifestPath error:NULL];
+    
+    // Editing a file's digest without recomputing the root digest is detected
+    NSMutableDictionary *plist = [NSPropertyListSerialization propertyListWithData:[NSData dataWithContentsOfFile:manifestPath] 
+                                                                           options:NSPropertyListMutableContainers format:NULL error:NULL];
+    [[[plist objectForKey:@"Files"] objectForKey:@"bands/0"] setObject:[NSData randomDataOfLength:32] forKey:@"Digest"];
+    [[NSPropertyListSerialization dataWithPropertyList:plist format:NSPropertyListBinaryFormat_v1_0 options:0 error:NULL] 
+     writeToFile:manifestPath atomically:NO];
+    
+    STAssertNil([[PGManifest alloc] initWithContentsOfFile:manifestPath error:&error], @"Read manifest with edited digest");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperMalformedManifestError, @"Wrong error for edited manifest: %@", error);
+    
+    [[@"garbage" dataUsingEncoding:NSUTF8StringEncoding] writeToFile:manifestPath atomically:NO];
+    STAssertNil([[PGManifest alloc] initWithContentsOfFile:manifestPath error:&error], @"Read garbage manifest");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperMalformedManifestError, @"Wrong error for garbage manifest: %@", error);
+}
+
+
+- (void)testAuthenticatedManifest
+{
+    NSError *error = nil;
+    PGManifest *manifest = [PGManifest manifestWithDirectoryAtPath:contentsPath excludedRelativePaths:nil error:&error];
+    NSString *manifestPath = [temporaryDirectory stringByAppendingPathComponent:@"Manifest.plist"];
+    STAssertTrue([manifest writeToFile:manifestPath password:@"password" error:&error], @"Failed to write manifest: %@", error);
+    
+    PGManifest *readManifest = [[PGManifest alloc] initWithContentsOfFile:manifestPath password:@"password" error:&error];
+    STAssertNotNil(readManifest, @"Failed to read authenticated manifest: %@", error);
+    STAssertEqualObjects([readManifest rootDigest], [manifest rootDigest], @"Root digests differ");
+    
+    STAssertNil([[PGManifest alloc] initWithContentsOfFile:manifestPath password:@"wrong" error:&error], @"Read manifest with wrong password");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperManifestMismatchError, @"Wrong error for wrong password: %@", error);
+    
+    // Someone without the password can rebuild a consistent manifest after changing a file, but not its authentication code
+    [[NSData randomDataOfLength:4096] writeToFile:[contentsPath stringByAppendingPathComponent:@"bands/0"] atomically:NO];
+    PGManifest *forgedManifest = [PGManifest manifestWithDirectoryAtPath:contentsPath excludedRelativePaths:nil error:&error];
+    STAssertTrue([forgedManifest writeToFile:manifestPath error:&error], @"Failed to write manifest: %@", error);
+    STAssertNotNil([[PGManifest alloc] initWithContentsOfFile:manifestPath error:&error], @"Failed to read unauthenticated manifest: %@", error);
+    STAssertNil([[PGManifest alloc] initWithContentsOfFile:manifestPath password:@"password" error:&error], @"Read forged manifest");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperManifestMismatchError, @"Wrong error for forged manifest: %@", error);
+    
+    // Copying the old authentication code into the forged manifest doesn't help either
+    NSMutableDictionary *plist = [NSPropertyListSerialization propertyListWithData:[NSData dataWithContentsOfFile:manifestPath] 
+                                                                           options:NSPropertyListMutableContainers format:NULL error:NULL];
+    [manifest writeToFile:manifestPath password:@"password" error:NULL];
+    NSDictionary *authenticPlist = [NSPropertyListSerialization propertyListWithData:[NSData dataWithContentsOfFile:manifestPath] 
+                                                                             options:NSPropertyListImmutable format:NULL error:NULL];
+    for (NSString *key in [NSArray arrayWithObjects:@"Salt", @"Rounds", @"AuthenticationCode", nil]) {
+        [plist setObject:[authenticPlist objectForKey:key] forKey:key];
+    }
+    
+    [[NSPropertyListSerialization dataWithPropertyList:plist format:NSPropertyListBinaryFormat_v1_0 options:0 error:NULL] 
+     writeToFile:manifestPath atomically:NO];
+    STAssertNil([[PGManifest alloc] initWithContentsOfFile:manifestPath password:@"password" error:&error], @"Read spliced manifest");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperManifestMismatchError, @"Wrong error for spliced manifest: %@", error);
+}
+
+
+- (void)testWrapperManifest
+{
+    NSError *error = nil;
+    NSString *wrapperPath = [temporaryDirectory stringByAppendingPathComponent:@"Test.edi"];
+    NSDictionary *volumeOptions = [NSDictionary dictionaryWithObjectsAndKeys:PGBandStoreBackend, PGBackendVolumeOption, 
+                                   [NSNumber numberWithUnsignedInteger:5], PGSizeVolumeOption, nil];
+    PGEncryptedDiskImageWrapper *wrapper = [PGEncryptedDiskImageWrapper createEncryptedDiskImageWrapperAtPath:wrapperPath masterPassword:@"master"
+                                                                                                         user:@"user" password:@"password" 
+                                                                                                volumeOptions:volumeOptions error:&error];
+    STAssertNotNil(wrapper, @"Failed to create wrapper: %@", error);
+    
+    STAssertFalse([wrapper verifyManifestWithOptions:0 error:&error], @"Verified wrapper without a manifest");
+    STAssertTrue([wrapper updateManifest:&error], @"Failed to update manifest: %@", error);
+    STAssertTrue([wrapper verifyManifestWithOptions:0 error:&error], @"Failed to verify unchanged wrapper: %@", error);
+    
+    // Issuing a session token doesn't invalidate the manifest, but writing to the band store does until the manifest is updated
+    STAssertNotNil([wrapper issueSessionTokenWithTimeToLive:60 error:&error], @"Failed to issue session token: %@", error);
+    STAssertTrue([wrapper verifyManifestWithOptions:0 error:&error], @"Session token invalidated manifest: %@", error);
+    
+    PGBandStore *bandStore = [wrapper openBandStore:&error];
+    STAssertTrue([bandStore writeData:[NSData randomDataOfLength:4096] atOffset:0 error:&error] && [bandStore flush:&error], 
+                 @"Failed to write band store: %@", error);
+    
+    STAssertFalse([wrapper verifyManifestWithOptions:0 error:&error], @"Verified changed wrapper");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperManifestMismatchError, @"Wrong error for changed wrapper: %@", error);
+    STAssertTrue([[[error userInfo] objectForKey:PGMismatchedPathsKey] count] > 0, @"No mismatched paths");
+    
+    STAssertTrue([wrapper updateManifest:&error], @"Failed to update manifest: %@", error);
+    STAssertTrue([wrapper verifyManifestWithOptions:PGManifestRehashAllFiles error:&error], @"Failed to verify updated wrapper: %@", error);
+    
+    // Changing the band store and recomputing the manifest without the master password is still detected
+    STAssertTrue([bandStore writeData:[NSData randomDataOfLength:4096] atOffset:0 error:&error] && [bandStore flush:&error], 
+                 @"Failed to write band store: %@", error);
+    NSString *manifestPath = [wrapperPath stringByAppendingPathComponent:@"Manifest.plist"];
+    PGManifest *forgedManifest = [[[PGManifest alloc] initWithContentsOfFile:manifestPath error:&error] 
+                                  manifestByUpdatingWithDirectoryAtPath:wrapperPath options:0 error:&error];
+    STAssertTrue([forgedManifest writeToFile:manifestPath error:&error], @"Failed to write manifest: %@", error);
+    STAssertFalse([wrapper verifyManifestWithOptions:0 error:&error], @"Verified wrapper with forged manifest");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperManifestMismatchError, @"Wrong error for forged manifest: %@", error);
+}
+
+@end
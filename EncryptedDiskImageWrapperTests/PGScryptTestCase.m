@@ -0,0 +1,97 @@
+//
+//  PGScryptTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGScryptTestCase.h"
+
+#import "NSData+Crypto.h"
+#import "PGScrypt.h"
+
+@implementation PGScryptTestCase
+
+- (void)testVectors
+{
+    // The test vectors from RFC 7914, section 12, except for the last, which takes 1 GB
+    NSArray *vectors = [NSArray arrayWithObjects:
+                        [NSArray arrayWithObjects:@"", @"", [NSNumber numberWithUnsignedInt:16], [NSNumber numberWithUnsignedInt:1], 
+                         [NSNumber numberWithUnsignedInt:1], @"77d6576238657b203b19ca42c18a0497f16b4844e3074ae8dfdffa3fede21442"
+                         @"fcd0069ded0948f8326a753a0fc81f17e8d3e0fb2e0d3628cf35e20c38d18906", nil],
+                        [NSArray arrayWithObjects:@"password", @"NaCl", [NSNumber numberWithUnsignedInt:1024], [NSNumber numberWithUnsignedInt:8], 
+                         [NSNumber numberWithUnsignedInt:16], @"fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b373162"
+                         @"2eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640", nil],
+                        [NSArray arrayWithObjects:@"pleaseletmein", @"SodiumChloride", [NSNumber numberWithUnsignedInt:16384], 
+                         [NSNumber numberWithUnsignedInt:8], [NSNumber numberWithUnsignedInt:1], 
+                         @"7023bdcb3afd7348461c06cd81fd38ebfda8fbba904f8e3ea9b543f6545da1f2"
+                         @"d5432955613f0fcf62d49705242a9af9e61e85dc0d651e40dfcf017b45575887", nil], nil];
+    
+    for (NSArray *vector in vectors) {
+        NSData *password = [[vector objectAtIndex:0] dataUsingEncoding:NSUTF8StringEncoding];
+        NSData *salt = [[vector objectAtIndex:1] dataUsingEncoding:NSUTF8StringEncoding];
+        NSData *expectedKey = [NSData dataWithHexadecimalString:[vector objectAtIndex:5]];
+        
+        NSMutableData *key = [NSMutableData dataWithLength:[expectedKey length]];
+        PGCryptoStatus status = PGScryptDeriveKey([password bytes], [password length], [salt bytes], [salt length], 
+                                                  [[vector objectAtIndex:2] unsignedIntValue], [[vector objectAtIndex:3] unsignedIntValue], 
+                                                  [[vector objectAtIndex:4] unsignedIntValue], [key mutableBytes], [key length]);
+        STAssertEquals(status, (PGCryptoStatus)PGCryptoSuccess, @"Derivation failed for %@", vector);
+        STAssertEqualObjects(key, expectedKey, @"Wrong key for %@", vector);
+    }
+}
+
+
+- (void)testInvalidParameters
+{
+    uint8_t key[PGSymmetricKeyLength];
+    
+    STAssertEquals(PGScryptDeriveKey("a", 1, "b", 1, 1000, 8, 1, key, sizeof(key)), (PGCryptoStatus)PGCryptoParameterError, 
+                   @"Accepted a cost that isn't a power of two");
+    STAssertEquals(PGScryptDeriveKey("a", 1, "b", 1, 1, 8, 1, key, sizeof(key)), (PGCryptoStatus)PGCryptoParameterError, @"Accepted a cost of 1");
+    STAssertEquals(PGScryptDeriveKey("a", 1, "b", 1, 16, 0, 1, key, sizeof(key)), (PGCryptoStatus)PGCryptoParameterError, 
+                   @"Accepted a block size of 0");
+    STAssertEquals(PGScryptDeriveKey("a", 1, "b", 1, 16, 8, 0, key, sizeof(key)), (PGCryptoStatus)PGCryptoParameterError, @"Accepted 0 lanes");
+    
+    // Parameters that would need more than the maximum memory are rejected before anything is allocated
+    STAssertTrue(PGScryptMemoryLength(1 << 20, 8, 16) > PGScryptMaximumMemoryLength, @"Test parameters don't exceed the maximum memory");
+    STAssertEquals(PGScryptDeriveKey("a", 1, "b", 1, 1 << 20, 8, 16, key, sizeof(key)), (PGCryptoStatus)PGCryptoParameterError, 
+                   @"Accepted parameters that need too much memory");
+    STAssertEquals(PGScryptMemoryLength(UINT32_MAX, UINT32_MAX, UINT32_MAX), (size_t)SIZE_MAX, @"Memory length overflowed");
+}
+
+
+- (void)testCalibration
+{
+    const size_t maximumMemoryLength = 64 * 1024 * 1024;
+    
+    for (uint32_t lanes = 1; lanes <= 4; lanes *= 2) {
+        uint32_t cost = PGScryptCalibrateCost(PGScryptDefaultBlockSize, lanes, 50, maximumMemoryLength);
+        STAssertTrue(cost >= PGScryptMinimumCost && (cost & (cost - 1)) == 0, @"Calibrated cost %u isn't a power of two", cost);
+        STAssertTrue(PGScryptMemoryLength(cost, PGScryptDefaultBlockSize, lanes) <= maximumMemoryLength, @"Calibrated cost uses too much memory");
+    }
+    
+    // A tiny memory limit always yields the minimum cost
+    STAssertEquals(PGScryptCalibrateCost(PGScryptDefaultBlockSize, 1, 1000, 0), (uint32_t)PGScryptMinimumCost, @"Ignored the memory limit");
+}
+
+@end
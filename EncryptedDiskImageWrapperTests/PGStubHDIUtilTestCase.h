@@ -0,0 +1,54 @@
+//
+//  PGStubHDIUtilTestCase.h
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <SenTestingKit/SenTestingKit.h>
+
+/*!
+ @abstract PGStubHDIUtilTestCase is the base class for test cases that run hdiutil-stub.sh instead of hdiutil.
+ @discussion Before each test, it creates a temporary directory and makes PGHDIUtilTask run the stub, so that tests don't depend on hdiutil or
+     touch real disk images. After each test, it restores the default launch path, clears the stub's environment variables, and removes the
+     temporary directory.
+ */
+@interface PGStubHDIUtilTestCase : SenTestCase
+{
+    NSString *temporaryDirectory;
+    NSString *stubLogPath;
+}
+
+/*!
+ @abstract Makes the stub append each invocation's verb to the log at stubLogPath.
+ @discussion Subclasses that create wrappers in -setUp can call this afterward, so that only the invocations made by their tests are counted.
+ */
+- (void)logStubInvocations;
+
+/*!
+ @abstract Returns the number of logged stub invocations with the specified verb.
+ @param verb The verb to count. May not be nil.
+ @return The number of invocations.
+ */
+- (NSUInteger)stubInvocationCountForVerb:(NSString *)verb;
+
+@end
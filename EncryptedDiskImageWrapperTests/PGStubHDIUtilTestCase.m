@@ -0,0 +1,75 @@
+//
+//  PGStubHDIUtilTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGStubHDIUtilTestCase.h"
+
+#import <stdlib.h>
+
+#import "NSFileManager+TemporaryFiles.h"
+#import "PGHDIUtilTask.h"
+
+@implementation PGStubHDIUtilTestCase
+
+- (void)setUp
+{
+    [super setUp];
+    NSString *template = [NSStringFromClass([self class]) stringByAppendingString:@".XXXXXX"];
+    temporaryDirectory = [[NSFileManager defaultManager] createTemporaryDirectoryWithTemplate:template error:NULL];
+    stubLogPath = [temporaryDirectory stringByAppendingPathComponent:@"hdiutil.log"];
+    
+    // Run the stub instead of hdiutil, so these tests don't depend on hdiutil or touch real disk images
+    [PGHDIUtilTask setDefaultLaunchPath:[[NSBundle bundleForClass:[PGStubHDIUtilTestCase class]] pathForResource:@"hdiutil-stub" ofType:@"sh"]];
+}
+
+
+- (void)tearDown
+{
+    [PGHDIUtilTask setDefaultLaunchPath:nil];
+    unsetenv("PGHDIUTIL_STUB_DELAY");
+    unsetenv("PGHDIUTIL_STUB_STATUS");
+    unsetenv("PGHDIUTIL_STUB_PADDING");
+    unsetenv("PGHDIUTIL_STUB_LOG");
+    
+    [[NSFileManager defaultManager] removeItemAtPath:temporaryDirectory error:NULL];
+    [super tearDown];
+}
+
+
+- (void)logStubInvocations
+{
+    setenv("PGHDIUTIL_STUB_LOG", [stubLogPath fileSystemRepresentation], 1);
+}
+
+
+- (NSUInteger)stubInvocationCountForVerb:(NSString *)verb
+{
+    NSString *log = [NSString stringWithContentsOfFile:stubLogPath encoding:NSUTF8StringEncoding error:NULL];
+    return [[[log componentsSeparatedByString:@"\n"] indexesOfObjectsPassingTest:^BOOL(id line, NSUInteger index, BOOL *stop) {
+        return [line isEqualToString:verb];
+    }] count];
+}
+
+@end
@@ -0,0 +1,300 @@
+//
+//  PGTemplatePoolTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGTemplatePoolTestCase.h"
+
+#import <stdlib.h>
+
+#import "NSData+Crypto.h"
+#import "PGBandStore.h"
+#import "PGEncryptedDiskImageWrapper.h"
+#import "PGErrors.h"
+#import "PGTemplatePool.h"
+
+@implementation PGTemplatePoolTestCase
+
+- (void)setUp
+{
+    [super setUp];
+    masterPassword = [NSData randomlyGeneratedPassword];
+    volumeOptions = [NSDictionary dictionaryWithObjectsAndKeys:@"Test Volume", PGNameVolumeOption, [NSNumber numberWithUnsignedInteger:5], 
+                     PGSizeVolumeOption, nil];
+    
+    [self logStubInvocations];
+}
+
+
+- (void)testClaimAndRefill
+{
+    NSError *error = nil;
+    PGTemplatePool *templatePool = [[PGTemplatePool alloc] initWithDirectory:[temporaryDirectory stringByAppendingPathComponent:@"Templates"] 
+                                                                       error:&error];
+    STAssertNotNil(templatePool, @"Failed to create template pool with error: %@", error);
+    [templatePool setDepth:2 forVolumeOptions:volumeOptions];
+    [templatePool waitUntilIdle];
+    
+    STAssertEquals([templatePool targetDepthForVolumeOptions:volumeOptions], (NSUInteger)2, @"Wrong target depth");
+    STAssertEquals([templatePool depthForVolumeOptions:volumeOptions], (NSUInteger)2, @"Pool wasn't filled");
+    STAssertEquals([self stubInvocationCountForVerb:@"create"], (NSUInteger)2, @"Wrong number of creates");
+    
+    // Equal volume options share templates, even if they're different instances
+    NSMutableDictionary *equalOptions = [volumeOptions mutableCopy];
+    NSString *wrapperPath = [temporaryDirectory stringByAppendingPathComponent:@"test.edi"];
+    PGEncryptedDiskImageWrapper *wrapper = [PGEncryptedDiskImageWrapper createEncryptedDiskImageWrapperAtPath:wrapperPath 
+                                                                                              masterPassword:masterPassword user:@"user1" 
+                                                                                                    password:@"password1" 
+                                                                                               volumeOptions:equalOptions 
+                                                                                                templatePool:templatePool error:&error];
+    STAssertNotNil(wrapper, @"Failed to create wrapper with error: %@", error);
+    STAssertEquals([templatePool hitCount], (NSUInteger)1, @"Wrong hit count");
+    STAssertEquals([templatePool missCount], (NSUInteger)0, @"Wrong miss count");
+    STAssertEqualsWithAccuracy([templatePool hitRate], 1.0, 0.001, @"Wrong hit rate");
+    STAssertEquals([self stubInvocationCountForVerb:@"chpass"], (NSUInteger)1, @"Template's master password wasn't changed");
+    
+    wrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:@"user1" password:@"password1" error:&error];
+    STAssertNotNil(wrapper, @"Failed to open wrapper created from template with error: %@", error);
+    STAssertNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:@"user1" password:@"wrong" error:NULL], 
+                @"Opened wrapper with wrong password");
+    STAssertTrue([wrapper attachAtPath:temporaryDirectory error:&error], @"Failed to attach wrapper with error: %@", error);
+    [wrapper detach:NULL];
+    
+    // The claimed template is replaced in the background
+    [templatePool waitUntilIdle];
+    STAssertEquals([templatePool depthForVolumeOptions:volumeOptions], (NSUInteger)2, @"Pool wasn't refilled");
+    STAssertEquals([self stubInvocationCountForVerb:@"create"], (NSUInteger)3, @"Wrong number of creates");
+    
+    STAssertTrue([templatePool removeAllTemplates:&error], @"Failed to remove templates with error: %@", error);
+    STAssertEquals([[[NSFileManager defaultManager] contentsOfDirectoryAtPath:[templatePool directory] error:NULL] count], (NSUInteger)0, 
+                   @"Templates remain after removing them");
+}
+
+
+- (void)testMisses
+{
+    NSError *error = nil;
+    PGTemplatePool *templatePool = [[PGTemplatePool alloc] initWithDirectory:[temporaryDirectory stringByAppendingPathComponent:@"Templates"] 
+                                                                       error:&error];
+    STAssertNotNil(templatePool, @"Failed to create template pool with error: %@", error);
+    [templatePool setDepth:1 forVolumeOptions:volumeOptions];
+    [templatePool waitUntilIdle];
+    
+    // Templates are only handed out for the volume options they were created with
+    NSDictionary *otherOptions = [NSDictionary dictionaryWithObjectsAndKeys:@"Other Volume", PGNameVolumeOption, 
+                                  [NSNumber numberWithUnsignedInteger:5], PGSizeVolumeOption, nil];
+    NSString *wrapperPath = [temporaryDirectory stringByAppendingPathComponent:@"test.edi"];
+    PGEncryptedDiskImageWrapper *wrapper = [PGEncryptedDiskImageWrapper createEncryptedDiskImageWrapperAtPath:wrapperPath 
+                                                                                              masterPassword:masterPassword user:@"user1" 
+                                                                                                    password:@"password1" 
+                                                                                               volumeOptions:otherOptions 
+                                                                                                templatePool:templatePool error:&error];
+    STAssertNotNil(wrapper, @"Failed to create wrapper with error: %@", error);
+    
+    STAssertEquals([templatePool hitCount], (NSUInteger)0, @"Wrong hit count");
+    STAssertEquals([templatePool missCount], (NSUInteger)1, @"Wrong miss count");
+    STAssertEqualsWithAccuracy([templatePool hitRate], 0.0, 0.001, @"Wrong hit rate");
+    STAssertEquals([templatePool depthForVolumeOptions:volumeOptions], (NSUInteger)1, @"Template was claimed by a miss");
+    STAssertEquals([self stubInvocationCountForVerb:@"create"], (NSUInteger)2, @"Miss didn't fall back to hdiutil");
+    
+    [templatePool removeAllTemplates:NULL];
+}
+
+
+- (void)testDepthChanges
+{
+    NSError *error = nil;
+    PGTemplatePool *templatePool = [[PGTemplatePool alloc] initWithDirectory:[temporaryDirectory stringByAppendingPathComponent:@"Templates"] 
+                                                                       error:&error];
+    STAssertNotNil(templatePool, @"Failed to create template pool with error: %@", error);
+    [templatePool setMaximumPreparationCount:3];
+    [templatePool setDepth:3 forVolumeOptions:volumeOptions];
+    [templatePool waitUntilIdle];
+    STAssertEquals([templatePool depthForVolumeOptions:volumeOptions], (NSUInteger)3, @"Pool wasn't filled");
+    
+    // Lowering the depth removes surplus templates from disk
+    [templatePool setDepth:1 forVolumeOptions:volumeOptions];
+    STAssertEquals([templatePool depthForVolumeOptions:volumeOptions], (NSUInteger)1, @"Surplus templates weren't removed");
+    STAssertEquals([[[NSFileManager defaultManager] contentsOfDirectoryAtPath:[templatePool directory] error:NULL] count], (NSUInteger)1, 
+                   @"Wrong number of templates on disk");
+    
+    [templatePool setDepth:0 forVolumeOptions:volumeOptions];
+    STAssertEquals([templatePool depthForVolumeOptions:volumeOptions], (NSUInteger)0, @"Templates remain at depth 0");
+    NSString *templateMasterPassword = nil;
+    STAssertNil([templatePool claimTemplateForVolumeOptions:volumeOptions masterPassword:&templateMasterPassword], @"Claimed template at depth 0");
+    STAssertNil(templateMasterPassword, @"Master password returned without a template");
+    STAssertEquals([self stubInvocationCountForVerb:@"create"], (NSUInteger)3, @"Wrong number of creates");
+}
+
+
+- (void)testPreparationFailure
+{
+    setenv("PGHDIUTIL_STUB_STATUS", "1", 1);
+    
+    NSError *error = nil;
+    PGTemplatePool *templatePool = [[PGTemplatePool alloc] initWithDirectory:[temporaryDirectory stringByAppendingPathComponent:@"Templates"] 
+                                                                       error:&error];
+    STAssertNotNil(templatePool, @"Failed to create template pool with error: %@", error);
+    [templatePool setDepth:2 forVolumeOptions:volumeOptions];
+    [templatePool waitUntilIdle];
+    
+    // Preparation stops after the first failure rather than retrying in a loop
+    STAssertEquals([templatePool depthForVolumeOptions:volumeOptions], (NSUInteger)0, @"Failed preparation produced a template");
+    STAssertEquals([self stubInvocationCountForVerb:@"create"], (NSUInteger)1, @"Failed preparation was retried");
+    STAssertEquals([[[NSFileManager defaultManager] contentsOfDirectoryAtPath:[templatePool directory] error:NULL] count], (NSUInteger)0, 
+                   @"Failed template wasn't removed");
+    
+    // The next claim is a miss, but resumes preparation
+    unsetenv("PGHDIUTIL_STUB_STATUS");
+    NSString *templateMasterPassword = nil;
+    STAssertNil([templatePool claimTemplateForVolumeOptions:volumeOptions masterPassword:&templateMasterPassword], @"Claimed nonexistent template");
+    [templatePool waitUntilIdle];
+    STAssertEquals([templatePool depthForVolumeOptions:volumeOptions], (NSUInteger)2, @"Preparation didn't resume");
+    STAssertEquals([templatePool missCount], (NSUInteger)1, @"Wrong miss count");
+    
+    [templatePool removeAllTemplates:NULL];
+}
+
+
+- (void)testBandStoreTemplates
+{
+    NSDictionary *bandStoreOptions = [NSDictionary dictionaryWithObjectsAndKeys:PGBandStoreBackend, PGBackendVolumeOption, 
+                                      [NSNumber numberWithUnsignedInteger:5], PGSizeVolumeOption, nil];
+    NSError *error = nil;
+    PGTemplatePool *templatePool = [[PGTemplatePool alloc] initWithDirectory:[temporaryDirectory stringByAppendingPathComponent:@"Templates"] 
+                                                                       error:&error];
+    STAssertNotNil(templatePool, @"Failed to create template pool with error: %@", error);
+    [templatePool setDepth:1 forVolumeOptions:bandStoreOptions];
+    [templatePool waitUntilIdle];
+    STAssertEquals([templatePool depthForVolumeOptions:bandStoreOptions], (NSUInteger)1, @"Pool wasn't filled");
+    
+    NSString *wrapperPath = [temporaryDirectory stringByAppendingPathComponent:@"test.edi"];
+    PGEncryptedDiskImageWrapper *wrapper = [PGEncryptedDiskImageWrapper createEncryptedDiskImageWrapperAtPath:wrapperPath 
+                                                                                              masterPassword:masterPassword user:@"user1" 
+                                                                                                    password:@"password1" 
+                                                                                               volumeOptions:bandStoreOptions 
+                                                                                                templatePool:templatePool error:&error];
+    STAssertNotNil(wrapper, @"Failed to create wrapper with error: %@", error);
+    STAssertEquals([templatePool hitCount], (NSUInteger)1, @"Wrong hit count");
+    STAssertNotNil([wrapper openBandStore:&error], @"Failed to open band store with error: %@", error);
+    STAssertEquals([self stubInvocationCountForVerb:@"create"], (NSUInteger)0, @"Band store templates ran hdiutil");
+    
+    // The template's master password is replaced by the one the wrapper was created with
+    NSString *bandStorePath = [wrapperPath stringByAppendingPathComponent:@"EncryptedBandStore.bands"];
+    STAssertNotNil([[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:masterPassword error:&error], 
+                   @"Failed to open band store with the wrapper's master password with error: %@", error);
+    
+    [templatePool removeAllTemplates:NULL];
+}
+
+
+- (void)testTemplatesHaveDistinctMasterPasswords
+{
+    NSDictionary *bandStoreOptions = [NSDictionary dictionaryWithObjectsAndKeys:PGBandStoreBackend, PGBackendVolumeOption, 
+                                      [NSNumber numberWithUnsignedInteger:5], PGSizeVolumeOption, nil];
+    NSError *error = nil;
+    PGTemplatePool *templatePool = [[PGTemplatePool alloc] initWithDirectory:[temporaryDirectory stringByAppendingPathComponent:@"Templates"] 
+                                                                       error:&error];
+    STAssertNotNil(templatePool, @"Failed to create template pool with error: %@", error);
+    [templatePool setDepth:2 forVolumeOptions:bandStoreOptions];
+    [templatePool waitUntilIdle];
+    
+    NSString *masterPassword1 = nil;
+    NSString *masterPassword2 = nil;
+    NSString *templatePath1 = [templatePool claimTemplateForVolumeOptions:bandStoreOptions masterPassword:&masterPassword1];
+    NSString *templatePath2 = [templatePool claimTemplateForVolumeOptions:bandStoreOptions masterPassword:&masterPassword2];
+    STAssertNotNil(templatePath1, @"Failed to claim template");
+    STAssertNotNil(templatePath2, @"Failed to claim template");
+    STAssertNotNil(masterPassword1, @"No master password returned with template");
+    STAssertFalse([masterPassword1 isEqualToString:masterPassword2], @"Templates share a master password");
+    
+    // Each template's storage opens with its own master password and no other
+    NSString *bandStorePath = [templatePath1 stringByAppendingPathComponent:@"EncryptedBandStore.bands"];
+    STAssertNotNil([[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:masterPassword1 error:&error], 
+                   @"Failed to open template's band store with error: %@", error);
+    STAssertNil([[PGBandStore alloc] initWithContentsOfFile:bandStorePath password:masterPassword2 error:NULL], 
+                @"Opened template's band store with another template's master password");
+    
+    [[NSFileManager defaultManager] removeItemAtPath:templatePath1 error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:templatePath2 error:NULL];
+    [templatePool removeAllTemplates:NULL];
+}
+
+
+- (void)testDirectoryCreationFailure
+{
+    // A regular file where the directory should be keeps it from being created
+    NSString *directory = [temporaryDirectory stringByAppendingPathComponent:@"Templates"];
+    [[NSData data] writeToFile:directory atomically:NO];
+    
+    NSError *error = nil;
+    STAssertNil([[PGTemplatePool alloc] initWithDirectory:directory error:&error], @"Created template pool without its directory");
+    STAssertEquals([error code], (NSInteger)PGEncryptedDiskImageWrapperCreationError, @"Wrong error code");
+}
+
+
+
+- (void)testStaleTemplatesRemoved
+{
+    // Templates left behind by an earlier process can't be used, since their master passwords were never stored
+    NSString *directory = [temporaryDirectory stringByAppendingPathComponent:@"Templates"];
+    NSString *staleTemplatePath = [directory stringByAppendingPathComponent:@"Template.stale"];
+    [[NSFileManager defaultManager] createDirectoryAtPath:staleTemplatePath withIntermediateDirectories:YES attributes:nil error:NULL];
+    
+    NSError *error = nil;
+    PGTemplatePool *templatePool = [[PGTemplatePool alloc] initWithDirectory:directory error:&error];
+    STAssertNotNil(templatePool, @"Failed to create template pool with error: %@", error);
+    STAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:staleTemplatePath], @"Stale template wasn't removed");
+}
+
+
+- (void)testClaimedTemplateRemovedOnFailure
+{
+    NSDictionary *bandStoreOptions = [NSDictionary dictionaryWithObjectsAndKeys:PGBandStoreBackend, PGBackendVolumeOption, 
+                                      [NSNumber numberWithUnsignedInteger:5], PGSizeVolumeOption, nil];
+    NSError *error = nil;
+    PGTemplatePool *templatePool = [[PGTemplatePool alloc] initWithDirectory:[temporaryDirectory stringByAppendingPathComponent:@"Templates"] 
+                                                                       error:&error];
+    STAssertNotNil(templatePool, @"Failed to create template pool with error: %@", error);
+    [templatePool setDepth:1 forVolumeOptions:bandStoreOptions];
+    [templatePool waitUntilIdle];
+    
+    // An existing file at the wrapper's path keeps the claimed template from being moved into place
+    NSString *wrapperPath = [temporaryDirectory stringByAppendingPathComponent:@"test.edi"];
+    [[NSData data] writeToFile:wrapperPath atomically:NO];
+    STAssertNil([PGEncryptedDiskImageWrapper createEncryptedDiskImageWrapperAtPath:wrapperPath masterPassword:masterPassword user:@"user1" 
+                                                                          password:@"password1" volumeOptions:bandStoreOptions 
+                                                                      templatePool:templatePool error:&error], 
+                @"Created wrapper over an existing file");
+    STAssertEquals([templatePool hitCount], (NSUInteger)1, @"Wrong hit count");
+    
+    // Nothing but the replacement template is left in the pool's directory
+    [templatePool waitUntilIdle];
+    STAssertEquals([[[NSFileManager defaultManager] contentsOfDirectoryAtPath:[templatePool directory] error:NULL] count], (NSUInteger)1, 
+                   @"Claimed template wasn't removed");
+    
+    [templatePool removeAllTemplates:NULL];
+}
+
+@end
@@ -0,0 +1,237 @@
+//
+//  PGUserTableCacheTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGUserTableCacheTestCase.h"
+
+#import "NSFileManager+TemporaryFiles.h"
+#import "PGEncryptedDiskImageWrapper.h"
+#import "PGUserTable.h"
+#import "PGUserTableCache.h"
+#import "PGUserTableTestEntry.h"
+
+/*!
+ @abstract Writes a user table with an entry for the specified user to the specified path.
+ @param path The path of the user table file. May not be nil.
+ @param user The user. May not be nil.
+ @return Whether the table was written.
+ */
+static BOOL PGUserTableCacheTestWriteTable(NSString *path, NSString *user)
+{
+    PGUserTable *userTable = [[PGUserTable alloc] init];
+    [userTable setEntry:PGUserTableTestEntry(user) forUser:user];
+    return [userTable writeToFile:path error:NULL];
+}
+
+
+/*!
+ @abstract Returns the size of the file at the specified path.
+ @param path The path of the file. May not be nil.
+ @return The file's size, or 0 if it doesn't exist.
+ */
+static unsigned long long PGUserTableCacheTestFileSize(NSString *path)
+{
+    return [[[NSFileManager defaultManager] attributesOfItemAtPath:path error:NULL] fileSize];
+}
+
+
+@implementation PGUserTableCacheTestCase
+
+- (void)setUp
+{
+    [super setUp];
+    temporaryDirectory = [[NSFileManager defaultManager] createTemporaryDirectoryWithTemplate:@"PGUserTableCacheTestCase.XXXXXX" error:NULL];
+}
+
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:temporaryDirectory error:NULL];
+    [super tearDown];
+}
+
+
+- (void)testHitsAndMisses
+{
+    NSError *error = nil;
+    NSString *path = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.db"];
+    STAssertTrue(PGUserTableCacheTestWriteTable(path, @"user"), @"Failed to write user table");
+    
+    PGUserTableCache *cache = [[PGUserTableCache alloc] init];
+    STAssertEquals([cache hitRate], 0.0, @"Hit rate with no lookups is nonzero");
+    
+    PGUserTable *userTable = [cache userTableAtPath:path error:&error];
+    STAssertNotNil(userTable, @"Failed to look up user table: %@", error);
+    STAssertNotNil([userTable entryForUser:@"user"], @"Cached table missing entry");
+    STAssertTrue([userTable isReadOnly], @"Cached table is writable");
+    STAssertThrows([userTable removeEntryForUser:@"user"], @"Changed a cached table");
+    
+    // Equivalent paths share the cached table
+    STAssertTrue([cache userTableAtPath:path error:&error] == userTable, @"Second lookup opened a new table");
+    NSString *equivalentPath = [[temporaryDirectory stringByAppendingPathComponent:@"."] stringByAppendingPathComponent:@"UserTable.db"];
+    STAssertTrue([cache userTableAtPath:equivalentPath error:&error] == userTable, @"Equivalent path opened a new table");
+    
+    STAssertEquals([cache hitCount], (NSUInteger)2, @"Wrong hit count");
+    STAssertEquals([cache missCount], (NSUInteger)1, @"Wrong miss count");
+    STAssertEqualsWithAccuracy([cache hitRate], 2.0 / 3.0, 0.001, @"Wrong hit rate");
+    STAssertEquals([cache count], (NSUInteger)1, @"Wrong count");
+    STAssertEquals([cache footprint], PGUserTableCacheTestFileSize(path), @"Wrong footprint");
+    
+    STAssertNil([cache userTableAtPath:[temporaryDirectory stringByAppendingPathComponent:@"Missing.db"] error:&error], @"Found missing table");
+    
+    [cache removeUserTableAtPath:path];
+    STAssertEquals([cache count], (NSUInteger)0, @"Table not removed");
+    STAssertFalse([cache userTableAtPath:path error:&error] == userTable, @"Removed table handed out");
+    
+    [cache removeAllUserTables];
+    STAssertEquals([cache count], (NSUInteger)0, @"Tables not removed");
+    STAssertEquals([cache hitCount] + [cache missCount], (NSUInteger)0, @"Counters not reset");
+}
+
+
+- (void)testInvalidation
+{
+    NSError *error = nil;
+    NSString *path = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.db"];
+    STAssertTrue(PGUserTableCacheTestWriteTable(path, @"user1"), @"Failed to write user table");
+    
+    PGUserTableCache *cache = [[PGUserTableCache alloc] init];
+    PGUserTable *originalTable = [cache userTableAtPath:path error:&error];
+    
+    // Saving changes appends to the log, which the cache notices
+    PGUserTable *privateTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    [privateTable setEntry:PGUserTableTestEntry(@"user2") forUser:@"user2"];
+    STAssertTrue([privateTable saveChanges:&error], @"Failed to save changes: %@", error);
+    
+    PGUserTable *loggedTable = [cache userTableAtPath:path error:&error];
+    STAssertFalse(loggedTable == originalTable, @"Table not reopened after log changed");
+    STAssertNotNil([loggedTable entryForUser:@"user2"], @"Reopened table missing logged entry");
+    STAssertNil([originalTable entryForUser:@"user2"], @"Table handed out earlier changed");
+    NSString *logPath = [[path stringByDeletingPathExtension] stringByAppendingPathExtension:@"log"];
+    STAssertEquals([cache footprint], PGUserTableCacheTestFileSize(path) + PGUserTableCacheTestFileSize(logPath), @"Wrong footprint");
+    
+    // Compacting and rewriting replace the table file
+    STAssertTrue([PGUserTable compactTableAtPath:path error:&error], @"Failed to compact table: %@", error);
+    PGUserTable *compactedTable = [cache userTableAtPath:path error:&error];
+    STAssertFalse(compactedTable == loggedTable, @"Table not reopened after compaction");
+    STAssertNotNil([compactedTable entryForUser:@"user2"], @"Compacted table missing entry");
+    
+    STAssertTrue(PGUserTableCacheTestWriteTable(path, @"user3"), @"Failed to rewrite user table");
+    PGUserTable *rewrittenTable = [cache userTableAtPath:path error:&error];
+    STAssertFalse(rewrittenTable == compactedTable, @"Table not reopened after rewrite");
+    STAssertNotNil([rewrittenTable entryForUser:@"user3"], @"Rewritten table missing entry");
+    
+    STAssertEquals([cache missCount], (NSUInteger)4, @"Wrong miss count");
+    STAssertEquals([cache count], (NSUInteger)1, @"Stale tables kept");
+}
+
+
+- (void)testCountLimit
+{
+    NSError *error = nil;
+    NSMutableArray *paths = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 3; ++i) {
+        NSString *path = [temporaryDirectory stringByAppendingPathComponent:[NSString stringWithFormat:@"UserTable%lu.db", (unsigned long)i]];
+        STAssertTrue(PGUserTableCacheTestWriteTable(path, @"user"), @"Failed to write user table");
+        [paths addObject:path];
+    }
+    
+    PGUserTableCache *cache = [[PGUserTableCache alloc] init];
+    [cache setCountLimit:2];
+    STAssertEquals([cache countLimit], (NSUInteger)2, @"Count limit not set");
+    
+    // Using the first table again makes the second the least recently used, so it's evicted when the third is opened
+    [cache userTableAtPath:[paths objectAtIndex:0] error:&error];
+    [cache userTableAtPath:[paths objectAtIndex:1] error:&error];
+    [cache userTableAtPath:[paths objectAtIndex:0] error:&error];
+    [cache userTableAtPath:[paths objectAtIndex:2] error:&error];
+    STAssertEquals([cache count], (NSUInteger)2, @"Count limit exceeded");
+    
+    NSUInteger hitCount = [cache hitCount];
+    [cache userTableAtPath:[paths objectAtIndex:0] error:&error];
+    STAssertEquals([cache hitCount], hitCount + 1, @"Most recently used table evicted");
+    [cache userTableAtPath:[paths objectAtIndex:1] error:&error];
+    STAssertEquals([cache hitCount], hitCount + 1, @"Least recently used table not evicted");
+    
+    [cache setCountLimit:1];
+    STAssertEquals([cache count], (NSUInteger)1, @"Lowering count limit didn't evict tables");
+}
+
+
+- (void)testConcurrentLookups
+{
+    NSError *error = nil;
+    NSString *path = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.db"];
+    STAssertTrue(PGUserTableCacheTestWriteTable(path, @"user"), @"Failed to write user table");
+    
+    PGUserTableCache *cache = [[PGUserTableCache alloc] init];
+    PGUserTable *userTable = [cache userTableAtPath:path error:&error];
+    NSDictionary *entry = [userTable entryForUser:@"user"];
+    
+    // Every thread shares the one table and reads it at once
+    __block NSUInteger mismatchCount = 0;
+    dispatch_apply(1000, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        PGUserTable *lookedUpTable = [cache userTableAtPath:path error:NULL];
+        if (lookedUpTable != userTable || ![[lookedUpTable entryForUser:@"user"] isEqualToDictionary:entry]) {
+            @synchronized (cache) {
+                ++mismatchCount;
+            }
+        }
+    });
+    
+    STAssertEquals(mismatchCount, (NSUInteger)0, @"Concurrent lookups got the wrong table");
+    STAssertEquals([cache hitCount], (NSUInteger)1000, @"Wrong hit count");
+}
+
+
+- (void)testWrapperSharing
+{
+    NSError *error = nil;
+    NSString *wrapperPath = [temporaryDirectory stringByAppendingPathComponent:@"Test.edi"];
+    NSDictionary *volumeOptions = [NSDictionary dictionaryWithObjectsAndKeys:PGBandStoreBackend, PGBackendVolumeOption, 
+                                   [NSNumber numberWithUnsignedInteger:5], PGSizeVolumeOption, nil];
+    STAssertNotNil([PGEncryptedDiskImageWrapper createEncryptedDiskImageWrapperAtPath:wrapperPath masterPassword:@"master" user:@"user1" 
+                                                                             password:@"password1" volumeOptions:volumeOptions error:&error],
+                   @"Failed to create wrapper: %@", error);
+    
+    PGUserTableCache *cache = [PGUserTableCache sharedUserTableCache];
+    [cache removeAllUserTables];
+    
+    PGEncryptedDiskImageWrapper *wrapper = [[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:@"user1" 
+                                                                                              password:@"password1" error:&error];
+    STAssertNotNil(wrapper, @"Failed to open wrapper: %@", error);
+    STAssertNotNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:@"user1" password:@"password1" error:&error], 
+                   @"Failed to open wrapper again: %@", error);
+    STAssertEquals([cache hitCount], (NSUInteger)1, @"Second open didn't use the cached table");
+    
+    // Changing users doesn't touch the shared table, but wrappers opened after the change see it
+    [wrapper setPassword:@"password2" forUser:@"user2"];
+    STAssertTrue([wrapper saveUserTable], @"Failed to save user table");
+    STAssertNotNil([[PGEncryptedDiskImageWrapper alloc] initWithContentsOfFile:wrapperPath user:@"user2" password:@"password2" error:&error], 
+                   @"Failed to open wrapper as new user: %@", error);
+    STAssertEquals([cache missCount], (NSUInteger)2, @"Changed table not reopened");
+}
+
+@end
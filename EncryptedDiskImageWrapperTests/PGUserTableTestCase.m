@@ -0,0 +1,416 @@
+//
+//  PGUserTableTestCase.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGUserTableTestCase.h"
+
+#import "NSData+Crypto.h"
+#import "NSFileManager+TemporaryFiles.h"
+#import "PGUserTable.h"
+#import "PGUserTableTestEntry.h"
+
+@implementation PGUserTableTestCase
+
+- (void)setUp
+{
+    [super setUp];
+    temporaryDirectory = [[NSFileManager defaultManager] createTemporaryDirectoryWithTemplate:@"PGUserTableTestCase.XXXXXX" error:NULL];
+}
+
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:temporaryDirectory error:NULL];
+    [super tearDown];
+}
+
+
+- (void)testRoundTrip
+{
+    NSError *error = nil;
+    NSString *path = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.db"];
+    
+    // Enough users to exercise collisions in the index, including a non-ASCII name
+    NSMutableDictionary *expectedEntries = [NSMutableDictionary dictionary];
+    PGUserTable *userTable = [[PGUserTable alloc] init];
+    for (NSUInteger i = 0; i < 1000; ++i) {
+        NSString *user = [NSString stringWithFormat:@"user%lu", (unsigned long)i];
+        [expectedEntries setObject:PGUserTableTestEntry(user) forKey:user];
+    }
+    
+    [expectedEntries setObject:PGUserTableTestEntry(@"usér") forKey:@"usér"];
+    for (NSString *user in expectedEntries) {
+        [userTable setEntry:[expectedEntries objectForKey:user] forUser:user];
+    }
+    
+    STAssertTrue([userTable writeToFile:path error:&error], @"Failed to write user table with error: %@", error);
+    
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    STAssertNotNil(userTable, @"Failed to read user table with error: %@", error);
+    for (NSString *user in expectedEntries) {
+        STAssertEqualObjects([userTable entryForUser:user], [expectedEntries objectForKey:user], @"Wrong entry for %@", user);
+    }
+    
+    STAssertNil([userTable entryForUser:@"nobody"], @"Found entry for nonexistent user");
+    
+    __block NSUInteger entryCount = 0;
+    [userTable enumerateEntriesUsingBlock:^(NSString *user, NSDictionary *entry, BOOL *stop) {
+        STAssertEqualObjects(entry, [expectedEntries objectForKey:user], @"Enumerated wrong entry for %@", user);
+        ++entryCount;
+    }];
+    
+    STAssertEquals(entryCount, [expectedEntries count], @"Enumerated wrong number of entries");
+}
+
+
+- (void)testUnsavedChanges
+{
+    NSError *error = nil;
+    NSString *path = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.db"];
+    
+    PGUserTable *userTable = [[PGUserTable alloc] init];
+    [userTable setEntry:PGUserTableTestEntry(@"user1") forUser:@"user1"];
+    [userTable setEntry:PGUserTableTestEntry(@"user2") forUser:@"user2"];
+    [userTable writeToFile:path error:&error];
+    
+    // Changes on top of a mapped table take effect immediately and are written out
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    NSDictionary *newEntry = PGUserTableTestEntry(@"user2");
+    [userTable setEntry:newEntry forUser:@"user2"];
+    [userTable removeEntryForUser:@"user1"];
+    STAssertNil([userTable entryForUser:@"user1"], @"Removed user still has an entry");
+    STAssertEqualObjects([userTable entryForUser:@"user2"], newEntry, @"Changed user has the wrong entry");
+    
+    STAssertTrue([userTable writeToFile:path error:&error], @"Failed to write user table with error: %@", error);
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    STAssertNil([userTable entryForUser:@"user1"], @"Removed user still has an entry after saving");
+    STAssertEqualObjects([userTable entryForUser:@"user2"], newEntry, @"Changed user has the wrong entry after saving");
+}
+
+
+- (void)testPropertyListMigration
+{
+    NSError *error = nil;
+    NSString *propertyListPath = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.plist"];
+    NSString *path = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.db"];
+    
+    NSDictionary *propertyListTable = [NSDictionary dictionaryWithObjectsAndKeys:PGUserTableTestEntry(@"user1"), @"user1", 
+                                       PGUserTableTestEntry(@"user2"), @"user2", nil];
+    [propertyListTable writeToFile:propertyListPath atomically:YES];
+    
+    PGUserTable *userTable = [[PGUserTable alloc] initWithContentsOfPropertyListFile:propertyListPath error:&error];
+    STAssertNotNil(userTable, @"Failed to read property list user table with error: %@", error);
+    STAssertEqualObjects([userTable entryForUser:@"user1"], PGUserTableTestEntry(@"user1"), @"Wrong entry read from property list user table");
+    STAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:path], @"Reading a property list user table wrote a user table file");
+    
+    STAssertTrue([PGUserTable migratePropertyListFile:propertyListPath toTableAtPath:path error:&error], 
+                 @"Failed to migrate user table with error: %@", error);
+    STAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:propertyListPath], @"Migration removed the property list user table");
+    
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    for (NSString *user in propertyListTable) {
+        STAssertEqualObjects([userTable entryForUser:user], [propertyListTable objectForKey:user], @"Wrong migrated entry for %@", user);
+    }
+    
+    // Migrating again, e.g., from another process that read the property list before the first migration, must not overwrite later changes
+    [userTable removeEntryForUser:@"user1"];
+    STAssertTrue([userTable saveChanges:&error], @"Failed to save changes with error: %@", error);
+    STAssertTrue([PGUserTable migratePropertyListFile:propertyListPath toTableAtPath:path error:&error], 
+                 @"Failed to migrate user table again with error: %@", error);
+    
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    STAssertNil([userTable entryForUser:@"user1"], @"Migrating again overwrote changes saved after the first migration");
+}
+
+
+- (void)testMalformedFile
+{
+    NSError *error = nil;
+    NSString *path = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.db"];
+    
+    [[NSData randomDataOfLength:4096] writeToFile:path atomically:YES];
+    STAssertNil([[PGUserTable alloc] initWithContentsOfFile:path error:&error], @"Read user table from random data");
+    
+    [[NSData data] writeToFile:path atomically:YES];
+    STAssertNil([[PGUserTable alloc] initWithContentsOfFile:path error:&error], @"Read user table from empty file");
+}
+
+
+- (void)testSavedChanges
+{
+    NSError *error = nil;
+    NSString *path = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.db"];
+    
+    PGUserTable *userTable = [[PGUserTable alloc] init];
+    [userTable setEntry:PGUserTableTestEntry(@"user1") forUser:@"user1"];
+    [userTable writeToFile:path error:&error];
+    
+    PGUserTable *writer = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    PGUserTable *reader = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    
+    // Saved changes are visible to the writer immediately and to other readers after they refresh
+    NSDictionary *newEntry = PGUserTableTestEntry(@"user2");
+    [writer setEntry:newEntry forUser:@"user2"];
+    [writer removeEntryForUser:@"user1"];
+    STAssertTrue([writer saveChanges:&error], @"Failed to save changes with error: %@", error);
+    STAssertEqualObjects([writer entryForUser:@"user2"], newEntry, @"Saved user has the wrong entry");
+    STAssertNotNil([reader entryForUser:@"user1"], @"Reader saw changes before refreshing");
+    
+    STAssertTrue([reader refresh:&error], @"Failed to refresh with error: %@", error);
+    STAssertNil([reader entryForUser:@"user1"], @"Removed user still has an entry after refreshing");
+    STAssertEqualObjects([reader entryForUser:@"user2"], newEntry, @"Saved user has the wrong entry after refreshing");
+    
+    // Compaction folds the log into the table without disturbing existing readers
+    STAssertTrue([PGUserTable compactTableAtPath:path error:&error], @"Failed to compact with error: %@", error);
+    STAssertEqualObjects([reader entryForUser:@"user2"], newEntry, @"Saved user has the wrong entry after compaction");
+    STAssertTrue([reader refresh:&error], @"Failed to refresh after compaction with error: %@", error);
+    STAssertNil([reader entryForUser:@"user1"], @"Removed user has an entry after compaction");
+    STAssertEqualObjects([reader entryForUser:@"user2"], newEntry, @"Saved user has the wrong entry after compaction and refresh");
+    
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    STAssertEqualObjects([userTable entryForUser:@"user2"], newEntry, @"Compacted table has the wrong entry");
+}
+
+
+- (void)testConcurrentSaves
+{
+    NSError *error = nil;
+    NSString *path = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.db"];
+    [[[PGUserTable alloc] init] writeToFile:path error:&error];
+    
+    // Each iteration uses its own table, just as separate processes would. Compactions run in the middle of it all.
+    const size_t writerCount = 16;
+    const size_t usersPerWriter = 64;
+    dispatch_apply(writerCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t writer) {
+        PGUserTable *userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:NULL];
+        for (size_t i = 0; i < usersPerWriter; ++i) {
+            NSString *user = [NSString stringWithFormat:@"user%zu-%zu", writer, i];
+            [userTable setEntry:PGUserTableTestEntry(user) forUser:user];
+            STAssertTrue([userTable saveChanges:NULL], @"Failed to save changes for %@", user);
+        }
+        
+        if (writer % 4 == 0) [PGUserTable compactTableAtPath:path error:NULL];
+    });
+    
+    PGUserTable *userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    __block NSUInteger entryCount = 0;
+    [userTable enumerateEntriesUsingBlock:^(NSString *user, NSDictionary *entry, BOOL *stop) {
+        ++entryCount;
+    }];
+    
+    STAssertEquals(entryCount, (NSUInteger)(writerCount * usersPerWriter), @"Lost changes from concurrent writers");
+}
+
+
+- (void)testTornLogRecord
+{
+    NSError *error = nil;
+    NSString *path = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.db"];
+    NSString *logPath = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.log"];
+    [[[PGUserTable alloc] init] writeToFile:path error:&error];
+    
+    PGUserTable *userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    NSDictionary *entry = PGUserTableTestEntry(@"user1");
+    [userTable setEntry:entry forUser:@"user1"];
+    [userTable saveChanges:&error];
+    
+    // Garbage at the end of the log looks like a record that was cut off mid-write, and is ignored
+    NSFileHandle *logHandle = [NSFileHandle fileHandleForWritingAtPath:logPath];
+    [logHandle seekToEndOfFile];
+    [logHandle writeData:[NSData randomDataOfLength:37]];
+    [logHandle closeFile];
+    
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    STAssertNotNil(userTable, @"Failed to read user table with torn log record: %@", error);
+    STAssertEqualObjects([userTable entryForUser:@"user1"], entry, @"Wrong entry before torn log record");
+    
+    // The next writer truncates the torn record before appending
+    NSDictionary *newEntry = PGUserTableTestEntry(@"user2");
+    [userTable setEntry:newEntry forUser:@"user2"];
+    STAssertTrue([userTable saveChanges:&error], @"Failed to save changes after torn log record with error: %@", error);
+    
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    STAssertEqualObjects([userTable entryForUser:@"user2"], newEntry, @"Wrong entry after torn log record");
+}
+
+
+- (void)testTornBatch
+{
+    NSError *error = nil;
+    NSString *path = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.db"];
+    NSString *logPath = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.log"];
+    [[[PGUserTable alloc] init] writeToFile:path error:&error];
+    
+    PGUserTable *userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    NSDictionary *entry = PGUserTableTestEntry(@"user1");
+    [userTable setEntry:entry forUser:@"user1"];
+    STAssertTrue([userTable saveChanges:&error], @"Failed to save changes with error: %@", error);
+    unsigned long long committedLength = [[[NSFileManager defaultManager] attributesOfItemAtPath:logPath error:NULL] fileSize];
+    
+    for (NSUInteger i = 2; i <= 10; ++i) {
+        NSString *user = [NSString stringWithFormat:@"user%lu", (unsigned long)i];
+        [userTable setEntry:PGUserTableTestEntry(user) forUser:user];
+    }
+    
+    [userTable removeEntryForUser:@"user1"];
+    STAssertTrue([userTable saveChanges:&error], @"Failed to save batch with error: %@", error);
+    
+    // Cutting the batch off anywhere, even after some of its changes are complete, leaves none of it in effect
+    unsigned long long batchLength = [[[NSFileManager defaultManager] attributesOfItemAtPath:logPath error:NULL] fileSize];
+    NSFileHandle *logHandle = [NSFileHandle fileHandleForWritingAtPath:logPath];
+    [logHandle truncateFileAtOffset:committedLength + (batchLength - committedLength) * 3 / 4];
+    [logHandle closeFile];
+    
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    STAssertEqualObjects([userTable entryForUser:@"user1"], entry, @"Applied part of a torn batch");
+    for (NSUInteger i = 2; i <= 10; ++i) {
+        STAssertNil([userTable entryForUser:[NSString stringWithFormat:@"user%lu", (unsigned long)i]], @"Applied part of a torn batch");
+    }
+}
+
+
+- (void)testEntriesWithoutAlgorithm
+{
+    NSError *error = nil;
+    NSString *path = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.db"];
+    
+    // Entries written by earlier versions have no algorithm, and read back as CBC from both the table and the log
+    NSMutableDictionary *entry = [PGUserTableTestEntry(@"user1") mutableCopy];
+    [entry removeObjectForKey:PGAlgorithmUserTableEntryKey];
+    NSMutableDictionary *expectedEntry = [entry mutableCopy];
+    [expectedEntry setObject:[NSNumber numberWithUnsignedInt:PGAES256CBCEncryptionAlgorithm] forKey:PGAlgorithmUserTableEntryKey];
+    
+    PGUserTable *userTable = [[PGUserTable alloc] init];
+    [userTable setEntry:entry forUser:@"user1"];
+    [userTable writeToFile:path error:&error];
+    
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    STAssertEqualObjects([userTable entryForUser:@"user1"], expectedEntry, @"Wrong entry without algorithm from table");
+    
+    [entry setObject:@"user2" forKey:PGUserUserTableEntryKey];
+    [expectedEntry setObject:@"user2" forKey:PGUserUserTableEntryKey];
+    [userTable setEntry:entry forUser:@"user2"];
+    STAssertTrue([userTable saveChanges:&error], @"Failed to save changes with error: %@", error);
+    
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    STAssertEqualObjects([userTable entryForUser:@"user2"], expectedEntry, @"Wrong entry without algorithm from log");
+    
+    // Logged algorithms survive compaction
+    NSMutableDictionary *gcmEntry = [PGUserTableTestEntry(@"user3") mutableCopy];
+    [gcmEntry setObject:[NSNumber numberWithUnsignedInt:PGAES256GCMEncryptionAlgorithm] forKey:PGAlgorithmUserTableEntryKey];
+    [userTable setEntry:gcmEntry forUser:@"user3"];
+    [userTable saveChanges:&error];
+    STAssertTrue([PGUserTable compactTableAtPath:path error:&error], @"Failed to compact with error: %@", error);
+    
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    STAssertEqualObjects([userTable entryForUser:@"user3"], gcmEntry, @"Wrong algorithm after compaction");
+}
+
+
+- (void)testKeyDerivationParameters
+{
+    NSError *error = nil;
+    NSString *path = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.db"];
+    
+    NSMutableDictionary *scryptEntry = [PGUserTableTestEntry(@"user1") mutableCopy];
+    [scryptEntry setObject:[NSNumber numberWithUnsignedInt:PGScryptKeyDerivationAlgorithm] forKey:PGKeyDerivationUserTableEntryKey];
+    [scryptEntry setObject:[NSNumber numberWithUnsignedInt:8] forKey:PGBlockSizeUserTableEntryKey];
+    [scryptEntry setObject:[NSNumber numberWithUnsignedInt:arc4random_uniform(64) + 1] forKey:PGLanesUserTableEntryKey];
+    NSDictionary *pbkdf2Entry = PGUserTableTestEntry(@"user2");
+    
+    // A table with only PBKDF2 entries is written in the format that earlier versions read
+    PGUserTable *userTable = [[PGUserTable alloc] init];
+    [userTable setEntry:pbkdf2Entry forUser:@"user2"];
+    STAssertTrue([userTable writeToFile:path error:&error], @"Failed to write user table with error: %@", error);
+    
+    uint32_t header[2];
+    [[NSData dataWithContentsOfFile:path] getBytes:header length:sizeof(header)];
+    STAssertEquals(CFSwapInt32LittleToHost(header[1]), (uint32_t)1, @"PBKDF2-only table wasn't written as version 1");
+    
+    // Key derivation parameters survive the log, the table, and compaction, and PBKDF2 entries alongside them are unchanged
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    [userTable setEntry:scryptEntry forUser:@"user1"];
+    STAssertTrue([userTable saveChanges:&error], @"Failed to save changes with error: %@", error);
+    
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    STAssertEqualObjects([userTable entryForUser:@"user1"], scryptEntry, @"Wrong scrypt entry from log");
+    STAssertEqualObjects([userTable entryForUser:@"user2"], pbkdf2Entry, @"Wrong PBKDF2 entry from version 1 table");
+    
+    STAssertTrue([PGUserTable compactTableAtPath:path error:&error], @"Failed to compact with error: %@", error);
+    [[NSData dataWithContentsOfFile:path] getBytes:header length:sizeof(header)];
+    STAssertEquals(CFSwapInt32LittleToHost(header[1]), (uint32_t)2, @"Table with scrypt entries wasn't written as version 2");
+    
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    STAssertEqualObjects([userTable entryForUser:@"user1"], scryptEntry, @"Wrong scrypt entry from version 2 table");
+    STAssertEqualObjects([userTable entryForUser:@"user2"], pbkdf2Entry, @"Wrong PBKDF2 entry from version 2 table");
+}
+
+
+- (void)testLogVersions
+{
+    NSError *error = nil;
+    NSString *path = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.db"];
+    NSString *logPath = [temporaryDirectory stringByAppendingPathComponent:@"UserTable.log"];
+    [[[PGUserTable alloc] init] writeToFile:path error:&error];
+    
+    PGUserTable *userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    NSDictionary *entry = PGUserTableTestEntry(@"user1");
+    [userTable setEntry:entry forUser:@"user1"];
+    STAssertTrue([userTable saveChanges:&error], @"Failed to save changes with error: %@", error);
+    
+    // Rewrite the log's version, which follows its magic number, to make it look like a version 1 log. Those are still read.
+    uint32_t version = CFSwapInt32HostToLittle(1);
+    NSFileHandle *logHandle = [NSFileHandle fileHandleForWritingAtPath:logPath];
+    [logHandle seekToFileOffset:sizeof(uint32_t)];
+    [logHandle writeData:[NSData dataWithBytes:&version length:sizeof(version)]];
+    [logHandle closeFile];
+    
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    STAssertEqualObjects([userTable entryForUser:@"user1"], entry, @"Wrong entry from version 1 log");
+    
+    // Saving to a version 1 log folds it into the table and starts a current log, so older builds can't truncate our records
+    NSDictionary *newEntry = PGUserTableTestEntry(@"user2");
+    [userTable setEntry:newEntry forUser:@"user2"];
+    STAssertTrue([userTable saveChanges:&error], @"Failed to save changes to version 1 log with error: %@", error);
+    
+    NSData *logData = [NSData dataWithContentsOfFile:logPath];
+    STAssertEquals([logData length], 2 * sizeof(uint32_t), @"Version 1 log wasn't replaced");
+    [logData getBytes:&version range:NSMakeRange(sizeof(uint32_t), sizeof(version))];
+    STAssertEquals(CFSwapInt32LittleToHost(version), (uint32_t)3, @"Wrong log version");
+    
+    userTable = [[PGUserTable alloc] initWithContentsOfFile:path error:&error];
+    STAssertEqualObjects([userTable entryForUser:@"user1"], entry, @"Lost entry from version 1 log");
+    STAssertEqualObjects([userTable entryForUser:@"user2"], newEntry, @"Lost entry saved to version 1 log");
+    
+    // Logs from newer versions are refused rather than misread
+    version = CFSwapInt32HostToLittle(4);
+    logHandle = [NSFileHandle fileHandleForWritingAtPath:logPath];
+    [logHandle seekToFileOffset:sizeof(uint32_t)];
+    [logHandle writeData:[NSData dataWithBytes:&version length:sizeof(version)]];
+    [logHandle closeFile];
+    STAssertNil([[PGUserTable alloc] initWithContentsOfFile:path error:&error], @"Read log with unknown version");
+}
+
+@end
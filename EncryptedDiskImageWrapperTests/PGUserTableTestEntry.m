@@ -0,0 +1,38 @@
+//
+//  PGUserTableTestEntry.m
+//  EncryptedDiskImageWrapperTests
+//
+//  Created by Prachi Gauriar on 10/17/2026.
+//  Copyright (c) 2026 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGUserTableTestEntry.h"
+
+#import "NSData+Crypto.h"
+#import "PGUserTable.h"
+
+NSDictionary *PGUserTableTestEntry(NSString *user)
+{
+    return [NSDictionary dictionaryWithObjectsAndKeys:user, PGUserUserTableEntryKey, [NSData randomDataOfLength:24], PGSaltUserTableEntryKey, 
+            [NSNumber numberWithUnsignedInt:arc4random()], PGRoundsUserTableEntryKey, [NSData randomDataOfLength:16], 
+            PGInitializationVectorUserTableEntryKey, [NSData randomDataOfLength:48], PGSecretUserTableEntryKey, 
+            [NSNumber numberWithUnsignedInt:arc4random_uniform(2)], PGAlgorithmUserTableEntryKey, nil];
+}
@@ -0,0 +1,82 @@
+#!/bin/sh
+#
+#  hdiutil-stub.sh
+#  EncryptedDiskImageWrapper
+#
+#  Plays back canned hdiutil output so that PGHDIUtilTask and PGEncryptedDiskImageWrapper can be tested on systems
+#  without hdiutil. Its behavior is controlled by the following environment variables:
+#
+#    PGHDIUTIL_STUB_DELAY    Seconds to wait before responding. Defaults to 0.
+#    PGHDIUTIL_STUB_STATUS   Exit status. If nonzero, an error message is written to standard error. Defaults to 0.
+#    PGHDIUTIL_STUB_PADDING  Number of extra system entities in attach output, which can be used to make the output
+#                            larger than a pipe's buffer. Defaults to 0.
+#    PGHDIUTIL_STUB_LOG      Path of a file to which each invocation's verb is appended, which can be used to count
+#                            hdiutil invocations. Defaults to no log.
+#
+
+verb="$1"
+shift
+
+# Consume the password, which is written to standard input for every verb but detach. chpass is given two.
+[ "$verb" = "detach" ] || cat > /dev/null
+[ -z "$PGHDIUTIL_STUB_LOG" ] || echo "$verb" >> "$PGHDIUTIL_STUB_LOG"
+
+# Sleep in the background so that terminating this script doesn't leave a process holding our output pipes open
+sleep "${PGHDIUTIL_STUB_DELAY:-0}" < /dev/null > /dev/null 2>&1 &
+wait $!
+
+status="${PGHDIUTIL_STUB_STATUS:-0}"
+if [ "$status" -ne 0 ]; then
+    echo "hdiutil: $verb failed - stub failure" >&2
+    exit "$status"
+fi
+
+plist_header() {
+    echo '<?xml version="1.0" encoding="UTF-8"?>'
+    echo '<!DOCTYPE plist PUBLIC "-//Apple//DTD PLIST 1.0//EN" "http://www.apple.com/DTDs/PropertyList-1.0.dtd">'
+    echo '<plist version="1.0">'
+}
+
+case "$verb" in
+    create)
+        mkdir -p "$1" || exit 1
+        plist_header
+        echo "<array><string>$1</string></array>"
+        echo '</plist>'
+        ;;
+    attach)
+        mount_point=""
+        while [ $# -gt 0 ]; do
+            case "$1" in
+                -mountpoint) mount_point="$2"; shift ;;
+                -mountrandom) mount_point=$(mktemp -d "$2/stub.XXXXXX") || exit 1; shift ;;
+            esac
+            shift
+        done
+        
+        plist_header
+        echo '<dict><key>system-entities</key><array>'
+        padding=0
+        while [ "$padding" -lt "${PGHDIUTIL_STUB_PADDING:-0}" ]; do
+            echo "<dict><key>content-hint</key><string>Apple_Free</string><key>dev-entry</key><string>/dev/disk99s$padding</string></dict>"
+            padding=$((padding + 1))
+        done
+        echo "<dict><key>dev-entry</key><string>/dev/disk99s1</string><key>mount-point</key><string>$mount_point</string></dict>"
+        echo '</array></dict>'
+        echo '</plist>'
+        ;;
+    detach)
+        echo "\"$1\" unmounted."
+        echo "\"$1\" ejected."
+        ;;
+    chpass)
+        if [ ! -e "$1" ]; then
+            echo "hdiutil: chpass failed - No such file or directory" >&2
+            exit 1
+        fi
+        ;;
+    *)
+        echo "hdiutil: unknown verb $verb" >&2
+        exit 1
+        ;;
+esac